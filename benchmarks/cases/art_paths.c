@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The adaptive radix tree keyed by relation paths, as the manifest, the
+ * restore link map and the SSH tree map use it.
+ *
+ * One million paths are spread over a few databases, half of them below a
+ * tablespace so that their common prefixes are long. The phases are:
+ *
+ *   insert        - one pgmoneta_art_insert() per path, in manifest order
+ *   lookup        - one pgmoneta_art_search() per path, in another order
+ *   lookup_miss   - one pgmoneta_art_search() per absent path
+ *   bulk_load     - pgmoneta_art_bulk_load() of the sorted paths
+ *   lookup_bulk   - lookup on the bulk loaded tree
+ *   destroy       - pgmoneta_art_destroy() of both trees
+ *
+ * Dividing ART_PATHS_COUNT by a phase gives its rate. No backend is needed,
+ * so this runs in process.
+ */
+
+/* bench */
+#include <bench.h>
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <art.h>
+
+/* system */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ART_PATHS_COUNT 1000000
+#define ART_PATH_LENGTH      64
+#define ART_DATABASES         4
+
+static char* paths_create(void);
+static void shuffle(char** keys, int count, uint64_t seed);
+static int compare_paths(const void* a, const void* b);
+static int lookup(struct art* t, char** keys, int count, const char* phase);
+
+BENCH_MICRO(art_paths)
+{
+   char* buffer = NULL;
+   char** keys = NULL;
+   uintptr_t* values = NULL;
+   struct art* t = NULL;
+   struct art* bulk = NULL;
+   char miss[ART_PATH_LENGTH];
+   double start;
+
+   buffer = paths_create();
+   keys = malloc(ART_PATHS_COUNT * sizeof(char*));
+   values = malloc(ART_PATHS_COUNT * sizeof(uintptr_t));
+   if (buffer == NULL || keys == NULL || values == NULL)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < ART_PATHS_COUNT; i++)
+   {
+      keys[i] = buffer + (size_t)i * ART_PATH_LENGTH;
+   }
+
+   /* A manifest lists files in directory order, which is not sorted */
+   shuffle(keys, ART_PATHS_COUNT, 1);
+
+   if (pgmoneta_art_create(&t) || pgmoneta_art_create(&bulk))
+   {
+      goto error;
+   }
+
+   start = bench_now();
+
+   for (int i = 0; i < ART_PATHS_COUNT; i++)
+   {
+      if (pgmoneta_art_insert(t, keys[i], (uintptr_t)keys[i], ValueRef))
+      {
+         goto error;
+      }
+   }
+
+   bench_record("insert", bench_now() - start);
+
+   shuffle(keys, ART_PATHS_COUNT, 2);
+
+   if (lookup(t, keys, ART_PATHS_COUNT, "lookup"))
+   {
+      goto error;
+   }
+
+   start = bench_now();
+
+   for (int i = 0; i < ART_PATHS_COUNT; i++)
+   {
+      snprintf(&miss[0], sizeof(miss), "%s_init", keys[i]);
+      if (pgmoneta_art_search(t, &miss[0]) != 0)
+      {
+         goto error;
+      }
+   }
+
+   bench_record("lookup_miss", bench_now() - start);
+
+   qsort(keys, ART_PATHS_COUNT, sizeof(char*), compare_paths);
+   for (int i = 0; i < ART_PATHS_COUNT; i++)
+   {
+      values[i] = (uintptr_t)keys[i];
+   }
+
+   start = bench_now();
+
+   if (pgmoneta_art_bulk_load(bulk, keys, values, ValueRef, ART_PATHS_COUNT) || bulk->size != ART_PATHS_COUNT)
+   {
+      goto error;
+   }
+
+   bench_record("bulk_load", bench_now() - start);
+
+   shuffle(keys, ART_PATHS_COUNT, 2);
+
+   if (lookup(bulk, keys, ART_PATHS_COUNT, "lookup_bulk"))
+   {
+      goto error;
+   }
+
+   start = bench_now();
+
+   pgmoneta_art_destroy(t);
+   pgmoneta_art_destroy(bulk);
+
+   bench_record("destroy", bench_now() - start);
+
+   free(values);
+   free(keys);
+   free(buffer);
+
+   return 0;
+
+error:
+
+   pgmoneta_art_destroy(t);
+   pgmoneta_art_destroy(bulk);
+   free(values);
+   free(keys);
+   free(buffer);
+
+   return 1;
+}
+
+static char*
+paths_create(void)
+{
+   static const char* forks[] = {"", "_fsm", "_vm", ".1"};
+   static const unsigned int databases[ART_DATABASES] = {1, 5, 16384, 16385};
+   char* buffer = NULL;
+   char* path = NULL;
+   int per_database = ART_PATHS_COUNT / ART_DATABASES;
+
+   buffer = malloc((size_t)ART_PATHS_COUNT * ART_PATH_LENGTH);
+   if (buffer == NULL)
+   {
+      return NULL;
+   }
+
+   for (int i = 0; i < ART_PATHS_COUNT; i++)
+   {
+      unsigned int database = databases[i / per_database];
+      unsigned int relfilenode = 16384 + (i % per_database) / 4;
+
+      path = buffer + (size_t)i * ART_PATH_LENGTH;
+
+      if (i % 2 == 0)
+      {
+         snprintf(path, ART_PATH_LENGTH, "base/%u/%u%s", database, relfilenode, forks[i % 4]);
+      }
+      else
+      {
+         snprintf(path, ART_PATH_LENGTH, "pg_tblspc/16400/PG_17_202406281/%u/%u%s", database, relfilenode, forks[i % 4]);
+      }
+   }
+
+   return buffer;
+}
+
+static void
+shuffle(char** keys, int count, uint64_t seed)
+{
+   uint64_t x = seed * 0x9E3779B97F4A7C15ULL;
+   char* tmp = NULL;
+
+   for (int i = count - 1; i > 0; i--)
+   {
+      int j;
+
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      j = (int)(x % (uint64_t)(i + 1));
+
+      tmp = keys[i];
+      keys[i] = keys[j];
+      keys[j] = tmp;
+   }
+}
+
+static int
+compare_paths(const void* a, const void* b)
+{
+   return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int
+lookup(struct art* t, char** keys, int count, const char* phase)
+{
+   double start = bench_now();
+
+   for (int i = 0; i < count; i++)
+   {
+      if (pgmoneta_art_search(t, keys[i]) != (uintptr_t)keys[i])
+      {
+         return 1;
+      }
+   }
+
+   bench_record(phase, bench_now() - start);
+
+   return 0;
+}
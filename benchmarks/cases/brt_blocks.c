@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The block reference table of a WAL summary, as the summarizer builds it
+ * and incremental backup reads it.
+ *
+ * 100k relations get 22M modified blocks. Most relations have a few
+ * scattered blocks, one in a hundred is rewritten in long runs so that its
+ * chunks turn into bitmaps. The phases are:
+ *
+ *   build         - one pgmoneta_brt_mark_block_modified() per block
+ *   write         - pgmoneta_brt_write() to a temporary file
+ *   read_back     - pgmoneta_brt_read() of that file
+ *   extract       - pgmoneta_brt_entry_get_ranges() over every relation
+ *   extract_blocks - pgmoneta_brt_entry_get_blocks() and a qsort() over
+ *                   every relation, the baseline that extract replaced
+ *   union         - pgmoneta_brt_union() of the table into an empty one,
+ *                   and again into the now full one
+ *   destroy       - pgmoneta_brt_destroy() of all tables
+ *
+ * No backend is needed, so this runs in process.
+ */
+
+/* bench */
+#include <bench.h>
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <brt.h>
+
+/* system */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define BRT_RELATIONS      100000
+#define BRT_DENSE_EVERY       100
+#define BRT_DENSE_BLOCKS    25000
+#define BRT_DENSE_RUN          64
+#define BRT_DENSE_GAP          16
+#define BRT_SPARSE_BLOCKS      20
+#define BRT_SPARSE_STRIDE     997
+#define BRT_MAX_RANGES       4096
+
+static void locator(int i, struct rel_file_locator* rlocator);
+static int build(block_ref_table* brt);
+static int extract(block_ref_table* brt, block_ref_table_range* ranges);
+static int extract_blocks(block_ref_table* brt, block_number* blocks);
+static int compare_block_numbers(const void* a, const void* b);
+
+BENCH_MICRO(brt_blocks)
+{
+   char path[] = "/tmp/pgmoneta-bench-brt-XXXXXX";
+   int fd = -1;
+   block_ref_table* brt = NULL;
+   block_ref_table* read = NULL;
+   block_ref_table* merged = NULL;
+   block_ref_table_range* ranges = NULL;
+   block_number* blocks = NULL;
+   double start;
+
+   fd = mkstemp(path);
+   if (fd == -1)
+   {
+      goto error;
+   }
+   close(fd);
+
+   ranges = malloc(BRT_MAX_RANGES * sizeof(block_ref_table_range));
+   blocks = malloc(BRT_DENSE_BLOCKS * sizeof(block_number));
+   if (ranges == NULL || blocks == NULL)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_brt_create_empty(&brt) || pgmoneta_brt_create_empty(&merged))
+   {
+      goto error;
+   }
+
+   start = bench_now();
+
+   if (build(brt))
+   {
+      goto error;
+   }
+
+   bench_record("build", bench_now() - start);
+
+   start = bench_now();
+
+   if (pgmoneta_brt_write(brt, &path[0]))
+   {
+      goto error;
+   }
+
+   bench_record("write", bench_now() - start);
+
+   start = bench_now();
+
+   if (pgmoneta_brt_read(&path[0], &read) || read->table->size != BRT_RELATIONS)
+   {
+      goto error;
+   }
+
+   bench_record("read_back", bench_now() - start);
+
+   start = bench_now();
+
+   if (extract(read, ranges))
+   {
+      goto error;
+   }
+
+   bench_record("extract", bench_now() - start);
+
+   start = bench_now();
+
+   if (extract_blocks(read, blocks))
+   {
+      goto error;
+   }
+
+   bench_record("extract_blocks", bench_now() - start);
+
+   start = bench_now();
+
+   if (pgmoneta_brt_union(merged, read) || pgmoneta_brt_union(merged, brt) || merged->table->size != BRT_RELATIONS)
+   {
+      goto error;
+   }
+
+   bench_record("union", bench_now() - start);
+
+   start = bench_now();
+
+   pgmoneta_brt_destroy(brt);
+   pgmoneta_brt_destroy(read);
+   pgmoneta_brt_destroy(merged);
+
+   bench_record("destroy", bench_now() - start);
+
+   free(ranges);
+   free(blocks);
+   unlink(&path[0]);
+
+   return 0;
+
+error:
+
+   pgmoneta_brt_destroy(brt);
+   pgmoneta_brt_destroy(read);
+   pgmoneta_brt_destroy(merged);
+   free(ranges);
+   free(blocks);
+   unlink(&path[0]);
+
+   return 1;
+}
+
+static void
+locator(int i, struct rel_file_locator* rlocator)
+{
+   rlocator->spcOid = 1663;
+   rlocator->dbOid = 16384 + i % 4;
+   rlocator->relNumber = 16384 + i;
+}
+
+static int
+build(block_ref_table* brt)
+{
+   struct rel_file_locator rlocator;
+
+   for (int i = 0; i < BRT_RELATIONS; i++)
+   {
+      locator(i, &rlocator);
+
+      if (i % BRT_DENSE_EVERY == 0)
+      {
+         for (block_number b = 0; b < BRT_DENSE_BLOCKS; b++)
+         {
+            if (b % (BRT_DENSE_RUN + BRT_DENSE_GAP) < BRT_DENSE_RUN)
+            {
+               if (pgmoneta_brt_mark_block_modified(brt, &rlocator, MAIN_FORKNUM, b))
+               {
+                  return 1;
+               }
+            }
+         }
+      }
+      else
+      {
+         for (int j = 0; j < BRT_SPARSE_BLOCKS; j++)
+         {
+            if (pgmoneta_brt_mark_block_modified(brt, &rlocator, MAIN_FORKNUM, (block_number)(j * BRT_SPARSE_STRIDE + i % 7)))
+            {
+               return 1;
+            }
+         }
+      }
+   }
+
+   return 0;
+}
+
+static int
+extract(block_ref_table* brt, block_ref_table_range* ranges)
+{
+   struct rel_file_locator rlocator;
+   block_ref_table_entry* entry = NULL;
+   block_number limit_block;
+   int n = 0;
+
+   for (int i = 0; i < BRT_RELATIONS; i++)
+   {
+      locator(i, &rlocator);
+
+      entry = pgmoneta_brt_get_entry(brt, &rlocator, MAIN_FORKNUM, &limit_block);
+      if (entry == NULL)
+      {
+         return 1;
+      }
+
+      if (pgmoneta_brt_entry_get_ranges(entry, 0, entry->max_block_number + 1, ranges, BRT_MAX_RANGES, &n) || n == 0)
+      {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+static int
+extract_blocks(block_ref_table* brt, block_number* blocks)
+{
+   struct rel_file_locator rlocator;
+   block_ref_table_entry* entry = NULL;
+   block_number limit_block;
+   int n = 0;
+
+   for (int i = 0; i < BRT_RELATIONS; i++)
+   {
+      locator(i, &rlocator);
+
+      entry = pgmoneta_brt_get_entry(brt, &rlocator, MAIN_FORKNUM, &limit_block);
+      if (entry == NULL)
+      {
+         return 1;
+      }
+
+      if (pgmoneta_brt_entry_get_blocks(entry, 0, entry->max_block_number + 1, blocks, BRT_DENSE_BLOCKS, &n) || n == 0)
+      {
+         return 1;
+      }
+
+      qsort(blocks, n, sizeof(block_number), compare_block_numbers);
+   }
+
+   return 0;
+}
+
+static int
+compare_block_numbers(const void* a, const void* b)
+{
+   block_number x = *(const block_number*)a;
+   block_number y = *(const block_number*)b;
+
+   return x < y ? -1 : x > y;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A file list as pgmoneta_get_files() and the manifest readers build it,
+ * with the relative path as the tag and the checksum as the value.
+ *
+ * The phases are:
+ *
+ *   add      - pgmoneta_deque_add() of every file, in scrambled order
+ *   iterate  - a deque iterator over every file
+ *   exists   - pgmoneta_deque_exists() of a sample of the files
+ *   get      - pgmoneta_deque_get() of the same sample
+ *   sort     - pgmoneta_deque_sort() on the tags
+ *   poll     - pgmoneta_deque_poll() until the deque is empty
+ *   heap_mb  - heap held by the deque
+ *
+ * No backend is needed, so this runs in process.
+ */
+
+/* bench */
+#include <bench.h>
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <deque.h>
+#include <value.h>
+
+/* system */
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* A cluster with a few hundred thousand relation segments is common */
+#define DEQUE_FILES_COUNT 200000
+
+/* A scan per lookup is quadratic, so only look up a sample */
+#define DEQUE_FILES_LOOKUPS 10000
+
+/* mallinfo2() arrived in glibc 2.33 */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAVE_MALLINFO2
+#endif
+
+static void file_path(int i, char* path, size_t size);
+static size_t heap_in_use(void);
+
+BENCH_MICRO(deque_files)
+{
+   struct deque* files = NULL;
+   struct deque_iterator* iter = NULL;
+   char path[MISC_LENGTH];
+   char checksum[65];
+   size_t before;
+   size_t after;
+   uint64_t total = 0;
+   double start;
+
+   before = heap_in_use();
+
+   if (pgmoneta_deque_create(false, &files))
+   {
+      goto error;
+   }
+
+   start = bench_now();
+   for (int i = 0; i < DEQUE_FILES_COUNT; i++)
+   {
+      /* 7919 is prime, so this visits every file once */
+      file_path((int)(((int64_t)i * 7919) % DEQUE_FILES_COUNT), &path[0], sizeof(path));
+      snprintf(&checksum[0], sizeof(checksum), "%064x", i);
+      if (pgmoneta_deque_add(files, &path[0], (uintptr_t)&checksum[0], ValueString))
+      {
+         goto error;
+      }
+   }
+   bench_record("add", bench_now() - start);
+
+   after = heap_in_use();
+#ifdef HAVE_MALLINFO2
+   bench_record_memory("heap" BENCH_MEMORY_SUFFIX, after > before ? after - before : 0);
+#else
+   (void)after;
+#endif
+
+   start = bench_now();
+   if (pgmoneta_deque_iterator_create(files, &iter))
+   {
+      goto error;
+   }
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      total += strlen((char*)pgmoneta_value_data(iter->value));
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+   bench_record("iterate", bench_now() - start);
+
+   if (total != (uint64_t)DEQUE_FILES_COUNT * 64)
+   {
+      goto error;
+   }
+
+   start = bench_now();
+   for (int i = 0; i < DEQUE_FILES_LOOKUPS; i++)
+   {
+      file_path((int)(((int64_t)i * 104729) % DEQUE_FILES_COUNT), &path[0], sizeof(path));
+      if (!pgmoneta_deque_exists(files, &path[0]))
+      {
+         goto error;
+      }
+   }
+   bench_record("exists", bench_now() - start);
+
+   start = bench_now();
+   for (int i = 0; i < DEQUE_FILES_LOOKUPS; i++)
+   {
+      file_path((int)(((int64_t)i * 104729) % DEQUE_FILES_COUNT), &path[0], sizeof(path));
+      if (pgmoneta_deque_get(files, &path[0]) == 0)
+      {
+         goto error;
+      }
+   }
+   bench_record("get", bench_now() - start);
+
+   start = bench_now();
+   pgmoneta_deque_sort(files, NULL);
+   bench_record("sort", bench_now() - start);
+
+   start = bench_now();
+   while (!pgmoneta_deque_empty(files))
+   {
+      char* tag = NULL;
+
+      free((char*)pgmoneta_deque_poll(files, &tag));
+      free(tag);
+   }
+   bench_record("poll", bench_now() - start);
+
+   pgmoneta_deque_destroy(files);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+
+   return 1;
+}
+
+/* Shaped like a relation segment under the data directory */
+static void
+file_path(int i, char* path, size_t size)
+{
+   snprintf(path, size, "base/16384/%d.%d", 16384 + i / 8, i % 8);
+}
+
+static size_t
+heap_in_use(void)
+{
+#ifdef HAVE_MALLINFO2
+   struct mallinfo2 mi = mallinfo2();
+
+   return mi.uordblks + mi.hblkhd;
+#else
+   return 0;
+#endif
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Loading the OID mappings of pgmoneta-walinfo from a large synthetic
+ * mappings file, which pgmoneta_read_mappings_from_json() parses into a
+ * memory arena.
+ *
+ * The mappings are written to a temporary file and read back. The phases are:
+ *
+ *   parse_heap     - pgmoneta_json_read_file() of the mappings
+ *   destroy_heap   - pgmoneta_json_destroy() on the heap document
+ *   parse_arena    - pgmoneta_json_read_file_arena() of the mappings
+ *   destroy_arena  - pgmoneta_json_destroy() on the arena document
+ *   load           - pgmoneta_read_mappings_from_json()
+ *   heap_mb        - heap held by the heap document
+ *   arena_mb       - heap held by the arena document
+ *
+ * No backend is needed, so this runs in process.
+ */
+
+/* bench */
+#include <bench.h>
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <json.h>
+#include <wal.h>
+
+/* system */
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* A cluster with a few hundred thousand relations is common */
+#define MAPPINGS_RELATIONS_COUNT 200000
+
+/* mallinfo2() arrived in glibc 2.33 */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAVE_MALLINFO2
+#endif
+
+/* The mappings are kept in globals of wal.c, which has no function to release them */
+extern oid_mapping* oidMappings;
+extern int mappings_size;
+
+static int write_mappings(char* path);
+static size_t heap_in_use(void);
+static int read_document(char* path, bool arena, const char* parse, const char* destroy, const char* memory);
+static int load(char* path);
+
+BENCH_MICRO(oid_mappings)
+{
+   char path[] = "/tmp/pgmoneta-bench-mappings-XXXXXX";
+
+   if (write_mappings(&path[0]))
+   {
+      goto error;
+   }
+
+   if (read_document(&path[0], false, "parse_heap", "destroy_heap", "heap" BENCH_MEMORY_SUFFIX) ||
+       read_document(&path[0], true, "parse_arena", "destroy_arena", "arena" BENCH_MEMORY_SUFFIX) ||
+       load(&path[0]))
+   {
+      goto error;
+   }
+
+   unlink(&path[0]);
+
+   return 0;
+
+error:
+
+   unlink(&path[0]);
+
+   return 1;
+}
+
+/* Shaped like the output of the mapping queries in the pgmoneta-walinfo manual */
+static int
+write_mappings(char* path)
+{
+   FILE* file = NULL;
+   int fd = -1;
+
+   fd = mkstemp(path);
+   if (fd == -1)
+   {
+      goto error;
+   }
+
+   file = fdopen(fd, "w");
+   if (file == NULL)
+   {
+      close(fd);
+      goto error;
+   }
+
+   fprintf(file, "{\"tablespaces\":[{\"pg_default\":\"1663\"},{\"pg_global\":\"1664\"}],"
+           "\"databases\":[{\"postgres\":\"5\"},{\"template1\":\"1\"},{\"template0\":\"4\"}],"
+           "\"relations\":[");
+
+   for (int i = 0; i < MAPPINGS_RELATIONS_COUNT; i++)
+   {
+      fprintf(file, "%s\n{\"schema_%d.relation_%d\":\"%d\"}", i == 0 ? "" : ",", i % 100, i, 16384 + i);
+   }
+
+   fprintf(file, "]}\n");
+
+   if (fclose(file))
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static size_t
+heap_in_use(void)
+{
+#ifdef HAVE_MALLINFO2
+   struct mallinfo2 mi = mallinfo2();
+
+   return mi.uordblks + mi.hblkhd;
+#else
+   return 0;
+#endif
+}
+
+static int
+read_document(char* path, bool arena, const char* parse, const char* destroy, const char* memory)
+{
+   struct json* mappings = NULL;
+   size_t before;
+   size_t after;
+   double start;
+
+   before = heap_in_use();
+   start = bench_now();
+
+   if ((arena ? pgmoneta_json_read_file_arena(path, &mappings) : pgmoneta_json_read_file(path, &mappings)) ||
+       pgmoneta_json_array_length((struct json*)pgmoneta_json_get(mappings, "relations")) != MAPPINGS_RELATIONS_COUNT)
+   {
+      goto error;
+   }
+
+   bench_record(parse, bench_now() - start);
+
+   after = heap_in_use();
+#ifdef HAVE_MALLINFO2
+   bench_record_memory(memory, after > before ? after - before : 0);
+#else
+   (void)memory;
+   (void)after;
+#endif
+
+   start = bench_now();
+   pgmoneta_json_destroy(mappings);
+   bench_record(destroy, bench_now() - start);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(mappings);
+
+   return 1;
+}
+
+static int
+load(char* path)
+{
+   double start;
+   int ret = 1;
+
+   start = bench_now();
+
+   if (pgmoneta_read_mappings_from_json(path) == 0 && mappings_size == MAPPINGS_RELATIONS_COUNT + 5)
+   {
+      bench_record("load", bench_now() - start);
+      ret = 0;
+   }
+
+   for (int i = 0; i < mappings_size; i++)
+   {
+      free(oidMappings[i].name);
+   }
+   free(oidMappings);
+   oidMappings = NULL;
+   mappings_size = 0;
+
+   return ret;
+}
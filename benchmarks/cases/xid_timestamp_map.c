@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Timestamp enrichment of a synthetic, commit-heavy WAL segment.
+ *
+ * The segment is modelled as the decoder sees it: every transaction writes
+ * a few data records and then commits, some with subtransactions. The
+ * phases are the map operations the decoder performs on it:
+ *
+ *   insert  - one put per commit, with its subtransactions
+ *   lookup  - one get per record, as walinfo does to print the timestamp
+ *   sorted  - one pass over the entries in XID order
+ *
+ * No backend is needed, so this runs in process.
+ */
+
+/* bench */
+#include <bench.h>
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <walfile/wal_reader.h>
+
+/* system */
+#include <stdlib.h>
+
+/* Roughly what a 16 MB segment of short transactions holds */
+#define TRANSACTIONS           100000
+#define RECORDS_PER_TRANSACTION     4
+#define MAX_SUBXACTS                3
+#define FIRST_XID                 1000
+
+BENCH_MICRO(xid_timestamp_map)
+{
+   struct xid_timestamp_map* map = NULL;
+   struct xid_timestamp_entry* entries = NULL;
+   transaction_id subxacts[MAX_SUBXACTS];
+   transaction_id xid = FIRST_XID;
+   transaction_id last_xid;
+   timestamp_tz ts = 0;
+   size_t count = 0;
+   double start;
+
+   if (pgmoneta_xid_timestamp_map_create(&map))
+   {
+      goto error;
+   }
+
+   start = bench_now();
+
+   for (int i = 0; i < TRANSACTIONS; i++)
+   {
+      transaction_id top = xid++;
+      int nsubxacts = i % (MAX_SUBXACTS + 1);
+
+      for (int s = 0; s < nsubxacts; s++)
+      {
+         subxacts[s] = xid++;
+      }
+
+      if (pgmoneta_xid_timestamp_map_put_all(map, top, &subxacts[0], nsubxacts, (timestamp_tz)i))
+      {
+         goto error;
+      }
+   }
+
+   bench_record("insert", bench_now() - start);
+
+   last_xid = xid;
+   start = bench_now();
+
+   /* Records of a transaction carry the top-level XID */
+   xid = FIRST_XID;
+   for (int i = 0; i < TRANSACTIONS; i++)
+   {
+      for (int r = 0; r < RECORDS_PER_TRANSACTION; r++)
+      {
+         if (pgmoneta_xid_timestamp_map_get(map, xid, &ts) || ts != (timestamp_tz)i)
+         {
+            goto error;
+         }
+      }
+
+      xid += 1 + i % (MAX_SUBXACTS + 1);
+   }
+
+   bench_record("lookup", bench_now() - start);
+
+   start = bench_now();
+
+   if (pgmoneta_xid_timestamp_map_sorted(map, &entries, &count) ||
+       count != (size_t)(last_xid - FIRST_XID))
+   {
+      goto error;
+   }
+
+   bench_record("sorted", bench_now() - start);
+
+   free(entries);
+   pgmoneta_xid_timestamp_map_destroy(map);
+
+   return 0;
+
+error:
+
+   free(entries);
+   pgmoneta_xid_timestamp_map_destroy(map);
+
+   return 1;
+}
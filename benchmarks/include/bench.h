@@ -45,6 +45,13 @@ extern "C" {
 #define BENCH_MAX_ITERATIONS    100
 #define BENCH_DEFAULT_ITERATIONS  5
 #define BENCH_NAME_LENGTH        64
+#define BENCH_MAX_PHASES         16
+
+/** The backend of a case that runs in process and times itself */
+#define BENCH_BACKEND_NONE       -1
+
+/** In-process phases with this suffix hold megabytes rather than milliseconds */
+#define BENCH_MEMORY_SUFFIX      "_mb"
 
 /** @struct bench_phase
  * Defines a measured phase
@@ -103,6 +110,41 @@ bench_register_case(const char* name, int backend, bench_func_t func);
    }                                                                    \
    static int name(void)
 
+/**
+ * Define and register an in-process benchmark case
+ *
+ * The body runs one iteration, measures its own phases with bench_now()
+ * and reports each with bench_record(). No backend is started and
+ * backup.info is not read.
+ *
+ * Usage: BENCH_MICRO(xid_timestamp_map) { ... }
+ */
+#define BENCH_MICRO(name) BENCH_CASE(name, BENCH_BACKEND_NONE)
+
+/**
+ * Get a monotonic clock reading
+ * @return The reading, in milliseconds
+ */
+double
+bench_now(void);
+
+/**
+ * Record a phase timing of the current iteration of an in-process case
+ * @param phase The phase name
+ * @param milliseconds The elapsed time, in milliseconds
+ */
+void
+bench_record(const char* phase, double milliseconds);
+
+/**
+ * Record a memory figure of the current iteration of an in-process case.
+ * Results and compare tell it from a timing by its name
+ * @param phase The phase name, ending in BENCH_MEMORY_SUFFIX
+ * @param bytes The number of bytes
+ */
+void
+bench_record_memory(const char* phase, size_t bytes);
+
 /**
  * Run the cases and write a result per case
  * @param filter The case name, or NULL for all
@@ -141,13 +183,15 @@ bench_list(void);
  * @param branch The branch
  * @param commit The commit
  * @param iterations The number of iterations
+ * @param phases The phase names
+ * @param number_of_phases The number of phases
  * @param samples The samples, indexed [phase * iterations + iteration]
  * @return BENCH_OK upon success, otherwise BENCH_FAIL
  */
 int
 bench_report_write(const char* results_dir, const char* case_name,
                    const char* branch, const char* commit, int iterations,
-                   double* samples);
+                   const char** phases, int number_of_phases, double* samples);
 
 #ifdef __cplusplus
 }
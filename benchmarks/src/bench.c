@@ -43,6 +43,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* Recorded by pgmoneta on every backup; remote_* runs against an emulated
  * backend, so it is reported but never treated as signal.
@@ -71,14 +72,26 @@ struct bench_case
    bench_func_t func;
 };
 
+struct bench_record
+{
+   char name[BENCH_NAME_LENGTH];
+   double value;
+};
+
 static struct bench_case cases[BENCH_MAX_CASES];
 static int number_of_cases = 0;
 
+/* The phases an in-process case reported for the running iteration */
+static struct bench_record records[BENCH_MAX_PHASES];
+static int number_of_records = 0;
+
 static int newest_backup_label(const char* server, char* out, size_t size);
 static int collect(const char* server, double* out, char* label_out, size_t label_size);
 static int compare_double(const void* a, const void* b);
 static int run_case(struct bench_case* c, int iterations, const char* branch,
                     const char* commit, const char* results_dir);
+static int run_micro_case(struct bench_case* c, int iterations, const char* branch,
+                          const char* commit, const char* results_dir);
 
 void
 bench_register_case(const char* name, int backend, bench_func_t func)
@@ -108,10 +121,62 @@ bench_list(void)
 
    for (int i = 0; i < number_of_cases; i++)
    {
-      printf("  %s\n", cases[i].name);
+      printf("  %s%s\n", cases[i].name,
+             cases[i].backend == BENCH_BACKEND_NONE ? " (in-process)" : "");
    }
 }
 
+double
+bench_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+void
+bench_record(const char* phase, double milliseconds)
+{
+   for (int i = 0; i < number_of_records; i++)
+   {
+      if (!strcmp(records[i].name, phase))
+      {
+         records[i].value += milliseconds;
+         return;
+      }
+   }
+
+   if (number_of_records >= BENCH_MAX_PHASES)
+   {
+      fprintf(stderr, "bench: too many phases, ignoring %s\n", phase);
+      return;
+   }
+
+   if (strlen(phase) >= BENCH_NAME_LENGTH)
+   {
+      fprintf(stderr, "bench: phase name too long: %s\n", phase);
+      return;
+   }
+
+   pgmoneta_snprintf(records[number_of_records].name, BENCH_NAME_LENGTH, "%s", phase);
+   records[number_of_records].value = milliseconds;
+   number_of_records++;
+}
+
+void
+bench_record_memory(const char* phase, size_t bytes)
+{
+   if (!pgmoneta_ends_with((char*)phase, BENCH_MEMORY_SUFFIX))
+   {
+      fprintf(stderr, "bench: memory phase %s must end in %s\n", phase, BENCH_MEMORY_SUFFIX);
+      return;
+   }
+
+   bench_record(phase, (double)bytes / (1024.0 * 1024.0));
+}
+
 int
 bench_run(const char* filter, int iterations, const char* branch,
           const char* commit, const char* results_dir)
@@ -160,12 +225,18 @@ run_case(struct bench_case* c, int iterations, const char* branch,
          const char* commit, const char* results_dir)
 {
    int np = bench_number_of_phases();
+   const char** names = NULL;
    double* samples = NULL;
    double* values = NULL;
    int rc = BENCH_FAIL;
    int up = 0;
    char previous_label[MISC_LENGTH];
 
+   if (c->backend == BENCH_BACKEND_NONE)
+   {
+      return run_micro_case(c, iterations, branch, commit, results_dir);
+   }
+
    memset(&previous_label[0], 0, sizeof(previous_label));
 
    printf("\ncase: %s (%d iterations)\n", c->name, iterations);
@@ -174,11 +245,17 @@ run_case(struct bench_case* c, int iterations, const char* branch,
    /* Indexed [phase * iterations + iteration] */
    samples = (double*)calloc((size_t)np * iterations, sizeof(double));
    values = (double*)calloc((size_t)np, sizeof(double));
-   if (samples == NULL || values == NULL)
+   names = (const char**)calloc((size_t)np, sizeof(const char*));
+   if (samples == NULL || values == NULL || names == NULL)
    {
       goto error;
    }
 
+   for (int p = 0; p < np; p++)
+   {
+      names[p] = bench_phases[p].name;
+   }
+
    up = mctf_se_up(c->backend);
    if (up == MCTF_SKIPPED)
    {
@@ -249,7 +326,8 @@ run_case(struct bench_case* c, int iterations, const char* branch,
       }
    }
 
-   if (bench_report_write(results_dir, c->name, branch, commit, iterations, samples) != BENCH_OK)
+   if (bench_report_write(results_dir, c->name, branch, commit, iterations,
+                          names, np, samples) != BENCH_OK)
    {
       fprintf(stderr, "  failed: could not write result\n");
       goto error;
@@ -269,12 +347,109 @@ done:
       mctf_se_down();
    }
 
+   free(names);
    free(samples);
    free(values);
 
    return rc;
 }
 
+/* The phases are whatever the first measured iteration records */
+static int
+run_micro_case(struct bench_case* c, int iterations, const char* branch,
+               const char* commit, const char* results_dir)
+{
+   const char* names[BENCH_MAX_PHASES];
+   char phases[BENCH_MAX_PHASES][BENCH_NAME_LENGTH];
+   int np = 0;
+   double* samples = NULL;
+
+   printf("\ncase: %s (%d iterations, in-process)\n", c->name, iterations);
+   fflush(stdout);
+
+   /* Indexed [phase * iterations + iteration] */
+   samples = (double*)calloc((size_t)BENCH_MAX_PHASES * iterations, sizeof(double));
+   if (samples == NULL)
+   {
+      goto error;
+   }
+
+   /* Unmeasured: the first run pays for page faults on fresh allocations */
+   printf("  warmup ...\n");
+   fflush(stdout);
+   number_of_records = 0;
+   if (c->func() != 0)
+   {
+      fprintf(stderr, "  failed: warmup iteration failed\n");
+      goto error;
+   }
+
+   for (int i = 0; i < iterations; i++)
+   {
+      printf("  iteration %d/%d ...\n", i + 1, iterations);
+      fflush(stdout);
+
+      number_of_records = 0;
+      if (c->func() != 0)
+      {
+         fprintf(stderr, "  failed: iteration %d failed\n", i + 1);
+         goto error;
+      }
+
+      if (number_of_records == 0)
+      {
+         fprintf(stderr, "  failed: iteration %d recorded no phase\n", i + 1);
+         goto error;
+      }
+
+      if (i == 0)
+      {
+         for (int r = 0; r < number_of_records; r++)
+         {
+            pgmoneta_snprintf(phases[r], BENCH_NAME_LENGTH, "%s", records[r].name);
+            names[r] = phases[r];
+         }
+         np = number_of_records;
+      }
+
+      for (int r = 0; r < number_of_records; r++)
+      {
+         int p = 0;
+
+         while (p < np && strcmp(phases[p], records[r].name))
+         {
+            p++;
+         }
+
+         if (p == np)
+         {
+            fprintf(stderr, "  failed: iteration %d recorded unknown phase %s\n",
+                    i + 1, records[r].name);
+            goto error;
+         }
+
+         samples[p * iterations + i] = records[r].value;
+      }
+   }
+
+   if (bench_report_write(results_dir, c->name, branch, commit, iterations,
+                          names, np, samples) != BENCH_OK)
+   {
+      fprintf(stderr, "  failed: could not write result\n");
+      goto error;
+   }
+
+   free(samples);
+
+   return BENCH_OK;
+
+error:
+
+   free(samples);
+
+   return BENCH_FAIL;
+}
+
 /* Read the timings of the newest backup into out, in milliseconds */
 static int
 collect(const char* server, double* out, char* label_out, size_t label_size)
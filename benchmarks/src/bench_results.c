@@ -56,15 +56,20 @@ static int cores(void);
 static int newest_result(const char* results_dir, const char* branch,
                          const char* case_name, char* out, size_t size);
 static double phase_of(struct json* obj, const char* phase, bool* present);
-static void classify(double base, double cand, char* out, size_t size);
+static void classify(double base, double cand, bool memory, char* out, size_t size);
 static int render(struct json* base, struct json* cand, bool emulated);
+static void render_row(struct json* bm, struct json* cm, const char* phase, bool emulated, int* rows);
+static int format_ms(double value, char* out, size_t size);
+static int format_mb(double value, char* out, size_t size);
+static bool known_phase(const char* phase);
+static bool memory_phase(const char* phase);
 static const char* string_of(struct json* obj, const char* key);
 
 /* Writes <results_dir>/<branch>/<case>.<timestamp>.json */
 int
 bench_report_write(const char* results_dir, const char* case_name,
                    const char* branch, const char* commit, int iterations,
-                   double* samples)
+                   const char** phases, int number_of_phases, double* samples)
 {
    char branch_dir[MAX_PATH];
    char path[MAX_PATH];
@@ -102,7 +107,7 @@ bench_report_write(const char* results_dir, const char* case_name,
       goto error;
    }
 
-   for (int p = 0; bench_phases[p].name != NULL; p++)
+   for (int p = 0; p < number_of_phases; p++)
    {
       double m = bench_median(&samples[p * iterations], iterations);
 
@@ -112,7 +117,7 @@ bench_report_write(const char* results_dir, const char* case_name,
        */
       if (m > 0.0)
       {
-         pgmoneta_json_put(median, (char*)bench_phases[p].name,
+         pgmoneta_json_put(median, (char*)phases[p],
                            pgmoneta_value_from_double(m), ValueDouble);
       }
    }
@@ -233,6 +238,8 @@ render(struct json* base, struct json* cand, bool emulated)
 {
    struct json* bm = (struct json*)pgmoneta_json_get(base, "median");
    struct json* cm = (struct json*)pgmoneta_json_get(cand, "median");
+   struct json* medians[2];
+   struct json_iterator* iter = NULL;
    int rows = 0;
 
    if (bm == NULL || cm == NULL)
@@ -242,55 +249,141 @@ render(struct json* base, struct json* cand, bool emulated)
 
    for (int p = 0; bench_phases[p].name != NULL; p++)
    {
-      bool in_base = false;
-      bool in_cand = false;
-      double b;
-      double c;
-      char bs[24];
-      char cs[24];
-      char change[32];
-
       if (bench_phases[p].emulated != emulated)
       {
          continue;
       }
 
-      b = phase_of(bm, bench_phases[p].name, &in_base);
-      c = phase_of(cm, bench_phases[p].name, &in_cand);
+      render_row(bm, cm, bench_phases[p].name, emulated, &rows);
+   }
+
+   if (emulated)
+   {
+      return rows;
+   }
 
-      if (!in_base && !in_cand)
+   /*
+    * In-process cases name their own phases. Show the baseline's, in key
+    * order, then any the candidate added.
+    */
+   medians[0] = bm;
+   medians[1] = cm;
+
+   for (int m = 0; m < 2; m++)
+   {
+      if (pgmoneta_json_iterator_create(medians[m], &iter))
       {
-         continue;
+         break;
       }
 
-      if (rows == 0)
+      while (pgmoneta_json_iterator_next(iter))
       {
-         printf("\n%-20s  %12s  %12s  %s\n",
-                emulated ? "phase (emulated)" : "phase", "baseline", "candidate", "change");
-         printf("--------------------  ------------  ------------  ------------\n");
+         if (known_phase(iter->key) || (m == 1 && pgmoneta_json_contains_key(bm, iter->key)))
+         {
+            continue;
+         }
+
+         render_row(bm, cm, iter->key, emulated, &rows);
       }
-      rows++;
 
-      in_base ? pgmoneta_snprintf(&bs[0], sizeof(bs), "%.0fms", b) : pgmoneta_snprintf(&bs[0], sizeof(bs), "-");
-      in_cand ? pgmoneta_snprintf(&cs[0], sizeof(cs), "%.0fms", c) : pgmoneta_snprintf(&cs[0], sizeof(cs), "-");
+      pgmoneta_json_iterator_destroy(iter);
+      iter = NULL;
+   }
 
-      if (in_base && in_cand)
-      {
-         classify(b, c, &change[0], sizeof(change));
-      }
-      else
+   return rows;
+}
+
+static void
+render_row(struct json* bm, struct json* cm, const char* phase, bool emulated, int* rows)
+{
+   bool in_base = false;
+   bool in_cand = false;
+   bool memory = memory_phase(phase);
+   double b;
+   double c;
+   char bs[24];
+   char cs[24];
+   char change[32];
+
+   b = phase_of(bm, phase, &in_base);
+   c = phase_of(cm, phase, &in_cand);
+
+   if (!in_base && !in_cand)
+   {
+      return;
+   }
+
+   if (*rows == 0)
+   {
+      printf("\n%-20s  %12s  %12s  %s\n",
+             emulated ? "phase (emulated)" : "phase", "baseline", "candidate", "change");
+      printf("--------------------  ------------  ------------  ------------\n");
+   }
+   (*rows)++;
+
+   if (memory)
+   {
+      in_base ? format_mb(b, &bs[0], sizeof(bs)) : pgmoneta_snprintf(&bs[0], sizeof(bs), "-");
+      in_cand ? format_mb(c, &cs[0], sizeof(cs)) : pgmoneta_snprintf(&cs[0], sizeof(cs), "-");
+   }
+   else
+   {
+      in_base ? format_ms(b, &bs[0], sizeof(bs)) : pgmoneta_snprintf(&bs[0], sizeof(bs), "-");
+      in_cand ? format_ms(c, &cs[0], sizeof(cs)) : pgmoneta_snprintf(&cs[0], sizeof(cs), "-");
+   }
+
+   if (in_base && in_cand)
+   {
+      classify(b, c, memory, &change[0], sizeof(change));
+   }
+   else
+   {
+      pgmoneta_snprintf(&change[0], sizeof(change), "n/a");
+   }
+
+   printf("%-20s  %12s  %12s  %s\n", phase, &bs[0], &cs[0], &change[0]);
+}
+
+/* In-process phases are often below a millisecond */
+static int
+format_ms(double value, char* out, size_t size)
+{
+   if (value < 10.0)
+   {
+      return pgmoneta_snprintf(out, size, "%.3fms", value);
+   }
+
+   return pgmoneta_snprintf(out, size, "%.0fms", value);
+}
+
+static int
+format_mb(double value, char* out, size_t size)
+{
+   return pgmoneta_snprintf(out, size, "%.1fMB", value);
+}
+
+static bool
+known_phase(const char* phase)
+{
+   for (int p = 0; bench_phases[p].name != NULL; p++)
+   {
+      if (!strcmp(bench_phases[p].name, phase))
       {
-         pgmoneta_snprintf(&change[0], sizeof(change), "n/a");
+         return true;
       }
-
-      printf("%-20s  %12s  %12s  %s\n", bench_phases[p].name, &bs[0], &cs[0], &change[0]);
    }
 
-   return rows;
+   return false;
+}
+
+static bool
+memory_phase(const char* phase)
+{
+   return pgmoneta_ends_with((char*)phase, BENCH_MEMORY_SUFFIX);
 }
 
 static void
-classify(double base, double cand, char* out, size_t size)
+classify(double base, double cand, bool memory, char* out, size_t size)
 {
    double delta;
    double ratio;
@@ -313,11 +406,11 @@ classify(double base, double cand, char* out, size_t size)
 
    if (ratio > 1.0)
    {
-      pgmoneta_snprintf(out, size, "%.2fx faster", ratio);
+      pgmoneta_snprintf(out, size, memory ? "%.2fx smaller" : "%.2fx faster", ratio);
    }
    else
    {
-      pgmoneta_snprintf(out, size, "%.2fx slower", 1.0 / ratio);
+      pgmoneta_snprintf(out, size, memory ? "%.2fx larger" : "%.2fx slower", 1.0 / ratio);
    }
 }
 
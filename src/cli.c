@@ -150,6 +150,16 @@ static int conf_ls(SSL* ssl, int socket, uint8_t compression, uint8_t encryption
 static int conf_get(SSL* ssl, int socket, char* config_key, uint8_t compression, uint8_t encryption, int32_t output_format);
 static int conf_set(SSL* ssl, int socket, char* config_key, char* config_value, uint8_t compression, uint8_t encryption, int32_t output_format);
 
+/**
+ * The state of a response printed frame by frame
+ */
+struct print_state
+{
+   int32_t command; /**< The command of the response */
+   bool status;     /**< The status of the outcome */
+   char* key;       /**< The key of the array printed last */
+};
+
 static int process_result(SSL* ssl, int socket, int32_t output_format);
 static int process_get_result(SSL* ssl, int socket, char* param, int32_t output_format);
 static int process_set_result(SSL* ssl, int socket, char* config_key, int32_t output_format);
@@ -174,6 +184,8 @@ static void translate_response_argument(struct json* j);
 static void translate_servers_argument(struct json* j);
 static void translate_server_retention_argument(struct json* j, char* tag);
 static void translate_json_object(struct json* j);
+static void translate_json_array(int32_t command, char* key, struct json* array);
+static int print_frame(struct json* frame, bool first, void* data);
 
 static void
 version(void)
@@ -1127,7 +1139,7 @@ static void
 help_backup(void)
 {
    printf("Backup a server\n");
-   printf("  pgmoneta-cli backup <server> [identifier]\n");
+   printf("  pgmoneta-cli backup <server> [identifier|latest|auto]\n");
 }
 
 static void
@@ -2045,6 +2057,22 @@ static int
 process_result(SSL* ssl, int socket, int32_t output_format)
 {
    struct json* read = NULL;
+   struct print_state state;
+
+   if (MANAGEMENT_OUTPUT_FORMAT_TEXT == output_format)
+   {
+      memset(&state, 0, sizeof(struct print_state));
+
+      if (pgmoneta_management_read_frames(ssl, socket, NULL, NULL, print_frame, &state))
+      {
+         free(state.key);
+         goto error;
+      }
+
+      free(state.key);
+
+      return 0;
+   }
 
    if (pgmoneta_management_read_json(ssl, socket, NULL, NULL, &read))
    {
@@ -3236,12 +3264,6 @@ translate_json_object(struct json* j)
    struct json* response = NULL;
    struct json* outcome = NULL;
 
-   struct json* backups = NULL;
-   struct json* backup = NULL;
-   struct json* servers = NULL;
-   struct json_iterator* server_it = NULL;
-   struct json_iterator* backup_it = NULL;
-
    // Translate arguments of header
    header = (struct json*)pgmoneta_json_get(j, MANAGEMENT_CATEGORY_HEADER);
 
@@ -3302,56 +3324,18 @@ translate_json_object(struct json* j)
                translate_backup_argument(response);
                break;
             case MANAGEMENT_STATUS:
+            case MANAGEMENT_S3_LS:
+            case MANAGEMENT_STATUS_DETAILS:
                translate_response_argument(response);
-               servers = (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_SERVERS);
-               pgmoneta_json_iterator_create(servers, &server_it);
-               while (pgmoneta_json_iterator_next(server_it))
-               {
-                  translate_servers_argument((struct json*)pgmoneta_value_data(server_it->value));
-               }
-               pgmoneta_json_iterator_destroy(server_it);
+               translate_json_array(command, MANAGEMENT_ARGUMENT_SERVERS,
+                                    (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_SERVERS));
                break;
             case MANAGEMENT_LIST_BACKUP:
-               backups = (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_BACKUPS);
-               pgmoneta_json_iterator_create(backups, &backup_it);
-               while (pgmoneta_json_iterator_next(backup_it))
-               {
-                  backup = (struct json*)pgmoneta_value_data(backup_it->value);
-                  translate_backup_argument(backup);
-               }
-               pgmoneta_json_iterator_destroy(backup_it);
-               break;
-            case MANAGEMENT_S3_LS:
-               translate_response_argument(response);
-               servers = (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_SERVERS);
-               pgmoneta_json_iterator_create(servers, &server_it);
-               while (pgmoneta_json_iterator_next(server_it))
-               {
-                  translate_servers_argument((struct json*)pgmoneta_value_data(server_it->value));
-               }
-               pgmoneta_json_iterator_destroy(server_it);
+               translate_json_array(command, MANAGEMENT_ARGUMENT_BACKUPS,
+                                    (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_BACKUPS));
                break;
             case MANAGEMENT_S3_RESTORE:
                break;
-            case MANAGEMENT_STATUS_DETAILS:
-               translate_response_argument(response);
-               servers = (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_SERVERS);
-               pgmoneta_json_iterator_create(servers, &server_it);
-               while (pgmoneta_json_iterator_next(server_it))
-               {
-                  backups = (struct json*)pgmoneta_json_get((struct json*)pgmoneta_value_data(server_it->value), MANAGEMENT_ARGUMENT_BACKUPS);
-                  pgmoneta_json_iterator_create(backups, &backup_it);
-                  while (pgmoneta_json_iterator_next(backup_it))
-                  {
-                     backup = (struct json*)pgmoneta_value_data(backup_it->value);
-                     translate_backup_argument(backup);
-                  }
-                  pgmoneta_json_iterator_destroy(backup_it);
-
-                  translate_servers_argument((struct json*)pgmoneta_value_data(server_it->value));
-               }
-               pgmoneta_json_iterator_destroy(server_it);
-               break;
             case MANAGEMENT_CONF_GET:
                translate_configuration(response);
                break;
@@ -3365,3 +3349,108 @@ translate_json_object(struct json* j)
       }
    }
 }
+
+static void
+translate_json_array(int32_t command, char* key, struct json* array)
+{
+   struct json* item = NULL;
+   struct json_iterator* item_it = NULL;
+   struct json_iterator* backup_it = NULL;
+
+   if (pgmoneta_json_iterator_create(array, &item_it))
+   {
+      return;
+   }
+
+   while (pgmoneta_json_iterator_next(item_it))
+   {
+      item = (struct json*)pgmoneta_value_data(item_it->value);
+
+      switch (command)
+      {
+         case MANAGEMENT_LIST_BACKUP:
+            if (pgmoneta_compare_string(key, MANAGEMENT_ARGUMENT_BACKUPS))
+            {
+               translate_backup_argument(item);
+            }
+            break;
+         case MANAGEMENT_STATUS:
+         case MANAGEMENT_S3_LS:
+            if (pgmoneta_compare_string(key, MANAGEMENT_ARGUMENT_SERVERS))
+            {
+               translate_servers_argument(item);
+            }
+            break;
+         case MANAGEMENT_STATUS_DETAILS:
+            if (pgmoneta_compare_string(key, MANAGEMENT_ARGUMENT_SERVERS))
+            {
+               pgmoneta_json_iterator_create((struct json*)pgmoneta_json_get(item, MANAGEMENT_ARGUMENT_BACKUPS), &backup_it);
+               while (pgmoneta_json_iterator_next(backup_it))
+               {
+                  translate_backup_argument((struct json*)pgmoneta_value_data(backup_it->value));
+               }
+               pgmoneta_json_iterator_destroy(backup_it);
+               backup_it = NULL;
+
+               translate_servers_argument(item);
+            }
+            break;
+         default:
+            break;
+      }
+   }
+
+   pgmoneta_json_iterator_destroy(item_it);
+}
+
+static int
+print_frame(struct json* frame, bool first, void* data)
+{
+   struct print_state* state = (struct print_state*)data;
+   struct json* array = NULL;
+   struct json_iterator* iter = NULL;
+   char* str = NULL;
+
+   if (first)
+   {
+      state->command = (int32_t)pgmoneta_json_get((struct json*)pgmoneta_json_get(frame, MANAGEMENT_CATEGORY_HEADER), MANAGEMENT_ARGUMENT_COMMAND);
+      state->status = (bool)pgmoneta_json_get((struct json*)pgmoneta_json_get(frame, MANAGEMENT_CATEGORY_OUTCOME), MANAGEMENT_ARGUMENT_STATUS);
+
+      translate_json_object(frame);
+      pgmoneta_json_print(frame, FORMAT_TEXT);
+   }
+   else if (pgmoneta_json_iterator_create(frame, &iter) == 0)
+   {
+      // The items of an array of the response, printed under the response
+      while (pgmoneta_json_iterator_next(iter))
+      {
+         array = (struct json*)pgmoneta_value_data(iter->value);
+
+         if (state->status)
+         {
+            translate_json_array(state->command, iter->key, array);
+         }
+
+         if (state->key == NULL || !pgmoneta_compare_string(state->key, iter->key))
+         {
+            free(state->key);
+            state->key = pgmoneta_append(NULL, iter->key);
+
+            str = pgmoneta_indent(NULL, iter->key, INDENT_PER_LEVEL);
+            printf("%s:\n", str);
+            free(str);
+         }
+
+         str = pgmoneta_json_to_string(array, FORMAT_TEXT, NULL, 2 * INDENT_PER_LEVEL);
+         printf("%s\n", str);
+         free(str);
+      }
+      pgmoneta_json_iterator_destroy(iter);
+   }
+
+   fflush(stdout);
+
+   pgmoneta_json_destroy(frame);
+
+   return 0;
+}
@@ -38,19 +38,37 @@ extern "C" {
 
 #include <stdint.h>
 
-#define MAX_PREFIX_LEN 10
+#define MAX_PREFIX_LEN 32
 
 typedef int (*art_callback)(void* data, char* key, struct value* value);
 
 typedef void (*value_destroy_callback)(void* value);
 
+/** @struct art_pool
+ * A pool of inner nodes of one size. Heap trees carve their nodes out of
+ * slabs that grow geometrically, arena trees take them from the arena.
+ * Released nodes are kept on a free list for reuse
+ */
+struct art_pool
+{
+   void** slabs;        /**< The slabs */
+   uint32_t num_slabs;  /**< The number of slabs */
+   uint32_t max_slabs;  /**< The capacity of the slabs array */
+   uint32_t slab_nodes; /**< The number of nodes in the next slab */
+   char* next;          /**< The next unused node in the current slab */
+   char* end;           /**< The end of the current slab */
+   void* free;          /**< The released nodes */
+};
+
 /** @struct art
  * The ART tree
  */
 struct art
 {
-   struct art_node* root; /**< The root node of ART */
-   uint64_t size;         /**< The size of the ART */
+   struct art_node* root;      /**< The root node of ART */
+   uint64_t size;              /**< The size of the ART */
+   struct memory_arena* arena; /**< The arena nodes are allocated from, or NULL for the heap */
+   struct art_pool pools[4];   /**< The node pools, one per node type */
 };
 
 /** @struct art_iterator
@@ -73,6 +91,17 @@ struct art_iterator
 int
 pgmoneta_art_create(struct art** tree);
 
+/**
+ * Initializes an adaptive radix tree whose nodes, keys and values are
+ * allocated from an arena. The tree is released together with the arena,
+ * so pgmoneta_art_destroy() is a no-op for it
+ * @param arena The arena, or NULL for the heap
+ * @param tree [out] The tree
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_art_create_with_arena(struct memory_arena* arena, struct art** tree);
+
 /**
  * inserts a new value into the art tree,note that the key is copied while the value is sometimes not(depending on value type)
  * @param t The tree
@@ -95,6 +124,21 @@ pgmoneta_art_insert(struct art* t, char* key, uintptr_t value, enum value_type t
 int
 pgmoneta_art_insert_with_config(struct art* t, char* key, uintptr_t value, struct value_config* config);
 
+/**
+ * Loads keys into an empty ART tree. Keys sorted in strcmp() order are
+ * built bottom-up without any node growth or prefix splits; a later
+ * duplicate replaces an earlier one. Unsorted keys, or a tree that is
+ * not empty, fall back to one insert per key
+ * @param t The tree
+ * @param keys The keys
+ * @param values The value data, one per key
+ * @param type The value type
+ * @param count The number of keys
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_art_bulk_load(struct art* t, char** keys, uintptr_t* values, enum value_type type, int count);
+
 /**
  * Check if a key exists in the ART tree
  * @param t The tree
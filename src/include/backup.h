@@ -81,6 +81,14 @@ pgmoneta_delete_backup(int client_fd, int srv, uint8_t compression, uint8_t encr
 int
 pgmoneta_get_max_rate(int server);
 
+/**
+ * Get the number of connections of a full backup for a server
+ * @param server The server
+ * @return The number of connections, 0 for BASE_BACKUP
+ */
+int
+pgmoneta_get_backup_connections(int server);
+
 /**
  * Is the backup valid ?
  * @param server The server
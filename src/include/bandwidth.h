@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_BANDWIDTH_H
+#define PGMONETA_BANDWIDTH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* system */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BANDWIDTH_WAL             0 /**< WAL streaming */
+#define BANDWIDTH_BACKUP          1 /**< Receiving a backup */
+#define BANDWIDTH_RESTORE         2 /**< Restoring a backup */
+#define BANDWIDTH_TRANSFER        3 /**< Storage engine uploads */
+#define BANDWIDTH_ARCHIVE         4 /**< Archiving a backup */
+#define BANDWIDTH_OPERATIONS      5 /**< The number of operation types */
+
+#define BANDWIDTH_WEIGHT_WAL      8 /**< The share of WAL streaming within a server */
+#define BANDWIDTH_WEIGHT_BACKUP   2 /**< The share of backups within a server */
+#define BANDWIDTH_WEIGHT_RESTORE  4 /**< The share of restores within a server */
+#define BANDWIDTH_WEIGHT_TRANSFER 1 /**< The share of storage engine uploads within a server */
+#define BANDWIDTH_WEIGHT_ARCHIVE  1 /**< The share of archives within a server */
+
+/** @struct bandwidth_bucket
+ * Defines a token bucket, in bytes
+ */
+struct bandwidth_bucket
+{
+   double tokens; /**< The tokens, negative when in debt */
+   int64_t last;  /**< The time of the last refill in nanoseconds */
+};
+
+/** @struct bandwidth_class
+ * Defines the bandwidth of an operation type on a server
+ */
+struct bandwidth_class
+{
+   struct bandwidth_bucket assured; /**< The assured share of the server */
+   atomic_llong last_active;        /**< The time of the last transfer in nanoseconds */
+   atomic_ullong bytes;             /**< The bytes transferred */
+   atomic_ullong throttled;         /**< The time spent waiting in nanoseconds */
+};
+
+/** @struct bandwidth_server
+ * Defines the bandwidth of a server
+ */
+struct bandwidth_server
+{
+   struct bandwidth_bucket assured;                          /**< The assured share of the global limit */
+   struct bandwidth_bucket ceil;                             /**< The limit of the server */
+   struct bandwidth_class operations[BANDWIDTH_OPERATIONS]; /**< The operation types */
+};
+
+/** @struct bandwidth
+ * Defines the global bandwidth
+ */
+struct bandwidth
+{
+   atomic_schar lock;              /**< The lock of all the buckets */
+   struct bandwidth_bucket bucket; /**< The global limit */
+};
+
+/**
+ * Start to account the transfers of this thread to an operation on a server.
+ * Calls nest, so a backup can account its upload separately. Worker threads
+ * without an operation of their own use the outermost one of the process
+ * @param server The server
+ * @param operation The operation type (BANDWIDTH_*)
+ */
+void
+pgmoneta_bandwidth_begin(int server, int operation);
+
+/**
+ * Stop accounting to the operation of the last pgmoneta_bandwidth_begin()
+ */
+void
+pgmoneta_bandwidth_end(void);
+
+/**
+ * Account a transfer of this thread, waiting for bandwidth when a limit
+ * is reached. Small transfers are batched before they reach the scheduler.
+ * This is a no-op outside of pgmoneta_bandwidth_begin()
+ * @param bytes The number of bytes
+ */
+void
+pgmoneta_bandwidth_consume(size_t bytes);
+
+/**
+ * Account a transfer to an operation on a server, waiting for bandwidth
+ * when a limit is reached
+ * @param server The server
+ * @param operation The operation type (BANDWIDTH_*)
+ * @param bytes The number of bytes
+ */
+void
+pgmoneta_bandwidth_acquire(int server, int operation, size_t bytes);
+
+/**
+ * Get the name of an operation type
+ * @param operation The operation type (BANDWIDTH_*)
+ * @return The name
+ */
+char*
+pgmoneta_bandwidth_operation_name(int operation);
+
+/**
+ * Get the rates of an operation on a server in bytes per second, 0 meaning unlimited
+ * @param server The server
+ * @param operation The operation type (BANDWIDTH_*)
+ * @param now The time in nanoseconds
+ * @param global [out] The global limit
+ * @param assured [out] The weighted share of the global limit among the active servers
+ * @param ceiling [out] The limit of the server, or the global limit
+ * @param share [out] The weighted share of the server among its active operations
+ */
+void
+pgmoneta_bandwidth_rates(int server, int operation, int64_t now,
+                         double* global, double* assured, double* ceiling, double* share);
+
+/**
+ * Add the tokens earned since the last refill to a bucket, up to 100 ms worth
+ * @param bucket The bucket
+ * @param rate The rate in bytes per second, 0 meaning unlimited
+ * @param now The time in nanoseconds
+ */
+void
+pgmoneta_bandwidth_bucket_refill(struct bandwidth_bucket* bucket, double rate, int64_t now);
+
+/**
+ * Is a bucket out of debt
+ * @param bucket The bucket
+ * @param rate The rate in bytes per second, 0 meaning unlimited
+ * @return True if a transfer may start
+ */
+bool
+pgmoneta_bandwidth_bucket_ready(struct bandwidth_bucket* bucket, double rate);
+
+/**
+ * Take a transfer from a bucket, which may put it in debt
+ * @param bucket The bucket
+ * @param rate The rate in bytes per second, 0 meaning unlimited
+ * @param bytes The number of bytes
+ */
+void
+pgmoneta_bandwidth_bucket_take(struct bandwidth_bucket* bucket, double rate, size_t bytes);
+
+/**
+ * Get the time until a bucket is out of debt
+ * @param bucket The bucket
+ * @param rate The rate in bytes per second, 0 meaning unlimited
+ * @return The time in nanoseconds
+ */
+int64_t
+pgmoneta_bandwidth_bucket_wait(struct bandwidth_bucket* bucket, double rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
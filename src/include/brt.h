@@ -63,6 +63,8 @@
 #define MAX_ENTRIES_PER_CHUNK     (BLOCKS_PER_CHUNK / BLOCKS_PER_ENTRY)
 #define INITIAL_ENTRIES_PER_CHUNK 16
 #define BLOCKS_PER_READ           512
+#define BRT_WORDS_PER_CHUNK       (BLOCKS_PER_CHUNK / 64)
+#define BRT_KEY_LENGTH            32
 /* Magic number for serialization file format. */
 #define BLOCKREFTABLE_MAGIC 0x652b137b
 
@@ -122,6 +124,15 @@ typedef struct block_ref_table
    struct art* table; /**< The ART (Adaptive Radix Tree) used to store the block reference table entries */
 } block_ref_table;
 
+/**
+ * A run of modified blocks
+ */
+typedef struct block_ref_table_range
+{
+   block_number start; /**< The first block of the run */
+   uint32_t length;    /**< The number of blocks in the run */
+} block_ref_table_range;
+
 /**
  * On-disk serialization format for block reference table entries.
  */
@@ -233,6 +244,39 @@ pgmoneta_brt_entry_get_blocks(block_ref_table_entry* entry, block_number start_b
 int
 pgmoneta_brt_destroy(block_ref_table* brt);
 
+/**
+ * Get the number of modified blocks of a block entry
+ * @param entry The block entry
+ * @return The number of modified blocks
+ */
+uint64_t
+pgmoneta_brt_entry_cardinality(block_ref_table_entry* entry);
+
+/**
+ * Get the runs of modified blocks of a block entry in the range [start_blkno, stop_blkno),
+ * in block order with adjacent runs joined
+ * @param entry The block entry
+ * @param start_blkno The start block number
+ * @param stop_blkno The stop block number
+ * @param ranges The runs
+ * @param nranges The size of the runs array
+ * @param n [out] The number of runs
+ * @return 0 if success, otherwise 1 if the runs don't fit
+ */
+int
+pgmoneta_brt_entry_get_ranges(block_ref_table_entry* entry, block_number start_blkno,
+                              block_number stop_blkno, block_ref_table_range* ranges, int nranges, int* n);
+
+/**
+ * Add a newer block reference table to a block reference table. The limit
+ * blocks of the newer table are applied before its blocks
+ * @param brt The block reference table
+ * @param other The newer block reference table
+ * @return 0 if success, otherwise 1
+ */
+int
+pgmoneta_brt_union(block_ref_table* brt, block_ref_table* other);
+
 /**
  * Destroy the block entry (used as a callback)
  * @param entry The entry to be destroyed
@@ -267,4 +311,14 @@ pgmoneta_brt_write(block_ref_table* brt, char* file);
 int
 pgmoneta_brt_read(char* file, block_ref_table** brt);
 
+/**
+ * Read the contents of a summary file into an existing block reference table.
+ * Summary files must be merged in LSN order
+ * @param file The file path
+ * @param brt The block reference table
+ * @return 0 if success, otherwise failure
+ */
+int
+pgmoneta_brt_merge_file(char* file, block_ref_table* brt);
+
 #endif
\ No newline at end of file
@@ -59,6 +59,16 @@ pgmoneta_bzip2_request(SSL* ssl, int client_fd, uint8_t compression, uint8_t enc
 int
 pgmoneta_bzip2_file(char* from, char* to);
 
+/**
+ * BZip a file with a compression level
+ * @param from The from name
+ * @param to The to name
+ * @param level The compression level
+ * @return 0 upon success, otherwise 1.
+ */
+int
+pgmoneta_bzip2_file_level(char* from, char* to, int level);
+
 /**
  * BUNZip decompress a single file, also remove the original file
  * @param ssl The SSL
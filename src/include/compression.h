@@ -32,10 +32,22 @@
 #include <pgmoneta.h>
 #include <workers.h>
 
+#include <limits.h>
+
 struct workers;
 
 typedef int (*compression_func)(char*, char*);
 
+#define COMPRESSION_DECISION_SKIP   0
+#define COMPRESSION_DECISION_FAST   1
+#define COMPRESSION_DECISION_STRONG 2
+
+#define COMPRESSION_SAMPLE_SIZE     (64 * 1024)
+#define COMPRESSION_LEVEL_STORE     INT_MIN
+#define COMPRESSION_LEVEL_FAST      1
+#define COMPRESSION_MANIFEST        "backup.compression"
+#define COMPRESSION_DICTIONARY      "backup.dictionary"
+
 /** @struct compressor
  * Defines a compressor
  */
@@ -175,6 +187,33 @@ pgmoneta_decompress_file(char* from, char* to, int type, struct workers* workers
 int
 pgmoneta_decompress_directory(int server, char* directory, int type, struct workers* workers, struct deque* excludes);
 
+/**
+ * Estimate how well a file compresses from a trial compression of its
+ * first chunk. Data that looks random is skipped, highly redundant data
+ * only needs a fast level
+ * @param path The file path
+ * @param decision [out] The decision (skip, fast, strong)
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_compression_sample(char* path, int* decision);
+
+/**
+ * Get the class of a file in a data directory for compression statistics
+ * @param path The file path
+ * @return The class
+ */
+int
+pgmoneta_compression_class(char* path);
+
+/**
+ * Get the name of a compression class
+ * @param class The class
+ * @return The name
+ */
+char*
+pgmoneta_compression_class_name(int class);
+
 /**
  * Is the file compressed
  * @param file_path The file path
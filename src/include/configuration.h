@@ -52,11 +52,20 @@ extern "C" {
 #define CONFIGURATION_ARGUMENT_AZURE_SHARED_KEY        "azure_shared_key"
 #define CONFIGURATION_ARGUMENT_AZURE_STORAGE_ACCOUNT   "azure_storage_account"
 #define CONFIGURATION_ARGUMENT_BACKLOG                 "backlog"
+#define CONFIGURATION_ARGUMENT_BACKUP_MAX_CONCURRENT   "backup_max_concurrent"
+#define CONFIGURATION_ARGUMENT_BACKUP_MAX_PER_VOLUME   "backup_max_per_volume"
+#define CONFIGURATION_ARGUMENT_BACKUP_PRIORITY         "backup_priority"
+#define CONFIGURATION_ARGUMENT_BANDWIDTH_WEIGHT        "bandwidth_weight"
 #define CONFIGURATION_ARGUMENT_MAX_RATE                "max_rate"
+#define CONFIGURATION_ARGUMENT_BACKUP_CONNECTIONS      "backup_connections"
+#define CONFIGURATION_ARGUMENT_MAX_BANDWIDTH           "max_bandwidth"
 #define CONFIGURATION_ARGUMENT_BASE_DIR                "base_dir"
 #define CONFIGURATION_ARGUMENT_BLOCKING_TIMEOUT        "blocking_timeout"
 #define CONFIGURATION_ARGUMENT_COMPRESSION             "compression"
 #define CONFIGURATION_ARGUMENT_COMPRESSION_LEVEL       "compression_level"
+#define CONFIGURATION_ARGUMENT_COMPRESSION_POLICY      "compression_policy"
+#define CONFIGURATION_ARGUMENT_COMPRESSION_WINDOW      "compression_window"
+#define CONFIGURATION_ARGUMENT_COMPRESSION_DICTIONARY  "compression_dictionary"
 #define CONFIGURATION_ARGUMENT_CONSOLE                 "console"
 #define CONFIGURATION_ARGUMENT_CREATE_SLOT             "create_slot"
 #define CONFIGURATION_ARGUMENT_DIRECT_IO               "direct_io"
@@ -68,6 +77,7 @@ extern "C" {
 #define CONFIGURATION_ARGUMENT_HOT_STANDBY_OVERRIDES   "hot_standby_overrides"
 #define CONFIGURATION_ARGUMENT_HOT_STANDBY_TABLESPACES "hot_standby_tablespaces"
 #define CONFIGURATION_ARGUMENT_HUGEPAGE                "hugepage"
+#define CONFIGURATION_ARGUMENT_INCREMENTAL_THRESHOLD   "incremental_threshold"
 #define CONFIGURATION_ARGUMENT_KEEP_ALIVE              "keep_alive"
 #define CONFIGURATION_ARGUMENT_LIBEV                   "libev"
 #define CONFIGURATION_ARGUMENT_LOG_LEVEL               "log_level"
@@ -119,6 +129,8 @@ extern "C" {
 #define CONFIGURATION_ARGUMENT_USER                    "user"
 #define CONFIGURATION_ARGUMENT_USER_CONF_PATH          "users_configuration_path"
 #define CONFIGURATION_ARGUMENT_VERIFICATION            "verification"
+#define CONFIGURATION_ARGUMENT_WAL_ARCHIVE             "wal_archive"
+#define CONFIGURATION_ARGUMENT_WAL_SUMMARY             "wal_summary"
 #define CONFIGURATION_ARGUMENT_WAL_SHIPPING            "wal_shipping"
 #define CONFIGURATION_ARGUMENT_WAL_SLOT                "wal_slot"
 #define CONFIGURATION_ARGUMENT_WORKERS                 "workers"
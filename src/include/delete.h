@@ -34,6 +34,7 @@ extern "C" {
 #endif
 
 #include <pgmoneta.h>
+#include <workers.h>
 
 #include <stdlib.h>
 
@@ -46,6 +47,38 @@ extern "C" {
 int
 pgmoneta_delete(int srv, char* backup_id);
 
+/**
+ * Delete a backup from a server, and leave the removal of its
+ * directory to the reclaim workers
+ * @param srv The server index
+ * @param backup_id The backup_id
+ * @param reclaim The reclaim workers, or NULL to remove in place
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_delete_deferred(int srv, char* backup_id, struct workers* reclaim);
+
+/**
+ * Move a directory into the trash area of a server, and remove it
+ * using the reclaim workers. Without workers, or if the move fails,
+ * the directory is removed before returning
+ * @param srv The server index
+ * @param directory The directory
+ * @param reclaim The reclaim workers
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_delete_reclaim(int srv, char* directory, struct workers* reclaim);
+
+/**
+ * Remove what is left in the trash area of a server
+ * @param srv The server index
+ * @param reclaim The reclaim workers, or NULL to remove in place
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_delete_trash(int srv, struct workers* reclaim);
+
 /**
  * Delete WAL from a server
  * @param srv The server index
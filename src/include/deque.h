@@ -40,16 +40,16 @@ extern "C" {
 #include <stdint.h>
 
 /** @struct deque_node
- * Defines a deque node
+ * Defines a deque node, a slot in the ring of a deque
  */
 struct deque_node
 {
-   struct value* data;      /**< The value */
-   char* tag;               /**< The tag */
-   struct deque_node* next; /**< The next pointer */
-   struct deque_node* prev; /**< The previous pointer */
+   struct value* data; /**< The value, NULL for a removed node */
+   char* tag;          /**< The tag */
 };
 
+struct deque_index;
+
 /**
  * Compare two values in a deque
  * @param a The first value
@@ -60,15 +60,24 @@ struct deque_node
 typedef int (*compare_cb)(struct value* a, struct value* b);
 
 /** @struct deque
- * Defines a deque
+ * Defines a deque. The nodes live in a ring that doubles when full.
+ * Removing a node from the middle leaves a hole that iteration skips; holes
+ * are squeezed out by sorting, or instead of growing once they are at least
+ * half of the ring. Tag lookups on a large deque build a hash index of the
+ * tags, which is kept up to date from then on
  */
 struct deque
 {
-   uint32_t size;            /**< The size of the deque */
-   bool thread_safe;         /**< If the deque is thread safe */
-   pthread_rwlock_t mutex;   /**< The mutex of the deque */
-   struct deque_node* start; /**< The start node */
-   struct deque_node* end;   /**< The end node */
+   uint32_t size;              /**< The size of the deque */
+   bool thread_safe;           /**< If the deque is thread safe */
+   pthread_rwlock_t mutex;     /**< The mutex of the deque */
+   struct deque_node* nodes;   /**< The ring of nodes */
+   uint32_t capacity;          /**< The number of slots in the ring, a power of two */
+   uint32_t used;              /**< The number of slots in use, holes included */
+   uint32_t head;              /**< The slot of the first node */
+   uint64_t first;             /**< The position of the first node, positions never go down */
+   struct deque_index* index;  /**< The tag index, or NULL */
+   struct memory_arena* arena; /**< The arena holding the nodes, or NULL for the heap */
 };
 
 /** @struct deque_iterator
@@ -76,10 +85,10 @@ struct deque
  */
 struct deque_iterator
 {
-   struct deque* deque;    /**< The deque */
-   struct deque_node* cur; /**< The current deque node */
-   char* tag;              /**< The current tag */
-   struct value* value;    /**< The current value */
+   struct deque* deque; /**< The deque */
+   uint64_t position;   /**< The position of the current node, 0 before the first one */
+   char* tag;           /**< The current tag */
+   struct value* value; /**< The current value */
 };
 
 /**
@@ -91,6 +100,19 @@ struct deque_iterator
 int
 pgmoneta_deque_create(bool thread_safe, struct deque** deque);
 
+/**
+ * Create a deque whose nodes, tags and values live in an arena. Heap data
+ * added to it is destroyed with the arena. Polling hands out a heap copy of
+ * the tag, while copied values such as strings stay in the arena. A thread
+ * safe deque marks the arena as shared
+ * @param thread_safe If the deque needs to be thread safe
+ * @param arena The arena, or NULL for the heap
+ * @param deque The deque
+ * @return 0 if success, otherwise 1
+ */
+int
+pgmoneta_deque_create_with_arena(bool thread_safe, struct memory_arena* arena, struct deque** deque);
+
 /**
  * Add a node to deque's tail, the tag will be copied
  * This function is thread safe
@@ -228,7 +250,9 @@ bool
 pgmoneta_deque_iterator_has_next(struct deque_iterator* iter);
 
 /**
- * Remove the current node iterator points to and place the iterator to the previous node
+ * Remove the current node iterator points to. The tag and value are set
+ * to NULL afterwards, and the next call to pgmoneta_deque_iterator_next()
+ * moves on to the node that followed it
  * @param iter The iterator
  */
 void
@@ -265,7 +289,7 @@ void
 pgmoneta_deque_list(struct deque* deque);
 
 /**
- * Sort the deque
+ * Sort the deque. The sort is stable and moves the nodes within the ring
  * @param deque The deque
  * @param compare [Optional] The compare function pointer, if NULL then tag comparison is used
  */
@@ -291,7 +315,7 @@ void
 pgmoneta_deque_destroy(struct deque* deque);
 
 /**
- * Set the deque to be thread safe
+ * Set the deque to be thread safe. Its arena, if any, is marked as shared
  * @param deque The deque
  */
 void
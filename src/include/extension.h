@@ -39,8 +39,9 @@ extern "C" {
 #include <stdbool.h>
 #include <stdlib.h>
 
-#define MAX_QUERY_LENGTH    16384
-#define PGMONETA_CHUNK_SIZE 8192
+#define MAX_QUERY_LENGTH         16384
+#define PGMONETA_SEND_CHUNK_SIZE (1024 * 1024)
+#define PGMONETA_SEND_PIPELINE   8
 
 /**
  * Check if the server has the extension installed
@@ -104,18 +105,6 @@ pgmoneta_ext_get_file(SSL* ssl, int socket, char* file_path, struct query_respon
 int
 pgmoneta_ext_get_files(SSL* ssl, int socket, char* file_path, struct query_response** qr);
 
-/**
- * Send a file chunk to the extension
- * @param ssl The SSL structure
- * @param socket The socket
- * @param dest_path The path where the file will be written
- * @param base64_data The encoded file chunk in base64
- * @param qr The query result
- * @return 0 upon success, otherwise 1
- */
-int
-pgmoneta_ext_send_file_chunk(SSL* ssl, int socket, char* dest_path, char* base64_data, struct query_response** qr);
-
 /**
  * Promote a standby (replica) server to become the primary server
  * @param ssl The SSL structure
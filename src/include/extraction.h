@@ -30,8 +30,10 @@
 #define PGMONETA_EXTRACTION_H
 
 #include <deque.h>
+#include <tar.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -77,6 +79,35 @@ pgmoneta_extract_file(char* file_path, uint32_t type, bool copy, struct deque* f
 int
 pgmoneta_extract_backup_file(int server, char* label, char* relative_file_path, struct deque* failures, char** target_file);
 
+/**
+ * Stream the members of a tar archive to a callback without extracting it.
+ * The archive may be encrypted and/or compressed; the layers are removed
+ * in memory while the archive is read.
+ *
+ * @param file_path The archive path (e.g. "wal.tar.zstd.aes")
+ * @param type The file type bitmask (PGMONETA_FILE_TYPE_*), or 0 for auto-detect
+ * @param cb The member callback, which takes ownership of the member content
+ * @param arg The user argument passed to the callback
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_extract_archive_stream(char* file_path, uint32_t type, tar_member_cb cb, void* arg);
+
+/**
+ * Decrypt and decompress a file held in memory.
+ * The encryption and compression are derived from the file name suffix.
+ *
+ * @param name The file name (e.g. "000000010000000000000001.zstd")
+ * @param type The file type bitmask (PGMONETA_FILE_TYPE_*), or 0 for auto-detect
+ * @param data The file content
+ * @param size The size of the file content
+ * @param out [out] The decoded content (caller must free)
+ * @param out_size [out] The size of the decoded content
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_extract_buffer(char* name, uint32_t type, void* data, size_t size, void** out, size_t* out_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,6 +58,16 @@ pgmoneta_gzip_request(SSL* ssl, int client_fd, uint8_t compression, uint8_t encr
 int
 pgmoneta_gzip_file(char* from, char* to);
 
+/**
+ * GZip a file with a compression level
+ * @param from The from name
+ * @param to The to name
+ * @param level The compression level
+ * @return 0 upon success, otherwise 1.
+ */
+int
+pgmoneta_gzip_file_level(char* from, char* to, int level);
+
 /**
  * GUNZip a single file, also remove the original file
  * @param ssl The SSL
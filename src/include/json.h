@@ -72,6 +72,9 @@ struct json
    enum json_type type; /**< The json object type */
    // if the object is an array, it can have at most one json element
    void* elements; /**< The json elements, could be an array or some kv pairs */
+   // objects parsed into an arena share it, the root object owns it
+   struct memory_arena* arena; /**< The arena holding the object, or NULL for the heap */
+   bool owns_arena;            /**< Whether destroying the object destroys the arena */
 };
 
 /** @struct json_reader
@@ -213,6 +216,15 @@ pgmoneta_json_append(struct json* array, uintptr_t entry, enum value_type type);
 bool
 pgmoneta_json_next_array_item(struct json_reader* reader, struct json** item);
 
+/**
+ * Read the item the reader is positioned at, e.g. the top-level object of a freshly opened reader
+ * @param reader The json reader
+ * @param item [out] The item, parsed into json structure, all array and nested items will be skipped
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_json_read_item(struct json_reader* reader, struct json** item);
+
 /**
  * Get json array length
  * @param array The json array
@@ -261,6 +273,20 @@ pgmoneta_json_iterator_destroy(struct json_iterator* iter);
 int
 pgmoneta_json_parse_string(char* str, struct json** obj);
 
+/**
+ * Parse a string into a json object held in a memory arena.
+ * All nested objects, keys and values are allocated from the arena and
+ * keys are interned, so the whole document is released in one step by
+ * pgmoneta_json_destroy() on the returned root. Nested objects must not be
+ * destroyed on their own, and the document must not be modified from
+ * several threads at the same time
+ * @param str The string
+ * @param obj [out] The json object
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgmoneta_json_parse_string_arena(char* str, struct json** obj);
+
 /**
  * Clone a json object
  * @param from The from object
@@ -307,6 +333,17 @@ pgmoneta_json_destroy(struct json* object);
 int
 pgmoneta_json_read_file(char* path, struct json** obj);
 
+/**
+ * Read a json from disk into a memory arena, see
+ * pgmoneta_json_parse_string_arena(). Meant for large, read-only
+ * documents such as the OID mappings
+ * @param path The path
+ * @param obj [out] The json object
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgmoneta_json_read_file_arena(char* path, struct json** obj);
+
 /**
  * Write a json file to disk
  * @param path The path
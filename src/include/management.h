@@ -58,6 +58,16 @@ extern "C" {
 #define MANAGEMENT_ENCRYPTION_AES192_GCM 2
 #define MANAGEMENT_ENCRYPTION_AES128_GCM 3
 
+/**
+ * Set on the compression byte of a response sent as frames
+ */
+#define MANAGEMENT_STREAM                0x80
+
+/**
+ * The size a frame of a streamed response is filled up to
+ */
+#define MANAGEMENT_STREAM_FRAME_SIZE     65536
+
 /**
  * Management commands
  */
@@ -187,6 +197,7 @@ extern "C" {
 #define MANAGEMENT_ARGUMENT_START_TIME            "StartTime"
 #define MANAGEMENT_ARGUMENT_START_TIMELINE        "StartTimeline"
 #define MANAGEMENT_ARGUMENT_STATUS                "Status"
+#define MANAGEMENT_ARGUMENT_STREAM                "Stream"
 #define MANAGEMENT_ARGUMENT_TABLESPACE            "Tablespace"
 #define MANAGEMENT_ARGUMENT_TABLESPACES           "Tablespaces"
 #define MANAGEMENT_ARGUMENT_TABLESPACE_NAME       "TablespaceName"
@@ -224,6 +235,7 @@ extern "C" {
 #define MANAGEMENT_ERROR_BACKUP_NOSERVER                    111
 #define MANAGEMENT_ERROR_BACKUP_NOFORK                      112
 #define MANAGEMENT_ERROR_BACKUP_ERROR                       113
+#define MANAGEMENT_ERROR_BACKUP_QUEUE                       114
 
 #define MANAGEMENT_ERROR_INCREMENTAL_BACKUP_SETUP           200
 #define MANAGEMENT_ERROR_INCREMENTAL_BACKUP_EXECUTE         201
@@ -412,6 +424,15 @@ extern "C" {
 #define MANAGEMENT_OUTPUT_FORMAT_JSON 1
 #define MANAGEMENT_OUTPUT_FORMAT_RAW  2
 
+/**
+ * Callback for a frame of a management response
+ * @param frame The frame
+ * @param first Is this the first frame of the response
+ * @param data The callback data
+ * @return 0 upon success, otherwise 1
+ */
+typedef int (*management_frame_cb)(struct json* frame, bool first, void* data);
+
 /**
  * Create header for management command
  * @param command The command
@@ -895,6 +916,20 @@ pgmoneta_management_create_response(struct json* json, int server, struct json**
 int
 pgmoneta_management_read_json(SSL* ssl, int socket, uint8_t* compression, uint8_t* encryption, struct json** json);
 
+/**
+ * Read a management response frame by frame. A response that isn't
+ * streamed is handed to the callback as a single frame
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param compression The pointer to an integer that will store the compress method
+ * @param encryption The pointer to an integer that will store the encrypt method
+ * @param cb The callback for each frame, which takes ownership of the frame
+ * @param data The callback data
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_read_frames(SSL* ssl, int socket, uint8_t* compression, uint8_t* encryption, management_frame_cb cb, void* data);
+
 /**
  * Write the management JSON
  * @param ssl The SSL connection
@@ -907,6 +942,21 @@ pgmoneta_management_read_json(SSL* ssl, int socket, uint8_t* compression, uint8_
 int
 pgmoneta_management_write_json(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json* json);
 
+/**
+ * Write the management JSON as a stream of frames. The first frame holds the
+ * document without the arrays of the response, the following frames hold the
+ * array items. Each frame is compressed and encrypted on its own, and sent
+ * without base64 encoding. An empty frame ends the stream
+ * @param ssl The SSL connection
+ * @param socket The socket descriptor
+ * @param compression The compress method for wire protocol
+ * @param encryption The encrypt method for wire protocol
+ * @param json The JSON structure
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_management_write_json_stream(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json* json);
+
 #ifdef __cplusplus
 }
 #endif
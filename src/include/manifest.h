@@ -41,6 +41,12 @@ extern "C" {
 
 #define MANIFEST_CHUNK_SIZE 8192
 
+// the number of entries pgmoneta_manifest_convert sorts in memory at a time
+#define MANIFEST_SORT_CHUNK 65536
+
+// returned by pgmoneta_manifest_merge_diff when an input isn't sorted by path
+#define MANIFEST_DIFF_UNSORTED 2
+
 // simple manifest csv structure definition in case we want to change later
 #define MANIFEST_COLUMN_COUNT   2
 #define MANIFEST_PATH_INDEX     0
@@ -64,6 +70,54 @@ struct manifest_chunk
    int size;                                        /**< The size of the chunk */
 };
 
+/** @enum manifest_diff
+ * Defines the kind of a difference between two manifests
+ */
+enum manifest_diff {
+   ManifestDeleted, /**< The file only exists in the old manifest */
+   ManifestChanged, /**< The file exists in both with different checksums */
+   ManifestAdded,   /**< The file only exists in the new manifest */
+};
+
+/** @struct manifest_iterator
+ * Defines an iterator streaming the file entries of a backup_manifest
+ */
+struct manifest_iterator
+{
+   struct json_reader* reader; /**< The JSON reader positioned inside the Files array */
+   struct json* entry;         /**< The current file entry */
+   char* path;                 /**< The path of the current entry */
+   char* checksum;             /**< The checksum of the current entry */
+   uint64_t size;              /**< The size of the current entry */
+};
+
+/**
+ * Callback for every difference found by pgmoneta_manifest_merge_diff
+ * @param kind The kind of the difference
+ * @param path The path of the file
+ * @param checksum The checksum of the file, the old one for changed files
+ * @param data The user data
+ * @return 0 to continue, otherwise 1 to stop with an error
+ */
+typedef int (*manifest_diff_cb)(enum manifest_diff kind, char* path, char* checksum, void* data);
+
+/**
+ * Callback to adjust the size of a file when summing a manifest
+ * @param path The path of the file
+ * @param manifest_size The size recorded in the manifest
+ * @param data The user data
+ * @param size [out] The size to account for the file
+ * @return 0 on success, otherwise 1
+ */
+typedef int (*manifest_size_cb)(char* path, uint64_t manifest_size, void* data, uint64_t* size);
+
+/**
+ * Callback to leave a file entry out when rewriting a manifest
+ * @param path The path of the file
+ * @return true if the entry should be dropped, otherwise false
+ */
+typedef bool (*manifest_filter_cb)(char* path);
+
 /**
  * Verify checksum of the manifest and the checksum
  * @param root The root directory holding the manifest
@@ -87,7 +141,66 @@ int
 pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art** deleted_files, struct art** changed_files, struct art** added_files);
 
 /**
- * Generate the manifest on disk according to postgres manifest format
+ * Diff two backup.manifest files in a single pass, both must be sorted by path
+ * @param old_manifest The path to the old manifest
+ * @param new_manifest The path to the new manifest
+ * @param cb The callback for every deleted, changed or added file
+ * @param data The user data passed to the callback
+ * @return 0 on success, MANIFEST_DIFF_UNSORTED if an input isn't sorted
+ * (the differences reported so far are incomplete), otherwise 1
+ */
+int
+pgmoneta_manifest_merge_diff(char* old_manifest, char* new_manifest, manifest_diff_cb cb, void* data);
+
+/**
+ * Create an iterator over the file entries of a backup_manifest,
+ * only the current entry is held in memory
+ * @param manifest_path The path to the backup_manifest
+ * @param iter [out] The iterator
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_manifest_iterator_create(char* manifest_path, struct manifest_iterator** iter);
+
+/**
+ * Advance to the next file entry
+ * @param iter The iterator
+ * @return true if there is a next entry, otherwise false
+ */
+bool
+pgmoneta_manifest_iterator_next(struct manifest_iterator* iter);
+
+/**
+ * Destroy the iterator
+ * @param iter The iterator
+ */
+void
+pgmoneta_manifest_iterator_destroy(struct manifest_iterator* iter);
+
+/**
+ * Sum the file sizes of a backup_manifest
+ * @param manifest_path The path to the backup_manifest
+ * @param size_cb [Optional] The callback to adjust the size of each file
+ * @param data The user data passed to the callback
+ * @param size [out] The total size
+ * @param biggest_file_size [out] The size of the biggest file
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_manifest_sum_sizes(char* manifest_path, manifest_size_cb size_cb, void* data, uint64_t* size, uint64_t* biggest_file_size);
+
+/**
+ * Count the files of a backup.manifest
+ * @param manifest_path The path to the manifest CSV file
+ * @param count [out] The number of files
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_manifest_count_files(char* manifest_path, int* count);
+
+/**
+ * Generate the manifest on disk according to postgres manifest format,
+ * the files are written sorted by path
  * @param manifest The manifest
  * @param path The path
  * @return 0 on success, otherwise 1
@@ -95,6 +208,30 @@ pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art**
 int
 pgmoneta_write_postgresql_manifest(struct json* manifest, char* path);
 
+/**
+ * Rewrite a backup_manifest on disk, streaming the entries of the source manifest.
+ * The kept source entries are written in their order, followed by the new ones
+ * @param source The path to the source backup_manifest
+ * @param files The file entries to add
+ * @param drop [Optional] The filter for source entries to leave out
+ * @param path The path of the new manifest
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_manifest_rewrite(char* source, struct json* files, manifest_filter_cb drop, char* path);
+
+/**
+ * Convert the file entries of a backup_manifest into a backup.manifest sorted by path.
+ * The entries are sorted in runs of at most chunk entries, which are spilled next to
+ * the output and merged, so memory is bounded by the run size
+ * @param source The path to the backup_manifest
+ * @param path The path of the backup.manifest
+ * @param chunk The number of entries in a run, or 0 to sort all of them in memory
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_manifest_convert(char* source, char* path, uint32_t chunk);
+
 /**
  * Generate the manifest in memory (json format)
  * @param version The manifest file version
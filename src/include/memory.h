@@ -35,6 +35,7 @@ extern "C" {
 
 #include <pgmoneta.h>
 
+#include <pthread.h>
 #include <stdlib.h>
 
 /** @struct stream_buffer
@@ -49,14 +50,50 @@ struct stream_buffer
    size_t cursor; /**< next byte to consume */
 } __attribute__((aligned(64)));
 
+/** @struct memory_buffer_statistics
+ * Defines the buffer pool statistics of the process
+ */
+struct memory_buffer_statistics
+{
+   uint64_t hits;       /**< The number of requests served from a cache */
+   uint64_t misses;     /**< The number of requests that mapped a new buffer */
+   uint64_t huge_pages; /**< The number of buffers backed by huge pages */
+   uint64_t mapped;     /**< The number of bytes mapped */
+   uint64_t in_use;     /**< The number of bytes handed out */
+};
+
+struct memory_arena_block;
+struct memory_arena_finalizer;
+
+/** @struct memory_arena
+ * Defines a memory arena. Memory is handed out from a few large blocks,
+ * is never freed individually, and is released in one step when the
+ * arena is destroyed. Once the arena is shared by thread safe
+ * containers, it serializes its allocations, so the containers of one
+ * document may grow from several threads.
+ */
+struct memory_arena
+{
+   struct memory_arena_block* blocks;         /**< The blocks, newest first */
+   size_t block_size;                         /**< The size of a regular block */
+   size_t allocated;                          /**< The number of bytes handed out */
+   size_t reserved;                           /**< The number of bytes held in blocks */
+   struct memory_arena_finalizer* finalizers; /**< The callbacks to run on destroy */
+   char** interned;                           /**< The interned strings, open addressing */
+   uint32_t interned_capacity;                /**< The capacity of the interned table, a power of two */
+   uint32_t interned_size;                    /**< The number of interned strings */
+   bool shared;                               /**< Is the arena shared by thread safe containers */
+   pthread_mutex_t lock;                      /**< The lock serializing allocation when shared */
+};
+
 /**
- * Initialize a memory segment for the process local message structure
+ * Initialize a memory segment for the thread local message structure
  */
 void
 pgmoneta_memory_init(void);
 
 /**
- * Get the message structure
+ * Get the message structure of the calling thread, initializing it if needed
  * @return The structure
  */
 struct message*
@@ -124,6 +161,145 @@ pgmoneta_memory_stream_buffer_enlarge(struct stream_buffer* buffer, int bytes_ne
 void
 pgmoneta_memory_stream_buffer_free(struct stream_buffer* buffer);
 
+/**
+ * Create a memory arena
+ * @param block_size The size of a regular block, or 0 for the default
+ * @param arena The resulting arena
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_memory_arena_create(size_t block_size, struct memory_arena** arena);
+
+/**
+ * Mark an arena as shared by thread safe containers, which makes it
+ * serialize its allocations. Call it before the containers are used
+ * from several threads
+ * @param arena The arena
+ */
+void
+pgmoneta_memory_arena_share(struct memory_arena* arena);
+
+/**
+ * Allocate memory from an arena. The memory is not initialized
+ * @param arena The arena
+ * @param size The size
+ * @return The memory, or NULL upon failure
+ */
+void*
+pgmoneta_memory_arena_alloc(struct memory_arena* arena, size_t size);
+
+/**
+ * Copy a string into an arena
+ * @param arena The arena
+ * @param s The string
+ * @param length The length of the string, without the terminator
+ * @return The copy, or NULL upon failure
+ */
+char*
+pgmoneta_memory_arena_strndup(struct memory_arena* arena, const char* s, size_t length);
+
+/**
+ * Intern a string in an arena. Equal strings share one copy, which lives
+ * as long as the arena
+ * @param arena The arena
+ * @param s The string
+ * @param length The length of the string, without the terminator
+ * @return The interned string, or NULL upon failure
+ */
+char*
+pgmoneta_memory_arena_intern(struct memory_arena* arena, const char* s, size_t length);
+
+/**
+ * Register a callback to run when an arena is destroyed, for heap
+ * resources that objects in the arena refer to
+ * @param arena The arena
+ * @param callback The callback
+ * @param data The callback argument
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_memory_arena_defer(struct memory_arena* arena, void (*callback)(void* data), void* data);
+
+/**
+ * Destroy a memory arena, running its deferred callbacks and releasing
+ * all of its memory
+ * @param arena The arena
+ */
+void
+pgmoneta_memory_arena_destroy(struct memory_arena* arena);
+
+/**
+ * Allocate memory from an arena, or from the heap if there is none
+ * @param arena The arena, or NULL
+ * @param size The size
+ * @return The memory, or NULL upon failure
+ */
+void*
+pgmoneta_memory_alloc(struct memory_arena* arena, size_t size);
+
+/**
+ * Release memory obtained from pgmoneta_memory_alloc. Arena memory is
+ * only released with its arena
+ * @param arena The arena, or NULL
+ * @param data The memory
+ */
+void
+pgmoneta_memory_release(struct memory_arena* arena, void* data);
+
+/**
+ * Initialize the buffer pool. Buffers of 2MB and up are backed by
+ * transparent huge pages unless huge pages are off
+ * @param hugepage The huge page setting
+ */
+void
+pgmoneta_memory_buffer_initialize(unsigned char hugepage);
+
+/**
+ * Acquire a data buffer from the buffer pool. The buffer is page aligned,
+ * is placed on the NUMA node of the calling thread, and is not initialized
+ * @param size The size
+ * @return The buffer, or NULL upon failure
+ */
+void*
+pgmoneta_memory_buffer_acquire(size_t size);
+
+/**
+ * Resize a buffer from the buffer pool, keeping its content
+ * @param buffer The buffer, or NULL
+ * @param size The new size
+ * @return The buffer, or NULL upon failure in which case the original buffer is kept
+ */
+void*
+pgmoneta_memory_buffer_resize(void* buffer, size_t size);
+
+/**
+ * Get the capacity of a buffer from the buffer pool
+ * @param buffer The buffer
+ * @return The capacity
+ */
+size_t
+pgmoneta_memory_buffer_capacity(void* buffer);
+
+/**
+ * Release a buffer back to the buffer pool
+ * @param buffer The buffer, or NULL
+ */
+void
+pgmoneta_memory_buffer_release(void* buffer);
+
+/**
+ * Return the cached buffers of the process to the operating system
+ */
+void
+pgmoneta_memory_buffer_trim(void);
+
+/**
+ * Get the buffer pool statistics of the process
+ * @param statistics The statistics
+ */
+void
+pgmoneta_memory_buffer_statistics(struct memory_buffer_statistics* statistics);
+
 #ifdef __cplusplus
 }
 #endif
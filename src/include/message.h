@@ -411,6 +411,81 @@ pgmoneta_send_copy_done_message(SSL* ssl, int socket);
 int
 pgmoneta_create_query_message(char* query, struct message** msg);
 
+/**
+ * Create a Parse message for a named prepared statement, followed by a Sync
+ * @param statement The name of the statement
+ * @param query The query with $n parameters
+ * @param number_of_types The number of parameter types
+ * @param types The parameter type OIDs, or 0 to let the server infer them
+ * @param msg The resulting message
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_create_parse_message(char* statement, char* query, int number_of_types, int32_t* types, struct message** msg);
+
+/**
+ * Create a Bind, Execute and Sync message for a prepared statement.
+ * The parameters are sent in text format
+ * @param statement The name of the statement
+ * @param number_of_parameters The number of parameters
+ * @param parameters The parameters, NULL for SQL NULL
+ * @param binary Request the result in binary format
+ * @param msg The resulting message
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_create_bind_execute_message(char* statement, int number_of_parameters, char** parameters, bool binary,
+                                     struct message** msg);
+
+/**
+ * Create a Bind and Execute message for a prepared statement, optionally
+ * followed by a Sync. The parameters are sent in binary format with the given
+ * lengths and the result is requested in binary format. Messages without a Sync
+ * can be written back to back to pipeline several executions
+ * @param statement The name of the statement
+ * @param number_of_parameters The number of parameters
+ * @param parameters The parameters, NULL for SQL NULL
+ * @param lengths The length of each parameter
+ * @param sync Add a Sync to end the pipeline
+ * @param msg The resulting message
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_create_bind_execute_binary_message(char* statement, int number_of_parameters, char** parameters, int32_t* lengths,
+                                            bool sync, struct message** msg);
+
+/**
+ * Execute an extended query message and read until ReadyForQuery.
+ * The first column of the first DataRow is copied into the buffer
+ * as it is received
+ * @param ssl The SSL structure
+ * @param socket The socket
+ * @param msg The message
+ * @param buffer The buffer, or NULL when no row is expected
+ * @param capacity The capacity of the buffer
+ * @param length [out] The length of the column, 0 when NULL or no row
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_extended_query_execute(SSL* ssl, int socket, struct message* msg, void* buffer, size_t capacity, int64_t* length);
+
+/**
+ * Execute the message that ends a pipeline of extended queries and read until
+ * ReadyForQuery. The first column of the DataRow of each execution is copied
+ * into its own slot of the buffer as it is received
+ * @param ssl The SSL structure
+ * @param socket The socket
+ * @param msg The message
+ * @param buffer The buffer with a slot of capacity bytes per row
+ * @param capacity The capacity of each slot
+ * @param rows The number of rows expected
+ * @param lengths [out] The length of the column of each row, 0 when NULL or no row
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_extended_query_execute_rows(SSL* ssl, int socket, struct message* msg, void* buffer, size_t capacity, int rows,
+                                     int64_t* lengths);
+
 /**
  * Create and send a copy data message with the given content
  * @param ssl The SSL structure
@@ -555,7 +630,10 @@ int
 pgmoneta_receive_extra_files(SSL* ssl, int socket, char* username, char* source_dir, char* target_dir, char** info_extra);
 
 /**
- * Send a file from the client side to the extension side
+ * Send a file from the client side to the extension side.
+ * The chunks are sent as binary parameters in pipelined executions and each
+ * chunk is verified against its SHA-256 on the server side. A partial target
+ * file is resumed when its content matches the source
  * @param ssl The SSL structure
  * @param socket The socket
  * @param username The current server username
@@ -34,7 +34,9 @@ extern "C" {
 #endif
 
 /* pgmoneta */
+#include <bandwidth.h>
 #include <progress.h>
+#include <scheduler.h>
 
 /* system */
 #include <ev.h>
@@ -111,6 +113,16 @@ extern "C" {
 #define DIRECT_IO_AUTO               1
 #define DIRECT_IO_ON                 2
 
+#define COMPRESSION_POLICY_FIXED     0
+#define COMPRESSION_POLICY_ADAPTIVE  1
+#define COMPRESSION_POLICY_AUTO      2
+
+#define COMPRESSION_CLASS_RELATION    0
+#define COMPRESSION_CLASS_WAL         1
+#define COMPRESSION_CLASS_TRANSACTION 2
+#define COMPRESSION_CLASS_OTHER       3
+#define NUMBER_OF_COMPRESSION_CLASSES 4
+
 // clang-format on
 /* Compression type bits */
 #define COMPRESSION_TYPE_CLIENT 0x10
@@ -318,6 +330,8 @@ struct server
    int create_slot;                                               /**< Create a slot */
    atomic_bool repository;                                        /**< Repository lock */
    atomic_bool wal_repository;                                    /**< WAL repository lock */
+   atomic_bool wal_archive;                                       /**< WAL archive lock */
+   atomic_bool wal_summarizer;                                    /**< WAL summarizer lock */
    bool active_backup;                                            /**< Is there an active backup */
    bool active_restore;                                           /**< Is there an active restore */
    bool active_archive;                                           /**< Is there an active archive */
@@ -328,6 +342,7 @@ struct server
    size_t segment_size;                                           /**< The max size of a relation file segment*/
    size_t relseg_size;                                            /**< The max number of blocks in a relation file segment */
    pid_t wal_streaming;                                           /**< WAL streaming process id */
+   pid_t wal_summarizer_pid;                                      /**< WAL summarizer process id */
    bool checksums;                                                /**< Are checksums enabled */
    int fips_enabled;                                              /**< FIPS mode status */
    bool summarize_wal;                                            /**< Is summarize_wal enabled */
@@ -351,6 +366,10 @@ struct server
    char tls_ca_file[MAX_PATH];                                    /**< TLS CA certificate path */
    int workers;                                                   /**< The number of workers */
    int max_rate;                                                  /**< Maximum backup rate in bytes per second. */
+   int backup_connections;                                        /**< The number of connections of a full backup */
+   int max_bandwidth;                                             /**< Maximum bandwidth in bytes per second */
+   int bandwidth_weight;                                          /**< The share of the global bandwidth */
+   int backup_priority;                                           /**< The priority of queued backups */
    int number_of_extra;                                           /**< The number of source directory*/
    int progress_enabled;                                          /**< The progress status */
    char extra[MAX_EXTRA][MAX_EXTRA_PATH];                         /**< Source directory*/
@@ -359,6 +378,8 @@ struct server
    struct extension_info extensions[NUMBER_OF_EXTENSIONS];        /**< The extensions */
    struct s3_configuration s3;                                    /**< The S3 configuration */
    struct progress progress;                                      /**< The progress */
+   struct bandwidth_server bandwidth;                             /**< The bandwidth scheduler */
+   struct scheduler_server scheduler;                             /**< The backup queue */
 } __attribute__((aligned(64)));
 
 /** @struct user
@@ -392,6 +413,18 @@ struct prometheus_cache
    char data[];        /**< the payload */
 } __attribute__((aligned(64)));
 
+/** @struct compression_class
+ * Defines the compression statistics of a class of files
+ */
+struct compression_class
+{
+   atomic_ulong files;      /**< The number of files compressed */
+   atomic_ulong skipped;    /**< The number of files stored uncompressed */
+   atomic_ulong original;   /**< The size of the compressed files before compression */
+   atomic_ulong compressed; /**< The size of the compressed files after compression */
+   atomic_ulong cpu;        /**< The CPU time spent compressing in nanoseconds */
+} __attribute__((aligned(64)));
+
 /** @struct prometheus
  * Defines the Prometheus metrics
  */
@@ -401,6 +434,11 @@ struct prometheus
    atomic_ulong logging_warn;  /**< Logging: WARN */
    atomic_ulong logging_error; /**< Logging: ERROR */
    atomic_ulong logging_fatal; /**< Logging: FATAL */
+
+   atomic_ulong buffer_pool_hits;       /**< Buffer pool: requests served from a cache */
+   atomic_ulong buffer_pool_misses;     /**< Buffer pool: requests that mapped a new buffer */
+   atomic_ulong buffer_pool_huge_pages; /**< Buffer pool: buffers backed by huge pages */
+   atomic_long buffer_pool_mapped;      /**< Buffer pool: bytes mapped */
 } __attribute__((aligned(64)));
 
 /** @struct common_configuration
@@ -461,8 +499,11 @@ struct main_configuration
 
    char base_dir[MAX_PATH]; /**< The base directory */
 
-   int compression_type;  /**< The compression type */
-   int compression_level; /**< The compression level */
+   int compression_type;               /**< The compression type */
+   int compression_level;              /**< The compression level */
+   int compression_policy;             /**< The compression policy (fixed, adaptive, auto) */
+   pgmoneta_time_t compression_window; /**< The target backup window of the auto compression policy */
+   bool compression_dictionary;        /**< Compress small files against a trained zstd dictionary */
 
    int create_slot; /**< Create a slot */
 
@@ -516,9 +557,21 @@ struct main_configuration
    unsigned char hugepage;  /**< Huge page support */
    unsigned char direct_io; /**< Direct I/O support (off, auto, on) */
 
-   int max_rate; /**< Maximum backup rate in bytes per second. */
+   int max_rate;           /**< Maximum backup rate in bytes per second. */
+   int backup_connections; /**< The number of connections of a full backup */
+
+   int max_bandwidth;          /**< Maximum bandwidth in bytes per second */
+   struct bandwidth bandwidth; /**< The bandwidth scheduler */
+
+   struct compression_class compression_classes[NUMBER_OF_COMPRESSION_CLASSES]; /**< The compression statistics per class of files */
+
+   int backup_max_concurrent; /**< The maximum number of running backups */
+   int backup_max_per_volume; /**< The maximum number of running backups on a volume */
+   int incremental_threshold; /**< The WAL volume in percent of the last backup below which an automatic backup is incremental */
 
    pgmoneta_time_t verification; /**< The sha512 verification interval */
+   pgmoneta_time_t wal_archive;  /**< The WAL archive interval */
+   bool wal_summary;             /**< Summarize the WAL as it is received */
 
    bool progress; /**< Enable backup progress tracking */
 
@@ -96,14 +96,14 @@ pgmoneta_restore_backup(struct art* nodes);
  * (the last level of directory should not be followed by back slash)
  * @param prior_labels The labels of prior incremental/full backups, from newest to oldest
  * @param bck The backup to be restored
- * @param manifest The manifest of the incremental backup to be combined
+ * @param manifest The path to the manifest of the incremental backup to be combined
  * @param incremental Whether to combine the backups into an incremental backup
  * @param combine_as_is Whether to alter the resulting backup
  * @return 0 on success, 1 if otherwise
  */
 int
 pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, char* output_dir, struct deque* prior_labels,
-                         struct backup* bck, struct json* manifest, bool incremental, bool combine_as_is, struct art* nodes);
+                         struct backup* bck, char* manifest, bool incremental, bool combine_as_is, struct art* nodes);
 
 /**
  * Rollup backups into a new backup
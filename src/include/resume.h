@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_RESUME_H
+#define PGMONETA_RESUME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgmoneta.h>
+#include <art.h>
+#include <brt.h>
+
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RESUME_INFO  "resume.info"
+#define RESUME_FILES "resume.files"
+#define RESUME_BRT   "resume.brt"
+
+#define RESUME_LABEL         "LABEL"
+#define RESUME_PARENT        "PARENT"
+#define RESUME_START_LSN     "START_LSN"
+#define RESUME_SUMMARY_START "SUMMARY_START"
+#define RESUME_SUMMARY_END   "SUMMARY_END"
+
+/** @struct resume_file
+ * A file completed by an interrupted backup
+ */
+struct resume_file
+{
+   uint64_t size;                /**< The size of the local file */
+   char sha256[65];              /**< The SHA-256 of the file, empty if it wasn't checksummed */
+   char local[MAX_PATH];         /**< The path of the local file relative to the data directory */
+};
+
+/** @struct resume
+ * The checkpoint of a backup that is fetched file by file. The files that are
+ * completed are recorded under the resume directory of the server, and a backup
+ * that is interrupted leaves its files there for the next backup to reuse
+ */
+struct resume
+{
+   int server;                   /**< The server */
+   char* directory;              /**< The resume directory of the server */
+   char* data;                   /**< The files of the interrupted backup */
+   char label[MISC_LENGTH];      /**< The label of the backup */
+   char parent[MISC_LENGTH];     /**< The label of the parent backup, empty for a full backup */
+   uint64_t start_lsn;           /**< The start LSN of the interrupted backup, 0 if there is none */
+   uint64_t summary_start;       /**< The start LSN of the saved summary */
+   uint64_t summary_end;         /**< The end LSN of the saved summary */
+   struct art* files;            /**< The completed files of the interrupted backup by server path */
+   uint64_t number_of_files;     /**< The number of completed files of the interrupted backup */
+   block_ref_table* changed;     /**< The blocks changed since the interrupted backup started */
+   FILE* log;                    /**< The record of the completed files */
+   uint64_t reused;              /**< The number of files reused */
+   pthread_mutex_t lock;         /**< The lock of the record */
+};
+
+/**
+ * Open the checkpoint of a server. The files of an interrupted backup are kept if
+ * it had the same parent, and a backup directory left by a crash is taken over
+ * @param srv The server
+ * @param parent The label of the parent backup, or NULL for a full backup
+ * @param resume [out] The checkpoint
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_resume_open(int srv, char* parent, struct resume** resume);
+
+/**
+ * Start recording a backup. The blocks changed since the interrupted backup
+ * started are summarized to decide which of its relation files can be reused
+ * @param resume The checkpoint
+ * @param label The label of the backup
+ * @param start_lsn The start LSN of the backup
+ * @param wal_dir The WAL directory of the server
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_resume_start(struct resume* resume, char* label, uint64_t start_lsn, char* wal_dir);
+
+/**
+ * Get the summary of an incremental backup from the summary saved by the
+ * interrupted backup and the blocks changed since
+ * @param resume The checkpoint
+ * @param start_lsn The start LSN of the summary
+ * @param end_lsn The end LSN of the summary
+ * @param brt [out] The block reference table
+ * @return 0 upon success, otherwise 1 if the saved summary can't be used
+ */
+int
+pgmoneta_resume_summary(struct resume* resume, uint64_t start_lsn, uint64_t end_lsn, block_ref_table** brt);
+
+/**
+ * Save the summary of an incremental backup for the next attempt
+ * @param resume The checkpoint
+ * @param start_lsn The start LSN of the summary
+ * @param end_lsn The end LSN of the summary
+ * @param brt The block reference table
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_resume_summary_save(struct resume* resume, uint64_t start_lsn, uint64_t end_lsn, block_ref_table* brt);
+
+/**
+ * Reuse a file of the interrupted backup. A relation fork is reused if no block of
+ * it changed since the interrupted backup started, any other file if its checksum
+ * still matches the server
+ * @param resume The checkpoint
+ * @param ssl The SSL connection
+ * @param socket The socket
+ * @param path The path of the file relative to the data cluster
+ * @param rlocator The relation of the file, or NULL if it isn't a relation fork
+ * @param frk The fork of the relation
+ * @param backup_data The data directory of the backup
+ * @return true if the file was moved into the backup, otherwise false
+ */
+bool
+pgmoneta_resume_reuse(struct resume* resume, SSL* ssl, int socket, char* path,
+                      struct rel_file_locator* rlocator, enum fork_number frk, char* backup_data);
+
+/**
+ * Record a completed file. Can be called from several workers
+ * @param resume The checkpoint
+ * @param path The path of the file relative to the data cluster
+ * @param local The path of the local file relative to the data directory
+ * @param checksum Record the checksum of the file
+ * @param backup_data The data directory of the backup
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_resume_complete(struct resume* resume, char* path, char* local, bool checksum, char* backup_data);
+
+/**
+ * Finish the checkpoint. A successful backup removes the checkpoint, otherwise
+ * the data directory of the backup is kept for the next backup
+ * @param resume The checkpoint
+ * @param success Whether the backup succeeded
+ * @param backup_data The data directory of the backup
+ */
+void
+pgmoneta_resume_finish(struct resume* resume, bool success, char* backup_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_SCHEDULER_H
+#define PGMONETA_SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* system */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define SCHEDULER_QUEUE_SIZE 256 /**< The maximum number of queued and running backups */
+
+#define SCHEDULER_FREE       0 /**< The slot is unused */
+#define SCHEDULER_QUEUED     1 /**< The backup waits to be started */
+#define SCHEDULER_RUNNING    2 /**< The backup is running */
+
+struct json;
+
+/** @struct scheduler_server
+ * Defines the backup queue statistics of a server
+ */
+struct scheduler_server
+{
+   atomic_int queued;        /**< The number of queued backups */
+   atomic_ullong dispatched; /**< The number of started backups */
+   atomic_ullong wait;       /**< The time the started backups waited in seconds */
+};
+
+/** @struct scheduler_job
+ * Defines a backup in the queue
+ */
+struct scheduler_job
+{
+   int state;            /**< The state (SCHEDULER_*) */
+   int server;           /**< The server */
+   int priority;         /**< The priority, higher first */
+   int client_fd;        /**< The client waiting for the result, or -1 */
+   uint8_t compression;  /**< The compression of the client */
+   uint8_t encryption;   /**< The encryption of the client */
+   pid_t pid;            /**< The process running the backup */
+   dev_t volume;         /**< The volume of the backup directory */
+   uint64_t sequence;    /**< The order of arrival */
+   time_t queued;        /**< The time the backup was queued */
+   struct json* payload; /**< The request */
+};
+
+/**
+ * Load the queue persisted by a previous run. The backups are queued
+ * without a client
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_scheduler_load(void);
+
+/**
+ * Queue a backup
+ * @param server The server
+ * @param client_fd The client waiting for the result, or -1
+ * @param compression The compression of the client
+ * @param encryption The encryption of the client
+ * @param payload The request, which is copied
+ * @return 0 upon success, 1 if the queue is full
+ */
+int
+pgmoneta_scheduler_enqueue(int server, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload);
+
+/**
+ * Get the next backup that can start within the concurrency limits.
+ * Backups are ordered by the priority of their server and then by arrival
+ * @return The backup, or NULL
+ */
+struct scheduler_job*
+pgmoneta_scheduler_next(void);
+
+/**
+ * Mark a backup as running
+ * @param job The backup
+ * @param pid The process running the backup
+ */
+void
+pgmoneta_scheduler_start(struct scheduler_job* job, pid_t pid);
+
+/**
+ * Remove a backup from the queue, and disconnect its client
+ * @param job The backup
+ */
+void
+pgmoneta_scheduler_remove(struct scheduler_job* job);
+
+/**
+ * Remove the backup run by a process that has exited
+ * @param pid The process
+ * @return True if the process ran a backup, otherwise false
+ */
+bool
+pgmoneta_scheduler_finish(pid_t pid);
+
+/**
+ * Release the queue, and disconnect the waiting clients. The queue
+ * is kept on disk
+ */
+void
+pgmoneta_scheduler_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
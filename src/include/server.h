@@ -38,6 +38,12 @@ extern "C" {
 #include <stdlib.h>
 #include <time.h>
 
+#define READ_BINARY_FILE_STATEMENT "pgmoneta_read_binary_file"
+
+#define BYTEAOID 17
+#define INT8OID 20
+#define TEXTOID 25
+
 /**
  * Stores the stats of a file
  */
@@ -116,20 +122,32 @@ bool
 pgmoneta_server_verify_connection(int srv);
 
 /**
- * Read a relation file from the server cluster
+ * Check the privileges needed to read files from the server cluster and
+ * prepare the pg_read_binary_file statement on the connection
+ * @param srv The server index
+ * @param ssl The SSL connection
+ * @param socket The socket
+ * @return return 0 if success, otherwise failure
+ */
+int
+pgmoneta_server_prepare_read_binary_file(int srv, SSL* ssl, int socket);
+
+/**
+ * Read a relation file from the server cluster using the statement
+ * prepared by pgmoneta_server_prepare_read_binary_file
  * @param srv The server index
  * @param ssl The SSL connection
  * @param relative_file_path The relative path of the relation file inside the data cluter
  * @param offset The offset of the file from where data retrieval should start
  * @param length The number of bytes that should be retrieved
  * @param socket The socket
- * @param [out] out The binary output
- * @param [out] len The binary output length
+ * @param buffer The buffer of at least length bytes
+ * @param [out] len The number of bytes read, 0 at the end of the file
  * @return return 0 if success, otherwise failure
  */
 int
-pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, int offset,
-                                 int length, int socket, uint8_t** out, int* len);
+pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, int64_t offset,
+                                 int64_t length, int socket, uint8_t* buffer, int64_t* len);
 
 /**
  * Force a checkpoint
@@ -155,6 +173,20 @@ pgmoneta_server_checkpoint(int srv, SSL* ssl, int socket, uint64_t* chkpt_lsn, u
 int
 pgmoneta_server_file_stat(int srv, SSL* ssl, int socket, char* relative_file_path, struct file_stats* stat);
 
+/**
+ * Compute the SHA-256 of the start of a file on the server, using the
+ * pg_read_binary_file privilege checked by pgmoneta_server_prepare_read_binary_file
+ * @param srv The server index
+ * @param ssl The SSL connection
+ * @param socket The socket
+ * @param relative_file_path The relative path of the file inside the data cluster
+ * @param length The number of bytes to hash
+ * @param sha256 [out] The hash value
+ * @return return 0 if success, otherwise failure
+ */
+int
+pgmoneta_server_file_checksum(int srv, SSL* ssl, int socket, char* relative_file_path, int64_t length, char** sha256);
+
 /**
  * Start the backup
  *
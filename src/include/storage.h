@@ -35,6 +35,7 @@ extern "C" {
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <art.h>
 #include <info.h>
 #include <workflow.h>
 
@@ -142,6 +143,31 @@ pgmoneta_sftp_wal_close(int server, char* filename, bool partial, sftp_file* fil
 bool
 pgmoneta_is_storage_engine_enabled(int engine);
 
+/**
+ * Upload a WAL file to the wal/ prefix of a server in a storage engine
+ * @param server The server index
+ * @param engine The storage engine flag (STORAGE_ENGINE_S3 or STORAGE_ENGINE_AZURE)
+ * @param directory The local directory holding the file
+ * @param file The file name
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_storage_upload_wal(int server, int engine, char* directory, char* file);
+
+/**
+ * Find the newest backup before a label that was uploaded by a storage engine.
+ * Only a valid backup with the same compression and encryption qualifies, so
+ * its remote objects use the same names and can be copied server-side
+ * @param server The server index
+ * @param label The label of the backup being uploaded
+ * @param engine The storage engine flag (STORAGE_ENGINE_S3 or STORAGE_ENGINE_AZURE)
+ * @param previous [out] The label of the previous upload, or NULL if none
+ * @param checksums [out] The file checksums of the previous upload (key=path, value=checksum), or NULL if none
+ * @return 0 on success, otherwise 1
+ */
+int
+pgmoneta_storage_previous_upload(int server, char* label, int engine, char** previous, struct art** checksums);
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,7 +52,8 @@ struct streamer
    struct encryptor* encryptor;       /**< The encryptor */
    struct deque* destinations;        /**< The streaming destinations */
    struct deque* failed_destinations; /**< The failed destinations */
-   char buffer[BUFFER_SIZE];          /**< The internal buffer */
+   char* buffer;                      /**< The internal buffer */
+   char* cbuf;                        /**< The compression buffer */
    size_t size;                       /**< The buffer data size */
    size_t capacity;                   /**< The buffer capacity */
    size_t written;                    /**< Total data streamed */
@@ -29,10 +29,24 @@
 #ifndef PGMONETA_TAR_H
 #define PGMONETA_TAR_H
 
+#include <deque.h>
+
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Callback invoked for each regular file of a streamed tar archive
+ * @param name The member path inside the archive
+ * @param data The member content, ownership is transferred to the callback
+ * @param size The member size
+ * @param arg The user argument
+ * @return 0 to continue, otherwise 1 to stop the iteration
+ */
+typedef int (*tar_member_cb)(char* name, void* data, size_t size, void* arg);
+
 /**
  * Create a tar archive of the given directory
  * @param src The source directory
@@ -51,6 +65,20 @@ pgmoneta_tar(char* src, char* dst);
 int
 pgmoneta_untar(char* src, char* dst);
 
+/**
+ * Stream the regular files of a tar archive to a callback without staging
+ * them on disk. The archive itself may be encrypted and/or compressed, in
+ * which case it is decrypted and decompressed while it is read.
+ * @param src The path to the tar file
+ * @param encryption The encryption type of the archive (ENCRYPTION_*)
+ * @param compression The compression type of the archive (COMPRESSION_*)
+ * @param cb The member callback
+ * @param arg The user argument passed to the callback
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_untar_stream(char* src, int encryption, int compression, tar_member_cb cb, void* arg);
+
 #ifdef __cplusplus
 }
 #endif
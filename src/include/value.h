@@ -36,6 +36,8 @@ extern "C" {
 #include <inttypes.h>
 #include <stdbool.h>
 
+struct memory_arena;
+
 typedef void (*data_destroy_cb)(uintptr_t data);
 typedef char* (*data_to_string_cb)(uintptr_t data, int32_t format, char* tag, int indent);
 
@@ -77,6 +79,7 @@ struct value
    uintptr_t data;               /**< The data, could be passed by value or by reference */
    data_destroy_cb destroy_data; /**< The callback to destroy data */
    data_to_string_cb to_string;  /**< The callback to convert data to string */
+   struct memory_arena* arena;   /**< The arena holding the value, or NULL for the heap */
 };
 
 /**
@@ -112,6 +115,21 @@ pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value
 int
 pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value);
 
+/**
+ * Create a value in an arena. Strings are copied into the arena. Data that
+ * lives on the heap is destroyed together with the arena, unless the value
+ * is destroyed first
+ * @param arena The arena, or NULL for the heap
+ * @param type The value type, ignored if config is set
+ * @param data The value data, type cast it to uintptr_t before passing into function
+ * @param config The configuration, or NULL
+ * @param value [out] The value
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgmoneta_value_create_with_arena(struct memory_arena* arena, enum value_type type, uintptr_t data,
+                                 struct value_config* config, struct value** value);
+
 /**
  * Destroy a value along with the data within
  * @param value The value
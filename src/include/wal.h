@@ -34,6 +34,8 @@ extern "C" {
 #endif
 
 #include <pgmoneta.h>
+#include <deque.h>
+#include <workers.h>
 
 #include <ev.h>
 #include <stdint.h>
@@ -94,6 +96,31 @@ pgmoneta_get_timeline_history(int srv, uint32_t tli, struct timeline_history** h
 void
 pgmoneta_free_timeline_history(struct timeline_history* history);
 
+/**
+ * Plan the WAL files a restore needs. The segments run from the start LSN
+ * to the target LSN along the history of the target timeline
+ * @param srv The server
+ * @param start_lsn The LSN the recovery starts from
+ * @param tli The target timeline, or 0 for the latest timeline
+ * @param lsn The target LSN, or UINT64_MAX for the end of the timeline
+ * @param history Include the timeline history files
+ * @param files [out] The WAL files as named in the WAL directory of the server
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_wal_restore_plan(int srv, uint64_t start_lsn, uint32_t tli, uint64_t lsn, bool history, struct deque** files);
+
+/**
+ * Decrypt and decompress WAL files of the server into a target directory
+ * @param srv The server
+ * @param files The WAL files as named in the WAL directory of the server
+ * @param target The target directory
+ * @param workers The optional workers
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_wal_stage(int srv, struct deque* files, char* target, struct workers* workers);
+
 /**
  * @brief Read OID mappings from PostgreSQL server
  *
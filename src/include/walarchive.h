@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGMONETA_WALARCHIVE_H
+#define PGMONETA_WALARCHIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* pgmoneta */
+#include <pgmoneta.h>
+
+/* system */
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WAL_ARCHIVE_CURSOR "wal_archive.cursor"
+#define WAL_ARCHIVE_GROUP  32 /**< The number of small files uploaded by one task */
+
+/** @struct wal_archive_cursor
+ * Defines the durable position of the WAL archive of a server
+ */
+struct wal_archive_cursor
+{
+   char segment[MISC_LENGTH]; /**< The newest segment archived together with all older segments */
+   time_t updated;            /**< The time the cursor was last moved */
+};
+
+/**
+ * Archive the WAL of all servers to the S3 and Azure storage engines
+ * @param argv The argv
+ */
+void
+pgmoneta_wal_archive(char** argv);
+
+/**
+ * Archive the WAL of a server to the S3 and Azure storage engines.
+ * Finished segments newer than the cursor are uploaded by the workers of
+ * the server, the .history and .partial files are uploaded in groups, and
+ * the cursor is moved past the segments that were uploaded without a gap
+ * @param server The server
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_wal_archive_server(int server);
+
+/**
+ * Is the WAL archive enabled
+ * @return True if wal_archive is set and the S3 or Azure storage engine is used
+ */
+bool
+pgmoneta_wal_archive_enabled(void);
+
+/**
+ * Read the cursor of the WAL archive of a server
+ * @param server The server
+ * @param cursor The cursor, empty if nothing has been archived yet
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_wal_archive_read_cursor(int server, struct wal_archive_cursor* cursor);
+
+/**
+ * Write the cursor of the WAL archive of a server
+ * @param server The server
+ * @param cursor The cursor
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_wal_archive_write_cursor(int server, struct wal_archive_cursor* cursor);
+
+/**
+ * Has a WAL file been archived. Always true when the WAL archive is disabled
+ * @param server The server
+ * @param file The WAL file name
+ * @return True if the segment of the file is at or before the cursor
+ */
+bool
+pgmoneta_wal_archive_is_archived(int server, char* file);
+
+/**
+ * Get how far the WAL archive of a server is behind
+ * @param server The server
+ * @param seconds The age of the oldest segment that is not archived
+ * @param bytes The size of the segments that are not archived
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_wal_archive_lag(int server, uint64_t* seconds, uint64_t* bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,7 +34,7 @@
 #include <wal.h>
 #include <walfile/wal_reader.h>
 
-extern struct partial_xlog_record* partial_record;
+extern _Thread_local struct partial_xlog_record* partial_record;
 
 /* Return Codes */
 #define PGMONETA_WAL_SUCCESS    0 /**< WAL operation succeeded */
@@ -109,6 +109,24 @@ struct walfile
 int
 pgmoneta_read_walfile(int server, char* path, struct walfile** wf);
 
+/**
+ * Read a WAL segment that is already held in memory
+ * @param server The server index
+ * @param name The WAL segment name
+ * @param data The segment content
+ * @param size The size of the segment content
+ * @param wf The WAL file structure to populate
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_read_walfile_buffer(int server, char* name, void* data, size_t size, struct walfile** wf);
+
+/**
+ * Release the partial record state of the calling thread
+ */
+void
+pgmoneta_reset_partial_record(void);
+
 /**
  * Write a WAL file
  * @param wf The WAL file structure
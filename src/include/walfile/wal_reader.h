@@ -179,6 +179,7 @@ enum wal_level {
 struct walfile;                    /* Forward declaration of walfile, defined in walfile.h. */
 struct xlog_long_page_header_data; /* Forward declaration of xlog_long_page_header_data, defined in walfile.h */
 struct block_ref_table;            /* Forward declaration of block reference table structure, defined in brt.h */
+struct rmgr_stats;                 /* Forward declaration of resource manager statistics, defined in rmgr.h */
 /**
  * @struct xlog_page_header_data
  * @brief Represents the header of an XLOG page.
@@ -239,6 +240,7 @@ struct xlog_record
  * - xlog_record: Pointer to the record's header structure
  * - data_buffer_bytes_read: Total Number of bytes read for the data portion
  * - xlog_record_bytes_read: Number of bytes read for the header portion
+ * - lsn: The LSN of the record
  */
 
 struct partial_xlog_record
@@ -247,6 +249,7 @@ struct partial_xlog_record
    char* xlog_record;               /**< Pointer to the xlog record. */
    uint32_t data_buffer_bytes_read; /**< Length of the total data read in data_buffer. */
    uint32_t xlog_record_bytes_read; /**< Length of the total data read in xlog_record buffer. */
+   xlog_rec_ptr lsn;                /**< The LSN of the record. */
 };
 
 /**
@@ -421,22 +424,27 @@ struct xid_timestamp_entry
  * This structure maintains a collection of XID -> timestamp mappings,
  * allowing efficient lookup of transaction commit times.
  *
+ * The map is an open-addressing hash table with linear probing. A slot
+ * holding INVALID_TRANSACTION_ID is free, so that XID cannot be stored.
+ *
  * This subsystem requires PostgreSQL track_commit_timestamp to be enabled.
  * If track_commit_timestamp is disabled, WAL transaction timestamp handling is
  * unsupported and startup will fail.
  *
  * Fields:
- * - entries: Deque of XID timestamp entries.
- * - sorted: Whether deque entries are sorted and ready for sequential lookup.
+ * - slots: The hash table slots.
+ * - capacity: The number of slots, always a power of two.
+ * - size: The number of used slots.
  */
 struct xid_timestamp_map
 {
-   struct deque* entries; /**< Deque of XID timestamp entries. */
-   bool sorted;           /**< Whether deque entries are sorted and ready for sequential lookup. */
+   struct xid_timestamp_entry* slots; /**< The hash table slots. */
+   size_t capacity;                   /**< The number of slots, always a power of two. */
+   size_t size;                       /**< The number of used slots. */
 };
 
 /* External variables */
-extern struct server* server_config;
+extern _Thread_local struct server* server_config;
 
 /**
  * Track the WAL magic value currently being displayed/decoded.
@@ -446,6 +454,19 @@ extern struct server* server_config;
 void pgmoneta_wal_set_current_magic(uint16_t magic_value);
 uint16_t pgmoneta_wal_get_current_magic(void);
 
+/**
+ * Track the number of WAL records displayed by the calling thread.
+ * The counter drives the limit option and the JSON record separator,
+ * and lets parallel renderers continue where another thread left off.
+ */
+void pgmoneta_wal_set_display_count(uint32_t count);
+uint32_t pgmoneta_wal_get_display_count(void);
+
+/**
+ * Release the server the calling thread decoded standalone WAL with
+ */
+void pgmoneta_wal_reset_server(void);
+
 /* Function definitions */
 
 /**
@@ -463,13 +484,26 @@ pgmoneta_validate_wal_filename(char* path, char** base_filename, xlog_seg_no* se
  * Parses a WAL file and populates server information.
  *
  * @param path The file path of the WAL file.
- * @param server The index of the server structure, if -1, config.servers[0] will be initialized based on magic value.
+ * @param server The index of the server structure, if -1, a server of the calling thread is initialized based on magic value.
  * @param wal_file The WAL file structure to be populated with parsed data.
  * @return 0 on success, otherwise 1.
  */
 int
 pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file);
 
+/**
+ * Parses a WAL segment that is already held in memory.
+ *
+ * @param name The WAL segment name, used for validation and the segment LSN.
+ * @param data The segment content.
+ * @param size The size of the segment content.
+ * @param server The index of the server structure, if -1, a server of the calling thread is initialized based on magic value.
+ * @param wal_file The WAL file structure to be populated with parsed data.
+ * @return 0 on success, otherwise 1.
+ */
+int
+pgmoneta_wal_parse_wal_buffer(char* name, void* data, size_t size, int server, struct walfile* wal_file);
+
 /**
  * Retrieves block data from the decoded XLOG record.
  *
@@ -579,6 +613,23 @@ pgmoneta_wal_record_modify_rmgr_occurance(struct decoded_xlog_record* record, ui
 void
 pgmoneta_wal_record_collect_stats(struct decoded_xlog_record* record, uint64_t start_lsn, uint64_t end_lsn);
 
+/**
+ * Collect detailed WAL statistics for resource managers into a caller owned table
+ * @param record The decoded WAL record to analyze
+ * @param start_lsn The start LSN
+ * @param end_lsn The end LSN
+ * @param stats The statistics table with RM_MAX_ID + 1 entries
+ */
+void
+pgmoneta_wal_record_collect_stats_into(struct decoded_xlog_record* record, uint64_t start_lsn, uint64_t end_lsn, struct rmgr_stats* stats);
+
+/**
+ * Merge a statistics table into the global resource manager statistics
+ * @param stats The statistics table with RM_MAX_ID + 1 entries
+ */
+void
+pgmoneta_wal_merge_stats(struct rmgr_stats* stats);
+
 /**
  * Summarizes the contents of a decoded WAL record
  *
@@ -634,9 +685,8 @@ pgmoneta_calculate_column_widths(struct walfile* wf, uint64_t start_lsn, uint64_
                                  struct column_widths* widths);
 
 /**
- * Create a new deque-backed XID timestamp map
+ * Create a new hash-indexed XID timestamp map
  *
- * @param initial_capacity Initial capacity hint for the map
  * @param map Output parameter for the created map
  * @return 0 on success, 1 on error
  */
@@ -662,6 +712,22 @@ pgmoneta_xid_timestamp_map_destroy(struct xid_timestamp_map* map);
 int
 pgmoneta_xid_timestamp_map_put(struct xid_timestamp_map* map, transaction_id xid, timestamp_tz timestamp);
 
+/**
+ * Add or update a transaction and all of its subtransactions with one timestamp
+ *
+ * The map grows at most once for the whole set, rather than once per entry.
+ *
+ * @param map The XID timestamp map
+ * @param xid The transaction ID
+ * @param subxacts The subtransaction IDs, may be NULL if nsubxacts is 0
+ * @param nsubxacts The number of subtransaction IDs
+ * @param timestamp The commit/abort timestamp
+ * @return 0 on success, 1 on error
+ */
+int
+pgmoneta_xid_timestamp_map_put_all(struct xid_timestamp_map* map, transaction_id xid,
+                                   transaction_id* subxacts, int nsubxacts, timestamp_tz timestamp);
+
 /**
  * Get the timestamp for a given XID
  *
@@ -682,6 +748,17 @@ pgmoneta_xid_timestamp_map_get(struct xid_timestamp_map* map, transaction_id xid
 size_t
 pgmoneta_xid_timestamp_map_size(struct xid_timestamp_map* map);
 
+/**
+ * Get the entries of the XID timestamp map in ascending XID order
+ *
+ * @param map The XID timestamp map
+ * @param entries Output parameter for the entries, owned by the caller
+ * @param count Output parameter for the number of entries
+ * @return 0 on success, 1 on error
+ */
+int
+pgmoneta_xid_timestamp_map_sorted(struct xid_timestamp_map* map, struct xid_timestamp_entry** entries, size_t* count);
+
 /**
  * Process a WAL record and extract XID -> timestamp mapping
  *
@@ -32,6 +32,8 @@
 #include <pgmoneta.h>
 #include <brt.h>
 
+#define WAL_SUMMARY_SEGMENTS 16 /**< The number of WAL segments rolled up into one summary */
+
 /**
  * Summarize the WAL records in the range [start_lsn, end_lsn) for a timeline, assuming that
  * both start and end LSNs belongs to the same timeline.
@@ -61,4 +63,55 @@ pgmoneta_summarize_wal(int srv, char* wal_dir, uint64_t start_lsn, uint64_t end_
 int
 pgmoneta_wal_summary_save(int srv, uint64_t s_lsn, uint64_t e_lsn, block_ref_table* brt);
 
+/**
+ * Start the WAL summarizer of a server unless it is already running.
+ * Called by the WAL receiver when a segment is finished
+ * @param srv The server
+ * @param argv The argv
+ */
+void
+pgmoneta_wal_summarizer(int srv, char** argv);
+
+/**
+ * Release the WAL summarizer lock of the server whose summarizer exited.
+ * Called by the SIGCHLD reaper, so a summarizer that crashed or was killed
+ * doesn't keep later ones from starting
+ * @param pid The process id of the reaped child
+ */
+void
+pgmoneta_wal_summarizer_exited(pid_t pid);
+
+/**
+ * Summarize the finished WAL segments of a server that aren't summarized yet.
+ * The summaries are aligned to WAL_SUMMARY_SEGMENTS segments and the pieces
+ * of a group are rolled up once the group is complete. Summaries whose WAL
+ * has been removed are deleted
+ * @param srv The server
+ * @return 0 is success, otherwise failure
+ */
+int
+pgmoneta_wal_summarize_server(int srv);
+
+/**
+ * Get the block reference table for the range [start_lsn, end_lsn) by merging the
+ * summaries of the WAL summarizer and summarizing the WAL that they don't cover
+ * @param srv The server
+ * @param wal_dir The directory to the wal segments (Optional and is used for testing)
+ * @param start_lsn The start lsn
+ * @param end_lsn The end lsn
+ * @param brt [out] The BRT output
+ * @return 0 is success, otherwise failure
+ */
+int
+pgmoneta_wal_summary_collect(int srv, char* wal_dir, uint64_t start_lsn, uint64_t end_lsn, block_ref_table** brt);
+
+/**
+ * Get how far the WAL summarizer of a server is behind the WAL receiver
+ * @param srv The server
+ * @param bytes [out] The number of bytes of finished WAL that isn't summarized
+ * @return 0 is success, otherwise failure
+ */
+int
+pgmoneta_wal_summary_lag(int srv, uint64_t* bytes);
+
 #endif
\ No newline at end of file
@@ -128,8 +128,9 @@ extern "C" {
 #define NODE_INCREMENTAL_LABEL           "incremental_label"   /* The label of the incremental backup */
 #define NODE_LABEL                       "label"               /* The backup label */
 #define NODE_LABELS                      "labels"              /* A list of backup labels */
-#define NODE_MANIFEST                    "manifest"            /* The manifest */
+#define NODE_MANIFEST                    "manifest"            /* The path to the manifest */
 #define NODE_PRIMARY                     "primary"             /* Is the server a primary */
+#define NODE_RECLAIM                     "reclaim"             /* The workers reclaiming deleted backups */
 #define NODE_RECOVERY_INFO               "recovery_info"       /* The recovery information */
 #define NODE_SERVER_BACKUP               "server_backup"       /* The backup directory of the server */
 #define NODE_S3_OBJECTS                  "s3_objects"          /* The list of S3 objects */
@@ -138,6 +139,7 @@ extern "C" {
 #define NODE_TARGET_BASE                 "target_base"         /* The target base directory */
 #define NODE_TARGET_FILE                 "target_file"         /* The target file */
 #define NODE_TARGET_ROOT                 "target_root"         /* The target root directory */
+#define NODE_WAL_STAGING                 "wal_staging"         /* The workers staging WAL during a restore */
 #define NODE_WORKER_ERRORS               "worker_errors"       /* Deque of worker failure messages */
 
 /* Supplied by the user */
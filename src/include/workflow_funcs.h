@@ -53,6 +53,16 @@ pgmoneta_create_basebackup(void);
 struct workflow*
 pgmoneta_create_incremental_backup(void);
 
+/**
+ * Take a full backup by reading the files of the cluster over several
+ * connections between the start and the stop of the backup, instead of BASE_BACKUP
+ * @param name The name of the workflow
+ * @param nodes The nodes
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_parallel_backup_execute(char* name, struct art* nodes);
+
 /**
  * Create a workflow for the restore
  * @return The workflow
@@ -37,8 +37,19 @@ extern "C" {
 #include <compression.h>
 #include <json.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 
+#define ZSTD_DICTIONARY_SIZE        (112 * 1024)
+#define ZSTD_DICTIONARY_FILE_SIZE   (64 * 1024)
+#define ZSTD_DICTIONARY_SAMPLE_SIZE (16 * 1024 * 1024)
+#define ZSTD_DICTIONARY_MIN_SAMPLES 32
+
+/** @struct zstd_dictionary
+ * A trained dictionary shared by the workers compressing a directory
+ */
+struct zstd_dictionary;
+
 /**
  * ZSTD decompress a single file, also remove the original file
  * @param ssl The SSL
@@ -79,6 +90,16 @@ pgmoneta_zstandardc_request(SSL* ssl, int client_fd, uint8_t compression, uint8_
 int
 pgmoneta_zstandardc_file(char* from, char* to);
 
+/**
+ * Compress a file with a compression level
+ * @param from The from name
+ * @param to The to name
+ * @param level The compression level
+ * @return The result
+ */
+int
+pgmoneta_zstandardc_file_level(char* from, char* to, int level);
+
 /**
  * ZSTD compress a string
  * @param s The original string
@@ -107,6 +128,45 @@ pgmoneta_zstdd_string(unsigned char* compressed_buffer, size_t compressed_size,
 int
 pgmoneta_zstd_compressor_create(struct compressor** compressor);
 
+/**
+ * Train a dictionary from the small files of a backup directory. The dictionary
+ * is stored as the backup.dictionary file of the backup, and is reused when the
+ * file is already there, as for an incremental backup sharing the dictionary of
+ * its parent. The dictionary is found through the identifier in the frame header
+ * when decompressing
+ * @param directory The backup directory
+ * @param level The compression level
+ * @param dictionary [out] The dictionary, or NULL if there is too little to train on
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_zstandard_dictionary_train(char* directory, int level, struct zstd_dictionary** dictionary);
+
+/**
+ * Get the identifier of a dictionary
+ * @param dictionary The dictionary
+ * @return The identifier, or 0
+ */
+uint32_t
+pgmoneta_zstandard_dictionary_id(struct zstd_dictionary* dictionary);
+
+/**
+ * Compress a small file with a dictionary, also remove the original file
+ * @param from The from name
+ * @param to The to name
+ * @param dictionary The dictionary
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgmoneta_zstandardc_file_dictionary(char* from, char* to, struct zstd_dictionary* dictionary);
+
+/**
+ * Destroy a dictionary
+ * @param dictionary The dictionary
+ */
+void
+pgmoneta_zstandard_dictionary_destroy(struct zstd_dictionary* dictionary);
+
 #ifdef __cplusplus
 }
 #endif
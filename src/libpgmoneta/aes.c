@@ -30,6 +30,7 @@
 #include <aes.h>
 #include <logging.h>
 #include <management.h>
+#include <memory.h>
 #include <progress.h>
 #include <security.h>
 #include <utils.h>
@@ -161,15 +162,23 @@ ensure_capacity(unsigned char** buf, size_t* capacity, size_t required)
 
    pgmoneta_log_debug("ensure_capacity: grow buffer %zu -> %zu (required %zu)", *capacity, new_cap, required);
 
-   tmp = realloc(*buf, new_cap);
+   tmp = pgmoneta_memory_buffer_acquire(new_cap);
    if (tmp == NULL)
    {
       pgmoneta_log_error("ensure_capacity: failed to allocate memory");
       return 1;
    }
 
+   /* Pooled buffers are reused, so clear the old content before it goes back */
+   if (*buf != NULL)
+   {
+      memcpy(tmp, *buf, *capacity);
+      pgmoneta_cleanse(*buf, *capacity);
+      pgmoneta_memory_buffer_release(*buf);
+   }
+
    *buf = tmp;
-   *capacity = new_cap;
+   *capacity = pgmoneta_memory_buffer_capacity(tmp);
 
    return 0;
 }
@@ -1922,7 +1931,7 @@ aes_encryptor_close(struct encryptor* encryptor)
    if (this->out_buf != NULL)
    {
       pgmoneta_cleanse(this->out_buf, this->out_capacity);
-      free(this->out_buf);
+      pgmoneta_memory_buffer_release(this->out_buf);
       this->out_buf = NULL;
    }
    this->out_capacity = 0;
@@ -2250,7 +2259,7 @@ noop_encryptor_close(struct encryptor* encryptor)
       return;
    }
 
-   free(this->out_buf);
+   pgmoneta_memory_buffer_release(this->out_buf);
    this->out_buf = NULL;
    this->out_capacity = 0;
 }
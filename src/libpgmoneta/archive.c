@@ -30,6 +30,7 @@
 #include <pgmoneta.h>
 #include <achv.h>
 #include <backup.h>
+#include <bandwidth.h>
 #include <files.h>
 #include <logging.h>
 #include <management.h>
@@ -53,6 +54,7 @@
 #define NAME "archive"
 
 static char* basebackup_archive_extension(void);
+static bool archive_read_compressed(struct archive* a, int compression_type);
 
 void
 pgmoneta_archive(SSL* ssl, int client_fd, int server, uint8_t compression, uint8_t encryption, struct json* payload)
@@ -82,6 +84,8 @@ pgmoneta_archive(SSL* ssl, int client_fd, int server, uint8_t compression, uint8
 
    config = (struct main_configuration*)shmem;
 
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_ARCHIVE);
+
 #ifdef HAVE_FREEBSD
    clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
 #else
@@ -231,6 +235,7 @@ pgmoneta_archive(SSL* ssl, int client_fd, int server, uint8_t compression, uint8
    pgmoneta_log_debug("Archive: Released repository lock");
 #endif
 
+   pgmoneta_bandwidth_end();
    pgmoneta_stop_logging();
 
    free(label);
@@ -257,6 +262,7 @@ error:
    config->common.servers[server].active_archive = false;
    atomic_store(&config->common.servers[server].repository, false);
 
+   pgmoneta_bandwidth_end();
    pgmoneta_stop_logging();
 
    free(label);
@@ -380,6 +386,8 @@ pgmoneta_receive_archive_files(int srv, SSL* ssl, int socket, struct stream_buff
 
          if (msg->kind == 'd' && msg->length > 0)
          {
+            pgmoneta_bandwidth_consume(msg->length);
+
             // copy data
             if (fwrite(msg->data, msg->length, 1, file) != 1)
             {
@@ -699,6 +707,8 @@ pgmoneta_receive_archive_stream(int srv, SSL* ssl, int socket, struct stream_buf
                   break;
                }
 
+               pgmoneta_bandwidth_consume(msg->length - 1);
+
                if (fwrite(msg->data + 1, msg->length - 1, 1, file) != 1)
                {
                   pgmoneta_log_error("could not write to file %s", file_path);
@@ -836,7 +846,12 @@ pgmoneta_extract_backup_tar_file(char* file_path, char* destination, char* manif
    a = archive_read_new();
    archive_read_support_format_tar(a);
 
-   if (COMPRESSION_IS_SERVER(config->compression_type))
+   if (COMPRESSION_IS_SERVER(config->compression_type) && archive_read_compressed(a, config->compression_type))
+   {
+      /* The entries are decoded while they are read, so the tar isn't written out in between */
+      archive_name = pgmoneta_append(archive_name, file_path);
+   }
+   else if (COMPRESSION_IS_SERVER(config->compression_type))
    {
       if (pgmoneta_vfile_create_local(file_path, "r", &reader))
       {
@@ -1067,6 +1082,30 @@ error:
    return 1;
 }
 
+static bool
+archive_read_compressed(struct archive* a, int compression_type)
+{
+   int ret = ARCHIVE_FATAL;
+
+   switch (COMPRESSION_ALGORITHM(compression_type))
+   {
+      case COMPRESSION_ALG_GZIP:
+         ret = archive_read_support_filter_gzip(a);
+         break;
+      case COMPRESSION_ALG_ZSTD:
+         ret = archive_read_support_filter_zstd(a);
+         break;
+      case COMPRESSION_ALG_LZ4:
+         ret = archive_read_support_filter_lz4(a);
+         break;
+      default:
+         break;
+   }
+
+   /* ARCHIVE_WARN means libarchive would run an external program to decode */
+   return ret == ARCHIVE_OK;
+}
+
 static char*
 basebackup_archive_extension(void)
 {
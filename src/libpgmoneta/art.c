@@ -29,14 +29,24 @@
 #include <art.h>
 #include <json.h>
 #include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
+#include <stdlib.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define IS_LEAF(x)  (((uintptr_t)(x) & 1))
 #define SET_LEAF(x) ((void*)((uintptr_t)(x) | 1))
 #define GET_LEAF(x) ((struct art_leaf*)((void*)((uintptr_t)(x) & ~1)))
 
+#define ART_CACHE_LINE     64
+#define ART_MAX_SLAB_NODES 64
+
 enum art_node_type {
    Node4,
    Node16,
@@ -50,24 +60,29 @@ enum art_node_type {
  * All node types should be aligned
  * because we need the last bit to be 0 as a flag bit for leaf.
  * So that leaf can be treated as a node as well and stored in the children field,
- * and only converted back when necessary
+ * and only converted back when necessary.
+ * The complete prefix is always stored, so the prefix never has to be
+ * recovered from a leaf. Up to MAX_PREFIX_LEN bytes are kept inline in the
+ * header cache line, longer prefixes live in their own buffer
  */
 struct art_node
 {
    uint32_t prefix_len;                  /**< The actual length of the prefix segment */
    enum art_node_type type;              /**< The node type */
    uint8_t num_children;                 /**< The number of children */
-   unsigned char prefix[MAX_PREFIX_LEN]; /**< The (potentially partial) prefix, only record up to MAX_PREFIX_LEN characters */
+   unsigned char prefix[MAX_PREFIX_LEN]; /**< The prefix, when it is at most MAX_PREFIX_LEN characters */
+   unsigned char* long_prefix;           /**< The prefix, when it is longer than MAX_PREFIX_LEN characters */
 } __attribute__((aligned(64)));
 
 /**
- * The ART leaf with key buffer of arbitrary size
+ * The ART leaf. A heap leaf keeps its key right behind the leaf in the
+ * same allocation, an arena leaf points at the key interned in the arena
  */
 struct art_leaf
 {
    struct value* value;
    uint32_t key_len;
-   unsigned char key[];
+   unsigned char* key;
 } __attribute__((aligned(64)));
 
 /**
@@ -128,50 +143,83 @@ struct to_string_param
 static struct art_node**
 node_get_child(struct art_node* node, unsigned char ch);
 
-// Get the left most leaf of a child
-static struct art_leaf*
-node_get_minimum(struct art_node* node);
+static void
+create_art_leaf(struct art* t, struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config);
 
 static void
-create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config);
+create_art_node(struct art* t, struct art_node** node, enum art_node_type type);
 
+/**
+ * Take a node of the given type from the pool of the tree
+ * @param t The tree
+ * @param type The node type
+ * @param size The size of the node
+ * @return The node, or NULL if out of memory
+ */
+static void*
+node_alloc(struct art* t, enum art_node_type type, size_t size);
+
+/**
+ * Return a node, and its long prefix if any, to the pool of the tree
+ * @param t The tree
+ * @param node The node
+ */
 static void
-create_art_node(struct art_node** node, enum art_node_type type);
+node_release(struct art* t, struct art_node* node);
 
+/**
+ * Release the slabs of all pools of a heap tree
+ * @param t The tree
+ */
 static void
-create_art_node4(struct art_node4** node);
+pools_destroy(struct art* t);
+
+/**
+ * Get the complete prefix of a node
+ * @param node The node
+ * @return The prefix
+ */
+static unsigned char*
+node_prefix(struct art_node* node);
 
+/**
+ * Set the prefix of a node. The new prefix may overlap the current one
+ * @param t The tree
+ * @param node The node
+ * @param prefix The prefix
+ * @param len The length of the prefix
+ */
 static void
-create_art_node16(struct art_node16** node);
+node_set_prefix(struct art* t, struct art_node* node, unsigned char* prefix, uint32_t len);
 
 static void
-create_art_node48(struct art_node48** node);
+create_art_node4(struct art* t, struct art_node4** node);
 
 static void
-create_art_node256(struct art_node256** node);
+create_art_node16(struct art* t, struct art_node16** node);
 
-// Destroy ART nodes/leaves recursively
 static void
-destroy_art_node(struct art_node* node);
+create_art_node48(struct art* t, struct art_node48** node);
 
-static int
-art_iterate(struct art* t, art_callback cb, void* data);
+static void
+create_art_node256(struct art* t, struct art_node256** node);
 
 /**
- * Get where the keys diverge starting from depth.
- * This function only compares within the partial prefix range
+ * Destroy ART nodes/leaves recursively
+ * @param t The tree
  * @param node The node
- * @param key The key
- * @param depth The starting depth
- * @param key_len The length of the key
- * @return The length of the part of the prefix that matches
+ * @param recycle Whether to return the nodes to the pools, rather than
+ * leaving them to go away with the slabs
  */
-static uint32_t
-check_prefix_partial(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t key_len);
+static void
+destroy_art_node(struct art* t, struct art_node* node, bool recycle);
+
+static int
+art_iterate(struct art* t, art_callback cb, void* data);
 
 /**
  * Get where the keys diverge starting from depth.
- * This function compares with the complete key to determine if diverging point goes beyond current prefix or partial prefix
+ * The complete prefix is stored, so this is exact
  * @param node The node
  * @param key The key
  * @param depth The starting depth
@@ -203,6 +251,32 @@ leaf_match(struct art_leaf* leaf, unsigned char* key, uint32_t key_len);
 static int
 find_index(unsigned char ch, unsigned char* keys, int length);
 
+/**
+ * Find the child of a node16 for a key character, comparing all keys at once
+ * when SSE2 or NEON is available
+ * @param node The node
+ * @param ch The key character
+ * @return The index, or -1 if not found
+ */
+static int
+node16_find_child(struct art_node16* node, unsigned char ch);
+
+/**
+ * Build a subtree bottom-up from a range of sorted keys
+ * @param t The tree
+ * @param keys The keys
+ * @param lens The lengths of the keys, including the terminator
+ * @param values The value data
+ * @param type The value type
+ * @param start The first key of the range
+ * @param end One past the last key of the range
+ * @param depth The depth all keys of the range share
+ * @param count [out] The number of distinct keys
+ * @return The subtree
+ */
+static struct art_node*
+bulk_build(struct art* t, char** keys, uint32_t* lens, uintptr_t* values, enum value_type type, int start, int end, uint32_t depth, uint64_t* count);
+
 /**
  * Insert a value into a node recursively, adopting lazy expansion and path compression --
  * Expand the leaf, or split inner node should keys diverge within node's prefix range
@@ -218,7 +292,7 @@ find_index(unsigned char ch, unsigned char* keys, int length);
  * @return Old value if the key exists, otherwise NULL
  */
 static struct value*
-art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new);
+art_node_insert(struct art* t, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new);
 
 /**
  * Delete a value from a node recursively.
@@ -230,13 +304,13 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
  * @return Deleted value if the key exists, otherwise NULL
  */
 static struct art_leaf*
-art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len);
+art_node_delete(struct art* t, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len);
 
 static int
 art_node_iterate(struct art_node* node, art_callback cb, void* data);
 
 static void
-node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child);
+node_add_child(struct art* t, struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 /**
  * Add a child to the node. The function assumes node is not NULL,
@@ -249,13 +323,13 @@ node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char
  * @param child The child
  */
 static void
-node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child);
+node4_add_child(struct art* t, struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
-node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child);
+node16_add_child(struct art* t, struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
-node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child);
+node48_add_child(struct art* t, struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
 node256_add_child(struct art_node256* node, unsigned char ch, void* child);
@@ -264,19 +338,19 @@ node256_add_child(struct art_node256* node, unsigned char ch, void* child);
 // They also do not free the leaf node for bookkeeping purpose. The key insight is that due to path compression,
 // no node will have only one child, if node has only one child after deletion, it merges with this child
 static void
-node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned char ch);
+node_remove_child(struct art* t, struct art_node* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch);
+node4_remove_child(struct art* t, struct art_node4* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch);
+node16_remove_child(struct art* t, struct art_node16* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch);
+node48_remove_child(struct art* t, struct art_node48* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsigned char ch);
+node256_remove_child(struct art* t, struct art_node256* node, struct art_node** node_ref, unsigned char ch);
 
 static void
 copy_header(struct art_node* dest, struct art_node* src);
@@ -307,11 +381,21 @@ to_text_string(struct art* t, char* tag, int indent);
 
 int
 pgmoneta_art_create(struct art** tree)
+{
+   return pgmoneta_art_create_with_arena(NULL, tree);
+}
+
+int
+pgmoneta_art_create_with_arena(struct memory_arena* arena, struct art** tree)
 {
    struct art* t = NULL;
-   t = malloc(sizeof(struct art));
-   t->size = 0;
-   t->root = NULL;
+   t = pgmoneta_memory_alloc(arena, sizeof(struct art));
+   if (t == NULL)
+   {
+      return 1;
+   }
+   memset(t, 0, sizeof(struct art));
+   t->arena = arena;
    *tree = t;
    return 0;
 }
@@ -323,7 +407,13 @@ pgmoneta_art_destroy(struct art* tree)
    {
       return 0;
    }
-   destroy_art_node(tree->root);
+   if (tree->arena != NULL)
+   {
+      /* Nodes, leaves and values live in the arena and go away with it */
+      return 0;
+   }
+   destroy_art_node(tree, tree->root, false);
+   pools_destroy(tree);
    free(tree);
    return 0;
 }
@@ -406,7 +496,6 @@ pgmoneta_art_prefix_search(struct art* t, char* prefix, char*** matches, int max
    uint32_t key_len = 0;
    unsigned char* key = (unsigned char*)prefix;
    struct prefix_search_state state;
-   struct art_leaf* min_leaf = NULL;
 
    if (t == NULL || t->root == NULL || matches == NULL || max_matches <= 0)
    {
@@ -447,8 +536,8 @@ pgmoneta_art_prefix_search(struct art* t, char* prefix, char*** matches, int max
          return state.current_count;
       }
 
-      uint32_t cpl = check_prefix_partial(node, key, depth, key_len);
-      if (cpl < min(node->prefix_len, MAX_PREFIX_LEN) && depth + cpl < key_len)
+      uint32_t cpl = check_prefix(node, key, depth, key_len);
+      if (cpl < node->prefix_len && depth + cpl < key_len)
       {
          return state.current_count;
       }
@@ -456,11 +545,8 @@ pgmoneta_art_prefix_search(struct art* t, char* prefix, char*** matches, int max
       depth += node->prefix_len;
       if (depth >= key_len)
       {
-         min_leaf = node_get_minimum(node);
-         if (min_leaf != NULL && min_leaf->key_len >= key_len && strncmp((char*)min_leaf->key, prefix, key_len) == 0)
-         {
-            art_node_iterate(node, prefix_search_cb, &state);
-         }
+         // the prefix is complete, so every key below the node matches
+         art_node_iterate(node, prefix_search_cb, &state);
          return state.current_count;
       }
 
@@ -483,7 +569,7 @@ pgmoneta_art_insert(struct art* t, char* key, uintptr_t value, enum value_type t
       // c'mon, at least create a tree first...
       goto error;
    }
-   old_val = art_node_insert(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, type, NULL, &new);
+   old_val = art_node_insert(t, t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, type, NULL, &new);
    pgmoneta_value_destroy(old_val);
    if (new)
    {
@@ -503,7 +589,7 @@ pgmoneta_art_insert_with_config(struct art* t, char* key, uintptr_t value, struc
    {
       goto error;
    }
-   old_val = art_node_insert(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, ValueRef, config, &new);
+   old_val = art_node_insert(t, t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, ValueRef, config, &new);
    pgmoneta_value_destroy(old_val);
    if (new)
    {
@@ -514,6 +600,68 @@ error:
    return 1;
 }
 
+int
+pgmoneta_art_bulk_load(struct art* t, char** keys, uintptr_t* values, enum value_type type, int count)
+{
+   uint32_t* lens = NULL;
+   uint64_t loaded = 0;
+   bool sorted = true;
+
+   if (t == NULL || keys == NULL || values == NULL || type == ValueNone || count < 0)
+   {
+      goto error;
+   }
+
+   if (count == 0)
+   {
+      return 0;
+   }
+
+   lens = malloc(count * sizeof(uint32_t));
+   if (lens == NULL)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < count; i++)
+   {
+      if (keys[i] == NULL)
+      {
+         goto error;
+      }
+      lens[i] = strlen(keys[i]) + 1;
+      if (i > 0 && sorted && strcmp(keys[i - 1], keys[i]) > 0)
+      {
+         sorted = false;
+      }
+   }
+
+   if (!sorted || t->root != NULL)
+   {
+      for (int i = 0; i < count; i++)
+      {
+         if (pgmoneta_art_insert(t, keys[i], values[i], type))
+         {
+            goto error;
+         }
+      }
+   }
+   else
+   {
+      t->root = bulk_build(t, keys, lens, values, type, 0, count, 0, &loaded);
+      t->size = loaded;
+   }
+
+   free(lens);
+
+   return 0;
+
+error:
+   free(lens);
+
+   return 1;
+}
+
 int
 pgmoneta_art_delete(struct art* t, char* key)
 {
@@ -522,14 +670,14 @@ pgmoneta_art_delete(struct art* t, char* key)
    {
       return 1;
    }
-   l = art_node_delete(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1);
+   l = art_node_delete(t, t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1);
    if (l != NULL)
    {
       t->size--;
       pgmoneta_value_destroy(l->value);
    }
 
-   free(l);
+   pgmoneta_memory_release(t->arena, l);
    return 0;
 }
 
@@ -540,7 +688,7 @@ pgmoneta_art_clear(struct art* t)
    {
       return 0;
    }
-   destroy_art_node(t->root);
+   destroy_art_node(t, t->root, true);
    t->root = NULL;
    t->size = 0;
    return 0;
@@ -575,34 +723,46 @@ min(uint32_t a, uint32_t b)
 }
 
 static void
-create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config)
+create_art_leaf(struct art* t, struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config)
 {
    struct art_leaf* l = NULL;
-   l = malloc(sizeof(struct art_leaf) + key_len);
-   memset(l, 0, sizeof(struct art_leaf) + key_len);
-   if (config != NULL)
+   if (t->arena != NULL)
    {
-      pgmoneta_value_create_with_config(value, config, &l->value);
+      l = pgmoneta_memory_alloc(t->arena, sizeof(struct art_leaf));
+      memset(l, 0, sizeof(struct art_leaf));
+      if (key_len > 0 && key[key_len - 1] == '\0')
+      {
+         /* String keys repeat across objects, so share one copy */
+         l->key = (unsigned char*)pgmoneta_memory_arena_intern(t->arena, (char*)key, key_len - 1);
+      }
+      else
+      {
+         l->key = pgmoneta_memory_alloc(t->arena, key_len);
+         memcpy(l->key, key, key_len);
+      }
    }
    else
    {
-      pgmoneta_value_create(type, value, &l->value);
+      l = malloc(sizeof(struct art_leaf) + key_len);
+      memset(l, 0, sizeof(struct art_leaf) + key_len);
+      l->key = (unsigned char*)(l + 1);
+      memcpy(l->key, key, key_len);
    }
+   pgmoneta_value_create_with_arena(t->arena, type, value, config, &l->value);
 
    l->key_len = key_len;
-   memcpy(l->key, key, key_len);
    *leaf = l;
 }
 
 static void
-create_art_node(struct art_node** node, enum art_node_type type)
+create_art_node(struct art* t, struct art_node** node, enum art_node_type type)
 {
    struct art_node* n = NULL;
    switch (type)
    {
       case Node4:
       {
-         struct art_node4* n4 = malloc(sizeof(struct art_node4));
+         struct art_node4* n4 = node_alloc(t, Node4, sizeof(struct art_node4));
          memset(n4, 0, sizeof(struct art_node4));
          n4->node.type = Node4;
          n = (struct art_node*)n4;
@@ -610,7 +770,7 @@ create_art_node(struct art_node** node, enum art_node_type type)
       }
       case Node16:
       {
-         struct art_node16* n16 = malloc(sizeof(struct art_node16));
+         struct art_node16* n16 = node_alloc(t, Node16, sizeof(struct art_node16));
          memset(n16, 0, sizeof(struct art_node16));
          n16->node.type = Node16;
          n = (struct art_node*)n16;
@@ -618,7 +778,7 @@ create_art_node(struct art_node** node, enum art_node_type type)
       }
       case Node48:
       {
-         struct art_node48* n48 = malloc(sizeof(struct art_node48));
+         struct art_node48* n48 = node_alloc(t, Node48, sizeof(struct art_node48));
          memset(n48, 0, sizeof(struct art_node48));
          n48->node.type = Node48;
          n = (struct art_node*)n48;
@@ -626,7 +786,7 @@ create_art_node(struct art_node** node, enum art_node_type type)
       }
       case Node256:
       {
-         struct art_node256* n256 = malloc(sizeof(struct art_node256));
+         struct art_node256* n256 = node_alloc(t, Node256, sizeof(struct art_node256));
          memset(n256, 0, sizeof(struct art_node256));
          n256->node.type = Node256;
          n = (struct art_node*)n256;
@@ -637,39 +797,163 @@ create_art_node(struct art_node** node, enum art_node_type type)
 }
 
 static void
-create_art_node4(struct art_node4** node)
+create_art_node4(struct art* t, struct art_node4** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node4);
+   create_art_node(t, &n, Node4);
    *node = (struct art_node4*)n;
 }
 
 static void
-create_art_node16(struct art_node16** node)
+create_art_node16(struct art* t, struct art_node16** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node16);
+   create_art_node(t, &n, Node16);
    *node = (struct art_node16*)n;
 }
 
 static void
-create_art_node48(struct art_node48** node)
+create_art_node48(struct art* t, struct art_node48** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node48);
+   create_art_node(t, &n, Node48);
    *node = (struct art_node48*)n;
 }
 
 static void
-create_art_node256(struct art_node256** node)
+create_art_node256(struct art* t, struct art_node256** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node256);
+   create_art_node(t, &n, Node256);
    *node = (struct art_node256*)n;
 }
 
+static void*
+node_alloc(struct art* t, enum art_node_type type, size_t size)
+{
+   struct art_pool* pool = &t->pools[type];
+   void** slabs = NULL;
+   char* slab = NULL;
+   uint32_t max_slabs = 0;
+   void* n = NULL;
+
+   if (pool->free != NULL)
+   {
+      n = pool->free;
+      pool->free = *(void**)n;
+      return n;
+   }
+
+   if (t->arena != NULL)
+   {
+      /* The arena carves nodes out of its blocks already */
+      return pgmoneta_memory_alloc(t->arena, size);
+   }
+
+   if (pool->next == pool->end)
+   {
+      if (pool->num_slabs == pool->max_slabs)
+      {
+         max_slabs = pool->max_slabs == 0 ? 4 : pool->max_slabs * 2;
+         slabs = realloc(pool->slabs, max_slabs * sizeof(void*));
+         if (slabs == NULL)
+         {
+            return NULL;
+         }
+         pool->slabs = slabs;
+         pool->max_slabs = max_slabs;
+      }
+
+      /* Start with a single node so that the many small trees, like the
+       * ones behind JSON objects, stay small */
+      if (pool->slab_nodes == 0)
+      {
+         pool->slab_nodes = 1;
+      }
+
+      /* Every node type is a multiple of the cache line */
+      slab = aligned_alloc(ART_CACHE_LINE, size * pool->slab_nodes);
+      if (slab == NULL)
+      {
+         return NULL;
+      }
+
+      pool->slabs[pool->num_slabs++] = slab;
+      pool->next = slab;
+      pool->end = slab + size * pool->slab_nodes;
+      pool->slab_nodes = min(pool->slab_nodes * 2, ART_MAX_SLAB_NODES);
+   }
+
+   n = pool->next;
+   pool->next += size;
+
+   return n;
+}
+
+static void
+node_release(struct art* t, struct art_node* node)
+{
+   struct art_pool* pool = NULL;
+
+   if (node == NULL)
+   {
+      return;
+   }
+
+   pool = &t->pools[node->type];
+
+   pgmoneta_memory_release(t->arena, node->long_prefix);
+   node->long_prefix = NULL;
+
+   *(void**)node = pool->free;
+   pool->free = node;
+}
+
+static void
+pools_destroy(struct art* t)
+{
+   for (int i = 0; i < 4; i++)
+   {
+      struct art_pool* pool = &t->pools[i];
+
+      for (uint32_t j = 0; j < pool->num_slabs; j++)
+      {
+         free(pool->slabs[j]);
+      }
+      free(pool->slabs);
+      memset(pool, 0, sizeof(struct art_pool));
+   }
+}
+
+static unsigned char*
+node_prefix(struct art_node* node)
+{
+   return node->prefix_len > MAX_PREFIX_LEN ? node->long_prefix : node->prefix;
+}
+
+static void
+node_set_prefix(struct art* t, struct art_node* node, unsigned char* prefix, uint32_t len)
+{
+   unsigned char* old = node->long_prefix;
+
+   if (len > MAX_PREFIX_LEN)
+   {
+      node->long_prefix = pgmoneta_memory_alloc(t->arena, len);
+      memcpy(node->long_prefix, prefix, len);
+   }
+   else
+   {
+      memmove(node->prefix, prefix, len);
+      node->long_prefix = NULL;
+   }
+   node->prefix_len = len;
+
+   /* Released last, as the new prefix may be a part of it */
+   pgmoneta_memory_release(t->arena, old);
+}
+
 static void
-destroy_art_node(struct art_node* node)
+destroy_art_node(struct art* t, struct art_node* node, bool recycle)
 {
    if (node == NULL)
    {
@@ -678,7 +962,7 @@ destroy_art_node(struct art_node* node)
    if (IS_LEAF(node))
    {
       pgmoneta_value_destroy(GET_LEAF(node)->value);
-      free(GET_LEAF(node));
+      pgmoneta_memory_release(t->arena, GET_LEAF(node));
       return;
    }
    switch (node->type)
@@ -688,7 +972,7 @@ destroy_art_node(struct art_node* node)
          struct art_node4* n = (struct art_node4*)node;
          for (int i = 0; i < node->num_children; i++)
          {
-            destroy_art_node(n->children[i]);
+            destroy_art_node(t, n->children[i], recycle);
          }
          break;
       }
@@ -697,7 +981,7 @@ destroy_art_node(struct art_node* node)
          struct art_node16* n = (struct art_node16*)node;
          for (int i = 0; i < node->num_children; i++)
          {
-            destroy_art_node(n->children[i]);
+            destroy_art_node(t, n->children[i], recycle);
          }
          break;
       }
@@ -711,7 +995,7 @@ destroy_art_node(struct art_node* node)
             {
                continue;
             }
-            destroy_art_node(n->children[idx - 1]);
+            destroy_art_node(t, n->children[idx - 1], recycle);
          }
          break;
       }
@@ -725,12 +1009,19 @@ destroy_art_node(struct art_node* node)
             {
                continue;
             }
-            destroy_art_node(n->children[i]);
+            destroy_art_node(t, n->children[i], recycle);
          }
          break;
       }
    }
-   free(node);
+   if (recycle)
+   {
+      node_release(t, node);
+   }
+   else
+   {
+      pgmoneta_memory_release(t->arena, node->long_prefix);
+   }
 }
 
 static struct art_node**
@@ -751,8 +1042,8 @@ node_get_child(struct art_node* node, unsigned char ch)
       case Node16:
       {
          struct art_node16* n = (struct art_node16*)node;
-         int idx = find_index(ch, n->keys, n->node.num_children);
-         if (idx == -1 || n->keys[idx] != ch)
+         int idx = node16_find_child(n, ch);
+         if (idx == -1)
          {
             goto error;
          }
@@ -778,10 +1069,10 @@ error:
 }
 
 static struct value*
-art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new)
+art_node_insert(struct art* t, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new)
 {
    struct art_leaf* leaf = NULL;
-   struct art_leaf* min_leaf = NULL;
+   unsigned char* prefix = NULL;
    uint32_t idx = 0;
    uint32_t diff_len = 0; // where the keys diverge
    struct art_node* new_node = NULL;
@@ -792,7 +1083,7 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
    {
       // Lazy expansion, skip creating an inner node since it currently will have only this one leaf.
       // We will compare keys when reach leaf anyway, the path doesn't need to 100% match the key along the way
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      create_art_leaf(t, &leaf, key, key_len, value, type, config);
       *node_ref = SET_LEAF(leaf);
       *new = true;
       return NULL;
@@ -805,24 +1096,14 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       if (leaf_match(GET_LEAF(node), key, key_len))
       {
          old_val = GET_LEAF(node)->value;
-         if (config != NULL)
-         {
-            pgmoneta_value_create_with_config(value, config, &(GET_LEAF(node)->value));
-         }
-         else
-         {
-            pgmoneta_value_create(type, value, &(GET_LEAF(node)->value));
-         }
+         pgmoneta_value_create_with_arena(t->arena, type, value, config, &(GET_LEAF(node)->value));
          return old_val;
       }
-      // If the key does not match with existing key, old key and new key diverged some point after depth
-      // Even if we merely store a partial prefix for each node, it couldn't have diverged before depth.
-      // The reason is that when we find it diverged outside the partial prefix range,
-      // we compare with the existing key in the left most leaf and find an exact diverging point to split the node (see details below).
-      // This way we inductively guarantee that all children to a parent share the same prefix even if it's only partially stored
+      // If the key does not match with existing key, old key and new key diverged some point after depth.
+      // Every node stores its complete prefix, so the keys couldn't have diverged before depth
       leaf_key = GET_LEAF(node)->key;
-      create_art_node(&new_node, Node4);
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      create_art_node(t, &new_node, Node4);
+      create_art_leaf(t, &leaf, key, key_len, value, type, config);
       // Get the diverging index after point of depth
       for (idx = depth; idx < min(key_len, GET_LEAF(node)->key_len); idx++)
       {
@@ -830,69 +1111,43 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
          {
             break;
          }
-         if (idx - depth < MAX_PREFIX_LEN)
-         {
-            new_node->prefix[idx - depth] = key[idx];
-         }
       }
-      new_node->prefix_len = idx - depth;
+      node_set_prefix(t, new_node, key + depth, idx - depth);
       depth += new_node->prefix_len;
-      node_add_child(new_node, &new_node, key[depth], SET_LEAF(leaf));
-      node_add_child(new_node, &new_node, leaf_key[depth], (void*)node);
+      node_add_child(t, new_node, &new_node, key[depth], SET_LEAF(leaf));
+      node_add_child(t, new_node, &new_node, leaf_key[depth], (void*)node);
       // replace with new node
       *node_ref = new_node;
       *new = true;
       return NULL;
    }
 
-   // There are several cases,
+   // There are two cases,
    // 1. The key diverges outside the current prefix (diff_len >= prefix_len)
    // 2. The key diverges within the current prefix (diff_len < prefix_len)
-   //   2.1. The key diverges within the partial prefix range (diff_len < MAX_PREFIX_LEN)
-   //   2.2. The key diverges outside the partial prefix range (MAX_PREFIX_LEN <= diff_len < prefix_len)
    // For case 1, go to the next child to add node recursively, or add leaf to current node in place
    // For case 2, split the current node and add child to new node.
-   // Note that it's tricky to check case 2.2, or in that case know the exact diverging point,
-   // since we merely store the first 10 (MAX_PREFIX_LEN) bytes of the prefix.
-   // In this case we use the key in the left most leaf of the node to determine the diverging point.
-   // Theoretically we inductively guarantee that all children to the same parent share the same prefixes.
-   // So we can use the key inside any leaf under this node to see if the diverging point goes beyond the current prefix,
-   // but it's most convenient and efficient to reach the left most key.
+   // The prefix is stored pessimistically, i.e. in full, so the diverging point is always exact,
+   // even for prefixes longer than MAX_PREFIX_LEN such as the ones of relation paths.
 
    diff_len = check_prefix(node, key, depth, key_len);
    if (diff_len < node->prefix_len)
    {
       // case 2, split the node
-      create_art_node(&new_node, Node4);
-      create_art_leaf(&leaf, key, key_len, value, type, config);
-      new_node->prefix_len = diff_len;
-      memcpy(new_node->prefix, node->prefix, min(MAX_PREFIX_LEN, diff_len));
-      // We need to know if new bytes that were once outside the partial prefix range will now come into the range
-      // If original key didn't fill up the partial prefix buffer in the first place,
-      // no new bytes will come into buffer when prefix shifts left
-      if (node->prefix_len <= MAX_PREFIX_LEN)
-      {
-         node->prefix_len = node->prefix_len - (diff_len + 1);
-         node_add_child(new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
-         node_add_child(new_node, &new_node, node->prefix[diff_len], node);
-         // Update node's prefix info since we move it downwards
-         // The first diverging character serves as the key byte in keys array,
-         // so we don't duplicate store it in the prefix.
-         // In other words, if prefix is the starting point,
-         // prefix + prefix_len - 1 is the last byte of the prefix,
-         // prefix + prefix_len is the indexing byte
-         // prefix + prefix_len + 1 is the starting point of the next prefix
-         memmove(node->prefix, node->prefix + diff_len + 1, node->prefix_len);
-      }
-      else
-      {
-         node->prefix_len = node->prefix_len - (diff_len + 1);
-         min_leaf = node_get_minimum(node);
-         node_add_child(new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
-         node_add_child(new_node, &new_node, min_leaf->key[depth + diff_len], node);
-         // node is moved downwards
-         memmove(node->prefix, min_leaf->key + depth + diff_len + 1, min(MAX_PREFIX_LEN, node->prefix_len));
-      }
+      prefix = node_prefix(node);
+      create_art_node(t, &new_node, Node4);
+      create_art_leaf(t, &leaf, key, key_len, value, type, config);
+      node_set_prefix(t, new_node, prefix, diff_len);
+      node_add_child(t, new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
+      node_add_child(t, new_node, &new_node, prefix[diff_len], node);
+      // Update node's prefix info since we move it downwards
+      // The first diverging character serves as the key byte in keys array,
+      // so we don't duplicate store it in the prefix.
+      // In other words, if prefix is the starting point,
+      // prefix + prefix_len - 1 is the last byte of the prefix,
+      // prefix + prefix_len is the indexing byte
+      // prefix + prefix_len + 1 is the starting point of the next prefix
+      node_set_prefix(t, node, prefix + diff_len + 1, node->prefix_len - (diff_len + 1));
       // replace
       *node_ref = new_node;
       *new = true;
@@ -910,13 +1165,13 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
          {
             node->num_children++;
          }
-         return art_node_insert(*next, next, depth + 1, key, key_len, value, type, config, new);
+         return art_node_insert(t, *next, next, depth + 1, key, key_len, value, type, config, new);
       }
       else
       {
          // add a child to current node since the spot is available
-         create_art_leaf(&leaf, key, key_len, value, type, config);
-         node_add_child(node, node_ref, key[depth], SET_LEAF(leaf));
+         create_art_leaf(t, &leaf, key, key_len, value, type, config);
+         node_add_child(t, node, node_ref, key[depth], SET_LEAF(leaf));
          *new = true;
          return NULL;
       }
@@ -924,7 +1179,7 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
 }
 
 static struct art_leaf*
-art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len)
+art_node_delete(struct art* t, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len)
 {
    struct art_leaf* l = NULL;
    struct art_node** child = NULL;
@@ -944,8 +1199,8 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
       }
       return NULL;
    }
-   diff_len = check_prefix_partial(node, key, depth, key_len);
-   if (diff_len != min(MAX_PREFIX_LEN, node->prefix_len))
+   diff_len = check_prefix(node, key, depth, key_len);
+   if (diff_len != node->prefix_len)
    {
       return NULL;
    }
@@ -967,7 +1222,7 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
          if (leaf_match(GET_LEAF(*child), key, key_len))
          {
             l = GET_LEAF(*child);
-            node_remove_child(node, node_ref, key[depth]);
+            node_remove_child(t, node, node_ref, key[depth]);
             return l;
          }
          else
@@ -977,7 +1232,7 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
       }
       else
       {
-         return art_node_delete(*child, child, depth + 1, key, key_len);
+         return art_node_delete(t, *child, child, depth + 1, key, key_len);
       }
    }
 }
@@ -1070,18 +1325,18 @@ art_node_iterate(struct art_node* node, art_callback cb, void* data)
 }
 
 static void
-node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child)
+node_add_child(struct art* t, struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    switch (node->type)
    {
       case Node4:
-         node4_add_child((struct art_node4*)node, node_ref, ch, child);
+         node4_add_child(t, (struct art_node4*)node, node_ref, ch, child);
          break;
       case Node16:
-         node16_add_child((struct art_node16*)node, node_ref, ch, child);
+         node16_add_child(t, (struct art_node16*)node, node_ref, ch, child);
          break;
       case Node48:
-         node48_add_child((struct art_node48*)node, node_ref, ch, child);
+         node48_add_child(t, (struct art_node48*)node, node_ref, ch, child);
          break;
       case Node256:
          node256_add_child((struct art_node256*)node, ch, child);
@@ -1090,7 +1345,7 @@ node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char
 }
 
 static void
-node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child)
+node4_add_child(struct art* t, struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 4)
    {
@@ -1107,20 +1362,20 @@ node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned cha
    {
       // expand
       struct art_node16* new_node = NULL;
-      create_art_node16(&new_node);
+      create_art_node16(t, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
       memcpy(new_node->keys, node->keys, node->node.num_children);
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
+      node_release(t, (struct art_node*)node);
 
-      node16_add_child(new_node, node_ref, ch, child);
+      node16_add_child(t, new_node, node_ref, ch, child);
    }
 }
 
 static void
-node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child)
+node16_add_child(struct art* t, struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 16)
    {
@@ -1137,7 +1392,7 @@ node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned c
    {
       // expand
       struct art_node48* new_node = NULL;
-      create_art_node48(&new_node);
+      create_art_node48(t, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
       for (int i = 0; i < node->node.num_children; i++)
@@ -1146,13 +1401,13 @@ node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned c
       }
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
-      node48_add_child(new_node, node_ref, ch, child);
+      node_release(t, (struct art_node*)node);
+      node48_add_child(t, new_node, node_ref, ch, child);
    }
 }
 
 static void
-node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child)
+node48_add_child(struct art* t, struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 48)
    {
@@ -1170,7 +1425,7 @@ node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned c
    {
       // expand
       struct art_node256* new_node = NULL;
-      create_art_node256(&new_node);
+      create_art_node256(t, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1182,7 +1437,7 @@ node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned c
       }
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
+      node_release(t, (struct art_node*)node);
       node256_add_child(new_node, ch, child);
    }
 }
@@ -1237,135 +1492,155 @@ copy_header(struct art_node* dest, struct art_node* src)
    dest->num_children = src->num_children;
    dest->prefix_len = src->prefix_len;
    memcpy(dest->prefix, src->prefix, min(MAX_PREFIX_LEN, src->prefix_len));
+   // the new node takes over the long prefix, src is released afterwards
+   dest->long_prefix = src->long_prefix;
+   src->long_prefix = NULL;
 }
 
 static uint32_t
-check_prefix_partial(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t key_len)
+check_prefix(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t key_len)
 {
    uint32_t len = 0;
-   uint32_t max_cmp = min(min(node->prefix_len, MAX_PREFIX_LEN), key_len - depth);
-   while (len < max_cmp && key[depth + len] == node->prefix[len])
+   unsigned char* prefix = node_prefix(node);
+   uint32_t max_cmp = depth < key_len ? min(node->prefix_len, key_len - depth) : 0;
+   while (len < max_cmp && key[depth + len] == prefix[len])
    {
       len++;
    }
    return len;
 }
 
-static uint32_t
-check_prefix(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t key_len)
+static int
+node16_find_child(struct art_node16* node, unsigned char ch)
 {
-   uint32_t len = 0;
-   struct art_leaf* leaf = NULL;
-   uint32_t max_cmp = min(min(node->prefix_len, MAX_PREFIX_LEN), key_len - depth);
-   while (len < max_cmp && key[depth + len] == node->prefix[len])
-   {
-      len++;
-   }
-   // diverge within partial prefix range
-   if (len < MAX_PREFIX_LEN)
+#if defined(__SSE2__)
+   __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)ch), _mm_loadu_si128((__m128i*)node->keys));
+   // keys past num_children are stale after removals, mask them out
+   unsigned int mask = (unsigned int)_mm_movemask_epi8(cmp) & ((1U << node->node.num_children) - 1);
+   return mask != 0 ? __builtin_ctz(mask) : -1;
+#elif defined(__ARM_NEON)
+   uint8x16_t cmp = vceqq_u8(vdupq_n_u8(ch), vld1q_u8(node->keys));
+   // narrow every lane to 4 bits, giving a 64 bit mask
+   uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+   // keys past num_children are stale after removals, mask them out
+   if (node->node.num_children < 16)
    {
-      return len;
+      mask &= (1ULL << (4 * node->node.num_children)) - 1;
    }
-
-   leaf = node_get_minimum(node);
-   max_cmp = min(leaf->key_len, key_len) - depth;
-   // continue comparing the real keys
-   while (len < max_cmp && leaf->key[depth + len] == key[depth + len])
+   return mask != 0 ? __builtin_ctzll(mask) >> 2 : -1;
+#else
+   int idx = find_index(ch, node->keys, node->node.num_children);
+   if (idx == -1 || node->keys[idx] != ch)
    {
-      len++;
+      return -1;
    }
-   return len;
+   return idx;
+#endif
 }
 
-static bool
-leaf_match(struct art_leaf* leaf, unsigned char* key, uint32_t key_len)
+static struct art_node*
+bulk_build(struct art* t, char** keys, uint32_t* lens, uintptr_t* values, enum value_type type, int start, int end, uint32_t depth, uint64_t* count)
 {
-   if (leaf->key_len != key_len)
+   unsigned char* first = (unsigned char*)keys[start];
+   unsigned char* last = (unsigned char*)keys[end - 1];
+   uint32_t max_cmp = min(lens[start], lens[end - 1]);
+   uint32_t lcp = depth;
+   struct art_node* node = NULL;
+   struct art_leaf* leaf = NULL;
+   unsigned char ch = 0;
+   int bounds[257];
+   int groups = 0;
+
+   // The keys are sorted, so the first and the last key share the prefix of the range
+   while (lcp < max_cmp && first[lcp] == last[lcp])
    {
-      return false;
+      lcp++;
    }
-   return memcmp(leaf->key, key, key_len) == 0;
-}
 
-static struct art_leaf*
-node_get_minimum(struct art_node* node)
-{
-   if (node == NULL)
+   // Keys are terminated, so this is a single key or duplicates of it, the last one wins
+   if (lcp == max_cmp)
    {
-      return NULL;
+      create_art_leaf(t, &leaf, last, lens[end - 1], values[end - 1], type, NULL);
+      (*count)++;
+      return SET_LEAF(leaf);
    }
-   while (node != NULL && !IS_LEAF(node))
+
+   // Split the range by the byte after the common prefix, every group is a child
+   for (int i = start; i < end; i++)
    {
-      switch (node->type)
+      if (i == start || keys[i][lcp] != keys[i - 1][lcp])
       {
-         case Node4:
-         {
-            struct art_node4* n = (struct art_node4*)node;
-            node = n->children[0];
-            break;
-         }
-         case Node16:
-         {
-            struct art_node16* n = (struct art_node16*)node;
-            node = n->children[0];
-            break;
-         }
-         case Node48:
-         {
-            struct art_node48* n = (struct art_node48*)node;
-            int idx = 0;
-            while (n->keys[idx] == 0)
-            {
-               idx++;
-            }
-            node = n->children[n->keys[idx] - 1];
-            break;
-         }
-         case Node256:
-         {
-            struct art_node256* n = (struct art_node256*)node;
-            int idx = 0;
-            while (n->children[idx] == NULL)
-            {
-               idx++;
-            }
-            node = n->children[idx];
-            break;
-         }
+         bounds[groups] = i;
+         groups++;
       }
    }
-   if (node == NULL)
+   bounds[groups] = end;
+
+   // Size the node up front, children then never make it grow
+   if (groups <= 4)
    {
-      return NULL;
+      create_art_node(t, &node, Node4);
+   }
+   else if (groups <= 16)
+   {
+      create_art_node(t, &node, Node16);
+   }
+   else if (groups <= 48)
+   {
+      create_art_node(t, &node, Node48);
+   }
+   else
+   {
+      create_art_node(t, &node, Node256);
+   }
+   node_set_prefix(t, node, first + depth, lcp - depth);
+
+   for (int g = 0; g < groups; g++)
+   {
+      ch = (unsigned char)keys[bounds[g]][lcp];
+      node_add_child(t, node, &node, ch, bulk_build(t, keys, lens, values, type, bounds[g], bounds[g + 1], lcp + 1, count));
+   }
+
+   return node;
+}
+
+static bool
+leaf_match(struct art_leaf* leaf, unsigned char* key, uint32_t key_len)
+{
+   if (leaf->key_len != key_len)
+   {
+      return false;
    }
-   return GET_LEAF(node);
+   return memcmp(leaf->key, key, key_len) == 0;
 }
 
 static void
-node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned char ch)
+node_remove_child(struct art* t, struct art_node* node, struct art_node** node_ref, unsigned char ch)
 {
    switch (node->type)
    {
       case Node4:
-         node4_remove_child((struct art_node4*)node, node_ref, ch);
+         node4_remove_child(t, (struct art_node4*)node, node_ref, ch);
          break;
       case Node16:
-         node16_remove_child((struct art_node16*)node, node_ref, ch);
+         node16_remove_child(t, (struct art_node16*)node, node_ref, ch);
          break;
       case Node48:
-         node48_remove_child((struct art_node48*)node, node_ref, ch);
+         node48_remove_child(t, (struct art_node48*)node, node_ref, ch);
          break;
       case Node256:
-         node256_remove_child((struct art_node256*)node, node_ref, ch);
+         node256_remove_child(t, (struct art_node256*)node, node_ref, ch);
          break;
    }
 }
 
 static void
-node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch)
+node4_remove_child(struct art* t, struct art_node4* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = 0;
    uint32_t len = 0;
+   unsigned char buf[MAX_PREFIX_LEN];
+   unsigned char* prefix = NULL;
    struct art_node* child = NULL;
    idx = find_index(ch, node->keys, node->node.num_children);
    memmove(node->keys + idx, node->keys + idx + 1, node->node.num_children - (idx + 1));
@@ -1378,32 +1653,34 @@ node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned
       if (IS_LEAF(child))
       {
          // replace directly
-         free(node);
+         node_release(t, (struct art_node*)node);
          *node_ref = child;
          return;
       }
       // parent prefix bytes + byte index to child + child prefix bytes
-      len = node->node.prefix_len;
-      if (len < MAX_PREFIX_LEN)
+      len = node->node.prefix_len + 1 + child->prefix_len;
+      prefix = len <= MAX_PREFIX_LEN ? buf : malloc(len);
+      if (prefix == NULL)
       {
-         node->node.prefix[len] = node->keys[0];
-         len++;
+         // keep the node with its single child, the tree is still valid
+         return;
       }
-      // keep filling as much as we can
-      for (uint32_t i = 0; len + i < MAX_PREFIX_LEN && i < child->prefix_len; i++)
+      memcpy(prefix, node_prefix((struct art_node*)node), node->node.prefix_len);
+      prefix[node->node.prefix_len] = node->keys[0];
+      memcpy(prefix + node->node.prefix_len + 1, node_prefix(child), child->prefix_len);
+      node_set_prefix(t, child, prefix, len);
+      if (prefix != buf)
       {
-         node->node.prefix[len + i] = child->prefix[i];
+         free(prefix);
       }
-      child->prefix_len = node->node.prefix_len + 1 + child->prefix_len;
-      memcpy(child->prefix, node->node.prefix, min(child->prefix_len, MAX_PREFIX_LEN));
-      free(node);
+      node_release(t, (struct art_node*)node);
       // replace
       *node_ref = child;
    }
 }
 
 static void
-node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch)
+node16_remove_child(struct art* t, struct art_node16* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = 0;
    struct art_node4* new_node = NULL;
@@ -1415,17 +1692,17 @@ node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigne
    // Trick from libart, do not downgrade immediately to avoid jumping on 4/5 boundary
    if (node->node.num_children <= 3)
    {
-      create_art_node4(&new_node);
+      create_art_node4(t, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->keys, node->keys, node->node.num_children);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
-      free(node);
+      node_release(t, (struct art_node*)node);
       *node_ref = (struct art_node*)new_node;
    }
 }
 
 static void
-node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch)
+node48_remove_child(struct art* t, struct art_node48* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = node->keys[ch];
    int cnt = 0;
@@ -1436,7 +1713,7 @@ node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigne
 
    if (node->node.num_children <= 12)
    {
-      create_art_node16(&new_node);
+      create_art_node16(t, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1447,13 +1724,13 @@ node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigne
             cnt++;
          }
       }
-      free(node);
+      node_release(t, (struct art_node*)node);
       *node_ref = (struct art_node*)new_node;
    }
 }
 
 static void
-node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsigned char ch)
+node256_remove_child(struct art* t, struct art_node256* node, struct art_node** node_ref, unsigned char ch)
 {
    int num = 0;
    for (int i = 0; i < 48; i++)
@@ -1474,7 +1751,7 @@ node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsig
 
    if (node->node.num_children <= 37)
    {
-      create_art_node48(&new_node);
+      create_art_node48(t, &new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1485,7 +1762,7 @@ node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsig
             cnt++;
          }
       }
-      free(node);
+      node_release(t, (struct art_node*)node);
       *node_ref = (struct art_node*)new_node;
    }
 }
@@ -1660,9 +1937,8 @@ art_search(struct art* t, unsigned char* key, uint32_t key_len)
          }
          return GET_LEAF(node)->value;
       }
-      // optimistically check the prefix,
-      // we move forward as long as up to MAX_PREFIX_LEN characters match
-      if (check_prefix_partial(node, key, depth, key_len) != min(node->prefix_len, MAX_PREFIX_LEN))
+      // the complete prefix is stored, so a mismatch ends the search here
+      if (check_prefix(node, key, depth, key_len) != node->prefix_len)
       {
          return NULL;
       }
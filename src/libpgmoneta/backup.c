@@ -31,6 +31,7 @@
 #include <aes.h>
 #include <art.h>
 #include <backup.h>
+#include <bandwidth.h>
 #include <compression.h>
 #include <info.h>
 #include <logging.h>
@@ -42,6 +43,8 @@
 #include <wal.h>
 #include <workflow.h>
 
+static bool incremental_automatic(int server);
+
 void
 pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encryption, struct json* payload)
 {
@@ -78,6 +81,8 @@ pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encrypti
 
    config = (struct main_configuration*)shmem;
 
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_BACKUP);
+
    if (!config->common.servers[server].valid)
    {
       ec = MANAGEMENT_ERROR_BACKUP_INVALID;
@@ -119,6 +124,11 @@ pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encrypti
    req = (struct json*)pgmoneta_json_get(payload, MANAGEMENT_CATEGORY_REQUEST);
    incremental = (char*)pgmoneta_json_get(req, MANAGEMENT_ARGUMENT_BACKUP);
 
+   if (pgmoneta_compare_string(incremental, "auto"))
+   {
+      incremental = incremental_automatic(server) ? "latest" : NULL;
+   }
+
    strftime(&date_str[0], sizeof(date_str), "%Y%m%d%H%M%S", time_info);
 
    date = pgmoneta_append(date, &date_str[0]);
@@ -279,7 +289,8 @@ pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encrypti
       goto error;
    }
 
-   if (pgmoneta_management_response_ok(NULL, client_fd, start_t, end_t, compression, encryption, payload))
+   /* A backup queued by a previous run has no client */
+   if (client_fd != -1 && pgmoneta_management_response_ok(NULL, client_fd, start_t, end_t, compression, encryption, payload))
    {
       ec = MANAGEMENT_ERROR_BACKUP_NETWORK;
       pgmoneta_log_error("Backup: Error sending response for %s", config->common.servers[server].name);
@@ -313,6 +324,7 @@ pgmoneta_backup(int client_fd, int server, uint8_t compression, uint8_t encrypti
 
    pgmoneta_disconnect(client_fd);
 
+   pgmoneta_bandwidth_end();
    pgmoneta_stop_logging();
 
    exit(0);
@@ -356,6 +368,7 @@ error:
 
    pgmoneta_disconnect(client_fd);
 
+   pgmoneta_bandwidth_end();
    pgmoneta_stop_logging();
 
    exit(1);
@@ -778,6 +791,21 @@ pgmoneta_get_max_rate(int server)
    return config->max_rate;
 }
 
+int
+pgmoneta_get_backup_connections(int server)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config->common.servers[server].backup_connections != -1)
+   {
+      return config->common.servers[server].backup_connections;
+   }
+
+   return config->backup_connections;
+}
+
 bool
 pgmoneta_is_backup_valid(int server, char* identifier)
 {
@@ -1017,3 +1045,59 @@ error:
 
    return 1;
 }
+
+static bool
+incremental_automatic(int server)
+{
+   bool incremental = false;
+   char* server_backup = NULL;
+   char* wal_dir = NULL;
+   int number_of_backups = 0;
+   uint64_t wal = 0;
+   struct backup** backups = NULL;
+   struct backup* latest = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config->incremental_threshold <= 0 || config->common.servers[server].version < 14)
+   {
+      goto done;
+   }
+
+   server_backup = pgmoneta_get_server_backup(server);
+   wal_dir = pgmoneta_get_server_wal(server);
+
+   if (pgmoneta_load_infos(server_backup, &number_of_backups, &backups) || number_of_backups == 0)
+   {
+      goto done;
+   }
+
+   latest = backups[number_of_backups - 1];
+   if (latest->valid != VALID_TRUE || latest->restore_size == 0)
+   {
+      goto done;
+   }
+
+   /* The WAL generated since the last backup is what an incremental backup has to copy */
+   wal = pgmoneta_number_of_wal_files(wal_dir, &latest->wal[0], NULL);
+   wal *= config->common.servers[server].wal_size;
+
+   incremental = wal * 100 < latest->restore_size * (uint64_t)config->incremental_threshold;
+
+   pgmoneta_log_debug("Backup: %" PRIu64 " bytes of WAL since %s/%s, %s backup",
+                      wal, config->common.servers[server].name, latest->label,
+                      incremental ? "incremental" : "full");
+
+done:
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      free(backups[i]);
+   }
+   free(backups);
+   free(server_backup);
+   free(wal_dir);
+
+   return incremental;
+}
@@ -0,0 +1,441 @@
+﻿/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <bandwidth.h>
+#include <logging.h>
+
+/* system */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define BANDWIDTH_QUANTUM     (64 * 1024)  /* Bytes a thread batches before asking the scheduler */
+#define BANDWIDTH_BURST_NS    100000000LL  /* A bucket holds 100 ms worth of tokens */
+#define BANDWIDTH_ACTIVE_NS   1000000000LL /* An operation takes part in the sharing for a second after a transfer */
+#define BANDWIDTH_MIN_WAIT_NS 1000000LL
+#define BANDWIDTH_MAX_WAIT_NS 100000000LL  /* Look at the shares again at least every 100 ms */
+#define BANDWIDTH_DEPTH       4
+
+static int weights[BANDWIDTH_OPERATIONS] = {
+   BANDWIDTH_WEIGHT_WAL,
+   BANDWIDTH_WEIGHT_BACKUP,
+   BANDWIDTH_WEIGHT_RESTORE,
+   BANDWIDTH_WEIGHT_TRANSFER,
+   BANDWIDTH_WEIGHT_ARCHIVE
+};
+
+static char* names[BANDWIDTH_OPERATIONS] = {
+   "wal",
+   "backup",
+   "restore",
+   "transfer",
+   "archive"
+};
+
+/* The operations this thread accounts to, innermost last */
+static _Thread_local int current_server[BANDWIDTH_DEPTH];
+static _Thread_local int current_operation[BANDWIDTH_DEPTH];
+static _Thread_local int depth = 0;
+static _Thread_local bool owner = false;
+
+/* The outermost operation of the process, inherited by worker threads */
+static int process_server = -1;
+static int process_operation = -1;
+
+static _Thread_local size_t pending = 0;
+
+static int64_t bandwidth_now(void);
+static void bandwidth_flush(void);
+static bool bandwidth_current(int* server, int* operation);
+static bool bandwidth_active(struct bandwidth_class* operation, int64_t now);
+
+void
+pgmoneta_bandwidth_begin(int server, int operation)
+{
+   bandwidth_flush();
+
+   if (depth == 0 && process_server == -1)
+   {
+      process_server = server;
+      process_operation = operation;
+      owner = true;
+   }
+
+   if (depth < BANDWIDTH_DEPTH)
+   {
+      current_server[depth] = server;
+      current_operation[depth] = operation;
+   }
+   depth++;
+}
+
+void
+pgmoneta_bandwidth_end(void)
+{
+   bandwidth_flush();
+
+   if (depth > 0)
+   {
+      depth--;
+   }
+
+   if (depth == 0 && owner)
+   {
+      process_server = -1;
+      process_operation = -1;
+      owner = false;
+   }
+}
+
+void
+pgmoneta_bandwidth_consume(size_t bytes)
+{
+   size_t batch = 0;
+   int server = -1;
+   int operation = -1;
+
+   if (!bandwidth_current(&server, &operation))
+   {
+      return;
+   }
+
+   pending += bytes;
+   if (pending < BANDWIDTH_QUANTUM)
+   {
+      return;
+   }
+
+   batch = pending;
+   pending = 0;
+
+   pgmoneta_bandwidth_acquire(server, operation, batch);
+}
+
+void
+pgmoneta_bandwidth_acquire(int server, int operation, size_t bytes)
+{
+   signed char isfree;
+   int64_t start;
+   int64_t now;
+   int64_t wait;
+   double global;
+   double assured;
+   double ceiling;
+   double share;
+   struct bandwidth_server* bs = NULL;
+   struct bandwidth_class* bc = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || bytes == 0 ||
+       server < 0 || server >= config->common.number_of_servers ||
+       operation < 0 || operation >= BANDWIDTH_OPERATIONS)
+   {
+      return;
+   }
+
+   bs = &config->common.servers[server].bandwidth;
+   bc = &bs->operations[operation];
+
+   start = bandwidth_now();
+   atomic_store(&bc->last_active, start);
+   atomic_fetch_add(&bc->bytes, bytes);
+
+   if (config->max_bandwidth <= 0 && config->common.servers[server].max_bandwidth <= 0)
+   {
+      return;
+   }
+
+retry:
+   isfree = STATE_FREE;
+   if (!atomic_compare_exchange_strong(&config->bandwidth.lock, &isfree, STATE_IN_USE))
+   {
+      SLEEP_AND_GOTO(1000L, retry);
+   }
+
+   now = bandwidth_now();
+   pgmoneta_bandwidth_rates(server, operation, now, &global, &assured, &ceiling, &share);
+
+   pgmoneta_bandwidth_bucket_refill(&config->bandwidth.bucket, global, now);
+   pgmoneta_bandwidth_bucket_refill(&bs->assured, assured, now);
+   pgmoneta_bandwidth_bucket_refill(&bs->ceil, ceiling, now);
+   pgmoneta_bandwidth_bucket_refill(&bc->assured, share, now);
+
+   if (pgmoneta_bandwidth_bucket_ready(&bc->assured, share))
+   {
+      /* Within the assured share of the operation, which may put the rest in debt */
+      pgmoneta_bandwidth_bucket_take(&bc->assured, share, bytes);
+      pgmoneta_bandwidth_bucket_take(&bs->assured, assured, bytes);
+      pgmoneta_bandwidth_bucket_take(&bs->ceil, ceiling, bytes);
+      pgmoneta_bandwidth_bucket_take(&config->bandwidth.bucket, global, bytes);
+   }
+   else if (pgmoneta_bandwidth_bucket_ready(&bs->ceil, ceiling) && pgmoneta_bandwidth_bucket_ready(&bs->assured, assured))
+   {
+      /* Borrow what the other operations of the server leave unused */
+      pgmoneta_bandwidth_bucket_take(&bs->assured, assured, bytes);
+      pgmoneta_bandwidth_bucket_take(&bs->ceil, ceiling, bytes);
+      pgmoneta_bandwidth_bucket_take(&config->bandwidth.bucket, global, bytes);
+   }
+   else if (pgmoneta_bandwidth_bucket_ready(&bs->ceil, ceiling) && pgmoneta_bandwidth_bucket_ready(&config->bandwidth.bucket, global))
+   {
+      /* Borrow what the other servers leave unused */
+      pgmoneta_bandwidth_bucket_take(&bs->ceil, ceiling, bytes);
+      pgmoneta_bandwidth_bucket_take(&config->bandwidth.bucket, global, bytes);
+   }
+   else
+   {
+      wait = pgmoneta_bandwidth_bucket_wait(&bs->assured, assured);
+      if (pgmoneta_bandwidth_bucket_wait(&config->bandwidth.bucket, global) < wait)
+      {
+         wait = pgmoneta_bandwidth_bucket_wait(&config->bandwidth.bucket, global);
+      }
+      if (pgmoneta_bandwidth_bucket_wait(&bs->ceil, ceiling) > wait)
+      {
+         wait = pgmoneta_bandwidth_bucket_wait(&bs->ceil, ceiling);
+      }
+      if (pgmoneta_bandwidth_bucket_wait(&bc->assured, share) < wait)
+      {
+         wait = pgmoneta_bandwidth_bucket_wait(&bc->assured, share);
+      }
+
+      atomic_store(&config->bandwidth.lock, STATE_FREE);
+
+      if (wait < BANDWIDTH_MIN_WAIT_NS)
+      {
+         wait = BANDWIDTH_MIN_WAIT_NS;
+      }
+      else if (wait > BANDWIDTH_MAX_WAIT_NS)
+      {
+         wait = BANDWIDTH_MAX_WAIT_NS;
+      }
+
+      SLEEP(wait);
+      atomic_store(&bc->last_active, bandwidth_now());
+      goto retry;
+   }
+
+   atomic_store(&config->bandwidth.lock, STATE_FREE);
+
+   if (now > start)
+   {
+      atomic_fetch_add(&bc->throttled, (unsigned long long)(now - start));
+   }
+}
+
+char*
+pgmoneta_bandwidth_operation_name(int operation)
+{
+   if (operation < 0 || operation >= BANDWIDTH_OPERATIONS)
+   {
+      return "unknown";
+   }
+
+   return names[operation];
+}
+
+void
+pgmoneta_bandwidth_rates(int server, int operation, int64_t now,
+                         double* global, double* assured, double* ceiling, double* share)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct server* srv = &config->common.servers[server];
+   double limit = srv->max_bandwidth > 0 ? (double)srv->max_bandwidth : 0.0;
+   int server_weights = 0;
+   int operation_weights = 0;
+
+   *global = config->max_bandwidth > 0 ? (double)config->max_bandwidth : 0.0;
+
+   if (limit > 0.0 && (*global == 0.0 || limit < *global))
+   {
+      *ceiling = limit;
+   }
+   else
+   {
+      *ceiling = *global;
+   }
+
+   if (*global > 0.0)
+   {
+      for (int i = 0; i < config->common.number_of_servers; i++)
+      {
+         bool active = i == server;
+
+         for (int j = 0; !active && j < BANDWIDTH_OPERATIONS; j++)
+         {
+            active = bandwidth_active(&config->common.servers[i].bandwidth.operations[j], now);
+         }
+
+         if (active)
+         {
+            server_weights += config->common.servers[i].bandwidth_weight > 0 ? config->common.servers[i].bandwidth_weight : 1;
+         }
+      }
+
+      *assured = *global * (srv->bandwidth_weight > 0 ? srv->bandwidth_weight : 1) / server_weights;
+      if (limit > 0.0 && limit < *assured)
+      {
+         *assured = limit;
+      }
+   }
+   else
+   {
+      *assured = limit;
+   }
+
+   for (int j = 0; j < BANDWIDTH_OPERATIONS; j++)
+   {
+      if (j == operation || bandwidth_active(&srv->bandwidth.operations[j], now))
+      {
+         operation_weights += weights[j];
+      }
+   }
+
+   *share = *assured * weights[operation] / operation_weights;
+}
+
+void
+pgmoneta_bandwidth_bucket_refill(struct bandwidth_bucket* bucket, double rate, int64_t now)
+{
+   double burst;
+
+   if (rate <= 0.0)
+   {
+      bucket->tokens = 0.0;
+      bucket->last = now;
+      return;
+   }
+
+   burst = rate * BANDWIDTH_BURST_NS / 1000000000.0;
+   if (burst < BANDWIDTH_QUANTUM)
+   {
+      burst = BANDWIDTH_QUANTUM;
+   }
+
+   if (bucket->last == 0)
+   {
+      bucket->tokens = burst;
+   }
+   else if (now > bucket->last)
+   {
+      bucket->tokens += rate * (double)(now - bucket->last) / 1000000000.0;
+   }
+
+   if (bucket->tokens > burst)
+   {
+      bucket->tokens = burst;
+   }
+
+   bucket->last = now;
+}
+
+bool
+pgmoneta_bandwidth_bucket_ready(struct bandwidth_bucket* bucket, double rate)
+{
+   return rate <= 0.0 || bucket->tokens >= 0.0;
+}
+
+void
+pgmoneta_bandwidth_bucket_take(struct bandwidth_bucket* bucket, double rate, size_t bytes)
+{
+   if (rate > 0.0)
+   {
+      bucket->tokens -= (double)bytes;
+   }
+}
+
+int64_t
+pgmoneta_bandwidth_bucket_wait(struct bandwidth_bucket* bucket, double rate)
+{
+   if (pgmoneta_bandwidth_bucket_ready(bucket, rate))
+   {
+      return 0;
+   }
+
+   return (int64_t)(-bucket->tokens * 1000000000.0 / rate);
+}
+
+static int64_t
+bandwidth_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+bandwidth_flush(void)
+{
+   size_t batch = pending;
+   int server = -1;
+   int operation = -1;
+
+   pending = 0;
+
+   if (batch == 0 || !bandwidth_current(&server, &operation))
+   {
+      return;
+   }
+
+   pgmoneta_bandwidth_acquire(server, operation, batch);
+}
+
+static bool
+bandwidth_current(int* server, int* operation)
+{
+   int top = 0;
+
+   if (depth > 0)
+   {
+      top = (depth < BANDWIDTH_DEPTH ? depth : BANDWIDTH_DEPTH) - 1;
+      *server = current_server[top];
+      *operation = current_operation[top];
+      return true;
+   }
+
+   if (process_server != -1)
+   {
+      *server = process_server;
+      *operation = process_operation;
+      return true;
+   }
+
+   return false;
+}
+
+static bool
+bandwidth_active(struct bandwidth_class* operation, int64_t now)
+{
+   int64_t last = atomic_load(&operation->last_active);
+
+   return last > 0 && now - last < BANDWIDTH_ACTIVE_NS;
+}
@@ -35,13 +35,16 @@
 #include <wal.h>
 #include <walfile/wal_reader.h>
 
-static void generate_art_key_from_brt_key(block_ref_table_key brt_key, char** art_key);
+static void generate_art_key_from_brt_key(block_ref_table_key brt_key, char* art_key);
 static int brt_comparator(const void* a, const void* b);
 static int brt_insert(block_ref_table* brt, block_ref_table_key key, block_ref_table_entry** brt_entry, bool* found);
 static block_ref_table_entry* brt_lookup(block_ref_table* brt, block_ref_table_key key);
 
 static void brt_set_limit_block(block_ref_table_entry* entry, block_number limit_block);
 static void brt_mark_block_modified(block_ref_table_entry* entry, block_number blocknum);
+static void brt_ensure_chunks(block_ref_table_entry* entry, unsigned chunkno);
+static block_ref_table_chunk brt_chunk_to_bitmap(block_ref_table_entry* entry, unsigned chunkno);
+static void brt_chunk_words(block_ref_table_entry* entry, unsigned chunkno, uint64_t* words);
 
 static void brt_write(FILE* f, block_ref_table_buffer* buffer, void* data, int length);
 static int brt_read(FILE* f, struct block_ref_table_reader* reader, void* data, int length);
@@ -255,6 +258,231 @@ pgmoneta_brt_entry_get_blocks(block_ref_table_entry* entry, block_number start_b
    return 0;
 }
 
+uint64_t
+pgmoneta_brt_entry_cardinality(block_ref_table_entry* entry)
+{
+   uint64_t cardinality = 0;
+
+   if (entry == NULL)
+   {
+      return 0;
+   }
+
+   for (uint32_t chunkno = 0; chunkno < entry->nchunks; chunkno++)
+   {
+      uint16_t usage = entry->chunk_usage[chunkno];
+
+      if (usage == MAX_ENTRIES_PER_CHUNK)
+      {
+         block_ref_table_chunk data = entry->chunk_data[chunkno];
+
+         for (unsigned i = 0; i < MAX_ENTRIES_PER_CHUNK; i++)
+         {
+            cardinality += (uint64_t)__builtin_popcount(data[i]);
+         }
+      }
+      else
+      {
+         cardinality += usage;
+      }
+   }
+
+   return cardinality;
+}
+
+int
+pgmoneta_brt_entry_get_ranges(block_ref_table_entry* entry, block_number start_blkno,
+                              block_number stop_blkno, block_ref_table_range* ranges, int nranges, int* n)
+{
+   uint64_t words[BRT_WORDS_PER_CHUNK];
+   uint32_t start_chunkno;
+   uint32_t stop_chunkno;
+   int nresults = 0;
+
+   *n = 0;
+
+   if (entry == NULL || stop_blkno <= start_blkno)
+   {
+      return 0;
+   }
+
+   start_chunkno = start_blkno / BLOCKS_PER_CHUNK;
+   stop_chunkno = (stop_blkno - 1) / BLOCKS_PER_CHUNK + 1;
+   if (stop_chunkno > entry->nchunks)
+   {
+      stop_chunkno = entry->nchunks;
+   }
+
+   for (uint32_t chunkno = start_chunkno; chunkno < stop_chunkno; ++chunkno)
+   {
+      block_number base = chunkno * BLOCKS_PER_CHUNK;
+      unsigned start_offset = 0;
+      unsigned stop_offset = BLOCKS_PER_CHUNK;
+
+      if (entry->chunk_usage[chunkno] == 0)
+      {
+         continue;
+      }
+
+      if (chunkno == start_chunkno)
+      {
+         start_offset = start_blkno - base;
+      }
+      if (chunkno == stop_chunkno - 1 && stop_blkno - base < BLOCKS_PER_CHUNK)
+      {
+         stop_offset = stop_blkno - base;
+      }
+
+      brt_chunk_words(entry, chunkno, words);
+
+      /* Mask the blocks outside of the requested range */
+      for (unsigned i = 0; i < start_offset / 64; i++)
+      {
+         words[i] = 0;
+      }
+      if (start_offset % 64 != 0)
+      {
+         words[start_offset / 64] &= ~(((uint64_t)1 << (start_offset % 64)) - 1);
+      }
+      if (stop_offset % 64 != 0)
+      {
+         words[stop_offset / 64] &= ((uint64_t)1 << (stop_offset % 64)) - 1;
+      }
+      for (unsigned i = (stop_offset + 63) / 64; i < BRT_WORDS_PER_CHUNK; i++)
+      {
+         words[i] = 0;
+      }
+
+      /* Find the runs a word at a time */
+      for (unsigned i = 0; i < BRT_WORDS_PER_CHUNK; i++)
+      {
+         uint64_t w = words[i];
+
+         while (w != 0)
+         {
+            unsigned bit = (unsigned)__builtin_ctzll(w);
+            uint64_t shifted = w >> bit;
+            unsigned length = ~shifted == 0 ? 64 : (unsigned)__builtin_ctzll(~shifted);
+            block_number blkno = base + i * 64 + bit;
+
+            if (nresults > 0 && ranges[nresults - 1].start + ranges[nresults - 1].length == blkno)
+            {
+               ranges[nresults - 1].length += length;
+            }
+            else
+            {
+               if (nresults == nranges)
+               {
+                  *n = nresults;
+                  return 1;
+               }
+
+               ranges[nresults].start = blkno;
+               ranges[nresults].length = length;
+               nresults++;
+            }
+
+            if (bit + length >= 64)
+            {
+               w = 0;
+            }
+            else
+            {
+               w &= ~((((uint64_t)1 << length) - 1) << bit);
+            }
+         }
+      }
+   }
+
+   *n = nresults;
+   return 0;
+}
+
+int
+pgmoneta_brt_union(block_ref_table* brt, block_ref_table* other)
+{
+   struct art_iterator* it = NULL;
+   block_ref_table_entry* source = NULL;
+   block_ref_table_entry* target = NULL;
+
+   if (other == NULL || other->table->size == 0)
+   {
+      return 0;
+   }
+
+   if (pgmoneta_art_iterator_create(other->table, &it))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_art_iterator_next(it))
+   {
+      source = (block_ref_table_entry*)it->value->data;
+
+      /* The other table is newer, so its limit block applies before its blocks */
+      if (pgmoneta_brt_set_limit_block(brt, &source->key.rlocator, source->key.forknum, source->limit_block))
+      {
+         goto error;
+      }
+
+      target = brt_lookup(brt, source->key);
+      if (target == NULL)
+      {
+         goto error;
+      }
+
+      for (uint32_t chunkno = 0; chunkno < source->nchunks; chunkno++)
+      {
+         uint16_t usage = source->chunk_usage[chunkno];
+         block_ref_table_chunk data = source->chunk_data[chunkno];
+
+         if (usage == MAX_ENTRIES_PER_CHUNK)
+         {
+            block_ref_table_chunk bitmap;
+
+            brt_ensure_chunks(target, chunkno);
+            if (target->chunk_size[chunkno] == 0)
+            {
+               target->chunk_data[chunkno] = (uint16_t*)calloc(MAX_ENTRIES_PER_CHUNK, sizeof(uint16_t));
+               target->chunk_size[chunkno] = MAX_ENTRIES_PER_CHUNK;
+               target->chunk_usage[chunkno] = MAX_ENTRIES_PER_CHUNK;
+            }
+
+            /* Bitmaps are combined a word at a time */
+            bitmap = brt_chunk_to_bitmap(target, chunkno);
+
+            for (unsigned i = 0; i < MAX_ENTRIES_PER_CHUNK; i++)
+            {
+               bitmap[i] |= data[i];
+            }
+         }
+         else
+         {
+            for (unsigned i = 0; i < usage; i++)
+            {
+               brt_mark_block_modified(target, chunkno * BLOCKS_PER_CHUNK + data[i]);
+            }
+         }
+      }
+
+      if (source->max_block_number != InvalidBlockNumber &&
+          (target->max_block_number == InvalidBlockNumber || source->max_block_number > target->max_block_number))
+      {
+         target->max_block_number = source->max_block_number;
+      }
+   }
+
+   pgmoneta_art_iterator_destroy(it);
+
+   return 0;
+
+error:
+
+   pgmoneta_art_iterator_destroy(it);
+
+   return 1;
+}
+
 int
 pgmoneta_brt_destroy(block_ref_table* brt)
 {
@@ -383,8 +611,29 @@ error:
 int
 pgmoneta_brt_read(char* file_path, block_ref_table** brt)
 {
-   FILE* file = NULL;
    block_ref_table* b = NULL;
+
+   if (pgmoneta_brt_create_empty(&b))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_brt_merge_file(file_path, b))
+   {
+      goto error;
+   }
+
+   *brt = b;
+   return 0;
+error:
+   pgmoneta_brt_destroy(b);
+   return 1;
+}
+
+int
+pgmoneta_brt_merge_file(char* file_path, block_ref_table* brt)
+{
+   FILE* file = NULL;
    struct rel_file_locator rlocator;
    enum fork_number forknum;
    block_number limit_block;
@@ -399,11 +648,6 @@ pgmoneta_brt_read(char* file_path, block_ref_table** brt)
       return 1; // Error opening file
    }
 
-   if (pgmoneta_brt_create_empty(&b))
-   {
-      goto error;
-   }
-
    if ((reader = (struct block_ref_table_reader*)malloc(sizeof(struct block_ref_table_reader))) == NULL)
    {
       goto error;
@@ -422,7 +666,8 @@ pgmoneta_brt_read(char* file_path, block_ref_table** brt)
 
    while (brt_read_next_relation(file, reader, &rlocator, &forknum, &limit_block))
    {
-      if (pgmoneta_brt_set_limit_block(b, &rlocator, forknum, limit_block))
+      /* The limit block only ever decreases, so it is applied before the blocks of this file */
+      if (pgmoneta_brt_set_limit_block(brt, &rlocator, forknum, limit_block))
       {
          goto error;
       }
@@ -438,7 +683,7 @@ pgmoneta_brt_read(char* file_path, block_ref_table** brt)
 
          for (unsigned i = 0; i < nblocks; i++)
          {
-            if (pgmoneta_brt_mark_block_modified(b, &rlocator, forknum, blocks[i]))
+            if (pgmoneta_brt_mark_block_modified(brt, &rlocator, forknum, blocks[i]))
             {
                goto error;
             }
@@ -446,7 +691,6 @@ pgmoneta_brt_read(char* file_path, block_ref_table** brt)
       }
    }
 
-   *brt = b;
    fclose(file);
    free(reader);
    return 0;
@@ -455,35 +699,41 @@ error:
    {
       fclose(file);
    }
-   pgmoneta_brt_destroy(b);
    free(reader);
    return 1;
 }
 
 static void
-generate_art_key_from_brt_key(block_ref_table_key brt_key, char** art_key)
+generate_art_key_from_brt_key(block_ref_table_key brt_key, char* art_key)
 {
-   char* k = NULL;
-   k = pgmoneta_append_int(k, brt_key.rlocator.spcOid);
-   k = pgmoneta_append_char(k, '_');
-   k = pgmoneta_append_int(k, brt_key.rlocator.dbOid);
-   k = pgmoneta_append_char(k, '_');
-   k = pgmoneta_append_int(k, brt_key.rlocator.relNumber);
-   k = pgmoneta_append_char(k, '_');
-   k = pgmoneta_append_int(k, brt_key.forknum);
-
-   *art_key = k;
+   static const char hex[] = "0123456789ABCDEF";
+   uint32_t parts[3] = {brt_key.rlocator.spcOid, brt_key.rlocator.dbOid, brt_key.rlocator.relNumber};
+   int n = 0;
+
+   /*
+    * The key is the binary key in fixed width hex, so it is built without
+    * allocating and the ART keeps the entries in the serialization order
+    */
+   for (int i = 0; i < 3; i++)
+   {
+      for (int shift = 28; shift >= 0; shift -= 4)
+      {
+         art_key[n++] = hex[(parts[i] >> shift) & 0xF];
+      }
+   }
+   art_key[n++] = hex[brt_key.forknum & 0xF];
+   art_key[n] = '\0';
 }
 
 static int
 brt_insert(block_ref_table* brt, block_ref_table_key key, block_ref_table_entry** brt_entry, bool* found)
 {
-   char* art_key = NULL;
+   char art_key[BRT_KEY_LENGTH];
    block_ref_table_entry* e = NULL;
    struct value_config value_config;
    value_config.destroy_data = pgmoneta_brt_entry_destroy;
 
-   generate_art_key_from_brt_key(key, &art_key);
+   generate_art_key_from_brt_key(key, art_key);
 
    if ((e = (block_ref_table_entry*)pgmoneta_art_search(brt->table, art_key)) != NULL)
    {
@@ -507,25 +757,20 @@ brt_insert(block_ref_table* brt, block_ref_table_key key, block_ref_table_entry*
    }
    *brt_entry = e;
 done:
-   free(art_key);
    return 0;
 error:
    free(e);
-   free(art_key);
    return 1;
 }
 
 static block_ref_table_entry*
 brt_lookup(block_ref_table* brt, block_ref_table_key key)
 {
-   char* art_key = NULL;
-   block_ref_table_entry* e = NULL;
+   char art_key[BRT_KEY_LENGTH];
 
-   generate_art_key_from_brt_key(key, &art_key);
-   e = (block_ref_table_entry*)pgmoneta_art_search(brt->table, art_key);
+   generate_art_key_from_brt_key(key, art_key);
 
-   free(art_key);
-   return e;
+   return (block_ref_table_entry*)pgmoneta_art_search(brt->table, art_key);
 }
 
 static void
@@ -612,42 +857,7 @@ brt_mark_block_modified(block_ref_table_entry* entry, block_number blknum)
     * If 'nchunks' isn't big enough for us to be able to represent the state
     * of this block, we need to enlarge our arrays.
     */
-   if (chunkno >= entry->nchunks)
-   {
-      unsigned max_chunks;
-      unsigned extra_chunks;
-
-      /*
-       * New array size is a power of 2, at least 16, big enough so that
-       * chunkno will be a valid array index.
-       */
-      max_chunks = MAX((uint32_t)16, entry->nchunks);
-      while (max_chunks < chunkno + 1)
-      {
-         max_chunks *= 2;
-      }
-      extra_chunks = max_chunks - entry->nchunks;
-
-      if (entry->nchunks == 0)
-      {
-         entry->chunk_size = (uint16_t*)malloc(sizeof(uint16_t) * max_chunks);
-         memset(&entry->chunk_size[entry->nchunks], 0, sizeof(uint16_t) * max_chunks);
-         entry->chunk_usage = (uint16_t*)malloc(sizeof(uint16_t) * max_chunks);
-         memset(&entry->chunk_usage[entry->nchunks], 0, sizeof(uint16_t) * max_chunks);
-         entry->chunk_data = (block_ref_table_chunk*)malloc(sizeof(block_ref_table_chunk) * max_chunks);
-         memset(&entry->chunk_data[entry->nchunks], 0, sizeof(block_ref_table_chunk) * max_chunks);
-      }
-      else
-      {
-         entry->chunk_size = (uint16_t*)realloc(entry->chunk_size, sizeof(uint16_t) * max_chunks);
-         memset(&entry->chunk_size[entry->nchunks], 0, extra_chunks * sizeof(uint16_t));
-         entry->chunk_usage = (uint16_t*)realloc(entry->chunk_usage, sizeof(uint16_t) * max_chunks);
-         memset(&entry->chunk_usage[entry->nchunks], 0, extra_chunks * sizeof(uint16_t));
-         entry->chunk_data = (block_ref_table_chunk*)realloc(entry->chunk_data, sizeof(block_ref_table_chunk) * max_chunks);
-         memset(&entry->chunk_data[entry->nchunks], 0, extra_chunks * sizeof(block_ref_table_chunk));
-      }
-      entry->nchunks = max_chunks;
-   }
+   brt_ensure_chunks(entry, chunkno);
 
    /*
     * If the chunk that covers this block number doesn't exist yet, create it
@@ -697,31 +907,11 @@ brt_mark_block_modified(block_ref_table_entry* entry, block_number blknum)
     */
    if (entry->chunk_usage[chunkno] == MAX_ENTRIES_PER_CHUNK - 1)
    {
-      block_ref_table_chunk newchunk;
-      unsigned j;
-
-      /* Allocate a new chunk. */
-      newchunk = (uint16_t*)malloc(MAX_ENTRIES_PER_CHUNK * sizeof(uint16_t));
-      memset(newchunk, 0, MAX_ENTRIES_PER_CHUNK * sizeof(uint16_t));
-
-      /* Set the bit for each existing entry. */
-      for (j = 0; j < entry->chunk_usage[chunkno]; ++j)
-      {
-         unsigned coff = entry->chunk_data[chunkno][j];
-
-         newchunk[coff / BLOCKS_PER_ENTRY] |=
-            1 << (coff % BLOCKS_PER_ENTRY);
-      }
+      block_ref_table_chunk newchunk = brt_chunk_to_bitmap(entry, chunkno);
 
       /* Set the bit for the new entry. */
       newchunk[chunkoffset / BLOCKS_PER_ENTRY] |=
          1 << (chunkoffset % BLOCKS_PER_ENTRY);
-
-      /* Swap the new chunk into place and update metadata. */
-      free(entry->chunk_data[chunkno]);
-      entry->chunk_data[chunkno] = newchunk;
-      entry->chunk_size[chunkno] = MAX_ENTRIES_PER_CHUNK;
-      entry->chunk_usage[chunkno] = MAX_ENTRIES_PER_CHUNK;
       return;
    }
 
@@ -943,7 +1133,7 @@ brt_flush(FILE* f, block_ref_table_buffer* buffer)
    size_t bytes_written = 0;
    while (bytes_written < (size_t)buffer->used)
    {
-      bytes_written += fwrite(buffer->data, sizeof(char), buffer->used, f);
+      bytes_written += fwrite(buffer->data + bytes_written, sizeof(char), buffer->used - bytes_written, f);
    }
    fflush(f);
 
@@ -967,7 +1157,7 @@ brt_write(FILE* f, block_ref_table_buffer* buffer, void* data, int length)
    {
       while (bytes_written < (size_t)length)
       {
-         bytes_written += fwrite((char*)data, sizeof(char), length, f);
+         bytes_written += fwrite((char*)data + bytes_written, sizeof(char), length - bytes_written, f);
       }
       fflush(f);
       return;
@@ -992,16 +1182,18 @@ brt_read(FILE* f, struct block_ref_table_reader* reader, void* data, int length)
          bytes_to_copy = MIN(length, buffer->used - buffer->cursor);
          memcpy(data, &buffer->data[buffer->cursor], bytes_to_copy);
          buffer->cursor += bytes_to_copy;
+         data = (char*)data + bytes_to_copy;
          length -= bytes_to_copy;
       }
       else if ((size_t)length >= buffer_size) /* Read directly in this case */
       {
          bytes_read = fread(data, sizeof(char), length, f);
-         length -= bytes_read;
          if (bytes_read == 0)
          {
             return 1;
          }
+         data = (char*)data + bytes_read;
+         length -= bytes_read;
       }
       else /* Refill the buffer */
       {
@@ -1025,3 +1217,104 @@ brt_file_terminate(FILE* f, block_ref_table_buffer* buffer)
    /* Flush any leftover data out of our buffer. */
    brt_flush(f, buffer);
 }
+
+static void
+brt_ensure_chunks(block_ref_table_entry* entry, unsigned chunkno)
+{
+   if (chunkno >= entry->nchunks)
+   {
+      unsigned max_chunks;
+      unsigned extra_chunks;
+
+      /*
+       * New array size is a power of 2, at least 16, big enough so that
+       * chunkno will be a valid array index.
+       */
+      max_chunks = MAX((uint32_t)16, entry->nchunks);
+      while (max_chunks < chunkno + 1)
+      {
+         max_chunks *= 2;
+      }
+      extra_chunks = max_chunks - entry->nchunks;
+
+      if (entry->nchunks == 0)
+      {
+         entry->chunk_size = (uint16_t*)malloc(sizeof(uint16_t) * max_chunks);
+         memset(&entry->chunk_size[entry->nchunks], 0, sizeof(uint16_t) * max_chunks);
+         entry->chunk_usage = (uint16_t*)malloc(sizeof(uint16_t) * max_chunks);
+         memset(&entry->chunk_usage[entry->nchunks], 0, sizeof(uint16_t) * max_chunks);
+         entry->chunk_data = (block_ref_table_chunk*)malloc(sizeof(block_ref_table_chunk) * max_chunks);
+         memset(&entry->chunk_data[entry->nchunks], 0, sizeof(block_ref_table_chunk) * max_chunks);
+      }
+      else
+      {
+         entry->chunk_size = (uint16_t*)realloc(entry->chunk_size, sizeof(uint16_t) * max_chunks);
+         memset(&entry->chunk_size[entry->nchunks], 0, extra_chunks * sizeof(uint16_t));
+         entry->chunk_usage = (uint16_t*)realloc(entry->chunk_usage, sizeof(uint16_t) * max_chunks);
+         memset(&entry->chunk_usage[entry->nchunks], 0, extra_chunks * sizeof(uint16_t));
+         entry->chunk_data = (block_ref_table_chunk*)realloc(entry->chunk_data, sizeof(block_ref_table_chunk) * max_chunks);
+         memset(&entry->chunk_data[entry->nchunks], 0, extra_chunks * sizeof(block_ref_table_chunk));
+      }
+      entry->nchunks = max_chunks;
+   }
+}
+
+static block_ref_table_chunk
+brt_chunk_to_bitmap(block_ref_table_entry* entry, unsigned chunkno)
+{
+   block_ref_table_chunk newchunk;
+
+   if (entry->chunk_usage[chunkno] == MAX_ENTRIES_PER_CHUNK)
+   {
+      return entry->chunk_data[chunkno];
+   }
+
+   /* Allocate a new chunk. */
+   newchunk = (uint16_t*)malloc(MAX_ENTRIES_PER_CHUNK * sizeof(uint16_t));
+   memset(newchunk, 0, MAX_ENTRIES_PER_CHUNK * sizeof(uint16_t));
+
+   /* Set the bit for each existing entry. */
+   for (unsigned j = 0; j < entry->chunk_usage[chunkno]; ++j)
+   {
+      unsigned coff = entry->chunk_data[chunkno][j];
+
+      newchunk[coff / BLOCKS_PER_ENTRY] |=
+         1 << (coff % BLOCKS_PER_ENTRY);
+   }
+
+   /* Swap the new chunk into place and update metadata. */
+   free(entry->chunk_data[chunkno]);
+   entry->chunk_data[chunkno] = newchunk;
+   entry->chunk_size[chunkno] = MAX_ENTRIES_PER_CHUNK;
+   entry->chunk_usage[chunkno] = MAX_ENTRIES_PER_CHUNK;
+
+   return newchunk;
+}
+
+static void
+brt_chunk_words(block_ref_table_entry* entry, unsigned chunkno, uint64_t* words)
+{
+   uint16_t usage = entry->chunk_usage[chunkno];
+   block_ref_table_chunk data = entry->chunk_data[chunkno];
+
+   if (usage == MAX_ENTRIES_PER_CHUNK)
+   {
+      /* Four bitmap entries make a word, independent of the byte order */
+      for (unsigned i = 0; i < BRT_WORDS_PER_CHUNK; i++)
+      {
+         words[i] = (uint64_t)data[4 * i] |
+                    ((uint64_t)data[4 * i + 1] << 16) |
+                    ((uint64_t)data[4 * i + 2] << 32) |
+                    ((uint64_t)data[4 * i + 3] << 48);
+      }
+   }
+   else
+   {
+      memset(words, 0, BRT_WORDS_PER_CHUNK * sizeof(uint64_t));
+
+      for (unsigned i = 0; i < usage; i++)
+      {
+         words[data[i] / 64] |= (uint64_t)1 << (data[i] % 64);
+      }
+   }
+}
@@ -261,12 +261,16 @@ error:
 int
 pgmoneta_bzip2_file(char* from, char* to)
 {
-   int level;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
 
-   level = config->compression_level;
+   return pgmoneta_bzip2_file_level(from, to, config->compression_level);
+}
+
+int
+pgmoneta_bzip2_file_level(char* from, char* to, int level)
+{
    if (level < 1)
    {
       level = 1;
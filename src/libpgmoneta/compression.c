@@ -32,6 +32,7 @@
 #include <files.h>
 #include <gzip_compression.h>
 #include <logging.h>
+#include <lz4.h>
 #include <lz4_compression.h>
 #include <progress.h>
 #include <utils.h>
@@ -40,12 +41,38 @@
 #include <zstandard_compression.h>
 
 #include <dirent.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
+#define COMPRESSION_SKIP_RATIO 0.95
+#define COMPRESSION_FAST_RATIO 0.25
+
 static int
 create_noop_compressor(struct compressor** compressor);
 
+/* The state of one compression run over a directory */
+struct compression_policy
+{
+   int policy;                                                          /**< The compression policy */
+   int level;                                                           /**< The strong compression level */
+   int workers;                                                         /**< The number of workers */
+   double window;                                                       /**< The target window in seconds, or 0 */
+   struct timespec start;                                               /**< The start of the run */
+   char root[MAX_PATH];                                                 /**< The root directory */
+   uint64_t total;                                                      /**< The number of bytes to compress */
+   atomic_ulong done;                                                   /**< The number of bytes processed */
+   atomic_ulong strong_bytes;                                           /**< The number of bytes compressed at the strong level */
+   atomic_ulong strong_time;                                            /**< The time spent at the strong level in nanoseconds */
+   struct compression_class classes[NUMBER_OF_COMPRESSION_CLASSES];     /**< The statistics of the run */
+   struct deque* decisions;                                             /**< The decisions per file */
+   struct zstd_dictionary* dictionary;                                  /**< The dictionary for small files, or NULL */
+};
+
 struct compression_operation_task
 {
    struct worker_common common;
@@ -55,6 +82,7 @@ struct compression_operation_task
    char to[MAX_PATH];
    int server;
    bool progress_enabled;
+   struct compression_policy* policy;
 };
 
 static bool
@@ -74,18 +102,34 @@ pgmoneta_compression_file_callback(int type, compression_func* compress_cb);
 
 static int
 create_compression_operation_task(int server, char* from, char* to, int type, bool decompress,
-                                  struct workers* workers,
+                                  struct workers* workers, struct compression_policy* policy,
                                   struct compression_operation_task** task);
 
 static void
 do_compression_operation(struct worker_common* wc);
 
 static int
-dispatch_compression_operation(int server, char* from, char* to, int type, bool decompress, struct workers* workers);
+dispatch_compression_operation(int server, char* from, char* to, int type, bool decompress, struct workers* workers,
+                               struct compression_policy* policy);
 
 static int
 process_directory_operation(int server, char* directory, int type, struct workers* workers, struct deque* excludes,
-                            bool decompress);
+                            bool decompress, struct compression_policy* policy);
+
+static int
+compress_file_level(char* from, char* to, int type, int level);
+
+static int
+compress_with_policy(struct compression_operation_task* task);
+
+static int
+policy_decide(struct compression_policy* policy, char* path);
+
+static int
+policy_write(struct compression_policy* policy);
+
+static void
+policy_report(struct compression_policy* policy);
 
 static int
 noop_compress(struct compressor* compressor, void* out_buf, size_t out_capacity, size_t* out_size, bool* finished);
@@ -180,7 +224,7 @@ pgmoneta_compress_file(char* from, char* to, int type, struct workers* workers)
 
    if (workers != NULL)
    {
-      return dispatch_compression_operation(-1, from, to, type, false, workers);
+      return dispatch_compression_operation(-1, from, to, type, false, workers, NULL);
    }
 
    if (pgmoneta_compression_file_callback(type, &compress_cb))
@@ -198,7 +242,77 @@ error:
 int
 pgmoneta_compress_directory(int server, char* directory, int type, struct workers* workers, struct deque* excludes)
 {
-   return process_directory_operation(server, directory, type, workers, excludes, false);
+   struct compression_policy policy;
+   struct main_configuration* config;
+   int ret = 1;
+
+   config = (struct main_configuration*)shmem;
+
+   memset(&policy, 0, sizeof(struct compression_policy));
+
+   /* WAL segments keep the configured level, as they are looked up by their suffix */
+   policy.policy = server >= 0 ? config->compression_policy : COMPRESSION_POLICY_FIXED;
+   policy.level = config->compression_level;
+   policy.workers = workers != NULL && server >= 0 ? pgmoneta_get_number_of_workers(server) : 1;
+   policy.window = (double)pgmoneta_time_convert(config->compression_window, FORMAT_TIME_S);
+
+   if (policy.policy == COMPRESSION_POLICY_AUTO)
+   {
+      if (policy.window <= 0)
+      {
+         policy.policy = COMPRESSION_POLICY_ADAPTIVE;
+      }
+      else
+      {
+         policy.total = pgmoneta_directory_size(directory);
+      }
+   }
+
+   if (directory != NULL)
+   {
+      pgmoneta_snprintf(policy.root, sizeof(policy.root), "%s", directory);
+   }
+
+   if (pgmoneta_deque_create(true, &policy.decisions))
+   {
+      goto error;
+   }
+
+   if (server >= 0 && config->compression_dictionary && COMPRESSION_ALGORITHM(type) == COMPRESSION_ALG_ZSTD)
+   {
+      /* A missing dictionary only costs ratio on the small files */
+      if (pgmoneta_zstandard_dictionary_train(directory, policy.level, &policy.dictionary))
+      {
+         pgmoneta_log_warn("Could not train a compression dictionary for %s", directory);
+      }
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &policy.start);
+
+   ret = process_directory_operation(server, directory, type, workers, excludes, false, &policy);
+
+   /* The tasks refer to the policy */
+   if (workers != NULL)
+   {
+      pgmoneta_workers_wait(workers);
+   }
+
+   if (ret == 0)
+   {
+      policy_report(&policy);
+
+      if (policy.policy != COMPRESSION_POLICY_FIXED && policy_write(&policy))
+      {
+         ret = 1;
+      }
+   }
+
+error:
+
+   pgmoneta_zstandard_dictionary_destroy(policy.dictionary);
+   pgmoneta_deque_destroy(policy.decisions);
+
+   return ret;
 }
 
 int
@@ -208,7 +322,7 @@ pgmoneta_decompress_file(char* from, char* to, int type, struct workers* workers
 
    if (workers != NULL)
    {
-      return dispatch_compression_operation(-1, from, to, type, true, workers);
+      return dispatch_compression_operation(-1, from, to, type, true, workers, NULL);
    }
 
    if (COMPRESSION_ALGORITHM(type) == COMPRESSION_ALG_NONE)
@@ -234,7 +348,139 @@ error:
 int
 pgmoneta_decompress_directory(int server, char* directory, int type, struct workers* workers, struct deque* excludes)
 {
-   return process_directory_operation(server, directory, type, workers, excludes, true);
+   return process_directory_operation(server, directory, type, workers, excludes, true, NULL);
+}
+
+int
+pgmoneta_compression_sample(char* path, int* decision)
+{
+   FILE* file = NULL;
+   char* buffer = NULL;
+   char* trial = NULL;
+   size_t n = 0;
+   int bound;
+   int size;
+   double ratio;
+
+   *decision = COMPRESSION_DECISION_STRONG;
+
+   if (path == NULL)
+   {
+      goto error;
+   }
+
+   bound = LZ4_compressBound(COMPRESSION_SAMPLE_SIZE);
+
+   buffer = (char*)malloc(COMPRESSION_SAMPLE_SIZE);
+   trial = (char*)malloc(bound);
+   if (buffer == NULL || trial == NULL)
+   {
+      goto error;
+   }
+
+   file = fopen(path, "rb");
+   if (file == NULL)
+   {
+      goto error;
+   }
+
+   n = fread(buffer, 1, COMPRESSION_SAMPLE_SIZE, file);
+   if (ferror(file))
+   {
+      goto error;
+   }
+
+   if (n == 0)
+   {
+      *decision = COMPRESSION_DECISION_FAST;
+      goto done;
+   }
+
+   /* A trial with the fastest codec is a cheap estimate of the ratio */
+   size = LZ4_compress_fast(buffer, trial, (int)n, bound, 1);
+   if (size <= 0)
+   {
+      goto error;
+   }
+
+   ratio = (double)size / (double)n;
+
+   if (ratio >= COMPRESSION_SKIP_RATIO)
+   {
+      *decision = COMPRESSION_DECISION_SKIP;
+   }
+   else if (ratio <= COMPRESSION_FAST_RATIO)
+   {
+      *decision = COMPRESSION_DECISION_FAST;
+   }
+
+done:
+
+   fclose(file);
+   free(buffer);
+   free(trial);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   free(buffer);
+   free(trial);
+
+   return 1;
+}
+
+int
+pgmoneta_compression_class(char* path)
+{
+   if (path == NULL)
+   {
+      return COMPRESSION_CLASS_OTHER;
+   }
+
+   if (strstr(path, "pg_wal/") != NULL)
+   {
+      return COMPRESSION_CLASS_WAL;
+   }
+
+   if (strstr(path, "pg_xact/") != NULL ||
+       strstr(path, "pg_multixact/") != NULL ||
+       strstr(path, "pg_subtrans/") != NULL ||
+       strstr(path, "pg_commit_ts/") != NULL)
+   {
+      return COMPRESSION_CLASS_TRANSACTION;
+   }
+
+   if (pgmoneta_starts_with(path, "base/") || pgmoneta_starts_with(path, "global/") ||
+       strstr(path, "/base/") != NULL || strstr(path, "/global/") != NULL)
+   {
+      return COMPRESSION_CLASS_RELATION;
+   }
+
+   return COMPRESSION_CLASS_OTHER;
+}
+
+char*
+pgmoneta_compression_class_name(int class)
+{
+   switch (class)
+   {
+      case COMPRESSION_CLASS_RELATION:
+         return "relation";
+      case COMPRESSION_CLASS_WAL:
+         return "wal";
+      case COMPRESSION_CLASS_TRANSACTION:
+         return "transaction";
+      default:
+         break;
+   }
+
+   return "other";
 }
 
 static bool
@@ -271,7 +517,7 @@ is_regular_entry(struct dirent* entry, char* path)
 
 static int
 create_compression_operation_task(int server, char* from, char* to, int type, bool decompress,
-                                  struct workers* workers,
+                                  struct workers* workers, struct compression_policy* policy,
                                   struct compression_operation_task** task)
 {
    struct compression_operation_task* t = NULL;
@@ -304,6 +550,7 @@ create_compression_operation_task(int server, char* from, char* to, int type, bo
    t->common.workers = workers;
    t->server = server;
    t->progress_enabled = (server >= 0 && pgmoneta_is_progress_enabled(server));
+   t->policy = policy;
 
    *task = t;
 
@@ -324,6 +571,10 @@ do_compression_operation(struct worker_common* wc)
    {
       result = pgmoneta_decompress_file(task->from, task->to, task->type, NULL);
    }
+   else if (task->policy != NULL)
+   {
+      result = compress_with_policy(task);
+   }
    else
    {
       result = pgmoneta_compress_file(task->from, task->to, task->type, NULL);
@@ -344,11 +595,12 @@ do_compression_operation(struct worker_common* wc)
 }
 
 static int
-dispatch_compression_operation(int server, char* from, char* to, int type, bool decompress, struct workers* workers)
+dispatch_compression_operation(int server, char* from, char* to, int type, bool decompress, struct workers* workers,
+                               struct compression_policy* policy)
 {
    struct compression_operation_task* task = NULL;
 
-   if (create_compression_operation_task(server, from, to, type, decompress, workers, &task))
+   if (create_compression_operation_task(server, from, to, type, decompress, workers, policy, &task))
    {
       goto error;
    }
@@ -381,7 +633,7 @@ error:
 
 static int
 process_directory_operation(int server, char* directory, int type, struct workers* workers, struct deque* excludes,
-                            bool decompress)
+                            bool decompress, struct compression_policy* policy)
 {
    DIR* dir = NULL;
    struct dirent* entry = NULL;
@@ -429,7 +681,7 @@ process_directory_operation(int server, char* directory, int type, struct worker
 
       if (is_directory_entry(entry, full_path))
       {
-         if (process_directory_operation(server, full_path, type, workers, excludes, decompress))
+         if (process_directory_operation(server, full_path, type, workers, excludes, decompress, policy))
          {
             goto error;
          }
@@ -475,6 +727,8 @@ process_directory_operation(int server, char* directory, int type, struct worker
       {
          if (pgmoneta_ends_with(entry->d_name, "backup_manifest") ||
              pgmoneta_ends_with(entry->d_name, "backup_label") ||
+             pgmoneta_ends_with(entry->d_name, COMPRESSION_MANIFEST) ||
+             pgmoneta_ends_with(entry->d_name, COMPRESSION_DICTIONARY) ||
              pgmoneta_ends_with(entry->d_name, ".tmp") ||
              pgmoneta_ends_with(entry->d_name, ".partial"))
          {
@@ -490,7 +744,7 @@ process_directory_operation(int server, char* directory, int type, struct worker
          to = pgmoneta_append(to, suffix);
       }
 
-      if (dispatch_compression_operation(server, full_path, to, type, decompress, workers))
+      if (dispatch_compression_operation(server, full_path, to, type, decompress, workers, policy))
       {
          free(to);
          goto error;
@@ -512,6 +766,269 @@ error:
    return 1;
 }
 
+static int
+compress_file_level(char* from, char* to, int type, int level)
+{
+   switch (COMPRESSION_ALGORITHM(type))
+   {
+      case COMPRESSION_ALG_GZIP:
+         return pgmoneta_gzip_file_level(from, to, level);
+      case COMPRESSION_ALG_ZSTD:
+         return pgmoneta_zstandardc_file_level(from, to, level);
+      case COMPRESSION_ALG_LZ4:
+         return pgmoneta_lz4c_file(from, to);
+      case COMPRESSION_ALG_BZIP2:
+         return pgmoneta_bzip2_file_level(from, to, level);
+      case COMPRESSION_ALG_NONE:
+      default:
+         break;
+   }
+
+   pgmoneta_log_error("pgmoneta_compress: no compression callback found for type %d", COMPRESSION_ALGORITHM(type));
+
+   return 1;
+}
+
+static uint64_t
+elapsed_ns(struct timespec* start, struct timespec* end)
+{
+   return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000UL + (uint64_t)end->tv_nsec - (uint64_t)start->tv_nsec;
+}
+
+static int
+policy_decide(struct compression_policy* policy, char* path)
+{
+   int decision = COMPRESSION_DECISION_STRONG;
+   struct timespec now;
+   double elapsed;
+   double rate;
+   uint64_t done;
+   uint64_t strong_bytes;
+   uint64_t strong_time;
+
+   if (policy->policy == COMPRESSION_POLICY_FIXED)
+   {
+      return COMPRESSION_DECISION_STRONG;
+   }
+
+   if (pgmoneta_compression_sample(path, &decision))
+   {
+      return COMPRESSION_DECISION_STRONG;
+   }
+
+   if (policy->policy != COMPRESSION_POLICY_AUTO || decision != COMPRESSION_DECISION_STRONG)
+   {
+      return decision;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   elapsed = (double)elapsed_ns(&policy->start, &now) / 1000000000.0;
+
+   if (elapsed >= policy->window)
+   {
+      return COMPRESSION_DECISION_FAST;
+   }
+
+   strong_bytes = atomic_load(&policy->strong_bytes);
+   strong_time = atomic_load(&policy->strong_time);
+   done = atomic_load(&policy->done);
+
+   if (strong_bytes == 0 || strong_time == 0 || done >= policy->total)
+   {
+      return decision;
+   }
+
+   /* Bytes per second that the workers can compress at the strong level */
+   rate = (double)strong_bytes / ((double)strong_time / 1000000000.0) * (double)policy->workers;
+
+   if (rate * (policy->window - elapsed) < (double)(policy->total - done))
+   {
+      decision = COMPRESSION_DECISION_FAST;
+   }
+
+   return decision;
+}
+
+static int
+compress_with_policy(struct compression_operation_task* task)
+{
+   struct compression_policy* policy = task->policy;
+   struct main_configuration* config;
+   struct stat st;
+   struct timespec cpu_start;
+   struct timespec cpu_end;
+   struct timespec wall_start;
+   struct timespec wall_end;
+   char entry[MAX_PATH + 4];
+   char* relative = NULL;
+   uint64_t original = 0;
+   uint64_t compressed = 0;
+   uint64_t cpu;
+   int decision;
+   int level;
+   int class;
+
+   config = (struct main_configuration*)shmem;
+
+   if (stat(task->from, &st) == 0)
+   {
+      original = (uint64_t)st.st_size;
+   }
+
+   relative = task->from;
+   if (policy->root[0] != '\0' && pgmoneta_starts_with(task->from, policy->root))
+   {
+      relative = task->from + strlen(policy->root);
+      while (*relative == '/')
+      {
+         relative++;
+      }
+   }
+
+   decision = policy_decide(policy, task->from);
+   class = pgmoneta_compression_class(relative);
+
+   switch (decision)
+   {
+      case COMPRESSION_DECISION_SKIP:
+         level = COMPRESSION_LEVEL_STORE;
+         break;
+      case COMPRESSION_DECISION_FAST:
+         level = COMPRESSION_LEVEL_FAST;
+         break;
+      default:
+         level = policy->level;
+         break;
+   }
+
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+   clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+   if (policy->dictionary != NULL && original > 0 && original <= ZSTD_DICTIONARY_FILE_SIZE &&
+       decision != COMPRESSION_DECISION_SKIP)
+   {
+      if (pgmoneta_zstandardc_file_dictionary(task->from, task->to, policy->dictionary))
+      {
+         goto error;
+      }
+   }
+   else if (compress_file_level(task->from, task->to, task->type, level))
+   {
+      goto error;
+   }
+
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+   clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+   cpu = elapsed_ns(&cpu_start, &cpu_end);
+
+   if (stat(task->to, &st) == 0)
+   {
+      compressed = (uint64_t)st.st_size;
+   }
+
+   atomic_fetch_add(&policy->done, original);
+
+   if (decision == COMPRESSION_DECISION_STRONG)
+   {
+      atomic_fetch_add(&policy->strong_bytes, original);
+      atomic_fetch_add(&policy->strong_time, elapsed_ns(&wall_start, &wall_end));
+   }
+
+   atomic_fetch_add(&policy->classes[class].files, 1);
+   atomic_fetch_add(&policy->classes[class].original, original);
+   atomic_fetch_add(&policy->classes[class].compressed, compressed);
+   atomic_fetch_add(&policy->classes[class].cpu, cpu);
+
+   atomic_fetch_add(&config->compression_classes[class].files, 1);
+   atomic_fetch_add(&config->compression_classes[class].original, original);
+   atomic_fetch_add(&config->compression_classes[class].compressed, compressed);
+   atomic_fetch_add(&config->compression_classes[class].cpu, cpu);
+
+   if (decision == COMPRESSION_DECISION_SKIP)
+   {
+      atomic_fetch_add(&policy->classes[class].skipped, 1);
+      atomic_fetch_add(&config->compression_classes[class].skipped, 1);
+   }
+
+   if (policy->policy != COMPRESSION_POLICY_FIXED)
+   {
+      pgmoneta_snprintf(&entry[0], sizeof(entry), "%s,%d", relative, decision);
+      pgmoneta_deque_add(policy->decisions, NULL, (uintptr_t)&entry[0], ValueString);
+   }
+
+   return 0;
+
+error:
+
+   return 1;
+}
+
+static int
+policy_write(struct compression_policy* policy)
+{
+   char path[MAX_PATH];
+   FILE* file = NULL;
+   struct deque_iterator* iter = NULL;
+
+   pgmoneta_snprintf(&path[0], sizeof(path), "%s/%s", policy->root, COMPRESSION_MANIFEST);
+
+   file = fopen(path, "w");
+   if (file == NULL)
+   {
+      pgmoneta_log_error("Compression: Could not create %s", path);
+      goto error;
+   }
+
+   if (pgmoneta_deque_iterator_create(policy->decisions, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      fprintf(file, "%s\n", (char*)pgmoneta_value_data(iter->value));
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+
+   fflush(file);
+   fclose(file);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   return 1;
+}
+
+static void
+policy_report(struct compression_policy* policy)
+{
+   for (int i = 0; i < NUMBER_OF_COMPRESSION_CLASSES; i++)
+   {
+      uint64_t files = atomic_load(&policy->classes[i].files);
+      uint64_t original = atomic_load(&policy->classes[i].original);
+      uint64_t compressed = atomic_load(&policy->classes[i].compressed);
+      uint64_t cpu = atomic_load(&policy->classes[i].cpu);
+      double saved = original > compressed ? (double)(original - compressed) : 0.0;
+
+      if (files == 0)
+      {
+         continue;
+      }
+
+      pgmoneta_log_debug("Compression: %s files=%" PRIu64 " skipped=%" PRIu64 " original=%" PRIu64 " compressed=%" PRIu64 " saved/cpu-second=%.0f",
+                         pgmoneta_compression_class_name(i), files, atomic_load(&policy->classes[i].skipped),
+                         original, compressed, cpu > 0 ? saved / ((double)cpu / 1000000000.0) : 0.0);
+   }
+}
+
 int
 pgmoneta_compressor_create(int compression_type, struct compressor** compressor)
 {
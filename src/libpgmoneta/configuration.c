@@ -80,6 +80,7 @@ static int as_logging_level(char* str);
 static int as_logging_mode(char* str);
 static int as_hugepage(char* str);
 static int as_direct_io(char* str);
+static int as_compression_policy(char* str);
 static int as_compression(char* str);
 static int as_storage_engine(char* str);
 static char* as_ciphers(char* str);
@@ -112,6 +113,7 @@ static int to_storage_engine(char* where, int value);
 static int to_create_slot(char* where, int value);
 static int to_hugepage(char* where, int value);
 static int to_direct_io(char* where, int value);
+static int to_compression_policy(char* where, int value);
 static int to_log_type(char* where, int value);
 static int to_log_level(char* where, int value);
 static int to_log_mode(char* where, int value);
@@ -176,6 +178,9 @@ pgmoneta_init_main_configuration(void* shm)
 
    config->compression_type = COMPRESSION_CLIENT_ZSTD;
    config->compression_level = 3;
+   config->compression_policy = COMPRESSION_POLICY_FIXED;
+   config->compression_window = PGMONETA_TIME_DISABLED;
+   config->compression_dictionary = false;
 
    config->common.encryption = ENCRYPTION_NONE;
 
@@ -213,8 +218,18 @@ pgmoneta_init_main_configuration(void* shm)
    atomic_init(&config->common.log_lock, STATE_FREE);
 
    config->max_rate = 0;
+   config->backup_connections = 0;
+
+   config->max_bandwidth = 0;
+   atomic_init(&config->bandwidth.lock, STATE_FREE);
+
+   config->backup_max_concurrent = 0;
+   config->backup_max_per_volume = 0;
+   config->incremental_threshold = 50;
 
    config->verification = PGMONETA_TIME_DISABLED;
+   config->wal_archive = PGMONETA_TIME_DISABLED;
+   config->wal_summary = false;
 
 #ifdef DEBUG
    config->link = true;
@@ -303,12 +318,15 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                   srv.primary = false;
                   atomic_init(&srv.repository, false);
                   atomic_init(&srv.wal_repository, false);
+                  atomic_init(&srv.wal_archive, false);
+                  atomic_init(&srv.wal_summarizer, false);
                   srv.active_backup = false;
                   srv.active_restore = false;
                   srv.active_archive = false;
                   srv.active_delete = false;
                   srv.active_retention = false;
                   srv.wal_streaming = -1;
+                  srv.wal_summarizer_pid = -1;
                   srv.valid = false;
                   srv.fips_enabled = SERVER_FIPS_UNKNOWN;
                   srv.cur_timeline = 1;
@@ -319,6 +337,10 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                   memset(srv.wal_shipping, 0, MAX_PATH);
                   srv.workers = -1;
                   srv.max_rate = -1;
+                  srv.backup_connections = -1;
+                  srv.max_bandwidth = 0;
+                  srv.bandwidth_weight = 1;
+                  srv.backup_priority = 0;
                   srv.progress_enabled = -1;
 
                   idx_server++;
@@ -1213,6 +1235,45 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (pgmoneta_compare_string(key, "compression_policy"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     config->compression_policy = as_compression_policy(value);
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "compression_window"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_seconds(value, &config->compression_window, PGMONETA_TIME_DISABLED))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "compression_dictionary"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_bool(value, &config->compression_dictionary))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (pgmoneta_compare_string(key, "storage_engine"))
                {
                   if (pgmoneta_compare_string(section, "pgmoneta"))
@@ -1785,6 +1846,142 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (pgmoneta_compare_string(key, "backup_connections"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->backup_connections))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else if (strlen(section) > 0)
+                  {
+                     max = strlen(section);
+                     if (max > MISC_LENGTH - 1)
+                     {
+                        max = MISC_LENGTH - 1;
+                     }
+                     memcpy(&srv.name, section, max);
+                     if (as_int(value, &srv.backup_connections))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "max_bandwidth"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_bytes(value, &config->max_bandwidth, 0))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else if (strlen(section) > 0)
+                  {
+                     max = strlen(section);
+                     if (max > MISC_LENGTH - 1)
+                     {
+                        max = MISC_LENGTH - 1;
+                     }
+                     memcpy(&srv.name, section, max);
+                     if (as_bytes(value, &srv.max_bandwidth, 0))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "bandwidth_weight"))
+               {
+                  if (strlen(section) > 0 && !pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     max = strlen(section);
+                     if (max > MISC_LENGTH - 1)
+                     {
+                        max = MISC_LENGTH - 1;
+                     }
+                     memcpy(&srv.name, section, max);
+                     if (as_int(value, &srv.bandwidth_weight))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "backup_max_concurrent"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->backup_max_concurrent))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "backup_max_per_volume"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->backup_max_per_volume))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "incremental_threshold"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_int(value, &config->incremental_threshold))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "backup_priority"))
+               {
+                  if (strlen(section) > 0 && !pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     max = strlen(section);
+                     if (max > MISC_LENGTH - 1)
+                     {
+                        max = MISC_LENGTH - 1;
+                     }
+                     memcpy(&srv.name, section, max);
+                     if (as_int(value, &srv.backup_priority))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else if (pgmoneta_compare_string(key, "verification"))
                {
                   if (pgmoneta_compare_string(section, "pgmoneta"))
@@ -1799,6 +1996,34 @@ pgmoneta_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (pgmoneta_compare_string(key, "wal_archive"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_seconds(value, &config->wal_archive, PGMONETA_TIME_DISABLED))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (pgmoneta_compare_string(key, "wal_summary"))
+               {
+                  if (pgmoneta_compare_string(section, "pgmoneta"))
+                  {
+                     if (as_bool(value, &config->wal_summary))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
 #ifdef DEBUG
                else if (pgmoneta_compare_string(key, "link"))
                {
@@ -1995,6 +2220,11 @@ pgmoneta_validate_main_configuration(void* shm)
       config->workers = 0;
    }
 
+   if (config->backup_connections < 0)
+   {
+      config->backup_connections = 0;
+   }
+
    if (strlen(config->metrics_cert_file) > 0)
    {
       if (!pgmoneta_exists(config->metrics_cert_file))
@@ -2145,6 +2375,35 @@ pgmoneta_validate_main_configuration(void* shm)
       {
          config->common.servers[i].max_rate = -1;
       }
+
+      if (config->common.servers[i].backup_connections < -1)
+      {
+         config->common.servers[i].backup_connections = -1;
+      }
+
+      if (config->common.servers[i].bandwidth_weight < 1)
+      {
+         pgmoneta_log_warn("bandwidth_weight of [%s] must be at least 1", config->common.servers[i].name);
+         config->common.servers[i].bandwidth_weight = 1;
+      }
+   }
+
+   if (config->backup_max_concurrent < 0)
+   {
+      pgmoneta_log_warn("backup_max_concurrent must be 0 or greater");
+      config->backup_max_concurrent = 0;
+   }
+
+   if (config->backup_max_per_volume < 0)
+   {
+      pgmoneta_log_warn("backup_max_per_volume must be 0 or greater");
+      config->backup_max_per_volume = 0;
+   }
+
+   if (config->incremental_threshold < 0 || config->incremental_threshold > 100)
+   {
+      pgmoneta_log_warn("incremental_threshold must be between 0 and 100");
+      config->incremental_threshold = 50;
    }
 
    if (pgmoneta_time_convert(config->verification, FORMAT_TIME_S) < 0)
@@ -2152,6 +2411,35 @@ pgmoneta_validate_main_configuration(void* shm)
       pgmoneta_log_fatal("verification cannot be less than 0");
       return 1;
    }
+
+   if (pgmoneta_time_convert(config->compression_window, FORMAT_TIME_S) < 0)
+   {
+      pgmoneta_log_fatal("compression_window cannot be less than 0");
+      return 1;
+   }
+
+   if (config->compression_policy == COMPRESSION_POLICY_AUTO &&
+       pgmoneta_time_convert(config->compression_window, FORMAT_TIME_S) <= 0)
+   {
+      pgmoneta_log_warn("compression_policy auto requires compression_window, using adaptive");
+   }
+
+   if (config->compression_dictionary && COMPRESSION_ALGORITHM(config->compression_type) != COMPRESSION_ALG_ZSTD)
+   {
+      pgmoneta_log_warn("compression_dictionary requires zstd compression");
+   }
+
+   if (pgmoneta_time_convert(config->wal_archive, FORMAT_TIME_S) < 0)
+   {
+      pgmoneta_log_fatal("wal_archive cannot be less than 0");
+      return 1;
+   }
+
+   if (pgmoneta_time_convert(config->wal_archive, FORMAT_TIME_S) > 0 &&
+       !(config->storage_engine & (STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE)))
+   {
+      pgmoneta_log_warn("wal_archive requires the s3 or azure storage engine");
+   }
    return 0;
 }
 
@@ -3581,6 +3869,30 @@ to_hugepage(char* where, int value)
    return 0;
 }
 
+static int
+to_compression_policy(char* where, int value)
+{
+   if (!where)
+   {
+      return 1;
+   }
+   switch (value)
+   {
+      case COMPRESSION_POLICY_FIXED:
+         snprintf(where, MISC_LENGTH, "%s", "fixed");
+         break;
+      case COMPRESSION_POLICY_ADAPTIVE:
+         snprintf(where, MISC_LENGTH, "%s", "adaptive");
+         break;
+      case COMPRESSION_POLICY_AUTO:
+         snprintf(where, MISC_LENGTH, "%s", "auto");
+         break;
+      default:
+         return 1;
+   }
+   return 0;
+}
+
 static int
 to_direct_io(char* where, int value)
 {
@@ -3727,6 +4039,9 @@ add_configuration_response(struct json* res)
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_MANAGEMENT, (uintptr_t)config->management, ValueInt64);
    pgmoneta_json_put_enum_value(res, CONFIGURATION_ARGUMENT_COMPRESSION, config->compression_type, to_compression);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_COMPRESSION_LEVEL, (uintptr_t)config->compression_level, ValueInt64);
+   pgmoneta_json_put_enum_value(res, CONFIGURATION_ARGUMENT_COMPRESSION_POLICY, config->compression_policy, to_compression_policy);
+   pgmoneta_json_put_time_value(res, CONFIGURATION_ARGUMENT_COMPRESSION_WINDOW, config->compression_window, FORMAT_TIME_S);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_COMPRESSION_DICTIONARY, (uintptr_t)config->compression_dictionary, ValueBool);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_WORKERS, (uintptr_t)config->workers, ValueInt64);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_PROGRESS, (uintptr_t)config->progress, ValueBool);
    pgmoneta_json_put_enum_value(res, CONFIGURATION_ARGUMENT_STORAGE_ENGINE, config->storage_engine, to_storage_engine);
@@ -3770,6 +4085,11 @@ add_configuration_response(struct json* res)
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_METRICS_CA_FILE, (uintptr_t)config->metrics_ca_file, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_LIBEV, (uintptr_t)config->libev, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_MAX_RATE, (uintptr_t)config->max_rate, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_BACKUP_CONNECTIONS, (uintptr_t)config->backup_connections, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_MAX_BANDWIDTH, (uintptr_t)config->max_bandwidth, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_BACKUP_MAX_CONCURRENT, (uintptr_t)config->backup_max_concurrent, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_BACKUP_MAX_PER_VOLUME, (uintptr_t)config->backup_max_per_volume, ValueInt64);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_INCREMENTAL_THRESHOLD, (uintptr_t)config->incremental_threshold, ValueInt64);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_MANIFEST, (uintptr_t)"SHA512", ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_KEEP_ALIVE, (uintptr_t)config->common.keep_alive, ValueBool);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_NODELAY, (uintptr_t)config->common.nodelay, ValueBool);
@@ -3783,6 +4103,8 @@ add_configuration_response(struct json* res)
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_USER_CONF_PATH, (uintptr_t)config->common.users_path, ValueString);
    pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_ADMIN_CONF_PATH, (uintptr_t)config->common.admins_path, ValueString);
    pgmoneta_json_put_time_value(res, CONFIGURATION_ARGUMENT_VERIFICATION, config->verification, FORMAT_TIME_S);
+   pgmoneta_json_put_time_value(res, CONFIGURATION_ARGUMENT_WAL_ARCHIVE, config->wal_archive, FORMAT_TIME_S);
+   pgmoneta_json_put(res, CONFIGURATION_ARGUMENT_WAL_SUMMARY, (uintptr_t)config->wal_summary, ValueBool);
 
    free(ret);
 }
@@ -3858,6 +4180,10 @@ add_servers_configuration_response(struct json* res)
       pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_HOT_STANDBY_TABLESPACES, (uintptr_t)config->common.servers[i].hot_standby_tablespaces, ValueString);
       pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_WORKERS, (uintptr_t)config->common.servers[i].workers, ValueInt64);
       pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_MAX_RATE, (uintptr_t)config->common.servers[i].max_rate, ValueInt64);
+      pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_BACKUP_CONNECTIONS, (uintptr_t)config->common.servers[i].backup_connections, ValueInt64);
+      pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_MAX_BANDWIDTH, (uintptr_t)config->common.servers[i].max_bandwidth, ValueInt64);
+      pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_BANDWIDTH_WEIGHT, (uintptr_t)config->common.servers[i].bandwidth_weight, ValueInt64);
+      pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_BACKUP_PRIORITY, (uintptr_t)config->common.servers[i].backup_priority, ValueInt64);
       pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_PROGRESS, pgmoneta_is_progress_enabled(i), ValueBool);
       pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_MANIFEST, (uintptr_t)"SHA512", ValueString);
       pgmoneta_json_put(server_conf, CONFIGURATION_ARGUMENT_TLS_CERT_FILE, (uintptr_t)config->common.servers[i].tls_cert_file, ValueString);
@@ -4458,6 +4784,34 @@ apply_main_configuration(struct main_configuration* config, struct server* srv,
             unknown = true;
          }
       }
+      else if (pgmoneta_compare_string(key, "backup_connections"))
+      {
+         if (as_int(value, &srv->backup_connections))
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "max_bandwidth"))
+      {
+         if (as_bytes(value, &srv->max_bandwidth, 0))
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "bandwidth_weight"))
+      {
+         if (as_int(value, &srv->bandwidth_weight) || srv->bandwidth_weight < 1)
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "backup_priority"))
+      {
+         if (as_int(value, &srv->backup_priority))
+         {
+            unknown = true;
+         }
+      }
       else if (pgmoneta_compare_string(key, "retention"))
       {
          srv->retention_days = -1;
@@ -4562,6 +4916,24 @@ apply_main_configuration(struct main_configuration* config, struct server* srv,
             unknown = true;
          }
       }
+      else if (pgmoneta_compare_string(key, "compression_policy"))
+      {
+         config->compression_policy = as_compression_policy(value);
+      }
+      else if (pgmoneta_compare_string(key, "compression_window"))
+      {
+         if (as_seconds(value, &config->compression_window, PGMONETA_TIME_DISABLED))
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "compression_dictionary"))
+      {
+         if (as_bool(value, &config->compression_dictionary))
+         {
+            unknown = true;
+         }
+      }
       else if (pgmoneta_compare_string(key, "retention"))
       {
          config->retention_days = -1;
@@ -4580,6 +4952,42 @@ apply_main_configuration(struct main_configuration* config, struct server* srv,
             unknown = true;
          }
       }
+      else if (pgmoneta_compare_string(key, "backup_connections"))
+      {
+         if (as_int(value, &config->backup_connections))
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "max_bandwidth"))
+      {
+         if (as_bytes(value, &config->max_bandwidth, 0))
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "backup_max_concurrent"))
+      {
+         if (as_int(value, &config->backup_max_concurrent) || config->backup_max_concurrent < 0)
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "backup_max_per_volume"))
+      {
+         if (as_int(value, &config->backup_max_per_volume) || config->backup_max_per_volume < 0)
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "incremental_threshold"))
+      {
+         if (as_int(value, &config->incremental_threshold) ||
+             config->incremental_threshold < 0 || config->incremental_threshold > 100)
+         {
+            unknown = true;
+         }
+      }
       else if (pgmoneta_compare_string(key, "verification"))
       {
          if (as_seconds(value, &config->verification, PGMONETA_TIME_DISABLED))
@@ -4587,6 +4995,20 @@ apply_main_configuration(struct main_configuration* config, struct server* srv,
             unknown = true;
          }
       }
+      else if (pgmoneta_compare_string(key, "wal_archive"))
+      {
+         if (as_seconds(value, &config->wal_archive, PGMONETA_TIME_DISABLED))
+         {
+            unknown = true;
+         }
+      }
+      else if (pgmoneta_compare_string(key, "wal_summary"))
+      {
+         if (as_bool(value, &config->wal_summary))
+         {
+            unknown = true;
+         }
+      }
       else if (pgmoneta_compare_string(key, "blocking_timeout"))
       {
          if (as_seconds(value, &config->blocking_timeout, PGMONETA_TIME_SEC(DEFAULT_BLOCKING_TIMEOUT)))
@@ -4697,6 +5119,22 @@ write_config_value(char* buffer, char* config_key, size_t buffer_size)
          {
             pgmoneta_snprintf(buffer, buffer_size, "%d", config->compression_level);
          }
+         else if (pgmoneta_compare_string(key_info.key, "compression_policy"))
+         {
+            char policy[MISC_LENGTH];
+
+            memset(&policy[0], 0, sizeof(policy));
+            to_compression_policy(&policy[0], config->compression_policy);
+            pgmoneta_snprintf(buffer, buffer_size, "%s", &policy[0]);
+         }
+         else if (pgmoneta_compare_string(key_info.key, "compression_window"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%" PRId64, pgmoneta_time_convert(config->compression_window, FORMAT_TIME_S));
+         }
+         else if (pgmoneta_compare_string(key_info.key, "compression_dictionary"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%s", config->compression_dictionary ? "on" : "off");
+         }
          else if (pgmoneta_compare_string(key_info.key, "storage_engine"))
          {
             pgmoneta_snprintf(buffer, buffer_size, "%d", config->storage_engine);
@@ -4705,10 +5143,38 @@ write_config_value(char* buffer, char* config_key, size_t buffer_size)
          {
             pgmoneta_snprintf(buffer, buffer_size, "%d", config->max_rate);
          }
+         else if (pgmoneta_compare_string(key_info.key, "backup_connections"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%d", config->backup_connections);
+         }
+         else if (pgmoneta_compare_string(key_info.key, "max_bandwidth"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%d", config->max_bandwidth);
+         }
+         else if (pgmoneta_compare_string(key_info.key, "backup_max_concurrent"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%d", config->backup_max_concurrent);
+         }
+         else if (pgmoneta_compare_string(key_info.key, "backup_max_per_volume"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%d", config->backup_max_per_volume);
+         }
+         else if (pgmoneta_compare_string(key_info.key, "incremental_threshold"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%d", config->incremental_threshold);
+         }
          else if (pgmoneta_compare_string(key_info.key, "verification"))
          {
             pgmoneta_snprintf(buffer, buffer_size, "%" PRId64, pgmoneta_time_convert(config->verification, FORMAT_TIME_S));
          }
+         else if (pgmoneta_compare_string(key_info.key, "wal_archive"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%" PRId64, pgmoneta_time_convert(config->wal_archive, FORMAT_TIME_S));
+         }
+         else if (pgmoneta_compare_string(key_info.key, "wal_summary"))
+         {
+            pgmoneta_snprintf(buffer, buffer_size, "%s", config->wal_summary ? "on" : "off");
+         }
          else if (pgmoneta_compare_string(key_info.key, "retention"))
          {
             char* ret = get_retention_string(config->retention_days, config->retention_weeks, config->retention_months, config->retention_years);
@@ -4768,6 +5234,22 @@ write_config_value(char* buffer, char* config_key, size_t buffer_size)
                {
                   pgmoneta_snprintf(buffer, buffer_size, "%d", srv->max_rate);
                }
+               else if (pgmoneta_compare_string(key_info.key, "backup_connections"))
+               {
+                  pgmoneta_snprintf(buffer, buffer_size, "%d", srv->backup_connections);
+               }
+               else if (pgmoneta_compare_string(key_info.key, "max_bandwidth"))
+               {
+                  pgmoneta_snprintf(buffer, buffer_size, "%d", srv->max_bandwidth);
+               }
+               else if (pgmoneta_compare_string(key_info.key, "bandwidth_weight"))
+               {
+                  pgmoneta_snprintf(buffer, buffer_size, "%d", srv->bandwidth_weight);
+               }
+               else if (pgmoneta_compare_string(key_info.key, "backup_priority"))
+               {
+                  pgmoneta_snprintf(buffer, buffer_size, "%d", srv->backup_priority);
+               }
                else if (pgmoneta_compare_string(key_info.key, "retention"))
                {
                   char* ret = get_retention_string(srv->retention_days, srv->retention_weeks, srv->retention_months, srv->retention_years);
@@ -5256,6 +5738,22 @@ as_logging_mode(char* str)
    return PGMONETA_LOGGING_MODE_APPEND;
 }
 
+static int
+as_compression_policy(char* str)
+{
+   if (!strcasecmp(str, "adaptive"))
+   {
+      return COMPRESSION_POLICY_ADAPTIVE;
+   }
+
+   if (!strcasecmp(str, "auto"))
+   {
+      return COMPRESSION_POLICY_AUTO;
+   }
+
+   return COMPRESSION_POLICY_FIXED;
+}
+
 static int
 as_hugepage(char* str)
 {
@@ -6126,6 +6624,10 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    config->create_slot = reload->create_slot;
    config->compression_type = reload->compression_type;
    config->compression_level = reload->compression_level;
+   config->compression_policy = reload->compression_policy;
+   config->compression_window = reload->compression_window;
+   config->compression_dictionary = reload->compression_dictionary;
+   config->wal_summary = reload->wal_summary;
    if (restart_string("workspace", config->workspace, reload->workspace))
    {
       changed = true;
@@ -6149,6 +6651,11 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
       changed = true;
    }
 
+   if (restart_time("wal_archive", config->wal_archive, reload->wal_archive, true))
+   {
+      changed = true;
+   }
+
    if (strncmp(config->common.log_path, reload->common.log_path, MISC_LENGTH) ||
        config->common.log_rotation_size != reload->common.log_rotation_size ||
        pgmoneta_time_convert(config->common.log_rotation_age, FORMAT_TIME_S) != pgmoneta_time_convert(reload->common.log_rotation_age, FORMAT_TIME_S) ||
@@ -6260,6 +6767,11 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    config->workers = reload->workers;
    config->progress = reload->progress;
    config->max_rate = reload->max_rate;
+   config->backup_connections = reload->backup_connections;
+   config->max_bandwidth = reload->max_bandwidth;
+   config->backup_max_concurrent = reload->backup_max_concurrent;
+   config->backup_max_per_volume = reload->backup_max_per_volume;
+   config->incremental_threshold = reload->incremental_threshold;
 
    /* prometheus */
    atomic_init(&config->common.prometheus.logging_info, 0);
@@ -6355,6 +6867,10 @@ copy_server(struct server* dst, struct server* src)
    dst->workers = src->workers;
    dst->progress = src->progress;
    dst->max_rate = src->max_rate;
+   dst->backup_connections = src->backup_connections;
+   dst->max_bandwidth = src->max_bandwidth;
+   dst->bandwidth_weight = src->bandwidth_weight;
+   dst->backup_priority = src->backup_priority;
 
    if (restart_string("tls_cert_file", dst->tls_cert_file, src->tls_cert_file))
    {
@@ -28,12 +28,16 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <delete.h>
 #include <deque.h>
 #include <logging.h>
 #include <utils.h>
+#include <walarchive.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
+#include <errno.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,8 +53,17 @@
 static void
 delete_wal_older_than(int srv, char* srv_wal, char* base);
 
+static char* get_server_trash(int srv);
+static void do_reclaim(struct worker_common* wc);
+
 int
 pgmoneta_delete(int srv, char* label)
+{
+   return pgmoneta_delete_deferred(srv, label, NULL);
+}
+
+int
+pgmoneta_delete_deferred(int srv, char* label, struct workers* reclaim)
 {
    int ec = -1;
    char* en = NULL;
@@ -70,6 +83,14 @@ pgmoneta_delete(int srv, char* label)
       goto error;
    }
 
+   if (reclaim != NULL)
+   {
+      if (pgmoneta_art_insert(nodes, NODE_RECLAIM, (uintptr_t)reclaim, ValueRef))
+      {
+         goto error;
+      }
+   }
+
    if (pgmoneta_workflow_execute(workflow, nodes, &en, &ec))
    {
       goto error;
@@ -94,6 +115,154 @@ error:
    return 1;
 }
 
+int
+pgmoneta_delete_reclaim(int srv, char* directory, struct workers* reclaim)
+{
+   char* trash = NULL;
+   char* target = NULL;
+   char* name = NULL;
+   size_t length = 0;
+   struct worker_input* wi = NULL;
+
+   if (reclaim == NULL || !pgmoneta_workers_outcome_ok(reclaim))
+   {
+      goto in_place;
+   }
+
+   trash = get_server_trash(srv);
+   if (trash == NULL || pgmoneta_mkdir(trash))
+   {
+      goto in_place;
+   }
+
+   /* The last path component names the entry in the trash */
+   length = strlen(directory);
+   while (length > 1 && directory[length - 1] == '/')
+   {
+      length--;
+   }
+
+   name = directory + length;
+   while (name > directory && *(name - 1) != '/')
+   {
+      name--;
+   }
+
+   target = pgmoneta_append(target, trash);
+   for (char* c = name; c < directory + length; c++)
+   {
+      target = pgmoneta_append_char(target, *c);
+   }
+
+   if (pgmoneta_exists(target))
+   {
+      pgmoneta_delete_directory(target);
+   }
+
+   if (rename(directory, target))
+   {
+      pgmoneta_log_debug("Reclaim: Unable to move %s to %s (%s)", directory, target, strerror(errno));
+      errno = 0;
+      goto in_place;
+   }
+
+   if (pgmoneta_create_worker_input(target, NULL, NULL, 0, reclaim, &wi))
+   {
+      pgmoneta_delete_directory(target);
+      goto done;
+   }
+
+   pgmoneta_log_trace("Reclaim: %s", target);
+
+   if (pgmoneta_workers_add(reclaim, do_reclaim, (struct worker_common*)wi))
+   {
+      pgmoneta_delete_directory(target);
+      free(wi);
+   }
+
+done:
+
+   free(trash);
+   free(target);
+
+   return 0;
+
+in_place:
+
+   free(trash);
+   free(target);
+
+   return pgmoneta_delete_directory(directory);
+}
+
+int
+pgmoneta_delete_trash(int srv, struct workers* reclaim)
+{
+   char* trash = NULL;
+   char* d = NULL;
+   int number_of_directories = 0;
+   char** dirs = NULL;
+
+   trash = get_server_trash(srv);
+   if (trash == NULL)
+   {
+      goto error;
+   }
+
+   if (!pgmoneta_exists(trash))
+   {
+      free(trash);
+      return 0;
+   }
+
+   if (pgmoneta_get_directories(trash, &number_of_directories, &dirs))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_directories; i++)
+   {
+      struct worker_input* wi = NULL;
+
+      d = pgmoneta_append(d, trash);
+      d = pgmoneta_append(d, dirs[i]);
+
+      pgmoneta_log_debug("Reclaim: Left over %s", d);
+
+      if (reclaim != NULL && !pgmoneta_create_worker_input(d, NULL, NULL, 0, reclaim, &wi))
+      {
+         if (pgmoneta_workers_add(reclaim, do_reclaim, (struct worker_common*)wi))
+         {
+            pgmoneta_delete_directory(d);
+            free(wi);
+         }
+      }
+      else
+      {
+         pgmoneta_delete_directory(d);
+      }
+
+      free(d);
+      d = NULL;
+   }
+
+   for (int i = 0; i < number_of_directories; i++)
+   {
+      free(dirs[i]);
+   }
+   free(dirs);
+
+   free(trash);
+
+   return 0;
+
+error:
+
+   free(trash);
+
+   return 1;
+}
+
 int
 pgmoneta_delete_wal(int srv)
 {
@@ -207,6 +376,13 @@ delete_wal_older_than(int srv, char* srv_wal, char* base)
             delete = true;
          }
 
+         /* Keep the WAL that the WAL archive hasn't uploaded yet */
+         if (delete && !pgmoneta_wal_archive_is_archived(srv, file))
+         {
+            pgmoneta_log_debug("WAL: Keeping %s until it is archived", file);
+            delete = false;
+         }
+
          if (delete)
          {
             memset(wal_address, 0, MAX_PATH);
@@ -253,3 +429,32 @@ error:
    pgmoneta_deque_destroy(wal_files);
    pgmoneta_deque_iterator_destroy(iter);
 }
+
+static char*
+get_server_trash(int srv)
+{
+   char* d = NULL;
+
+   d = pgmoneta_get_server(srv);
+   if (d == NULL)
+   {
+      return NULL;
+   }
+
+   d = pgmoneta_append(d, "trash/");
+
+   return d;
+}
+
+static void
+do_reclaim(struct worker_common* wc)
+{
+   struct worker_input* wi = (struct worker_input*)wc;
+
+   if (pgmoneta_delete_directory(wi->directory))
+   {
+      pgmoneta_log_warn("Reclaim: Unable to remove %s", wi->directory);
+   }
+
+   free(wi);
+}
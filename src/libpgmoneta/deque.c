@@ -29,22 +29,50 @@
 #include <pgmoneta.h>
 #include <deque.h>
 #include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+#define DEQUE_INITIAL_CAPACITY      8
+#define DEQUE_INDEX_THRESHOLD      16
+#define DEQUE_INDEX_INITIAL_CAPACITY 64
+#define DEQUE_INDEX_DELETED        UINT64_MAX
+#define DEQUE_SORT_RUN             16
+
+/** @struct deque_index_entry
+ * Defines an entry of the tag index
+ */
+struct deque_index_entry
+{
+   uint64_t position; /**< The position of the node, 0 if the entry is empty */
+   uint32_t hash;     /**< The hash of the tag */
+};
+
+/** @struct deque_index
+ * Defines the tag index of a deque, an open addressing hash table from the
+ * hash of a tag to the positions of the nodes carrying it
+ */
+struct deque_index
+{
+   struct deque_index_entry* entries; /**< The entries */
+   uint32_t capacity;                 /**< The number of entries, a power of two */
+   uint32_t count;                    /**< The number of positions */
+   uint32_t deleted;                  /**< The number of deleted entries */
+};
+
 // tag is copied if not NULL
-static void
+static int
 deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type, struct value_config* config);
 
 // tag is copied if not NULL
-static void
-deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node** node);
+static int
+deque_node_create(struct deque* deque, uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node* node);
 
-// tag will always be freed
+// tag will always be freed, the node becomes a hole
 static void
-deque_node_destroy(struct deque_node* node);
+deque_node_destroy(struct deque* deque, struct deque_node* node);
 
 static void
 deque_read_lock(struct deque* deque);
@@ -55,12 +83,67 @@ deque_write_lock(struct deque* deque);
 static void
 deque_unlock(struct deque* deque);
 
-static struct deque_node*
-deque_next(struct deque* deque, struct deque_node* node);
+/**
+ * Take the lock for a tag lookup. Once a deque is large enough the first
+ * lookup builds the tag index, which needs the write lock
+ * @param deque The deque
+ */
+static void
+deque_lookup_lock(struct deque* deque);
 
+/**
+ * Get the node at a position
+ * @param deque The deque
+ * @param position The position, which must be in the ring
+ * @return The node
+ */
 static struct deque_node*
+deque_node_at(struct deque* deque, uint64_t position);
+
+/**
+ * Get the position of the first live node at or after a position
+ * @param deque The deque
+ * @param position The position
+ * @return The position, or 0 if there is none
+ */
+static uint64_t
+deque_next(struct deque* deque, uint64_t position);
+
+/**
+ * Find the first node with a tag
+ * @param deque The deque
+ * @param tag The tag
+ * @return The position of the node, or 0 if not found
+ */
+static uint64_t
 deque_find(struct deque* deque, char* tag);
 
+/**
+ * Move the nodes into a new ring. Positions are kept, unless the holes
+ * are squeezed out, which also drops the tag index
+ * @param deque The deque
+ * @param capacity The capacity of the new ring
+ * @param squeeze Whether to squeeze out the holes
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+deque_relayout(struct deque* deque, uint32_t capacity, bool squeeze);
+
+/**
+ * Remove the node at a position, leaving a hole
+ * @param deque The deque
+ * @param position The position
+ */
+static void
+deque_remove(struct deque* deque, uint64_t position);
+
+/**
+ * Drop the holes at the head of the ring, so the first node is always live
+ * @param deque The deque
+ */
+static void
+deque_trim(struct deque* deque);
+
 static char*
 to_json_string(struct deque* deque, char* tag, int indent);
 
@@ -70,36 +153,66 @@ to_compact_json_string(struct deque* deque, char* tag, int indent);
 static char*
 to_text_string(struct deque* deque, char* tag, int indent);
 
-static struct deque_node*
-deque_remove(struct deque* deque, struct deque_node* node);
+static int
+deque_compare(struct deque_node* a, struct deque_node* b, compare_cb cmp);
+
+/**
+ * Stable sort of a run of nodes, insertion sort for short runs and
+ * bottom-up merge sort on top of them
+ * @param nodes The nodes
+ * @param n The number of nodes
+ * @param cmp The compare function, or NULL for the tags
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+deque_sort(struct deque_node* nodes, uint32_t n, compare_cb cmp);
 
-static struct deque_node*
-get_middle(struct deque_node* node);
+static int
+tag_compare(char* tag1, char* tag2);
 
-static struct deque_node*
-deque_sort(struct deque_node* node, compare_cb cmp);
+static uint32_t
+deque_hash(char* tag);
 
-static struct deque_node*
-deque_merge(struct deque_node* node1, struct deque_node* node2, compare_cb cmp);
+static void
+deque_index_build(struct deque* deque);
 
 static int
-tag_compare(char* tag1, char* tag2);
+deque_index_add(struct deque* deque, uint64_t position, char* tag);
+
+static uint64_t
+deque_index_find(struct deque* deque, char* tag);
+
+static void
+deque_index_remove(struct deque* deque, uint64_t position, char* tag);
+
+static void
+deque_index_destroy(struct deque* deque);
 
 int
 pgmoneta_deque_create(bool thread_safe, struct deque** deque)
+{
+   return pgmoneta_deque_create_with_arena(thread_safe, NULL, deque);
+}
+
+int
+pgmoneta_deque_create_with_arena(bool thread_safe, struct memory_arena* arena, struct deque** deque)
 {
    struct deque* q = NULL;
-   q = malloc(sizeof(struct deque));
-   q->size = 0;
+   q = pgmoneta_memory_alloc(arena, sizeof(struct deque));
+   if (q == NULL)
+   {
+      return 1;
+   }
+   memset(q, 0, sizeof(struct deque));
    q->thread_safe = thread_safe;
+   q->arena = arena;
+   // position 0 means before the first node to an iterator
+   q->first = 1;
    if (thread_safe)
    {
       pthread_rwlock_init(&q->mutex, NULL);
+      pgmoneta_memory_arena_share(arena);
    }
-   deque_node_create(0, ValueInt32, NULL, NULL, &q->start);
-   deque_node_create(0, ValueInt32, NULL, NULL, &q->end);
-   q->start->next = q->end;
-   q->end->prev = q->start;
    *deque = q;
    return 0;
 }
@@ -107,54 +220,74 @@ pgmoneta_deque_create(bool thread_safe, struct deque** deque)
 int
 pgmoneta_deque_add(struct deque* deque, char* tag, uintptr_t data, enum value_type type)
 {
-   deque_offer(deque, tag, data, type, NULL);
-   return 0;
+   return deque_offer(deque, tag, data, type, NULL);
 }
 
 int
 pgmoneta_deque_remove(struct deque* deque, char* tag)
 {
    int cnt = 0;
-   struct deque_iterator* iter = NULL;
+   uint64_t position = 0;
+   struct deque_node* node = NULL;
    if (deque == NULL || tag == NULL)
    {
       return 0;
    }
-   pgmoneta_deque_iterator_create(deque, &iter);
-   while (pgmoneta_deque_iterator_next(iter))
+   deque_write_lock(deque);
+   if (deque->index != NULL)
    {
-      if (pgmoneta_compare_string(iter->tag, tag))
+      while ((position = deque_index_find(deque, tag)) != 0)
       {
-         pgmoneta_deque_iterator_remove(iter);
+         deque_remove(deque, position);
          cnt++;
       }
    }
-   pgmoneta_deque_iterator_destroy(iter);
+   else
+   {
+      for (position = deque->first; position < deque->first + deque->used; position++)
+      {
+         node = deque_node_at(deque, position);
+         if (node->data != NULL && pgmoneta_compare_string(node->tag, tag))
+         {
+            // removing the head drops the holes after it, the end of the ring stays put
+            deque_remove(deque, position);
+            cnt++;
+            if (position < deque->first)
+            {
+               position = deque->first - 1;
+            }
+         }
+      }
+   }
+   deque_unlock(deque);
    return cnt;
 }
 
 int
 pgmoneta_deque_clear(struct deque* deque)
 {
-   struct deque_iterator* iter = NULL;
    if (deque == NULL)
    {
       return 0;
    }
-   pgmoneta_deque_iterator_create(deque, &iter);
-   while (pgmoneta_deque_iterator_next(iter))
+   deque_write_lock(deque);
+   for (uint32_t i = 0; i < deque->used; i++)
    {
-      pgmoneta_deque_iterator_remove(iter);
+      deque_node_destroy(deque, &deque->nodes[(deque->head + i) & (deque->capacity - 1)]);
    }
-   pgmoneta_deque_iterator_destroy(iter);
+   deque_index_destroy(deque);
+   deque->first += deque->used;
+   deque->used = 0;
+   deque->head = 0;
+   deque->size = 0;
+   deque_unlock(deque);
    return 0;
 }
 
 int
 pgmoneta_deque_add_with_config(struct deque* deque, char* tag, uintptr_t data, struct value_config* config)
 {
-   deque_offer(deque, tag, data, ValueRef, config);
-   return 0;
+   return deque_offer(deque, tag, data, ValueRef, config);
 }
 
 uintptr_t
@@ -162,32 +295,46 @@ pgmoneta_deque_poll(struct deque* deque, char** tag)
 {
    struct deque_node* head = NULL;
    struct value* val = NULL;
+   char* t = NULL;
    uintptr_t data = 0;
    if (deque == NULL || pgmoneta_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_write_lock(deque);
-   head = deque->start->next;
-   // this should not happen when size is not 0, but just in case
-   if (head == deque->end)
+   // another thread may have emptied it
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
-   // remove node
-   deque->start->next = head->next;
-   head->next->prev = deque->start;
-   deque->size--;
+   head = &deque->nodes[deque->head];
+   if (deque->index != NULL && head->tag != NULL)
+   {
+      deque_index_remove(deque, deque->first, head->tag);
+   }
    val = head->data;
+   t = head->tag;
+   head->data = NULL;
+   head->tag = NULL;
+   deque->head = (deque->head + 1) & (deque->capacity - 1);
+   deque->first++;
+   deque->used--;
+   deque->size--;
+   deque_trim(deque);
+
    if (tag != NULL)
    {
-      *tag = head->tag;
+      // the caller owns the tag, so hand out a heap copy of an arena tag
+      *tag = deque->arena != NULL && t != NULL ? pgmoneta_append(NULL, t) : t;
+   }
+   else
+   {
+      pgmoneta_memory_release(deque->arena, t);
    }
-   free(head);
 
    data = pgmoneta_value_data(val);
-   free(val);
+   pgmoneta_memory_release(deque->arena, val);
 
    deque_unlock(deque);
    return data;
@@ -198,32 +345,48 @@ pgmoneta_deque_poll_last(struct deque* deque, char** tag)
 {
    struct deque_node* tail = NULL;
    struct value* val = NULL;
+   char* t = NULL;
    uintptr_t data = 0;
    if (deque == NULL || pgmoneta_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_write_lock(deque);
-   tail = deque->end->prev;
-   if (tail == deque->start)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
-   // remove node
-   deque->end->prev = tail->prev;
-   tail->prev->next = deque->end;
+   // skip the holes at the tail
+   tail = deque_node_at(deque, deque->first + deque->used - 1);
+   while (tail->data == NULL)
+   {
+      deque->used--;
+      tail = deque_node_at(deque, deque->first + deque->used - 1);
+   }
+   if (deque->index != NULL && tail->tag != NULL)
+   {
+      deque_index_remove(deque, deque->first + deque->used - 1, tail->tag);
+   }
+   val = tail->data;
+   t = tail->tag;
+   tail->data = NULL;
+   tail->tag = NULL;
+   deque->used--;
    deque->size--;
 
-   val = tail->data;
    if (tag != NULL)
    {
-      *tag = tail->tag;
+      // the caller owns the tag, so hand out a heap copy of an arena tag
+      *tag = deque->arena != NULL && t != NULL ? pgmoneta_append(NULL, t) : t;
+   }
+   else
+   {
+      pgmoneta_memory_release(deque->arena, t);
    }
-   free(tail);
 
    data = pgmoneta_value_data(val);
-   free(val);
+   pgmoneta_memory_release(deque->arena, val);
 
    deque_unlock(deque);
    return data;
@@ -239,13 +402,12 @@ pgmoneta_deque_peek(struct deque* deque, char** tag)
       return 0;
    }
    deque_read_lock(deque);
-   head = deque->start->next;
-   // this should not happen when size is not 0, but just in case
-   if (head == deque->end)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
+   head = &deque->nodes[deque->head];
    val = head->data;
    if (tag != NULL)
    {
@@ -260,18 +422,24 @@ pgmoneta_deque_peek_last(struct deque* deque, char** tag)
 {
    struct deque_node* tail = NULL;
    struct value* val = NULL;
+   uint64_t position = 0;
    if (deque == NULL || pgmoneta_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_read_lock(deque);
-   tail = deque->end->prev;
-   // this should not happen when size is not 0, but just in case
-   if (tail == deque->start)
+   if (deque->size == 0)
    {
       deque_unlock(deque);
       return 0;
    }
+   position = deque->first + deque->used - 1;
+   tail = deque_node_at(deque, position);
+   while (tail->data == NULL)
+   {
+      position--;
+      tail = deque_node_at(deque, position);
+   }
    val = tail->data;
    if (tag != NULL)
    {
@@ -284,16 +452,16 @@ pgmoneta_deque_peek_last(struct deque* deque, char** tag)
 uintptr_t
 pgmoneta_deque_get(struct deque* deque, char* tag)
 {
-   struct deque_node* n = NULL;
+   uint64_t position = 0;
    uintptr_t ret = 0;
 
-   deque_read_lock(deque);
-   n = deque_find(deque, tag);
-   if (n == NULL)
+   deque_lookup_lock(deque);
+   position = deque_find(deque, tag);
+   if (position == 0)
    {
       goto error;
    }
-   ret = pgmoneta_value_data(n->data);
+   ret = pgmoneta_value_data(deque_node_at(deque, position)->data);
    deque_unlock(deque);
    return ret;
 error:
@@ -305,15 +473,10 @@ bool
 pgmoneta_deque_exists(struct deque* deque, char* tag)
 {
    bool ret = false;
-   struct deque_node* n = NULL;
 
-   deque_read_lock(deque);
+   deque_lookup_lock(deque);
 
-   n = deque_find(deque, tag);
-   if (n != NULL)
-   {
-      ret = true;
-   }
+   ret = deque_find(deque, tag) != 0;
 
    deque_unlock(deque);
 
@@ -342,52 +505,50 @@ void
 pgmoneta_deque_sort(struct deque* deque, compare_cb compare)
 {
    deque_write_lock(deque);
-   if (deque == NULL || deque->start == NULL || deque->end == NULL || deque->size <= 1)
+   if (deque == NULL || deque->size <= 1)
    {
       deque_unlock(deque);
       return;
    }
-   // break the connection to start and end node since we are going to move nodes around
-   struct deque_node* first = deque->start->next;
-   struct deque_node* last = deque->end->prev;
-   struct deque_node* node = NULL;
-   first->prev = NULL;
-   last->next = NULL;
-   deque->start->next = NULL;
-   deque->end->prev = NULL;
-   node = deque_sort(first, compare);
-   deque->start->next = node;
-   node->prev = deque->start;
-   while (node->next != NULL)
-   {
-      node = node->next;
-   }
-   deque->end->prev = node;
-   node->next = deque->end;
+   // make the nodes one contiguous run starting at slot 0
+   if ((deque->used != deque->size || deque->head != 0) &&
+       deque_relayout(deque, deque->capacity, true))
+   {
+      pgmoneta_log_error("Deque: out of memory while sorting");
+      deque_unlock(deque);
+      return;
+   }
+   // the positions move, so the tag index goes
+   deque_index_destroy(deque);
+   if (deque_sort(deque->nodes, deque->size, compare))
+   {
+      pgmoneta_log_error("Deque: out of memory while sorting");
+   }
    deque_unlock(deque);
 }
 
 void
 pgmoneta_deque_destroy(struct deque* deque)
 {
-   struct deque_node* n = NULL;
-   struct deque_node* next = NULL;
    if (deque == NULL)
    {
       return;
    }
-   n = deque->start;
-   while (n != NULL)
+   // the nodes of an arena deque are released with the arena
+   if (deque->arena == NULL)
    {
-      next = n->next;
-      deque_node_destroy(n);
-      n = next;
+      for (uint32_t i = 0; i < deque->used; i++)
+      {
+         deque_node_destroy(deque, &deque->nodes[(deque->head + i) & (deque->capacity - 1)]);
+      }
+      free(deque->nodes);
+      deque_index_destroy(deque);
    }
    if (deque->thread_safe)
    {
       pthread_rwlock_destroy(&deque->mutex);
    }
-   free(deque);
+   pgmoneta_memory_release(deque->arena, deque);
 }
 
 void
@@ -399,6 +560,7 @@ pgmoneta_deque_set_thread_safe(struct deque* deque)
    }
    deque->thread_safe = true;
    pthread_rwlock_init(&deque->mutex, NULL);
+   pgmoneta_memory_arena_share(deque->arena);
 }
 
 char*
@@ -442,8 +604,12 @@ pgmoneta_deque_iterator_create(struct deque* deque, struct deque_iterator** iter
       return 1;
    }
    i = malloc(sizeof(struct deque_iterator));
+   if (i == NULL)
+   {
+      return 1;
+   }
    i->deque = deque;
-   i->cur = deque->start;
+   i->position = 0;
    i->tag = NULL;
    i->value = NULL;
    *iter = i;
@@ -453,21 +619,20 @@ pgmoneta_deque_iterator_create(struct deque* deque, struct deque_iterator** iter
 void
 pgmoneta_deque_iterator_remove(struct deque_iterator* iter)
 {
-   if (iter == NULL || iter->cur == NULL || iter->deque == NULL ||
-       iter->cur == iter->deque->start || iter->cur == iter->deque->end)
+   struct deque* deque = NULL;
+   if (iter == NULL || iter->deque == NULL)
    {
       return;
    }
-   iter->cur = deque_remove(iter->deque, iter->cur);
-   if (iter->cur == iter->deque->start)
+   deque = iter->deque;
+   if (iter->position < deque->first || iter->position >= deque->first + deque->used ||
+       deque_node_at(deque, iter->position)->data == NULL)
    {
-      iter->value = NULL;
-      iter->tag = NULL;
       return;
    }
-   iter->value = iter->cur->data;
-   iter->tag = iter->cur->tag;
-   return;
+   deque_remove(deque, iter->position);
+   iter->value = NULL;
+   iter->tag = NULL;
 }
 
 void
@@ -483,17 +648,23 @@ pgmoneta_deque_iterator_destroy(struct deque_iterator* iter)
 bool
 pgmoneta_deque_iterator_next(struct deque_iterator* iter)
 {
+   struct deque_node* node = NULL;
+   uint64_t position = 0;
    if (iter == NULL)
    {
       return false;
    }
-   iter->cur = deque_next(iter->deque, iter->cur);
-   if (iter->cur == NULL)
+   position = deque_next(iter->deque, iter->position + 1);
+   if (position == 0)
    {
+      // park past the end, so that a remove is a no-op
+      iter->position = iter->deque->first + iter->deque->used;
       return false;
    }
-   iter->value = iter->cur->data;
-   iter->tag = iter->cur->tag;
+   node = deque_node_at(iter->deque, position);
+   iter->position = position;
+   iter->value = node->data;
+   iter->tag = node->tag;
    return true;
 }
 
@@ -504,66 +675,100 @@ pgmoneta_deque_iterator_has_next(struct deque_iterator* iter)
    {
       return false;
    }
-   return deque_next(iter->deque, iter->cur) != NULL;
+   return deque_next(iter->deque, iter->position + 1) != 0;
 }
 
-static void
+static int
 deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type, struct value_config* config)
 {
-   struct deque_node* n = NULL;
-   struct deque_node* last = NULL;
+   struct deque_node n;
+   uint32_t capacity = 0;
+   bool squeeze = false;
+
+   if (deque == NULL)
+   {
+      return 1;
+   }
 
    if (type == ValueNone)
    {
-      return;
+      return 0;
+   }
+
+   memset(&n, 0, sizeof(struct deque_node));
+
+   if (deque_node_create(deque, data, type, tag, config, &n))
+   {
+      goto error;
    }
 
-   deque_node_create(data, type, tag, config, &n);
    deque_write_lock(deque);
+
+   if (deque->used == deque->capacity)
+   {
+      // squeeze the holes out rather than grow once they are half of the ring
+      squeeze = deque->used > 0 && (deque->used - deque->size) * 2 >= deque->used;
+      capacity = squeeze ? deque->capacity : (deque->capacity == 0 ? DEQUE_INITIAL_CAPACITY : deque->capacity * 2);
+      if (deque_relayout(deque, capacity, squeeze))
+      {
+         deque_unlock(deque);
+         goto error;
+      }
+   }
+
+   deque->nodes[(deque->head + deque->used) & (deque->capacity - 1)] = n;
+   deque->used++;
    deque->size++;
-   last = deque->end->prev;
-   last->next = n;
-   n->prev = last;
-   n->next = deque->end;
-   deque->end->prev = n;
+
+   if (deque->index != NULL && n.tag != NULL && deque_index_add(deque, deque->first + deque->used - 1, n.tag))
+   {
+      // lookups fall back to a scan
+      deque_index_destroy(deque);
+   }
+
    deque_unlock(deque);
+   return 0;
+
+error:
+   deque_node_destroy(deque, &n);
+   return 1;
 }
 
-static void
-deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node** node)
+static int
+deque_node_create(struct deque* deque, uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node* node)
 {
-   struct deque_node* n = NULL;
-   n = malloc(sizeof(struct deque_node));
-   memset(n, 0, sizeof(struct deque_node));
-   if (config != NULL)
+   node->data = NULL;
+   node->tag = NULL;
+   if (pgmoneta_value_create_with_arena(deque->arena, type, data, config, &node->data))
    {
-      pgmoneta_value_create_with_config(data, config, &n->data);
+      return 1;
    }
-   else
+   if (tag == NULL)
    {
-      pgmoneta_value_create(type, data, &n->data);
+      node->tag = NULL;
    }
-   if (tag != NULL)
+   else if (deque->arena != NULL)
    {
-      n->tag = pgmoneta_append(NULL, tag);
+      node->tag = pgmoneta_memory_arena_strndup(deque->arena, tag, strlen(tag));
    }
    else
    {
-      n->tag = NULL;
+      node->tag = pgmoneta_append(NULL, tag);
    }
-   *node = n;
+   return 0;
 }
 
 static void
-deque_node_destroy(struct deque_node* node)
+deque_node_destroy(struct deque* deque, struct deque_node* node)
 {
    if (node == NULL)
    {
       return;
    }
    pgmoneta_value_destroy(node->data);
-   free(node->tag);
-   free(node);
+   pgmoneta_memory_release(deque->arena, node->tag);
+   node->data = NULL;
+   node->tag = NULL;
 }
 
 static void
@@ -596,42 +801,132 @@ deque_unlock(struct deque* deque)
    pthread_rwlock_unlock(&deque->mutex);
 }
 
+static void
+deque_lookup_lock(struct deque* deque)
+{
+   deque_read_lock(deque);
+   if (deque != NULL && deque->index == NULL && deque->size >= DEQUE_INDEX_THRESHOLD)
+   {
+      deque_unlock(deque);
+      deque_write_lock(deque);
+      deque_index_build(deque);
+   }
+}
+
 static struct deque_node*
-deque_next(struct deque* deque, struct deque_node* node)
+deque_node_at(struct deque* deque, uint64_t position)
 {
-   struct deque_node* next = NULL;
-   if (deque == NULL || deque->size == 0 || node == NULL)
+   return &deque->nodes[(deque->head + (uint32_t)(position - deque->first)) & (deque->capacity - 1)];
+}
+
+static uint64_t
+deque_next(struct deque* deque, uint64_t position)
+{
+   if (deque == NULL || deque->size == 0)
+   {
+      return 0;
+   }
+   if (position < deque->first)
    {
-      return NULL;
+      position = deque->first;
    }
-   if (node->next == deque->end)
+   while (position < deque->first + deque->used)
    {
-      return NULL;
+      if (deque_node_at(deque, position)->data != NULL)
+      {
+         return position;
+      }
+      position++;
    }
-   next = node->next;
-   return next;
+   return 0;
 }
 
-static struct deque_node*
+static uint64_t
 deque_find(struct deque* deque, char* tag)
 {
-   struct deque_node* n = NULL;
+   struct deque_node* node = NULL;
    if (tag == NULL || strlen(tag) == 0 || deque == NULL || deque->size == 0)
    {
-      return NULL;
+      return 0;
    }
-   n = deque_next(deque, deque->start);
+   if (deque->index != NULL)
+   {
+      return deque_index_find(deque, tag);
+   }
+   for (uint64_t position = deque->first; position < deque->first + deque->used; position++)
+   {
+      node = deque_node_at(deque, position);
+      if (node->data != NULL && pgmoneta_compare_string(tag, node->tag))
+      {
+         return position;
+      }
+   }
+   return 0;
+}
+
+static int
+deque_relayout(struct deque* deque, uint32_t capacity, bool squeeze)
+{
+   struct deque_node* nodes = NULL;
+   struct deque_node* node = NULL;
+   uint32_t n = 0;
 
-   while (n != NULL)
+   nodes = pgmoneta_memory_alloc(deque->arena, capacity * sizeof(struct deque_node));
+   if (nodes == NULL)
    {
-      if (pgmoneta_compare_string(tag, n->tag))
+      return 1;
+   }
+
+   for (uint32_t i = 0; i < deque->used; i++)
+   {
+      node = &deque->nodes[(deque->head + i) & (deque->capacity - 1)];
+      if (squeeze && node->data == NULL)
       {
-         return n;
+         continue;
       }
+      nodes[n++] = *node;
+   }
 
-      n = deque_next(deque, n);
+   pgmoneta_memory_release(deque->arena, deque->nodes);
+   deque->nodes = nodes;
+   deque->capacity = capacity;
+   deque->head = 0;
+
+   if (squeeze)
+   {
+      deque->used = n;
+      deque_index_destroy(deque);
+   }
+
+   return 0;
+}
+
+static void
+deque_remove(struct deque* deque, uint64_t position)
+{
+   struct deque_node* node = deque_node_at(deque, position);
+   if (deque->index != NULL && node->tag != NULL)
+   {
+      deque_index_remove(deque, position, node->tag);
+   }
+   deque_node_destroy(deque, node);
+   deque->size--;
+   deque_trim(deque);
+}
+
+static void
+deque_trim(struct deque* deque)
+{
+   while (deque->used > 0 && deque->nodes[deque->head].data == NULL)
+   {
+      deque->head = (deque->head + 1) & (deque->capacity - 1);
+      deque->first++;
+      deque->used--;
+   }
+   if (deque->used == 0)
+   {
+      deque->head = 0;
    }
-   return NULL;
 }
 
 static char*
@@ -640,6 +935,7 @@ to_json_string(struct deque* deque, char* tag, int indent)
    char* ret = NULL;
    ret = pgmoneta_indent(ret, tag, indent);
    struct deque_node* cur = NULL;
+   uint32_t cnt = 0;
    if (deque == NULL || pgmoneta_deque_empty(deque))
    {
       ret = pgmoneta_append(ret, "[]");
@@ -647,12 +943,12 @@ to_json_string(struct deque* deque, char* tag, int indent)
    }
    deque_read_lock(deque);
    ret = pgmoneta_append(ret, "[\n");
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   for (uint64_t position = deque_next(deque, 0); position != 0; position = deque_next(deque, position + 1))
    {
-      bool has_next = cur->next != deque->end;
+      bool has_next = ++cnt < deque->size;
       char* str = NULL;
       char* t = NULL;
+      cur = deque_node_at(deque, position);
       if (cur->tag != NULL)
       {
          t = pgmoneta_append(t, cur->tag);
@@ -663,7 +959,6 @@ to_json_string(struct deque* deque, char* tag, int indent)
       ret = pgmoneta_append(ret, str);
       ret = pgmoneta_append(ret, has_next ? ",\n" : "\n");
       free(str);
-      cur = deque_next(deque, cur);
    }
    ret = pgmoneta_indent(ret, NULL, indent);
    ret = pgmoneta_append(ret, "]");
@@ -677,6 +972,7 @@ to_compact_json_string(struct deque* deque, char* tag, int indent)
    char* ret = NULL;
    ret = pgmoneta_indent(ret, tag, indent);
    struct deque_node* cur = NULL;
+   uint32_t cnt = 0;
    if (deque == NULL || pgmoneta_deque_empty(deque))
    {
       ret = pgmoneta_append(ret, "[]");
@@ -684,12 +980,12 @@ to_compact_json_string(struct deque* deque, char* tag, int indent)
    }
    deque_read_lock(deque);
    ret = pgmoneta_append(ret, "[");
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   for (uint64_t position = deque_next(deque, 0); position != 0; position = deque_next(deque, position + 1))
    {
-      bool has_next = cur->next != deque->end;
+      bool has_next = ++cnt < deque->size;
       char* str = NULL;
       char* t = NULL;
+      cur = deque_node_at(deque, position);
       if (cur->tag != NULL)
       {
          t = pgmoneta_append(t, cur->tag);
@@ -700,7 +996,6 @@ to_compact_json_string(struct deque* deque, char* tag, int indent)
       ret = pgmoneta_append(ret, str);
       ret = pgmoneta_append(ret, has_next ? "," : "");
       free(str);
-      cur = deque_next(deque, cur);
    }
    ret = pgmoneta_append(ret, "]");
    deque_unlock(deque);
@@ -712,6 +1007,7 @@ to_text_string(struct deque* deque, char* tag, int indent)
 {
    char* ret = NULL;
    int cnt = 0;
+   uint32_t visited = 0;
    int next_indent = pgmoneta_compare_string(tag, BULLET_POINT) ? 0 : indent;
    // we have a tag and it's not the bullet point, so that means another line
    if (tag != NULL && !pgmoneta_compare_string(tag, BULLET_POINT))
@@ -726,11 +1022,11 @@ to_text_string(struct deque* deque, char* tag, int indent)
       return ret;
    }
    deque_read_lock(deque);
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   for (uint64_t position = deque_next(deque, 0); position != 0; position = deque_next(deque, position + 1))
    {
-      bool has_next = cur->next != deque->end;
+      bool has_next = ++visited < deque->size;
       char* str = NULL;
+      cur = deque_node_at(deque, position);
       str = pgmoneta_value_to_string(cur->data, FORMAT_TEXT, BULLET_POINT, next_indent);
       if (cnt == 0)
       {
@@ -747,157 +1043,289 @@ to_text_string(struct deque* deque, char* tag, int indent)
       ret = pgmoneta_append(ret, str);
       ret = pgmoneta_append(ret, has_next ? "\n" : "");
       free(str);
-      cur = deque_next(deque, cur);
    }
    deque_unlock(deque);
    return ret;
 }
 
-static struct deque_node*
-deque_remove(struct deque* deque, struct deque_node* node)
+static int
+deque_compare(struct deque_node* a, struct deque_node* b, compare_cb cmp)
 {
-   if (deque == NULL || node == NULL || node == deque->start || node == deque->end)
+   if (cmp != NULL)
    {
-      return NULL;
+      return cmp(a->data, b->data);
    }
-   struct deque_node* prev = node->prev;
-   struct deque_node* next = node->next;
-   prev->next = next;
-   next->prev = prev;
-   deque_node_destroy(node);
-   deque->size--;
-   return prev;
+   return tag_compare(a->tag, b->tag);
 }
 
-static struct deque_node*
-get_middle(struct deque_node* node)
+static int
+deque_sort(struct deque_node* nodes, uint32_t n, compare_cb cmp)
+{
+   struct deque_node* src = nodes;
+   struct deque_node* dst = NULL;
+   struct deque_node* buffer = NULL;
+   struct deque_node* swap = NULL;
+   struct deque_node node;
+
+   // insertion sort the runs, it is stable and cheap on short ones
+   for (uint32_t start = 0; start < n; start += DEQUE_SORT_RUN)
+   {
+      uint32_t end = start + DEQUE_SORT_RUN < n ? start + DEQUE_SORT_RUN : n;
+      for (uint32_t i = start + 1; i < end; i++)
+      {
+         uint32_t j = i;
+         node = nodes[i];
+         while (j > start && deque_compare(&nodes[j - 1], &node, cmp) > 0)
+         {
+            nodes[j] = nodes[j - 1];
+            j--;
+         }
+         nodes[j] = node;
+      }
+   }
+
+   if (n <= DEQUE_SORT_RUN)
+   {
+      return 0;
+   }
+
+   buffer = malloc(n * sizeof(struct deque_node));
+   if (buffer == NULL)
+   {
+      return 1;
+   }
+   dst = buffer;
+
+   // merge the runs pairwise, bouncing between the ring and the buffer
+   for (uint32_t width = DEQUE_SORT_RUN; width < n; width *= 2)
+   {
+      for (uint32_t left = 0; left < n; left += 2 * width)
+      {
+         uint32_t mid = left + width < n ? left + width : n;
+         uint32_t right = left + 2 * width < n ? left + 2 * width : n;
+         uint32_t i = left;
+         uint32_t j = mid;
+         uint32_t k = left;
+
+         while (i < mid && j < right)
+         {
+            // take from the left on ties, which keeps the sort stable
+            if (deque_compare(&src[i], &src[j], cmp) <= 0)
+            {
+               dst[k++] = src[i++];
+            }
+            else
+            {
+               dst[k++] = src[j++];
+            }
+         }
+         while (i < mid)
+         {
+            dst[k++] = src[i++];
+         }
+         while (j < right)
+         {
+            dst[k++] = src[j++];
+         }
+      }
+      swap = src;
+      src = dst;
+      dst = swap;
+   }
+
+   if (src != nodes)
+   {
+      memcpy(nodes, src, n * sizeof(struct deque_node));
+   }
+
+   free(buffer);
+
+   return 0;
+}
+
+static int
+tag_compare(char* tag1, char* tag2)
 {
-   struct deque_node* slow = node;
-   struct deque_node* fast = node;
-   while (fast != NULL && fast->next != NULL)
+   if (tag1 == NULL)
    {
-      slow = slow->next;
-      fast = fast->next->next;
+      return tag2 == NULL ? 0 : 1;
+   }
+   if (tag2 == NULL)
+   {
+      return tag1 == NULL ? 0 : -1;
    }
-   return slow;
+   return strcmp(tag1, tag2);
 }
 
-static struct deque_node*
-deque_sort(struct deque_node* node, compare_cb cmp)
+/* FNV-1a */
+static uint32_t
+deque_hash(char* tag)
 {
-   struct deque_node* mid = NULL;
-   struct deque_node* prevmid = NULL;
-   struct deque_node* node1 = NULL;
-   struct deque_node* node2 = NULL;
-   if (node == NULL || node->next == NULL)
+   uint32_t h = 2166136261U;
+
+   for (unsigned char* c = (unsigned char*)tag; *c != '\0'; c++)
    {
-      return node;
+      h ^= *c;
+      h *= 16777619U;
    }
-   mid = get_middle(node);
-   prevmid = mid->prev;
-   mid->prev = NULL;
-   prevmid->next = NULL;
-   node1 = deque_sort(node, cmp);
-   node2 = deque_sort(mid, cmp);
-   return deque_merge(node1, node2, cmp);
+
+   return h;
 }
 
-static struct deque_node*
-deque_merge(struct deque_node* node1, struct deque_node* node2, compare_cb cmp)
+static void
+deque_index_build(struct deque* deque)
 {
+   struct deque_index* index = NULL;
    struct deque_node* node = NULL;
-   struct deque_node* left = node1;
-   struct deque_node* right = node2;
-   struct deque_node* next = NULL;
-   struct deque_node* start = NULL;
-   if (node1 == NULL)
+   uint32_t capacity = DEQUE_INDEX_INITIAL_CAPACITY;
+
+   if (deque->index != NULL || deque->size < DEQUE_INDEX_THRESHOLD)
+   {
+      return;
+   }
+
+   while (capacity < deque->size * 2)
    {
-      return node2;
+      capacity *= 2;
    }
-   if (node2 == NULL)
+
+   index = pgmoneta_memory_alloc(deque->arena, sizeof(struct deque_index));
+   if (index == NULL)
    {
-      return node1;
+      return;
    }
-   while (left != NULL && right != NULL)
+   index->entries = pgmoneta_memory_alloc(deque->arena, capacity * sizeof(struct deque_index_entry));
+   if (index->entries == NULL)
    {
-      int cmp_result = 0;
+      pgmoneta_memory_release(deque->arena, index);
+      return;
+   }
+   memset(index->entries, 0, capacity * sizeof(struct deque_index_entry));
+   index->capacity = capacity;
+   index->count = 0;
+   index->deleted = 0;
+   deque->index = index;
 
-      if (cmp != NULL)
+   for (uint64_t position = deque->first; position < deque->first + deque->used; position++)
+   {
+      node = deque_node_at(deque, position);
+      if (node->data != NULL && node->tag != NULL)
       {
-         cmp_result = cmp(left->data, right->data);
+         // the table was sized for every node, so this does not grow
+         deque_index_add(deque, position, node->tag);
       }
-      else
+   }
+}
+
+static int
+deque_index_add(struct deque* deque, uint64_t position, char* tag)
+{
+   struct deque_index* index = deque->index;
+   struct deque_index_entry* entries = NULL;
+   uint32_t capacity = DEQUE_INDEX_INITIAL_CAPACITY;
+   uint32_t hash = deque_hash(tag);
+   uint32_t i = 0;
+
+   // keep the table at most half full, counting the deleted entries
+   if ((index->count + index->deleted + 1) * 2 > index->capacity)
+   {
+      while (capacity < (index->count + 1) * 4)
       {
-         cmp_result = tag_compare(left->tag, right->tag);
+         capacity *= 2;
       }
-
-      if (cmp_result <= 0)
+      entries = pgmoneta_memory_alloc(deque->arena, capacity * sizeof(struct deque_index_entry));
+      if (entries == NULL)
       {
-         next = left->next;
-         if (node == NULL)
-         {
-            start = left;
-            node = left;
-            node->prev = NULL;
-            node->next = NULL;
-         }
-         else
-         {
-            node->next = left;
-            left->prev = node;
-            left->next = NULL;
-            node = node->next;
-         }
-         left = next;
+         return 1;
       }
-      else
+      memset(entries, 0, capacity * sizeof(struct deque_index_entry));
+      for (uint32_t j = 0; j < index->capacity; j++)
       {
-         next = right->next;
-         if (node == NULL)
+         if (index->entries[j].position == 0 || index->entries[j].position == DEQUE_INDEX_DELETED)
          {
-            start = right;
-            node = right;
-            node->prev = NULL;
-            node->next = NULL;
+            continue;
          }
-         else
+         i = index->entries[j].hash & (capacity - 1);
+         while (entries[i].position != 0)
          {
-            node->next = right;
-            right->prev = node;
-            right->next = NULL;
-            node = node->next;
+            i = (i + 1) & (capacity - 1);
          }
-         right = next;
+         entries[i] = index->entries[j];
       }
+      pgmoneta_memory_release(deque->arena, index->entries);
+      index->entries = entries;
+      index->capacity = capacity;
+      index->deleted = 0;
    }
-   while (left != NULL)
+
+   i = hash & (index->capacity - 1);
+   while (index->entries[i].position != 0 && index->entries[i].position != DEQUE_INDEX_DELETED)
    {
-      next = left->next;
-      node->next = left;
-      left->prev = node;
-      left = next;
-      node = node->next;
+      i = (i + 1) & (index->capacity - 1);
    }
-   while (right != NULL)
+   if (index->entries[i].position == DEQUE_INDEX_DELETED)
    {
-      next = right->next;
-      node->next = right;
-      right->prev = node;
-      right = next;
-      node = node->next;
+      index->deleted--;
    }
-   return start;
+   index->entries[i].position = position;
+   index->entries[i].hash = hash;
+   index->count++;
+
+   return 0;
 }
-static int
-tag_compare(char* tag1, char* tag2)
+
+static uint64_t
+deque_index_find(struct deque* deque, char* tag)
 {
-   if (tag1 == NULL)
+   struct deque_index* index = deque->index;
+   struct deque_index_entry* entry = NULL;
+   uint32_t hash = deque_hash(tag);
+   uint32_t i = hash & (index->capacity - 1);
+   uint64_t found = 0;
+
+   // tags may repeat, so walk the whole cluster and keep the first node
+   while (index->entries[i].position != 0)
+   {
+      entry = &index->entries[i];
+      if (entry->position != DEQUE_INDEX_DELETED && entry->hash == hash &&
+          (found == 0 || entry->position < found) &&
+          strcmp(deque_node_at(deque, entry->position)->tag, tag) == 0)
+      {
+         found = entry->position;
+      }
+      i = (i + 1) & (index->capacity - 1);
+   }
+
+   return found;
+}
+
+static void
+deque_index_remove(struct deque* deque, uint64_t position, char* tag)
+{
+   struct deque_index* index = deque->index;
+   uint32_t i = deque_hash(tag) & (index->capacity - 1);
+
+   while (index->entries[i].position != 0)
    {
-      return tag2 == NULL ? 0 : 1;
+      if (index->entries[i].position == position)
+      {
+         index->entries[i].position = DEQUE_INDEX_DELETED;
+         index->count--;
+         index->deleted++;
+         return;
+      }
+      i = (i + 1) & (index->capacity - 1);
    }
-   if (tag2 == NULL)
+}
+
+static void
+deque_index_destroy(struct deque* deque)
+{
+   if (deque->index == NULL)
    {
-      return tag1 == NULL ? 0 : -1;
+      return;
    }
-   return strcmp(tag1, tag2);
+   pgmoneta_memory_release(deque->arena, deque->index->entries);
+   pgmoneta_memory_release(deque->arena, deque->index);
+   deque->index = NULL;
 }
@@ -81,14 +81,6 @@ pgmoneta_ext_get_files(SSL* ssl, int socket, char* file_path, struct query_respo
    return query_execute(ssl, socket, query, qr);
 }
 
-int
-pgmoneta_ext_send_file_chunk(SSL* ssl, int socket, char* dest_path, char* base64_data, struct query_response** qr)
-{
-   char query[MAX_QUERY_LENGTH];
-   pgmoneta_snprintf(query, MAX_QUERY_LENGTH, "SELECT pgmoneta_ext_receive_file_chunk('%s', '%s');", base64_data, dest_path);
-   return query_execute(ssl, socket, query, qr);
-}
-
 int
 pgmoneta_ext_promote(SSL* ssl, int socket, struct query_response** qr)
 {
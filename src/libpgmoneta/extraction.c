@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <aes.h>
 #include <compression.h>
 #include <extraction.h>
 #include <files.h>
@@ -119,6 +120,30 @@ bitmask_to_encryption(uint32_t file_type)
    return ENCRYPTION_NONE;
 }
 
+/**
+ * Resolve the file type of a tar archive and verify that it is one.
+ */
+static int
+archive_file_type(char* file_path, uint32_t type, uint32_t* file_type)
+{
+   uint32_t t = type;
+
+   if (t == PGMONETA_FILE_TYPE_UNKNOWN)
+   {
+      t = pgmoneta_extraction_get_file_type(file_path);
+   }
+   t = normalize_file_type(t);
+
+   if (!(t & PGMONETA_FILE_TYPE_TAR))
+   {
+      pgmoneta_log_error("extraction: file is not a TAR archive: %s", file_path);
+      return 1;
+   }
+
+   *file_type = t;
+   return 0;
+}
+
 /**
  * Stream-restore a file: reads src, decrypts+decompresses via streamer(RESTORE),
  * writes the result to dst. All processing happens in memory — no temp files.
@@ -454,3 +479,121 @@ error:
    free(to);
    return 1;
 }
+
+int
+pgmoneta_extract_archive_stream(char* file_path, uint32_t type, tar_member_cb cb, void* arg)
+{
+   uint32_t file_type = 0;
+
+   if (file_path == NULL || cb == NULL)
+   {
+      return 1;
+   }
+
+   if (archive_file_type(file_path, type, &file_type))
+   {
+      return 1;
+   }
+
+   return pgmoneta_untar_stream(file_path, bitmask_to_encryption(file_type), bitmask_to_compression(file_type), cb, arg);
+}
+
+int
+pgmoneta_extract_buffer(char* name, uint32_t type, void* data, size_t size, void** out, size_t* out_size)
+{
+   struct encryptor* encryptor = NULL;
+   struct compressor* compressor = NULL;
+   uint32_t file_type = type;
+   void* dbuf = NULL;
+   size_t dbuf_size = 0;
+   char* result = NULL;
+   size_t result_size = 0;
+   size_t result_capacity = 0;
+   size_t produced = 0;
+   bool finished = false;
+
+   if (name == NULL || data == NULL || out == NULL || out_size == NULL)
+   {
+      goto error;
+   }
+
+   *out = NULL;
+   *out_size = 0;
+
+   if (file_type == PGMONETA_FILE_TYPE_UNKNOWN)
+   {
+      file_type = pgmoneta_extraction_get_file_type(name);
+   }
+   file_type = normalize_file_type(file_type);
+
+   if ((file_type & (PGMONETA_FILE_TYPE_ENCRYPTED | PGMONETA_FILE_TYPE_COMPRESSION_MASK)) == 0)
+   {
+      /* No encryption or compression — just copy */
+      result = malloc(size > 0 ? size : 1);
+      if (result == NULL)
+      {
+         goto error;
+      }
+      memcpy(result, data, size);
+
+      *out = result;
+      *out_size = size;
+      return 0;
+   }
+
+   if (pgmoneta_encryptor_create(bitmask_to_encryption(file_type), &encryptor))
+   {
+      pgmoneta_log_error("extraction: failed to create encryptor for %s", name);
+      goto error;
+   }
+
+   if (pgmoneta_compressor_create(bitmask_to_compression(file_type), &compressor))
+   {
+      pgmoneta_log_error("extraction: failed to create compressor for %s", name);
+      goto error;
+   }
+
+   if (encryptor->decrypt(encryptor, data, size, true, &dbuf, &dbuf_size))
+   {
+      pgmoneta_log_error("extraction: failed to decrypt %s", name);
+      goto error;
+   }
+
+   pgmoneta_compressor_prepare(compressor, dbuf, dbuf_size, true);
+   while (!finished)
+   {
+      if (result_capacity - result_size < BUFFER_SIZE)
+      {
+         char* tmp = NULL;
+
+         result_capacity = result_capacity == 0 ? MAX(size * 4, (size_t)BUFFER_SIZE) : result_capacity * 2;
+         tmp = realloc(result, result_capacity);
+         if (tmp == NULL)
+         {
+            goto error;
+         }
+         result = tmp;
+      }
+
+      if (compressor->decompress(compressor, result + result_size, result_capacity - result_size, &produced, &finished))
+      {
+         pgmoneta_log_error("extraction: failed to decompress %s", name);
+         goto error;
+      }
+      result_size += produced;
+   }
+
+   pgmoneta_compressor_destroy(compressor);
+   pgmoneta_encryptor_destroy(encryptor);
+
+   *out = result;
+   *out_size = result_size;
+
+   return 0;
+
+error:
+   pgmoneta_compressor_destroy(compressor);
+   pgmoneta_encryptor_destroy(encryptor);
+   free(result);
+   return 1;
+}
@@ -161,13 +161,21 @@ error:
 int
 pgmoneta_gzip_file(char* from, char* to)
 {
-   int level;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
 
-   level = config->compression_level;
-   if (level < 1)
+   return pgmoneta_gzip_file_level(from, to, config->compression_level);
+}
+
+int
+pgmoneta_gzip_file_level(char* from, char* to, int level)
+{
+   if (level == COMPRESSION_LEVEL_STORE)
+   {
+      level = 0;
+   }
+   else if (level < 1)
    {
       level = 1;
    }
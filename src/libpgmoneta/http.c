@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <bandwidth.h>
 #include <http.h>
 #include <logging.h>
 #include <network.h>
@@ -442,6 +443,8 @@ pgmoneta_http_invoke(struct http* connection, struct http_request* request, stru
       }
       while ((n = (ssize_t)request->read_cb(stream_buffer, sizeof(stream_buffer), request->read_userdata)) > 0)
       {
+         pgmoneta_bandwidth_consume((size_t)n);
+
          stream_msg.data = stream_buffer;
          stream_msg.length = n;
          if (pgmoneta_write_message(connection->ssl, connection->socket, &stream_msg) != MESSAGE_STATUS_OK)
@@ -452,6 +455,9 @@ pgmoneta_http_invoke(struct http* connection, struct http_request* request, stru
       }
       goto response;
    }
+
+   pgmoneta_bandwidth_consume(full_request_size);
+
 req:
    if (error < 5)
    {
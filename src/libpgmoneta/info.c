@@ -32,6 +32,7 @@
 #include <info.h>
 #include <logging.h>
 #include <management.h>
+#include <manifest.h>
 #include <network.h>
 #include <rfile.h>
 #include <security.h>
@@ -71,6 +72,18 @@ create_info(char* directory, char* label, int status);
 static int
 split_file_path(char* path, char** relative_path, char** bare_file_name);
 
+/** @struct backup_size_input
+ * Defines the backup whose incremental file sizes are resolved
+ */
+struct backup_size_input
+{
+   int server;  /**< The server */
+   char* label; /**< The label of the backup */
+};
+
+static int
+incremental_file_size(char* path, uint64_t manifest_size, void* data, uint64_t* size);
+
 static void
 write_info(FILE* sfile, const char* fmt, ...);
 
@@ -1464,110 +1477,31 @@ error:
 int
 pgmoneta_backup_size(int server, char* label, unsigned long* size, uint64_t* biggest_file_size)
 {
-   struct json* manifest_read = NULL;
-   struct json* files = NULL;
-   struct main_configuration* config = NULL;
-   struct json_iterator* iter = NULL;
    char* manifest_path = NULL;
-   unsigned long sz = 0;
+   uint64_t sz = 0;
    uint64_t biggest_file_sz = 0;
-   char* relative_path = NULL;
-   char* bare_file_name = NULL;
+   struct backup_size_input input;
 
-   config = (struct main_configuration*)shmem;
+   input.server = server;
+   input.label = label;
 
-   // read and traverse the manifest of the incremental backup
+   // stream the manifest of the incremental backup
    manifest_path = pgmoneta_get_server_backup_identifier_data(server, label);
    manifest_path = pgmoneta_append(manifest_path, "backup_manifest");
-   if (pgmoneta_json_read_file(manifest_path, &manifest_read))
+   if (pgmoneta_manifest_sum_sizes(manifest_path, incremental_file_size, &input, &sz, &biggest_file_sz))
    {
       pgmoneta_log_error("Unable to read manifest %s", manifest_path);
       goto error;
    }
 
-   files = (struct json*)pgmoneta_json_get(manifest_read, MANIFEST_FILES);
-
-   if (files == NULL)
-   {
-      goto error;
-   }
-
-   pgmoneta_json_iterator_create(files, &iter);
-   while (pgmoneta_json_iterator_next(iter))
-   {
-      struct json* file = NULL;
-      char* file_path = NULL;
-      uint64_t file_size = 0;
-
-      file = (struct json*)pgmoneta_value_data(iter->value);
-      file_path = (char*)pgmoneta_json_get(file, "Path");
-      /* for incremental files get the `truncated_block_length` */
-      if (pgmoneta_is_incremental_path(file_path))
-      {
-         struct rfile* rf = NULL;
-         uint32_t block_length = 0;
-
-         if (split_file_path(file_path, &relative_path, &bare_file_name))
-         {
-            pgmoneta_log_error("Unable to split file path %s", file_path);
-            goto error;
-         }
-
-         if (pgmoneta_incremental_rfile_initialize(server, label, relative_path, bare_file_name, config->common.encryption, config->compression_type, NULL, &rf))
-         {
-            pgmoneta_log_error("Unable to create rfile %s", bare_file_name);
-            goto error;
-         }
-         block_length = rf->truncation_block_length;
-         for (uint32_t i = 0; i < rf->num_blocks; i++)
-         {
-            if (rf->relative_block_numbers[i] >= block_length)
-            {
-               block_length = rf->relative_block_numbers[i] + 1;
-            }
-         }
-
-         if (block_length == 0)
-         {
-            pgmoneta_log_error("Unable to find block length for %s", bare_file_name);
-            goto error;
-         }
-         file_size = block_length * config->common.servers[server].block_size;
-         pgmoneta_rfile_destroy(rf);
-         free(relative_path);
-         free(bare_file_name);
-         relative_path = NULL;
-         bare_file_name = NULL;
-      }
-      /* for non-incremental files get the file size from manifest itself */
-      else
-      {
-         file_size = (uint64_t)pgmoneta_json_get(file, "Size");
-      }
-
-      if (file_size > biggest_file_sz)
-      {
-         biggest_file_sz = file_size;
-      }
-      sz += file_size;
-   }
-   pgmoneta_json_iterator_destroy(iter);
-
    *size = sz;
    *biggest_file_size = biggest_file_sz;
 
-   pgmoneta_json_destroy(manifest_read);
    free(manifest_path);
-   free(relative_path);
-   free(bare_file_name);
    return 0;
 
 error:
-   pgmoneta_json_iterator_destroy(iter);
-   pgmoneta_json_destroy(manifest_read);
    free(manifest_path);
-   free(relative_path);
-   free(bare_file_name);
    return 1;
 }
 
@@ -1602,6 +1536,65 @@ error:
    return 1;
 }
 
+static int
+incremental_file_size(char* path, uint64_t manifest_size, void* data, uint64_t* size)
+{
+   struct backup_size_input* input = (struct backup_size_input*)data;
+   struct rfile* rf = NULL;
+   uint32_t block_length = 0;
+   char* relative_path = NULL;
+   char* bare_file_name = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   /* for non-incremental files get the file size from manifest itself */
+   if (!pgmoneta_is_incremental_path(path))
+   {
+      *size = manifest_size;
+      return 0;
+   }
+
+   /* for incremental files get the `truncated_block_length` */
+   if (split_file_path(path, &relative_path, &bare_file_name))
+   {
+      pgmoneta_log_error("Unable to split file path %s", path);
+      goto error;
+   }
+
+   if (pgmoneta_incremental_rfile_initialize(input->server, input->label, relative_path, bare_file_name, config->common.encryption, config->compression_type, NULL, &rf))
+   {
+      pgmoneta_log_error("Unable to create rfile %s", bare_file_name);
+      goto error;
+   }
+   block_length = rf->truncation_block_length;
+   for (uint32_t i = 0; i < rf->num_blocks; i++)
+   {
+      if (rf->relative_block_numbers[i] >= block_length)
+      {
+         block_length = rf->relative_block_numbers[i] + 1;
+      }
+   }
+
+   if (block_length == 0)
+   {
+      pgmoneta_log_error("Unable to find block length for %s", bare_file_name);
+      goto error;
+   }
+   *size = (uint64_t)block_length * config->common.servers[input->server].block_size;
+
+   pgmoneta_rfile_destroy(rf);
+   free(relative_path);
+   free(bare_file_name);
+   return 0;
+
+error:
+   pgmoneta_rfile_destroy(rf);
+   free(relative_path);
+   free(bare_file_name);
+   return 1;
+}
+
 static int
 split_file_path(char* path, char** relative_path, char** bare_file_name)
 {
@@ -42,6 +42,21 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * The state of a whole-document parse. The input length is known up front,
+ * and strings are unescaped into a reusable scratch buffer before they are
+ * copied into the document
+ */
+struct json_parser
+{
+   char* str;                  /**< The input */
+   uint64_t len;               /**< The length of the input */
+   struct memory_arena* arena; /**< The arena for the document, or NULL for the heap */
+   char* scratch;              /**< The scratch buffer */
+   size_t scratch_size;        /**< The size of the scratch buffer */
+};
 
 static int advance_to_first_array_element(struct json_reader* reader);
 static int json_read(struct json_reader* reader);
@@ -52,11 +67,17 @@ static int json_stream_parse_item(struct json_reader* reader, struct json** item
 static bool type_allowed(enum value_type type);
 static char* item_to_string(struct json* item, int32_t format, char* tag, int indent);
 static char* array_to_string(struct json* array, int32_t format, char* tag, int indent);
-static int parse_string(char* str, uint64_t* index, struct json** obj);
+static int json_create(struct memory_arena* arena, struct json** object);
+static int parse_document(char* str, uint64_t len, bool arena, struct json** obj);
+static int parse_string(struct json_parser* parser, uint64_t* index, struct json** obj);
+static int parse_quoted(struct json_parser* parser, uint64_t* index, uint64_t* length);
+static int parse_token(struct json_parser* parser, uint64_t start, uint64_t end);
+static int scratch_reserve(struct json_parser* parser, size_t size);
 static int json_add(struct json* obj, char* key, uintptr_t val, enum value_type type);
-static int fill_value(char* str, char* key, uint64_t* index, struct json* o);
+static int fill_value(struct json_parser* parser, char* key, uint64_t* index, struct json* o);
 static bool value_start(char ch);
 static int handle_escape_char(char* str, uint64_t* index, uint64_t len, char* ch);
+static int read_file(char* path, bool arena, struct json** obj);
 
 int
 pgmoneta_json_reader_init(char* path, struct json_reader** reader)
@@ -336,13 +357,38 @@ done:
    return false;
 }
 
+int
+pgmoneta_json_read_item(struct json_reader* reader, struct json** item)
+{
+   *item = NULL;
+
+   if (reader == NULL || reader->state != ItemStart)
+   {
+      goto error;
+   }
+
+   if (json_stream_parse_item(reader, item))
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
+   if (reader != NULL)
+   {
+      reader->state = InvalidState;
+   }
+   return 1;
+}
+
 int
 pgmoneta_json_append(struct json* array, uintptr_t entry, enum value_type type)
 {
    if (array != NULL && array->type == JSONUnknown)
    {
       array->type = JSONArray;
-      pgmoneta_deque_create(false, (struct deque**)&array->elements);
+      pgmoneta_deque_create_with_arena(false, array->arena, (struct deque**)&array->elements);
    }
    if (array == NULL || array->type != JSONArray || !type_allowed(type))
    {
@@ -359,7 +405,7 @@ pgmoneta_json_put(struct json* item, char* key, uintptr_t val, enum value_type t
    if (item != NULL && item->type == JSONUnknown)
    {
       item->type = JSONItem;
-      pgmoneta_art_create((struct art**)&item->elements);
+      pgmoneta_art_create_with_arena(item->arena, (struct art**)&item->elements);
    }
    if (item == NULL || item->type != JSONItem || !type_allowed(type) || key == NULL || strlen(key) == 0)
    {
@@ -432,11 +478,7 @@ pgmoneta_json_clear(struct json* obj)
 int
 pgmoneta_json_create(struct json** object)
 {
-   struct json* o = malloc(sizeof(struct json));
-   memset(o, 0, sizeof(struct json));
-   o->type = JSONUnknown;
-   *object = o;
-   return 0;
+   return json_create(NULL, object);
 }
 
 int
@@ -446,6 +488,14 @@ pgmoneta_json_destroy(struct json* object)
    {
       return 0;
    }
+   if (object->arena != NULL)
+   {
+      if (object->owns_arena)
+      {
+         pgmoneta_memory_arena_destroy(object->arena);
+      }
+      return 0;
+   }
    if (object->type == JSONArray)
    {
       pgmoneta_deque_destroy(object->elements);
@@ -620,13 +670,23 @@ pgmoneta_json_iterator_has_next(struct json_iterator* iter)
 int
 pgmoneta_json_parse_string(char* str, struct json** obj)
 {
-   uint64_t idx = 0;
-   if (str == NULL || strlen(str) < 2)
+   if (str == NULL)
    {
       return 1;
    }
 
-   return parse_string(str, &idx, obj);
+   return parse_document(str, strlen(str), false, obj);
+}
+
+int
+pgmoneta_json_parse_string_arena(char* str, struct json** obj)
+{
+   if (str == NULL)
+   {
+      return 1;
+   }
+
+   return parse_document(str, strlen(str), true, obj);
 }
 
 int
@@ -719,14 +779,74 @@ pgmoneta_json_put_size_value(struct json* res, char* key, unsigned int bytes)
 }
 
 static int
-parse_string(char* str, uint64_t* index, struct json** obj)
+json_create(struct memory_arena* arena, struct json** object)
+{
+   struct json* o = NULL;
+
+   o = pgmoneta_memory_alloc(arena, sizeof(struct json));
+   if (o == NULL)
+   {
+      return 1;
+   }
+   memset(o, 0, sizeof(struct json));
+   o->type = JSONUnknown;
+   o->arena = arena;
+   *object = o;
+   return 0;
+}
+
+static int
+parse_document(char* str, uint64_t len, bool arena, struct json** obj)
+{
+   struct json_parser parser;
+   struct memory_arena* a = NULL;
+   struct json* o = NULL;
+   uint64_t idx = 0;
+
+   memset(&parser, 0, sizeof(struct json_parser));
+
+   if (len < 2)
+   {
+      goto error;
+   }
+
+   if (arena && pgmoneta_memory_arena_create(0, &a))
+   {
+      goto error;
+   }
+
+   parser.str = str;
+   parser.len = len;
+   parser.arena = a;
+
+   if (parse_string(&parser, &idx, &o))
+   {
+      goto error;
+   }
+
+   o->owns_arena = a != NULL;
+
+   free(parser.scratch);
+   *obj = o;
+   return 0;
+
+error:
+   free(parser.scratch);
+   pgmoneta_memory_arena_destroy(a);
+   return 1;
+}
+
+static int
+parse_string(struct json_parser* parser, uint64_t* index, struct json** obj)
 {
    enum json_type type;
    struct json* o = NULL;
+   char* str = parser->str;
+   uint64_t len = parser->len;
    uint64_t idx = *index;
+   uint64_t key_len = 0;
    char ch = str[idx];
    char* key = NULL;
-   uint64_t len = strlen(str);
 
    if (ch == '{')
    {
@@ -741,7 +861,10 @@ parse_string(char* str, uint64_t* index, struct json** obj)
       goto error;
    }
    idx++;
-   pgmoneta_json_create(&o);
+   if (json_create(parser->arena, &o))
+   {
+      goto error;
+   }
    if (type == JSONItem)
    {
       while (idx < len)
@@ -777,30 +900,30 @@ parse_string(char* str, uint64_t* index, struct json** obj)
          {
             goto error;
          }
-         idx++;
          // The key
-         while (idx < len && str[idx] != '"')
+         if (parse_quoted(parser, &idx, &key_len) || key_len == 0)
          {
-            char ec_ch;
-            // handle escape character
-            if (str[idx] == '\\')
+            goto error;
+         }
+         // the scratch buffer is reused by the value, so keep a copy of the key
+         if (parser->arena != NULL)
+         {
+            key = pgmoneta_memory_arena_intern(parser->arena, parser->scratch, key_len);
+         }
+         else
+         {
+            key = malloc(key_len + 1);
+            if (key != NULL)
             {
-               if (handle_escape_char(str, &idx, len, &ec_ch))
-               {
-                  goto error;
-               }
-               key = pgmoneta_append_char(key, ec_ch);
-               continue;
+               memcpy(key, parser->scratch, key_len + 1);
             }
-
-            key = pgmoneta_append_char(key, str[idx++]);
          }
-         if (idx == len || key == NULL)
+         if (key == NULL)
          {
             goto error;
          }
          // The lands between
-         while (idx < len && (str[idx] == '"' || isspace(str[idx])))
+         while (idx < len && isspace(str[idx]))
          {
             idx++;
          }
@@ -817,11 +940,14 @@ parse_string(char* str, uint64_t* index, struct json** obj)
             goto error;
          }
          // The value
-         if (fill_value(str, key, &idx, o))
+         if (fill_value(parser, key, &idx, o))
          {
             goto error;
          }
-         free(key);
+         if (parser->arena == NULL)
+         {
+            free(key);
+         }
          key = NULL;
       }
    }
@@ -860,7 +986,7 @@ parse_string(char* str, uint64_t* index, struct json** obj)
             goto error;
          }
 
-         if (fill_value(str, key, &idx, o))
+         if (fill_value(parser, NULL, &idx, o))
          {
             goto error;
          }
@@ -872,10 +998,101 @@ parse_string(char* str, uint64_t* index, struct json** obj)
    return 0;
 error:
    pgmoneta_json_destroy(o);
-   free(key);
+   if (parser->arena == NULL)
+   {
+      free(key);
+   }
    return 1;
 }
 
+static int
+parse_quoted(struct json_parser* parser, uint64_t* index, uint64_t* length)
+{
+   char* str = parser->str;
+   uint64_t len = parser->len;
+   uint64_t idx = *index + 1;
+   uint64_t start = 0;
+   uint64_t out = 0;
+   char ec_ch;
+
+   while (idx < len && str[idx] != '"')
+   {
+      // copy the run up to the next quote or escape in one go
+      start = idx;
+      while (idx < len && str[idx] != '"' && str[idx] != '\\')
+      {
+         idx++;
+      }
+      if (scratch_reserve(parser, out + (idx - start) + 1))
+      {
+         return 1;
+      }
+      memcpy(parser->scratch + out, str + start, idx - start);
+      out += idx - start;
+
+      if (idx < len && str[idx] == '\\')
+      {
+         if (handle_escape_char(str, &idx, len, &ec_ch))
+         {
+            return 1;
+         }
+         if (scratch_reserve(parser, out + 2))
+         {
+            return 1;
+         }
+         parser->scratch[out++] = ec_ch;
+      }
+   }
+   if (idx == len || scratch_reserve(parser, out + 1))
+   {
+      return 1;
+   }
+   parser->scratch[out] = '\0';
+
+   *index = idx + 1;
+   *length = out;
+   return 0;
+}
+
+static int
+parse_token(struct json_parser* parser, uint64_t start, uint64_t end)
+{
+   if (scratch_reserve(parser, end - start + 1))
+   {
+      return 1;
+   }
+   memcpy(parser->scratch, parser->str + start, end - start);
+   parser->scratch[end - start] = '\0';
+   return 0;
+}
+
+static int
+scratch_reserve(struct json_parser* parser, size_t size)
+{
+   size_t new_size = 0;
+   char* scratch = NULL;
+
+   if (size <= parser->scratch_size)
+   {
+      return 0;
+   }
+
+   new_size = parser->scratch_size > 0 ? parser->scratch_size : 256;
+   while (new_size < size)
+   {
+      new_size *= 2;
+   }
+
+   scratch = realloc(parser->scratch, new_size);
+   if (scratch == NULL)
+   {
+      return 1;
+   }
+   parser->scratch = scratch;
+   parser->scratch_size = new_size;
+   return 0;
+}
+
 static int
 json_add(struct json* obj, char* key, uintptr_t val, enum value_type type)
 {
@@ -901,92 +1118,61 @@ value_start(char ch)
 }
 
 static int
-fill_value(char* str, char* key, uint64_t* index, struct json* o)
+fill_value(struct json_parser* parser, char* key, uint64_t* index, struct json* o)
 {
+   char* str = parser->str;
+   uint64_t len = parser->len;
    uint64_t idx = *index;
-   uint64_t len = strlen(str);
+   uint64_t start = idx;
+
    if (str[idx] == '"')
    {
-      char* val = NULL;
-      idx++;
-      while (idx < len && str[idx] != '"')
-      {
-         char ec_ch;
-         if (str[idx] == '\\')
-         {
-            if (handle_escape_char(str, &idx, len, &ec_ch))
-            {
-               goto error;
-            }
-            val = pgmoneta_append_char(val, ec_ch);
-            continue;
-         }
-
-         val = pgmoneta_append_char(val, str[idx++]);
-      }
-      if (idx == len)
+      uint64_t length = 0;
+      if (parse_quoted(parser, &idx, &length))
       {
          goto error;
       }
-      if (val == NULL)
-      {
-         json_add(o, key, (uintptr_t)"", ValueString);
-      }
-      else
-      {
-         json_add(o, key, (uintptr_t)val, ValueString);
-      }
-      idx++;
-      free(val);
+      json_add(o, key, (uintptr_t)parser->scratch, ValueString);
    }
    else if (str[idx] == '-' || str[idx] == '+' || isdigit(str[idx]))
    {
       bool has_digit = false;
-      char* val_str = NULL;
+      char* end = NULL;
       while (idx < len && (isdigit(str[idx]) || str[idx] == '.' || str[idx] == '-' || str[idx] == '+'))
       {
          if (str[idx] == '.')
          {
             has_digit = true;
          }
-         val_str = pgmoneta_append_char(val_str, str[idx++]);
+         idx++;
+      }
+      if (parse_token(parser, start, idx))
+      {
+         goto error;
       }
       if (has_digit)
       {
-         double val = 0.;
-         if (sscanf(val_str, "%lf", &val) != 1)
+         double val = strtod(parser->scratch, &end);
+         if (end == parser->scratch)
          {
-            free(val_str);
             goto error;
          }
          json_add(o, key, pgmoneta_value_from_double(val), ValueDouble);
-         free(val_str);
       }
       else
       {
-         int64_t val = 0;
-         if (sscanf(val_str, "%" PRId64, &val) != 1)
+         int64_t val = strtoll(parser->scratch, &end, 10);
+         if (end == parser->scratch)
          {
-            free(val_str);
             goto error;
          }
          json_add(o, key, (uintptr_t)val, ValueInt64);
-         free(val_str);
-      }
-   }
-   else if (str[idx] == '{')
-   {
-      struct json* val = NULL;
-      if (parse_string(str, &idx, &val))
-      {
-         goto error;
       }
-      json_add(o, key, (uintptr_t)val, ValueJSON);
    }
-   else if (str[idx] == '[')
+   else if (str[idx] == '{' || str[idx] == '[')
    {
       struct json* val = NULL;
-      if (parse_string(str, &idx, &val))
+      if (parse_string(parser, &idx, &val))
       {
          goto error;
       }
@@ -994,29 +1180,26 @@ fill_value(char* str, char* key, uint64_t* index, struct json* o)
    }
    else if (str[idx] == 'n' || str[idx] == 't' || str[idx] == 'f')
    {
-      char* val = NULL;
       while (idx < len && str[idx] >= 'a' && str[idx] <= 'z')
       {
-         val = pgmoneta_append_char(val, str[idx++]);
+         idx++;
       }
-      if (pgmoneta_compare_string(val, "null"))
+      if (idx - start == 4 && !strncmp(str + start, "null", 4))
       {
          json_add(o, key, 0, ValueString);
       }
-      else if (pgmoneta_compare_string(val, "true"))
+      else if (idx - start == 4 && !strncmp(str + start, "true", 4))
       {
          json_add(o, key, true, ValueBool);
       }
-      else if (pgmoneta_compare_string(val, "false"))
+      else if (idx - start == 5 && !strncmp(str + start, "false", 5))
       {
          json_add(o, key, false, ValueBool);
       }
       else
       {
-         free(val);
          goto error;
       }
-      free(val);
    }
    else
    {
@@ -1460,59 +1643,13 @@ error:
 int
 pgmoneta_json_read_file(char* path, struct json** obj)
 {
-   FILE* file = NULL;
-   char buf[DEFAULT_BUFFER_SIZE];
-   char* str = NULL;
-   struct json* j = NULL;
-
-   *obj = NULL;
-
-   if (path == NULL)
-   {
-      goto error;
-   }
-
-   if (pgmoneta_fopen_secure(path, "r", &file))
-   {
-      pgmoneta_log_error("Failed to open json file %s", path);
-      goto error;
-   }
-
-   memset(buf, 0, sizeof(buf));
-
-   // save the last one for ending so that we get to use append
-   while (fread(buf, 1, DEFAULT_BUFFER_SIZE - 1, file) > 0)
-   {
-      str = pgmoneta_append(str, buf);
-      memset(buf, 0, sizeof(buf));
-   }
-
-   if (pgmoneta_json_parse_string(str, &j))
-   {
-      pgmoneta_log_error("Failed to parse json file %s", path);
-      goto error;
-   }
-
-   *obj = j;
-
-   fflush(file);
-   fclose(file);
-   free(str);
-   return 0;
-
-error:
-
-   pgmoneta_json_destroy(j);
-
-   if (file != NULL)
-   {
-      fflush(file);
-      fclose(file);
-   }
-
-   free(str);
+   return read_file(path, false, obj);
+}
 
-   return 1;
+int
+pgmoneta_json_read_file_arena(char* path, struct json** obj)
+{
+   return read_file(path, true, obj);
 }
 
 int
@@ -1593,3 +1730,70 @@ array_to_string(struct json* array, int32_t format, char* tag, int indent)
 {
    return pgmoneta_deque_to_string(array->elements, format, tag, indent);
 }
+
+static int
+read_file(char* path, bool arena, struct json** obj)
+{
+   FILE* file = NULL;
+   struct stat st;
+   char* str = NULL;
+   size_t size = 0;
+   struct json* j = NULL;
+
+   *obj = NULL;
+
+   if (path == NULL)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_fopen_secure(path, "r", &file))
+   {
+      pgmoneta_log_error("Failed to open json file %s", path);
+      goto error;
+   }
+
+   // read the document in one go, the parser needs all of it anyway
+   if (fstat(fileno(file), &st))
+   {
+      pgmoneta_log_error("Failed to stat json file %s", path);
+      goto error;
+   }
+
+   str = malloc((size_t)st.st_size + 1);
+   if (str == NULL)
+   {
+      goto error;
+   }
+
+   size = fread(str, 1, (size_t)st.st_size, file);
+   if (ferror(file))
+   {
+      pgmoneta_log_error("Failed to read json file %s", path);
+      goto error;
+   }
+   str[size] = '\0';
+
+   if (parse_document(str, size, arena, &j))
+   {
+      pgmoneta_log_error("Failed to parse json file %s", path);
+      goto error;
+   }
+
+   *obj = j;
+
+   fclose(file);
+   free(str);
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   free(str);
+
+   return 1;
+}
@@ -54,6 +54,15 @@ static int read_complete(SSL* ssl, int socket, void* buf, size_t size);
 static int write_complete(SSL* ssl, int socket, void* buf, size_t size);
 static int write_socket(int socket, void* buf, size_t size);
 static int write_ssl(SSL* ssl, void* buf, size_t size);
+static bool is_stream_requested(struct json* json);
+static bool is_stream_array(struct value* value);
+static char* frame_tag(char* key);
+static char* frame_envelope(struct json* response);
+static int merge_frame(struct json* frame, bool first, void* data);
+static int write_frame(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, char* s);
+static int read_frame(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json** frame);
+static int encode_frame(uint8_t compression, uint8_t encryption, char* s, unsigned char** data, size_t* size);
+static int decode_frame(uint8_t compression, uint8_t encryption, unsigned char* data, size_t size, char** s);
 
 int
 pgmoneta_management_request_backup(SSL* ssl, int socket, char* server, uint8_t compression, uint8_t encryption, char* incremental, int32_t output_format)
@@ -1037,7 +1046,14 @@ pgmoneta_management_response_ok(SSL* ssl, int socket, struct timespec start_time
       goto error;
    }
 
-   if (pgmoneta_management_write_json(ssl, socket, compression, encryption, payload))
+   if (is_stream_requested(payload))
+   {
+      if (pgmoneta_management_write_json_stream(ssl, socket, compression, encryption, payload))
+      {
+         goto error;
+      }
+   }
+   else if (pgmoneta_management_write_json(ssl, socket, compression, encryption, payload))
    {
       goto error;
    }
@@ -1168,25 +1184,52 @@ pgmoneta_management_response_error_with_nodes(SSL* ssl, int socket, char* server
 
 int
 pgmoneta_management_read_json(SSL* ssl, int socket, uint8_t* compression, uint8_t* encryption, struct json** json)
+{
+   struct json* r = NULL;
+
+   *json = NULL;
+
+   if (pgmoneta_management_read_frames(ssl, socket, compression, encryption, merge_frame, &r))
+   {
+      goto error;
+   }
+
+   if (r == NULL)
+   {
+      goto error;
+   }
+
+   *json = r;
+
+   return 0;
+
+error:
+
+   pgmoneta_json_destroy(r);
+
+   return 1;
+}
+
+int
+pgmoneta_management_read_frames(SSL* ssl, int socket, uint8_t* compression, uint8_t* encryption, management_frame_cb cb, void* data)
 {
    uint8_t compress_method = MANAGEMENT_COMPRESSION_NONE;
    uint8_t encrypt_method = MANAGEMENT_ENCRYPTION_NONE;
+   bool stream = false;
+   bool first = true;
    char* s = NULL;
-   struct json* r = NULL;
-
-   unsigned char* transfer_buffer = NULL;
    unsigned char* decoded_buffer = NULL;
-   unsigned char* decrypted_buffer = NULL;
-   char* decompressed = NULL;
-   size_t transfer_size = 0;
    size_t decoded_size = 0;
-   size_t decrypted_size = 0;
+   struct json* frame = NULL;
 
    if (read_uint8("pgmoneta-cli", ssl, socket, &compress_method))
    {
       goto error;
    }
 
+   stream = (compress_method & MANAGEMENT_STREAM) == MANAGEMENT_STREAM;
+   compress_method &= ~MANAGEMENT_STREAM;
+
    if (compression != NULL)
    {
       *compression = compress_method;
@@ -1202,6 +1245,33 @@ pgmoneta_management_read_json(SSL* ssl, int socket, uint8_t* compression, uint8_
       *encryption = encrypt_method;
    }
 
+   if (stream)
+   {
+      while (true)
+      {
+         if (read_frame(ssl, socket, compress_method, encrypt_method, &frame))
+         {
+            goto error;
+         }
+
+         if (frame == NULL)
+         {
+            break;
+         }
+
+         if (cb(frame, first, data))
+         {
+            frame = NULL;
+            goto error;
+         }
+
+         frame = NULL;
+         first = false;
+      }
+
+      return 0;
+   }
+
    if (read_string("pgmoneta-cli", ssl, socket, &s))
    {
       goto error;
@@ -1210,347 +1280,758 @@ pgmoneta_management_read_json(SSL* ssl, int socket, uint8_t* compression, uint8_
    if (compress_method || encrypt_method)
    {
       // First, perform decode
-      if (pgmoneta_base64_decode(s, strlen(s), (void**)&decoded_buffer, &decoded_size) != 0)
+      if (s == NULL || pgmoneta_base64_decode(s, strlen(s), (void**)&decoded_buffer, &decoded_size) != 0)
       {
          pgmoneta_log_error("pgmoneta_management_read_json: Decoding failed");
          goto error;
       }
       free(s);
       s = NULL;
-      transfer_buffer = decoded_buffer;
-      transfer_size = decoded_size;
+
+      // Then, decrypt and decompress
+      if (decode_frame(compress_method, encrypt_method, decoded_buffer, decoded_size, &s))
+      {
+         decoded_buffer = NULL;
+         goto error;
+      }
       decoded_buffer = NULL;
+   }
+
+   if (pgmoneta_json_parse_string(s, &frame))
+   {
+      goto error;
+   }
+
+   free(s);
+   s = NULL;
+
+   if (cb(frame, true, data))
+   {
+      goto error;
+   }
+
+   return 0;
+
+error:
 
-      // Second, perform decrypt
-      int mode = 0;
-      switch (encrypt_method)
+   pgmoneta_json_destroy(frame);
+   free(s);
+   free(decoded_buffer);
+
+   return 1;
+}
+
+int
+pgmoneta_management_write_json(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json* json)
+{
+   char* s = NULL;
+   unsigned char* transfer_buffer = NULL;
+   char* encoded = NULL;
+   size_t transfer_size = 0;
+   size_t encoded_size = 0;
+
+   s = pgmoneta_json_to_string(json, FORMAT_JSON_COMPACT, NULL, 0);
+
+   if (write_uint8("pgmoneta-cli", ssl, socket, compression))
+   {
+      goto error;
+   }
+
+   if (write_uint8("pgmoneta-cli", ssl, socket, encryption))
+   {
+      goto error;
+   }
+
+   if (compression || encryption)
+   {
+      // First, compress and encrypt
+      if (encode_frame(compression, encryption, s, &transfer_buffer, &transfer_size))
       {
-         case MANAGEMENT_ENCRYPTION_AES256_GCM:
-            mode = ENCRYPTION_AES_256_GCM;
-            break;
-         case MANAGEMENT_ENCRYPTION_AES192_GCM:
-            mode = ENCRYPTION_AES_192_GCM;
-            break;
-         case MANAGEMENT_ENCRYPTION_AES128_GCM:
-            mode = ENCRYPTION_AES_128_GCM;
-            break;
-         default:
-            if (encrypt_method != MANAGEMENT_ENCRYPTION_NONE)
-            {
-               pgmoneta_log_error("pgmoneta_management_read_json: Unsupported management encryption code %d", encrypt_method);
-               goto error;
-            }
-            break;
+         s = NULL;
+         goto error;
       }
+      s = NULL;
 
-      if (mode != 0)
+      // Then, perform base64 encode
+      if (pgmoneta_base64_encode(transfer_buffer, transfer_size, &encoded, &encoded_size) != 0)
       {
-         if (pgmoneta_decrypt_buffer(transfer_buffer, transfer_size, &decrypted_buffer, &decrypted_size, mode))
+         pgmoneta_log_error("pgmoneta_management_write_json: Encoding failed");
+         goto error;
+      }
+
+      free(transfer_buffer);
+      transfer_buffer = NULL;
+      s = encoded;
+      encoded = NULL;
+   }
+
+   if (write_string("pgmoneta-cli", ssl, socket, s))
+   {
+      goto error;
+   }
+
+   free(s);
+
+   return 0;
+
+error:
+
+   free(s);
+   free(transfer_buffer);
+   free(encoded);
+
+   return 1;
+}
+
+int
+pgmoneta_management_write_json_stream(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json* json)
+{
+   char* s = NULL;
+   char* str = NULL;
+   char* tag = NULL;
+   size_t size = 0;
+   struct json* response = NULL;
+   struct json* array = NULL;
+   struct json_iterator* iter = NULL;
+   struct json_iterator* aiter = NULL;
+
+   response = (struct json*)pgmoneta_json_get(json, MANAGEMENT_CATEGORY_RESPONSE);
+
+   if (write_uint8("pgmoneta-cli", ssl, socket, compression | MANAGEMENT_STREAM))
+   {
+      goto error;
+   }
+
+   if (write_uint8("pgmoneta-cli", ssl, socket, encryption))
+   {
+      goto error;
+   }
+
+   // The first frame is the document without the arrays of the response
+   s = pgmoneta_append_char(s, '{');
+   if (pgmoneta_json_iterator_create(json, &iter) == 0)
+   {
+      while (pgmoneta_json_iterator_next(iter))
+      {
+         tag = frame_tag(iter->key);
+         s = pgmoneta_append(s, tag);
+         if (pgmoneta_compare_string(iter->key, MANAGEMENT_CATEGORY_RESPONSE))
          {
-            pgmoneta_log_error("pgmoneta_management_read_json: Decryption failed");
-            goto error;
+            str = frame_envelope(response);
          }
-         free(transfer_buffer);
-         transfer_buffer = decrypted_buffer;
-         transfer_size = decrypted_size;
-         decrypted_buffer = NULL;
+         else
+         {
+            str = pgmoneta_value_to_string(iter->value, FORMAT_JSON_COMPACT, NULL, 0);
+         }
+         s = pgmoneta_append(s, str);
+         s = pgmoneta_append(s, pgmoneta_json_iterator_has_next(iter) ? "," : "");
+         free(str);
+         str = NULL;
+         free(tag);
+         tag = NULL;
       }
+      pgmoneta_json_iterator_destroy(iter);
+      iter = NULL;
+   }
+   s = pgmoneta_append_char(s, '}');
 
-      // Third, perform decompress
-      switch (compress_method)
+   if (write_frame(ssl, socket, compression, encryption, s))
+   {
+      s = NULL;
+      goto error;
+   }
+   s = NULL;
+
+   // Then the arrays of the response, in frames of about MANAGEMENT_STREAM_FRAME_SIZE bytes
+   if (pgmoneta_json_iterator_create(response, &iter) == 0)
+   {
+      while (pgmoneta_json_iterator_next(iter))
       {
-         case MANAGEMENT_COMPRESSION_GZIP:
-            if (pgmoneta_gunzip_string(transfer_buffer, transfer_size, &decompressed))
+         if (!is_stream_array(iter->value))
+         {
+            continue;
+         }
+
+         array = (struct json*)pgmoneta_value_data(iter->value);
+         tag = frame_tag(iter->key);
+
+         if (pgmoneta_json_iterator_create(array, &aiter))
+         {
+            goto error;
+         }
+
+         while (pgmoneta_json_iterator_next(aiter))
+         {
+            if (s == NULL)
             {
-               pgmoneta_log_error("pgmoneta_management_read_json: GZIP decompress failed");
-               goto error;
+               s = pgmoneta_append_char(s, '{');
+               s = pgmoneta_append(s, tag);
+               s = pgmoneta_append_char(s, '[');
+               size = strlen(s);
             }
-            free(transfer_buffer);
-            transfer_buffer = NULL;
-            s = decompressed;
-            decompressed = NULL;
-            break;
-         case MANAGEMENT_COMPRESSION_ZSTD:
-            if (pgmoneta_zstdd_string(transfer_buffer, transfer_size, &decompressed))
+            else
             {
-               pgmoneta_log_error("pgmoneta_management_read_json: ZSTD decompress failed");
-               goto error;
+               s = pgmoneta_append_char(s, ',');
+               size++;
             }
-            free(transfer_buffer);
-            transfer_buffer = NULL;
-            s = decompressed;
-            decompressed = NULL;
-            break;
-         case MANAGEMENT_COMPRESSION_LZ4:
-            if (pgmoneta_lz4d_string(transfer_buffer, transfer_size, &decompressed))
+
+            str = pgmoneta_value_to_string(aiter->value, FORMAT_JSON_COMPACT, NULL, 0);
+            s = pgmoneta_append(s, str);
+            size += strlen(str);
+            free(str);
+            str = NULL;
+
+            if (size >= MANAGEMENT_STREAM_FRAME_SIZE || !pgmoneta_json_iterator_has_next(aiter))
             {
-               if (transfer_size <= INT_MAX)
-               {
-                  size_t legacy_size = transfer_size * 4;
-                  if (legacy_size == 0 || legacy_size > SIZE_MAX - 1)
-                  {
-                     pgmoneta_log_error("pgmoneta_management_read_json: LZ4 legacy size overflow");
-                     goto error;
-                  }
-                  decompressed = (char*)malloc(legacy_size + 1);
-                  if (decompressed == NULL)
-                  {
-                     pgmoneta_log_error("pgmoneta_management_read_json: LZ4 legacy allocation failed");
-                     goto error;
-                  }
-                  int legacy_decompressed = LZ4_decompress_safe((char*)transfer_buffer, decompressed, (int)transfer_size, (int)legacy_size);
-                  if (legacy_decompressed < 0)
-                  {
-                     pgmoneta_log_error("pgmoneta_management_read_json: LZ4 legacy decompress failed");
-                     free(decompressed);
-                     decompressed = NULL;
-                     goto error;
-                  }
-                  decompressed[legacy_decompressed] = '\0';
-               }
-               else
+               s = pgmoneta_append(s, "]}");
+
+               if (write_frame(ssl, socket, compression, encryption, s))
                {
-                  pgmoneta_log_error("pgmoneta_management_read_json: LZ4 decompress failed");
+                  s = NULL;
                   goto error;
                }
+               s = NULL;
             }
-            free(transfer_buffer);
-            transfer_buffer = NULL;
-            s = decompressed;
-            decompressed = NULL;
-            break;
-         case MANAGEMENT_COMPRESSION_BZIP2:
-            if (pgmoneta_bunzip2_string(transfer_buffer, transfer_size, &decompressed))
-            {
-               pgmoneta_log_error("pgmoneta_management_read_json: bzip2 decompress failed");
-               goto error;
-            }
-            free(transfer_buffer);
-            transfer_buffer = NULL;
-            s = decompressed;
-            decompressed = NULL;
-            break;
-         default:
-            s = (char*)transfer_buffer;
-            transfer_buffer = NULL;
-            break;
+         }
+
+         pgmoneta_json_iterator_destroy(aiter);
+         aiter = NULL;
+         free(tag);
+         tag = NULL;
       }
+      pgmoneta_json_iterator_destroy(iter);
+      iter = NULL;
    }
 
-   if (pgmoneta_json_parse_string(s, &r))
+   // An empty frame ends the stream
+   if (write_string("pgmoneta-cli", ssl, socket, NULL))
    {
       goto error;
    }
 
-   *json = r;
-
-   free(s);
-
    return 0;
 
 error:
 
-   pgmoneta_json_destroy(r);
+   pgmoneta_json_iterator_destroy(aiter);
+   pgmoneta_json_iterator_destroy(iter);
+   free(s);
+   free(str);
+   free(tag);
+
+   return 1;
+}
 
-   if (s != NULL)
+static bool
+is_stream_requested(struct json* json)
+{
+   struct json* header = NULL;
+   struct json* response = NULL;
+   struct json_iterator* iter = NULL;
+   bool found = false;
+
+   header = (struct json*)pgmoneta_json_get(json, MANAGEMENT_CATEGORY_HEADER);
+   if (!(bool)pgmoneta_json_get(header, MANAGEMENT_ARGUMENT_STREAM))
    {
-      free(s);
+      return false;
    }
-   if (transfer_buffer != NULL)
-   {
-      free(transfer_buffer);
-      transfer_buffer = NULL;
-   }
-   if (decoded_buffer != NULL)
+
+   response = (struct json*)pgmoneta_json_get(json, MANAGEMENT_CATEGORY_RESPONSE);
+   if (pgmoneta_json_iterator_create(response, &iter))
    {
-      free(decoded_buffer);
+      return false;
    }
-   if (decrypted_buffer != NULL)
+
+   while (!found && pgmoneta_json_iterator_next(iter))
    {
-      free(decrypted_buffer);
+      found = is_stream_array(iter->value);
    }
-   if (decompressed != NULL)
+
+   pgmoneta_json_iterator_destroy(iter);
+
+   return found;
+}
+
+static bool
+is_stream_array(struct value* value)
+{
+   struct json* array = NULL;
+
+   if (value == NULL || value->type != ValueJSON)
    {
-      free(decompressed);
+      return false;
    }
 
-   return 1;
+   array = (struct json*)pgmoneta_value_data(value);
+
+   return array != NULL && array->type == JSONArray && pgmoneta_json_array_length(array) > 0;
 }
 
-int
-pgmoneta_management_write_json(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json* json)
+static char*
+frame_tag(char* key)
 {
-   char* s = NULL;
+   char* tag = NULL;
+   char* escaped = NULL;
 
-   unsigned char* transfer_buffer = NULL;
-   unsigned char* compressed_buffer = NULL;
-   unsigned char* encrypted_buffer = NULL;
-   char* encoded = NULL;
-   size_t transfer_size = 0;
-   size_t compressed_size = 0;
-   size_t encrypted_size = 0;
-   size_t encoded_size = 0;
+   escaped = pgmoneta_escape_string(key);
 
-   s = pgmoneta_json_to_string(json, FORMAT_JSON_COMPACT, NULL, 0);
+   tag = pgmoneta_append_char(tag, '"');
+   tag = pgmoneta_append(tag, escaped);
+   tag = pgmoneta_append(tag, "\":");
 
-   if (write_uint8("pgmoneta-cli", ssl, socket, compression))
+   free(escaped);
+
+   return tag;
+}
+
+static char*
+frame_envelope(struct json* response)
+{
+   char* s = NULL;
+   char* str = NULL;
+   char* tag = NULL;
+   bool next = false;
+   struct json_iterator* iter = NULL;
+
+   s = pgmoneta_append_char(s, '{');
+
+   if (pgmoneta_json_iterator_create(response, &iter) == 0)
    {
-      goto error;
+      while (pgmoneta_json_iterator_next(iter))
+      {
+         if (is_stream_array(iter->value))
+         {
+            continue;
+         }
+
+         tag = frame_tag(iter->key);
+         str = pgmoneta_value_to_string(iter->value, FORMAT_JSON_COMPACT, tag, 0);
+         s = pgmoneta_append(s, next ? "," : "");
+         s = pgmoneta_append(s, str);
+         next = true;
+         free(str);
+         free(tag);
+      }
+      pgmoneta_json_iterator_destroy(iter);
    }
 
-   if (write_uint8("pgmoneta-cli", ssl, socket, encryption))
+   s = pgmoneta_append_char(s, '}');
+
+   return s;
+}
+
+static int
+merge_frame(struct json* frame, bool first, void* data)
+{
+   struct json** json = (struct json**)data;
+   struct json* response = NULL;
+   struct json* items = NULL;
+   struct json* target = NULL;
+   struct json_iterator* iter = NULL;
+   struct json_iterator* aiter = NULL;
+
+   if (first)
    {
-      goto error;
+      *json = frame;
+      return 0;
    }
 
-   if (compression || encryption)
+   response = (struct json*)pgmoneta_json_get(*json, MANAGEMENT_CATEGORY_RESPONSE);
+   if (response == NULL)
    {
-      // First, perform compress
-      switch (compression)
+      if (pgmoneta_json_create(&response))
       {
-         case MANAGEMENT_COMPRESSION_GZIP:
-            if (pgmoneta_gzip_string(s, &compressed_buffer, &compressed_size))
-            {
-               pgmoneta_log_error("pgmoneta_management_write_json: Failed to gzip the string");
-               goto error;
-            }
-            transfer_buffer = compressed_buffer;
-            transfer_size = compressed_size;
-
-            free(s);
-            compressed_buffer = NULL;
-            s = NULL;
-            break;
-         case MANAGEMENT_COMPRESSION_ZSTD:
-            if (pgmoneta_zstdc_string(s, &compressed_buffer, &compressed_size))
-            {
-               pgmoneta_log_error("pgmoneta_management_write_json: Failed to zstd the string");
-               goto error;
-            }
-            transfer_buffer = compressed_buffer;
-            transfer_size = compressed_size;
+         goto error;
+      }
+      pgmoneta_json_put(*json, MANAGEMENT_CATEGORY_RESPONSE, (uintptr_t)response, ValueJSON);
+   }
 
-            free(s);
-            compressed_buffer = NULL;
-            s = NULL;
-            break;
-         case MANAGEMENT_COMPRESSION_LZ4:
-            if (pgmoneta_lz4c_string(s, &compressed_buffer, &compressed_size))
-            {
-               pgmoneta_log_error("pgmoneta_management_write_json: Failed to lz4 the string");
-               goto error;
-            }
-            transfer_buffer = compressed_buffer;
-            transfer_size = compressed_size;
+   if (pgmoneta_json_iterator_create(frame, &iter))
+   {
+      goto error;
+   }
 
-            free(s);
-            compressed_buffer = NULL;
-            s = NULL;
-            break;
-         case MANAGEMENT_COMPRESSION_BZIP2:
-            if (pgmoneta_bzip2_string(s, &compressed_buffer, &compressed_size))
-            {
-               pgmoneta_log_error("pgmoneta_management_write_json: Failed to bzip2 the string");
-               goto error;
-            }
-            transfer_buffer = compressed_buffer;
-            transfer_size = compressed_size;
+   while (pgmoneta_json_iterator_next(iter))
+   {
+      items = (struct json*)pgmoneta_value_data(iter->value);
 
-            free(s);
-            compressed_buffer = NULL;
-            s = NULL;
-            break;
-         default:
-            transfer_buffer = (unsigned char*)s;
-            transfer_size = strlen(s);
-            s = NULL;
-            break;
+      target = (struct json*)pgmoneta_json_get(response, iter->key);
+      if (target == NULL)
+      {
+         if (pgmoneta_json_create(&target))
+         {
+            goto error;
+         }
+         pgmoneta_json_put(response, iter->key, (uintptr_t)target, ValueJSON);
       }
 
-      // Second, perform encrypt
-      int mode = 0;
-      switch (encryption)
+      if (pgmoneta_json_iterator_create(items, &aiter))
       {
-         case MANAGEMENT_ENCRYPTION_AES256_GCM:
-            mode = ENCRYPTION_AES_256_GCM;
-            break;
-         case MANAGEMENT_ENCRYPTION_AES192_GCM:
-            mode = ENCRYPTION_AES_192_GCM;
-            break;
-         case MANAGEMENT_ENCRYPTION_AES128_GCM:
-            mode = ENCRYPTION_AES_128_GCM;
-            break;
-         default:
-            if (encryption != MANAGEMENT_ENCRYPTION_NONE)
-            {
-               pgmoneta_log_error("pgmoneta_management_write_json: Unsupported management encryption code %d", encryption);
-               goto error;
-            }
-            break;
+         continue;
       }
 
-      if (mode != 0)
+      while (pgmoneta_json_iterator_next(aiter))
       {
-         if (pgmoneta_encrypt_buffer(transfer_buffer, transfer_size, &encrypted_buffer, &encrypted_size, mode))
+         if (pgmoneta_json_append(target, pgmoneta_value_data(aiter->value), aiter->value->type))
          {
-            pgmoneta_log_error("pgmoneta_management_write_json: Encryption failed");
             goto error;
          }
-         free(transfer_buffer);
-         transfer_buffer = encrypted_buffer;
-         transfer_size = encrypted_size;
-         encrypted_buffer = NULL;
-      }
 
-      // Third, perform base64 encode
-      if (pgmoneta_base64_encode(transfer_buffer, transfer_size, &encoded, &encoded_size) != 0)
-      {
-         pgmoneta_log_error("pgmoneta_management_write_json: Encoding failed");
-         goto error;
+         // The item now belongs to the response
+         if (aiter->value->type == ValueJSON)
+         {
+            aiter->value->data = 0;
+         }
       }
 
-      free(transfer_buffer);
-      transfer_buffer = NULL;
-      s = encoded;
-      encoded = NULL;
+      pgmoneta_json_iterator_destroy(aiter);
+      aiter = NULL;
    }
 
-   if (write_string("pgmoneta-cli", ssl, socket, s))
+   pgmoneta_json_iterator_destroy(iter);
+   pgmoneta_json_destroy(frame);
+
+   return 0;
+
+error:
+
+   pgmoneta_json_iterator_destroy(aiter);
+   pgmoneta_json_iterator_destroy(iter);
+   pgmoneta_json_destroy(frame);
+
+   return 1;
+}
+
+static int
+write_frame(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, char* s)
+{
+   char buf4[4] = {0};
+   unsigned char* buffer = NULL;
+   size_t size = 0;
+
+   if (encode_frame(compression, encryption, s, &buffer, &size))
    {
       goto error;
    }
 
-   free(s);
+   pgmoneta_write_uint32(&buf4, (uint32_t)size);
+   if (write_complete(ssl, socket, &buf4, sizeof(buf4)))
+   {
+      pgmoneta_log_warn("pgmoneta-cli: write_frame: %p %d %s", ssl, socket, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   if (write_complete(ssl, socket, buffer, size))
+   {
+      pgmoneta_log_warn("pgmoneta-cli: write_frame: %p %d %s", ssl, socket, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   free(buffer);
 
    return 0;
 
 error:
 
-   if (s != NULL)
+   free(buffer);
+
+   return 1;
+}
+
+static int
+read_frame(SSL* ssl, int socket, uint8_t compression, uint8_t encryption, struct json** frame)
+{
+   char buf4[4] = {0};
+   uint32_t size = 0;
+   unsigned char* buffer = NULL;
+   char* s = NULL;
+
+   *frame = NULL;
+
+   if (read_complete(ssl, socket, &buf4[0], sizeof(buf4)))
    {
-      free(s);
+      pgmoneta_log_warn("pgmoneta-cli: read_frame: %p %d %s", ssl, socket, strerror(errno));
+      errno = 0;
+      goto error;
    }
-   if (transfer_buffer != NULL)
+
+   size = pgmoneta_read_uint32(&buf4);
+   if (size == 0)
    {
-      free(transfer_buffer);
-      transfer_buffer = NULL;
+      return 0;
+   }
+
+   buffer = calloc(1, (size_t)size + 1);
+   if (buffer == NULL)
+   {
+      goto error;
+   }
+
+   if (read_complete(ssl, socket, buffer, size))
+   {
+      pgmoneta_log_warn("pgmoneta-cli: read_frame: %p %d %s", ssl, socket, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   if (decode_frame(compression, encryption, buffer, size, &s))
+   {
+      buffer = NULL;
+      goto error;
    }
+   buffer = NULL;
+
+   if (pgmoneta_json_parse_string(s, frame))
+   {
+      goto error;
+   }
+
+   free(s);
+
+   return 0;
+
+error:
+
+   free(buffer);
+   free(s);
+
+   return 1;
+}
+
+static int
+encode_frame(uint8_t compression, uint8_t encryption, char* s, unsigned char** data, size_t* size)
+{
+   unsigned char* transfer_buffer = NULL;
+   unsigned char* compressed_buffer = NULL;
+   unsigned char* encrypted_buffer = NULL;
+   size_t transfer_size = 0;
+   size_t compressed_size = 0;
+   size_t encrypted_size = 0;
+   int mode = 0;
+
+   *data = NULL;
+   *size = 0;
+
+   // First, perform compress
+   switch (compression)
+   {
+      case MANAGEMENT_COMPRESSION_GZIP:
+         if (pgmoneta_gzip_string(s, &compressed_buffer, &compressed_size))
+         {
+            pgmoneta_log_error("pgmoneta_management_write_json: Failed to gzip the string");
+            goto error;
+         }
+         break;
+      case MANAGEMENT_COMPRESSION_ZSTD:
+         if (pgmoneta_zstdc_string(s, &compressed_buffer, &compressed_size))
+         {
+            pgmoneta_log_error("pgmoneta_management_write_json: Failed to zstd the string");
+            goto error;
+         }
+         break;
+      case MANAGEMENT_COMPRESSION_LZ4:
+         if (pgmoneta_lz4c_string(s, &compressed_buffer, &compressed_size))
+         {
+            pgmoneta_log_error("pgmoneta_management_write_json: Failed to lz4 the string");
+            goto error;
+         }
+         break;
+      case MANAGEMENT_COMPRESSION_BZIP2:
+         if (pgmoneta_bzip2_string(s, &compressed_buffer, &compressed_size))
+         {
+            pgmoneta_log_error("pgmoneta_management_write_json: Failed to bzip2 the string");
+            goto error;
+         }
+         break;
+      default:
+         break;
+   }
+
    if (compressed_buffer != NULL)
    {
-      free(compressed_buffer);
+      transfer_buffer = compressed_buffer;
+      transfer_size = compressed_size;
+      compressed_buffer = NULL;
+      free(s);
    }
-   if (encrypted_buffer != NULL)
+   else
    {
-      free(encrypted_buffer);
+      transfer_buffer = (unsigned char*)s;
+      transfer_size = strlen(s);
+   }
+   s = NULL;
+
+   // Second, perform encrypt
+   switch (encryption)
+   {
+      case MANAGEMENT_ENCRYPTION_AES256_GCM:
+         mode = ENCRYPTION_AES_256_GCM;
+         break;
+      case MANAGEMENT_ENCRYPTION_AES192_GCM:
+         mode = ENCRYPTION_AES_192_GCM;
+         break;
+      case MANAGEMENT_ENCRYPTION_AES128_GCM:
+         mode = ENCRYPTION_AES_128_GCM;
+         break;
+      default:
+         if (encryption != MANAGEMENT_ENCRYPTION_NONE)
+         {
+            pgmoneta_log_error("pgmoneta_management_write_json: Unsupported management encryption code %d", encryption);
+            goto error;
+         }
+         break;
    }
-   if (encoded != NULL)
+
+   if (mode != 0)
    {
-      free(encoded);
+      if (pgmoneta_encrypt_buffer(transfer_buffer, transfer_size, &encrypted_buffer, &encrypted_size, mode))
+      {
+         pgmoneta_log_error("pgmoneta_management_write_json: Encryption failed");
+         goto error;
+      }
+      free(transfer_buffer);
+      transfer_buffer = encrypted_buffer;
+      transfer_size = encrypted_size;
+      encrypted_buffer = NULL;
    }
 
+   *data = transfer_buffer;
+   *size = transfer_size;
+
+   return 0;
+
+error:
+
+   free(s);
+   free(transfer_buffer);
+   free(compressed_buffer);
+   free(encrypted_buffer);
+
    return 1;
 }
 
+static int
+decode_frame(uint8_t compression, uint8_t encryption, unsigned char* data, size_t size, char** s)
+{
+   unsigned char* transfer_buffer = data;
+   unsigned char* decrypted_buffer = NULL;
+   char* decompressed = NULL;
+   size_t transfer_size = size;
+   size_t decrypted_size = 0;
+   int mode = 0;
+
+   *s = NULL;
+
+   // First, perform decrypt
+   switch (encryption)
+   {
+      case MANAGEMENT_ENCRYPTION_AES256_GCM:
+         mode = ENCRYPTION_AES_256_GCM;
+         break;
+      case MANAGEMENT_ENCRYPTION_AES192_GCM:
+         mode = ENCRYPTION_AES_192_GCM;
+         break;
+      case MANAGEMENT_ENCRYPTION_AES128_GCM:
+         mode = ENCRYPTION_AES_128_GCM;
+         break;
+      default:
+         if (encryption != MANAGEMENT_ENCRYPTION_NONE)
+         {
+            pgmoneta_log_error("pgmoneta_management_read_json: Unsupported management encryption code %d", encryption);
+            goto error;
+         }
+         break;
+   }
+
+   if (mode != 0)
+   {
+      if (pgmoneta_decrypt_buffer(transfer_buffer, transfer_size, &decrypted_buffer, &decrypted_size, mode))
+      {
+         pgmoneta_log_error("pgmoneta_management_read_json: Decryption failed");
+         goto error;
+      }
+      free(transfer_buffer);
+      transfer_buffer = decrypted_buffer;
+      transfer_size = decrypted_size;
+      decrypted_buffer = NULL;
+   }
+
+   // Second, perform decompress
+   switch (compression)
+   {
+      case MANAGEMENT_COMPRESSION_GZIP:
+         if (pgmoneta_gunzip_string(transfer_buffer, transfer_size, &decompressed))
+         {
+            pgmoneta_log_error("pgmoneta_management_read_json: GZIP decompress failed");
+            goto error;
+         }
+         break;
+      case MANAGEMENT_COMPRESSION_ZSTD:
+         if (pgmoneta_zstdd_string(transfer_buffer, transfer_size, &decompressed))
+         {
+            pgmoneta_log_error("pgmoneta_management_read_json: ZSTD decompress failed");
+            goto error;
+         }
+         break;
+      case MANAGEMENT_COMPRESSION_LZ4:
+         if (pgmoneta_lz4d_string(transfer_buffer, transfer_size, &decompressed))
+         {
+            if (transfer_size <= INT_MAX)
+            {
+               size_t legacy_size = transfer_size * 4;
+               if (legacy_size == 0 || legacy_size > SIZE_MAX - 1)
+               {
+                  pgmoneta_log_error("pgmoneta_management_read_json: LZ4 legacy size overflow");
+                  goto error;
+               }
+               decompressed = (char*)malloc(legacy_size + 1);
+               if (decompressed == NULL)
+               {
+                  pgmoneta_log_error("pgmoneta_management_read_json: LZ4 legacy allocation failed");
+                  goto error;
+               }
+               int legacy_decompressed = LZ4_decompress_safe((char*)transfer_buffer, decompressed, (int)transfer_size, (int)legacy_size);
+               if (legacy_decompressed < 0)
+               {
+                  pgmoneta_log_error("pgmoneta_management_read_json: LZ4 legacy decompress failed");
+                  goto error;
+               }
+               decompressed[legacy_decompressed] = '\0';
+            }
+            else
+            {
+               pgmoneta_log_error("pgmoneta_management_read_json: LZ4 decompress failed");
+               goto error;
+            }
+         }
+         break;
+      case MANAGEMENT_COMPRESSION_BZIP2:
+         if (pgmoneta_bunzip2_string(transfer_buffer, transfer_size, &decompressed))
+         {
+            pgmoneta_log_error("pgmoneta_management_read_json: bzip2 decompress failed");
+            goto error;
+         }
+         break;
+      default:
+         *s = (char*)transfer_buffer;
+         return 0;
+   }
+
+   free(transfer_buffer);
+   *s = decompressed;
+
+   return 0;
+
+error:
+
+   free(transfer_buffer);
+   free(decrypted_buffer);
+   free(decompressed);
+
+   return 1;
+}
 static int
 read_uint8(char* prefix, SSL* ssl, int socket, uint8_t* i)
 {
@@ -1921,6 +2402,7 @@ pgmoneta_management_create_header(int32_t command, uint8_t compression, uint8_t
    pgmoneta_json_put(header, MANAGEMENT_ARGUMENT_TIMESTAMP, (uintptr_t)timestamp, ValueString);
    pgmoneta_json_put(header, MANAGEMENT_ARGUMENT_COMPRESSION, (uintptr_t)compression, ValueUInt8);
    pgmoneta_json_put(header, MANAGEMENT_ARGUMENT_ENCRYPTION, (uintptr_t)encryption, ValueUInt8);
+   pgmoneta_json_put(header, MANAGEMENT_ARGUMENT_STREAM, (uintptr_t)true, ValueBool);
 
    pgmoneta_json_put(j, MANAGEMENT_CATEGORY_HEADER, (uintptr_t)header, ValueJSON);
 
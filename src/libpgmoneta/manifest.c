@@ -57,6 +57,46 @@
 #define MANIFEST_FILE_KEY_LAST_MODIFIED      "Last-Modified"
 #define MANIFEST_FILE_KEY_CHECKSUM           "Checksum"
 
+/** @struct manifest_diff_arts
+ * Collects the differences of two manifests
+ */
+struct manifest_diff_arts
+{
+   struct art* deleted; /**< The deleted files */
+   struct art* changed; /**< The changed files */
+   struct art* added;   /**< The added files */
+};
+
+static int
+compare_manifests_chunked(char* old_manifest, char* new_manifest, struct art** deleted_files, struct art** changed_files, struct art** added_files);
+
+static int
+collect_diff(enum manifest_diff kind, char* path, char* checksum, void* data);
+
+static int
+next_sorted_entry(struct csv_reader* reader, struct manifest_file* file);
+
+static int
+compare_file_path(struct value* v1, struct value* v2);
+
+static int
+write_sorted_run(struct deque* rows, char* path);
+
+static int
+merge_sorted_runs(char* path, int runs);
+
+static void
+write_manifest_header(FILE* file, int version, bool has_system_identifier, uint64_t system_identifier);
+
+static void
+write_manifest_file(FILE* file, struct json* f, bool first);
+
+static void
+write_manifest_wal_range(FILE* file, struct json* r, bool first);
+
+static int
+write_manifest_checksum(FILE* file, char* path);
+
 static void
 build_deque(struct deque* deque, struct csv_reader* reader, char** f);
 
@@ -73,9 +113,7 @@ int
 pgmoneta_manifest_checksum_verify(char* root, struct art* file_checksums, struct art* file_sizes)
 {
    char manifest_path[MAX_PATH];
-   char* key_path[1] = {"Files"};
-   struct json_reader* reader = NULL;
-   struct json* file = NULL;
+   struct manifest_iterator* iter = NULL;
 
    if (file_sizes == NULL || file_checksums == NULL)
    {
@@ -91,52 +129,185 @@ pgmoneta_manifest_checksum_verify(char* root, struct art* file_checksums, struct
    {
       pgmoneta_snprintf(manifest_path, MAX_PATH, "%s/%s", root, "backup_manifest");
    }
-   if (pgmoneta_json_reader_init(manifest_path, &reader))
-   {
-      goto error;
-   }
-   if (pgmoneta_json_locate(reader, key_path, 1))
+   if (pgmoneta_manifest_iterator_create(manifest_path, &iter))
    {
-      pgmoneta_log_error("cannot locate files array in manifest %s", manifest_path);
       goto error;
    }
-   while (pgmoneta_json_next_array_item(reader, &file))
+   while (pgmoneta_manifest_iterator_next(iter))
    {
-      char* file_path = NULL;
       size_t file_size = 0;
-      size_t file_size_manifest = 0;
       char* hash = NULL;
-      char* checksum = NULL;
-
-      file_path = (char*)pgmoneta_json_get(file, "Path");
 
-      file_size = (size_t)pgmoneta_art_search(file_sizes, file_path);
-      file_size_manifest = (int64_t)pgmoneta_json_get(file, "Size");
-      if (file_size != file_size_manifest)
+      file_size = (size_t)pgmoneta_art_search(file_sizes, iter->path);
+      if (file_size != iter->size)
       {
-         pgmoneta_log_error("File size mismatch, path: %s. getting %lu, should be %lu", file_path, file_size, file_size_manifest);
+         pgmoneta_log_error("File size mismatch, path: %s. getting %lu, should be %lu", iter->path, file_size, iter->size);
       }
-      hash = (char*)pgmoneta_art_search(file_checksums, file_path);
-      checksum = (char*)pgmoneta_json_get(file, "Checksum");
-      if (!pgmoneta_compare_string(hash, checksum))
+      hash = (char*)pgmoneta_art_search(file_checksums, iter->path);
+      if (!pgmoneta_compare_string(hash, iter->checksum))
       {
-         pgmoneta_log_error("File checksum mismatch, path: %s. getting %s, should be %s", file_path, hash, checksum);
+         pgmoneta_log_error("File checksum mismatch, path: %s. getting %s, should be %s", iter->path, hash, iter->checksum);
       }
-      pgmoneta_json_destroy(file);
-      file = NULL;
    }
-   pgmoneta_json_reader_close(reader);
-   pgmoneta_json_destroy(file);
+   pgmoneta_manifest_iterator_destroy(iter);
    return 0;
 
 error:
-   pgmoneta_json_reader_close(reader);
-   pgmoneta_json_destroy(file);
+   pgmoneta_manifest_iterator_destroy(iter);
    return 1;
 }
 
 int
 pgmoneta_compare_manifests(char* old_manifest, char* new_manifest, struct art** deleted_files, struct art** changed_files, struct art** added_files)
+{
+   int ret;
+   struct manifest_diff_arts diff;
+
+   *deleted_files = NULL;
+   *changed_files = NULL;
+   *added_files = NULL;
+
+   memset(&diff, 0, sizeof(struct manifest_diff_arts));
+
+   pgmoneta_art_create(&diff.deleted);
+   pgmoneta_art_create(&diff.changed);
+   pgmoneta_art_create(&diff.added);
+
+   ret = pgmoneta_manifest_merge_diff(old_manifest, new_manifest, collect_diff, &diff);
+   if (ret == MANIFEST_DIFF_UNSORTED)
+   {
+      // manifests written before the sorted-output guarantee
+      pgmoneta_log_debug("Manifests %s and %s are not sorted, comparing in chunks", old_manifest, new_manifest);
+      pgmoneta_art_destroy(diff.deleted);
+      pgmoneta_art_destroy(diff.changed);
+      pgmoneta_art_destroy(diff.added);
+      return compare_manifests_chunked(old_manifest, new_manifest, deleted_files, changed_files, added_files);
+   }
+   else if (ret)
+   {
+      goto error;
+   }
+
+   if (diff.deleted->size > 0 || diff.changed->size > 0 || diff.added->size > 0)
+   {
+      pgmoneta_art_insert(diff.changed, "backup_manifest", (uintptr_t)"backup manifest", ValueString);
+   }
+
+   *deleted_files = diff.deleted;
+   *changed_files = diff.changed;
+   *added_files = diff.added;
+
+   return 0;
+
+error:
+   pgmoneta_art_destroy(diff.deleted);
+   pgmoneta_art_destroy(diff.changed);
+   pgmoneta_art_destroy(diff.added);
+   return 1;
+}
+
+int
+pgmoneta_manifest_merge_diff(char* old_manifest, char* new_manifest, manifest_diff_cb cb, void* data)
+{
+   int ret = 1;
+   int cmp = 0;
+   struct csv_reader* r1 = NULL;
+   struct csv_reader* r2 = NULL;
+   struct manifest_file f1;
+   struct manifest_file f2;
+
+   memset(&f1, 0, sizeof(struct manifest_file));
+   memset(&f2, 0, sizeof(struct manifest_file));
+
+   if (cb == NULL)
+   {
+      goto done;
+   }
+
+   if (pgmoneta_csv_reader_init(old_manifest, &r1))
+   {
+      goto done;
+   }
+
+   if (pgmoneta_csv_reader_init(new_manifest, &r2))
+   {
+      goto done;
+   }
+
+   if ((ret = next_sorted_entry(r1, &f1)) || (ret = next_sorted_entry(r2, &f2)))
+   {
+      goto done;
+   }
+
+   while (f1.path != NULL || f2.path != NULL)
+   {
+      if (f1.path == NULL)
+      {
+         cmp = 1;
+      }
+      else if (f2.path == NULL)
+      {
+         cmp = -1;
+      }
+      else
+      {
+         cmp = strcmp(f1.path, f2.path);
+      }
+
+      if (cmp < 0)
+      {
+         if (cb(ManifestDeleted, f1.path, f1.checksum, data))
+         {
+            ret = 1;
+            goto done;
+         }
+         ret = next_sorted_entry(r1, &f1);
+      }
+      else if (cmp > 0)
+      {
+         if (cb(ManifestAdded, f2.path, f2.checksum, data))
+         {
+            ret = 1;
+            goto done;
+         }
+         ret = next_sorted_entry(r2, &f2);
+      }
+      else
+      {
+         if (!pgmoneta_compare_string(f1.checksum, f2.checksum))
+         {
+            if (cb(ManifestChanged, f1.path, f1.checksum, data))
+            {
+               ret = 1;
+               goto done;
+            }
+         }
+         if (!(ret = next_sorted_entry(r1, &f1)))
+         {
+            ret = next_sorted_entry(r2, &f2);
+         }
+      }
+
+      if (ret)
+      {
+         goto done;
+      }
+   }
+
+   ret = 0;
+
+done:
+   free(f1.path);
+   free(f1.checksum);
+   free(f2.path);
+   free(f2.checksum);
+   pgmoneta_csv_reader_destroy(r1);
+   pgmoneta_csv_reader_destroy(r2);
+   return ret;
+}
+
+static int
+compare_manifests_chunked(char* old_manifest, char* new_manifest, struct art** deleted_files, struct art** changed_files, struct art** added_files)
 {
    struct csv_reader* r1 = NULL;
    char** f1 = NULL;
@@ -321,13 +492,11 @@ int
 pgmoneta_write_postgresql_manifest(struct json* manifest, char* path)
 {
    FILE* file = NULL;
-   char* checksum = NULL;
    int version;
+   bool first = true;
    struct json* files = NULL;
-   struct json* f = NULL;
    struct json_iterator* fiter = NULL;
    struct json* wal_ranges = NULL;
-   struct json* r = NULL;
    struct json_iterator* riter = NULL;
 
    if (path == NULL || manifest == NULL)
@@ -354,6 +523,12 @@ pgmoneta_write_postgresql_manifest(struct json* manifest, char* path)
    files = (struct json*)pgmoneta_json_get(manifest, MANIFEST_KEY_FILES);
    wal_ranges = (struct json*)pgmoneta_json_get(manifest, MANIFEST_KEY_WAL_RANGES);
 
+   // the files are already in memory, so write them in a stable order
+   if (files->type == JSONArray)
+   {
+      pgmoneta_deque_sort((struct deque*)files->elements, compare_file_path);
+   }
+
    pgmoneta_json_iterator_create(files, &fiter);
    pgmoneta_json_iterator_create(wal_ranges, &riter);
 
@@ -363,77 +538,396 @@ pgmoneta_write_postgresql_manifest(struct json* manifest, char* path)
       goto error;
    }
 
-   fprintf(file, "{ \"%s\": %d,\n", MANIFEST_KEY_VERSION, version);
+   write_manifest_header(file, version, pgmoneta_json_contains_key(manifest, MANIFEST_KEY_SYS_IDENTIFIER),
+                         (uint64_t)pgmoneta_json_get(manifest, MANIFEST_KEY_SYS_IDENTIFIER));
+
+   while (pgmoneta_json_iterator_next(fiter))
+   {
+      write_manifest_file(file, (struct json*)pgmoneta_value_data(fiter->value), first);
+      first = false;
+   }
+   fprintf(file, "%s],\n", first ? "" : "\n");
 
-   if (pgmoneta_json_contains_key(manifest, MANIFEST_KEY_SYS_IDENTIFIER))
+   fprintf(file, "\"%s\": [\n", MANIFEST_KEY_WAL_RANGES);
+   first = true;
+   while (pgmoneta_json_iterator_next(riter))
    {
-      fprintf(file, "\"%s\": %" PRIu64 ",\n", MANIFEST_KEY_SYS_IDENTIFIER,
-              (uint64_t)pgmoneta_json_get(manifest, MANIFEST_KEY_SYS_IDENTIFIER));
+      write_manifest_wal_range(file, (struct json*)pgmoneta_value_data(riter->value), first);
+      first = false;
    }
+   fprintf(file, "%s],\n", first ? "" : "\n");
 
-   fprintf(file, "\"%s\": [\n", MANIFEST_KEY_FILES);
-   while (pgmoneta_json_iterator_next(fiter))
+   if (write_manifest_checksum(file, path))
    {
-      f = (struct json*)pgmoneta_value_data(fiter->value);
-      fprintf(file, "{ \"Path\": \"%s\", \"Size\": %" PRIu64 ", \"Last-Modified\": \"%s\", \"Checksum-Algorithm\": \"%s\", \"Checksum\": \"%s\" }",
-              (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_PATH),
-              (uint64_t)pgmoneta_json_get(f, MANIFEST_FILE_KEY_SIZE),
-              (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_LAST_MODIFIED),
-              (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_CHECKSUM_ALGORITHM),
-              (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_CHECKSUM));
-      if (pgmoneta_json_iterator_has_next(fiter))
-      {
-         fprintf(file, ",\n");
-      }
-      else
+      goto error;
+   }
+
+   fclose(file);
+   pgmoneta_json_iterator_destroy(fiter);
+   pgmoneta_json_iterator_destroy(riter);
+   return 0;
+
+error:
+   pgmoneta_json_iterator_destroy(fiter);
+   pgmoneta_json_iterator_destroy(riter);
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   return 1;
+}
+
+int
+pgmoneta_manifest_rewrite(char* source, struct json* files, manifest_filter_cb drop, char* path)
+{
+   FILE* file = NULL;
+   int version;
+   bool first = true;
+   char* key_path[1] = {MANIFEST_KEY_WAL_RANGES};
+   struct json_reader* reader = NULL;
+   struct json* header = NULL;
+   struct json* range = NULL;
+   struct json_iterator* fiter = NULL;
+   struct manifest_iterator* iter = NULL;
+
+   if (source == NULL || path == NULL)
+   {
+      goto error;
+   }
+
+   // the top-level scalars, the arrays are skipped
+   if (pgmoneta_json_reader_init(source, &reader) || pgmoneta_json_read_item(reader, &header))
+   {
+      pgmoneta_log_error("Unable to read manifest header of %s", source);
+      goto error;
+   }
+   pgmoneta_json_reader_close(reader);
+   reader = NULL;
+
+   if (!pgmoneta_json_contains_key(header, MANIFEST_KEY_VERSION))
+   {
+      pgmoneta_log_error("Manifest doesn't contain necessary version entry");
+      goto error;
+   }
+
+   version = (int)pgmoneta_json_get(header, MANIFEST_KEY_VERSION);
+
+   if (pgmoneta_manifest_iterator_create(source, &iter))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_fopen_secure(path, "wb", &file))
+   {
+      pgmoneta_log_error("Failed to create json file %s", path);
+      goto error;
+   }
+
+   write_manifest_header(file, version, pgmoneta_json_contains_key(header, MANIFEST_KEY_SYS_IDENTIFIER),
+                         (uint64_t)pgmoneta_json_get(header, MANIFEST_KEY_SYS_IDENTIFIER));
+
+   // the source order is kept, PostgreSQL doesn't sort its manifests
+   while (pgmoneta_manifest_iterator_next(iter))
+   {
+      if (drop != NULL && drop(iter->path))
       {
-         fprintf(file, "\n");
+         continue;
       }
+
+      write_manifest_file(file, iter->entry, first);
+      first = false;
+   }
+
+   pgmoneta_json_iterator_create(files, &fiter);
+   while (pgmoneta_json_iterator_next(fiter))
+   {
+      write_manifest_file(file, (struct json*)pgmoneta_value_data(fiter->value), first);
+      first = false;
    }
-   fprintf(file, "],\n");
+   fprintf(file, "%s],\n", first ? "" : "\n");
 
    fprintf(file, "\"%s\": [\n", MANIFEST_KEY_WAL_RANGES);
-   while (pgmoneta_json_iterator_next(riter))
+   first = true;
+   if (pgmoneta_json_reader_init(source, &reader) || pgmoneta_json_locate(reader, key_path, 1))
+   {
+      pgmoneta_log_error("Cannot locate WAL ranges in manifest %s", source);
+      goto error;
+   }
+   while (pgmoneta_json_next_array_item(reader, &range))
+   {
+      write_manifest_wal_range(file, range, first);
+      first = false;
+      pgmoneta_json_destroy(range);
+      range = NULL;
+   }
+   fprintf(file, "%s],\n", first ? "" : "\n");
+
+   if (write_manifest_checksum(file, path))
+   {
+      goto error;
+   }
+
+   fclose(file);
+   pgmoneta_json_reader_close(reader);
+   pgmoneta_json_iterator_destroy(fiter);
+   pgmoneta_manifest_iterator_destroy(iter);
+   pgmoneta_json_destroy(header);
+   return 0;
+
+error:
+   if (file != NULL)
    {
-      r = (struct json*)pgmoneta_value_data(riter->value);
-      fprintf(file, "{ \"Timeline\": %d, \"Start-LSN\": \"%s\", \"End-LSN\": \"%s\" }",
-              (int)pgmoneta_json_get(r, "Timeline"),
-              (char*)pgmoneta_json_get(r, "Start-LSN"),
-              (char*)pgmoneta_json_get(r, "End-LSN"));
-      if (pgmoneta_json_iterator_has_next(riter))
+      fclose(file);
+   }
+   pgmoneta_json_reader_close(reader);
+   pgmoneta_json_destroy(range);
+   pgmoneta_json_iterator_destroy(fiter);
+   pgmoneta_manifest_iterator_destroy(iter);
+   pgmoneta_json_destroy(header);
+   return 1;
+}
+
+int
+pgmoneta_manifest_convert(char* source, char* path, uint32_t chunk)
+{
+   int ret = 1;
+   int runs = 0;
+   char run_path[MAX_PATH];
+   char* key_path[1] = {MANIFEST_KEY_FILES};
+   struct json_reader* reader = NULL;
+   struct json* entry = NULL;
+   struct deque* rows = NULL;
+
+   if (pgmoneta_json_reader_init(source, &reader))
+   {
+      goto done;
+   }
+   if (pgmoneta_json_locate(reader, key_path, 1))
+   {
+      pgmoneta_log_error("Could not locate files array in manifest %s", source);
+      goto done;
+   }
+
+   if (pgmoneta_deque_create(false, &rows))
+   {
+      goto done;
+   }
+
+   // PostgreSQL doesn't sort its manifests, so sort the rows in bounded runs
+   while (pgmoneta_json_next_array_item(reader, &entry))
+   {
+      if (pgmoneta_deque_add(rows, (char*)pgmoneta_json_get(entry, MANIFEST_FILE_KEY_PATH),
+                             pgmoneta_json_get(entry, MANIFEST_FILE_KEY_CHECKSUM), ValueString))
       {
-         fprintf(file, ",\n");
+         goto done;
       }
-      else
+      pgmoneta_json_destroy(entry);
+      entry = NULL;
+
+      if (chunk > 0 && pgmoneta_deque_size(rows) >= chunk)
       {
-         fprintf(file, "\n");
+         pgmoneta_snprintf(run_path, sizeof(run_path), "%s.%d", path, runs);
+         if (write_sorted_run(rows, run_path))
+         {
+            goto done;
+         }
+         runs++;
+
+         pgmoneta_deque_destroy(rows);
+         rows = NULL;
+         if (pgmoneta_deque_create(false, &rows))
+         {
+            goto done;
+         }
       }
    }
-   fprintf(file, "],\n");
 
-   fflush(file);
+   if (runs == 0)
+   {
+      ret = write_sorted_run(rows, path);
+      goto done;
+   }
 
-   if (pgmoneta_create_sha256_file(path, &checksum))
+   if (pgmoneta_deque_size(rows) > 0)
+   {
+      pgmoneta_snprintf(run_path, sizeof(run_path), "%s.%d", path, runs);
+      if (write_sorted_run(rows, run_path))
+      {
+         goto done;
+      }
+      runs++;
+   }
+
+   pgmoneta_deque_destroy(rows);
+   rows = NULL;
+
+   ret = merge_sorted_runs(path, runs);
+
+done:
+   for (int i = 0; i < runs; i++)
+   {
+      pgmoneta_snprintf(run_path, sizeof(run_path), "%s.%d", path, i);
+      remove(run_path);
+   }
+   pgmoneta_json_reader_close(reader);
+   pgmoneta_json_destroy(entry);
+   pgmoneta_deque_destroy(rows);
+   return ret;
+}
+
+int
+pgmoneta_manifest_iterator_create(char* manifest_path, struct manifest_iterator** iter)
+{
+   char* key_path[1] = {MANIFEST_KEY_FILES};
+   struct manifest_iterator* i = NULL;
+
+   *iter = NULL;
+
+   i = (struct manifest_iterator*)calloc(1, sizeof(struct manifest_iterator));
+   if (i == NULL)
    {
-      pgmoneta_log_error("unable to get manifest checksum at %s", path);
       goto error;
    }
-   fprintf(file, "\"%s\": \"%s\"}\n", MANIFEST_KEY_CHECKSUM, checksum);
 
-   free(checksum);
-   fclose(file);
-   pgmoneta_json_iterator_destroy(fiter);
-   pgmoneta_json_iterator_destroy(riter);
+   if (pgmoneta_json_reader_init(manifest_path, &i->reader))
+   {
+      pgmoneta_log_error("Unable to read manifest %s", manifest_path);
+      goto error;
+   }
+
+   if (pgmoneta_json_locate(i->reader, key_path, 1))
+   {
+      pgmoneta_log_error("Cannot locate files array in manifest %s", manifest_path);
+      goto error;
+   }
+
+   *iter = i;
+
    return 0;
 
 error:
-   free(checksum);
-   pgmoneta_json_iterator_destroy(fiter);
-   pgmoneta_json_iterator_destroy(riter);
-   if (file != NULL)
+   pgmoneta_manifest_iterator_destroy(i);
+   return 1;
+}
+
+bool
+pgmoneta_manifest_iterator_next(struct manifest_iterator* iter)
+{
+   if (iter == NULL || iter->reader == NULL)
    {
-      fclose(file);
+      return false;
+   }
+
+   pgmoneta_json_destroy(iter->entry);
+   iter->entry = NULL;
+   iter->path = NULL;
+   iter->checksum = NULL;
+   iter->size = 0;
+
+   if (!pgmoneta_json_next_array_item(iter->reader, &iter->entry))
+   {
+      return false;
+   }
+
+   iter->path = (char*)pgmoneta_json_get(iter->entry, MANIFEST_FILE_KEY_PATH);
+   iter->checksum = (char*)pgmoneta_json_get(iter->entry, MANIFEST_FILE_KEY_CHECKSUM);
+   iter->size = (uint64_t)pgmoneta_json_get(iter->entry, MANIFEST_FILE_KEY_SIZE);
+
+   return iter->path != NULL;
+}
+
+void
+pgmoneta_manifest_iterator_destroy(struct manifest_iterator* iter)
+{
+   if (iter == NULL)
+   {
+      return;
+   }
+
+   pgmoneta_json_reader_close(iter->reader);
+   pgmoneta_json_destroy(iter->entry);
+   free(iter);
+}
+
+int
+pgmoneta_manifest_sum_sizes(char* manifest_path, manifest_size_cb size_cb, void* data, uint64_t* size, uint64_t* biggest_file_size)
+{
+   uint64_t sz = 0;
+   uint64_t biggest = 0;
+   uint64_t file_size = 0;
+   struct manifest_iterator* iter = NULL;
+
+   *size = 0;
+   *biggest_file_size = 0;
+
+   if (pgmoneta_manifest_iterator_create(manifest_path, &iter))
+   {
+      goto error;
    }
+
+   while (pgmoneta_manifest_iterator_next(iter))
+   {
+      file_size = iter->size;
+      if (size_cb != NULL && size_cb(iter->path, iter->size, data, &file_size))
+      {
+         goto error;
+      }
+
+      if (file_size > biggest)
+      {
+         biggest = file_size;
+      }
+      sz += file_size;
+   }
+
+   *size = sz;
+   *biggest_file_size = biggest;
+
+   pgmoneta_manifest_iterator_destroy(iter);
+   return 0;
+
+error:
+   pgmoneta_manifest_iterator_destroy(iter);
+   return 1;
+}
+
+int
+pgmoneta_manifest_count_files(char* manifest_path, int* count)
+{
+   int cols = 0;
+   int num = 0;
+   char** entry = NULL;
+   struct csv_reader* reader = NULL;
+
+   *count = 0;
+
+   if (pgmoneta_csv_reader_init(manifest_path, &reader))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_csv_next_row(reader, &cols, &entry))
+   {
+      free(entry);
+      entry = NULL;
+
+      if (cols != MANIFEST_COLUMN_COUNT)
+      {
+         pgmoneta_log_error("pgmoneta_manifest_count_files: incorrect number of columns");
+         goto error;
+      }
+
+      num++;
+   }
+
+   pgmoneta_csv_reader_destroy(reader);
+
+   *count = num;
+
+   return 0;
+
+error:
+   pgmoneta_csv_reader_destroy(reader);
    return 1;
 }
 
@@ -851,3 +1345,255 @@ error:
 
    return 1;
 }
+
+static int
+collect_diff(enum manifest_diff kind, char* path, char* checksum, void* data)
+{
+   struct manifest_diff_arts* diff = (struct manifest_diff_arts*)data;
+
+   switch (kind)
+   {
+      case ManifestDeleted:
+         return pgmoneta_art_insert(diff->deleted, path, (uintptr_t)checksum, ValueString);
+      case ManifestChanged:
+         return pgmoneta_art_insert(diff->changed, path, (uintptr_t)checksum, ValueString);
+      case ManifestAdded:
+         return pgmoneta_art_insert(diff->added, path, (uintptr_t)checksum, ValueString);
+      default:
+         break;
+   }
+
+   return 1;
+}
+
+static int
+next_sorted_entry(struct csv_reader* reader, struct manifest_file* file)
+{
+   int cols = 0;
+   char** entry = NULL;
+   char* path = NULL;
+   char* checksum = NULL;
+
+   // the row points into the reader's line buffer, so copy it out
+   while (pgmoneta_csv_next_row(reader, &cols, &entry))
+   {
+      if (cols != MANIFEST_COLUMN_COUNT)
+      {
+         pgmoneta_log_error("Incorrect number of columns in manifest file");
+         free(entry);
+         entry = NULL;
+         continue;
+      }
+
+      path = strdup(entry[MANIFEST_PATH_INDEX]);
+      checksum = strdup(entry[MANIFEST_CHECKSUM_INDEX]);
+      free(entry);
+
+      if (path == NULL || checksum == NULL)
+      {
+         goto error;
+      }
+
+      if (file->path != NULL && strcmp(path, file->path) <= 0)
+      {
+         free(path);
+         free(checksum);
+         return MANIFEST_DIFF_UNSORTED;
+      }
+      break;
+   }
+
+   free(file->path);
+   free(file->checksum);
+   file->path = path;
+   file->checksum = checksum;
+
+   return 0;
+
+error:
+   free(path);
+   free(checksum);
+   return 1;
+}
+
+static int
+write_sorted_run(struct deque* rows, char* path)
+{
+   int ret = 1;
+   char* info[MANIFEST_COLUMN_COUNT];
+   struct csv_writer* writer = NULL;
+   struct deque_iterator* iter = NULL;
+
+   pgmoneta_deque_sort(rows, NULL);
+
+   if (pgmoneta_csv_writer_init(path, &writer))
+   {
+      pgmoneta_log_error("Could not create csv writer for %s", path);
+      goto done;
+   }
+
+   if (pgmoneta_deque_iterator_create(rows, &iter))
+   {
+      goto done;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      info[MANIFEST_PATH_INDEX] = iter->tag;
+      info[MANIFEST_CHECKSUM_INDEX] = (char*)pgmoneta_value_data(iter->value);
+      if (pgmoneta_csv_write(writer, MANIFEST_COLUMN_COUNT, info))
+      {
+         goto done;
+      }
+   }
+
+   ret = 0;
+
+done:
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_csv_writer_destroy(writer);
+   return ret;
+}
+
+static int
+merge_sorted_runs(char* path, int runs)
+{
+   int ret = 1;
+   int min;
+   char run_path[MAX_PATH];
+   char* info[MANIFEST_COLUMN_COUNT];
+   struct csv_reader** readers = NULL;
+   struct manifest_file* heads = NULL;
+   struct csv_writer* writer = NULL;
+
+   readers = (struct csv_reader**)calloc(runs, sizeof(struct csv_reader*));
+   heads = (struct manifest_file*)calloc(runs, sizeof(struct manifest_file));
+   if (readers == NULL || heads == NULL)
+   {
+      goto done;
+   }
+
+   for (int i = 0; i < runs; i++)
+   {
+      pgmoneta_snprintf(run_path, sizeof(run_path), "%s.%d", path, i);
+      if (pgmoneta_csv_reader_init(run_path, &readers[i]) || next_sorted_entry(readers[i], &heads[i]))
+      {
+         goto done;
+      }
+   }
+
+   if (pgmoneta_csv_writer_init(path, &writer))
+   {
+      pgmoneta_log_error("Could not create csv writer for %s", path);
+      goto done;
+   }
+
+   // the runs are few, so a linear scan for the smallest head will do
+   while (true)
+   {
+      min = -1;
+      for (int i = 0; i < runs; i++)
+      {
+         if (heads[i].path != NULL && (min == -1 || strcmp(heads[i].path, heads[min].path) < 0))
+         {
+            min = i;
+         }
+      }
+
+      if (min == -1)
+      {
+         break;
+      }
+
+      info[MANIFEST_PATH_INDEX] = heads[min].path;
+      info[MANIFEST_CHECKSUM_INDEX] = heads[min].checksum;
+      if (pgmoneta_csv_write(writer, MANIFEST_COLUMN_COUNT, info) || next_sorted_entry(readers[min], &heads[min]))
+      {
+         goto done;
+      }
+   }
+
+   ret = 0;
+
+done:
+   for (int i = 0; heads != NULL && i < runs; i++)
+   {
+      free(heads[i].path);
+      free(heads[i].checksum);
+   }
+   for (int i = 0; readers != NULL && i < runs; i++)
+   {
+      pgmoneta_csv_reader_destroy(readers[i]);
+   }
+   pgmoneta_csv_writer_destroy(writer);
+   free(readers);
+   free(heads);
+   return ret;
+}
+
+static int
+compare_file_path(struct value* v1, struct value* v2)
+{
+   char* p1 = (char*)pgmoneta_json_get((struct json*)pgmoneta_value_data(v1), MANIFEST_FILE_KEY_PATH);
+   char* p2 = (char*)pgmoneta_json_get((struct json*)pgmoneta_value_data(v2), MANIFEST_FILE_KEY_PATH);
+
+   if (p1 == NULL || p2 == NULL)
+   {
+      return p1 == NULL ? (p2 == NULL ? 0 : 1) : -1;
+   }
+
+   return strcmp(p1, p2);
+}
+
+static void
+write_manifest_header(FILE* file, int version, bool has_system_identifier, uint64_t system_identifier)
+{
+   fprintf(file, "{ \"%s\": %d,\n", MANIFEST_KEY_VERSION, version);
+
+   if (has_system_identifier)
+   {
+      fprintf(file, "\"%s\": %" PRIu64 ",\n", MANIFEST_KEY_SYS_IDENTIFIER, system_identifier);
+   }
+
+   fprintf(file, "\"%s\": [\n", MANIFEST_KEY_FILES);
+}
+
+static void
+write_manifest_file(FILE* file, struct json* f, bool first)
+{
+   fprintf(file, "%s{ \"Path\": \"%s\", \"Size\": %" PRIu64 ", \"Last-Modified\": \"%s\", \"Checksum-Algorithm\": \"%s\", \"Checksum\": \"%s\" }",
+           first ? "" : ",\n",
+           (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_PATH),
+           (uint64_t)pgmoneta_json_get(f, MANIFEST_FILE_KEY_SIZE),
+           (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_LAST_MODIFIED),
+           (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_CHECKSUM_ALGORITHM),
+           (char*)pgmoneta_json_get(f, MANIFEST_FILE_KEY_CHECKSUM));
+}
+
+static void
+write_manifest_wal_range(FILE* file, struct json* r, bool first)
+{
+   fprintf(file, "%s{ \"Timeline\": %d, \"Start-LSN\": \"%s\", \"End-LSN\": \"%s\" }",
+           first ? "" : ",\n",
+           (int)pgmoneta_json_get(r, "Timeline"),
+           (char*)pgmoneta_json_get(r, "Start-LSN"),
+           (char*)pgmoneta_json_get(r, "End-LSN"));
+}
+
+static int
+write_manifest_checksum(FILE* file, char* path)
+{
+   char* checksum = NULL;
+
+   fflush(file);
+
+   if (pgmoneta_create_sha256_file(path, &checksum))
+   {
+      pgmoneta_log_error("unable to get manifest checksum at %s", path);
+      return 1;
+   }
+   fprintf(file, "\"%s\": \"%s\"}\n", MANIFEST_KEY_CHECKSUM, checksum);
+
+   free(checksum);
+   return 0;
+}
@@ -28,17 +28,105 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <memory.h>
 #include <utils.h>
 
 /* system */
 #ifdef DEBUG
 #include <assert.h>
 #endif
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef HAVE_LINUX
+#include <sys/syscall.h>
+#endif
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGNMENT          16
+#define ARENA_INTERNED_CAPACITY  64
+
+#define BUFFER_POOL_CLASSES        5
+#define BUFFER_POOL_MIN_SHIFT      16
+#define BUFFER_POOL_CLASS_SHIFT    2
+#define BUFFER_POOL_NODES          8
+#define BUFFER_POOL_THREAD_BYTES   (8 * 1024 * 1024)
+#define BUFFER_POOL_SHARED_BYTES   (64 * 1024 * 1024)
+#define BUFFER_POOL_HUGE_PAGE      (2 * 1024 * 1024)
+#define BUFFER_POOL_MAGIC          0x706d6266
+#define BUFFER_POOL_MPOL_PREFERRED 1
+
+struct memory_arena_block
+{
+   struct memory_arena_block* next; /**< The next, older, block */
+   size_t size;                     /**< The usable size */
+   size_t used;                     /**< The used size */
+   char data[] __attribute__((aligned(ARENA_ALIGNMENT)));
+};
+
+struct memory_arena_finalizer
+{
+   struct memory_arena_finalizer* next; /**< The next finalizer */
+   void (*callback)(void* data);        /**< The callback */
+   void* data;                          /**< The callback argument */
+};
+
+/* The header of a pooled buffer, placed in the page in front of the data */
+struct memory_buffer
+{
+   uint32_t magic;             /**< The magic */
+   int size_class;             /**< The size class, or -1 when the buffer isn't pooled */
+   int node;                   /**< The NUMA node */
+   bool huge;                  /**< Backed by huge pages */
+   size_t capacity;            /**< The usable size */
+   size_t mapped;              /**< The size of the mapping */
+   struct memory_buffer* next; /**< The next cached buffer */
+};
+
+/* The buffers cached by a thread */
+struct memory_buffer_cache
+{
+   struct memory_buffer* buffers[BUFFER_POOL_CLASSES]; /**< The cached buffers per size class */
+   size_t size;                                        /**< The number of bytes cached */
+   bool registered;                                    /**< Flushed when the thread exits */
+};
+
+/* The message buffer of a thread, so connections can be read from several threads */
+static _Thread_local struct message* message = NULL;
+static _Thread_local void* data = NULL;
+
+static unsigned char buffer_hugepage = HUGEPAGE_OFF;
+#ifdef HAVE_LINUX
+static int buffer_numa = -1;
+#endif
+static pthread_mutex_t buffer_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct memory_buffer* buffer_shared[BUFFER_POOL_NODES][BUFFER_POOL_CLASSES];
+static size_t buffer_shared_size = 0;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t buffer_key;
+static atomic_ullong buffer_hits = 0;
+static atomic_ullong buffer_misses = 0;
+static atomic_ullong buffer_huge_pages = 0;
+static atomic_ullong buffer_mapped = 0;
+static atomic_ullong buffer_in_use = 0;
+static _Thread_local struct memory_buffer_cache buffer_cache;
+
+static void* arena_alloc(struct memory_arena* arena, size_t size);
+static int arena_add_block(struct memory_arena* arena, size_t size);
+static uint32_t arena_hash(const char* s, size_t length);
+static int arena_grow_interned(struct memory_arena* arena);
 
-static struct message* message = NULL;
-static void* data = NULL;
+static int buffer_class(size_t size);
+static int buffer_node(void);
+static struct memory_buffer* buffer_header(void* buffer);
+static struct memory_buffer* buffer_map(int size_class, size_t size, int node);
+static void buffer_unmap(struct memory_buffer* b);
+static void buffer_cache_flush(void* cache);
+static void buffer_key_create(void);
 
 void
 pgmoneta_memory_init(void)
@@ -66,6 +154,11 @@ pgmoneta_memory_init(void)
 struct message*
 pgmoneta_memory_message(void)
 {
+   if (message == NULL)
+   {
+      pgmoneta_memory_init();
+   }
+
 #ifdef DEBUG
    assert(message != NULL);
    assert(data != NULL);
@@ -98,6 +191,8 @@ pgmoneta_memory_destroy(void)
 
    data = NULL;
    message = NULL;
+
+   pgmoneta_memory_buffer_trim();
 }
 
 void*
@@ -155,7 +250,7 @@ pgmoneta_memory_stream_buffer_init(struct stream_buffer** buffer)
 
    b->size = DEFAULT_BUFFER_SIZE;
    b->start = b->end = b->cursor = 0;
-   b->buffer = aligned_alloc((size_t)ALIGNMENT_SIZE, DEFAULT_BUFFER_SIZE);
+   b->buffer = pgmoneta_memory_buffer_acquire(DEFAULT_BUFFER_SIZE);
    *buffer = b;
 }
 
@@ -179,7 +274,7 @@ pgmoneta_memory_stream_buffer_enlarge(struct stream_buffer* buffer, int bytes_ne
       return 0;
    }
 
-   new_buffer = aligned_alloc((size_t)ALIGNMENT_SIZE, new_size);
+   new_buffer = pgmoneta_memory_buffer_acquire(new_size);
 
    if (new_buffer == NULL)
    {
@@ -189,7 +284,7 @@ pgmoneta_memory_stream_buffer_enlarge(struct stream_buffer* buffer, int bytes_ne
    memset(new_buffer, 0, new_size);
    memcpy(new_buffer, buffer->buffer, buffer->size);
 
-   free(buffer->buffer);
+   pgmoneta_memory_buffer_release(buffer->buffer);
 
    buffer->size = new_size;
    buffer->buffer = new_buffer;
@@ -206,8 +301,796 @@ pgmoneta_memory_stream_buffer_free(struct stream_buffer* buffer)
    }
    if (buffer->buffer != NULL)
    {
-      free(buffer->buffer);
+      pgmoneta_memory_buffer_release(buffer->buffer);
       buffer->buffer = NULL;
    }
    free(buffer);
 }
+
+int
+pgmoneta_memory_arena_create(size_t block_size, struct memory_arena** arena)
+{
+   struct memory_arena* a = NULL;
+
+   *arena = NULL;
+
+   a = (struct memory_arena*)malloc(sizeof(struct memory_arena));
+   if (a == NULL)
+   {
+      goto error;
+   }
+
+   memset(a, 0, sizeof(struct memory_arena));
+   pthread_mutex_init(&a->lock, NULL);
+   a->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+
+   if (arena_add_block(a, a->block_size))
+   {
+      goto error;
+   }
+
+   *arena = a;
+
+   return 0;
+
+error:
+
+   pgmoneta_memory_arena_destroy(a);
+
+   return 1;
+}
+
+void
+pgmoneta_memory_arena_share(struct memory_arena* arena)
+{
+   if (arena != NULL)
+   {
+      arena->shared = true;
+   }
+}
+
+void*
+pgmoneta_memory_arena_alloc(struct memory_arena* arena, size_t size)
+{
+   void* p = NULL;
+   bool shared;
+
+   if (arena == NULL)
+   {
+      return NULL;
+   }
+
+   shared = arena->shared;
+
+   if (shared)
+   {
+      pthread_mutex_lock(&arena->lock);
+   }
+   p = arena_alloc(arena, size);
+   if (shared)
+   {
+      pthread_mutex_unlock(&arena->lock);
+   }
+
+   return p;
+}
+
+char*
+pgmoneta_memory_arena_strndup(struct memory_arena* arena, const char* s, size_t length)
+{
+   char* copy = NULL;
+
+   copy = (char*)pgmoneta_memory_arena_alloc(arena, length + 1);
+   if (copy == NULL)
+   {
+      return NULL;
+   }
+
+   memcpy(copy, s, length);
+   copy[length] = '\0';
+
+   return copy;
+}
+
+char*
+pgmoneta_memory_arena_intern(struct memory_arena* arena, const char* s, size_t length)
+{
+   uint32_t mask;
+   uint32_t index;
+   char* copy = NULL;
+   bool shared;
+
+   if (arena == NULL || s == NULL)
+   {
+      return NULL;
+   }
+
+   shared = arena->shared;
+
+   if (shared)
+   {
+      pthread_mutex_lock(&arena->lock);
+   }
+
+   /* Keep the table at most half full */
+   if ((arena->interned_size + 1) * 2 > arena->interned_capacity)
+   {
+      if (arena_grow_interned(arena))
+      {
+         goto done;
+      }
+   }
+
+   mask = arena->interned_capacity - 1;
+   index = arena_hash(s, length) & mask;
+
+   while (arena->interned[index] != NULL)
+   {
+      char* candidate = arena->interned[index];
+
+      if (strncmp(candidate, s, length) == 0 && candidate[length] == '\0')
+      {
+         copy = candidate;
+         goto done;
+      }
+
+      index = (index + 1) & mask;
+   }
+
+   copy = (char*)arena_alloc(arena, length + 1);
+   if (copy == NULL)
+   {
+      goto done;
+   }
+
+   memcpy(copy, s, length);
+   copy[length] = '\0';
+
+   arena->interned[index] = copy;
+   arena->interned_size++;
+
+done:
+
+   if (shared)
+   {
+      pthread_mutex_unlock(&arena->lock);
+   }
+
+   return copy;
+}
+
+int
+pgmoneta_memory_arena_defer(struct memory_arena* arena, void (*callback)(void* data), void* data)
+{
+   struct memory_arena_finalizer* f = NULL;
+   bool shared;
+
+   if (arena == NULL || callback == NULL)
+   {
+      return 1;
+   }
+
+   shared = arena->shared;
+
+   if (shared)
+   {
+      pthread_mutex_lock(&arena->lock);
+   }
+
+   f = (struct memory_arena_finalizer*)arena_alloc(arena, sizeof(struct memory_arena_finalizer));
+   if (f != NULL)
+   {
+      f->callback = callback;
+      f->data = data;
+      f->next = arena->finalizers;
+      arena->finalizers = f;
+   }
+
+   if (shared)
+   {
+      pthread_mutex_unlock(&arena->lock);
+   }
+
+   return f != NULL ? 0 : 1;
+}
+
+void
+pgmoneta_memory_arena_destroy(struct memory_arena* arena)
+{
+   struct memory_arena_finalizer* f = NULL;
+   struct memory_arena_block* block = NULL;
+   struct memory_arena_block* next = NULL;
+
+   if (arena == NULL)
+   {
+      return;
+   }
+
+   /* Finalizers live in the blocks, so they run first */
+   f = arena->finalizers;
+   while (f != NULL)
+   {
+      f->callback(f->data);
+      f = f->next;
+   }
+
+   block = arena->blocks;
+   while (block != NULL)
+   {
+      next = block->next;
+      free(block);
+      block = next;
+   }
+
+   free(arena->interned);
+   pthread_mutex_destroy(&arena->lock);
+   free(arena);
+}
+
+void*
+pgmoneta_memory_alloc(struct memory_arena* arena, size_t size)
+{
+   if (arena != NULL)
+   {
+      return pgmoneta_memory_arena_alloc(arena, size);
+   }
+
+   return malloc(size);
+}
+
+void
+pgmoneta_memory_release(struct memory_arena* arena, void* data)
+{
+   if (arena == NULL)
+   {
+      free(data);
+   }
+}
+
+void
+pgmoneta_memory_buffer_initialize(unsigned char hugepage)
+{
+   buffer_hugepage = hugepage;
+}
+
+void*
+pgmoneta_memory_buffer_acquire(size_t size)
+{
+   int size_class;
+   int node;
+   struct memory_buffer* b = NULL;
+
+   size_class = buffer_class(size);
+   node = buffer_node();
+
+   if (size_class >= 0)
+   {
+      b = buffer_cache.buffers[size_class];
+      if (b != NULL)
+      {
+         buffer_cache.buffers[size_class] = b->next;
+         buffer_cache.size -= b->capacity;
+      }
+      else
+      {
+         pthread_mutex_lock(&buffer_lock);
+         b = buffer_shared[node][size_class];
+         if (b != NULL)
+         {
+            buffer_shared[node][size_class] = b->next;
+            buffer_shared_size -= b->capacity;
+         }
+         pthread_mutex_unlock(&buffer_lock);
+      }
+   }
+
+   if (b != NULL)
+   {
+      atomic_fetch_add(&buffer_hits, 1);
+      if (shmem != NULL)
+      {
+         atomic_fetch_add(&((struct common_configuration*)shmem)->prometheus.buffer_pool_hits, 1);
+      }
+   }
+   else
+   {
+      b = buffer_map(size_class, size, node);
+      if (b == NULL)
+      {
+         return NULL;
+      }
+   }
+
+   b->next = NULL;
+   atomic_fetch_add(&buffer_in_use, b->capacity);
+
+   return (char*)b + (b->mapped - b->capacity);
+}
+
+void*
+pgmoneta_memory_buffer_resize(void* buffer, size_t size)
+{
+   void* n = NULL;
+   size_t capacity;
+
+   if (buffer == NULL)
+   {
+      return pgmoneta_memory_buffer_acquire(size);
+   }
+
+   capacity = pgmoneta_memory_buffer_capacity(buffer);
+   if (capacity >= size)
+   {
+      return buffer;
+   }
+
+   n = pgmoneta_memory_buffer_acquire(size);
+   if (n == NULL)
+   {
+      return NULL;
+   }
+
+   memcpy(n, buffer, capacity);
+   pgmoneta_memory_buffer_release(buffer);
+
+   return n;
+}
+
+size_t
+pgmoneta_memory_buffer_capacity(void* buffer)
+{
+   struct memory_buffer* b = buffer_header(buffer);
+
+   return b != NULL ? b->capacity : 0;
+}
+
+void
+pgmoneta_memory_buffer_release(void* buffer)
+{
+   struct memory_buffer* b = NULL;
+
+   if (buffer == NULL)
+   {
+      return;
+   }
+
+   b = buffer_header(buffer);
+   if (b == NULL)
+   {
+      return;
+   }
+
+   atomic_fetch_sub(&buffer_in_use, b->capacity);
+
+   if (b->size_class < 0)
+   {
+      buffer_unmap(b);
+      return;
+   }
+
+   if (buffer_cache.size + b->capacity <= BUFFER_POOL_THREAD_BYTES)
+   {
+      if (!buffer_cache.registered)
+      {
+         pthread_once(&buffer_key_once, buffer_key_create);
+         pthread_setspecific(buffer_key, &buffer_cache);
+         buffer_cache.registered = true;
+      }
+
+      b->next = buffer_cache.buffers[b->size_class];
+      buffer_cache.buffers[b->size_class] = b;
+      buffer_cache.size += b->capacity;
+      return;
+   }
+
+   pthread_mutex_lock(&buffer_lock);
+   if (buffer_shared_size + b->capacity <= BUFFER_POOL_SHARED_BYTES)
+   {
+      b->next = buffer_shared[b->node][b->size_class];
+      buffer_shared[b->node][b->size_class] = b;
+      buffer_shared_size += b->capacity;
+      b = NULL;
+   }
+   pthread_mutex_unlock(&buffer_lock);
+
+   if (b != NULL)
+   {
+      buffer_unmap(b);
+   }
+}
+
+void
+pgmoneta_memory_buffer_trim(void)
+{
+   struct memory_buffer* b = NULL;
+   struct memory_buffer* list = NULL;
+
+   buffer_cache_flush(&buffer_cache);
+
+   pthread_mutex_lock(&buffer_lock);
+   for (int i = 0; i < BUFFER_POOL_NODES; i++)
+   {
+      for (int j = 0; j < BUFFER_POOL_CLASSES; j++)
+      {
+         while (buffer_shared[i][j] != NULL)
+         {
+            b = buffer_shared[i][j];
+            buffer_shared[i][j] = b->next;
+            b->next = list;
+            list = b;
+         }
+      }
+   }
+   buffer_shared_size = 0;
+   pthread_mutex_unlock(&buffer_lock);
+
+   while (list != NULL)
+   {
+      b = list;
+      list = b->next;
+      buffer_unmap(b);
+   }
+}
+
+void
+pgmoneta_memory_buffer_statistics(struct memory_buffer_statistics* statistics)
+{
+   statistics->hits = atomic_load(&buffer_hits);
+   statistics->misses = atomic_load(&buffer_misses);
+   statistics->huge_pages = atomic_load(&buffer_huge_pages);
+   statistics->mapped = atomic_load(&buffer_mapped);
+   statistics->in_use = atomic_load(&buffer_in_use);
+}
+
+static void*
+arena_alloc(struct memory_arena* arena, size_t size)
+{
+   struct memory_arena_block* block = NULL;
+   size_t aligned = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+   void* p = NULL;
+
+   if (aligned == 0)
+   {
+      aligned = ARENA_ALIGNMENT;
+   }
+
+   block = arena->blocks;
+
+   if (block == NULL || block->size - block->used < aligned)
+   {
+      /* Oversized requests get a block of their own; the current block
+       * keeps serving the small ones
+       */
+      if (aligned > arena->block_size / 4)
+      {
+         if (arena_add_block(arena, aligned))
+         {
+            return NULL;
+         }
+
+         block = arena->blocks;
+
+         if (block->next != NULL)
+         {
+            arena->blocks = block->next;
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+         }
+      }
+      else
+      {
+         if (arena_add_block(arena, arena->block_size))
+         {
+            return NULL;
+         }
+
+         block = arena->blocks;
+      }
+   }
+
+   p = &block->data[block->used];
+   block->used += aligned;
+   arena->allocated += aligned;
+
+   return p;
+}
+
+static int
+arena_add_block(struct memory_arena* arena, size_t size)
+{
+   struct memory_arena_block* block = NULL;
+
+   block = (struct memory_arena_block*)malloc(sizeof(struct memory_arena_block) + size);
+   if (block == NULL)
+   {
+      return 1;
+   }
+
+   block->size = size;
+   block->used = 0;
+   block->next = arena->blocks;
+   arena->blocks = block;
+   arena->reserved += size;
+
+   return 0;
+}
+
+/* FNV-1a */
+static uint32_t
+arena_hash(const char* s, size_t length)
+{
+   uint32_t h = 2166136261U;
+
+   for (size_t i = 0; i < length; i++)
+   {
+      h ^= (unsigned char)s[i];
+      h *= 16777619U;
+   }
+
+   return h;
+}
+
+static int
+arena_grow_interned(struct memory_arena* arena)
+{
+   uint32_t capacity = arena->interned_capacity > 0 ? arena->interned_capacity * 2 : ARENA_INTERNED_CAPACITY;
+   char** table = NULL;
+
+   table = (char**)calloc(capacity, sizeof(char*));
+   if (table == NULL)
+   {
+      return 1;
+   }
+
+   for (uint32_t i = 0; i < arena->interned_capacity; i++)
+   {
+      char* s = arena->interned[i];
+      uint32_t index;
+
+      if (s == NULL)
+      {
+         continue;
+      }
+
+      index = arena_hash(s, strlen(s)) & (capacity - 1);
+      while (table[index] != NULL)
+      {
+         index = (index + 1) & (capacity - 1);
+      }
+      table[index] = s;
+   }
+
+   free(arena->interned);
+   arena->interned = table;
+   arena->interned_capacity = capacity;
+
+   return 0;
+}
+
+static int
+buffer_class(size_t size)
+{
+   for (int i = 0; i < BUFFER_POOL_CLASSES; i++)
+   {
+      if (size <= (size_t)1 << (BUFFER_POOL_MIN_SHIFT + i * BUFFER_POOL_CLASS_SHIFT))
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+static int
+buffer_node(void)
+{
+#ifdef HAVE_LINUX
+   unsigned int cpu = 0;
+   unsigned int node = 0;
+
+   if (buffer_numa == -1)
+   {
+      /* Only bind buffers when there is more than one node */
+      buffer_numa = access("/sys/devices/system/node/node1", F_OK) == 0 ? 1 : 0;
+      errno = 0;
+   }
+
+   if (buffer_numa == 1 && syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+   {
+      return (int)(node % BUFFER_POOL_NODES);
+   }
+#endif
+
+   return 0;
+}
+
+static struct memory_buffer*
+buffer_header(void* buffer)
+{
+   struct memory_buffer* b = NULL;
+   long page = sysconf(_SC_PAGESIZE);
+
+   if (buffer == NULL)
+   {
+      return NULL;
+   }
+
+   b = (struct memory_buffer*)((char*)buffer - page);
+
+#ifdef DEBUG
+   assert(b->magic == BUFFER_POOL_MAGIC);
+#endif
+
+   return b->magic == BUFFER_POOL_MAGIC ? b : NULL;
+}
+
+static struct memory_buffer*
+buffer_map(int size_class, size_t size, int node)
+{
+   size_t page = (size_t)sysconf(_SC_PAGESIZE);
+   size_t capacity;
+   size_t mapped;
+   size_t length;
+   bool huge = false;
+   char* m = NULL;
+   char* aligned = NULL;
+
+   if (size_class >= 0)
+   {
+      capacity = (size_t)1 << (BUFFER_POOL_MIN_SHIFT + size_class * BUFFER_POOL_CLASS_SHIFT);
+   }
+   else
+   {
+      capacity = (size + page - 1) & ~(page - 1);
+   }
+
+   /* The header takes the page in front of the data */
+   mapped = capacity + page;
+
+#ifdef HAVE_LINUX
+   huge = buffer_hugepage != HUGEPAGE_OFF && capacity >= BUFFER_POOL_HUGE_PAGE;
+#endif
+
+   /* Align huge page backed buffers, so every full 2MB range of the data can use a huge page */
+   length = huge ? mapped + BUFFER_POOL_HUGE_PAGE : mapped;
+
+   m = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (m == MAP_FAILED)
+   {
+      errno = 0;
+      return NULL;
+   }
+
+   aligned = m;
+   if (huge)
+   {
+      aligned = (char*)((((uintptr_t)m + page + BUFFER_POOL_HUGE_PAGE - 1) & ~((uintptr_t)BUFFER_POOL_HUGE_PAGE - 1)) - page);
+
+      if (aligned > m)
+      {
+         munmap(m, aligned - m);
+      }
+      if (m + length > aligned + mapped)
+      {
+         munmap(aligned + mapped, (m + length) - (aligned + mapped));
+      }
+   }
+
+#ifdef HAVE_LINUX
+   if (huge && madvise(aligned + page, capacity, MADV_HUGEPAGE) != 0)
+   {
+      errno = 0;
+      huge = false;
+   }
+
+   if (buffer_numa == 1 && node < (int)(sizeof(unsigned long) * 8))
+   {
+      unsigned long mask = 1UL << node;
+
+      if (syscall(SYS_mbind, aligned, mapped, BUFFER_POOL_MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0) != 0)
+      {
+         errno = 0;
+      }
+   }
+#endif
+
+   ((struct memory_buffer*)aligned)->magic = BUFFER_POOL_MAGIC;
+   ((struct memory_buffer*)aligned)->size_class = size_class;
+   ((struct memory_buffer*)aligned)->node = node;
+   ((struct memory_buffer*)aligned)->huge = huge;
+   ((struct memory_buffer*)aligned)->capacity = capacity;
+   ((struct memory_buffer*)aligned)->mapped = mapped;
+   ((struct memory_buffer*)aligned)->next = NULL;
+
+   atomic_fetch_add(&buffer_misses, 1);
+   atomic_fetch_add(&buffer_mapped, mapped);
+   if (huge)
+   {
+      atomic_fetch_add(&buffer_huge_pages, 1);
+   }
+
+   if (shmem != NULL)
+   {
+      struct prometheus* p = &((struct common_configuration*)shmem)->prometheus;
+
+      atomic_fetch_add(&p->buffer_pool_misses, 1);
+      atomic_fetch_add(&p->buffer_pool_mapped, (long)mapped);
+      if (huge)
+      {
+         atomic_fetch_add(&p->buffer_pool_huge_pages, 1);
+      }
+   }
+
+   return (struct memory_buffer*)aligned;
+}
+
+static void
+buffer_unmap(struct memory_buffer* b)
+{
+   size_t mapped = b->mapped;
+
+   b->magic = 0;
+
+   atomic_fetch_sub(&buffer_mapped, mapped);
+   if (b->huge)
+   {
+      atomic_fetch_sub(&buffer_huge_pages, 1);
+   }
+
+   if (shmem != NULL)
+   {
+      atomic_fetch_sub(&((struct common_configuration*)shmem)->prometheus.buffer_pool_mapped, (long)mapped);
+   }
+
+   munmap(b, mapped);
+}
+
+static void
+buffer_cache_flush(void* cache)
+{
+   struct memory_buffer_cache* c = (struct memory_buffer_cache*)cache;
+   struct memory_buffer* b = NULL;
+   struct memory_buffer* list = NULL;
+
+   if (c == NULL)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&buffer_lock);
+   for (int i = 0; i < BUFFER_POOL_CLASSES; i++)
+   {
+      while (c->buffers[i] != NULL)
+      {
+         b = c->buffers[i];
+         c->buffers[i] = b->next;
+
+         if (buffer_shared_size + b->capacity <= BUFFER_POOL_SHARED_BYTES)
+         {
+            b->next = buffer_shared[b->node][i];
+            buffer_shared[b->node][i] = b;
+            buffer_shared_size += b->capacity;
+         }
+         else
+         {
+            b->next = list;
+            list = b;
+         }
+      }
+   }
+   c->size = 0;
+   pthread_mutex_unlock(&buffer_lock);
+
+   while (list != NULL)
+   {
+      b = list;
+      list = b->next;
+      buffer_unmap(b);
+   }
+}
+
+static void
+buffer_key_create(void)
+{
+   pthread_key_create(&buffer_key, buffer_cache_flush);
+}
@@ -32,6 +32,7 @@
 #include <extension.h>
 #include <logging.h>
 #include <manifest.h>
+#include <memory.h>
 #include <message.h>
 #include <network.h>
 #include <security.h>
@@ -44,11 +45,13 @@
 #include <unistd.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/sha.h>
 #include <openssl/ssl.h>
 #include <sys/time.h>
 #include <stdio.h>
 
 static struct message* allocate_message(size_t size);
+static int create_bind_execute_message(char* statement, int number_of_parameters, char** parameters, int32_t* lengths, bool binary, bool sync, struct message** msg);
 
 static int read_message(int socket, bool block, int timeout, struct message** msg);
 static int write_message(int socket, struct message* msg);
@@ -62,6 +65,7 @@ static int get_number_of_columns(struct message* msg);
 static int get_column_name(struct message* msg, int index, char** name);
 
 static unsigned char* decode_base64(char* base64_data, int* decoded_len);
+static int send_file_resume(SSL* ssl, int socket, FILE* file, int64_t file_size, char* target_path, int64_t* offset);
 static char** get_paths(struct query_response* data, int* count);
 static void extract_file_name(char* path, char* file_name, char* file_path);
 
@@ -1130,6 +1134,289 @@ pgmoneta_create_query_message(char* query, struct message** msg)
    return MESSAGE_STATUS_OK;
 }
 
+int
+pgmoneta_create_parse_message(char* statement, char* query, int number_of_types, int32_t* types, struct message** msg)
+{
+   struct message* m = NULL;
+   size_t size;
+   size_t offset;
+
+   *msg = NULL;
+
+   if (statement == NULL || query == NULL || number_of_types < 0)
+   {
+      return MESSAGE_STATUS_ERROR;
+   }
+
+   /* Parse followed by Sync */
+   size = 1 + 4 + strlen(statement) + 1 + strlen(query) + 1 + 2 + 4 * number_of_types;
+   size += 1 + 4;
+
+   m = allocate_message(size);
+   if (m == NULL)
+   {
+      return MESSAGE_STATUS_ERROR;
+   }
+
+   m->kind = 'P';
+
+   pgmoneta_write_byte(m->data, 'P');
+   pgmoneta_write_int32(m->data + 1, size - 1 - 1 - 4);
+   offset = 5;
+
+   pgmoneta_write_string(m->data + offset, statement);
+   offset += strlen(statement) + 1;
+
+   pgmoneta_write_string(m->data + offset, query);
+   offset += strlen(query) + 1;
+
+   pgmoneta_write_int16(m->data + offset, (int16_t)number_of_types);
+   offset += 2;
+
+   for (int i = 0; i < number_of_types; i++)
+   {
+      pgmoneta_write_int32(m->data + offset, types[i]);
+      offset += 4;
+   }
+
+   pgmoneta_write_byte(m->data + offset, 'S');
+   pgmoneta_write_int32(m->data + offset + 1, 4);
+
+   *msg = m;
+
+   return MESSAGE_STATUS_OK;
+}
+
+int
+pgmoneta_create_bind_execute_message(char* statement, int number_of_parameters, char** parameters, bool binary,
+                                     struct message** msg)
+{
+   return create_bind_execute_message(statement, number_of_parameters, parameters, NULL, binary, true, msg);
+}
+
+int
+pgmoneta_create_bind_execute_binary_message(char* statement, int number_of_parameters, char** parameters, int32_t* lengths,
+                                            bool sync, struct message** msg)
+{
+   if (lengths == NULL)
+   {
+      *msg = NULL;
+      return MESSAGE_STATUS_ERROR;
+   }
+
+   return create_bind_execute_message(statement, number_of_parameters, parameters, lengths, true, sync, msg);
+}
+
+int
+pgmoneta_extended_query_execute(SSL* ssl, int socket, struct message* msg, void* buffer, size_t capacity, int64_t* length)
+{
+   int64_t l = 0;
+
+   if (pgmoneta_extended_query_execute_rows(ssl, socket, msg, buffer, capacity, 1, &l))
+   {
+      if (length != NULL)
+      {
+         *length = 0;
+      }
+      return 1;
+   }
+
+   if (length != NULL)
+   {
+      *length = l;
+   }
+
+   return 0;
+}
+
+int
+pgmoneta_extended_query_execute_rows(SSL* ssl, int socket, struct message* msg, void* buffer, size_t capacity, int rows,
+                                     int64_t* lengths)
+{
+   int status;
+   bool done = false;
+   bool failed = false;
+   int row = 0;
+   char header[5];
+   size_t header_size = 0;
+   char kind = 0;
+   size_t body = 0;
+   size_t position = 0;
+   char field[6];
+   int32_t field_length = -1;
+   struct message* reply = NULL;
+   struct message* error = NULL;
+
+   for (int i = 0; lengths != NULL && i < rows; i++)
+   {
+      lengths[i] = 0;
+   }
+
+   status = pgmoneta_write_message(ssl, socket, msg);
+   if (status != MESSAGE_STATUS_OK)
+   {
+      goto error;
+   }
+
+   while (!done)
+   {
+      char* p = NULL;
+      size_t n = 0;
+
+      status = pgmoneta_read_block_message(ssl, socket, &reply);
+
+      if (status == MESSAGE_STATUS_ZERO)
+      {
+         SLEEP(1000000L);
+         continue;
+      }
+      else if (status != MESSAGE_STATUS_OK)
+      {
+         goto error;
+      }
+
+      p = (char*)reply->data;
+      n = (size_t)reply->length;
+
+      /* Messages are decoded as they arrive, so the DataRow payload goes straight into the buffer */
+      while (n > 0)
+      {
+         size_t take;
+
+         if (header_size < 5)
+         {
+            int32_t m_length;
+
+            take = MIN(5 - header_size, n);
+            memcpy(&header[header_size], p, take);
+            header_size += take;
+            p += take;
+            n -= take;
+
+            if (header_size < 5)
+            {
+               continue;
+            }
+
+            kind = header[0];
+            m_length = pgmoneta_read_int32(&header[1]);
+
+            if (m_length < 4)
+            {
+               pgmoneta_log_error("Invalid message length: %d", m_length);
+               goto error;
+            }
+
+            body = (size_t)m_length - 4;
+            position = 0;
+            field_length = -1;
+
+            if (kind == 'E')
+            {
+               pgmoneta_free_message(error);
+               error = allocate_message(1 + (size_t)m_length);
+               if (error == NULL)
+               {
+                  goto error;
+               }
+               error->kind = 'E';
+               memcpy(error->data, &header[0], 5);
+            }
+         }
+         else
+         {
+            take = MIN(body - position, n);
+
+            if (kind == 'D' && row < rows)
+            {
+               for (size_t i = 0; i < take && position + i < sizeof(field); i++)
+               {
+                  field[position + i] = p[i];
+               }
+
+               if (position < sizeof(field) && position + take >= sizeof(field))
+               {
+                  if (pgmoneta_read_int16(&field[0]) != 1)
+                  {
+                     pgmoneta_log_error("Unexpected number of columns in query response");
+                     failed = true;
+                  }
+
+                  field_length = pgmoneta_read_int32(&field[2]);
+
+                  if (field_length > 0 && (buffer == NULL || (size_t)field_length > capacity))
+                  {
+                     pgmoneta_log_error("Query response of %d bytes exceeds the buffer of %zu bytes", field_length, capacity);
+                     failed = true;
+                  }
+               }
+
+               if (!failed && field_length > 0 && position + take > sizeof(field))
+               {
+                  size_t start = MAX(position, sizeof(field));
+                  size_t end = MIN(position + take, sizeof(field) + (size_t)field_length);
+
+                  if (end > start)
+                  {
+                     memcpy((char*)buffer + (size_t)row * capacity + (start - sizeof(field)), p + (start - position), end - start);
+                  }
+               }
+            }
+            else if (kind == 'E' && error != NULL)
+            {
+               memcpy((char*)error->data + 5 + position, p, take);
+            }
+
+            position += take;
+            p += take;
+            n -= take;
+         }
+
+         if (header_size == 5 && position == body)
+         {
+            if (kind == 'D' && row < rows)
+            {
+               if (lengths != NULL && field_length > 0)
+               {
+                  lengths[row] = field_length;
+               }
+               row++;
+            }
+            else if (kind == 'E')
+            {
+               pgmoneta_log_error_response_message(error);
+               failed = true;
+            }
+            else if (kind == 'Z')
+            {
+               done = true;
+            }
+
+            header_size = 0;
+         }
+      }
+
+      pgmoneta_clear_message();
+      reply = NULL;
+   }
+
+   if (failed)
+   {
+      goto error;
+   }
+
+   pgmoneta_free_message(error);
+
+   return 0;
+
+error:
+
+   pgmoneta_clear_message();
+   pgmoneta_free_message(error);
+
+   return 1;
+}
+
 int
 pgmoneta_send_copy_data(SSL* ssl, int socket, char* buffer, size_t nbytes)
 {
@@ -1476,6 +1763,114 @@ pgmoneta_query_response_debug(struct query_response* response)
    pgmoneta_log_trace("Tuples: %d", number_of_tuples);
 }
 
+static int
+create_bind_execute_message(char* statement, int number_of_parameters, char** parameters, int32_t* lengths, bool binary,
+                            bool sync, struct message** msg)
+{
+   struct message* m = NULL;
+   size_t bind;
+   size_t size;
+   size_t offset;
+   int32_t length;
+
+   *msg = NULL;
+
+   if (statement == NULL || number_of_parameters < 0)
+   {
+      return MESSAGE_STATUS_ERROR;
+   }
+
+   /* Bind: portal, statement, parameter formats, parameters and result formats */
+   bind = 1 + 4 + 1 + strlen(statement) + 1 + 2 + 2 + 2 + 2 + 2;
+   for (int i = 0; i < number_of_parameters; i++)
+   {
+      if (parameters[i] != NULL)
+      {
+         bind += 4 + (lengths != NULL ? (size_t)lengths[i] : strlen(parameters[i]));
+      }
+      else
+      {
+         bind += 4;
+      }
+   }
+
+   /* Bind and Execute of the unnamed portal, and the Sync when this ends the pipeline */
+   size = bind + 1 + 4 + 1 + 4;
+   if (sync)
+   {
+      size += 1 + 4;
+   }
+
+   m = allocate_message(size);
+   if (m == NULL)
+   {
+      return MESSAGE_STATUS_ERROR;
+   }
+
+   m->kind = 'B';
+
+   pgmoneta_write_byte(m->data, 'B');
+   pgmoneta_write_int32(m->data + 1, bind - 1);
+   offset = 5;
+
+   /* Unnamed portal */
+   offset += 1;
+
+   pgmoneta_write_string(m->data + offset, statement);
+   offset += strlen(statement) + 1;
+
+   /* One parameter format for all parameters, text unless lengths are given */
+   pgmoneta_write_int16(m->data + offset, 1);
+   offset += 2;
+   pgmoneta_write_int16(m->data + offset, lengths != NULL ? 1 : 0);
+   offset += 2;
+
+   pgmoneta_write_int16(m->data + offset, (int16_t)number_of_parameters);
+   offset += 2;
+
+   for (int i = 0; i < number_of_parameters; i++)
+   {
+      if (parameters[i] == NULL)
+      {
+         pgmoneta_write_int32(m->data + offset, -1);
+         offset += 4;
+      }
+      else
+      {
+         length = lengths != NULL ? lengths[i] : (int32_t)strlen(parameters[i]);
+         pgmoneta_write_int32(m->data + offset, length);
+         offset += 4;
+         memcpy(m->data + offset, parameters[i], length);
+         offset += length;
+      }
+   }
+
+   /* One result format for all columns */
+   pgmoneta_write_int16(m->data + offset, 1);
+   offset += 2;
+   pgmoneta_write_int16(m->data + offset, binary ? 1 : 0);
+   offset += 2;
+
+   pgmoneta_write_byte(m->data + offset, 'E');
+   pgmoneta_write_int32(m->data + offset + 1, 4 + 1 + 4);
+   offset += 5;
+
+   /* Unnamed portal, all rows */
+   offset += 1;
+   pgmoneta_write_int32(m->data + offset, 0);
+   offset += 4;
+
+   if (sync)
+   {
+      pgmoneta_write_byte(m->data + offset, 'S');
+      pgmoneta_write_int32(m->data + offset + 1, 4);
+   }
+
+   *msg = m;
+
+   return MESSAGE_STATUS_OK;
+}
+
 static struct message*
 allocate_message(size_t size)
 {
@@ -2770,10 +3165,20 @@ pgmoneta_send_file(SSL* ssl, int socket, char* username, char* source_path, char
 {
    FILE* file = NULL;
    struct query_response* qr = NULL;
-   unsigned char buffer[PGMONETA_CHUNK_SIZE];
-   char* encode_chunk = NULL;
-   size_t bytes_read;
-   size_t encoded_size;
+   unsigned char* buffer = NULL;
+   unsigned char checksums[PGMONETA_SEND_PIPELINE][SHA256_DIGEST_LENGTH];
+   unsigned char remote[PGMONETA_SEND_PIPELINE][SHA256_DIGEST_LENGTH];
+   int64_t lengths[PGMONETA_SEND_PIPELINE];
+   size_t sizes[PGMONETA_SEND_PIPELINE];
+   char* parameters[4];
+   int32_t parameter_lengths[4];
+   char offset_param[8];
+   char length_param[8];
+   int32_t types[4] = {BYTEAOID, TEXTOID, INT8OID, INT8OID};
+   struct message* msg = NULL;
+   int64_t offset = 0;
+   int64_t position;
+   int count;
 
    // Check if the user has sufficient privileges
    pgmoneta_ext_privilege(ssl, socket, &qr);
@@ -2789,24 +3194,106 @@ pgmoneta_send_file(SSL* ssl, int socket, char* username, char* source_path, char
          goto error;
       }
 
-      // Send the file content in chunks
-      while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      // Continue after the part of the file that is already on the server
+      if (send_file_resume(ssl, socket, file, (int64_t)pgmoneta_get_file_size(source_path), target_path, &offset))
+      {
+         goto error;
+      }
+
+      /* The chunk is bound as bytea, so only the server encodes it for the extension */
+      if (pgmoneta_create_parse_message("",
+                                        "WITH w AS MATERIALIZED (SELECT pgmoneta_ext_receive_file_chunk(translate(encode($1, 'base64'), E'\\n', ''), $2)) "
+                                        "SELECT sha256(pg_read_binary_file($2, $3, $4)) FROM w;",
+                                        4, &types[0], &msg) != MESSAGE_STATUS_OK)
+      {
+         goto error;
+      }
+
+      if (pgmoneta_extended_query_execute(ssl, socket, msg, NULL, 0, NULL))
+      {
+         pgmoneta_log_error("Sending file: Unable to prepare the file transfer");
+         goto error;
+      }
+      pgmoneta_free_message(msg);
+      msg = NULL;
+
+      buffer = (unsigned char*)pgmoneta_memory_buffer_acquire(PGMONETA_SEND_CHUNK_SIZE * PGMONETA_SEND_PIPELINE);
+      if (buffer == NULL)
       {
-         if (pgmoneta_base64_encode(buffer, bytes_read, &encode_chunk, &encoded_size))
+         goto error;
+      }
+
+      // Send the file content in pipelined chunks, one round trip per pipeline
+      while (true)
+      {
+         for (count = 0; count < PGMONETA_SEND_PIPELINE; count++)
          {
-            goto error;
+            sizes[count] = fread(buffer + (size_t)count * PGMONETA_SEND_CHUNK_SIZE, 1, PGMONETA_SEND_CHUNK_SIZE, file);
+            if (sizes[count] == 0)
+            {
+               break;
+            }
+
+            if (!EVP_Digest(buffer + (size_t)count * PGMONETA_SEND_CHUNK_SIZE, sizes[count], checksums[count], NULL, EVP_sha256(), NULL))
+            {
+               goto error;
+            }
          }
 
-         pgmoneta_ext_send_file_chunk(ssl, socket, target_path, encode_chunk, &qr);
-         if (!qr)
+         if (count == 0)
          {
-            pgmoneta_log_error("Sending file: Send file chunk failed");
-            goto error;
+            break;
+         }
+
+         position = offset;
+         for (int i = 0; i < count; i++)
+         {
+            pgmoneta_write_int64(&offset_param[0], position);
+            pgmoneta_write_int64(&length_param[0], (int64_t)sizes[i]);
+
+            parameters[0] = (char*)buffer + (size_t)i * PGMONETA_SEND_CHUNK_SIZE;
+            parameter_lengths[0] = (int32_t)sizes[i];
+            parameters[1] = target_path;
+            parameter_lengths[1] = (int32_t)strlen(target_path);
+            parameters[2] = &offset_param[0];
+            parameter_lengths[2] = sizeof(offset_param);
+            parameters[3] = &length_param[0];
+            parameter_lengths[3] = sizeof(length_param);
+
+            if (pgmoneta_create_bind_execute_binary_message("", 4, &parameters[0], &parameter_lengths[0], i == count - 1, &msg) != MESSAGE_STATUS_OK)
+            {
+               goto error;
+            }
+
+            if (i < count - 1)
+            {
+               if (pgmoneta_write_message(ssl, socket, msg) != MESSAGE_STATUS_OK)
+               {
+                  pgmoneta_log_error("Sending file: Send file chunk failed");
+                  goto error;
+               }
+            }
+            else if (pgmoneta_extended_query_execute_rows(ssl, socket, msg, &remote[0][0], SHA256_DIGEST_LENGTH, count, &lengths[0]))
+            {
+               pgmoneta_log_error("Sending file: Send file chunk failed");
+               goto error;
+            }
+
+            pgmoneta_free_message(msg);
+            msg = NULL;
+
+            position += (int64_t)sizes[i];
+         }
+
+         for (int i = 0; i < count; i++)
+         {
+            if (lengths[i] != SHA256_DIGEST_LENGTH || memcmp(remote[i], checksums[i], SHA256_DIGEST_LENGTH) != 0)
+            {
+               pgmoneta_log_error("Sending file: Checksum mismatch for %s at offset %" PRId64, target_path, offset);
+               goto error;
+            }
+            offset += (int64_t)sizes[i];
          }
-         pgmoneta_free_query_response(qr);
-         free(encode_chunk);
-         encode_chunk = NULL;
-         qr = NULL;
       }
    }
    else if (qr != NULL && qr->tuples != NULL && qr->tuples->data != NULL && qr->tuples->data[0] != NULL && qr->tuples->data[0][0] == 'f')
@@ -2821,10 +3308,7 @@ pgmoneta_send_file(SSL* ssl, int socket, char* username, char* source_path, char
    }
 
    fclose(file);
-   if (encode_chunk)
-   {
-      free(encode_chunk);
-   }
+   pgmoneta_memory_buffer_release(buffer);
    pgmoneta_free_query_response(qr);
 
    return 0;
@@ -2834,11 +3318,134 @@ error:
    {
       fclose(file);
    }
-   if (encode_chunk)
+   pgmoneta_memory_buffer_release(buffer);
+   pgmoneta_free_message(msg);
+   pgmoneta_free_query_response(qr);
+
+   return 1;
+}
+
+static int
+send_file_resume(SSL* ssl, int socket, FILE* file, int64_t file_size, char* target_path, int64_t* offset)
+{
+   int32_t types[2] = {TEXTOID, INT8OID};
+   char* parameters[2];
+   int32_t parameter_lengths[2];
+   char size_param[8];
+   char size[8];
+   unsigned char checksum[SHA256_DIGEST_LENGTH];
+   unsigned char local[SHA256_DIGEST_LENGTH];
+   unsigned char* buffer = NULL;
+   EVP_MD_CTX* ctx = NULL;
+   struct message* msg = NULL;
+   int64_t length = 0;
+   int64_t remote;
+   int64_t remaining;
+   size_t n;
+
+   *offset = 0;
+
+   parameters[0] = target_path;
+   parameter_lengths[0] = (int32_t)strlen(target_path);
+
+   if (pgmoneta_create_parse_message("", "SELECT size FROM pg_stat_file($1, true);", 1, &types[0], &msg) != MESSAGE_STATUS_OK ||
+       pgmoneta_extended_query_execute(ssl, socket, msg, NULL, 0, NULL))
+   {
+      goto error;
+   }
+   pgmoneta_free_message(msg);
+   msg = NULL;
+
+   if (pgmoneta_create_bind_execute_binary_message("", 1, &parameters[0], &parameter_lengths[0], true, &msg) != MESSAGE_STATUS_OK ||
+       pgmoneta_extended_query_execute(ssl, socket, msg, &size[0], sizeof(size), &length))
    {
-      free(encode_chunk);
+      goto error;
    }
-   pgmoneta_free_query_response(qr);
+   pgmoneta_free_message(msg);
+   msg = NULL;
+
+   /* No target file yet */
+   if (length != sizeof(size))
+   {
+      return 0;
+   }
+
+   remote = pgmoneta_read_int64(&size[0]);
+
+   if (remote == 0)
+   {
+      return 0;
+   }
+
+   if (remote > file_size)
+   {
+      pgmoneta_log_error("Sending file: %s is larger on the server than the source", target_path);
+      goto error;
+   }
+
+   pgmoneta_write_int64(&size_param[0], remote);
+   parameters[1] = &size_param[0];
+   parameter_lengths[1] = sizeof(size_param);
+
+   if (pgmoneta_create_parse_message("", "SELECT sha256(pg_read_binary_file($1, 0, $2));", 2, &types[0], &msg) != MESSAGE_STATUS_OK ||
+       pgmoneta_extended_query_execute(ssl, socket, msg, NULL, 0, NULL))
+   {
+      goto error;
+   }
+   pgmoneta_free_message(msg);
+   msg = NULL;
+
+   if (pgmoneta_create_bind_execute_binary_message("", 2, &parameters[0], &parameter_lengths[0], true, &msg) != MESSAGE_STATUS_OK ||
+       pgmoneta_extended_query_execute(ssl, socket, msg, &checksum[0], sizeof(checksum), &length))
+   {
+      goto error;
+   }
+   pgmoneta_free_message(msg);
+   msg = NULL;
+
+   buffer = (unsigned char*)pgmoneta_memory_buffer_acquire(PGMONETA_SEND_CHUNK_SIZE);
+   ctx = EVP_MD_CTX_new();
+   if (buffer == NULL || ctx == NULL || !EVP_DigestInit_ex(ctx, EVP_sha256(), NULL))
+   {
+      goto error;
+   }
+
+   remaining = remote;
+   while (remaining > 0)
+   {
+      n = fread(buffer, 1, (size_t)MIN(remaining, (int64_t)PGMONETA_SEND_CHUNK_SIZE), file);
+      if (n == 0 || !EVP_DigestUpdate(ctx, buffer, n))
+      {
+         goto error;
+      }
+      remaining -= (int64_t)n;
+   }
+
+   if (!EVP_DigestFinal_ex(ctx, local, NULL))
+   {
+      goto error;
+   }
+
+   if (length != SHA256_DIGEST_LENGTH || memcmp(checksum, local, SHA256_DIGEST_LENGTH) != 0)
+   {
+      pgmoneta_log_error("Sending file: %s on the server does not match the source, remove it to send the file again", target_path);
+      goto error;
+   }
+
+   pgmoneta_log_info("Sending file: Resuming %s at offset %" PRId64, target_path, remote);
+
+   *offset = remote;
+
+   EVP_MD_CTX_free(ctx);
+   pgmoneta_memory_buffer_release(buffer);
+
+   return 0;
+
+error:
+
+   EVP_MD_CTX_free(ctx);
+   pgmoneta_memory_buffer_release(buffer);
+   pgmoneta_free_message(msg);
 
    return 1;
 }
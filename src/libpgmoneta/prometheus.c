@@ -30,6 +30,7 @@
 #include <pgmoneta.h>
 #include <art.h>
 #include <backup.h>
+#include <compression.h>
 #include <extension.h>
 #include <fips.h>
 #include <info.h>
@@ -41,6 +42,8 @@
 #include <shmem.h>
 #include <utils.h>
 #include <wal.h>
+#include <walarchive.h>
+#include <walfile/wal_summary.h>
 #include <workflow.h>
 
 /* system */
@@ -477,6 +480,73 @@ home_page(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "  <h2>pgmoneta_logging_fatal</h2>\n");
    data = pgmoneta_append(data, "  The number of FATAL logging statements\n");
    data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_buffer_pool_hits</h2>\n");
+   data = pgmoneta_append(data, "  The number of buffer requests served from the buffer pool\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_buffer_pool_misses</h2>\n");
+   data = pgmoneta_append(data, "  The number of buffer requests that mapped a new buffer\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_buffer_pool_huge_pages</h2>\n");
+   data = pgmoneta_append(data, "  The number of buffers backed by huge pages\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_buffer_pool_mapped</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes mapped by the buffer pool\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_compression_original_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes given to compression per file class\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>class</td>\n");
+   data = pgmoneta_append(data, "        <td>relation|wal|transaction|other</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_compression_saved_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes saved by compression per file class\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>class</td>\n");
+   data = pgmoneta_append(data, "        <td>relation|wal|transaction|other</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_compression_cpu_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The CPU time spent in compression per file class\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>class</td>\n");
+   data = pgmoneta_append(data, "        <td>relation|wal|transaction|other</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_compression_skipped_files</h2>\n");
+   data = pgmoneta_append(data, "  The number of files stored without compression per file class\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>class</td>\n");
+   data = pgmoneta_append(data, "        <td>relation|wal|transaction|other</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_compression_saved_bytes_per_cpu_second</h2>\n");
+   data = pgmoneta_append(data, "  The number of bytes saved by compression per CPU second per file class\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>class</td>\n");
+   data = pgmoneta_append(data, "        <td>relation|wal|transaction|other</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
    data = pgmoneta_append(data, "  <h2>pgmoneta_retention_days</h2>\n");
    data = pgmoneta_append(data, "  The retention of pgmoneta in days\n");
    data = pgmoneta_append(data, "  <h2>pgmoneta_retention_weeks</h2>\n");
@@ -501,6 +571,83 @@ home_page(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "    </tbody>\n");
    data = pgmoneta_append(data, "  </table>\n");
    data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_bandwidth_limit</h2>\n");
+   data = pgmoneta_append(data, "  The bandwidth limit of pgmoneta in bytes per second\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_bandwidth_server_limit</h2>\n");
+   data = pgmoneta_append(data, "  The bandwidth limit of a server in bytes per second\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_bandwidth_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The bytes transferred by an operation on a server\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>operation</td>\n");
+   data = pgmoneta_append(data, "        <td>wal|backup|restore|transfer</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_bandwidth_throttled_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The time an operation on a server waited for bandwidth\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>operation</td>\n");
+   data = pgmoneta_append(data, "        <td>wal|backup|restore|transfer</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_backup_queue</h2>\n");
+   data = pgmoneta_append(data, "  The number of queued backups of a server\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_backup_queue_started</h2>\n");
+   data = pgmoneta_append(data, "  The number of queued backups of a server that started\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_backup_queue_wait_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The time the started backups of a server waited in the queue\n");
+   data = pgmoneta_append(data, "  <table border=\"1\">\n");
+   data = pgmoneta_append(data, "    <tbody>\n");
+   data = pgmoneta_append(data, "      <tr>\n");
+   data = pgmoneta_append(data, "        <td>name</td>\n");
+   data = pgmoneta_append(data, "        <td>The identifier for the server</td>\n");
+   data = pgmoneta_append(data, "      </tr>\n");
+   data = pgmoneta_append(data, "    </tbody>\n");
+   data = pgmoneta_append(data, "  </table>\n");
+   data = pgmoneta_append(data, "  <p>\n");
    data = pgmoneta_append(data, "  <h2>pgmoneta_compression</h2>\n");
    data = pgmoneta_append(data, "  The compression used\n");
    data = pgmoneta_append(data, "  <ul>\n");
@@ -553,6 +700,15 @@ home_page(SSL* client_ssl, int client_fd)
    data = pgmoneta_append(data, "  <h2>pgmoneta_wal_shipping_total_space</h2>\n");
    data = pgmoneta_append(data, "  The total disk space for the WAL shipping directory of a server\n");
    data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_wal_archive_lag_seconds</h2>\n");
+   data = pgmoneta_append(data, "  The age of the oldest WAL segment of a server that isn't archived\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_wal_archive_lag_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The size of the WAL segments of a server that aren't archived\n");
+   data = pgmoneta_append(data, "  <p>\n");
+   data = pgmoneta_append(data, "  <h2>pgmoneta_wal_summary_lag_bytes</h2>\n");
+   data = pgmoneta_append(data, "  The size of the finished WAL of a server that isn't summarized\n");
+   data = pgmoneta_append(data, "  <p>\n");
    data = pgmoneta_append(data, "  <h2>pgmoneta_workspace</h2>\n");
    data = pgmoneta_append(data, "  The disk space used for workspace for a server\n");
    data = pgmoneta_append(data, "  <p>\n");
@@ -1596,6 +1752,7 @@ general_information(prometheus_metrics_container_t* container)
    char* data = NULL;
    time_t t;
    char time_str[128];
+   uint64_t lag_bytes_total[NUMBER_OF_SERVERS];
    struct tm* time_info;
    struct main_configuration* config;
 
@@ -1658,6 +1815,125 @@ general_information(prometheus_metrics_container_t* container)
    add_metric_to_art(container->general_metrics, "pgmoneta_logging_fatal", data, NULL, NULL, 0);
    free(data);
    data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_buffer_pool_hits The number of buffer requests served from the buffer pool\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_buffer_pool_hits counter\n");
+   data = pgmoneta_append(data, "pgmoneta_buffer_pool_hits ");
+   data = pgmoneta_append_ulong(data, atomic_load(&config->common.prometheus.buffer_pool_hits));
+   data = pgmoneta_append(data, "\n\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_buffer_pool_hits", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_buffer_pool_misses The number of buffer requests that mapped a new buffer\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_buffer_pool_misses counter\n");
+   data = pgmoneta_append(data, "pgmoneta_buffer_pool_misses ");
+   data = pgmoneta_append_ulong(data, atomic_load(&config->common.prometheus.buffer_pool_misses));
+   data = pgmoneta_append(data, "\n\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_buffer_pool_misses", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_buffer_pool_huge_pages The number of buffers backed by huge pages\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_buffer_pool_huge_pages counter\n");
+   data = pgmoneta_append(data, "pgmoneta_buffer_pool_huge_pages ");
+   data = pgmoneta_append_ulong(data, atomic_load(&config->common.prometheus.buffer_pool_huge_pages));
+   data = pgmoneta_append(data, "\n\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_buffer_pool_huge_pages", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_buffer_pool_mapped The number of bytes mapped by the buffer pool\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_buffer_pool_mapped gauge\n");
+   data = pgmoneta_append(data, "pgmoneta_buffer_pool_mapped ");
+   data = pgmoneta_append_ulong(data, (unsigned long)MAX(atomic_load(&config->common.prometheus.buffer_pool_mapped), 0));
+   data = pgmoneta_append(data, "\n\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_buffer_pool_mapped", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_compression_original_bytes The number of bytes given to compression per file class\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_compression_original_bytes counter\n");
+   for (int i = 0; i < NUMBER_OF_COMPRESSION_CLASSES; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_compression_original_bytes{");
+      data = pgmoneta_append(data, "class=\"");
+      data = pgmoneta_append(data, pgmoneta_compression_class_name(i));
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_ulong(data, atomic_load(&config->compression_classes[i].original));
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_compression_original_bytes", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_compression_saved_bytes The number of bytes saved by compression per file class\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_compression_saved_bytes counter\n");
+   for (int i = 0; i < NUMBER_OF_COMPRESSION_CLASSES; i++)
+   {
+      unsigned long original = atomic_load(&config->compression_classes[i].original);
+      unsigned long compressed = atomic_load(&config->compression_classes[i].compressed);
+
+      data = pgmoneta_append(data, "pgmoneta_compression_saved_bytes{");
+      data = pgmoneta_append(data, "class=\"");
+      data = pgmoneta_append(data, pgmoneta_compression_class_name(i));
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_ulong(data, original > compressed ? original - compressed : 0);
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_compression_saved_bytes", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_compression_cpu_seconds The CPU time spent in compression per file class\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_compression_cpu_seconds counter\n");
+   for (int i = 0; i < NUMBER_OF_COMPRESSION_CLASSES; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_compression_cpu_seconds{");
+      data = pgmoneta_append(data, "class=\"");
+      data = pgmoneta_append(data, pgmoneta_compression_class_name(i));
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_double(data, atomic_load(&config->compression_classes[i].cpu) / 1000000000.0);
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_compression_cpu_seconds", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_compression_skipped_files The number of files stored without compression per file class\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_compression_skipped_files counter\n");
+   for (int i = 0; i < NUMBER_OF_COMPRESSION_CLASSES; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_compression_skipped_files{");
+      data = pgmoneta_append(data, "class=\"");
+      data = pgmoneta_append(data, pgmoneta_compression_class_name(i));
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_ulong(data, atomic_load(&config->compression_classes[i].skipped));
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_compression_skipped_files", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_compression_saved_bytes_per_cpu_second The number of bytes saved by compression per CPU second per file class\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_compression_saved_bytes_per_cpu_second gauge\n");
+   for (int i = 0; i < NUMBER_OF_COMPRESSION_CLASSES; i++)
+   {
+      unsigned long original = atomic_load(&config->compression_classes[i].original);
+      unsigned long compressed = atomic_load(&config->compression_classes[i].compressed);
+      double cpu = (double)atomic_load(&config->compression_classes[i].cpu);
+
+      data = pgmoneta_append(data, "pgmoneta_compression_saved_bytes_per_cpu_second{");
+      data = pgmoneta_append(data, "class=\"");
+      data = pgmoneta_append(data, pgmoneta_compression_class_name(i));
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_double(data, cpu > 0 ? (double)(original > compressed ? original - compressed : 0) / (cpu / 1000000000.0) : 0.0);
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+   add_metric_to_art(container->general_metrics, "pgmoneta_compression_saved_bytes_per_cpu_second", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
    data = pgmoneta_append(data, "#HELP pgmoneta_retention_days The retention days of pgmoneta\n");
    data = pgmoneta_append(data, "#TYPE pgmoneta_retention_days gauge\n");
    data = pgmoneta_append(data, "pgmoneta_retention_days ");
@@ -1764,6 +2040,131 @@ general_information(prometheus_metrics_container_t* container)
    add_metric_to_art(container->general_metrics, "pgmoneta_retention_server", data, NULL, NULL, 0);
    free(data);
    data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_bandwidth_limit The bandwidth limit of pgmoneta in bytes per second\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_bandwidth_limit gauge\n");
+   data = pgmoneta_append(data, "pgmoneta_bandwidth_limit ");
+   data = pgmoneta_append_int(data, config->max_bandwidth <= 0 ? 0 : config->max_bandwidth);
+   data = pgmoneta_append(data, "\n\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_bandwidth_limit", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_bandwidth_server_limit The bandwidth limit of a server in bytes per second\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_bandwidth_server_limit gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_bandwidth_server_limit{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_int(data, config->common.servers[i].max_bandwidth <= 0 ? 0 : config->common.servers[i].max_bandwidth);
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_bandwidth_server_limit", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_bandwidth_bytes The bytes transferred by an operation on a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_bandwidth_bytes counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < BANDWIDTH_OPERATIONS; j++)
+      {
+         data = pgmoneta_append(data, "pgmoneta_bandwidth_bytes{");
+         data = pgmoneta_append(data, "name=\"");
+         data = pgmoneta_append(data, config->common.servers[i].name);
+         data = pgmoneta_append(data, "\"");
+         data = pgmoneta_append(data, ", ");
+         data = pgmoneta_append(data, "operation=\"");
+         data = pgmoneta_append(data, pgmoneta_bandwidth_operation_name(j));
+         data = pgmoneta_append(data, "\"");
+         data = pgmoneta_append(data, "} ");
+         data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].bandwidth.operations[j].bytes));
+         data = pgmoneta_append(data, "\n");
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_bandwidth_bytes", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_bandwidth_throttled_seconds The time an operation on a server waited for bandwidth\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_bandwidth_throttled_seconds counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      for (int j = 0; j < BANDWIDTH_OPERATIONS; j++)
+      {
+         data = pgmoneta_append(data, "pgmoneta_bandwidth_throttled_seconds{");
+         data = pgmoneta_append(data, "name=\"");
+         data = pgmoneta_append(data, config->common.servers[i].name);
+         data = pgmoneta_append(data, "\"");
+         data = pgmoneta_append(data, ", ");
+         data = pgmoneta_append(data, "operation=\"");
+         data = pgmoneta_append(data, pgmoneta_bandwidth_operation_name(j));
+         data = pgmoneta_append(data, "\"");
+         data = pgmoneta_append(data, "} ");
+         data = pgmoneta_append_double(data, atomic_load(&config->common.servers[i].bandwidth.operations[j].throttled) / 1000000000.0);
+         data = pgmoneta_append(data, "\n");
+      }
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_bandwidth_throttled_seconds", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_backup_queue The number of queued backups of a server\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_backup_queue gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_backup_queue{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_int(data, atomic_load(&config->common.servers[i].scheduler.queued));
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_backup_queue", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_backup_queue_started The number of queued backups of a server that started\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_backup_queue_started counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_backup_queue_started{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].scheduler.dispatched));
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_backup_queue_started", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_backup_queue_wait_seconds The time the started backups of a server waited in the queue\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_backup_queue_wait_seconds counter\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_backup_queue_wait_seconds{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"");
+      data = pgmoneta_append(data, "} ");
+      data = pgmoneta_append_ulong(data, atomic_load(&config->common.servers[i].scheduler.wait));
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->general_metrics, "pgmoneta_backup_queue_wait_seconds", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
    data = pgmoneta_append(data, "#HELP pgmoneta_compression The compression used\n");
    data = pgmoneta_append(data, "#TYPE pgmoneta_compression gauge\n");
    data = pgmoneta_append(data, "pgmoneta_compression ");
@@ -1961,6 +2362,65 @@ general_information(prometheus_metrics_container_t* container)
    add_metric_to_art(container->wal_metrics, "pgmoneta_wal_shipping_total_space", data, NULL, NULL, 0);
    free(data);
    data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_wal_archive_lag_seconds The age of the oldest WAL segment of a server that isn't archived\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_wal_archive_lag_seconds gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      uint64_t lag_seconds = 0;
+      uint64_t lag_bytes = 0;
+
+      pgmoneta_wal_archive_lag(i, &lag_seconds, &lag_bytes);
+
+      data = pgmoneta_append(data, "pgmoneta_wal_archive_lag_seconds{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+      data = pgmoneta_append_ulong(data, lag_seconds);
+      data = pgmoneta_append(data, "\n");
+
+      lag_bytes_total[i] = lag_bytes;
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->wal_metrics, "pgmoneta_wal_archive_lag_seconds", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_wal_archive_lag_bytes The size of the WAL segments of a server that aren't archived\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_wal_archive_lag_bytes gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      data = pgmoneta_append(data, "pgmoneta_wal_archive_lag_bytes{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+      data = pgmoneta_append_ulong(data, lag_bytes_total[i]);
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->wal_metrics, "pgmoneta_wal_archive_lag_bytes", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
+   data = pgmoneta_append(data, "#HELP pgmoneta_wal_summary_lag_bytes The size of the finished WAL of a server that isn't summarized\n");
+   data = pgmoneta_append(data, "#TYPE pgmoneta_wal_summary_lag_bytes gauge\n");
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      uint64_t lag_bytes = 0;
+
+      pgmoneta_wal_summary_lag(i, &lag_bytes);
+
+      data = pgmoneta_append(data, "pgmoneta_wal_summary_lag_bytes{");
+      data = pgmoneta_append(data, "name=\"");
+      data = pgmoneta_append(data, config->common.servers[i].name);
+      data = pgmoneta_append(data, "\"} ");
+      data = pgmoneta_append_ulong(data, lag_bytes);
+      data = pgmoneta_append(data, "\n");
+   }
+   data = pgmoneta_append(data, "\n");
+
+   add_metric_to_art(container->wal_metrics, "pgmoneta_wal_summary_lag_bytes", data, NULL, NULL, 0);
+   free(data);
+   data = NULL;
    data = pgmoneta_append(data, "#HELP pgmoneta_workspace The disk space used for workspace for a server\n");
    data = pgmoneta_append(data, "#TYPE pgmoneta_workspace gauge\n");
    for (int i = 0; i < config->common.number_of_servers; i++)
@@ -28,6 +28,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <bandwidth.h>
 #include <extraction.h>
 #include <files.h>
 #include <logging.h>
@@ -83,7 +84,6 @@ static int restore_backup_incremental(struct art* nodes);
 
 static int carry_out_workflow(struct workflow* workflow, struct art* nodes);
 
-static void clear_manifest_incremental_entries(struct json* manifest);
 /**
  * Combine the provided backups or each of the user defined table-spaces
  * The function will be called for two rounds, the first round would construct the data directory
@@ -399,6 +399,8 @@ pgmoneta_restore(SSL* ssl, int client_fd, int server, uint8_t compression, uint8
 
    config = (struct main_configuration*)shmem;
 
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_RESTORE);
+
 #ifdef HAVE_FREEBSD
    clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
 #else
@@ -689,6 +691,7 @@ pgmoneta_restore(SSL* ssl, int client_fd, int server, uint8_t compression, uint8
 
    pgmoneta_disconnect(client_fd);
 
+   pgmoneta_bandwidth_end();
    pgmoneta_stop_logging();
 
    free(backup);
@@ -709,6 +712,7 @@ error:
 
    pgmoneta_disconnect(client_fd);
 
+   pgmoneta_bandwidth_end();
    pgmoneta_stop_logging();
 
    if (locked)
@@ -843,7 +847,7 @@ pgmoneta_restore_backup(struct art* nodes)
 }
 
 int
-pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, char* output_dir, struct deque* prior_labels, struct backup* bck, struct json* manifest, bool incremental, bool combine_as_is, struct art* nodes)
+pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, char* output_dir, struct deque* prior_labels, struct backup* bck, char* manifest, bool incremental, bool combine_as_is, struct art* nodes)
 {
    uint32_t tsoid = 0;
    char relative_tablespace_path[MAX_PATH];
@@ -909,16 +913,16 @@ pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, c
    memset(manifest_path, 0, MAX_PATH);
    pgmoneta_snprintf(manifest_path, MAX_PATH, "%s/backup_manifest", output_dir);
 
-   clear_manifest_incremental_entries(manifest);
-   files = (struct json*)pgmoneta_json_get(manifest, MANIFEST_FILES);
-   if (files == NULL)
+   // only the entries of reconstructed files are kept in memory,
+   // the rest of the manifest is streamed when it is written
+   if (pgmoneta_json_create(&files))
    {
       goto error;
    }
-
-   if (number_of_workers > 0)
+   files->type = JSONArray;
+   if (pgmoneta_deque_create(number_of_workers > 0, (struct deque**)&files->elements))
    {
-      pgmoneta_deque_set_thread_safe((struct deque*)files->elements);
+      goto error;
    }
 
    // It is actually ok even if we don't explicitly create the top level directory
@@ -1019,7 +1023,7 @@ pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, c
       }
    }
 
-   if (pgmoneta_write_postgresql_manifest(manifest, manifest_path))
+   if (pgmoneta_manifest_rewrite(manifest, files, pgmoneta_is_incremental_path, manifest_path))
    {
       pgmoneta_log_error("Fail to write manifest to %s", manifest_path);
       goto error;
@@ -1028,6 +1032,7 @@ pgmoneta_combine_backups(int server, char* label, char* base, char* input_dir, c
    pgmoneta_workers_destroy(workers);
    pgmoneta_art_destroy(backups);
    pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_json_destroy(files);
    free(server_dir);
    return 0;
 
@@ -1035,6 +1040,7 @@ error:
    pgmoneta_workers_destroy(workers);
    pgmoneta_art_destroy(backups);
    pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_json_destroy(files);
    free(server_dir);
    return 1;
 }
@@ -2413,38 +2419,6 @@ error:
    return 0;
 }
 
-static void
-clear_manifest_incremental_entries(struct json* manifest)
-{
-   struct json* files = NULL;
-   struct json* f = NULL;
-   char* path = NULL;
-   struct json_iterator* iter = NULL;
-   struct deque_iterator* diter = NULL;
-   if (manifest == NULL)
-   {
-      return;
-   }
-   files = (struct json*)pgmoneta_json_get(manifest, MANIFEST_FILES);
-   if (files == NULL)
-   {
-      return;
-   }
-   pgmoneta_json_iterator_create(files, &iter);
-   // a tiny hack to get the internal deque iterator of the json iterator
-   diter = (struct deque_iterator*)iter->iter;
-   while (pgmoneta_deque_iterator_next(diter))
-   {
-      f = (struct json*)pgmoneta_value_data(diter->value);
-      path = (char*)pgmoneta_json_get(f, "Path");
-      if (pgmoneta_is_incremental_path(path))
-      {
-         pgmoneta_deque_iterator_remove(diter);
-      }
-   }
-   pgmoneta_json_iterator_destroy(iter);
-}
-
 static int
 restore_backup_full(struct art* nodes)
 {
@@ -2594,7 +2568,6 @@ restore_backup_incremental(struct art* nodes)
    char tmp_excluded_file_path[MAX_PATH_CONCAT + sizeof(TMP_SUFFIX)];
    int excluded_files = 0;
    char* manifest_path = NULL;
-   struct json* manifest = NULL;
    struct workflow* workflow = NULL;
    struct main_configuration* config;
    uint64_t free_space = 0;
@@ -2631,12 +2604,13 @@ restore_backup_incremental(struct art* nodes)
 
    manifest_path = pgmoneta_get_server_backup_identifier_data(server, backup->label);
    manifest_path = pgmoneta_append(manifest_path, "backup_manifest");
-   // read the manifest for later usage
-   if (pgmoneta_json_read_file(manifest_path, &manifest))
+   // the manifest is streamed from disk when the combined one is written
+   if (!pgmoneta_exists(manifest_path))
    {
+      pgmoneta_log_error("restore_backup_incremental: missing manifest %s", manifest_path);
       goto error;
    }
-   pgmoneta_art_insert(nodes, NODE_MANIFEST, (uintptr_t)manifest, ValueJSON);
+   pgmoneta_art_insert(nodes, NODE_MANIFEST, (uintptr_t)manifest_path, ValueString);
 
    if (!pgmoneta_exists(target_root_combine))
    {
@@ -0,0 +1,759 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <art.h>
+#include <brt.h>
+#include <logging.h>
+#include <resume.h>
+#include <security.h>
+#include <server.h>
+#include <utils.h>
+#include <walfile/wal_summary.h>
+
+/* system */
+#include <errno.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int read_info(struct resume* resume);
+static int write_info(struct resume* resume);
+static int read_files(struct resume* resume);
+static int record_file(struct resume* resume, char* path, char* local, uint64_t size, char* sha256, bool reused);
+static void discard(struct resume* resume);
+static char* resume_path(struct resume* resume, char* name);
+
+int
+pgmoneta_resume_open(int srv, char* parent, struct resume** resume)
+{
+   char* old = NULL;
+   char* old_data = NULL;
+   char* old_info = NULL;
+   char* info = NULL;
+   struct resume* r = NULL;
+
+   *resume = NULL;
+
+   r = (struct resume*)malloc(sizeof(struct resume));
+   if (r == NULL)
+   {
+      goto error;
+   }
+
+   memset(r, 0, sizeof(struct resume));
+   r->server = srv;
+   pthread_mutex_init(&r->lock, NULL);
+
+   r->directory = pgmoneta_get_server(srv);
+   if (r->directory == NULL)
+   {
+      goto error;
+   }
+   r->directory = pgmoneta_append(r->directory, "resume/");
+   r->data = pgmoneta_append(r->data, r->directory);
+   r->data = pgmoneta_append(r->data, "data/");
+
+   if (pgmoneta_art_create(&r->files))
+   {
+      goto error;
+   }
+
+   info = resume_path(r, RESUME_INFO);
+   if (!pgmoneta_exists(info))
+   {
+      goto done;
+   }
+
+   if (read_info(r))
+   {
+      pgmoneta_log_warn("Resume: Unable to read %s", info);
+      discard(r);
+      goto done;
+   }
+
+   if (!pgmoneta_compare_string(r->parent, parent != NULL ? parent : ""))
+   {
+      pgmoneta_log_debug("Resume: Discarding %s, it was based on '%s'", r->label, r->parent);
+      discard(r);
+      goto done;
+   }
+
+   /* A crash leaves the files of the interrupted backup in its backup directory */
+   old = pgmoneta_get_server_backup_identifier(srv, r->label);
+   if (old != NULL && pgmoneta_exists(old))
+   {
+      old_info = pgmoneta_append(old_info, old);
+      old_info = pgmoneta_append(old_info, "backup.info");
+
+      if (pgmoneta_exists(old_info))
+      {
+         /* The backup got far enough to be saved, so it doesn't belong to us */
+         discard(r);
+         goto done;
+      }
+
+      old_data = pgmoneta_get_server_backup_identifier_data(srv, r->label);
+      if (pgmoneta_exists(old_data))
+      {
+         if (pgmoneta_exists(r->data))
+         {
+            pgmoneta_delete_directory(r->data);
+         }
+
+         if (rename(old_data, r->data))
+         {
+            pgmoneta_log_warn("Resume: Unable to move %s to %s (%s)", old_data, r->data, strerror(errno));
+            errno = 0;
+            discard(r);
+            goto done;
+         }
+      }
+
+      pgmoneta_delete_directory(old);
+   }
+
+   if (read_files(r))
+   {
+      pgmoneta_log_warn("Resume: Unable to read the files of %s", r->label);
+      discard(r);
+      goto done;
+   }
+
+   pgmoneta_log_info("Resume: %" PRIu64 " files of %s can be reused", r->number_of_files, r->label);
+
+done:
+
+   pgmoneta_snprintf(r->parent, sizeof(r->parent), "%s", parent != NULL ? parent : "");
+
+   free(old);
+   free(old_data);
+   free(old_info);
+   free(info);
+
+   *resume = r;
+
+   return 0;
+
+error:
+
+   free(old);
+   free(old_data);
+   free(old_info);
+   free(info);
+
+   if (r != NULL)
+   {
+      pgmoneta_art_destroy(r->files);
+      pthread_mutex_destroy(&r->lock);
+      free(r->directory);
+      free(r->data);
+      free(r);
+   }
+
+   return 1;
+}
+
+int
+pgmoneta_resume_start(struct resume* resume, char* label, uint64_t start_lsn, char* wal_dir)
+{
+   char* files = NULL;
+
+   if (resume == NULL)
+   {
+      return 1;
+   }
+
+   /* Changes since the interrupted backup started decide which relation forks are still valid */
+   if (resume->number_of_files > 0 && resume->start_lsn != 0 && start_lsn >= resume->start_lsn)
+   {
+      if (pgmoneta_wal_summary_collect(resume->server, wal_dir, resume->start_lsn, start_lsn, &resume->changed))
+      {
+         pgmoneta_log_warn("Resume: Unable to summarize the WAL since %s was started, only checksummed files are reused",
+                           resume->label);
+         pgmoneta_brt_destroy(resume->changed);
+         resume->changed = NULL;
+      }
+   }
+
+   pgmoneta_snprintf(resume->label, sizeof(resume->label), "%s", label);
+   resume->start_lsn = start_lsn;
+
+   if (pgmoneta_mkdir(resume->directory) || write_info(resume))
+   {
+      goto error;
+   }
+
+   files = resume_path(resume, RESUME_FILES);
+   if (pgmoneta_fopen_secure(files, "w", &resume->log))
+   {
+      pgmoneta_log_error("Resume: Could not open %s due to %s", files, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   free(files);
+
+   return 0;
+
+error:
+
+   free(files);
+
+   return 1;
+}
+
+int
+pgmoneta_resume_summary(struct resume* resume, uint64_t start_lsn, uint64_t end_lsn, block_ref_table** brt)
+{
+   char* f = NULL;
+   char* from = NULL;
+   char* to = NULL;
+   block_ref_table* summary = NULL;
+
+   *brt = NULL;
+
+   if (resume == NULL || resume->changed == NULL || resume->summary_start != start_lsn || resume->summary_end == 0)
+   {
+      return 1;
+   }
+
+   f = resume_path(resume, RESUME_BRT);
+
+   if (!pgmoneta_exists(f) || pgmoneta_brt_read(f, &summary))
+   {
+      goto error;
+   }
+
+   /* The saved summary ends where the interrupted backup started */
+   if (pgmoneta_brt_union(summary, resume->changed))
+   {
+      goto error;
+   }
+
+   from = pgmoneta_lsn_to_string(start_lsn);
+   to = pgmoneta_lsn_to_string(resume->summary_end);
+   pgmoneta_log_debug("Resume: Reusing the summary %s-%s of %s", from, to, resume->label);
+
+   if (pgmoneta_resume_summary_save(resume, start_lsn, end_lsn, summary))
+   {
+      goto error;
+   }
+
+   *brt = summary;
+
+   free(f);
+   free(from);
+   free(to);
+
+   return 0;
+
+error:
+
+   pgmoneta_brt_destroy(summary);
+   free(f);
+   free(from);
+   free(to);
+
+   return 1;
+}
+
+int
+pgmoneta_resume_summary_save(struct resume* resume, uint64_t start_lsn, uint64_t end_lsn, block_ref_table* brt)
+{
+   char* f = NULL;
+
+   if (resume == NULL)
+   {
+      return 1;
+   }
+
+   f = resume_path(resume, RESUME_BRT);
+
+   if (pgmoneta_brt_write(brt, f))
+   {
+      goto error;
+   }
+
+   resume->summary_start = start_lsn;
+   resume->summary_end = end_lsn;
+
+   if (write_info(resume))
+   {
+      goto error;
+   }
+
+   free(f);
+
+   return 0;
+
+error:
+
+   pgmoneta_log_warn("Resume: Unable to save the summary of %s", resume->label);
+   free(f);
+
+   return 1;
+}
+
+bool
+pgmoneta_resume_reuse(struct resume* resume, SSL* ssl, int socket, char* path,
+                      struct rel_file_locator* rlocator, enum fork_number frk, char* backup_data)
+{
+   bool reuse = false;
+   char* from = NULL;
+   char* to = NULL;
+   char* dir = NULL;
+   char* local_sha256 = NULL;
+   char* server_sha256 = NULL;
+   block_number limit_block = InvalidBlockNumber;
+   struct stat st;
+   struct resume_file* rf = NULL;
+
+   if (resume == NULL || resume->log == NULL)
+   {
+      return false;
+   }
+
+   rf = (struct resume_file*)pgmoneta_art_search(resume->files, path);
+   if (rf == NULL)
+   {
+      return false;
+   }
+
+   from = pgmoneta_append(from, resume->data);
+   from = pgmoneta_append(from, rf->local);
+
+   memset(&st, 0, sizeof(struct stat));
+   if (stat(from, &st) || (uint64_t)st.st_size != rf->size)
+   {
+      errno = 0;
+      goto done;
+   }
+
+   if (rlocator != NULL && resume->changed != NULL)
+   {
+      /* Every change of a relation fork is WAL-logged, so an unchanged fork is still valid */
+      reuse = pgmoneta_brt_get_entry(resume->changed, rlocator, frk, &limit_block) == NULL;
+   }
+   else if (rf->sha256[0] != '\0')
+   {
+      /* One byte more than the copy detects a file that has grown */
+      reuse = !pgmoneta_create_sha256_file(from, &local_sha256) &&
+              pgmoneta_compare_string(local_sha256, rf->sha256) &&
+              !pgmoneta_server_file_checksum(resume->server, ssl, socket, path, (int64_t)rf->size + 1, &server_sha256) &&
+              pgmoneta_compare_string(server_sha256, rf->sha256);
+   }
+
+   if (!reuse)
+   {
+      goto done;
+   }
+
+   to = pgmoneta_append(to, backup_data);
+   to = pgmoneta_append(to, rf->local);
+
+   dir = pgmoneta_append(dir, to);
+   if (pgmoneta_mkdir(dirname(dir)) || pgmoneta_move_file(from, to))
+   {
+      reuse = false;
+      goto done;
+   }
+
+   if (record_file(resume, path, rf->local, rf->size, rf->sha256, true))
+   {
+      reuse = false;
+      goto done;
+   }
+
+   pgmoneta_log_trace("Resume: Reusing %s", path);
+
+done:
+
+   free(from);
+   free(to);
+   free(dir);
+   free(local_sha256);
+   free(server_sha256);
+
+   return reuse;
+}
+
+int
+pgmoneta_resume_complete(struct resume* resume, char* path, char* local, bool checksum, char* backup_data)
+{
+   int ret = 1;
+   char* f = NULL;
+   char* sha256 = NULL;
+   struct stat st;
+
+   if (resume == NULL || resume->log == NULL)
+   {
+      return 0;
+   }
+
+   f = pgmoneta_append(f, backup_data);
+   f = pgmoneta_append(f, local);
+
+   memset(&st, 0, sizeof(struct stat));
+   if (stat(f, &st))
+   {
+      errno = 0;
+      goto done;
+   }
+
+   if (checksum && pgmoneta_create_sha256_file(f, &sha256))
+   {
+      goto done;
+   }
+
+   ret = record_file(resume, path, local, (uint64_t)st.st_size, sha256, false);
+
+done:
+
+   free(f);
+   free(sha256);
+
+   return ret;
+}
+
+void
+pgmoneta_resume_finish(struct resume* resume, bool success, char* backup_data)
+{
+   if (resume == NULL)
+   {
+      return;
+   }
+
+   if (resume->log != NULL)
+   {
+      fflush(resume->log);
+      fclose(resume->log);
+   }
+
+   if (success)
+   {
+      if (pgmoneta_exists(resume->directory))
+      {
+         pgmoneta_delete_directory(resume->directory);
+      }
+
+      if (resume->reused > 0)
+      {
+         pgmoneta_log_info("Resume: Reused %" PRIu64 " files", resume->reused);
+      }
+   }
+   else if (resume->log != NULL && backup_data != NULL && pgmoneta_exists(backup_data))
+   {
+      /* What is left of the interrupted backup has been replaced by the files of this one */
+      if (pgmoneta_exists(resume->data))
+      {
+         pgmoneta_delete_directory(resume->data);
+      }
+
+      if (rename(backup_data, resume->data))
+      {
+         pgmoneta_log_warn("Resume: Unable to keep %s (%s)", backup_data, strerror(errno));
+         errno = 0;
+      }
+      else
+      {
+         pgmoneta_log_info("Resume: Keeping the files of %s for the next backup", resume->label);
+      }
+   }
+
+   pgmoneta_art_destroy(resume->files);
+   pgmoneta_brt_destroy(resume->changed);
+   pthread_mutex_destroy(&resume->lock);
+   free(resume->directory);
+   free(resume->data);
+   free(resume);
+}
+
+static int
+read_info(struct resume* resume)
+{
+   char buffer[MAX_PATH];
+   char* f = NULL;
+   FILE* file = NULL;
+
+   f = resume_path(resume, RESUME_INFO);
+
+   file = fopen(f, "r");
+   if (file == NULL)
+   {
+      errno = 0;
+      goto error;
+   }
+
+   while (fgets(&buffer[0], sizeof(buffer), file) != NULL)
+   {
+      char* value = NULL;
+
+      buffer[strcspn(&buffer[0], "\n")] = '\0';
+
+      value = strchr(&buffer[0], '=');
+      if (value == NULL)
+      {
+         goto error;
+      }
+      *value++ = '\0';
+
+      if (pgmoneta_compare_string(RESUME_LABEL, &buffer[0]))
+      {
+         pgmoneta_snprintf(resume->label, sizeof(resume->label), "%s", value);
+      }
+      else if (pgmoneta_compare_string(RESUME_PARENT, &buffer[0]))
+      {
+         pgmoneta_snprintf(resume->parent, sizeof(resume->parent), "%s", value);
+      }
+      else if (pgmoneta_compare_string(RESUME_START_LSN, &buffer[0]))
+      {
+         resume->start_lsn = pgmoneta_string_to_lsn(value);
+      }
+      else if (pgmoneta_compare_string(RESUME_SUMMARY_START, &buffer[0]))
+      {
+         resume->summary_start = pgmoneta_string_to_lsn(value);
+      }
+      else if (pgmoneta_compare_string(RESUME_SUMMARY_END, &buffer[0]))
+      {
+         resume->summary_end = pgmoneta_string_to_lsn(value);
+      }
+   }
+
+   if (strlen(resume->label) == 0)
+   {
+      goto error;
+   }
+
+   fclose(file);
+   free(f);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(f);
+
+   return 1;
+}
+
+static int
+write_info(struct resume* resume)
+{
+   char* f = NULL;
+   char* start = NULL;
+   char* summary_start = NULL;
+   char* summary_end = NULL;
+   FILE* file = NULL;
+
+   f = resume_path(resume, RESUME_INFO);
+   start = pgmoneta_lsn_to_string(resume->start_lsn);
+   summary_start = pgmoneta_lsn_to_string(resume->summary_start);
+   summary_end = pgmoneta_lsn_to_string(resume->summary_end);
+
+   if (pgmoneta_fopen_secure(f, "w", &file))
+   {
+      pgmoneta_log_error("Resume: Could not open %s due to %s", f, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   fprintf(file, "%s=%s\n", RESUME_LABEL, resume->label);
+   fprintf(file, "%s=%s\n", RESUME_PARENT, resume->parent);
+   fprintf(file, "%s=%s\n", RESUME_START_LSN, start);
+   fprintf(file, "%s=%s\n", RESUME_SUMMARY_START, summary_start);
+   fprintf(file, "%s=%s\n", RESUME_SUMMARY_END, summary_end);
+
+   if (fflush(file) || fsync(fileno(file)))
+   {
+      goto error;
+   }
+
+   fclose(file);
+   free(f);
+   free(start);
+   free(summary_start);
+   free(summary_end);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(f);
+   free(start);
+   free(summary_start);
+   free(summary_end);
+
+   return 1;
+}
+
+static int
+read_files(struct resume* resume)
+{
+   char buffer[MAX_PATH * 2 + MISC_LENGTH];
+   char* f = NULL;
+   FILE* file = NULL;
+
+   f = resume_path(resume, RESUME_FILES);
+
+   file = fopen(f, "r");
+   if (file == NULL)
+   {
+      errno = 0;
+      free(f);
+      return 0;
+   }
+
+   /* size <TAB> sha256 <TAB> local <TAB> path, a torn last line is ignored */
+   while (fgets(&buffer[0], sizeof(buffer), file) != NULL)
+   {
+      char* size = NULL;
+      char* sha256 = NULL;
+      char* local = NULL;
+      char* path = NULL;
+      char* save = NULL;
+      struct resume_file* rf = NULL;
+
+      if (strchr(&buffer[0], '\n') == NULL)
+      {
+         break;
+      }
+      buffer[strcspn(&buffer[0], "\n")] = '\0';
+
+      size = strtok_r(&buffer[0], "\t", &save);
+      sha256 = strtok_r(NULL, "\t", &save);
+      local = strtok_r(NULL, "\t", &save);
+      path = strtok_r(NULL, "\t", &save);
+
+      if (size == NULL || sha256 == NULL || local == NULL || path == NULL)
+      {
+         break;
+      }
+
+      rf = (struct resume_file*)malloc(sizeof(struct resume_file));
+      if (rf == NULL)
+      {
+         goto error;
+      }
+
+      memset(rf, 0, sizeof(struct resume_file));
+      rf->size = strtoull(size, NULL, 10);
+      if (!pgmoneta_compare_string(sha256, "-"))
+      {
+         pgmoneta_snprintf(rf->sha256, sizeof(rf->sha256), "%s", sha256);
+      }
+      pgmoneta_snprintf(rf->local, sizeof(rf->local), "%s", local);
+
+      if (pgmoneta_art_insert(resume->files, path, (uintptr_t)rf, ValueMem))
+      {
+         free(rf);
+         goto error;
+      }
+
+      resume->number_of_files++;
+   }
+
+   fclose(file);
+   free(f);
+
+   return 0;
+
+error:
+
+   fclose(file);
+   free(f);
+
+   return 1;
+}
+
+static int
+record_file(struct resume* resume, char* path, char* local, uint64_t size, char* sha256, bool reused)
+{
+   int ret = 0;
+
+   pthread_mutex_lock(&resume->lock);
+
+   if (fprintf(resume->log, "%" PRIu64 "\t%s\t%s\t%s\n", size,
+               sha256 != NULL && strlen(sha256) > 0 ? sha256 : "-", local, path) < 0 ||
+       fflush(resume->log))
+   {
+      ret = 1;
+   }
+   else if (reused)
+   {
+      resume->reused++;
+   }
+
+   pthread_mutex_unlock(&resume->lock);
+
+   return ret;
+}
+
+static void
+discard(struct resume* resume)
+{
+   if (pgmoneta_exists(resume->directory))
+   {
+      pgmoneta_delete_directory(resume->directory);
+   }
+
+   pgmoneta_art_destroy(resume->files);
+   resume->files = NULL;
+   pgmoneta_art_create(&resume->files);
+
+   memset(resume->label, 0, sizeof(resume->label));
+   memset(resume->parent, 0, sizeof(resume->parent));
+   resume->start_lsn = 0;
+   resume->number_of_files = 0;
+   resume->summary_start = 0;
+   resume->summary_end = 0;
+}
+
+static char*
+resume_path(struct resume* resume, char* name)
+{
+   char* p = NULL;
+
+   p = pgmoneta_append(p, resume->directory);
+   p = pgmoneta_append(p, name);
+
+   return p;
+}
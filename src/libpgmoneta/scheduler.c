@@ -0,0 +1,508 @@
+﻿/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <json.h>
+#include <logging.h>
+#include <management.h>
+#include <network.h>
+#include <scheduler.h>
+#include <server.h>
+#include <utils.h>
+
+/* system */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define SCHEDULER_FILE "backup.queue"
+
+/* The queue lives in the main process, only the statistics are shared */
+static struct scheduler_job jobs[SCHEDULER_QUEUE_SIZE];
+static uint64_t sequence = 0;
+
+static struct scheduler_job* scheduler_slot(void);
+static dev_t scheduler_volume(int server);
+static bool scheduler_before(struct scheduler_job* a, struct scheduler_job* b);
+static char* scheduler_file(void);
+static void scheduler_save(void);
+
+int
+pgmoneta_scheduler_load(void)
+{
+   char* f = NULL;
+   char line[MAX_PATH];
+   char name[MISC_LENGTH];
+   char incremental[MISC_LENGTH];
+   int priority = 0;
+   long long queued = 0;
+   int server = -1;
+   FILE* file = NULL;
+   struct scheduler_job* job = NULL;
+   struct json* payload = NULL;
+   struct json* request = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   f = scheduler_file();
+   if (f == NULL)
+   {
+      goto error;
+   }
+
+   file = fopen(f, "r");
+   if (file == NULL)
+   {
+      free(f);
+      return 0;
+   }
+
+   memset(&line[0], 0, sizeof(line));
+   while (fgets(&line[0], sizeof(line), file) != NULL)
+   {
+      memset(&name[0], 0, sizeof(name));
+      memset(&incremental[0], 0, sizeof(incremental));
+
+      if (sscanf(&line[0], "%127s %d %lld %127s", &name[0], &priority, &queued, &incremental[0]) != 4)
+      {
+         continue;
+      }
+
+      server = -1;
+      for (int i = 0; server == -1 && i < config->common.number_of_servers; i++)
+      {
+         if (pgmoneta_compare_string(config->common.servers[i].name, &name[0]))
+         {
+            server = i;
+         }
+      }
+
+      if (server == -1)
+      {
+         pgmoneta_log_warn("Scheduler: Dropping the queued backup of unknown server %s", &name[0]);
+         continue;
+      }
+
+      if (pgmoneta_management_create_header(MANAGEMENT_BACKUP, MANAGEMENT_COMPRESSION_NONE, MANAGEMENT_ENCRYPTION_NONE,
+                                            MANAGEMENT_OUTPUT_FORMAT_JSON, &payload))
+      {
+         goto error;
+      }
+
+      if (pgmoneta_management_create_request(payload, &request))
+      {
+         goto error;
+      }
+
+      pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)config->common.servers[server].name, ValueString);
+      if (strcmp(&incremental[0], "-"))
+      {
+         pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)&incremental[0], ValueString);
+      }
+
+      job = scheduler_slot();
+      if (job == NULL)
+      {
+         pgmoneta_log_warn("Scheduler: Queue is full, dropping the queued backup of %s", &name[0]);
+         pgmoneta_json_destroy(payload);
+         payload = NULL;
+         break;
+      }
+
+      job->state = SCHEDULER_QUEUED;
+      job->server = server;
+      job->priority = priority;
+      job->client_fd = -1;
+      job->compression = MANAGEMENT_COMPRESSION_NONE;
+      job->encryption = MANAGEMENT_ENCRYPTION_NONE;
+      job->pid = -1;
+      job->volume = scheduler_volume(server);
+      job->sequence = sequence++;
+      job->queued = (time_t)queued;
+      job->payload = payload;
+      payload = NULL;
+
+      atomic_fetch_add(&config->common.servers[server].scheduler.queued, 1);
+
+      pgmoneta_log_info("Scheduler: Queued backup of %s from the previous run", &name[0]);
+   }
+
+   fclose(file);
+   free(f);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   pgmoneta_json_destroy(payload);
+   free(f);
+
+   return 1;
+}
+
+int
+pgmoneta_scheduler_enqueue(int server, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload)
+{
+   struct scheduler_job* job = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   job = scheduler_slot();
+   if (job == NULL)
+   {
+      return 1;
+   }
+
+   if (pgmoneta_json_clone(payload, &job->payload))
+   {
+      return 1;
+   }
+
+   job->state = SCHEDULER_QUEUED;
+   job->server = server;
+   job->priority = config->common.servers[server].backup_priority;
+   job->client_fd = client_fd;
+   job->compression = compression;
+   job->encryption = encryption;
+   job->pid = -1;
+   job->volume = scheduler_volume(server);
+   job->sequence = sequence++;
+   job->queued = time(NULL);
+
+   atomic_fetch_add(&config->common.servers[server].scheduler.queued, 1);
+
+   scheduler_save();
+
+   return 0;
+}
+
+struct scheduler_job*
+pgmoneta_scheduler_next(void)
+{
+   int running = 0;
+   int on_volume = 0;
+   bool busy = false;
+   struct scheduler_job* next = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+   {
+      if (jobs[i].state == SCHEDULER_RUNNING)
+      {
+         running++;
+      }
+   }
+
+   if (config->backup_max_concurrent > 0 && running >= config->backup_max_concurrent)
+   {
+      return NULL;
+   }
+
+   for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+   {
+      struct scheduler_job* job = &jobs[i];
+
+      if (job->state != SCHEDULER_QUEUED)
+      {
+         continue;
+      }
+
+      if (next != NULL && !scheduler_before(job, next))
+      {
+         continue;
+      }
+
+      /* One backup at a time for a server, and only when it is reachable */
+      if (atomic_load(&config->common.servers[job->server].repository) ||
+          !pgmoneta_server_is_online(job->server))
+      {
+         continue;
+      }
+
+      busy = false;
+      on_volume = 0;
+      for (int j = 0; !busy && j < SCHEDULER_QUEUE_SIZE; j++)
+      {
+         if (jobs[j].state != SCHEDULER_RUNNING)
+         {
+            continue;
+         }
+
+         if (jobs[j].server == job->server)
+         {
+            busy = true;
+         }
+         else if (jobs[j].volume == job->volume)
+         {
+            on_volume++;
+         }
+      }
+
+      if (busy || (config->backup_max_per_volume > 0 && on_volume >= config->backup_max_per_volume))
+      {
+         continue;
+      }
+
+      next = job;
+   }
+
+   return next;
+}
+
+void
+pgmoneta_scheduler_start(struct scheduler_job* job, pid_t pid)
+{
+   time_t now;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   now = time(NULL);
+
+   job->state = SCHEDULER_RUNNING;
+   job->pid = pid;
+
+   atomic_fetch_sub(&config->common.servers[job->server].scheduler.queued, 1);
+   atomic_fetch_add(&config->common.servers[job->server].scheduler.dispatched, 1);
+   atomic_fetch_add(&config->common.servers[job->server].scheduler.wait,
+                    (unsigned long long)(now > job->queued ? now - job->queued : 0));
+
+   pgmoneta_log_debug("Scheduler: Started backup of %s after %lld seconds (%d)",
+                      config->common.servers[job->server].name, (long long)(now - job->queued), pid);
+
+   /* The backup process answers the client */
+   if (job->client_fd != -1)
+   {
+      pgmoneta_disconnect(job->client_fd);
+      job->client_fd = -1;
+   }
+}
+
+void
+pgmoneta_scheduler_remove(struct scheduler_job* job)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (job->state == SCHEDULER_QUEUED)
+   {
+      atomic_fetch_sub(&config->common.servers[job->server].scheduler.queued, 1);
+   }
+
+   if (job->client_fd != -1)
+   {
+      pgmoneta_disconnect(job->client_fd);
+   }
+
+   pgmoneta_json_destroy(job->payload);
+
+   memset(job, 0, sizeof(struct scheduler_job));
+   job->client_fd = -1;
+
+   scheduler_save();
+}
+
+bool
+pgmoneta_scheduler_finish(pid_t pid)
+{
+   for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+   {
+      if (jobs[i].state == SCHEDULER_RUNNING && jobs[i].pid == pid)
+      {
+         pgmoneta_scheduler_remove(&jobs[i]);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void
+pgmoneta_scheduler_destroy(void)
+{
+   for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+   {
+      if (jobs[i].state == SCHEDULER_FREE)
+      {
+         continue;
+      }
+
+      if (jobs[i].client_fd != -1)
+      {
+         pgmoneta_disconnect(jobs[i].client_fd);
+      }
+
+      pgmoneta_json_destroy(jobs[i].payload);
+
+      memset(&jobs[i], 0, sizeof(struct scheduler_job));
+      jobs[i].client_fd = -1;
+   }
+}
+
+static struct scheduler_job*
+scheduler_slot(void)
+{
+   for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+   {
+      if (jobs[i].state == SCHEDULER_FREE)
+      {
+         return &jobs[i];
+      }
+   }
+
+   return NULL;
+}
+
+static dev_t
+scheduler_volume(int server)
+{
+   char* d = NULL;
+   struct stat st;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   memset(&st, 0, sizeof(struct stat));
+
+   d = pgmoneta_get_server_backup(server);
+   if (d == NULL || stat(d, &st))
+   {
+      stat(config->base_dir, &st);
+   }
+   free(d);
+
+   return st.st_dev;
+}
+
+static bool
+scheduler_before(struct scheduler_job* a, struct scheduler_job* b)
+{
+   if (a->priority != b->priority)
+   {
+      return a->priority > b->priority;
+   }
+
+   return a->sequence < b->sequence;
+}
+
+static char*
+scheduler_file(void)
+{
+   char* f = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   f = pgmoneta_append(f, config->base_dir);
+   if (!pgmoneta_ends_with(config->base_dir, "/"))
+   {
+      f = pgmoneta_append(f, "/");
+   }
+   f = pgmoneta_append(f, SCHEDULER_FILE);
+
+   return f;
+}
+
+static void
+scheduler_save(void)
+{
+   char* f = NULL;
+   char* tmp = NULL;
+   char* incremental = NULL;
+   struct json* request = NULL;
+   FILE* file = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   f = scheduler_file();
+   if (f == NULL)
+   {
+      goto error;
+   }
+
+   tmp = pgmoneta_append(tmp, f);
+   tmp = pgmoneta_append(tmp, ".tmp");
+
+   file = fopen(tmp, "w");
+   if (file == NULL)
+   {
+      pgmoneta_log_warn("Scheduler: Unable to write %s: %s", tmp, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   /* A running backup is queued again if pgmoneta stops before it completes */
+   for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+   {
+      if (jobs[i].state == SCHEDULER_FREE)
+      {
+         continue;
+      }
+
+      request = (struct json*)pgmoneta_json_get(jobs[i].payload, MANAGEMENT_CATEGORY_REQUEST);
+      incremental = (char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_BACKUP);
+
+      fprintf(file, "%s %d %lld %s\n", config->common.servers[jobs[i].server].name, jobs[i].priority,
+              (long long)jobs[i].queued, incremental != NULL && strlen(incremental) > 0 ? incremental : "-");
+   }
+
+   if (fclose(file) || rename(tmp, f))
+   {
+      file = NULL;
+      pgmoneta_log_warn("Scheduler: Unable to write %s: %s", f, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   free(tmp);
+   free(f);
+
+   return;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(tmp);
+   free(f);
+}
@@ -28,11 +28,14 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <bandwidth.h>
+#include <compression.h>
 #include <deque.h>
 #include <files.h>
 #include <http.h>
 #include <logging.h>
 #include <manifest.h>
+#include <memory.h>
 #include <progress.h>
 #include <security.h>
 #include <storage.h>
@@ -42,8 +45,16 @@
 
 /* system */
 #include <assert.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+/* Files larger than this are uploaded as staged blocks */
+#define AZURE_BLOCK_SIZE (8 * 1024 * 1024)
+
+/* The number of attempts for a block */
+#define AZURE_BLOCK_RETRIES 3
 
 static char* azure_storage_name(void);
 static int azure_storage_setup(char* name, struct art*);
@@ -59,11 +70,32 @@ struct azure_transfer_task
    char remote_path[MAX_PATH];
    char local_root[MAX_PATH];
    char local_path[MAX_PATH];
+   char copy_root[MAX_PATH];
+};
+
+struct azure_block_task
+{
+   struct worker_common common;
+   char local_path[MAX_PATH];
+   char azure_path[MAX_PATH];
+   int index;
+   off_t offset;
+   size_t length;
 };
 
-static int azure_upload_files(char* local_root, char* azure_root, int server, int compression, int encryption);
+static int azure_upload_files(char* local_root, char* azure_root, int server, int compression, int encryption,
+                              char* previous_root, struct art* previous_checksums);
 static int azure_send_upload_request(char* local_root, char* azure_root, char* relative_path);
-static int azure_add_request_headers(struct http_request* request, char* auth_value, char* utc_date);
+static int azure_send_put_request(char* azure_path, char* comp, char* block_id, char* copy_source,
+                                  char* content_type, void* data, size_t length);
+static int azure_send_copy_request(char* source_root, char* azure_root, char* relative_path);
+static int azure_add_request_headers(struct http_request* request, char* auth_value, char* utc_date, bool block_blob);
+static int azure_stage_file(char* local_root, char* relative_path, char* azure_root, size_t size,
+                            struct workers* workers, struct deque* staged);
+static int azure_put_block(struct azure_block_task* task);
+static void do_put_block(struct worker_common* wc);
+static int azure_put_block_list(char* azure_path, int number_of_blocks);
+static void azure_block_id(int index, char* id, size_t id_size);
 static void do_upload_file(struct worker_common* wc);
 static int azure_create_transfer_task(int server, char* azure_root, char* remote_path,
                                       char* local_root, char* local_path,
@@ -72,6 +104,8 @@ static int azure_upload_one_file(struct azure_transfer_task* task);
 
 static char* azure_get_host(void);
 static char* azure_get_basepath(int server, char* identifier);
+static char* azure_get_walpath(int server);
+static char* azure_get_url(char* azure_path);
 
 struct workflow*
 pgmoneta_storage_create_azure(void)
@@ -130,6 +164,9 @@ azure_storage_execute(char* name __attribute__((unused)), struct art* nodes)
    char* local_root = NULL;
    char* base_dir = NULL;
    char* azure_root = NULL;
+   char* previous_label = NULL;
+   char* previous_root = NULL;
+   struct art* previous_checksums = NULL;
    struct main_configuration* config;
    struct backup* temp_backup = NULL;
 
@@ -151,6 +188,8 @@ azure_storage_execute(char* name __attribute__((unused)), struct art* nodes)
    server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
    label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
 
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_TRANSFER);
+
    pgmoneta_log_debug("Azure storage engine (execute): %s/%s", config->common.servers[server].name, label);
 
    local_root = pgmoneta_get_server_backup_identifier(server, label);
@@ -163,7 +202,19 @@ azure_storage_execute(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   if (azure_upload_files(local_root, azure_root, server, temp_backup->compression, temp_backup->encryption))
+   if (pgmoneta_storage_previous_upload(server, label, STORAGE_ENGINE_AZURE, &previous_label, &previous_checksums))
+   {
+      pgmoneta_log_warn("Azure storage: unable to look up the previous upload for %s", label);
+   }
+
+   if (previous_label != NULL)
+   {
+      pgmoneta_log_debug("Azure storage: copying unchanged files from %s", previous_label);
+      previous_root = azure_get_basepath(server, previous_label);
+   }
+
+   if (azure_upload_files(local_root, azure_root, server, temp_backup->compression, temp_backup->encryption,
+                          previous_root, previous_checksums))
    {
       goto error;
    }
@@ -186,6 +237,11 @@ azure_storage_execute(char* name __attribute__((unused)), struct art* nodes)
    free(local_root);
    free(base_dir);
    free(azure_root);
+   free(previous_label);
+   free(previous_root);
+   pgmoneta_art_destroy(previous_checksums);
+
+   pgmoneta_bandwidth_end();
 
    return 0;
 
@@ -195,6 +251,11 @@ error:
    free(local_root);
    free(base_dir);
    free(azure_root);
+   free(previous_label);
+   free(previous_root);
+   pgmoneta_art_destroy(previous_checksums);
+
+   pgmoneta_bandwidth_end();
 
    return 1;
 }
@@ -280,12 +341,24 @@ error:
 static int
 azure_upload_one_file(struct azure_transfer_task* task)
 {
+   if (strlen(task->copy_root) > 0)
+   {
+      if (!azure_send_copy_request(task->copy_root, task->azure_root, task->remote_path))
+      {
+         goto done;
+      }
+
+      pgmoneta_log_debug("Azure copy: falling back to upload for %s", task->remote_path);
+   }
+
    if (azure_send_upload_request(task->local_root, task->azure_root, task->remote_path))
    {
       pgmoneta_log_error("Azure upload: failed %s", task->remote_path);
       return 1;
    }
 
+done:
+
    if (task->progress_enabled)
    {
       pgmoneta_progress_increment(task->server, 1);
@@ -313,6 +386,20 @@ static int azure_upload_metadata_files(char* local_root, char* azure_root);
 static int
 azure_upload_metadata_files(char* local_root, char* azure_root)
 {
+   char* dictionary_path = NULL;
+   bool dictionary;
+
+   /* The dictionary is needed to decompress the small files */
+   dictionary_path = pgmoneta_append(dictionary_path, local_root);
+   dictionary_path = pgmoneta_append(dictionary_path, COMPRESSION_DICTIONARY);
+   dictionary = pgmoneta_exists(dictionary_path);
+   free(dictionary_path);
+
+   if (dictionary && azure_send_upload_request(local_root, azure_root, COMPRESSION_DICTIONARY))
+   {
+      pgmoneta_log_error("Azure upload: failed to upload %s", COMPRESSION_DICTIONARY);
+      return 1;
+   }
    if (azure_send_upload_request(local_root, azure_root, "backup.manifest"))
    {
       pgmoneta_log_error("Azure upload: failed to upload backup.manifest");
@@ -333,9 +420,14 @@ azure_upload_metadata_files(char* local_root, char* azure_root)
 }
 
 static int
-azure_upload_files(char* local_root, char* azure_root, int server, int compression, int encryption)
+azure_upload_files(char* local_root, char* azure_root, int server, int compression, int encryption,
+                   char* previous_root, struct art* previous_checksums)
 {
    int number_of_workers = 0;
+   int copied = 0;
+   char* checksum = NULL;
+   char* previous_checksum = NULL;
+   bool unchanged = false;
    char* manifest_path = NULL;
    char* file_path = NULL;
    char* relative_file = NULL;
@@ -344,6 +436,8 @@ azure_upload_files(char* local_root, char* azure_root, int server, int compressi
    struct deque_iterator* iter = NULL;
    struct workers* workers = NULL;
    struct azure_transfer_task* task = NULL;
+   struct deque* staged = NULL;
+   struct deque_iterator* staged_iter = NULL;
 
    manifest_path = pgmoneta_append(manifest_path, local_root);
    manifest_path = pgmoneta_append(manifest_path, "backup.manifest");
@@ -368,6 +462,11 @@ azure_upload_files(char* local_root, char* azure_root, int server, int compressi
 
    pgmoneta_deque_iterator_create(paths, &iter);
 
+   if (pgmoneta_deque_create(false, &staged))
+   {
+      goto error;
+   }
+
    if (pgmoneta_is_progress_enabled(server))
    {
       pgmoneta_progress_set_total(server, pgmoneta_deque_size(paths));
@@ -388,6 +487,40 @@ azure_upload_files(char* local_root, char* azure_root, int server, int compressi
          relative_file = pgmoneta_append(relative_file, suffix);
       }
 
+      /* Unchanged since the previous upload, so let Azure copy the blob */
+      checksum = (char*)pgmoneta_value_data(iter->value);
+      unchanged = false;
+      if (previous_root != NULL && previous_checksums != NULL && checksum != NULL && strlen(checksum) > 0)
+      {
+         previous_checksum = (char*)pgmoneta_art_search(previous_checksums, file_path);
+         unchanged = previous_checksum != NULL && !strcmp(previous_checksum, checksum) &&
+                     strlen(previous_root) < MAX_PATH;
+      }
+
+      /* Large files are split into blocks, which the workers upload concurrently */
+      if (!unchanged)
+      {
+         char local_file[MAX_PATH];
+         struct stat st;
+
+         pgmoneta_snprintf(local_file, sizeof(local_file), "%s%s%s", local_root,
+                           pgmoneta_ends_with(local_root, "/") ? "" : "/", relative_file);
+
+         if (stat(local_file, &st) == 0 && st.st_size > AZURE_BLOCK_SIZE)
+         {
+            if (azure_stage_file(local_root, relative_file, azure_root, (size_t)st.st_size, workers, staged))
+            {
+               pgmoneta_log_error("Azure upload: failed to stage %s", relative_file);
+               free(relative_file);
+               goto error;
+            }
+
+            free(relative_file);
+            relative_file = NULL;
+            continue;
+         }
+      }
+
       if (azure_create_transfer_task(server, azure_root, relative_file, local_root, relative_file,
                                      workers, &task))
       {
@@ -396,6 +529,12 @@ azure_upload_files(char* local_root, char* azure_root, int server, int compressi
          goto error;
       }
 
+      if (unchanged)
+      {
+         pgmoneta_snprintf(task->copy_root, sizeof(task->copy_root), "%s", previous_root);
+         copied++;
+      }
+
       if (workers != NULL && pgmoneta_workers_outcome_ok(workers))
       {
          if (pgmoneta_workers_add(workers, do_upload_file, (struct worker_common*)task))
@@ -432,6 +571,31 @@ azure_upload_files(char* local_root, char* azure_root, int server, int compressi
       goto error;
    }
    pgmoneta_workers_destroy(workers);
+   workers = NULL;
+
+   /* Every block is in place, so commit the block lists */
+   pgmoneta_deque_iterator_create(staged, &staged_iter);
+   while (pgmoneta_deque_iterator_next(staged_iter))
+   {
+      if (azure_put_block_list(staged_iter->tag, (int)staged_iter->value->data))
+      {
+         goto error;
+      }
+
+      if (pgmoneta_is_progress_enabled(server))
+      {
+         pgmoneta_progress_increment(server, 1);
+      }
+   }
+   pgmoneta_deque_iterator_destroy(staged_iter);
+   staged_iter = NULL;
+   pgmoneta_deque_destroy(staged);
+   staged = NULL;
+
+   if (copied > 0)
+   {
+      pgmoneta_log_debug("Azure upload: %d of %d files copied server-side", copied, (int)pgmoneta_deque_size(paths));
+   }
 
    pgmoneta_deque_iterator_destroy(iter);
    pgmoneta_deque_destroy(paths);
@@ -453,6 +617,8 @@ error:
 
    pgmoneta_deque_iterator_destroy(iter);
    pgmoneta_deque_destroy(paths);
+   pgmoneta_deque_iterator_destroy(staged_iter);
+   pgmoneta_deque_destroy(staged);
    pgmoneta_workers_wait(workers);
    pgmoneta_workers_destroy(workers);
    free(manifest_path);
@@ -465,35 +631,11 @@ error:
 static int
 azure_send_upload_request(char* local_root, char* azure_root, char* relative_path)
 {
-   char utc_date[UTC_TIME_LENGTH];
-   char* string_to_sign = NULL;
-   char* signing_key = NULL;
-   char* base64_signature = NULL;
-   size_t base64_signature_length;
    char* local_path = NULL;
    char* azure_path = NULL;
-   char* azure_host = NULL;
-   char* auth_value = NULL;
-   unsigned char* signature_hmac = NULL;
-   int hmac_length = 0;
-   size_t signing_key_length = 0;
    FILE* file = NULL;
    struct stat file_info;
    void* file_data = NULL;
-   struct http* connection = NULL;
-   struct http_request* request = NULL;
-   struct http_response* response = NULL;
-   struct main_configuration* config;
-   char size_str[64];
-   char azure_put_path[MAX_PATH];
-
-   config = (struct main_configuration*)shmem;
-
-   if (strchr(config->azure_storage_account, ' ') != NULL)
-   {
-      pgmoneta_log_error("Azure storage account name contains spaces: '%s'. This is not allowed.", config->azure_storage_account);
-      goto error;
-   }
 
    local_path = pgmoneta_append(local_path, local_root);
    if (strlen(relative_path) > 0)
@@ -515,13 +657,6 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
       azure_path = pgmoneta_append(azure_path, relative_path);
    }
 
-   memset(&utc_date[0], 0, sizeof(utc_date));
-
-   if (pgmoneta_get_timestamp_UTC_format(utc_date))
-   {
-      goto error;
-   }
-
    if (pgmoneta_fopen_secure(local_path, "rb", &file))
    {
       goto error;
@@ -532,7 +667,7 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
       goto error;
    }
 
-   file_data = malloc(file_info.st_size);
+   file_data = pgmoneta_memory_buffer_acquire(file_info.st_size > 0 ? file_info.st_size : 1);
    if (file_data == NULL)
    {
       goto error;
@@ -546,18 +681,300 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
    fclose(file);
    file = NULL;
 
-   if (file_info.st_size == 0)
+   if (azure_send_put_request(azure_path, NULL, NULL, NULL, "application/octet-stream", file_data, file_info.st_size))
    {
-      string_to_sign = pgmoneta_append(string_to_sign, "PUT\n\n\n\n\napplication/octet-stream\n\n\n\n\n\n\nx-ms-blob-type:BlockBlob\nx-ms-date:");
+      pgmoneta_log_error("Failed to upload: %s to Azure path: %s", local_path, azure_path);
+      goto error;
    }
-   else
+
+   free(local_path);
+   free(azure_path);
+   pgmoneta_memory_buffer_release(file_data);
+
+   return 0;
+
+error:
+
+   free(local_path);
+   free(azure_path);
+   pgmoneta_memory_buffer_release(file_data);
+
+   if (file != NULL)
    {
-      string_to_sign = pgmoneta_append(string_to_sign, "PUT\n\n\n");
-      pgmoneta_snprintf(size_str, sizeof(size_str), "%ld", (long)file_info.st_size);
-      string_to_sign = pgmoneta_append(string_to_sign, size_str);
-      string_to_sign = pgmoneta_append(string_to_sign, "\n\napplication/octet-stream\n\n\n\n\n\n\nx-ms-blob-type:BlockBlob\nx-ms-date:");
+      fclose(file);
+   }
+
+   return 1;
+}
+
+static int
+azure_stage_file(char* local_root, char* relative_path, char* azure_root, size_t size,
+                 struct workers* workers, struct deque* staged)
+{
+   int number_of_blocks = 0;
+   char* azure_path = NULL;
+   struct azure_block_task* task = NULL;
+
+   azure_path = pgmoneta_append(azure_path, azure_root);
+   if (!pgmoneta_ends_with(azure_root, "/"))
+   {
+      azure_path = pgmoneta_append(azure_path, "/");
+   }
+   azure_path = pgmoneta_append(azure_path, relative_path);
+
+   number_of_blocks = (int)((size + AZURE_BLOCK_SIZE - 1) / AZURE_BLOCK_SIZE);
+
+   pgmoneta_log_debug("Azure upload: %s in %d blocks", azure_path, number_of_blocks);
+
+   for (int i = 0; i < number_of_blocks; i++)
+   {
+      task = (struct azure_block_task*)malloc(sizeof(struct azure_block_task));
+      if (task == NULL)
+      {
+         goto error;
+      }
+
+      memset(task, 0, sizeof(struct azure_block_task));
+      task->common.workers = workers;
+      pgmoneta_snprintf(task->local_path, sizeof(task->local_path), "%s%s%s", local_root,
+                        pgmoneta_ends_with(local_root, "/") ? "" : "/", relative_path);
+      pgmoneta_snprintf(task->azure_path, sizeof(task->azure_path), "%s", azure_path);
+      task->index = i;
+      task->offset = (off_t)i * AZURE_BLOCK_SIZE;
+      task->length = MIN((size_t)AZURE_BLOCK_SIZE, size - (size_t)task->offset);
+
+      if (workers != NULL)
+      {
+         if (!pgmoneta_workers_outcome_ok(workers))
+         {
+            goto error;
+         }
+
+         if (pgmoneta_workers_add(workers, do_put_block, (struct worker_common*)task))
+         {
+            goto error;
+         }
+         task = NULL;
+      }
+      else
+      {
+         int ret = azure_put_block(task);
+
+         free(task);
+         task = NULL;
+
+         if (ret)
+         {
+            goto error;
+         }
+      }
+   }
+
+   if (pgmoneta_deque_add(staged, azure_path, (uintptr_t)number_of_blocks, ValueInt32))
+   {
+      goto error;
+   }
+
+   free(azure_path);
+
+   return 0;
+
+error:
+
+   free(task);
+   free(azure_path);
+
+   return 1;
+}
+
+static int
+azure_put_block(struct azure_block_task* task)
+{
+   char block_id[16];
+   char* data = NULL;
+   int fd = -1;
+   ssize_t r = 0;
+   size_t done = 0;
+
+   data = (char*)pgmoneta_memory_buffer_acquire(task->length);
+   if (data == NULL)
+   {
+      goto error;
+   }
+
+   fd = open(task->local_path, O_RDONLY);
+   if (fd < 0)
+   {
+      goto error;
+   }
+
+   while (done < task->length)
+   {
+      r = pread(fd, data + done, task->length - done, task->offset + (off_t)done);
+      if (r <= 0)
+      {
+         goto error;
+      }
+      done += (size_t)r;
+   }
+
+   close(fd);
+   fd = -1;
+
+   azure_block_id(task->index, &block_id[0], sizeof(block_id));
+
+   /* A failed block is sent again on its own */
+   for (int attempt = 1; attempt <= AZURE_BLOCK_RETRIES; attempt++)
+   {
+      if (!azure_send_put_request(task->azure_path, "block", &block_id[0], NULL, "application/octet-stream", data, task->length))
+      {
+         pgmoneta_memory_buffer_release(data);
+         return 0;
+      }
+
+      pgmoneta_log_warn("Azure upload: block %d of %s failed (attempt %d/%d)",
+                        task->index, task->azure_path, attempt, AZURE_BLOCK_RETRIES);
+
+      if (attempt < AZURE_BLOCK_RETRIES)
+      {
+         sleep(attempt);
+      }
+   }
+
+error:
+
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+
+   pgmoneta_memory_buffer_release(data);
+
+   return 1;
+}
+
+static void
+do_put_block(struct worker_common* wc)
+{
+   struct azure_block_task* task = (struct azure_block_task*)wc;
+
+   if (azure_put_block(task))
+   {
+      pgmoneta_record_failure(task->common.workers != NULL ? task->common.workers->outcome : NULL,
+                              "Azure upload failed: block %d of %s", task->index, task->azure_path);
+   }
+
+   free(task);
+}
+
+static int
+azure_put_block_list(char* azure_path, int number_of_blocks)
+{
+   char block_id[16];
+   char* xml = NULL;
+
+   xml = pgmoneta_append(xml, "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>");
+   for (int i = 0; i < number_of_blocks; i++)
+   {
+      azure_block_id(i, &block_id[0], sizeof(block_id));
+
+      xml = pgmoneta_append(xml, "<Latest>");
+      xml = pgmoneta_append(xml, &block_id[0]);
+      xml = pgmoneta_append(xml, "</Latest>");
+   }
+   xml = pgmoneta_append(xml, "</BlockList>");
+
+   if (azure_send_put_request(azure_path, "blocklist", NULL, NULL, "application/xml", xml, strlen(xml)))
+   {
+      pgmoneta_log_error("Azure upload: failed to commit the block list of %s", azure_path);
+      free(xml);
+      return 1;
+   }
+
+   free(xml);
+
+   return 0;
+}
+
+static void
+azure_block_id(int index, char* id, size_t id_size)
+{
+   char raw[8];
+   char* encoded = NULL;
+   size_t encoded_length = 0;
+
+   /* All block ids of a blob must have the same length. Six digits encode to
+    * eight base64 characters without padding, so they are safe in a query */
+   pgmoneta_snprintf(raw, sizeof(raw), "%06d", index);
+
+   memset(id, 0, id_size);
+
+   if (!pgmoneta_base64_encode(raw, 6, &encoded, &encoded_length))
+   {
+      pgmoneta_snprintf(id, id_size, "%s", encoded);
+   }
+
+   free(encoded);
+}
+
+static int
+azure_send_put_request(char* azure_path, char* comp, char* block_id, char* copy_source,
+                       char* content_type, void* data, size_t length)
+{
+   char utc_date[UTC_TIME_LENGTH];
+   char* string_to_sign = NULL;
+   char* signing_key = NULL;
+   char* base64_signature = NULL;
+   size_t base64_signature_length;
+   char* azure_host = NULL;
+   char* auth_value = NULL;
+   unsigned char* signature_hmac = NULL;
+   int hmac_length = 0;
+   size_t signing_key_length = 0;
+   char* copy_status = NULL;
+   bool block_blob = (comp == NULL && copy_source == NULL);
+   struct http* connection = NULL;
+   struct http_request* request = NULL;
+   struct http_response* response = NULL;
+   struct main_configuration* config;
+   char size_str[64];
+   char azure_put_path[MAX_PATH];
+
+   config = (struct main_configuration*)shmem;
+
+   if (strchr(config->azure_storage_account, ' ') != NULL)
+   {
+      pgmoneta_log_error("Azure storage account name contains spaces: '%s'. This is not allowed.", config->azure_storage_account);
+      goto error;
+   }
+
+   memset(&utc_date[0], 0, sizeof(utc_date));
+
+   if (pgmoneta_get_timestamp_UTC_format(utc_date))
+   {
+      goto error;
    }
 
+   string_to_sign = pgmoneta_append(string_to_sign, "PUT\n\n\n");
+   if (length > 0)
+   {
+      pgmoneta_snprintf(size_str, sizeof(size_str), "%ld", (long)length);
+      string_to_sign = pgmoneta_append(string_to_sign, size_str);
+   }
+   string_to_sign = pgmoneta_append(string_to_sign, "\n\n");
+   string_to_sign = pgmoneta_append(string_to_sign, content_type);
+   string_to_sign = pgmoneta_append(string_to_sign, "\n\n\n\n\n\n\n");
+   if (block_blob)
+   {
+      string_to_sign = pgmoneta_append(string_to_sign, "x-ms-blob-type:BlockBlob\n");
+   }
+   if (copy_source != NULL)
+   {
+      string_to_sign = pgmoneta_append(string_to_sign, "x-ms-copy-source:");
+      string_to_sign = pgmoneta_append(string_to_sign, copy_source);
+      string_to_sign = pgmoneta_append(string_to_sign, "\n");
+   }
+   string_to_sign = pgmoneta_append(string_to_sign, "x-ms-date:");
    string_to_sign = pgmoneta_append(string_to_sign, utc_date);
    string_to_sign = pgmoneta_append(string_to_sign, "\nx-ms-version:2021-08-06\n/");
    string_to_sign = pgmoneta_append(string_to_sign, config->azure_storage_account);
@@ -573,6 +990,18 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
    string_to_sign = pgmoneta_append(string_to_sign, "/");
    string_to_sign = pgmoneta_append(string_to_sign, azure_path);
 
+   /* Query parameters are part of the canonical resource, sorted by name */
+   if (block_id != NULL)
+   {
+      string_to_sign = pgmoneta_append(string_to_sign, "\nblockid:");
+      string_to_sign = pgmoneta_append(string_to_sign, block_id);
+   }
+   if (comp != NULL)
+   {
+      string_to_sign = pgmoneta_append(string_to_sign, "\ncomp:");
+      string_to_sign = pgmoneta_append(string_to_sign, comp);
+   }
+
    if (pgmoneta_base64_decode(config->azure_shared_key, strlen(config->azure_shared_key), (void**)&signing_key, &signing_key_length))
    {
       goto error;
@@ -608,13 +1037,17 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
 
       if (use_endpoint)
       {
-         pgmoneta_snprintf(azure_put_path, sizeof(azure_put_path), "/%s/%s/%s",
-                           config->azure_storage_account, config->azure_container, azure_path);
+         pgmoneta_snprintf(azure_put_path, sizeof(azure_put_path), "/%s/%s/%s%s%s%s%s",
+                           config->azure_storage_account, config->azure_container, azure_path,
+                           comp != NULL ? "?comp=" : "", comp != NULL ? comp : "",
+                           block_id != NULL ? "&blockid=" : "", block_id != NULL ? block_id : "");
       }
       else
       {
-         pgmoneta_snprintf(azure_put_path, sizeof(azure_put_path), "/%s/%s",
-                           config->azure_container, azure_path);
+         pgmoneta_snprintf(azure_put_path, sizeof(azure_put_path), "/%s/%s%s%s%s%s",
+                           config->azure_container, azure_path,
+                           comp != NULL ? "?comp=" : "", comp != NULL ? comp : "",
+                           block_id != NULL ? "&blockid=" : "", block_id != NULL ? block_id : "");
       }
    }
 
@@ -623,57 +1056,79 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
       goto error;
    }
 
-   if (azure_add_request_headers(request, auth_value, utc_date))
+   if (azure_add_request_headers(request, auth_value, utc_date, block_blob))
+   {
+      goto error;
+   }
+
+   if (copy_source != NULL && pgmoneta_http_request_add_header(request, "x-ms-copy-source", copy_source))
    {
       goto error;
    }
 
-   if (pgmoneta_http_request_add_header(request, "Content-Type", "application/octet-stream"))
+   if (pgmoneta_http_request_add_header(request, "Content-Type", content_type))
    {
       goto error;
    }
 
-   if (pgmoneta_http_set_data(request, file_data, file_info.st_size))
+   if (pgmoneta_http_set_data(request, data, length))
    {
       goto error;
    }
 
    if (pgmoneta_http_invoke(connection, request, &response))
    {
-      pgmoneta_log_error("Failed to execute HTTP PUT request for %s", local_path);
+      pgmoneta_log_error("Failed to execute HTTP PUT request for %s", azure_path);
       goto error;
    }
 
-   if (response->status_code >= 200 && response->status_code < 300)
+   if (copy_source != NULL)
    {
-      char* azure_url = NULL;
-      azure_url = pgmoneta_append(azure_url, "https://");
-      azure_url = pgmoneta_append(azure_url, azure_host);
-      azure_url = pgmoneta_append(azure_url, "/");
-      azure_url = pgmoneta_append(azure_url, config->azure_container);
-      azure_url = pgmoneta_append(azure_url, "/");
-      azure_url = pgmoneta_append(azure_url, azure_path);
+      /* A copy inside the account normally completes before the response, anything else is retried as an upload */
+      copy_status = pgmoneta_http_get_response_header(response, "x-ms-copy-status");
 
-      pgmoneta_log_info("Successfully uploaded file to URL: %s", azure_url);
-      free(azure_url);
+      if (response->status_code < 200 || response->status_code >= 300 ||
+          copy_status == NULL || !pgmoneta_compare_string(copy_status, "success"))
+      {
+         pgmoneta_log_debug("Azure copy failed with status code: %d (%s). Failed to copy: %s to Azure path: %s",
+                            response->status_code, copy_status != NULL ? copy_status : "none",
+                            copy_source, azure_path);
+         goto error;
+      }
+
+      pgmoneta_log_debug("Successfully copied %s to Azure path: %s", copy_source, azure_path);
+   }
+   else if (response->status_code >= 200 && response->status_code < 300)
+   {
+      if (comp == NULL || pgmoneta_compare_string(comp, "blocklist"))
+      {
+         char* azure_url = NULL;
+         azure_url = pgmoneta_append(azure_url, "https://");
+         azure_url = pgmoneta_append(azure_url, azure_host);
+         azure_url = pgmoneta_append(azure_url, "/");
+         azure_url = pgmoneta_append(azure_url, config->azure_container);
+         azure_url = pgmoneta_append(azure_url, "/");
+         azure_url = pgmoneta_append(azure_url, azure_path);
+
+         pgmoneta_log_info("Successfully uploaded file to URL: %s", azure_url);
+         free(azure_url);
+      }
    }
    else
    {
-      pgmoneta_log_error("Azure upload failed with status code: %d. Failed to upload: %s to Azure path: %s. Azure container: %s, host: %s",
-                         response->status_code, local_path, azure_path,
+      pgmoneta_log_error("Azure upload failed with status code: %d. Azure path: %s%s%s. Azure container: %s, host: %s",
+                         response->status_code, azure_path,
+                         comp != NULL ? "?comp=" : "", comp != NULL ? comp : "",
                          config->azure_container, azure_host);
       goto error;
    }
 
-   free(local_path);
-   free(azure_path);
    free(azure_host);
    free(base64_signature);
    free(signature_hmac);
    free(string_to_sign);
    free(auth_value);
    free(signing_key);
-   free(file_data);
 
    pgmoneta_http_request_destroy(request);
    pgmoneta_http_response_destroy(response);
@@ -683,72 +1138,102 @@ azure_send_upload_request(char* local_root, char* azure_root, char* relative_pat
 
 error:
 
-   if (local_path != NULL)
-   {
-      free(local_path);
-   }
+   free(azure_host);
+   free(signing_key);
+   free(base64_signature);
+   free(signature_hmac);
+   free(string_to_sign);
+   free(auth_value);
 
-   if (azure_path != NULL)
+   if (connection != NULL)
    {
-      free(azure_path);
+      pgmoneta_http_destroy(connection);
    }
 
-   if (azure_host != NULL)
+   if (request != NULL)
    {
-      free(azure_host);
+      pgmoneta_http_request_destroy(request);
    }
 
-   if (signing_key != NULL)
+   if (response != NULL)
    {
-      free(signing_key);
+      pgmoneta_http_response_destroy(response);
    }
 
-   if (base64_signature != NULL)
-   {
-      free(base64_signature);
-   }
+   return 1;
+}
 
-   if (signature_hmac != NULL)
-   {
-      free(signature_hmac);
-   }
+static int
+azure_send_copy_request(char* source_root, char* azure_root, char* relative_path)
+{
+   char* source_path = NULL;
+   char* azure_path = NULL;
+   char* copy_source = NULL;
+   int ret;
 
-   if (string_to_sign != NULL)
+   source_path = pgmoneta_append(source_path, source_root);
+   if (!pgmoneta_ends_with(source_root, "/"))
    {
-      free(string_to_sign);
+      source_path = pgmoneta_append(source_path, "/");
    }
+   source_path = pgmoneta_append(source_path, relative_path);
 
-   if (auth_value != NULL)
+   azure_path = pgmoneta_append(azure_path, azure_root);
+   if (!pgmoneta_ends_with(azure_root, "/"))
    {
-      free(auth_value);
+      azure_path = pgmoneta_append(azure_path, "/");
    }
+   azure_path = pgmoneta_append(azure_path, relative_path);
 
-   if (file_data != NULL)
-   {
-      free(file_data);
-   }
+   copy_source = azure_get_url(source_path);
 
-   if (connection != NULL)
-   {
-      pgmoneta_http_destroy(connection);
-   }
+   ret = azure_send_put_request(azure_path, NULL, NULL, copy_source, "application/octet-stream", NULL, 0);
 
-   if (request != NULL)
-   {
-      pgmoneta_http_request_destroy(request);
-   }
+   free(source_path);
+   free(azure_path);
+   free(copy_source);
 
-   if (response != NULL)
+   return ret;
+}
+
+static char*
+azure_get_url(char* azure_path)
+{
+   char* url = NULL;
+   char* host = NULL;
+   char port[16];
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   host = azure_get_host();
+
+   if (strlen(config->azure_endpoint) > 0)
    {
-      pgmoneta_http_response_destroy(response);
+      url = pgmoneta_append(url, config->azure_use_tls ? "https://" : "http://");
+      url = pgmoneta_append(url, host);
+      if (config->azure_port > 0)
+      {
+         pgmoneta_snprintf(port, sizeof(port), ":%d", config->azure_port);
+         url = pgmoneta_append(url, port);
+      }
+      url = pgmoneta_append(url, "/");
+      url = pgmoneta_append(url, config->azure_storage_account);
    }
-
-   if (file != NULL)
+   else
    {
-      fclose(file);
+      url = pgmoneta_append(url, "https://");
+      url = pgmoneta_append(url, host);
    }
 
-   return 1;
+   url = pgmoneta_append(url, "/");
+   url = pgmoneta_append(url, config->azure_container);
+   url = pgmoneta_append(url, "/");
+   url = pgmoneta_append(url, azure_path);
+
+   free(host);
+
+   return url;
 }
 
 static char*
@@ -792,15 +1277,34 @@ azure_get_basepath(int server, char* identifier)
    return d;
 }
 
+static char*
+azure_get_walpath(int server)
+{
+   char* d = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   d = pgmoneta_append(d, config->azure_base_dir);
+   if (!pgmoneta_ends_with(config->azure_base_dir, "/"))
+   {
+      d = pgmoneta_append(d, "/");
+   }
+   d = pgmoneta_append(d, config->common.servers[server].name);
+   d = pgmoneta_append(d, "/wal/");
+
+   return d;
+}
+
 static int
-azure_add_request_headers(struct http_request* request, char* auth_value, char* utc_date)
+azure_add_request_headers(struct http_request* request, char* auth_value, char* utc_date, bool block_blob)
 {
    if (pgmoneta_http_request_add_header(request, "Authorization", auth_value))
    {
       return 1;
    }
 
-   if (pgmoneta_http_request_add_header(request, "x-ms-blob-type", "BlockBlob"))
+   if (block_blob && pgmoneta_http_request_add_header(request, "x-ms-blob-type", "BlockBlob"))
    {
       return 1;
    }
@@ -818,19 +1322,46 @@ azure_add_request_headers(struct http_request* request, char* auth_value, char*
    return 0;
 }
 
+int
+azure_upload_wal(int server, char* directory, char* file)
+{
+   char* azure_root = NULL;
+   int rc;
+
+   azure_root = azure_get_walpath(server);
+
+   rc = azure_send_upload_request(directory, azure_root, file);
+
+   free(azure_root);
+   return rc;
+}
+
 int
 azure_upload(int server, char* label, int compression __attribute__((unused)), int encryption __attribute__((unused)))
 {
    char* local_root = NULL;
    char* azure_root = NULL;
+   char* previous_label = NULL;
+   char* previous_root = NULL;
+   struct art* previous_checksums = NULL;
    int rc;
 
    local_root = pgmoneta_get_server_backup_identifier(server, label);
    azure_root = azure_get_basepath(server, label);
 
-   rc = azure_upload_files(local_root, azure_root, server, compression, encryption);
+   if (!pgmoneta_storage_previous_upload(server, label, STORAGE_ENGINE_AZURE, &previous_label, &previous_checksums) &&
+       previous_label != NULL)
+   {
+      previous_root = azure_get_basepath(server, previous_label);
+   }
+
+   rc = azure_upload_files(local_root, azure_root, server, compression, encryption,
+                           previous_root, previous_checksums);
 
    free(local_root);
    free(azure_root);
+   free(previous_label);
+   free(previous_root);
+   pgmoneta_art_destroy(previous_checksums);
    return rc;
 }
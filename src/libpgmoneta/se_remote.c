@@ -33,6 +33,7 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <bandwidth.h>
 #include <info.h>
 #include <logging.h>
 #include <shmem.h>
@@ -109,7 +110,9 @@ backend_task(struct worker_common* wc)
 
    pgmoneta_log_debug("remote_upload: %s started", t->engine->name);
 
+   pgmoneta_bandwidth_begin(t->server, BANDWIDTH_TRANSFER);
    t->result = t->engine->upload(t->server, t->label, t->compression, t->encryption);
+   pgmoneta_bandwidth_end();
 
 #ifdef HAVE_FREEBSD
    clock_gettime(CLOCK_MONOTONIC_FAST, &end);
@@ -28,6 +28,8 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <bandwidth.h>
+#include <compression.h>
 #include <deque.h>
 #include <files.h>
 #include <http.h>
@@ -54,6 +56,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* The limit of keys in one multi-object delete request */
+#define S3_MAX_DELETE_KEYS 1000
+
 static char* s3_backup_name(void);
 static char* s3_restore_name(void);
 static char* s3_cleanup_name(void);
@@ -65,10 +70,13 @@ static int s3_storage_list(char*, struct art*);
 static int s3_storage_teardown(char*, struct art*);
 static int s3_storage_noop_teardown(char*, struct art*);
 static int s3_storage_cleanup(char*, struct art*);
-static int s3_upload_files(char* local_root, char* s3_root, int server, int compression, int encryption);
+static int s3_upload_files(char* local_root, char* s3_root, int server, int compression, int encryption,
+                           char* previous_root, struct art* previous_checksums);
 static int s3_bootstrap(char* s3_root, int server, char* local_root);
 static int s3_download_files(char* s3_root, char* local_root, int server, int compression, int encryption);
+static int s3_download_dictionary(char* s3_root, int server, char* local_root);
 static int s3_send_upload_request(char* local_root, char* s3_root, char* relative_path, char* file_sha512, int server);
+static int s3_send_copy_request(char* source_root, char* s3_root, char* relative_path, int server);
 static int s3_list_objects(char* relative_path, char* s3_list, int server, bool common_prefixes, struct deque** objects);
 static int s3_delete_all_objects(char* relative_path, char* s3_list, int server, struct art*);
 static int s3_send_list_request(char* relative_path, char* s3_list, int server, char* continuationToken, bool common_prefixes, struct http_response** response);
@@ -87,7 +95,9 @@ static int s3_sign_request(char* method, char* canonical_uri, char* query_string
 static int s3_apply_signed_headers(struct http_request* request, struct deque* headers, char* auth_value);
 
 static char* s3_get_host(int server);
+static char* s3_get_server_root(int server);
 static char* s3_get_basepath(int server, char* identifier);
+static char* s3_get_walpath(int server);
 static char* s3_url_encode(char* str);
 static char* s3_label_from_common_prefix(char* prefix);
 static int xml_parse_s3_delete_result(char* xml, bool* has_fatal_error);
@@ -107,6 +117,18 @@ struct s3_transfer_task
    char local_root[MAX_PATH];
    char local_path[MAX_PATH];
    char file_sha512[MISC_LENGTH];
+   char copy_root[MAX_PATH];
+};
+
+struct s3_delete_task
+{
+   struct worker_common common;
+   int server;
+   bool progress_enabled;
+   char s3_root[MAX_PATH];
+   char relative_path[MAX_PATH];
+   char* xml;
+   int64_t keys;
 };
 
 struct s3_download_file_context
@@ -130,6 +152,8 @@ static int s3_create_transfer_task(int server, char* s3_root, char* remote_path,
 static int s3_upload_one_file(struct s3_transfer_task* task);
 static int s3_download_one_file(struct s3_transfer_task* task);
 static size_t s3_download_write_cb(void* buffer, size_t size, void* userdata);
+static int s3_delete_objects(struct s3_delete_task* task);
+static void do_delete_objects(struct worker_common* wc);
 static size_t s3_upload_read_cb(void* buffer, size_t size, void* userdata);
 
 struct workflow*
@@ -416,6 +440,9 @@ s3_storage_execute(char* name __attribute__((unused)), struct art* nodes)
    char* local_root = NULL;
    char* base_dir = NULL;
    char* s3_root = NULL;
+   char* previous_label = NULL;
+   char* previous_root = NULL;
+   struct art* previous_checksums = NULL;
    struct main_configuration* config;
    struct backup* temp_backup = NULL;
 #ifdef HAVE_FREEBSD
@@ -436,6 +463,8 @@ s3_storage_execute(char* name __attribute__((unused)), struct art* nodes)
    server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
    label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
 
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_TRANSFER);
+
    pgmoneta_log_debug("S3 storage engine (execute): %s/%s",
                       config->common.servers[server].name, label);
    pgmoneta_log_debug("S3 effective config: bucket=%s, region=%s, endpoint=%s",
@@ -453,7 +482,19 @@ s3_storage_execute(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   if (s3_upload_files(local_root, s3_root, server, temp_backup->compression, temp_backup->encryption))
+   if (pgmoneta_storage_previous_upload(server, label, STORAGE_ENGINE_S3, &previous_label, &previous_checksums))
+   {
+      pgmoneta_log_warn("S3 storage: unable to look up the previous upload for %s", label);
+   }
+
+   if (previous_label != NULL)
+   {
+      pgmoneta_log_debug("S3 storage: copying unchanged files from %s", previous_label);
+      previous_root = s3_get_basepath(server, previous_label);
+   }
+
+   if (s3_upload_files(local_root, s3_root, server, temp_backup->compression, temp_backup->encryption,
+                       previous_root, previous_checksums))
    {
       goto error;
    }
@@ -477,6 +518,11 @@ s3_storage_execute(char* name __attribute__((unused)), struct art* nodes)
    free(local_root);
    free(base_dir);
    free(s3_root);
+   free(previous_label);
+   free(previous_root);
+   pgmoneta_art_destroy(previous_checksums);
+
+   pgmoneta_bandwidth_end();
 
    return 0;
 
@@ -485,6 +531,11 @@ error:
    free(local_root);
    free(base_dir);
    free(s3_root);
+   free(previous_label);
+   free(previous_root);
+   pgmoneta_art_destroy(previous_checksums);
+
+   pgmoneta_bandwidth_end();
 
    return 1;
 }
@@ -859,6 +910,11 @@ s3_storage_restore(char* name __attribute__((unused)), struct art* nodes)
 
    pgmoneta_log_debug("S3 restore: compression=%d encryption=%d", backup->compression, backup->encryption);
 
+   if (s3_download_dictionary(s3_root, server, local_root))
+   {
+      goto error;
+   }
+
    if (s3_download_files(s3_root, local_root, server, backup->compression, backup->encryption))
    {
       goto error;
@@ -1134,6 +1190,61 @@ error:
    return 1;
 }
 
+static int
+s3_download_dictionary(char* s3_root, int server, char* local_root)
+{
+   char* path = NULL;
+   struct http_response* response = NULL;
+
+   if (s3_send_get_request(COMPRESSION_DICTIONARY, s3_root, server, -1, -1, &response))
+   {
+      pgmoneta_log_error("S3 restore: failed to GET %s", COMPRESSION_DICTIONARY);
+      goto error;
+   }
+
+   /* Only backups compressed with a dictionary have one */
+   if (response->status_code == 404)
+   {
+      goto done;
+   }
+
+   if (response->status_code != 200)
+   {
+      pgmoneta_log_error("S3 restore: %s returned status %d", COMPRESSION_DICTIONARY, response->status_code);
+      goto error;
+   }
+
+   path = pgmoneta_append(path, local_root);
+   path = pgmoneta_append(path, COMPRESSION_DICTIONARY);
+
+   if (pgmoneta_exists(path))
+   {
+      pgmoneta_delete_file(path, NULL);
+   }
+
+   if (pgmoneta_append_file_chunk(path, response->payload.data, response->payload.data_size, 0))
+   {
+      pgmoneta_log_error("S3 restore: failed to write %s", path);
+      goto error;
+   }
+
+   pgmoneta_log_debug("S3 restore: downloaded %s", COMPRESSION_DICTIONARY);
+
+done:
+
+   pgmoneta_http_response_destroy(response);
+   free(path);
+
+   return 0;
+
+error:
+
+   pgmoneta_http_response_destroy(response);
+   free(path);
+
+   return 1;
+}
+
 static int
 s3_download_files(char* s3_root, char* local_root, int server, int compression, int encryption)
 {
@@ -1481,6 +1592,16 @@ s3_upload_read_cb(void* buffer, size_t size, void* userdata)
 static int
 s3_upload_one_file(struct s3_transfer_task* task)
 {
+   if (strlen(task->copy_root) > 0)
+   {
+      if (!s3_send_copy_request(task->copy_root, task->s3_root, task->remote_path, task->server))
+      {
+         goto done;
+      }
+
+      pgmoneta_log_debug("S3 copy: falling back to upload for %s", task->remote_path);
+   }
+
    if (s3_send_upload_request(task->local_root, task->s3_root, task->remote_path,
                               strlen(task->file_sha512) > 0 ? task->file_sha512 : NULL, task->server))
    {
@@ -1488,6 +1609,8 @@ s3_upload_one_file(struct s3_transfer_task* task)
       return 1;
    }
 
+done:
+
    if (task->progress_enabled)
    {
       pgmoneta_progress_increment(task->server, 1);
@@ -1510,10 +1633,15 @@ do_upload_file(struct worker_common* wc)
 }
 
 static int
-s3_upload_files(char* local_root, char* s3_root, int server, int compression, int encryption)
+s3_upload_files(char* local_root, char* s3_root, int server, int compression, int encryption,
+                char* previous_root, struct art* previous_checksums)
 {
    int number_of_workers = 0;
+   int copied = 0;
+   char* checksum = NULL;
+   char* previous_checksum = NULL;
    char* manifest_path = NULL;
+   char* dictionary_path = NULL;
    char* file_path = NULL;
    char* relative_file = NULL;
    char* suffix = NULL;
@@ -1565,14 +1693,29 @@ s3_upload_files(char* local_root, char* s3_root, int server, int compression, in
          relative_file = pgmoneta_append(relative_file, suffix);
       }
 
+      checksum = (char*)pgmoneta_value_data(iter->value);
+
       if (s3_create_transfer_task(server, s3_root, relative_file, local_root, relative_file,
-                                  (char*)iter->cur->data, workers, &task))
+                                  checksum, workers, &task))
       {
          pgmoneta_log_error("S3 upload: failed to create transfer task");
          free(relative_file);
          goto error;
       }
 
+      /* Unchanged since the previous upload, so let S3 copy the object */
+      if (previous_root != NULL && previous_checksums != NULL && checksum != NULL && strlen(checksum) > 0)
+      {
+         previous_checksum = (char*)pgmoneta_art_search(previous_checksums, file_path);
+
+         if (previous_checksum != NULL && !strcmp(previous_checksum, checksum) &&
+             strlen(previous_root) < MAX_PATH)
+         {
+            pgmoneta_snprintf(task->copy_root, sizeof(task->copy_root), "%s", previous_root);
+            copied++;
+         }
+      }
+
       if (workers != NULL && pgmoneta_workers_outcome_ok(workers))
       {
          if (pgmoneta_workers_add(workers, do_upload_file, (struct worker_common*)task))
@@ -1610,11 +1753,27 @@ s3_upload_files(char* local_root, char* s3_root, int server, int compression, in
    }
    pgmoneta_workers_destroy(workers);
 
+   if (copied > 0)
+   {
+      pgmoneta_log_debug("S3 upload: %d of %d files copied server-side", copied, (int)pgmoneta_deque_size(paths));
+   }
+
    pgmoneta_deque_iterator_destroy(iter);
    pgmoneta_deque_destroy(paths);
    iter = NULL;
    paths = NULL;
 
+   /* The dictionary is needed to decompress the small files */
+   dictionary_path = pgmoneta_append(dictionary_path, local_root);
+   dictionary_path = pgmoneta_append(dictionary_path, COMPRESSION_DICTIONARY);
+
+   if (pgmoneta_exists(dictionary_path) &&
+       s3_send_upload_request(local_root, s3_root, COMPRESSION_DICTIONARY, NULL, server))
+   {
+      pgmoneta_log_error("S3 upload: failed to upload %s", COMPRESSION_DICTIONARY);
+      goto error;
+   }
+
    /* upload metadata file last (commit marker) */
    // no needs to compute the sha512 for metadata files
    if (s3_send_upload_request(local_root, s3_root, "backup.manifest", NULL, server))
@@ -1633,6 +1792,7 @@ s3_upload_files(char* local_root, char* s3_root, int server, int compression, in
       goto error;
    }
    free(manifest_path);
+   free(dictionary_path);
    free(suffix);
 
    return 0;
@@ -1644,6 +1804,7 @@ error:
    pgmoneta_workers_wait(workers);
    pgmoneta_workers_destroy(workers);
    free(manifest_path);
+   free(dictionary_path);
    free(suffix);
    free(task);
 
@@ -1760,15 +1921,30 @@ static int
 s3_delete_all_objects(char* relative_path, char* s3_root, int server, struct art* nodes)
 {
    struct http_response* list_response = NULL;
-   struct http_response* delete_response = NULL;
    struct deque* objects = NULL;
+   struct workers* workers = NULL;
+   struct s3_delete_task* task = NULL;
    char* continuation_token = NULL;
-   char* delete_xml = NULL;
    bool is_truncated = true;
-   int64_t deleted_objects = 0;
+   bool progress_enabled = pgmoneta_is_progress_enabled(server);
+   int number_of_workers = 0;
+   int64_t queued_objects = 0;
 
    (void)nodes;
 
+   if (strlen(relative_path) >= MAX_PATH || strlen(s3_root) >= MAX_PATH)
+   {
+      goto error;
+   }
+
+   /* Each page of the listing becomes multi-object delete requests of at most
+    * S3_MAX_DELETE_KEYS keys, sent on the workers while the listing continues */
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
    while (is_truncated)
    {
       // we set the common prefixes flag to false to avoid the dir scan
@@ -1793,57 +1969,126 @@ s3_delete_all_objects(char* relative_path, char* s3_root, int server, struct art
       pgmoneta_http_response_destroy(list_response);
       list_response = NULL;
 
-      if (objects != NULL && pgmoneta_deque_size(objects) > 0)
+      while (objects != NULL && pgmoneta_deque_size(objects) > 0)
       {
-         size_t sample_size = pgmoneta_deque_size(objects);
+         size_t batch = MIN((size_t)pgmoneta_deque_size(objects), (size_t)S3_MAX_DELETE_KEYS);
 
-         if (pgmoneta_is_progress_enabled(server))
+         task = (struct s3_delete_task*)malloc(sizeof(struct s3_delete_task));
+         if (task == NULL)
          {
-            pgmoneta_progress_set_total(server, deleted_objects + (int64_t)sample_size + (is_truncated ? 1 : 0));
+            goto error;
          }
 
-         if (xml_s3_build_delete_list(&delete_xml, objects, sample_size))
+         memset(task, 0, sizeof(struct s3_delete_task));
+         task->common.workers = workers;
+         task->server = server;
+         task->progress_enabled = progress_enabled;
+         task->keys = (int64_t)batch;
+         memcpy(task->s3_root, s3_root, strlen(s3_root));
+         memcpy(task->relative_path, relative_path, strlen(relative_path));
+
+         if (xml_s3_build_delete_list(&task->xml, objects, batch))
          {
             goto error;
          }
 
-         pgmoneta_deque_destroy(objects);
-         objects = NULL;
-
-         if (s3_send_delete_request(relative_path, s3_root, server, delete_xml, &delete_response))
+         queued_objects += (int64_t)batch;
+         if (progress_enabled)
          {
-            goto error;
+            pgmoneta_progress_set_total(server, queued_objects + (is_truncated ? 1 : 0));
          }
-         pgmoneta_http_response_destroy(delete_response);
-         delete_response = NULL;
 
-         deleted_objects += (int64_t)sample_size;
-         if (pgmoneta_is_progress_enabled(server))
+         if (workers != NULL)
          {
-            pgmoneta_progress_update_done(server, deleted_objects);
+            if (!pgmoneta_workers_outcome_ok(workers))
+            {
+               goto error;
+            }
+
+            if (pgmoneta_workers_add(workers, do_delete_objects, (struct worker_common*)task))
+            {
+               goto error;
+            }
+            task = NULL;
          }
+         else
+         {
+            int ret = s3_delete_objects(task);
 
-         free(delete_xml);
-         delete_xml = NULL;
-      }
-      else
-      {
-         pgmoneta_deque_destroy(objects);
-         objects = NULL;
+            task = NULL;
+            if (ret)
+            {
+               goto error;
+            }
+         }
       }
+
+      pgmoneta_deque_destroy(objects);
+      objects = NULL;
    }
 
+   pgmoneta_workers_wait(workers);
+   if (workers != NULL && !pgmoneta_workers_outcome_ok(workers))
+   {
+      goto error;
+   }
+
+   pgmoneta_workers_destroy(workers);
    free(continuation_token);
+
    return 0;
 
 error:
+   if (task != NULL)
+   {
+      free(task->xml);
+      free(task);
+   }
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
    pgmoneta_http_response_destroy(list_response);
-   pgmoneta_http_response_destroy(delete_response);
    pgmoneta_deque_destroy(objects);
-   free(delete_xml);
    free(continuation_token);
    return 1;
 }
+
+static int
+s3_delete_objects(struct s3_delete_task* task)
+{
+   struct http_response* response = NULL;
+   int ret = 0;
+
+   if (s3_send_delete_request(task->relative_path, task->s3_root, task->server, task->xml, &response))
+   {
+      ret = 1;
+   }
+   else if (task->progress_enabled)
+   {
+      pgmoneta_progress_increment(task->server, task->keys);
+   }
+
+   pgmoneta_http_response_destroy(response);
+   free(task->xml);
+   free(task);
+
+   return ret;
+}
+
+static void
+do_delete_objects(struct worker_common* wc)
+{
+   struct s3_delete_task* task = (struct s3_delete_task*)wc;
+   struct workers* workers = task->common.workers;
+   char path[MAX_PATH];
+
+   memcpy(path, task->relative_path, sizeof(path));
+
+   if (s3_delete_objects(task))
+   {
+      pgmoneta_record_failure(workers != NULL ? workers->outcome : NULL, "S3 delete failed: %s", path);
+   }
+}
+
 static int
 s3_build_signing_key(char* secret_access_key, char* short_date, char* region,
                      unsigned char** signing_key, int* signing_key_length)
@@ -2815,6 +3060,189 @@ error:
    return 1;
 }
 
+static int
+s3_send_copy_request(char* source_root, char* s3_root, char* relative_path, int server)
+{
+   char short_date[SHORT_TIME_LENGTH];
+   char long_date[LONG_TIME_LENGTH];
+   char* auth_value = NULL;
+   char* s3_host = NULL;
+   char* s3_path = NULL;
+   char* copy_source = NULL;
+   char* request_path = NULL;
+   char* body_hash = NULL;
+   char* canonical_uri = NULL;
+   struct deque* sign_headers = NULL;
+   struct http* connection = NULL;
+   struct http_request* request = NULL;
+   struct http_response* response = NULL;
+   int s3_port;
+   bool use_tls;
+
+   char* effective_endpoint = s3_get_effective_endpoint(server);
+   char* effective_region = s3_get_effective_region(server);
+   char* effective_access_key_id = s3_get_effective_access_key_id(server);
+   char* effective_secret_access_key = s3_get_effective_secret_access_key(server);
+   char* effective_bucket = s3_get_effective_bucket(server);
+   int effective_port = s3_get_effective_port(server);
+   bool effective_use_tls = s3_get_effective_use_tls(server);
+   char* effective_storage_class = s3_get_effective_storage_class(server);
+
+   bool use_storage_class = strlen(effective_storage_class) > 0 && strlen(effective_endpoint) == 0;
+
+   s3_path = pgmoneta_append(s3_path, s3_root);
+   if (!pgmoneta_ends_with(s3_root, "/"))
+   {
+      s3_path = pgmoneta_append(s3_path, "/");
+   }
+   s3_path = pgmoneta_append(s3_path, relative_path);
+
+   /* The copy source is always /<bucket>/<key>, the base path only holds the bucket for a custom endpoint */
+   copy_source = pgmoneta_append(copy_source, "/");
+   if (strlen(effective_endpoint) == 0)
+   {
+      copy_source = pgmoneta_append(copy_source, effective_bucket);
+      copy_source = pgmoneta_append(copy_source, "/");
+   }
+   copy_source = pgmoneta_append(copy_source, source_root);
+   if (!pgmoneta_ends_with(source_root, "/"))
+   {
+      copy_source = pgmoneta_append(copy_source, "/");
+   }
+   copy_source = pgmoneta_append(copy_source, relative_path);
+
+   memset(&short_date[0], 0, sizeof(short_date));
+   memset(&long_date[0], 0, sizeof(long_date));
+
+   if (pgmoneta_get_timestamp_ISO8601_format(short_date, long_date))
+   {
+      goto error;
+   }
+
+   s3_host = s3_get_host(server);
+
+   if (pgmoneta_generate_string_sha256_hash("", &body_hash))
+   {
+      goto error;
+   }
+
+   canonical_uri = pgmoneta_append(canonical_uri, "/");
+   canonical_uri = pgmoneta_append(canonical_uri, s3_path);
+
+   if (pgmoneta_deque_create(false, &sign_headers))
+   {
+      goto error;
+   }
+   pgmoneta_deque_add(sign_headers, "host", (uintptr_t)s3_host, ValueStringRef);
+   pgmoneta_deque_add(sign_headers, "x-amz-content-sha256", (uintptr_t)body_hash, ValueStringRef);
+   pgmoneta_deque_add(sign_headers, "x-amz-copy-source", (uintptr_t)copy_source, ValueStringRef);
+   pgmoneta_deque_add(sign_headers, "x-amz-date", (uintptr_t)long_date, ValueStringRef);
+
+   if (use_storage_class)
+   {
+      pgmoneta_deque_add(sign_headers, "x-amz-storage-class", (uintptr_t)effective_storage_class, ValueStringRef);
+   }
+
+   if (s3_sign_request("PUT", canonical_uri, NULL,
+                       sign_headers, body_hash,
+                       effective_access_key_id, effective_secret_access_key, effective_region,
+                       short_date, long_date, &auth_value))
+   {
+      goto error;
+   }
+
+   if (effective_port != 0)
+   {
+      s3_port = effective_port;
+   }
+   else
+   {
+      s3_port = effective_use_tls ? 443 : 80;
+   }
+
+   use_tls = effective_use_tls;
+   if (s3_port == 443)
+   {
+      use_tls = true;
+   }
+
+   if (pgmoneta_http_create(s3_host, s3_port, use_tls, &connection))
+   {
+      goto error;
+   }
+
+   request_path = pgmoneta_append(request_path, "/");
+   request_path = pgmoneta_append(request_path, s3_path);
+
+   if (pgmoneta_http_request_create(PGMONETA_HTTP_PUT, request_path, &request))
+   {
+      goto error;
+   }
+
+   if (s3_apply_signed_headers(request, sign_headers, auth_value))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_http_invoke(connection, request, &response))
+   {
+      goto error;
+   }
+
+   /* CopyObject may report a failure in the body of a 200 response */
+   if (response->status_code < 200 || response->status_code >= 300 ||
+       (response->payload.data != NULL && strstr((char*)response->payload.data, "<Error>") != NULL))
+   {
+      pgmoneta_log_debug("S3 copy failed with status code: %d. Failed to copy: %s to S3 path: %s",
+                         response->status_code, copy_source, s3_path);
+      goto error;
+   }
+
+   pgmoneta_log_debug("Successfully copied %s to URL: https://%s/%s", copy_source, s3_host, s3_path);
+
+   free(s3_host);
+   free(s3_path);
+   free(copy_source);
+   free(request_path);
+   free(body_hash);
+   free(auth_value);
+   free(canonical_uri);
+   pgmoneta_deque_destroy(sign_headers);
+   pgmoneta_http_request_destroy(request);
+   pgmoneta_http_response_destroy(response);
+   pgmoneta_http_destroy(connection);
+
+   return 0;
+
+error:
+
+   free(s3_host);
+   free(s3_path);
+   free(copy_source);
+   free(request_path);
+   free(body_hash);
+   free(auth_value);
+   free(canonical_uri);
+   pgmoneta_deque_destroy(sign_headers);
+
+   if (request != NULL)
+   {
+      pgmoneta_http_request_destroy(request);
+   }
+
+   if (response != NULL)
+   {
+      pgmoneta_http_response_destroy(response);
+   }
+
+   if (connection != NULL)
+   {
+      pgmoneta_http_destroy(connection);
+   }
+
+   return 1;
+}
+
 static char*
 s3_get_host(int server)
 {
@@ -2852,7 +3280,7 @@ s3_get_host(int server)
 }
 
 static char*
-s3_get_basepath(int server, char* identifier)
+s3_get_server_root(int server)
 {
    char* d = NULL;
    struct main_configuration* config;
@@ -2882,7 +3310,18 @@ s3_get_basepath(int server, char* identifier)
    }
 
    d = pgmoneta_append(d, config->common.servers[server].name);
-   d = pgmoneta_append(d, "/backup/");
+   d = pgmoneta_append(d, "/");
+
+   return d;
+}
+
+static char*
+s3_get_basepath(int server, char* identifier)
+{
+   char* d = NULL;
+
+   d = s3_get_server_root(server);
+   d = pgmoneta_append(d, "backup/");
    if (identifier != NULL)
    {
       d = pgmoneta_append(d, identifier);
@@ -2890,6 +3329,17 @@ s3_get_basepath(int server, char* identifier)
    return d;
 }
 
+static char*
+s3_get_walpath(int server)
+{
+   char* d = NULL;
+
+   d = s3_get_server_root(server);
+   d = pgmoneta_append(d, "wal/");
+
+   return d;
+}
+
 static char*
 s3_url_encode(char* str)
 {
@@ -3245,20 +3695,47 @@ s3_label_from_common_prefix(char* prefix)
    return copy;
 }
 
+int
+s3_upload_wal(int server, char* directory, char* file)
+{
+   char* s3_root = NULL;
+   int rc;
+
+   s3_root = s3_get_walpath(server);
+
+   rc = s3_send_upload_request(directory, s3_root, file, NULL, server);
+
+   free(s3_root);
+   return rc;
+}
+
 int
 s3_upload(int server, char* label, int compression, int encryption)
 {
    char* local_root = NULL;
    char* s3_root = NULL;
+   char* previous_label = NULL;
+   char* previous_root = NULL;
+   struct art* previous_checksums = NULL;
    int rc;
 
    local_root = pgmoneta_get_server_backup_identifier(server, label);
    s3_root = s3_get_basepath(server, label);
 
-   rc = s3_upload_files(local_root, s3_root, server, compression, encryption);
+   if (!pgmoneta_storage_previous_upload(server, label, STORAGE_ENGINE_S3, &previous_label, &previous_checksums) &&
+       previous_label != NULL)
+   {
+      previous_root = s3_get_basepath(server, previous_label);
+   }
+
+   rc = s3_upload_files(local_root, s3_root, server, compression, encryption,
+                        previous_root, previous_checksums);
 
    free(local_root);
    free(s3_root);
+   free(previous_label);
+   free(previous_root);
+   pgmoneta_art_destroy(previous_checksums);
    return rc;
 }
 
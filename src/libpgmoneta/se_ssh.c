@@ -31,10 +31,14 @@
 /* pgmoneta */
 #include <pgmoneta.h>
 #include <backup.h>
+#include <bandwidth.h>
+#include <compression.h>
 #include <logging.h>
+#include <memory.h>
 #include <security.h>
 #include <storage.h>
 #include <utils.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
@@ -44,6 +48,37 @@
 #include <fcntl.h>
 #include <libssh/libssh.h>
 #include <libssh/sftp.h>
+#include <pthread.h>
+
+/* The size of the reads from a local file */
+#define SFTP_BUFFER_SIZE (1024 * 1024)
+
+/* The largest write request that every SFTP server accepts */
+#define SFTP_WRITE_SIZE 32768
+
+/* The number of outstanding write requests for a file */
+#define SFTP_MAX_REQUESTS 64
+
+/** @struct sftp_connection
+ * Defines an SSH session with its SFTP channel
+ */
+struct sftp_connection
+{
+   ssh_session session; /**< The SSH session */
+   sftp_session sftp;   /**< The SFTP session */
+   bool busy;           /**< Is the connection in use */
+};
+
+/** @struct sftp_task
+ * Defines the upload of a file
+ */
+struct sftp_task
+{
+   struct worker_common common;   /**< The common base */
+   char local_root[MAX_PATH];     /**< The local root */
+   char remote_root[MAX_PATH];    /**< The remote root */
+   char relative_path[MAX_PATH];  /**< The path relative to the roots */
+};
 
 static char* ssh_storage_name(void);
 static int ssh_storage_setup(char*, struct art*);
@@ -57,11 +92,19 @@ static char* get_remote_server_backup(int server);
 static char* get_remote_server_backup_identifier(int server, char* identifier);
 static char* get_remote_server_wal(int server);
 
-static int read_latest_backup_sha256(char* path);
+static int read_backup_sha256(char* path, struct art* map);
+
+static int ssh_connect_server(ssh_session* ssh, sftp_session* sf);
+static int sftp_connections_create(int number);
+static struct sftp_connection* sftp_connection_acquire(void);
+static void sftp_connection_release(struct sftp_connection* connection);
+static void sftp_connections_destroy(void);
 
 static int sftp_make_directory(char* local_dir, char* remote_dir);
-static int sftp_copy_directory(char* local_root, char* remote_root, char* relative_path);
-static int sftp_copy_file(char* local_root, char* remote_root, char* relative_path);
+static int sftp_copy_directory(char* local_root, char* remote_root, char* relative_path, struct workers* workers);
+static int sftp_copy_file(struct sftp_connection* connection, char* local_root, char* remote_root, char* relative_path);
+static int sftp_write_file(struct sftp_connection* connection, FILE* sfile, sftp_file dfile);
+static void do_sftp_copy(struct worker_common* wc);
 static int sftp_wal_prepare(sftp_file* file, int segsize);
 static bool sftp_exists(char* path);
 static int sftp_get_file_size(char* file_path, size_t* file_size);
@@ -71,6 +114,13 @@ static ssh_session session = NULL;
 static sftp_session sftp = NULL;
 
 static struct art* tree_map = NULL;
+static struct art* current_map = NULL;
+
+static struct sftp_connection main_connection = {0};
+static struct sftp_connection* connections = NULL;
+static int number_of_connections = 0;
+static pthread_mutex_t connections_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t connections_cond = PTHREAD_COND_INITIALIZER;
 
 static bool is_error = false;
 
@@ -120,14 +170,6 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
 {
    int server = -1;
    char* label = NULL;
-   ssh_key srv_pubkey = NULL;
-   ssh_key client_pubkey = NULL;
-   ssh_key client_privkey = NULL;
-   char* hexa = NULL;
-   unsigned char* srv_pubkey_hash = NULL;
-   size_t hash_length;
-   int rc;
-   enum ssh_known_hosts_e state;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
@@ -144,39 +186,80 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
    pgmoneta_log_debug("SSH storage engine (setup): %s/%s", config->common.servers[server].name,
                       label != NULL ? label : "(wal)");
 
-   session = ssh_new();
+   if (ssh_connect_server(&session, &sftp))
+   {
+      goto error;
+   }
+
+   main_connection.session = session;
+   main_connection.sftp = sftp;
+
+   is_error = false;
+
+   return 0;
 
-   if (session == NULL)
+error:
+
+   is_error = true;
+
+   session = NULL;
+   sftp = NULL;
+
+   return 1;
+}
+
+static int
+ssh_connect_server(ssh_session* ssh, sftp_session* sf)
+{
+   ssh_session s = NULL;
+   sftp_session f = NULL;
+   ssh_key srv_pubkey = NULL;
+   ssh_key client_pubkey = NULL;
+   ssh_key client_privkey = NULL;
+   unsigned char* srv_pubkey_hash = NULL;
+   size_t hash_length;
+   int rc;
+   enum ssh_known_hosts_e state;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *ssh = NULL;
+   *sf = NULL;
+
+   s = ssh_new();
+
+   if (s == NULL)
    {
       goto error;
    }
 
-   ssh_options_set(session, SSH_OPTIONS_USER, config->ssh_username);
-   ssh_options_set(session, SSH_OPTIONS_HOST, config->ssh_hostname);
+   ssh_options_set(s, SSH_OPTIONS_USER, config->ssh_username);
+   ssh_options_set(s, SSH_OPTIONS_HOST, config->ssh_hostname);
    if (config->ssh_port > 0)
    {
       unsigned int port = (unsigned int)config->ssh_port;
-      ssh_options_set(session, SSH_OPTIONS_PORT, &port);
+      ssh_options_set(s, SSH_OPTIONS_PORT, &port);
    }
 
    if (strlen(config->ssh_ciphers) == 0)
    {
-      ssh_options_set(session, SSH_OPTIONS_CIPHERS_C_S, "aes256-ctr,aes192-ctr,aes128-ctr");
+      ssh_options_set(s, SSH_OPTIONS_CIPHERS_C_S, "aes256-ctr,aes192-ctr,aes128-ctr");
    }
    else
    {
-      ssh_options_set(session, SSH_OPTIONS_CIPHERS_C_S, config->ssh_ciphers);
+      ssh_options_set(s, SSH_OPTIONS_CIPHERS_C_S, config->ssh_ciphers);
    }
 
-   rc = ssh_connect(session);
+   rc = ssh_connect(s);
    if (rc != SSH_OK)
    {
       pgmoneta_log_error("Remote Backup: Error connecting to %s: %s",
-                         config->ssh_hostname, ssh_get_error(session));
+                         config->ssh_hostname, ssh_get_error(s));
       goto error;
    }
 
-   rc = ssh_get_server_publickey(session, &srv_pubkey);
+   rc = ssh_get_server_publickey(s, &srv_pubkey);
    if (rc < 0)
    {
       goto error;
@@ -189,7 +272,7 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   state = ssh_session_is_known_server(session);
+   state = ssh_session_is_known_server(s);
    switch (state)
    {
       case SSH_KNOWN_HOSTS_OK:
@@ -204,7 +287,7 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
          pgmoneta_log_error("could not find known host file: %s", strerror(errno));
          goto error;
       case SSH_KNOWN_HOSTS_UNKNOWN:
-         rc = ssh_session_update_known_hosts(session);
+         rc = ssh_session_update_known_hosts(s);
          if (rc < 0)
          {
             pgmoneta_log_error("could not update known_hosts file: %s", strerror(errno));
@@ -231,52 +314,53 @@ ssh_storage_setup(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   rc = ssh_userauth_publickey(session, NULL, client_privkey);
+   rc = ssh_userauth_publickey(s, NULL, client_privkey);
    if (rc != SSH_AUTH_SUCCESS)
    {
       pgmoneta_log_error("could not authenticate with public/private key: %s", strerror(errno));
       goto error;
    }
 
-   sftp = sftp_new(session);
+   f = sftp_new(s);
 
-   if (sftp == NULL)
+   if (f == NULL)
    {
-      pgmoneta_log_error("Error: %s", ssh_get_error(session));
+      pgmoneta_log_error("Error: %s", ssh_get_error(s));
       goto error;
    }
 
-   rc = sftp_init(sftp);
+   rc = sftp_init(f);
    if (rc != SSH_OK)
    {
-      pgmoneta_log_error("Error: %s", sftp_get_error(sftp));
+      pgmoneta_log_error("Error: %s", sftp_get_error(f));
       goto error;
    }
 
-   is_error = false;
-
-   ssh_string_free_char(hexa);
    ssh_clean_pubkey_hash(&srv_pubkey_hash);
    ssh_key_free(srv_pubkey);
    ssh_key_free(client_pubkey);
    ssh_key_free(client_privkey);
 
+   *ssh = s;
+   *sf = f;
+
    return 0;
 
 error:
 
-   is_error = true;
-
-   ssh_string_free_char(hexa);
    ssh_clean_pubkey_hash(&srv_pubkey_hash);
    ssh_key_free(srv_pubkey);
    ssh_key_free(client_pubkey);
    ssh_key_free(client_privkey);
 
-   sftp_free(sftp);
+   sftp_free(f);
+
+   if (s != NULL)
+   {
+      ssh_disconnect(s);
+      ssh_free(s);
+   }
 
-   ssh_disconnect(session);
-   ssh_free(session);
    return 1;
 }
 
@@ -289,7 +373,11 @@ ssh_storage_backup_execute(char* name __attribute__((unused)), struct art* nodes
    char* local_root = NULL;
    char* remote_root = NULL;
    char* latest_backup_sha256 = NULL;
+   char* current_backup_sha256 = NULL;
+   char* dictionary_path = NULL;
    int next_newest = -1;
+   int number_of_workers = 0;
+   struct workers* workers = NULL;
    int number_of_backups = 0;
    struct backup** backups = NULL;
    struct main_configuration* config;
@@ -306,6 +394,8 @@ ssh_storage_backup_execute(char* name __attribute__((unused)), struct art* nodes
    server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
    label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
 
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_TRANSFER);
+
    pgmoneta_log_debug("SSH storage engine (execute): %s/%s", config->common.servers[server].name, label);
 
    remote_root = get_remote_server_backup_identifier(server, label);
@@ -341,6 +431,11 @@ ssh_storage_backup_execute(char* name __attribute__((unused)), struct art* nodes
       goto error;
    }
 
+   if (pgmoneta_art_create(&current_map))
+   {
+      goto error;
+   }
+
    if (next_newest != -1)
    {
       latest_remote_root = get_remote_server_backup_identifier(server, backups[next_newest]->label);
@@ -348,24 +443,67 @@ ssh_storage_backup_execute(char* name __attribute__((unused)), struct art* nodes
       latest_backup_sha256 = pgmoneta_get_server_backup_identifier(server, backups[next_newest]->label);
       latest_backup_sha256 = pgmoneta_append(latest_backup_sha256, "backup.sha256");
 
-      if (read_latest_backup_sha256(latest_backup_sha256))
+      if (read_backup_sha256(latest_backup_sha256, tree_map))
       {
          goto error;
       }
+
+      /* The hashes of this backup were calculated by the SHA256 step */
+      current_backup_sha256 = pgmoneta_append(current_backup_sha256, local_root);
+      current_backup_sha256 = pgmoneta_append(current_backup_sha256, "backup.sha256");
+
+      if (read_backup_sha256(current_backup_sha256, current_map))
+      {
+         pgmoneta_log_debug("SSH: No hashes in %s", current_backup_sha256);
+      }
    }
 
-   sftp_copy_file(local_root, remote_root, "/backup.info");
-   sftp_copy_file(local_root, remote_root, "/backup.sha256");
+   sftp_copy_file(&main_connection, local_root, remote_root, "/backup.info");
+   sftp_copy_file(&main_connection, local_root, remote_root, "/backup.sha256");
+
+   /* The dictionary is needed to decompress the small files */
+   dictionary_path = pgmoneta_append(dictionary_path, local_root);
+   dictionary_path = pgmoneta_append(dictionary_path, COMPRESSION_DICTIONARY);
+
+   if (pgmoneta_exists(dictionary_path) &&
+       sftp_copy_file(&main_connection, local_root, remote_root, "/" COMPRESSION_DICTIONARY))
+   {
+      pgmoneta_log_error("SSH: Could not transfer %s", dictionary_path);
+      goto error;
+   }
 
    local_root = pgmoneta_append(local_root, "/data");
    remote_root = pgmoneta_append(remote_root, "/data");
 
-   if (sftp_copy_directory(local_root, remote_root, "") != 0)
+   /* Each worker uploads over its own SSH session */
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      if (sftp_connections_create(number_of_workers))
+      {
+         goto error;
+      }
+
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   if (sftp_copy_directory(local_root, remote_root, "", workers) != 0)
    {
       pgmoneta_log_error("failed to transfer the backup directory from the local host to the remote server: %s", strerror(errno));
       goto error;
    }
 
+   pgmoneta_workers_wait(workers);
+   if (workers != NULL && !pgmoneta_workers_outcome_ok(workers))
+   {
+      pgmoneta_log_error("failed to transfer the backup directory from the local host to the remote server");
+      goto error;
+   }
+
+   pgmoneta_workers_destroy(workers);
+   workers = NULL;
+   sftp_connections_destroy();
+
    is_error = false;
 
    for (int i = 0; i < number_of_backups; i++)
@@ -374,36 +512,42 @@ ssh_storage_backup_execute(char* name __attribute__((unused)), struct art* nodes
    }
    free(backups);
 
-   if (latest_backup_sha256 != NULL)
-   {
-      free(latest_backup_sha256);
-   }
+   free(latest_backup_sha256);
+   free(current_backup_sha256);
+   free(dictionary_path);
 
    free(server_path);
    free(remote_root);
    free(local_root);
 
+   pgmoneta_bandwidth_end();
+
    return 0;
 
 error:
 
    is_error = true;
 
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+   sftp_connections_destroy();
+
    for (int i = 0; i < number_of_backups; i++)
    {
       free(backups[i]);
    }
    free(backups);
 
-   if (latest_backup_sha256 != NULL)
-   {
-      free(latest_backup_sha256);
-   }
+   free(latest_backup_sha256);
+   free(current_backup_sha256);
+   free(dictionary_path);
 
    free(server_path);
    free(remote_root);
    free(local_root);
 
+   pgmoneta_bandwidth_end();
+
    return 1;
 }
 
@@ -477,15 +621,23 @@ ssh_storage_backup_teardown(char* name __attribute__((unused)), struct art* node
    pgmoneta_art_destroy(tree_map);
    tree_map = NULL;
 
+   pgmoneta_art_destroy(current_map);
+   current_map = NULL;
+
    free(latest_remote_root);
    latest_remote_root = NULL;
 
+   sftp_connections_destroy();
+
    sftp_free(sftp);
    sftp = NULL;
 
    ssh_free(session);
    session = NULL;
 
+   main_connection.session = NULL;
+   main_connection.sftp = NULL;
+
    return 0;
 }
 
@@ -511,8 +663,13 @@ ssh_storage_wal_shipping_teardown(char* name __attribute__((unused)), struct art
                       label != NULL ? label : "(wal)");
 
    sftp_free(sftp);
+   sftp = NULL;
 
    ssh_free(session);
+   session = NULL;
+
+   main_connection.session = NULL;
+   main_connection.sftp = NULL;
 
    return 0;
 }
@@ -563,11 +720,10 @@ error:
 }
 
 static int
-sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
+sftp_copy_directory(char* local_root, char* remote_root, char* relative_path, struct workers* workers)
 {
    char* from = NULL;
    char* to = NULL;
-   char* relative_file;
    int rc;
    DIR* dir;
    struct dirent* entry;
@@ -586,6 +742,7 @@ sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
 
    mode = pgmoneta_get_permission(from);
 
+   /* Directories are created on the main session before any file in them is sent */
    rc = sftp_mkdir(sftp, to, mode);
    if (rc != SSH_OK)
    {
@@ -608,23 +765,51 @@ sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
 
          pgmoneta_snprintf(relative_dir, sizeof(relative_dir), "%s/%s", relative_path, entry->d_name);
 
-         sftp_copy_directory(local_root, remote_root, relative_dir);
+         if (sftp_copy_directory(local_root, remote_root, relative_dir, workers))
+         {
+            goto error;
+         }
       }
       else
       {
-         relative_file = NULL;
+         struct sftp_task* task = NULL;
 
-         relative_file = pgmoneta_append(relative_file, relative_path);
-         relative_file = pgmoneta_append(relative_file, "/");
-         relative_file = pgmoneta_append(relative_file, entry->d_name);
-
-         if (sftp_copy_file(local_root, remote_root, relative_file))
+         task = (struct sftp_task*)malloc(sizeof(struct sftp_task));
+         if (task == NULL)
          {
-            free(relative_file);
             goto error;
          }
 
-         free(relative_file);
+         memset(task, 0, sizeof(struct sftp_task));
+         task->common.workers = workers;
+         pgmoneta_snprintf(task->local_root, sizeof(task->local_root), "%s", local_root);
+         pgmoneta_snprintf(task->remote_root, sizeof(task->remote_root), "%s", remote_root);
+         pgmoneta_snprintf(task->relative_path, sizeof(task->relative_path), "%s/%s", relative_path, entry->d_name);
+
+         if (workers != NULL)
+         {
+            if (!pgmoneta_workers_outcome_ok(workers))
+            {
+               free(task);
+               goto error;
+            }
+
+            if (pgmoneta_workers_add(workers, do_sftp_copy, (struct worker_common*)task))
+            {
+               free(task);
+               goto error;
+            }
+         }
+         else
+         {
+            rc = sftp_copy_file(&main_connection, task->local_root, task->remote_root, task->relative_path);
+            free(task);
+
+            if (rc)
+            {
+               goto error;
+            }
+         }
       }
    }
 
@@ -637,7 +822,10 @@ sftp_copy_directory(char* local_root, char* remote_root, char* relative_path)
 
 error:
 
-   closedir(dir);
+   if (dir != NULL)
+   {
+      closedir(dir);
+   }
 
    free(from);
    free(to);
@@ -645,18 +833,35 @@ error:
    return 1;
 }
 
+static void
+do_sftp_copy(struct worker_common* wc)
+{
+   struct sftp_task* task = (struct sftp_task*)wc;
+   struct sftp_connection* connection = NULL;
+
+   connection = sftp_connection_acquire();
+
+   if (connection == NULL || sftp_copy_file(connection, task->local_root, task->remote_root, task->relative_path))
+   {
+      pgmoneta_record_failure(task->common.workers != NULL ? task->common.workers->outcome : NULL,
+                              "SFTP upload failed: %s", task->relative_path);
+   }
+
+   sftp_connection_release(connection);
+
+   free(task);
+}
+
 static int
-sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
+sftp_copy_file(struct sftp_connection* connection, char* local_root, char* remote_root, char* relative_path)
 {
    char* s = NULL;
    char* d = NULL;
    char* sha256 = NULL;
    char* latest_sha256 = NULL;
    char* latest_backup_path = NULL;
-   char buffer[16384];
    FILE* sfile = NULL;
    sftp_file dfile = NULL;
-   unsigned long read_bytes = 0;
    mode_t mode = 0;
    bool is_link = false;
 
@@ -666,17 +871,25 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
    d = pgmoneta_append(d, remote_root);
    d = pgmoneta_append(d, relative_path);
 
-   pgmoneta_create_sha256_file(s, &sha256);
-
    if (latest_remote_root != NULL)
    {
-      latest_backup_path = pgmoneta_append(latest_backup_path, latest_remote_root);
-      latest_backup_path = pgmoneta_append(latest_backup_path, relative_path);
-
       if ((latest_sha256 = (char*)pgmoneta_art_search(tree_map, relative_path)) != NULL)
       {
+         char* current_sha256 = NULL;
+
+         if (current_map != NULL && (current_sha256 = (char*)pgmoneta_art_search(current_map, relative_path)) != NULL)
+         {
+            sha256 = pgmoneta_append(sha256, current_sha256);
+         }
+         else
+         {
+            pgmoneta_create_sha256_file(s, &sha256);
+         }
+
          if (pgmoneta_compare_string(latest_sha256, sha256))
          {
+            latest_backup_path = pgmoneta_append(latest_backup_path, latest_remote_root);
+            latest_backup_path = pgmoneta_append(latest_backup_path, relative_path);
             is_link = true;
          }
       }
@@ -684,9 +897,9 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
 
    if (is_link)
    {
-      if (sftp_symlink(sftp, latest_backup_path, d) < 0)
+      if (sftp_symlink(connection->sftp, latest_backup_path, d) < 0)
       {
-         pgmoneta_log_error("Failed to link remotely: %s", ssh_get_error(session));
+         pgmoneta_log_error("Failed to link remotely: %s", ssh_get_error(connection->session));
          goto error;
       }
    }
@@ -701,18 +914,18 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
          goto error;
       }
 
-      dfile = sftp_open(sftp, d, O_WRONLY | O_CREAT | O_TRUNC, mode);
+      dfile = sftp_open(connection->sftp, d, O_WRONLY | O_CREAT | O_TRUNC, mode);
 
       if (dfile == NULL)
       {
+         pgmoneta_log_error("Failed to open %s remotely: %s", d, ssh_get_error(connection->session));
          goto error;
       }
 
-      memset(buffer, 0, sizeof(buffer));
-
-      while ((read_bytes = fread(buffer, 1, sizeof(buffer), sfile)) > 0)
+      if (sftp_write_file(connection, sfile, dfile))
       {
-         sftp_write(dfile, buffer, read_bytes);
+         pgmoneta_log_error("Failed to write %s remotely: %s", d, ssh_get_error(connection->session));
+         goto error;
       }
    }
 
@@ -729,11 +942,7 @@ sftp_copy_file(char* local_root, char* remote_root, char* relative_path)
    free(s);
    free(d);
    free(sha256);
-
-   if (latest_backup_path != NULL)
-   {
-      free(latest_backup_path);
-   }
+   free(latest_backup_path);
 
    return 0;
 
@@ -752,14 +961,228 @@ error:
    free(s);
    free(d);
    free(sha256);
+   free(latest_backup_path);
+
+   return 1;
+}
+
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0)
+static int
+sftp_write_file(struct sftp_connection* connection, FILE* sfile, sftp_file dfile)
+{
+   char* buffer = NULL;
+   size_t read_bytes = 0;
+   size_t chunk = SFTP_WRITE_SIZE;
+   sftp_aio requests[SFTP_MAX_REQUESTS];
+   int head = 0;
+   int outstanding = 0;
+   sftp_limits_t limits = NULL;
+
+   memset(&requests[0], 0, sizeof(requests));
+
+   /* Use the largest write the server allows */
+   limits = sftp_limits(connection->sftp);
+   if (limits != NULL)
+   {
+      if (limits->max_write_length > 0)
+      {
+         chunk = MIN((size_t)limits->max_write_length, (size_t)SFTP_BUFFER_SIZE);
+      }
+      sftp_limits_free(limits);
+   }
+
+   buffer = (char*)pgmoneta_memory_buffer_acquire(SFTP_BUFFER_SIZE);
+   if (buffer == NULL)
+   {
+      goto error;
+   }
+
+   while ((read_bytes = fread(buffer, 1, SFTP_BUFFER_SIZE, sfile)) > 0)
+   {
+      size_t offset = 0;
+
+      pgmoneta_bandwidth_consume(read_bytes);
+
+      while (offset < read_bytes)
+      {
+         size_t length = MIN(chunk, read_bytes - offset);
+         int slot = (head + outstanding) % SFTP_MAX_REQUESTS;
+
+         /* The request window is full, so wait for the oldest write */
+         if (outstanding == SFTP_MAX_REQUESTS)
+         {
+            if (sftp_aio_wait_write(&requests[head]) < 0)
+            {
+               goto error;
+            }
+            head = (head + 1) % SFTP_MAX_REQUESTS;
+            outstanding--;
+         }
+
+         /* The data is copied into the outgoing packet before returning */
+         if (sftp_aio_begin_write(dfile, buffer + offset, length, &requests[slot]) < 0)
+         {
+            goto error;
+         }
+         outstanding++;
+
+         offset += length;
+      }
+   }
+
+   if (ferror(sfile))
+   {
+      goto error;
+   }
+
+   while (outstanding > 0)
+   {
+      if (sftp_aio_wait_write(&requests[head]) < 0)
+      {
+         goto error;
+      }
+      head = (head + 1) % SFTP_MAX_REQUESTS;
+      outstanding--;
+   }
+
+   pgmoneta_memory_buffer_release(buffer);
+
+   return 0;
+
+error:
+
+   while (outstanding > 0)
+   {
+      sftp_aio_free(requests[head]);
+      head = (head + 1) % SFTP_MAX_REQUESTS;
+      outstanding--;
+   }
+
+   pgmoneta_memory_buffer_release(buffer);
+
+   return 1;
+}
+#else
+static int
+sftp_write_file(struct sftp_connection* connection __attribute__((unused)), FILE* sfile, sftp_file dfile)
+{
+   char* buffer = NULL;
+   size_t read_bytes = 0;
 
-   if (latest_backup_path != NULL)
+   buffer = (char*)pgmoneta_memory_buffer_acquire(SFTP_WRITE_SIZE);
+   if (buffer == NULL)
    {
-      free(latest_backup_path);
+      goto error;
    }
 
+   while ((read_bytes = fread(buffer, 1, SFTP_WRITE_SIZE, sfile)) > 0)
+   {
+      pgmoneta_bandwidth_consume(read_bytes);
+
+      if (sftp_write(dfile, buffer, read_bytes) != (ssize_t)read_bytes)
+      {
+         goto error;
+      }
+   }
+
+   pgmoneta_memory_buffer_release(buffer);
+
+   return 0;
+
+error:
+
+   pgmoneta_memory_buffer_release(buffer);
+
    return 1;
 }
+#endif
+
+static int
+sftp_connections_create(int number)
+{
+   connections = (struct sftp_connection*)calloc(number, sizeof(struct sftp_connection));
+
+   if (connections == NULL)
+   {
+      return 1;
+   }
+
+   number_of_connections = number;
+
+   return 0;
+}
+
+static struct sftp_connection*
+sftp_connection_acquire(void)
+{
+   struct sftp_connection* connection = NULL;
+
+   pthread_mutex_lock(&connections_lock);
+
+   while (connection == NULL)
+   {
+      for (int i = 0; connection == NULL && i < number_of_connections; i++)
+      {
+         if (!connections[i].busy)
+         {
+            connection = &connections[i];
+            connection->busy = true;
+         }
+      }
+
+      if (connection == NULL)
+      {
+         pthread_cond_wait(&connections_cond, &connections_lock);
+      }
+   }
+
+   pthread_mutex_unlock(&connections_lock);
+
+   /* Sessions are opened on first use, so the handshakes run in parallel */
+   if (connection->session == NULL)
+   {
+      if (ssh_connect_server(&connection->session, &connection->sftp))
+      {
+         sftp_connection_release(connection);
+         return NULL;
+      }
+   }
+
+   return connection;
+}
+
+static void
+sftp_connection_release(struct sftp_connection* connection)
+{
+   if (connection == NULL)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&connections_lock);
+   connection->busy = false;
+   pthread_cond_signal(&connections_cond);
+   pthread_mutex_unlock(&connections_lock);
+}
+
+static void
+sftp_connections_destroy(void)
+{
+   for (int i = 0; i < number_of_connections; i++)
+   {
+      sftp_free(connections[i].sftp);
+
+      if (connections[i].session != NULL)
+      {
+         ssh_disconnect(connections[i].session);
+         ssh_free(connections[i].session);
+      }
+   }
+
+   free(connections);
+   connections = NULL;
+   number_of_connections = 0;
+}
 
 static int
 sftp_wal_prepare(sftp_file* file, int segsize)
@@ -786,7 +1209,7 @@ sftp_wal_prepare(sftp_file* file, int segsize)
 }
 
 static int
-read_latest_backup_sha256(char* path)
+read_backup_sha256(char* path, struct art* map)
 {
    char buffer[4096];
    FILE* file = NULL;
@@ -829,7 +1252,7 @@ read_latest_backup_sha256(char* path)
       memset(hash, 0, strlen(ptr));
       memcpy(hash, ptr, strlen(ptr) - 1);
 
-      pgmoneta_art_insert(tree_map, file_path, (uintptr_t)hash, ValueString);
+      pgmoneta_art_insert(map, file_path, (uintptr_t)hash, ValueString);
       free(file_path);
    }
 
@@ -1113,12 +1536,17 @@ cleanup:
       pgmoneta_art_destroy(tree_map);
       tree_map = NULL;
    }
+   pgmoneta_art_destroy(current_map);
+   current_map = NULL;
    free(latest_remote_root);
    latest_remote_root = NULL;
+   sftp_connections_destroy();
    sftp_free(sftp);
    sftp = NULL;
    ssh_free(session);
    session = NULL;
+   main_connection.session = NULL;
+   main_connection.sftp = NULL;
 
 done:
    pgmoneta_art_destroy(nodes);
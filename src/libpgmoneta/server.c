@@ -40,6 +40,7 @@
 
 /* system */
 #include <ev.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -58,7 +59,6 @@ static int get_summarize_wal(SSL* ssl, int socket, bool* sw);
 static int has_predefined_role(SSL* ssl, int socket, char* usr, char* role, bool* has_role);
 static int has_superuser_role(SSL* ssl, int socket, char* usr, bool* is_superuser);
 static int has_execute_privilege(SSL* ssl, int socket, char* usr, char* func_name, bool* has_privilege);
-static int transform_hex_bytea_to_binary(char* hex_bytea, uint8_t** out, int* len);
 static int transform_text_to_label_file_contents(char* text, struct label_file_contents* lf);
 static int process_server_parameters(int server, struct deque* server_parameters);
 static int query_execute(SSL* ssl, int socket, char* query, struct query_response** response);
@@ -316,17 +316,13 @@ pgmoneta_server_verify_connection(int srv)
 }
 
 int
-pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, int offset,
-                                 int length, int socket, uint8_t** out, int* len)
+pgmoneta_server_prepare_read_binary_file(int srv, SSL* ssl, int socket)
 {
    char* user = NULL;
    bool has_role = false;
    bool has_privilege = false;
-   char bytea_data_buffer[DEFAULT_BURST];
-   uint8_t* b_out = NULL;
-   int b_len = 0;
-   char query[MISC_LENGTH];
-   struct query_response* response = NULL;
+   int32_t types[3] = {TEXTOID, INT8OID, INT8OID};
+   struct message* parse_msg = NULL;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
@@ -363,38 +359,83 @@ pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, in
       goto error;
    }
 
-   memset(query, 0, sizeof(query));
-   pgmoneta_snprintf(query, sizeof(query), "SELECT pg_read_binary_file('%s', %d, %d, false);", relative_file_path, offset, length);
+   if (pgmoneta_create_parse_message(READ_BINARY_FILE_STATEMENT,
+                                     "SELECT pg_read_binary_file($1, $2, $3, false);",
+                                     3, &types[0], &parse_msg) != MESSAGE_STATUS_OK)
+   {
+      goto error;
+   }
 
-   if (query_execute(ssl, socket, query, &response))
+   if (pgmoneta_extended_query_execute(ssl, socket, parse_msg, NULL, 0, NULL))
    {
+      pgmoneta_log_error("Unable to prepare pg_read_binary_file on %s", config->common.servers[srv].name);
       goto error;
    }
 
-   if (response->number_of_columns != 1)
+   pgmoneta_free_message(parse_msg);
+
+   return 0;
+
+error:
+
+   pgmoneta_free_message(parse_msg);
+
+   return 1;
+}
+
+int
+pgmoneta_server_read_binary_file(int srv, SSL* ssl, char* relative_file_path, int64_t offset,
+                                 int64_t length, int socket, uint8_t* buffer, int64_t* len)
+{
+   char offset_str[MISC_LENGTH];
+   char length_str[MISC_LENGTH];
+   char* parameters[3];
+   struct message* bind_msg = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *len = 0;
+
+   if (ssl == NULL && socket < 0)
+   {
+      pgmoneta_log_error("Unable to connect to server %s", config->common.servers[srv].name);
+      goto error;
+   }
+
+   if (offset < 0 || length <= 0 || buffer == NULL)
    {
-      pgmoneta_log_error("Unexpected number of columns in query response");
       goto error;
    }
 
-   memset(bytea_data_buffer, 0, DEFAULT_BURST);
+   pgmoneta_snprintf(offset_str, sizeof(offset_str), "%" PRId64, offset);
+   pgmoneta_snprintf(length_str, sizeof(length_str), "%" PRId64, length);
 
-   /* Note: we get data in hex format */
-   pgmoneta_snprintf(bytea_data_buffer, DEFAULT_BURST, "%s", response->tuples->data[0]);
+   parameters[0] = relative_file_path;
+   parameters[1] = offset_str;
+   parameters[2] = length_str;
 
-   /* Transform it to binary */
-   if (transform_hex_bytea_to_binary(bytea_data_buffer, &b_out, &b_len))
+   if (pgmoneta_create_bind_execute_message(READ_BINARY_FILE_STATEMENT, 3, &parameters[0], true, &bind_msg) != MESSAGE_STATUS_OK)
    {
       goto error;
    }
 
-   *out = b_out;
-   *len = b_len;
-   pgmoneta_free_query_response(response);
+   /* The bytea arrives in binary format and is written directly into the buffer */
+   if (pgmoneta_extended_query_execute(ssl, socket, bind_msg, buffer, (size_t)length, len))
+   {
+      goto error;
+   }
+
+   if (*len == 0)
+   {
+      pgmoneta_log_debug("the requested chunk is not present or exceeds the boundary of the file");
+   }
+
+   pgmoneta_free_message(bind_msg);
    return 0;
+
 error:
-   free(b_out);
-   pgmoneta_free_query_response(response);
+   pgmoneta_free_message(bind_msg);
    return 1;
 }
 
@@ -575,6 +616,72 @@ error:
    return 1;
 }
 
+int
+pgmoneta_server_file_checksum(int srv, SSL* ssl, int socket, char* relative_file_path, int64_t length, char** sha256)
+{
+   char result[SHA256_DIGEST_LENGTH * 2 + 1];
+   char length_str[MISC_LENGTH];
+   char* parameters[2];
+   int32_t types[2] = {TEXTOID, INT8OID};
+   int64_t result_length = 0;
+   struct message* parse_msg = NULL;
+   struct message* bind_msg = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *sha256 = NULL;
+
+   if (ssl == NULL && socket < 0)
+   {
+      pgmoneta_log_error("Unable to connect to server %s", config->common.servers[srv].name);
+      goto error;
+   }
+
+   memset(result, 0, sizeof(result));
+   pgmoneta_snprintf(length_str, sizeof(length_str), "%" PRId64, length);
+
+   parameters[0] = relative_file_path;
+   parameters[1] = length_str;
+
+   /* The path is bound as a parameter of the unnamed statement, never pasted into the query */
+   if (pgmoneta_create_parse_message("", "SELECT encode(sha256(pg_read_binary_file($1, 0, $2, false)), 'hex');",
+                                     2, &types[0], &parse_msg) != MESSAGE_STATUS_OK)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_extended_query_execute(ssl, socket, parse_msg, NULL, 0, NULL))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_create_bind_execute_message("", 2, &parameters[0], false, &bind_msg) != MESSAGE_STATUS_OK)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_extended_query_execute(ssl, socket, bind_msg, &result[0], sizeof(result) - 1, &result_length))
+   {
+      goto error;
+   }
+
+   if (result_length != SHA256_DIGEST_LENGTH * 2)
+   {
+      goto error;
+   }
+
+   *sha256 = pgmoneta_append(NULL, &result[0]);
+
+   pgmoneta_free_message(parse_msg);
+   pgmoneta_free_message(bind_msg);
+   return 0;
+error:
+   pgmoneta_free_message(parse_msg);
+   pgmoneta_free_message(bind_msg);
+   return 1;
+}
+
 int
 pgmoneta_server_start_backup(int srv, SSL* ssl, int socket, char* label, char** lsn)
 {
@@ -1540,71 +1647,6 @@ error:
    return 1;
 }
 
-static int
-transform_hex_bytea_to_binary(char* hex_bytea, uint8_t** out, int* len)
-{
-   size_t hex_len;
-   size_t binary_len = 0;
-   uint8_t* binary_out = NULL;
-   char* hb = NULL;
-   int hi, lo;
-   char hex_chr_str[2] = {0};
-
-   /* check if valid hex bytea string */
-   if (hex_bytea == NULL || strncmp(hex_bytea, "\\x", 2) != 0)
-   {
-      pgmoneta_log_error("invalid hex bytea (missing \\x prefix)");
-      goto error;
-   }
-
-   /* skip '\x' */
-   hb = hex_bytea + 2;
-   hex_len = strlen(hb);
-
-   /* the requested chunk is not present in the file */
-   if (hex_len == 0)
-   {
-      pgmoneta_log_debug("the requested chunk is not present or exceeds the boundary of the file");
-      goto done;
-   }
-
-   if (hex_len % 2 != 0)
-   {
-      pgmoneta_log_error("invalid hex bytea (partial data)");
-      goto error;
-   }
-
-   binary_len = hex_len / 2;
-   binary_out = (uint8_t*)malloc(sizeof(uint8_t) * binary_len);
-   if (binary_out == NULL)
-   {
-      goto error;
-   }
-
-   for (size_t i = 0; i < binary_len; i++)
-   {
-      hex_chr_str[0] = hb[2 * i];
-      sscanf(hex_chr_str, "%x", &hi);
-      hex_chr_str[0] = hb[2 * i + 1];
-      sscanf(hex_chr_str, "%x", &lo);
-      if (hi == -1 || lo == -1)
-      {
-         pgmoneta_log_error("invalid hex character encountered");
-         goto error;
-      }
-      binary_out[i] = (uint8_t)(hi << 4) | (uint8_t)lo;
-   }
-
-done:
-   *out = binary_out;
-   *len = binary_len;
-   return 0;
-error:
-
-   free(binary_out);
-   return 1;
-}
-
 static int
 transform_text_to_label_file_contents(char* text, struct label_file_contents* lf)
 {
@@ -28,8 +28,23 @@
 
 /* pgmoneta */
 #include <pgmoneta.h>
+#include <art.h>
+#include <deque.h>
+#include <info.h>
+#include <logging.h>
+#include <manifest.h>
 #include <shmem.h>
 #include <storage.h>
+#include <utils.h>
+#include <value.h>
+
+/* system */
+#include <stdlib.h>
+#include <string.h>
+
+/* WAL upload entry points defined in their respective se_*.c */
+extern int s3_upload_wal(int server, char* directory, char* file);
+extern int azure_upload_wal(int server, char* directory, char* file);
 
 bool
 pgmoneta_is_storage_engine_enabled(int engine)
@@ -37,3 +52,142 @@ pgmoneta_is_storage_engine_enabled(int engine)
    struct main_configuration* config = (struct main_configuration*)shmem;
    return (config->storage_engine & engine) != 0;
 }
+
+int
+pgmoneta_storage_upload_wal(int server, int engine, char* directory, char* file)
+{
+   if (engine == STORAGE_ENGINE_S3)
+   {
+      return s3_upload_wal(server, directory, file);
+   }
+   else if (engine == STORAGE_ENGINE_AZURE)
+   {
+      return azure_upload_wal(server, directory, file);
+   }
+
+   pgmoneta_log_error("Storage: WAL upload is not supported by storage engine %d", engine);
+
+   return 1;
+}
+
+int
+pgmoneta_storage_previous_upload(int server, char* label, int engine, char** previous, struct art** checksums)
+{
+   char* d = NULL;
+   char* manifest_path = NULL;
+   int number_of_backups = 0;
+   struct backup** backups = NULL;
+   struct backup* current = NULL;
+   struct backup* candidate = NULL;
+   struct deque* paths = NULL;
+   struct deque_iterator* iter = NULL;
+   struct art* map = NULL;
+
+   *previous = NULL;
+   *checksums = NULL;
+
+   d = pgmoneta_get_server_backup(server);
+
+   if (pgmoneta_load_infos(d, &number_of_backups, &backups))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      if (backups[i] != NULL && !strcmp(backups[i]->label, label))
+      {
+         current = backups[i];
+      }
+   }
+
+   if (current == NULL)
+   {
+      goto done;
+   }
+
+   /* Newest uploaded backup older than the current one with the same file layout */
+   for (int i = number_of_backups - 1; i >= 0 && candidate == NULL; i--)
+   {
+      struct backup* b = backups[i];
+
+      if (b == NULL || b->valid != VALID_TRUE || strcmp(b->label, label) >= 0)
+      {
+         continue;
+      }
+
+      if (b->compression != current->compression || b->encryption != current->encryption)
+      {
+         continue;
+      }
+
+      if ((engine == STORAGE_ENGINE_S3 && b->remote_s3_elapsed_time > 0) ||
+          (engine == STORAGE_ENGINE_AZURE && b->remote_azure_elapsed_time > 0))
+      {
+         candidate = b;
+      }
+   }
+
+   if (candidate == NULL)
+   {
+      goto done;
+   }
+
+   manifest_path = pgmoneta_get_server_backup_identifier(server, candidate->label);
+   manifest_path = pgmoneta_append(manifest_path, "backup.manifest");
+
+   if (pgmoneta_manifest_get_paths(manifest_path, &paths))
+   {
+      pgmoneta_log_debug("Storage: no manifest for previous upload %s", candidate->label);
+      goto done;
+   }
+
+   if (pgmoneta_art_create(&map))
+   {
+      goto error;
+   }
+
+   pgmoneta_deque_iterator_create(paths, &iter);
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      char* checksum = (char*)pgmoneta_value_data(iter->value);
+
+      if (checksum != NULL && strlen(checksum) > 0)
+      {
+         pgmoneta_art_insert(map, iter->tag, (uintptr_t)checksum, ValueString);
+      }
+   }
+
+   *previous = pgmoneta_append(NULL, candidate->label);
+   *checksums = map;
+   map = NULL;
+
+done:
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      free(backups[i]);
+   }
+   free(backups);
+   free(d);
+   free(manifest_path);
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(paths);
+
+   return 0;
+
+error:
+
+   for (int i = 0; i < number_of_backups; i++)
+   {
+      free(backups[i]);
+   }
+   free(backups);
+   free(d);
+   free(manifest_path);
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(paths);
+   pgmoneta_art_destroy(map);
+
+   return 1;
+}
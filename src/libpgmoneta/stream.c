@@ -28,10 +28,12 @@
 
 #include <pgmoneta.h>
 #include <aes.h>
+#include <bandwidth.h>
 #include <compression.h>
 #include <deque.h>
 #include <files.h>
 #include <logging.h>
+#include <memory.h>
 #include <stream.h>
 #include <utils.h>
 #include <value.h>
@@ -53,10 +55,17 @@ pgmoneta_streamer_create(int mode, int encryption, int compression, struct strea
    struct streamer* s = NULL;
    s = malloc(sizeof(struct streamer));
    memset(s, 0, sizeof(struct streamer));
-   s->capacity = sizeof(s->buffer);
    s->compression = compression;
    s->encryption = encryption;
 
+   s->buffer = pgmoneta_memory_buffer_acquire(BUFFER_SIZE);
+   if (s->buffer == NULL)
+   {
+      pgmoneta_log_error("Failed to allocate streamer buffer");
+      goto error;
+   }
+   s->capacity = BUFFER_SIZE;
+
    if (encryption == ENCRYPTION_NONE && compression == COMPRESSION_NONE)
    {
       /* fall back to NONE to avoid unnecessary overhead */
@@ -84,6 +93,13 @@ pgmoneta_streamer_create(int mode, int encryption, int compression, struct strea
 
    if (mode != STREAMER_MODE_NONE)
    {
+      s->cbuf = pgmoneta_memory_buffer_acquire(BUFFER_SIZE);
+      if (s->cbuf == NULL)
+      {
+         pgmoneta_log_error("Failed to allocate streamer buffer");
+         goto error;
+      }
+
       if (pgmoneta_encryptor_create(encryption, &s->encryptor))
       {
          pgmoneta_log_error("Failed to create encryptor, mode %d", encryption);
@@ -116,6 +132,8 @@ pgmoneta_streamer_destroy(struct streamer* streamer)
    pgmoneta_encryptor_destroy(streamer->encryptor);
    pgmoneta_deque_destroy(streamer->destinations);
    pgmoneta_deque_destroy(streamer->failed_destinations);
+   pgmoneta_memory_buffer_release(streamer->buffer);
+   pgmoneta_memory_buffer_release(streamer->cbuf);
    free(streamer);
 }
 
@@ -146,6 +164,8 @@ pgmoneta_streamer_write(struct streamer* streamer, void* buffer, size_t size, bo
             pgmoneta_log_error("Streamer callback failed during execution");
             goto error;
          }
+         pgmoneta_bandwidth_consume(streamer->size);
+
          /* update bytes written on success */
          streamer->written += streamer->size;
          streamer->size = 0;
@@ -255,7 +275,7 @@ error:
 static int
 backup_stream_cb(struct streamer* this, bool last_chunk)
 {
-   char cbuf[BUFFER_SIZE];
+   char* cbuf = NULL;
    void* ebuf = NULL;
    size_t ebuf_size;
    size_t cbuf_size = 0;
@@ -269,10 +289,12 @@ backup_stream_cb(struct streamer* this, bool last_chunk)
       goto error;
    }
 
+   cbuf = this->cbuf;
+
    pgmoneta_compressor_prepare(this->compressor, this->buffer, this->size, last_chunk);
    while (!finished)
    {
-      if (this->compressor->compress(this->compressor, cbuf, sizeof(cbuf), &cbuf_size, &finished))
+      if (this->compressor->compress(this->compressor, cbuf, BUFFER_SIZE, &cbuf_size, &finished))
       {
          pgmoneta_log_error("Failed to compress data in streamer");
          goto error;
@@ -322,7 +344,7 @@ error:
 static int
 restore_stream_cb(struct streamer* this, bool last_chunk)
 {
-   char cbuf[BUFFER_SIZE];
+   char* cbuf = NULL;
    void* ebuf = NULL;
    size_t ebuf_size;
    size_t cbuf_size = 0;
@@ -336,6 +358,8 @@ restore_stream_cb(struct streamer* this, bool last_chunk)
       goto error;
    }
 
+   cbuf = this->cbuf;
+
    if (this->encryptor->decrypt(this->encryptor, this->buffer, this->size, last_chunk, &ebuf, &ebuf_size))
    {
       pgmoneta_log_error("Failed to decrypt data in streamer");
@@ -345,7 +369,7 @@ restore_stream_cb(struct streamer* this, bool last_chunk)
    pgmoneta_compressor_prepare(this->compressor, ebuf, ebuf_size, last_chunk);
    while (!finished)
    {
-      if (this->compressor->decompress(this->compressor, cbuf, sizeof(cbuf), &cbuf_size, &finished))
+      if (this->compressor->decompress(this->compressor, cbuf, BUFFER_SIZE, &cbuf_size, &finished))
       {
          pgmoneta_log_error("Failed to decompress data in streamer");
          goto error;
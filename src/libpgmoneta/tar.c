@@ -27,19 +27,41 @@
  */
 
 /* pgmoneta */
+#include <aes.h>
+#include <compression.h>
+#include <deque.h>
 #include <logging.h>
 #include <pgmoneta.h>
+#include <stream.h>
 #include <tar.h>
 #include <utils.h>
 
 #include <archive.h>
 #include <archive_entry.h>
 #include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
+/** @struct tar_stream
+ * Read state for a streamed, possibly encrypted and compressed, tar archive
+ */
+struct tar_stream
+{
+   FILE* file;                    /**< The archive file */
+   struct encryptor* encryptor;   /**< The encryptor */
+   struct compressor* compressor; /**< The compressor */
+   bool eof;                      /**< Has the whole file been read */
+   bool pending;                  /**< Does the compressor hold unprocessed input */
+   char in[BUFFER_SIZE];          /**< The raw input buffer */
+   char out[BUFFER_SIZE];         /**< The decoded output buffer */
+};
+
 static int write_tar_file(struct archive* a, char* src, char* dst);
+static la_ssize_t tar_stream_read_cb(struct archive* a, void* arg, const void** buffer);
 
 int
 pgmoneta_tar(char* src, char* dst)
@@ -216,6 +238,189 @@ error:
    return 1;
 }
 
+int
+pgmoneta_untar_stream(char* src, int encryption, int compression, tar_member_cb cb, void* arg)
+{
+   struct archive* a = NULL;
+   struct archive_entry* entry = NULL;
+   struct tar_stream* ts = NULL;
+   char* data = NULL;
+   la_int64_t entry_size = 0;
+   la_ssize_t n = 0;
+   size_t offset = 0;
+   int status;
+
+   if (src == NULL || cb == NULL)
+   {
+      goto error;
+   }
+
+   ts = calloc(1, sizeof(struct tar_stream));
+   if (ts == NULL)
+   {
+      goto error;
+   }
+
+   ts->file = fopen(src, "rb");
+   if (ts->file == NULL)
+   {
+      pgmoneta_log_error("Failed to open the tar file for reading: %s", src);
+      goto error;
+   }
+
+   if (pgmoneta_encryptor_create(encryption, &ts->encryptor))
+   {
+      pgmoneta_log_error("Failed to create encryptor for %s", src);
+      goto error;
+   }
+
+   if (pgmoneta_compressor_create(compression, &ts->compressor))
+   {
+      pgmoneta_log_error("Failed to create compressor for %s", src);
+      goto error;
+   }
+
+   a = archive_read_new();
+   archive_read_support_format_tar(a);
+
+   if (archive_read_open(a, ts, NULL, tar_stream_read_cb, NULL) != ARCHIVE_OK)
+   {
+      pgmoneta_log_error("Failed to open the tar file for reading: %s", archive_error_string(a));
+      goto error;
+   }
+
+   while ((status = archive_read_next_header(a, &entry)) == ARCHIVE_OK)
+   {
+      if (archive_entry_filetype(entry) != AE_IFREG)
+      {
+         continue;
+      }
+
+      entry_size = archive_entry_size(entry);
+      if (entry_size <= 0)
+      {
+         continue;
+      }
+
+      data = malloc((size_t)entry_size);
+      if (data == NULL)
+      {
+         pgmoneta_log_error("Failed to allocate %" PRId64 " bytes for %s", (int64_t)entry_size, archive_entry_pathname(entry));
+         goto error;
+      }
+
+      offset = 0;
+      while (offset < (size_t)entry_size)
+      {
+         n = archive_read_data(a, data + offset, (size_t)entry_size - offset);
+         if (n <= 0)
+         {
+            pgmoneta_log_error("Failed to read entry %s: %s", archive_entry_pathname(entry), archive_error_string(a));
+            goto error;
+         }
+         offset += (size_t)n;
+      }
+
+      if (cb((char*)archive_entry_pathname(entry), data, (size_t)entry_size, arg))
+      {
+         data = NULL;
+         goto error;
+      }
+      data = NULL;
+   }
+
+   if (status != ARCHIVE_EOF)
+   {
+      pgmoneta_log_error("Failed to read the tar file %s: %s", src, archive_error_string(a));
+      goto error;
+   }
+
+   archive_read_close(a);
+   archive_read_free(a);
+
+   pgmoneta_compressor_destroy(ts->compressor);
+   pgmoneta_encryptor_destroy(ts->encryptor);
+   fclose(ts->file);
+   free(ts);
+
+   return 0;
+
+error:
+   free(data);
+   if (a != NULL)
+   {
+      archive_read_close(a);
+      archive_read_free(a);
+   }
+   if (ts != NULL)
+   {
+      pgmoneta_compressor_destroy(ts->compressor);
+      pgmoneta_encryptor_destroy(ts->encryptor);
+      if (ts->file != NULL)
+      {
+         fclose(ts->file);
+      }
+      free(ts);
+   }
+
+   return 1;
+}
+
+static la_ssize_t
+tar_stream_read_cb(struct archive* a, void* arg, const void** buffer)
+{
+   struct tar_stream* ts = (struct tar_stream*)arg;
+   void* dbuf = NULL;
+   size_t dbuf_size = 0;
+   size_t out_size = 0;
+   size_t num_read = 0;
+   bool finished = false;
+
+   while (true)
+   {
+      if (ts->pending)
+      {
+         if (ts->compressor->decompress(ts->compressor, ts->out, sizeof(ts->out), &out_size, &finished))
+         {
+            archive_set_error(a, EIO, "Failed to decompress the tar file");
+            return -1;
+         }
+
+         ts->pending = !finished;
+
+         if (out_size > 0)
+         {
+            *buffer = ts->out;
+            return (la_ssize_t)out_size;
+         }
+
+         continue;
+      }
+
+      if (ts->eof)
+      {
+         return 0;
+      }
+
+      num_read = fread(ts->in, 1, sizeof(ts->in), ts->file);
+      if (ferror(ts->file))
+      {
+         archive_set_error(a, EIO, "Failed to read the tar file");
+         return -1;
+      }
+      ts->eof = feof(ts->file) != 0;
+
+      if (ts->encryptor->decrypt(ts->encryptor, ts->in, num_read, ts->eof, &dbuf, &dbuf_size))
+      {
+         archive_set_error(a, EIO, "Failed to decrypt the tar file");
+         return -1;
+      }
+
+      pgmoneta_compressor_prepare(ts->compressor, dbuf, dbuf_size, ts->eof);
+      ts->pending = true;
+   }
+}
+
 static int
 write_tar_file(struct archive* a, char* src, char* dst)
 {
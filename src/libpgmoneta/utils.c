@@ -1854,7 +1854,7 @@ pgmoneta_count_files(char* directory)
 
    if (pgmoneta_exists(manifest_path))
    {
-      if (!pgmoneta_manifest_get_paths(manifest_path, &paths))
+      if (!pgmoneta_manifest_count_files(manifest_path, &num))
       {
          goto cleanup;
       }
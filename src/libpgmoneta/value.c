@@ -29,6 +29,7 @@
 #include <art.h>
 #include <json.h>
 #include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
 /* System */
@@ -37,6 +38,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+static int value_create(struct memory_arena* arena, enum value_type type, uintptr_t data, struct value_config* config, struct value** value);
+static bool value_in_arena(struct memory_arena* arena, enum value_type type, uintptr_t data);
+static void arena_value_finalize(void* data);
 static void noop_destroy_cb(uintptr_t data);
 static void free_destroy_cb(uintptr_t data);
 static void art_destroy_cb(uintptr_t data);
@@ -63,19 +67,57 @@ static char* mem_to_string_cb(uintptr_t data, int32_t format, char* tag, int ind
 
 int
 pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value)
+{
+   return value_create(NULL, type, data, NULL, value);
+}
+
+int
+pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value)
+{
+   return value_create(NULL, ValueRef, data, config, value);
+}
+
+int
+pgmoneta_value_create_with_arena(struct memory_arena* arena, enum value_type type, uintptr_t data,
+                                 struct value_config* config, struct value** value)
+{
+   return value_create(arena, config != NULL ? ValueRef : type, data, config, value);
+}
+
+int
+pgmoneta_value_destroy(struct value* value)
+{
+   if (value == NULL)
+   {
+      return 0;
+   }
+   value->destroy_data(value->data);
+   if (value->arena != NULL)
+   {
+      // the arena may still hold a finalizer for this value
+      value->destroy_data = noop_destroy_cb;
+      return 0;
+   }
+   free(value);
+   return 0;
+}
+
+static int
+value_create(struct memory_arena* arena, enum value_type type, uintptr_t data, struct value_config* config, struct value** value)
 {
    struct value* val = NULL;
    if (type == ValueNone)
    {
       goto error;
    }
-   val = (struct value*)malloc(sizeof(struct value));
+   val = (struct value*)pgmoneta_memory_alloc(arena, sizeof(struct value));
    if (val == NULL)
    {
       goto error;
    }
    val->data = 0;
    val->type = type;
+   val->arena = arena;
    switch (type)
    {
       case ValueInt8:
@@ -143,13 +185,14 @@ pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value
    switch (type)
    {
       case ValueString:
-      {
-         val->data = (uintptr_t)pgmoneta_append(NULL, (char*)data);
-         val->destroy_data = free_destroy_cb;
-         break;
-      }
       case ValueBASE64:
       {
+         if (arena != NULL)
+         {
+            val->data = data != 0 ? (uintptr_t)pgmoneta_memory_arena_strndup(arena, (char*)data, strlen((char*)data)) : 0;
+            val->destroy_data = noop_destroy_cb;
+            break;
+         }
          val->data = (uintptr_t)pgmoneta_append(NULL, (char*)data);
          val->destroy_data = free_destroy_cb;
          break;
@@ -175,44 +218,34 @@ pgmoneta_value_create(enum value_type type, uintptr_t data, struct value** value
          val->destroy_data = noop_destroy_cb;
          break;
    }
-   *value = val;
-   return 0;
-
-error:
-   return 1;
-}
-
-int
-pgmoneta_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value)
-{
-   if (pgmoneta_value_create(ValueRef, data, value))
-   {
-      return 1;
-   }
    if (config != NULL)
    {
       if (config->destroy_data != NULL)
       {
-         (*value)->destroy_data = config->destroy_data;
+         val->destroy_data = config->destroy_data;
       }
       if (config->to_string != NULL)
       {
-         (*value)->to_string = config->to_string;
+         val->to_string = config->to_string;
       }
    }
-   return 0;
-}
-
-int
-pgmoneta_value_destroy(struct value* value)
-{
-   if (value == NULL)
+   if (arena != NULL && val->destroy_data != noop_destroy_cb)
    {
-      return 0;
+      if (value_in_arena(arena, type, data))
+      {
+         val->destroy_data = noop_destroy_cb;
+      }
+      else if (pgmoneta_memory_arena_defer(arena, arena_value_finalize, val))
+      {
+         goto error;
+      }
    }
-   value->destroy_data(value->data);
-   free(value);
+   *value = val;
    return 0;
+
+error:
+   pgmoneta_memory_release(arena, val);
+   return 1;
 }
 
 uintptr_t
@@ -375,6 +408,32 @@ pgmoneta_value_type_to_string(enum value_type type)
    }
 }
 
+/* Containers of the same arena are released with it */
+static bool
+value_in_arena(struct memory_arena* arena, enum value_type type, uintptr_t data)
+{
+   switch (type)
+   {
+      case ValueJSON:
+         return data == 0 || ((struct json*)data)->arena == arena;
+      case ValueDeque:
+         return data == 0 || ((struct deque*)data)->arena == arena;
+      case ValueART:
+         return data == 0 || ((struct art*)data)->arena == arena;
+      default:
+         return false;
+   }
+}
+
+static void
+arena_value_finalize(void* data)
+{
+   struct value* val = (struct value*)data;
+
+   val->destroy_data(val->data);
+   val->destroy_data = noop_destroy_cb;
+}
+
 static void
 noop_destroy_cb(uintptr_t data)
 {
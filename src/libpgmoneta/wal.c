@@ -29,7 +29,10 @@
 /* pgmoneta */
 #include <pgmoneta.h>
 #include <aes.h>
+#include <bandwidth.h>
 #include <bzip2_compression.h>
+#include <deque.h>
+#include <extraction.h>
 #include <gzip_compression.h>
 #include <logging.h>
 #include <lz4_compression.h>
@@ -39,6 +42,8 @@
 #include <storage.h>
 #include <utils.h>
 #include <wal.h>
+#include <workers.h>
+#include <walfile/wal_summary.h>
 #include <zstandard_compression.h>
 
 /* system */
@@ -77,6 +82,9 @@ static int wal_shipping_setup(int srv, char** wal_shipping);
 static void update_wal_lsn(int srv, size_t xlogptr);
 static void reap_wal_children(int sig);
 static void install_wal_sigchld_handler(void);
+static int wal_segment_parse(char* name, int segsize, uint32_t* tli, uint64_t* segno);
+static void do_wal_stage(struct worker_common* wc);
+static int wal_stage_file(char* from, char* target);
 
 void
 pgmoneta_wal(int srv, char** argv)
@@ -126,6 +134,7 @@ pgmoneta_wal(int srv, char** argv)
    install_wal_sigchld_handler();
 
    pgmoneta_set_proc_title(1, argv, "wal", config->common.servers[srv].name);
+   pgmoneta_bandwidth_begin(srv, BANDWIDTH_WAL);
 
    if (msg == NULL)
    {
@@ -296,6 +305,7 @@ pgmoneta_wal(int srv, char** argv)
    identify_system_response = NULL;
 
    pgmoneta_wal_server_compress_encrypt(srv, argv, NULL);
+   pgmoneta_wal_summarizer(srv, argv);
 
    while (config->running && pgmoneta_server_is_online(srv))
    {
@@ -386,6 +396,8 @@ pgmoneta_wal(int srv, char** argv)
                      pgmoneta_log_error("Incomplete CopyData payload");
                      goto error;
                   }
+                  pgmoneta_bandwidth_consume(msg->length - hdrlen);
+
                   xlogptr = pgmoneta_read_int64(msg->data + 1);
                   xlogoff = wal_xlog_offset(xlogptr, segsize);
 
@@ -537,6 +549,7 @@ pgmoneta_wal(int srv, char** argv)
                         }
 
                         pgmoneta_wal_server_compress_encrypt(srv, argv, wal_filename);
+                        pgmoneta_wal_summarizer(srv, argv);
                         free(wal_filename);
                         wal_filename = NULL;
 
@@ -730,11 +743,13 @@ static void
 reap_wal_children(int sig)
 {
    int status = 0;
+   pid_t pid;
 
    (void)sig;
 
-   while (waitpid(-1, &status, WNOHANG) > 0)
+   while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
    {
+      pgmoneta_wal_summarizer_exited(pid);
    }
 }
 
@@ -917,6 +932,237 @@ pgmoneta_free_timeline_history(struct timeline_history* history)
    }
 }
 
+int
+pgmoneta_wal_restore_plan(int srv, uint64_t start_lsn, uint32_t tli, uint64_t lsn, bool history, struct deque** files)
+{
+   int segsize;
+   uint32_t file_tli;
+   uint64_t segno;
+   uint64_t begin;
+   uint64_t end;
+   uint64_t first;
+   uint64_t last;
+   char* wal_dir = NULL;
+   struct deque* wal_files = NULL;
+   struct deque* result = NULL;
+   struct deque_iterator* it = NULL;
+   struct timeline_history* h = NULL;
+   struct timeline_history* th = NULL;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *files = NULL;
+
+   segsize = config->common.servers[srv].wal_size;
+   wal_dir = pgmoneta_get_server_wal(srv);
+
+   if (segsize <= 0 || pgmoneta_get_wal_files(wal_dir, &wal_files))
+   {
+      goto error;
+   }
+
+   /* The latest timeline is the highest one with a segment or a history file */
+   if (tli == 0)
+   {
+      pgmoneta_deque_iterator_create(wal_files, &it);
+      while (pgmoneta_deque_iterator_next(it))
+      {
+         if (!wal_segment_parse((char*)it->value->data, segsize, &file_tli, &segno))
+         {
+            tli = MAX(tli, file_tli);
+         }
+      }
+      pgmoneta_deque_iterator_destroy(it);
+      it = NULL;
+
+      if ((dir = opendir(wal_dir)) != NULL)
+      {
+         while ((entry = readdir(dir)) != NULL)
+         {
+            if (pgmoneta_ends_with(entry->d_name, ".history") && sscanf(entry->d_name, "%08X", &file_tli) == 1)
+            {
+               tli = MAX(tli, file_tli);
+            }
+         }
+         closedir(dir);
+         dir = NULL;
+      }
+
+      tli = MAX(tli, 1U);
+   }
+
+   if (pgmoneta_get_timeline_history(srv, tli, &h))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_create(false, &result))
+   {
+      goto error;
+   }
+
+   /* Each segment belongs to the timeline that was current at its position on the way to the target */
+   pgmoneta_deque_iterator_create(wal_files, &it);
+   while (pgmoneta_deque_iterator_next(it))
+   {
+      char* name = (char*)it->value->data;
+
+      if (wal_segment_parse(name, segsize, &file_tli, &segno))
+      {
+         continue;
+      }
+
+      begin = 0;
+      end = UINT64_MAX;
+      th = h;
+      while (th != NULL && th->parent_tli != file_tli)
+      {
+         begin = ((uint64_t)th->switchpos_hi << 32) | th->switchpos_lo;
+         th = th->next;
+      }
+
+      if (th != NULL)
+      {
+         end = ((uint64_t)th->switchpos_hi << 32) | th->switchpos_lo;
+      }
+      else if (file_tli != tli)
+      {
+         continue;
+      }
+
+      first = MAX(begin, start_lsn) / (uint64_t)segsize;
+      last = MIN(end, lsn) / (uint64_t)segsize;
+
+      if (MAX(begin, start_lsn) > MIN(end, lsn) || segno < first || segno > last)
+      {
+         continue;
+      }
+
+      if (pgmoneta_deque_add(result, name, (uintptr_t)name, ValueString))
+      {
+         goto error;
+      }
+   }
+   pgmoneta_deque_iterator_destroy(it);
+   it = NULL;
+
+   if (history && (dir = opendir(wal_dir)) != NULL)
+   {
+      while ((entry = readdir(dir)) != NULL)
+      {
+         if (entry->d_type == DT_REG && pgmoneta_ends_with(entry->d_name, ".history"))
+         {
+            if (pgmoneta_deque_add(result, entry->d_name, (uintptr_t)entry->d_name, ValueString))
+            {
+               goto error;
+            }
+         }
+      }
+      closedir(dir);
+      dir = NULL;
+   }
+
+   *files = result;
+
+   pgmoneta_free_timeline_history(h);
+   pgmoneta_deque_destroy(wal_files);
+   free(wal_dir);
+
+   return 0;
+
+error:
+
+   if (dir != NULL)
+   {
+      closedir(dir);
+   }
+   pgmoneta_deque_iterator_destroy(it);
+   pgmoneta_free_timeline_history(h);
+   pgmoneta_deque_destroy(result);
+   pgmoneta_deque_destroy(wal_files);
+   free(wal_dir);
+
+   return 1;
+}
+
+int
+pgmoneta_wal_stage(int srv, struct deque* files, char* target, struct workers* workers)
+{
+   char* wal_dir = NULL;
+   char* from = NULL;
+   char* to = NULL;
+   struct deque_iterator* it = NULL;
+   struct worker_input* wi = NULL;
+
+   wal_dir = pgmoneta_get_server_wal(srv);
+
+   if (pgmoneta_mkdir(target))
+   {
+      goto error;
+   }
+
+   pgmoneta_deque_iterator_create(files, &it);
+   while (pgmoneta_deque_iterator_next(it))
+   {
+      char* name = (char*)it->value->data;
+
+      from = pgmoneta_append(from, wal_dir);
+      from = pgmoneta_append(from, name);
+
+      to = pgmoneta_append(to, target);
+      if (!pgmoneta_ends_with(to, "/"))
+      {
+         to = pgmoneta_append(to, "/");
+      }
+      to = pgmoneta_append(to, name);
+
+      if (workers != NULL)
+      {
+         if (pgmoneta_create_worker_input(NULL, from, to, 0, workers, &wi))
+         {
+            goto error;
+         }
+
+         if (pgmoneta_workers_outcome_ok(workers))
+         {
+            pgmoneta_workers_add(workers, do_wal_stage, (struct worker_common*)wi);
+         }
+         else
+         {
+            free(wi);
+         }
+         wi = NULL;
+      }
+      else if (wal_stage_file(from, to))
+      {
+         pgmoneta_log_error("WAL staging failed: %s", from);
+         goto error;
+      }
+
+      free(from);
+      free(to);
+      from = NULL;
+      to = NULL;
+   }
+   pgmoneta_deque_iterator_destroy(it);
+
+   free(wal_dir);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(it);
+   free(from);
+   free(to);
+   free(wal_dir);
+
+   return 1;
+}
+
 static int
 wal_fetch_history(char* basedir, int timeline, SSL* ssl, int socket)
 {
@@ -1293,7 +1539,7 @@ pgmoneta_read_mappings_from_json(char* mappings_path)
    object_type current_type;
    char* sections[] = {"tablespaces", "databases", "relations"};
 
-   if (pgmoneta_json_read_file(mappings_path, &root))
+   if (pgmoneta_json_read_file_arena(mappings_path, &root))
    {
       pgmoneta_log_error("Failed to read mappings file: %s", mappings_path);
       goto error;
@@ -1356,7 +1602,7 @@ pgmoneta_read_mappings_from_json(char* mappings_path)
             }
             while (pgmoneta_json_iterator_next(iter))
             {
-               struct json* item = (struct json*)iter->value;
+               struct json* item = (struct json*)iter->value->data;
                if (item == NULL || item->type != JSONItem)
                {
                   pgmoneta_json_iterator_destroy(iter);
@@ -1912,3 +2158,48 @@ retry:
       exit(0);
    }
 }
+
+static int
+wal_segment_parse(char* name, int segsize, uint32_t* tli, uint64_t* segno)
+{
+   uint32_t high32 = 0;
+   uint32_t low32 = 0;
+
+   if (strlen(name) < 24 || sscanf(name, "%08X%08X%08X", tli, &high32, &low32) != 3)
+   {
+      return 1;
+   }
+
+   *segno = (uint64_t)high32 * (0x100000000ULL / (uint64_t)segsize) + low32;
+
+   return 0;
+}
+
+static void
+do_wal_stage(struct worker_common* wc)
+{
+   struct worker_input* wi = (struct worker_input*)wc;
+
+   if (wal_stage_file(wi->from, wi->to))
+   {
+      pgmoneta_record_failure(wi->common.workers->outcome, "WAL staging failed: %s", wi->from);
+   }
+
+   free(wi);
+}
+
+static int
+wal_stage_file(char* from, char* target)
+{
+   char* to = NULL;
+   int ret;
+
+   to = pgmoneta_append(to, target);
+
+   /* Decrypt and decompress in one pass straight into the target */
+   ret = pgmoneta_extract_file(from, 0, true, NULL, &to);
+
+   free(to);
+
+   return ret;
+}
@@ -0,0 +1,697 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgmoneta */
+#include <pgmoneta.h>
+#include <bandwidth.h>
+#include <deque.h>
+#include <files.h>
+#include <logging.h>
+#include <storage.h>
+#include <utils.h>
+#include <walarchive.h>
+#include <workers.h>
+
+/* system */
+#include <dirent.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct wal_archive_task
+{
+   struct worker_common common;
+   int server;
+   char directory[MAX_PATH];
+   char file[MISC_LENGTH];
+   struct deque* group;
+   bool* done;
+};
+
+static char* wal_archive_cursor_file(int server);
+static bool wal_archive_segment(char* file, char* segment);
+static int wal_archive_upload(int server, char* directory, char* file);
+static int wal_archive_dispatch(struct workers* workers, struct wal_archive_task* task);
+static void do_wal_archive(struct worker_common* wc);
+
+void
+pgmoneta_wal_archive(char** argv)
+{
+   bool failed = false;
+   struct main_configuration* config;
+
+   pgmoneta_start_logging();
+
+   config = (struct main_configuration*)shmem;
+
+   pgmoneta_set_proc_title(1, argv, "wal archive", NULL);
+
+   for (int server = 0; server < config->common.number_of_servers; server++)
+   {
+      bool active = false;
+
+      if (!atomic_compare_exchange_strong(&config->common.servers[server].wal_archive, &active, true))
+      {
+         pgmoneta_log_debug("WAL archive: Server %s is active", config->common.servers[server].name);
+         continue;
+      }
+
+      if (pgmoneta_wal_archive_server(server))
+      {
+         failed = true;
+      }
+
+      atomic_store(&config->common.servers[server].wal_archive, false);
+   }
+
+   pgmoneta_stop_logging();
+
+   exit(failed ? 1 : 0);
+}
+
+int
+pgmoneta_wal_archive_server(int server)
+{
+   int number_of_workers = 0;
+   int number_of_segments = 0;
+   int archived = 0;
+   char* d = NULL;
+   char* suffix = NULL;
+   char* path = NULL;
+   char segment[MISC_LENGTH];
+   bool small_ok = true;
+   bool throttled = false;
+   time_t start;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   struct stat st;
+   struct wal_archive_cursor cursor;
+   struct deque* segments = NULL;
+   struct deque* small = NULL;
+   struct deque_iterator* iter = NULL;
+   struct workers* workers = NULL;
+   struct wal_archive_task* task = NULL;
+   bool* done = NULL;
+   bool* group_done = NULL;
+   int number_of_groups = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   start = time(NULL);
+
+   if (pgmoneta_wal_archive_read_cursor(server, &cursor))
+   {
+      goto error;
+   }
+
+   d = pgmoneta_get_server_wal(server);
+
+   if (pgmoneta_extraction_get_suffix(config->compression_type, config->common.encryption, &suffix))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_create(false, &segments) || pgmoneta_deque_create(false, &small))
+   {
+      goto error;
+   }
+
+   if (!(dir = opendir(d)))
+   {
+      pgmoneta_log_debug("WAL archive: Unable to open %s", d);
+      goto done;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (entry->d_type != DT_REG)
+      {
+         continue;
+      }
+
+      if (pgmoneta_ends_with(entry->d_name, ".partial"))
+      {
+         /* The segment being streamed, uploaded again on every run */
+         pgmoneta_deque_add(small, NULL, (uintptr_t)entry->d_name, ValueString);
+      }
+      else if (strstr(entry->d_name, ".history") != NULL)
+      {
+         path = pgmoneta_append(NULL, d);
+         path = pgmoneta_append(path, entry->d_name);
+
+         if (strlen(cursor.segment) == 0 || (stat(path, &st) == 0 && st.st_mtime >= cursor.updated))
+         {
+            pgmoneta_deque_add(small, NULL, (uintptr_t)entry->d_name, ValueString);
+         }
+
+         free(path);
+         path = NULL;
+      }
+      else if (wal_archive_segment(entry->d_name, &segment[0]))
+      {
+         /* Only finished segments, once they have been compressed and encrypted */
+         if (strlen(entry->d_name) != strlen(segment) + (suffix != NULL ? strlen(suffix) : 0) ||
+             (suffix != NULL && !pgmoneta_ends_with(entry->d_name, suffix)))
+         {
+            continue;
+         }
+
+         if (strcmp(segment, cursor.segment) > 0)
+         {
+            pgmoneta_deque_add(segments, entry->d_name, (uintptr_t)entry->d_name, ValueString);
+         }
+      }
+   }
+
+   closedir(dir);
+   dir = NULL;
+
+   pgmoneta_deque_sort(segments, NULL);
+
+   number_of_segments = (int)pgmoneta_deque_size(segments);
+   number_of_groups = ((int)pgmoneta_deque_size(small) + WAL_ARCHIVE_GROUP - 1) / WAL_ARCHIVE_GROUP;
+
+   if (number_of_segments == 0 && number_of_groups == 0)
+   {
+      goto done;
+   }
+
+   done = (bool*)calloc(number_of_segments + 1, sizeof(bool));
+   group_done = (bool*)calloc(number_of_groups + 1, sizeof(bool));
+   if (done == NULL || group_done == NULL)
+   {
+      goto error;
+   }
+
+   number_of_workers = pgmoneta_get_number_of_workers(server);
+   if (number_of_workers > 0)
+   {
+      pgmoneta_workers_initialize(number_of_workers, &workers);
+   }
+
+   pgmoneta_bandwidth_begin(server, BANDWIDTH_TRANSFER);
+   throttled = true;
+
+   /* Segments go out in order, and as many at a time as there are workers */
+   pgmoneta_deque_iterator_create(segments, &iter);
+   for (int i = 0; pgmoneta_deque_iterator_next(iter); i++)
+   {
+      task = (struct wal_archive_task*)calloc(1, sizeof(struct wal_archive_task));
+      if (task == NULL)
+      {
+         goto error;
+      }
+
+      task->common.workers = workers;
+      task->server = server;
+      task->done = &done[i];
+      pgmoneta_snprintf(task->directory, sizeof(task->directory), "%s", d);
+      pgmoneta_snprintf(task->file, sizeof(task->file), "%s", iter->tag);
+
+      if (wal_archive_dispatch(workers, task))
+      {
+         task = NULL;
+         goto error;
+      }
+      task = NULL;
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   /* The .history and .partial files are small, so they share tasks */
+   pgmoneta_deque_iterator_create(small, &iter);
+   for (int i = 0; i < number_of_groups; i++)
+   {
+      task = (struct wal_archive_task*)calloc(1, sizeof(struct wal_archive_task));
+      if (task == NULL || pgmoneta_deque_create(false, &task->group))
+      {
+         goto error;
+      }
+
+      task->common.workers = workers;
+      task->server = server;
+      task->done = &group_done[i];
+      pgmoneta_snprintf(task->directory, sizeof(task->directory), "%s", d);
+
+      for (int j = 0; j < WAL_ARCHIVE_GROUP && pgmoneta_deque_iterator_next(iter); j++)
+      {
+         pgmoneta_deque_add(task->group, NULL, (uintptr_t)pgmoneta_value_data(iter->value), ValueString);
+      }
+
+      if (wal_archive_dispatch(workers, task))
+      {
+         task = NULL;
+         goto error;
+      }
+      task = NULL;
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+   workers = NULL;
+
+   pgmoneta_bandwidth_end();
+   throttled = false;
+
+   /* The cursor only moves past segments that were uploaded without a gap */
+   pgmoneta_deque_iterator_create(segments, &iter);
+   for (int i = 0; i < number_of_segments && done[i] && pgmoneta_deque_iterator_next(iter); i++)
+   {
+      wal_archive_segment(iter->tag, &cursor.segment[0]);
+      archived++;
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   for (int i = 0; i < number_of_groups; i++)
+   {
+      if (!group_done[i])
+      {
+         small_ok = false;
+      }
+   }
+
+   if (archived > 0 || small_ok)
+   {
+      if (small_ok)
+      {
+         cursor.updated = start;
+      }
+
+      if (pgmoneta_wal_archive_write_cursor(server, &cursor))
+      {
+         goto error;
+      }
+   }
+
+   if (archived > 0)
+   {
+      pgmoneta_log_debug("WAL archive: %s archived %d of %d segments up to %s",
+                         config->common.servers[server].name, archived, number_of_segments, cursor.segment);
+   }
+
+   if (archived < number_of_segments || !small_ok)
+   {
+      pgmoneta_log_warn("WAL archive: %s has %d segments left to upload",
+                        config->common.servers[server].name, number_of_segments - archived);
+      goto error;
+   }
+
+done:
+
+   free(d);
+   free(suffix);
+   free(done);
+   free(group_done);
+   pgmoneta_deque_destroy(segments);
+   pgmoneta_deque_destroy(small);
+
+   return 0;
+
+error:
+
+   if (dir != NULL)
+   {
+      closedir(dir);
+   }
+
+   if (task != NULL)
+   {
+      pgmoneta_deque_destroy(task->group);
+      free(task);
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_workers_wait(workers);
+   pgmoneta_workers_destroy(workers);
+
+   if (throttled)
+   {
+      pgmoneta_bandwidth_end();
+   }
+
+   free(path);
+   free(d);
+   free(suffix);
+   free(done);
+   free(group_done);
+   pgmoneta_deque_destroy(segments);
+   pgmoneta_deque_destroy(small);
+
+   return 1;
+}
+
+bool
+pgmoneta_wal_archive_enabled(void)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   return pgmoneta_time_convert(config->wal_archive, FORMAT_TIME_S) > 0 &&
+          (config->storage_engine & (STORAGE_ENGINE_S3 | STORAGE_ENGINE_AZURE)) != 0;
+}
+
+int
+pgmoneta_wal_archive_read_cursor(int server, struct wal_archive_cursor* cursor)
+{
+   char* f = NULL;
+   char line[MISC_LENGTH];
+   long long updated = 0;
+   FILE* file = NULL;
+
+   memset(cursor, 0, sizeof(struct wal_archive_cursor));
+
+   f = wal_archive_cursor_file(server);
+   if (f == NULL)
+   {
+      goto error;
+   }
+
+   file = fopen(f, "r");
+   if (file == NULL)
+   {
+      free(f);
+      return 0;
+   }
+
+   memset(&line[0], 0, sizeof(line));
+   if (fgets(&line[0], sizeof(line), file) != NULL)
+   {
+      if (sscanf(&line[0], "%24s %lld", &cursor->segment[0], &updated) != 2 ||
+          !pgmoneta_is_wal_file(&cursor->segment[0]))
+      {
+         pgmoneta_log_warn("WAL archive: Invalid cursor in %s", f);
+         memset(cursor, 0, sizeof(struct wal_archive_cursor));
+      }
+      else
+      {
+         cursor->updated = (time_t)updated;
+      }
+   }
+
+   fclose(file);
+   free(f);
+
+   return 0;
+
+error:
+
+   free(f);
+
+   return 1;
+}
+
+int
+pgmoneta_wal_archive_write_cursor(int server, struct wal_archive_cursor* cursor)
+{
+   char* f = NULL;
+   char* tmp = NULL;
+   FILE* file = NULL;
+
+   f = wal_archive_cursor_file(server);
+   if (f == NULL)
+   {
+      goto error;
+   }
+
+   tmp = pgmoneta_append(tmp, f);
+   tmp = pgmoneta_append(tmp, ".tmp");
+
+   file = fopen(tmp, "w");
+   if (file == NULL)
+   {
+      pgmoneta_log_warn("WAL archive: Unable to write %s: %s", tmp, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   fprintf(file, "%s %lld\n", cursor->segment, (long long)cursor->updated);
+
+   /* The cursor must never be ahead of what is on disk after a crash */
+   if (fflush(file) || fsync(fileno(file)) || fclose(file) || rename(tmp, f))
+   {
+      file = NULL;
+      pgmoneta_log_warn("WAL archive: Unable to write %s: %s", f, strerror(errno));
+      errno = 0;
+      goto error;
+   }
+
+   free(tmp);
+   free(f);
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(tmp);
+   free(f);
+
+   return 1;
+}
+
+bool
+pgmoneta_wal_archive_is_archived(int server, char* file)
+{
+   char segment[MISC_LENGTH];
+   struct wal_archive_cursor cursor;
+
+   if (!pgmoneta_wal_archive_enabled())
+   {
+      return true;
+   }
+
+   if (!wal_archive_segment(file, &segment[0]))
+   {
+      return true;
+   }
+
+   if (pgmoneta_wal_archive_read_cursor(server, &cursor))
+   {
+      return false;
+   }
+
+   return strlen(cursor.segment) > 0 && strcmp(segment, cursor.segment) <= 0;
+}
+
+int
+pgmoneta_wal_archive_lag(int server, uint64_t* seconds, uint64_t* bytes)
+{
+   char* d = NULL;
+   char* path = NULL;
+   char segment[MISC_LENGTH];
+   time_t oldest = 0;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   struct stat st;
+   struct wal_archive_cursor cursor;
+
+   *seconds = 0;
+   *bytes = 0;
+
+   if (!pgmoneta_wal_archive_enabled())
+   {
+      return 0;
+   }
+
+   if (pgmoneta_wal_archive_read_cursor(server, &cursor))
+   {
+      goto error;
+   }
+
+   d = pgmoneta_get_server_wal(server);
+
+   if (!(dir = opendir(d)))
+   {
+      free(d);
+      return 0;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (entry->d_type != DT_REG ||
+          pgmoneta_ends_with(entry->d_name, ".partial") ||
+          !wal_archive_segment(entry->d_name, &segment[0]) ||
+          strcmp(segment, cursor.segment) <= 0)
+      {
+         continue;
+      }
+
+      path = pgmoneta_append(NULL, d);
+      path = pgmoneta_append(path, entry->d_name);
+
+      if (stat(path, &st) == 0)
+      {
+         *bytes += (uint64_t)st.st_size;
+
+         if (oldest == 0 || st.st_mtime < oldest)
+         {
+            oldest = st.st_mtime;
+         }
+      }
+
+      free(path);
+      path = NULL;
+   }
+
+   closedir(dir);
+
+   if (oldest > 0 && time(NULL) > oldest)
+   {
+      *seconds = (uint64_t)(time(NULL) - oldest);
+   }
+
+   free(d);
+
+   return 0;
+
+error:
+
+   free(d);
+
+   return 1;
+}
+
+static char*
+wal_archive_cursor_file(int server)
+{
+   char* f = NULL;
+
+   f = pgmoneta_get_server(server);
+   if (f == NULL)
+   {
+      return NULL;
+   }
+
+   f = pgmoneta_append(f, WAL_ARCHIVE_CURSOR);
+
+   return f;
+}
+
+static bool
+wal_archive_segment(char* file, char* segment)
+{
+   if (file == NULL || strlen(file) < 24)
+   {
+      return false;
+   }
+
+   memset(segment, 0, MISC_LENGTH);
+   memcpy(segment, file, 24);
+
+   if (!pgmoneta_is_wal_file(segment))
+   {
+      memset(segment, 0, MISC_LENGTH);
+      return false;
+   }
+
+   return true;
+}
+
+static int
+wal_archive_upload(int server, char* directory, char* file)
+{
+   int engines[] = {STORAGE_ENGINE_S3, STORAGE_ENGINE_AZURE};
+
+   for (int i = 0; i < (int)(sizeof(engines) / sizeof(engines[0])); i++)
+   {
+      if (!pgmoneta_is_storage_engine_enabled(engines[i]))
+      {
+         continue;
+      }
+
+      if (pgmoneta_storage_upload_wal(server, engines[i], directory, file))
+      {
+         pgmoneta_log_error("WAL archive: Unable to upload %s%s", directory, file);
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+static int
+wal_archive_dispatch(struct workers* workers, struct wal_archive_task* task)
+{
+   if (workers != NULL)
+   {
+      if (pgmoneta_workers_add(workers, do_wal_archive, (struct worker_common*)task))
+      {
+         pgmoneta_deque_destroy(task->group);
+         free(task);
+         return 1;
+      }
+   }
+   else
+   {
+      do_wal_archive((struct worker_common*)task);
+   }
+
+   return 0;
+}
+
+static void
+do_wal_archive(struct worker_common* wc)
+{
+   bool ok = true;
+   struct deque_iterator* iter = NULL;
+   struct wal_archive_task* task = (struct wal_archive_task*)wc;
+
+   if (task->group != NULL)
+   {
+      pgmoneta_deque_iterator_create(task->group, &iter);
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         if (wal_archive_upload(task->server, task->directory, (char*)pgmoneta_value_data(iter->value)))
+         {
+            ok = false;
+         }
+      }
+      pgmoneta_deque_iterator_destroy(iter);
+   }
+   else if (wal_archive_upload(task->server, task->directory, task->file))
+   {
+      ok = false;
+   }
+
+   *task->done = ok;
+
+   pgmoneta_deque_destroy(task->group);
+   free(task);
+}
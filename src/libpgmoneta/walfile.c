@@ -35,7 +35,7 @@
 #include <dirent.h>
 #include <libgen.h>
 
-struct partial_xlog_record* partial_record = NULL;
+_Thread_local struct partial_xlog_record* partial_record = NULL;
 
 /**
  * Validate if a WAL file exists and is accessible before processing.
@@ -75,23 +75,11 @@ error:
    return error_code;
 }
 
-int
-pgmoneta_read_walfile(int server, char* path, struct walfile** wf)
+static int
+create_walfile(struct walfile** wf)
 {
-   int error_code = PGMONETA_WAL_SUCCESS;
    struct walfile* new_wf = NULL;
-   int validation_status = validate_wal_file(path);
-   if (validation_status != PGMONETA_WAL_SUCCESS)
-   {
-      return validation_status;
-   }
-
-   if (!pgmoneta_is_file(path))
-   {
-      pgmoneta_log_error("WAL file does not exist: %s", path);
-      error_code = PGMONETA_WAL_ERR_IO;
-      goto error;
-   }
+   int error_code = PGMONETA_WAL_SUCCESS;
 
    new_wf = calloc(1, sizeof(struct walfile));
    if (!new_wf)
@@ -115,22 +103,31 @@ pgmoneta_read_walfile(int server, char* path, struct walfile** wf)
       goto error;
    }
 
-   if (pgmoneta_wal_parse_wal_file(path, server, new_wf))
+   *wf = new_wf;
+
+   return PGMONETA_WAL_SUCCESS;
+
+error:
+   if (new_wf)
    {
-      pgmoneta_log_error("Failed to parse WAL file: %s", path);
-      error_code = PGMONETA_WAL_ERR_FORMAT;
-      goto error;
+      pgmoneta_destroy_walfile(new_wf);
    }
+   return error_code;
+}
 
+static void
+process_xid_timestamps(struct walfile* wf)
+{
    struct deque_iterator* record_iterator = NULL;
-   if (pgmoneta_deque_iterator_create(new_wf->records, &record_iterator) == 0)
+
+   if (pgmoneta_deque_iterator_create(wf->records, &record_iterator) == 0)
    {
       while (pgmoneta_deque_iterator_next(record_iterator))
       {
          struct decoded_xlog_record* record = (struct decoded_xlog_record*)record_iterator->value->data;
          if (!record->partial)
          {
-            if (pgmoneta_process_xid_timestamp(record, new_wf->xid_ts_map))
+            if (pgmoneta_process_xid_timestamp(record, wf->xid_ts_map))
             {
                pgmoneta_log_warn("Failed to process XID timestamp for record");
             }
@@ -139,7 +136,41 @@ pgmoneta_read_walfile(int server, char* path, struct walfile** wf)
       pgmoneta_deque_iterator_destroy(record_iterator);
    }
 
-   pgmoneta_log_debug("Created XID timestamp map with %zu entries", pgmoneta_xid_timestamp_map_size(new_wf->xid_ts_map));
+   pgmoneta_log_debug("Created XID timestamp map with %zu entries", pgmoneta_xid_timestamp_map_size(wf->xid_ts_map));
+}
+
+int
+pgmoneta_read_walfile(int server, char* path, struct walfile** wf)
+{
+   int error_code = PGMONETA_WAL_SUCCESS;
+   struct walfile* new_wf = NULL;
+   int validation_status = validate_wal_file(path);
+   if (validation_status != PGMONETA_WAL_SUCCESS)
+   {
+      return validation_status;
+   }
+
+   if (!pgmoneta_is_file(path))
+   {
+      pgmoneta_log_error("WAL file does not exist: %s", path);
+      error_code = PGMONETA_WAL_ERR_IO;
+      goto error;
+   }
+
+   error_code = create_walfile(&new_wf);
+   if (error_code != PGMONETA_WAL_SUCCESS)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_wal_parse_wal_file(path, server, new_wf))
+   {
+      pgmoneta_log_error("Failed to parse WAL file: %s", path);
+      error_code = PGMONETA_WAL_ERR_FORMAT;
+      goto error;
+   }
+
+   process_xid_timestamps(new_wf);
 
    *wf = new_wf;
 
@@ -153,6 +184,58 @@ error:
    return error_code;
 }
 
+int
+pgmoneta_read_walfile_buffer(int server, char* name, void* data, size_t size, struct walfile** wf)
+{
+   int error_code = PGMONETA_WAL_SUCCESS;
+   struct walfile* new_wf = NULL;
+
+   if (name == NULL || data == NULL || size == 0 || wf == NULL)
+   {
+      return PGMONETA_WAL_ERR_PARAM;
+   }
+
+   error_code = create_walfile(&new_wf);
+   if (error_code != PGMONETA_WAL_SUCCESS)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_wal_parse_wal_buffer(name, data, size, server, new_wf))
+   {
+      pgmoneta_log_error("Failed to parse WAL segment: %s", name);
+      error_code = PGMONETA_WAL_ERR_FORMAT;
+      goto error;
+   }
+
+   process_xid_timestamps(new_wf);
+
+   *wf = new_wf;
+
+   return PGMONETA_WAL_SUCCESS;
+
+error:
+   if (new_wf)
+   {
+      pgmoneta_destroy_walfile(new_wf);
+   }
+   return error_code;
+}
+
+void
+pgmoneta_reset_partial_record(void)
+{
+   if (partial_record == NULL)
+   {
+      return;
+   }
+
+   free(partial_record->xlog_record);
+   free(partial_record->data_buffer);
+   free(partial_record);
+   partial_record = NULL;
+}
+
 int
 pgmoneta_write_walfile(struct walfile* wf, int server __attribute__((unused)), char* path)
 {
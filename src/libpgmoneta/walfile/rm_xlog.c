@@ -398,11 +398,12 @@ timestamptz_to_time_t(timestamp_tz t)
 char*
 pgmoneta_wal_timestamptz_to_str(timestamp_tz dt)
 {
-   static char buf[MAXDATELEN + 1];
+   static _Thread_local char buf[MAXDATELEN + 1];
    char ts[MAXDATELEN + 1];
    char zone[MAXDATELEN + 1];
    time_t result = (time_t)timestamptz_to_time_t(dt);
-   struct tm* ltime = localtime(&result);
+   struct tm tm_buf;
+   struct tm* ltime = localtime_r(&result, &tm_buf);
 
    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", ltime);
    strftime(zone, sizeof(zone), "%Z", ltime);
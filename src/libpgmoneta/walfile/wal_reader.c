@@ -49,10 +49,20 @@
 #include <assert.h>
 #include <libgen.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-struct server* server_config;
-static uint16_t current_wal_magic = 0;
+/* Power of two, so a slot index is a mask of the hash */
+#define XID_TIMESTAMP_MAP_INITIAL_CAPACITY 64
+/* Grow once the map is 7/10 full */
+#define XID_TIMESTAMP_MAP_LOAD_NUMERATOR   7
+#define XID_TIMESTAMP_MAP_LOAD_DENOMINATOR 10
+
+_Thread_local struct server* server_config = NULL;
+/* The server of a thread decoding WAL that does not belong to a configured server */
+static _Thread_local struct server* standalone_server = NULL;
+static _Thread_local uint16_t current_wal_magic = 0;
+static _Thread_local uint32_t current_display_count = 0;
 
 void
 pgmoneta_wal_set_current_magic(uint16_t magic_value)
@@ -66,13 +76,39 @@ pgmoneta_wal_get_current_magic(void)
    return current_wal_magic;
 }
 
+void
+pgmoneta_wal_set_display_count(uint32_t count)
+{
+   current_display_count = count;
+}
+
+uint32_t
+pgmoneta_wal_get_display_count(void)
+{
+   return current_display_count;
+}
+
+void
+pgmoneta_wal_reset_server(void)
+{
+   if (server_config == standalone_server)
+   {
+      server_config = NULL;
+   }
+
+   free(standalone_server);
+   standalone_server = NULL;
+}
+
+static int parse_wal_stream(char* path, FILE* file, int server, struct walfile* wal_file);
 static int decode_xlog_record(char* buffer, struct decoded_xlog_record* decoded, struct xlog_record* record, uint32_t block_size, uint16_t magic_value, xlog_rec_ptr lsn);
 static void record_json(struct decoded_xlog_record* record, uint8_t magic_value, struct xid_timestamp_map* xid_ts_map, struct value** value);
 static bool get_record_block_tag_extended(struct decoded_xlog_record* pRecord, int id, struct rel_file_locator* pLocator, enum fork_number* pNumber, block_number* pInt, buffer* pVoid);
 static int magic_value_to_postgres_version(uint16_t magic_value);
-static int compare_xid_timestamp_entries(struct value* a, struct value* b);
-static void xid_timestamp_entry_destroy(uintptr_t data);
-static void pgmoneta_xid_timestamp_map_sort(struct xid_timestamp_map* map);
+static inline size_t xid_timestamp_map_hash(transaction_id xid);
+static void xid_timestamp_map_insert(struct xid_timestamp_map* map, transaction_id xid, timestamp_tz timestamp);
+static int xid_timestamp_map_reserve(struct xid_timestamp_map* map, size_t entries);
+static int compare_xid_timestamp_entries(const void* a, const void* b);
 static int add_xid_and_subxacts_to_map(transaction_id main_xid, transaction_id* subxacts, int nsubxacts, timestamp_tz timestamp, struct xid_timestamp_map* map);
 static int process_commit_record(struct xl_xact_commit* xlrec, uint8_t xl_info, transaction_id xid, bool use_v15_parser, struct xid_timestamp_map* map);
 static int process_abort_record(struct xl_xact_abort* xlrec, uint8_t xl_info, transaction_id xid, bool use_v15_parser, struct xid_timestamp_map* map);
@@ -273,6 +309,61 @@ pgmoneta_validate_wal_filename(char* path, char** base_filename, xlog_seg_no* se
 
 int
 pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
+{
+   FILE* file = NULL;
+   int ret;
+
+   if (pgmoneta_validate_wal_filename(path, NULL, NULL, 0))
+   {
+      pgmoneta_log_error("Error: Invalid WAL file name: %s", path);
+      return 1;
+   }
+
+   file = fopen(path, "rb");
+   if (file == NULL)
+   {
+      pgmoneta_log_fatal("Error: Could not open file %s", path);
+      return 1;
+   }
+
+   ret = parse_wal_stream(path, file, server, wal_file);
+
+   fclose(file);
+   return ret;
+}
+
+int
+pgmoneta_wal_parse_wal_buffer(char* name, void* data, size_t size, int server, struct walfile* wal_file)
+{
+   FILE* file = NULL;
+   int ret;
+
+   if (name == NULL || data == NULL || size == 0)
+   {
+      return 1;
+   }
+
+   if (pgmoneta_validate_wal_filename(name, NULL, NULL, 0))
+   {
+      pgmoneta_log_error("Error: Invalid WAL file name: %s", name);
+      return 1;
+   }
+
+   file = fmemopen(data, size, "rb");
+   if (file == NULL)
+   {
+      pgmoneta_log_fatal("Error: Could not open WAL buffer for %s", name);
+      return 1;
+   }
+
+   ret = parse_wal_stream(name, file, server, wal_file);
+
+   fclose(file);
+   return ret;
+}
+
+static int
+parse_wal_stream(char* path, FILE* file, int server, struct walfile* wal_file)
 {
 #define MALLOC(pointer, size)                                                  \
    pointer = malloc(size);                                                     \
@@ -300,7 +391,6 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
    xlog_rec_ptr* lsn_array = NULL;
    size_t lsn_array_size = 0;
    size_t lsn_array_capacity = 100;
-   FILE* file = NULL;
 
    /* Allocate partial_record if not already allocated */
    if (partial_record == NULL)
@@ -315,6 +405,7 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
       partial_record->xlog_record = NULL;
       partial_record->data_buffer_bytes_read = 0;
       partial_record->xlog_record_bytes_read = 0;
+      partial_record->lsn = 0;
    }
 
    lsn_array = malloc(lsn_array_capacity * sizeof(xlog_rec_ptr));
@@ -326,19 +417,6 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
 
    config = (struct walinfo_configuration*)shmem;
 
-   if (pgmoneta_validate_wal_filename(path, NULL, NULL, 0))
-   {
-      pgmoneta_log_error("Error: Invalid WAL file name: %s", path);
-      goto error;
-   }
-
-   file = fopen(path, "rb");
-   if (file == NULL)
-   {
-      pgmoneta_log_fatal("Error: Could not open file %s", path);
-      goto error;
-   }
-
    // calculate the size of the file
    fseek(file, 0, SEEK_END);
    wal_segz_bytes = ftell(file);
@@ -368,8 +446,21 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
 
    if (server == -1)
    {
-      config->common.servers[0].version = pg_version;
-      server_config = &config->common.servers[0];
+      /* The version comes from the WAL, so keep it per thread instead of in the shared configuration */
+      if (standalone_server == NULL)
+      {
+         standalone_server = calloc(1, sizeof(struct server));
+         if (standalone_server == NULL)
+         {
+            pgmoneta_log_error("Error: Could not allocate memory for the server");
+            goto error;
+         }
+      }
+
+      standalone_server->valid = config->common.servers[0].valid;
+      standalone_server->track_commit_timestamp = config->common.servers[0].track_commit_timestamp;
+      standalone_server->version = pg_version;
+      server_config = standalone_server;
    }
    else
    {
@@ -390,8 +481,9 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
 
    if (long_header->std.xlp_rem_len > 0)
    {
+      /* The page headers were read above, so the continuation starts right after the long header */
       next_record = MAXALIGN(
-         ftell(file) +
+         SIZE_OF_XLOG_LONG_PHD +
          ((long_header->std.xlp_rem_len / long_header->xlp_xlog_blcksz) * SIZE_OF_XLOG_SHORT_PHD) +
          long_header->std.xlp_rem_len % long_header->xlp_xlog_blcksz);
 
@@ -487,6 +579,7 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
             MALLOC(partial_record->xlog_record, SIZE_OF_XLOG_RECORD);
             memcpy(partial_record->xlog_record, temp_buffer, bytes_read);
             partial_record->xlog_record_bytes_read = bytes_read;
+            partial_record->lsn = base + next_record;
             free(temp_buffer);
             temp_buffer = NULL;
             decoded = NULL;
@@ -532,7 +625,7 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
          break;
       }
       uint32_t data_length = record->xl_tot_len - SIZE_OF_XLOG_RECORD;
-      xlog_rec_ptr lsn = ftell(file) + base - SIZE_OF_XLOG_RECORD;
+      xlog_rec_ptr lsn = initialized ? partial_record->lsn : ftell(file) + base - SIZE_OF_XLOG_RECORD;
       next_record = ftell(file) + MAXALIGN(record->xl_tot_len - SIZE_OF_XLOG_RECORD);
       uint32_t end_of_page = (page_number + 1) * wal_file->long_phd->xlp_xlog_blcksz;
 
@@ -555,6 +648,7 @@ pgmoneta_wal_parse_wal_file(char* path, int server, struct walfile* wal_file)
                MALLOC(partial_record->xlog_record, SIZE_OF_XLOG_RECORD);
                memcpy(partial_record->xlog_record, record, SIZE_OF_XLOG_RECORD);
                partial_record->xlog_record_bytes_read = SIZE_OF_XLOG_RECORD;
+               partial_record->lsn = lsn;
                if (total_bytes_read != 0)
                {
                   MALLOC(partial_record->data_buffer, total_bytes_read);
@@ -671,7 +765,6 @@ finish:
    free(lsn_array);
    lsn_array = NULL;
 
-   fclose(file);
    return 0;
 
 error:
@@ -687,10 +780,6 @@ error:
    free(lsn_array);
    lsn_array = NULL;
 
-   if (file != NULL)
-   {
-      fclose(file);
-   }
    pgmoneta_log_fatal("Error: Could not parse WAL file");
    return 1;
 }
@@ -1549,7 +1638,6 @@ pgmoneta_wal_record_display(struct decoded_xlog_record* record, uint16_t magic_v
                             struct deque* xids, uint32_t limit, char** included_objects, struct column_widths* widths,
                             struct xid_timestamp_map* xid_ts_map)
 {
-   static uint32_t current_limit = 0;
    char* header_str = NULL;
    char* rm_desc = NULL;
    char* backup_str = NULL;
@@ -1600,8 +1688,8 @@ pgmoneta_wal_record_display(struct decoded_xlog_record* record, uint16_t magic_v
       free(record_desc);
    }
 
-   current_limit++;
-   if (limit > 0 && current_limit > limit)
+   current_display_count++;
+   if (limit > 0 && current_display_count > limit)
    {
       goto cleanup;
    }
@@ -1610,7 +1698,7 @@ pgmoneta_wal_record_display(struct decoded_xlog_record* record, uint16_t magic_v
    {
       if (!quiet)
       {
-         if (current_limit == 1)
+         if (current_display_count == 1)
          {
             fprintf(out, "{\"Record\": ");
          }
@@ -1728,6 +1816,12 @@ pgmoneta_wal_record_modify_rmgr_occurance(struct decoded_xlog_record* record, ui
 
 void
 pgmoneta_wal_record_collect_stats(struct decoded_xlog_record* record, uint64_t start_lsn, uint64_t end_lsn)
+{
+   pgmoneta_wal_record_collect_stats_into(record, start_lsn, end_lsn, rmgr_stats_table);
+}
+
+void
+pgmoneta_wal_record_collect_stats_into(struct decoded_xlog_record* record, uint64_t start_lsn, uint64_t end_lsn, struct rmgr_stats* stats)
 {
    uint64_t rec_len;
    uint64_t fpi_len = 0;
@@ -1749,10 +1843,27 @@ pgmoneta_wal_record_collect_stats(struct decoded_xlog_record* record, uint64_t s
       }
    }
 
-   rmgr_stats_table[record->header.xl_rmid].count++;
-   rmgr_stats_table[record->header.xl_rmid].record_size += (rec_len - fpi_len);
-   rmgr_stats_table[record->header.xl_rmid].fpi_size += fpi_len;
-   rmgr_stats_table[record->header.xl_rmid].combined_size += rec_len;
+   stats[record->header.xl_rmid].count++;
+   stats[record->header.xl_rmid].record_size += (rec_len - fpi_len);
+   stats[record->header.xl_rmid].fpi_size += fpi_len;
+   stats[record->header.xl_rmid].combined_size += rec_len;
+}
+
+void
+pgmoneta_wal_merge_stats(struct rmgr_stats* stats)
+{
+   if (stats == NULL)
+   {
+      return;
+   }
+
+   for (int i = 0; i <= RM_MAX_ID; i++)
+   {
+      rmgr_stats_table[i].count += stats[i].count;
+      rmgr_stats_table[i].record_size += stats[i].record_size;
+      rmgr_stats_table[i].fpi_size += stats[i].fpi_size;
+      rmgr_stats_table[i].combined_size += stats[i].combined_size;
+   }
 }
 
 int
@@ -2583,27 +2694,34 @@ pgmoneta_wal_encode_xlog_record(struct decoded_xlog_record* decoded, uint16_t ma
 int
 pgmoneta_xid_timestamp_map_create(struct xid_timestamp_map** map)
 {
+   struct xid_timestamp_map* m = NULL;
+
    if (map == NULL)
    {
       pgmoneta_log_error("Invalid parameter: map is NULL");
       return 1;
    }
 
-   struct xid_timestamp_map* m = malloc(sizeof(struct xid_timestamp_map));
+   m = malloc(sizeof(struct xid_timestamp_map));
    if (m == NULL)
    {
       pgmoneta_log_error("Failed to allocate memory for XID timestamp map");
       return 1;
    }
 
-   if (pgmoneta_deque_create(false, &m->entries))
+   memset(m, 0, sizeof(struct xid_timestamp_map));
+
+   m->slots = calloc(XID_TIMESTAMP_MAP_INITIAL_CAPACITY, sizeof(struct xid_timestamp_entry));
+   if (m->slots == NULL)
    {
-      pgmoneta_log_error("Failed to create deque for XID timestamp map");
+      pgmoneta_log_error("Failed to allocate slots for XID timestamp map");
       free(m);
       return 1;
    }
 
-   m->sorted = false;
+   m->capacity = XID_TIMESTAMP_MAP_INITIAL_CAPACITY;
+   m->size = 0;
+
    *map = m;
    return 0;
 }
@@ -2616,15 +2734,19 @@ pgmoneta_xid_timestamp_map_destroy(struct xid_timestamp_map* map)
       return;
    }
 
-   if (map->entries != NULL)
-   {
-      pgmoneta_deque_destroy(map->entries);
-   }
+   free(map->slots);
    free(map);
 }
 
 int
 pgmoneta_xid_timestamp_map_put(struct xid_timestamp_map* map, transaction_id xid, timestamp_tz timestamp)
+{
+   return pgmoneta_xid_timestamp_map_put_all(map, xid, NULL, 0, timestamp);
+}
+
+int
+pgmoneta_xid_timestamp_map_put_all(struct xid_timestamp_map* map, transaction_id xid,
+                                   transaction_id* subxacts, int nsubxacts, timestamp_tz timestamp)
 {
    if (map == NULL)
    {
@@ -2632,23 +2754,39 @@ pgmoneta_xid_timestamp_map_put(struct xid_timestamp_map* map, transaction_id xid
       return 1;
    }
 
-   map->sorted = false;
+   if (xid == INVALID_TRANSACTION_ID)
+   {
+      pgmoneta_log_error("Invalid parameter: XID is invalid");
+      return 1;
+   }
 
-   struct xid_timestamp_entry* entry = malloc(sizeof(struct xid_timestamp_entry));
-   if (entry == NULL)
+   if (nsubxacts < 0 || (nsubxacts > 0 && subxacts == NULL))
    {
-      pgmoneta_log_error("Failed to allocate memory for XID timestamp entry");
+      pgmoneta_log_error("Invalid parameter: %d subxacts", nsubxacts);
       return 1;
    }
 
-   entry->xid = xid;
-   entry->timestamp = timestamp;
+   /* One reservation for the whole transaction, so a commit with many
+    * subtransactions rehashes at most once
+    */
+   if (xid_timestamp_map_reserve(map, map->size + 1 + (size_t)nsubxacts))
+   {
+      pgmoneta_log_error("Failed to grow XID timestamp map to %zu entries", map->size + 1 + (size_t)nsubxacts);
+      return 1;
+   }
 
-   struct value_config config;
-   memset(&config, 0, sizeof(struct value_config));
-   config.destroy_data = xid_timestamp_entry_destroy;
+   xid_timestamp_map_insert(map, xid, timestamp);
+
+   for (int i = 0; i < nsubxacts; i++)
+   {
+      if (subxacts[i] == INVALID_TRANSACTION_ID)
+      {
+         pgmoneta_log_warn("Skipping invalid subXID of XID %u", xid);
+         continue;
+      }
 
-   pgmoneta_deque_add_with_config(map->entries, NULL, (uintptr_t)entry, &config);
+      xid_timestamp_map_insert(map, subxacts[i], timestamp);
+   }
 
    return 0;
 }
@@ -2656,48 +2794,36 @@ pgmoneta_xid_timestamp_map_put(struct xid_timestamp_map* map, transaction_id xid
 int
 pgmoneta_xid_timestamp_map_get(struct xid_timestamp_map* map, transaction_id xid, timestamp_tz* timestamp)
 {
+   size_t mask;
+   size_t index;
+
    if (map == NULL || timestamp == NULL)
    {
       pgmoneta_log_error("Invalid parameter: map or timestamp is NULL");
       return 1;
    }
 
-   if (!map->sorted)
-   {
-      pgmoneta_xid_timestamp_map_sort(map);
-   }
-
-   struct deque_iterator* iter = NULL;
-   if (pgmoneta_deque_iterator_create(map->entries, &iter))
+   if (xid == INVALID_TRANSACTION_ID)
    {
-      pgmoneta_log_error("Failed to create iterator for XID timestamp map");
       return 1;
    }
 
-   int result = 1;
+   mask = map->capacity - 1;
+   index = xid_timestamp_map_hash(xid) & mask;
 
-   while (pgmoneta_deque_iterator_next(iter))
+   /* The load factor keeps at least one free slot, which ends every probe */
+   while (map->slots[index].xid != INVALID_TRANSACTION_ID)
    {
-      struct xid_timestamp_entry* entry = (struct xid_timestamp_entry*)pgmoneta_value_data(iter->value);
-      if (entry == NULL)
+      if (map->slots[index].xid == xid)
       {
-         continue;
+         *timestamp = map->slots[index].timestamp;
+         return 0;
       }
 
-      if (entry->xid == xid)
-      {
-         *timestamp = entry->timestamp;
-         result = 0;
-         break;
-      }
-      else if (entry->xid > xid)
-      {
-         break;
-      }
+      index = (index + 1) & mask;
    }
 
-   pgmoneta_deque_iterator_destroy(iter);
-   return result;
+   return 1;
 }
 
 size_t
@@ -2708,43 +2834,131 @@ pgmoneta_xid_timestamp_map_size(struct xid_timestamp_map* map)
       return 0;
    }
 
-   return pgmoneta_deque_size(map->entries);
+   return map->size;
 }
 
-static void
-pgmoneta_xid_timestamp_map_sort(struct xid_timestamp_map* map)
+int
+pgmoneta_xid_timestamp_map_sorted(struct xid_timestamp_map* map, struct xid_timestamp_entry** entries, size_t* count)
 {
-   if (map == NULL || map->entries == NULL)
+   struct xid_timestamp_entry* e = NULL;
+   size_t n = 0;
+
+   if (map == NULL || entries == NULL || count == NULL)
    {
-      return;
+      pgmoneta_log_error("Invalid parameter: map, entries or count is NULL");
+      return 1;
    }
 
-   if (pgmoneta_deque_size(map->entries) <= 1)
+   *entries = NULL;
+   *count = 0;
+
+   if (map->size == 0)
    {
-      map->sorted = true;
-      return;
+      return 0;
+   }
+
+   e = malloc(map->size * sizeof(struct xid_timestamp_entry));
+   if (e == NULL)
+   {
+      pgmoneta_log_error("Failed to allocate memory for sorted XID timestamp entries");
+      return 1;
+   }
+
+   for (size_t i = 0; i < map->capacity; i++)
+   {
+      if (map->slots[i].xid != INVALID_TRANSACTION_ID)
+      {
+         e[n++] = map->slots[i];
+      }
    }
 
-   pgmoneta_deque_sort(map->entries, compare_xid_timestamp_entries);
-   map->sorted = true;
+   qsort(e, n, sizeof(struct xid_timestamp_entry), compare_xid_timestamp_entries);
+
+   *entries = e;
+   *count = n;
+
+   return 0;
+}
+
+static inline size_t
+xid_timestamp_map_hash(transaction_id xid)
+{
+   /* Fibonacci hashing: XIDs are dense and sequential, so mix the high bits
+    * into the low ones before masking
+    */
+   uint32_t h = xid * 2654435769U;
+
+   return (size_t)(h ^ (h >> 16));
+}
+
+static void
+xid_timestamp_map_insert(struct xid_timestamp_map* map, transaction_id xid, timestamp_tz timestamp)
+{
+   size_t mask = map->capacity - 1;
+   size_t index = xid_timestamp_map_hash(xid) & mask;
+
+   while (map->slots[index].xid != INVALID_TRANSACTION_ID)
+   {
+      if (map->slots[index].xid == xid)
+      {
+         map->slots[index].timestamp = timestamp;
+         return;
+      }
+
+      index = (index + 1) & mask;
+   }
+
+   map->slots[index].xid = xid;
+   map->slots[index].timestamp = timestamp;
+   map->size++;
 }
 
 static int
-compare_xid_timestamp_entries(struct value* a, struct value* b)
+xid_timestamp_map_reserve(struct xid_timestamp_map* map, size_t entries)
 {
-   if (a == NULL || b == NULL)
+   struct xid_timestamp_entry* old_slots = map->slots;
+   size_t old_capacity = map->capacity;
+   size_t capacity = map->capacity;
+
+   while (entries * XID_TIMESTAMP_MAP_LOAD_DENOMINATOR > capacity * XID_TIMESTAMP_MAP_LOAD_NUMERATOR)
+   {
+      capacity *= 2;
+   }
+
+   if (capacity == old_capacity)
    {
       return 0;
    }
 
-   const struct xid_timestamp_entry* entry_a = (const struct xid_timestamp_entry*)pgmoneta_value_data(a);
-   const struct xid_timestamp_entry* entry_b = (const struct xid_timestamp_entry*)pgmoneta_value_data(b);
+   map->slots = calloc(capacity, sizeof(struct xid_timestamp_entry));
+   if (map->slots == NULL)
+   {
+      map->slots = old_slots;
+      return 1;
+   }
+
+   map->capacity = capacity;
+   map->size = 0;
 
-   if (entry_a == NULL || entry_b == NULL)
+   for (size_t i = 0; i < old_capacity; i++)
    {
-      return 0;
+      if (old_slots[i].xid != INVALID_TRANSACTION_ID)
+      {
+         xid_timestamp_map_insert(map, old_slots[i].xid, old_slots[i].timestamp);
+      }
    }
 
+   free(old_slots);
+
+   return 0;
+}
+
+static int
+compare_xid_timestamp_entries(const void* a, const void* b)
+{
+   const struct xid_timestamp_entry* entry_a = (const struct xid_timestamp_entry*)a;
+   const struct xid_timestamp_entry* entry_b = (const struct xid_timestamp_entry*)b;
+
    if (entry_a->xid < entry_b->xid)
    {
       return -1;
@@ -2756,12 +2970,6 @@ compare_xid_timestamp_entries(struct value* a, struct value* b)
    return 0;
 }
 
-static void
-xid_timestamp_entry_destroy(uintptr_t data)
-{
-   free((void*)data);
-}
-
 static int
 process_commit_record(struct xl_xact_commit* xlrec, uint8_t xl_info, transaction_id xid,
                       bool use_v15_parser, struct xid_timestamp_map* map)
@@ -2802,24 +3010,12 @@ static int
 add_xid_and_subxacts_to_map(transaction_id main_xid, transaction_id* subxacts, int nsubxacts,
                             timestamp_tz timestamp, struct xid_timestamp_map* map)
 {
-   if (pgmoneta_xid_timestamp_map_put(map, main_xid, timestamp))
+   if (pgmoneta_xid_timestamp_map_put_all(map, main_xid, subxacts, nsubxacts, timestamp))
    {
       pgmoneta_log_error("Failed to add XID %u to timestamp map", main_xid);
       return 1;
    }
 
-   for (int i = 0; i < nsubxacts; i++)
-   {
-      if (pgmoneta_xid_timestamp_map_put(map, subxacts[i], timestamp))
-      {
-         pgmoneta_log_warn("Failed to add subXID %u to timestamp map", subxacts[i]);
-      }
-      else
-      {
-         pgmoneta_log_trace("Added subXID %u -> timestamp %ld to map", subxacts[i], timestamp);
-      }
-   }
-
    pgmoneta_log_trace("Added XID %u -> timestamp %ld to map with %d subxacts", main_xid, timestamp, nsubxacts);
    return 0;
 }
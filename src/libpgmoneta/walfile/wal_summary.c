@@ -41,9 +41,19 @@
 #include <dirent.h>
 #include <errno.h>
 #include <libgen.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static char* summary_file_name(uint64_t s_lsn, uint64_t e_lsn);
+static bool summary_file_range(char* file, uint64_t* s_lsn, uint64_t* e_lsn);
+static int summary_files(int srv, struct deque** files);
+static int summary_rollup(int srv, uint64_t s_lsn, uint64_t e_lsn);
+static int wal_segments(int srv, xlog_seg_no* oldest, xlog_seg_no* newest);
+static int summarize_range(int srv, char* wal_dir, uint64_t start_lsn, uint64_t end_lsn, block_ref_table* brt);
 static int summarize_walfile(char* path, uint64_t start_lsn, uint64_t end_lsn, block_ref_table* brt);
 static int summarize_walfiles(int srv, char* dir_path, uint64_t start_lsn, uint64_t end_lsn, block_ref_table* brt);
 static char* get_wal_file_name(char* dir_path, char* file);
@@ -87,27 +97,10 @@ pgmoneta_summarize_wal(int srv, char* dir, uint64_t start_lsn, uint64_t end_lsn,
       goto error;
    }
 
-   partial_record = malloc(sizeof(struct partial_xlog_record));
-   partial_record->data_buffer_bytes_read = 0;
-   partial_record->xlog_record_bytes_read = 0;
-   partial_record->xlog_record = NULL;
-   partial_record->data_buffer = NULL;
-   /* Look upon the WAL archive directory and summarize the WAL records in the range [start_lsn, end_lsn) */
-   if (summarize_walfiles(srv, wal_dir, start_lsn, end_lsn, brt))
+   if (summarize_range(srv, wal_dir, start_lsn, end_lsn, brt))
    {
-      pgmoneta_log_error("Error while reading/describing WAL directory");
       goto error;
    }
-   if (partial_record->xlog_record != NULL)
-   {
-      free(partial_record->xlog_record);
-   }
-   if (partial_record->data_buffer != NULL)
-   {
-      free(partial_record->data_buffer);
-   }
-   free(partial_record);
-   partial_record = NULL;
 
    *b = brt;
 
@@ -135,7 +128,11 @@ pgmoneta_wal_summary_save(int srv, uint64_t s_lsn, uint64_t e_lsn, block_ref_tab
       summary_dir = pgmoneta_append_char(summary_dir, '/');
    }
    pgmoneta_log_debug("summary dir: %s", summary_dir);
-   /* Assuming the directory is created beforehand, just check */
+   if (!pgmoneta_exists(summary_dir))
+   {
+      pgmoneta_mkdir(summary_dir);
+   }
+
    if (!pgmoneta_is_directory(summary_dir))
    {
       pgmoneta_log_error("pgmoneta_summarize_wal: %s is not a directory", summary_dir);
@@ -177,6 +174,379 @@ error:
    return 1;
 }
 
+void
+pgmoneta_wal_summarizer(int srv, char** argv)
+{
+   bool active = false;
+   pid_t pid;
+   sigset_t mask;
+   sigset_t old;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (!config->wal_summary)
+   {
+      return;
+   }
+
+   /* One summarizer per server, it catches up on every segment finished in the meantime */
+   if (!atomic_compare_exchange_strong(&config->common.servers[srv].wal_summarizer, &active, true))
+   {
+      return;
+   }
+
+   /* The reaper clears the lock by pid, so it can't see the child before its pid is known */
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_BLOCK, &mask, &old);
+
+   pid = fork();
+   if (pid == -1)
+   {
+      pgmoneta_log_error("WAL summarizer: Cannot create process for %s", config->common.servers[srv].name);
+      atomic_store(&config->common.servers[srv].wal_summarizer, false);
+   }
+   else if (pid == 0)
+   {
+      sigprocmask(SIG_SETMASK, &old, NULL);
+
+      pgmoneta_set_priority(PRIORITY_LOW);
+
+      if (argv != NULL)
+      {
+         pgmoneta_set_proc_title(1, argv, "wal/summary", config->common.servers[srv].name);
+      }
+
+      pgmoneta_wal_summarize_server(srv);
+
+      atomic_store(&config->common.servers[srv].wal_summarizer, false);
+
+      exit(0);
+   }
+   else
+   {
+      config->common.servers[srv].wal_summarizer_pid = pid;
+   }
+
+   sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+void
+pgmoneta_wal_summarizer_exited(pid_t pid)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      if (config->common.servers[i].wal_summarizer_pid == pid)
+      {
+         config->common.servers[i].wal_summarizer_pid = -1;
+         atomic_store(&config->common.servers[i].wal_summarizer, false);
+      }
+   }
+}
+
+int
+pgmoneta_wal_summarize_server(int srv)
+{
+   char* wal_dir = NULL;
+   struct deque* files = NULL;
+   struct deque_iterator* iter = NULL;
+   block_ref_table* brt = NULL;
+   xlog_seg_no oldest = 0;
+   xlog_seg_no newest = 0;
+   uint64_t oldest_lsn = 0;
+   uint64_t cursor = 0;
+   uint64_t end_lsn = 0;
+   uint64_t group;
+   int wal_size;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   wal_size = config->common.servers[srv].wal_size;
+   if (wal_size <= 0)
+   {
+      return 0;
+   }
+
+   group = (uint64_t)wal_size * WAL_SUMMARY_SEGMENTS;
+
+   if (wal_segments(srv, &oldest, &newest) || newest <= oldest)
+   {
+      return 0;
+   }
+
+   XLOG_SEG_NO_OFFEST_TO_REC_PTR(oldest, 0, wal_size, oldest_lsn);
+
+   /* The newest finished segment completes the records that cross into it */
+   XLOG_SEG_NO_OFFEST_TO_REC_PTR(newest, 0, wal_size, end_lsn);
+
+   if (summary_files(srv, &files))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_iterator_create(files, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      uint64_t s_lsn = 0;
+      uint64_t e_lsn = 0;
+
+      summary_file_range(iter->tag, &s_lsn, &e_lsn);
+
+      /* The WAL of this summary has been removed by retention */
+      if (e_lsn <= oldest_lsn)
+      {
+         char* path = pgmoneta_get_server_summary(srv);
+
+         path = pgmoneta_append(path, iter->tag);
+         pgmoneta_delete_file(path, NULL);
+         free(path);
+
+         continue;
+      }
+
+      cursor = MAX(cursor, e_lsn);
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   if (cursor == 0)
+   {
+      cursor = oldest_lsn;
+   }
+
+   wal_dir = pgmoneta_get_server_wal(srv);
+
+   while (config->running && cursor < end_lsn)
+   {
+      uint64_t next = MIN(end_lsn, (cursor / group + 1) * group);
+
+      if (pgmoneta_brt_create_empty(&brt))
+      {
+         goto error;
+      }
+
+      if (summarize_range(srv, wal_dir, cursor, next, brt) ||
+          pgmoneta_wal_summary_save(srv, cursor, next, brt))
+      {
+         pgmoneta_log_error("WAL summary: Unable to summarize [%" PRIX64 ", %" PRIX64 ") for %s",
+                            cursor, next, config->common.servers[srv].name);
+         goto error;
+      }
+
+      pgmoneta_brt_destroy(brt);
+      brt = NULL;
+
+      pgmoneta_log_debug("WAL summary: %s summarized [%" PRIX64 ", %" PRIX64 ")",
+                         config->common.servers[srv].name, cursor, next);
+
+      /* Keep a single summary for each group of segments */
+      if (next % group == 0 && summary_rollup(srv, next - group, next))
+      {
+         goto error;
+      }
+
+      cursor = next;
+   }
+
+   pgmoneta_deque_destroy(files);
+   free(wal_dir);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+   pgmoneta_brt_destroy(brt);
+   free(wal_dir);
+
+   return 1;
+}
+
+int
+pgmoneta_wal_summary_collect(int srv, char* wal_dir, uint64_t start_lsn, uint64_t end_lsn, block_ref_table** b)
+{
+   char* summary_dir = NULL;
+   char* path = NULL;
+   struct deque* files = NULL;
+   struct deque_iterator* iter = NULL;
+   block_ref_table* brt = NULL;
+   uint64_t covered = start_lsn;
+   int merged = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (!config->wal_summary)
+   {
+      return pgmoneta_summarize_wal(srv, wal_dir, start_lsn, end_lsn, b);
+   }
+
+   if (pgmoneta_brt_create_empty(&brt))
+   {
+      goto error;
+   }
+
+   if (summary_files(srv, &files))
+   {
+      goto error;
+   }
+
+   summary_dir = pgmoneta_get_server_summary(srv);
+
+   if (pgmoneta_deque_iterator_create(files, &iter))
+   {
+      goto error;
+   }
+
+   /*
+    * The summaries are merged while they cover the range without a gap. A summary
+    * may start before start_lsn, which only adds blocks to the incremental backup
+    */
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      uint64_t s_lsn = 0;
+      uint64_t e_lsn = 0;
+
+      if (!summary_file_range(iter->tag, &s_lsn, &e_lsn) || e_lsn <= covered)
+      {
+         continue;
+      }
+
+      if (s_lsn > covered || e_lsn > end_lsn)
+      {
+         break;
+      }
+
+      path = pgmoneta_append(NULL, summary_dir);
+      path = pgmoneta_append(path, iter->tag);
+
+      if (pgmoneta_brt_merge_file(path, brt))
+      {
+         pgmoneta_log_error("WAL summary: Unable to read %s", path);
+         goto error;
+      }
+
+      free(path);
+      path = NULL;
+
+      covered = e_lsn;
+      merged++;
+   }
+
+   pgmoneta_log_debug("WAL summary: Merged %d summaries up to %" PRIX64 ", summarizing [%" PRIX64 ", %" PRIX64 ")",
+                      merged, covered, covered, end_lsn);
+
+   if (covered < end_lsn)
+   {
+      char* d = NULL;
+
+      d = wal_dir != NULL ? pgmoneta_append(NULL, wal_dir) : pgmoneta_get_server_wal(srv);
+
+      if (summarize_range(srv, d, covered, end_lsn, brt))
+      {
+         free(d);
+         goto error;
+      }
+
+      free(d);
+   }
+
+   *b = brt;
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+   free(summary_dir);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+   pgmoneta_brt_destroy(brt);
+   free(summary_dir);
+   free(path);
+
+   return 1;
+}
+
+int
+pgmoneta_wal_summary_lag(int srv, uint64_t* bytes)
+{
+   struct deque* files = NULL;
+   struct deque_iterator* iter = NULL;
+   xlog_seg_no oldest = 0;
+   xlog_seg_no newest = 0;
+   uint64_t cursor = 0;
+   uint64_t received = 0;
+   int wal_size;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   *bytes = 0;
+
+   wal_size = config->common.servers[srv].wal_size;
+
+   if (!config->wal_summary || wal_size <= 0 || wal_segments(srv, &oldest, &newest))
+   {
+      return 0;
+   }
+
+   XLOG_SEG_NO_OFFEST_TO_REC_PTR(newest + 1, 0, wal_size, received);
+   XLOG_SEG_NO_OFFEST_TO_REC_PTR(oldest, 0, wal_size, cursor);
+
+   if (summary_files(srv, &files))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_iterator_create(files, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      uint64_t s_lsn = 0;
+      uint64_t e_lsn = 0;
+
+      if (summary_file_range(iter->tag, &s_lsn, &e_lsn))
+      {
+         cursor = MAX(cursor, e_lsn);
+      }
+   }
+
+   if (received > cursor)
+   {
+      *bytes = received - cursor;
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+
+   return 1;
+}
+
 static char*
 summary_file_name(uint64_t s_lsn, uint64_t e_lsn)
 {
@@ -328,6 +698,12 @@ retry1:
                                file, seg_start_lsn, end_lsn);
             continue;
          }
+
+         /* No record starting in this segment can be in the range */
+         if (wal_size > 0 && seg_start_lsn + (uint64_t)wal_size <= start_lsn)
+         {
+            continue;
+         }
       }
 
       fn = get_wal_file_name(dir_path, file);
@@ -513,3 +889,251 @@ get_wal_file_name(char* dir_path, char* file)
 
    return fn;
 }
+
+static bool
+summary_file_range(char* file, uint64_t* s_lsn, uint64_t* e_lsn)
+{
+   uint32_t s_hi = 0;
+   uint32_t s_lo = 0;
+   uint32_t e_hi = 0;
+   uint32_t e_lo = 0;
+
+   if (file == NULL || strlen(file) != 32 ||
+       sscanf(file, "%08X%08X%08X%08X", &s_hi, &s_lo, &e_hi, &e_lo) != 4)
+   {
+      return false;
+   }
+
+   *s_lsn = ((uint64_t)s_hi << 32) | s_lo;
+   *e_lsn = ((uint64_t)e_hi << 32) | e_lo;
+
+   return true;
+}
+
+static int
+summary_files(int srv, struct deque** files)
+{
+   char* summary_dir = NULL;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   struct deque* d = NULL;
+   uint64_t s_lsn = 0;
+   uint64_t e_lsn = 0;
+
+   *files = NULL;
+
+   if (pgmoneta_deque_create(false, &d))
+   {
+      goto error;
+   }
+
+   summary_dir = pgmoneta_get_server_summary(srv);
+   if (summary_dir == NULL)
+   {
+      goto error;
+   }
+
+   if ((dir = opendir(summary_dir)) != NULL)
+   {
+      while ((entry = readdir(dir)) != NULL)
+      {
+         if (entry->d_type == DT_REG && summary_file_range(entry->d_name, &s_lsn, &e_lsn))
+         {
+            pgmoneta_deque_add(d, entry->d_name, (uintptr_t)entry->d_name, ValueString);
+         }
+      }
+
+      closedir(dir);
+   }
+
+   /* The names start with the start LSN in fixed width hex, so they sort in LSN order */
+   pgmoneta_deque_sort(d, NULL);
+
+   *files = d;
+
+   free(summary_dir);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_destroy(d);
+   free(summary_dir);
+
+   return 1;
+}
+
+static int
+summary_rollup(int srv, uint64_t s_lsn, uint64_t e_lsn)
+{
+   char* summary_dir = NULL;
+   char* path = NULL;
+   struct deque* files = NULL;
+   struct deque* pieces = NULL;
+   struct deque_iterator* iter = NULL;
+   block_ref_table* brt = NULL;
+   uint64_t first = 0;
+
+   if (summary_files(srv, &files) || pgmoneta_deque_create(false, &pieces))
+   {
+      goto error;
+   }
+
+   summary_dir = pgmoneta_get_server_summary(srv);
+
+   if (pgmoneta_brt_create_empty(&brt) || pgmoneta_deque_iterator_create(files, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      uint64_t start = 0;
+      uint64_t end = 0;
+
+      if (!summary_file_range(iter->tag, &start, &end) || end <= s_lsn || end > e_lsn)
+      {
+         continue;
+      }
+
+      path = pgmoneta_append(NULL, summary_dir);
+      path = pgmoneta_append(path, iter->tag);
+
+      if (pgmoneta_brt_merge_file(path, brt))
+      {
+         goto error;
+      }
+
+      if (pgmoneta_deque_empty(pieces))
+      {
+         first = start;
+      }
+
+      pgmoneta_deque_add(pieces, path, (uintptr_t)path, ValueString);
+
+      free(path);
+      path = NULL;
+   }
+
+   if (pgmoneta_deque_size(pieces) > 1)
+   {
+      if (pgmoneta_wal_summary_save(srv, first, e_lsn, brt))
+      {
+         goto error;
+      }
+
+      pgmoneta_deque_iterator_destroy(iter);
+      iter = NULL;
+
+      if (pgmoneta_deque_iterator_create(pieces, &iter))
+      {
+         goto error;
+      }
+
+      /* The rolled up summary covers all of the pieces */
+      while (pgmoneta_deque_iterator_next(iter))
+      {
+         pgmoneta_delete_file(iter->tag, NULL);
+      }
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+   pgmoneta_deque_destroy(pieces);
+   pgmoneta_brt_destroy(brt);
+   free(summary_dir);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(files);
+   pgmoneta_deque_destroy(pieces);
+   pgmoneta_brt_destroy(brt);
+   free(summary_dir);
+   free(path);
+
+   return 1;
+}
+
+static int
+wal_segments(int srv, xlog_seg_no* oldest, xlog_seg_no* newest)
+{
+   char* wal_dir = NULL;
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   xlog_seg_no seg_no = 0;
+   bool found = false;
+   int wal_size;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   wal_size = config->common.servers[srv].wal_size;
+
+   wal_dir = pgmoneta_get_server_wal(srv);
+   if (wal_dir == NULL || (dir = opendir(wal_dir)) == NULL)
+   {
+      free(wal_dir);
+      return 1;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (entry->d_type != DT_REG ||
+          pgmoneta_ends_with(entry->d_name, ".partial") ||
+          strstr(entry->d_name, ".history") != NULL ||
+          pgmoneta_validate_wal_filename(entry->d_name, NULL, &seg_no, wal_size))
+      {
+         continue;
+      }
+
+      if (!found || seg_no < *oldest)
+      {
+         *oldest = seg_no;
+      }
+
+      if (!found || seg_no > *newest)
+      {
+         *newest = seg_no;
+      }
+
+      found = true;
+   }
+
+   closedir(dir);
+   free(wal_dir);
+
+   return found ? 0 : 1;
+}
+
+static int
+summarize_range(int srv, char* wal_dir, uint64_t start_lsn, uint64_t end_lsn, block_ref_table* brt)
+{
+   int ret = 0;
+
+   partial_record = malloc(sizeof(struct partial_xlog_record));
+   partial_record->data_buffer_bytes_read = 0;
+   partial_record->xlog_record_bytes_read = 0;
+   partial_record->xlog_record = NULL;
+   partial_record->data_buffer = NULL;
+   /* Look upon the WAL archive directory and summarize the WAL records in the range [start_lsn, end_lsn) */
+   if (summarize_walfiles(srv, wal_dir, start_lsn, end_lsn, brt))
+   {
+      pgmoneta_log_error("Error while reading/describing WAL directory");
+      ret = 1;
+   }
+   if (partial_record->xlog_record != NULL)
+   {
+      free(partial_record->xlog_record);
+   }
+   if (partial_record->data_buffer != NULL)
+   {
+      free(partial_record->data_buffer);
+   }
+   free(partial_record);
+   partial_record = NULL;
+
+   return ret;
+}
@@ -37,6 +37,7 @@
 #include <tablespace.h>
 #include <utils.h>
 #include <workflow.h>
+#include <workflow_funcs.h>
 
 /* system */
 #include <assert.h>
@@ -49,6 +50,7 @@
 
 static char* basebackup_name(void);
 static int basebackup_execute(char*, struct art*);
+static bool use_parallel_backup(int server, struct tablespace* tablespaces);
 static unsigned long directory_size_excludes(char* directory, char** excludes);
 
 struct workflow*
@@ -79,7 +81,7 @@ basebackup_name(void)
 }
 
 static int
-basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
+basebackup_execute(char* name, struct art* nodes)
 {
    int server = -1;
    char* label = NULL;
@@ -225,6 +227,17 @@ basebackup_execute(char* name __attribute__((unused)), struct art* nodes)
    response = NULL;
    pgmoneta_close_ssl(ssl);
    pgmoneta_disconnect(socket);
+   ssl = NULL;
+   socket = -1;
+
+   if (use_parallel_backup(server, tablespaces))
+   {
+      pgmoneta_free_tablespaces(tablespaces);
+      pgmoneta_free_message(tablespace_msg);
+      pgmoneta_memory_destroy();
+
+      return pgmoneta_parallel_backup_execute(name, nodes);
+   }
 
    if (pgmoneta_server_authenticate(server, "postgres", config->common.users[usr].username, config->common.users[usr].password, true, &ssl, &socket) != AUTH_SUCCESS)
    {
@@ -451,6 +464,38 @@ error:
    return 1;
 }
 
+static bool
+use_parallel_backup(int server, struct tablespace* tablespaces)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (pgmoneta_get_backup_connections(server) <= 0)
+   {
+      return false;
+   }
+
+   if (config->common.servers[server].version < 14)
+   {
+      pgmoneta_log_debug("Backup: Using BASE_BACKUP for %s, backup_connections needs PostgreSQL 14+", config->common.servers[server].name);
+      return false;
+   }
+
+   /* The files are read from the data directory, so user tablespaces need BASE_BACKUP */
+   for (struct tablespace* t = tablespaces; t != NULL; t = t->next)
+   {
+      if (t->path != NULL && strlen(t->path) > 0)
+      {
+         pgmoneta_log_debug("Backup: Using BASE_BACKUP for %s, tablespace %s is outside of the data directory",
+                            config->common.servers[server].name, t->name);
+         return false;
+      }
+   }
+
+   return true;
+}
+
 static unsigned long
 directory_size_excludes(char* directory, char** excludes)
 {
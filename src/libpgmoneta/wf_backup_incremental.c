@@ -30,6 +30,7 @@
 #include <pgmoneta.h>
 #include <achv.h>
 #include <backup.h>
+#include <bandwidth.h>
 #include <extension.h>
 #include <extraction.h>
 #include <json.h>
@@ -38,17 +39,20 @@
 #include <memory.h>
 #include <message.h>
 #include <network.h>
+#include <resume.h>
 #include <security.h>
 #include <server.h>
 #include <tablespace.h>
 #include <utils.h>
 #include <walfile/wal_reader.h>
 #include <walfile/wal_summary.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
 #include <assert.h>
 #include <libgen.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -62,6 +66,32 @@ size_t segment_size;     // segment size
 size_t rel_seg_size;     // number of blocks in a segment
 size_t wal_segment_size; // wal segment size
 
+#define INCREMENTAL_FETCH_BLOCKS 128 /* the number of blocks fetched by one request */
+
+/** @struct parallel_backup
+ * Defines the files of a full backup shared by its connections
+ */
+struct parallel_backup
+{
+   int server;             /**< The server */
+   int usr;                /**< The user */
+   char* backup_data;      /**< The data directory of the backup */
+   char** files;           /**< The files of the cluster */
+   int number_of_files;    /**< The number of files */
+   atomic_int next;        /**< The next file to fetch */
+   atomic_bool failed;     /**< Has a connection failed */
+   struct resume* resume;  /**< The files of an interrupted backup */
+};
+
+/** @struct parallel_input
+ * Defines the input of a connection of a full backup
+ */
+struct parallel_input
+{
+   struct worker_common common;    /**< The common base */
+   struct parallel_backup* backup; /**< The backup */
+};
+
 static int send_upload_manifest(SSL* ssl, int socket);
 static int upload_manifest(SSL* ssl, int socket, char* path);
 /**
@@ -80,10 +110,6 @@ static size_t get_incremental_file_size(uint32_t num_incr_blocks);
  * Get the size of the header of incremental file
  */
 static size_t get_incremental_header_size(uint32_t num_incr_blocks);
-/**
- * Comparator for block number
- */
-static int compare_block_numbers(const void* a, const void* b);
 /**
  * Given a relative file path, derive the rlocator, fork number and segment number, also create
  * necessary directories
@@ -108,12 +134,13 @@ static int add_incremental_label_fields(char* label_file_path, char* prev_data);
  */
 static int write_incremental_file(int server, SSL* ssl, int socket, char* backup_data,
                                   char* relative_filename, uint32_t num_incr_blocks,
-                                  block_number* incr_blocks, uint32_t truncation_block_length, bool empty);
+                                  block_number* incr_blocks, block_ref_table_range* incr_ranges, int num_incr_ranges,
+                                  uint32_t truncation_block_length, bool empty, struct resume* resume);
 /**
  * Serialize all the blocks for a relation file
  */
 static int write_full_file(int server, SSL* ssl, int socket, char* backup_data,
-                           char* relative_filename, size_t expected_size);
+                           char* relative_filename, size_t expected_size, struct resume* resume, bool checksum);
 /**
  * Append padding (0 bytes) to the file stream
  */
@@ -127,6 +154,18 @@ static int copy_wal_from_archive(char* start_wal_file, char* wal_dir, char* back
  * Wait until the WAL segment file appears in the wal archive directory
  */
 static int wait_for_wal_switch(char* wal_dir, char* wal_file);
+/**
+ * Fetch the files of a full backup over a connection of its own
+ */
+static void do_parallel_fetch(struct worker_common* wc);
+/**
+ * Is the file left out of a full backup, following what BASE_BACKUP skips
+ */
+static bool parallel_exclude(char* path);
+/**
+ * Has the file been removed from the server since it was listed
+ */
+static bool parallel_vanished(SSL* ssl, int socket, char* path);
 static char* incr_backup_name(void);
 static int incr_backup_execute(char*, struct art*);
 
@@ -197,6 +236,8 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
    char* start_wal_filename = NULL;
    int num_incr_blocks = 0;
    block_number* incr_blocks = NULL;
+   int num_incr_ranges = 0;
+   block_ref_table_range* incr_ranges = NULL;
    uint32_t truncation_block_length = 0;
 
    block_ref_table_entry* brtentry = NULL;
@@ -209,6 +250,7 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
    struct file_stats fs = {0};
 
    struct backup* backup = NULL;
+   struct resume* resume = NULL;
    struct main_configuration* config;
 
    struct message* msg = NULL;
@@ -306,6 +348,12 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
    tag = pgmoneta_append(tag, "pgmoneta_");
    tag = pgmoneta_append(tag, label);
 
+   /* Pick up the files of an interrupted backup of the same parent */
+   if (pgmoneta_resume_open(server, incremental_label, &resume))
+   {
+      goto error;
+   }
+
    /* Start Backup */
    if (pgmoneta_server_start_backup(server, ssl, socket, tag, &start_backup_xlog))
    {
@@ -316,13 +364,24 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
 
    wal_dir = pgmoneta_get_server_wal(server);
 
-   /* Do WAL Summarization */
-   if (pgmoneta_summarize_wal(server, wal_dir, prev_backup_chkpt_lsn, start_backup_lsn, &summarized_brt))
+   if (pgmoneta_resume_start(resume, label, start_backup_lsn, wal_dir))
    {
-      pgmoneta_log_error("WAL summation for incremental backup failed");
+      pgmoneta_log_error("Incremental backup: Unable to record the progress of %s", label);
       goto error;
    }
 
+   /* Do WAL Summarization, extending the summary of an interrupted backup if there is one */
+   if (pgmoneta_resume_summary(resume, prev_backup_chkpt_lsn, start_backup_lsn, &summarized_brt))
+   {
+      if (pgmoneta_wal_summary_collect(server, wal_dir, prev_backup_chkpt_lsn, start_backup_lsn, &summarized_brt))
+      {
+         pgmoneta_log_error("WAL summation for incremental backup failed");
+         goto error;
+      }
+
+      pgmoneta_resume_summary_save(resume, prev_backup_chkpt_lsn, start_backup_lsn, summarized_brt);
+   }
+
    pgmoneta_mkdir(backup_data);
    if (create_standard_directories(ssl, socket, backup_data, &server_files, &num_of_server_files))
    {
@@ -330,6 +389,12 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
       goto error;
    }
 
+   if (pgmoneta_server_prepare_read_binary_file(server, ssl, socket))
+   {
+      pgmoneta_log_error("Incremental backup: Unable to read files from %s", config->common.servers[server].name);
+      goto error;
+   }
+
    for (int i = 0; i < num_of_server_files; i++)
    {
       block_number limit_block = InvalidBlockNumber;
@@ -342,8 +407,13 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
       /* handle other files and directories */
       if (!pgmoneta_starts_with(server_files[i], "base") && !pgmoneta_starts_with(server_files[i], "global"))
       {
+         if (pgmoneta_resume_reuse(resume, ssl, socket, server_files[i], NULL, MAIN_FORKNUM, backup_data))
+         {
+            continue;
+         }
+
          // full backup
-         if (write_full_file(server, ssl, socket, backup_data, server_files[i], 0))
+         if (write_full_file(server, ssl, socket, backup_data, server_files[i], 0, resume, true))
          {
             pgmoneta_log_error("Incremental backup: Error during backup of: %s", server_files[i]);
             goto error;
@@ -359,8 +429,13 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
 
       if (pgmoneta_ends_with(server_files[i], "pg_filenode.map") || pgmoneta_ends_with(server_files[i], "PG_VERSION") || pgmoneta_ends_with(server_files[i], "pg_control"))
       {
+         if (pgmoneta_resume_reuse(resume, ssl, socket, server_files[i], NULL, MAIN_FORKNUM, backup_data))
+         {
+            continue;
+         }
+
          /* undergo full backup */
-         if (write_full_file(server, ssl, socket, backup_data, server_files[i], 0))
+         if (write_full_file(server, ssl, socket, backup_data, server_files[i], 0, resume, true))
          {
             pgmoneta_log_error("Incremental backup: Error during backup of: %s", server_files[i]);
             goto error;
@@ -375,6 +450,12 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
          goto error;
       }
 
+      /* The free-space map fork isn't WAL-logged, so only its checksum tells if it is unchanged */
+      if (pgmoneta_resume_reuse(resume, ssl, socket, server_files[i], frk != FSM_FORKNUM ? &rlocator : NULL, frk, backup_data))
+      {
+         continue;
+      }
+
       /* find the file stat */
       if (pgmoneta_server_file_stat(server, ssl, socket, server_files[i], &fs))
       {
@@ -385,7 +466,7 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
       /* file size is not multiple of block size */
       if (fs.size % block_size != 0)
       {
-         if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size))
+         if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size, resume, false))
          {
             pgmoneta_log_error("Incremental backup: Error doing backup of %s", server_files[i]);
             goto error;
@@ -399,7 +480,7 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
        */
       if (frk == FSM_FORKNUM)
       {
-         if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size))
+         if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size, resume, true))
          {
             pgmoneta_log_error("Incremental backup: Error during backup of %s", server_files[i]);
             goto error;
@@ -423,7 +504,7 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
       {
          if (fs.size == 0)
          {
-            if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size))
+            if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size, resume, false))
             {
                pgmoneta_log_error("Incremental backup: Error during backup of %s", server_files[i]);
                goto error;
@@ -434,7 +515,7 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
          num_incr_blocks = 0;
          truncation_block_length = fs.size / block_size;
          if (write_incremental_file(server, ssl, socket, backup_data, server_files[i],
-                                    num_incr_blocks, NULL, truncation_block_length, true))
+                                    num_incr_blocks, NULL, NULL, 0, truncation_block_length, true, resume))
          {
             goto error;
          }
@@ -449,7 +530,7 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
        */
       if (limit_block <= segno * rel_seg_size)
       {
-         if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size))
+         if (write_full_file(server, ssl, socket, backup_data, server_files[i], fs.size, resume, false))
          {
             pgmoneta_log_error("Incremental backup: Error during backup of %s", server_files[i]);
             goto error;
@@ -467,21 +548,24 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
       }
 
       incr_blocks = (block_number*)malloc(rel_seg_size * sizeof(block_number));
-      if (pgmoneta_brt_entry_get_blocks(brtentry, start_blk, end_blk, incr_blocks, rel_seg_size, &num_incr_blocks))
+      incr_ranges = (block_ref_table_range*)malloc((rel_seg_size / 2 + 1) * sizeof(block_ref_table_range));
+      if (incr_blocks == NULL || incr_ranges == NULL ||
+          pgmoneta_brt_entry_get_ranges(brtentry, start_blk, end_blk, incr_ranges, rel_seg_size / 2 + 1, &num_incr_ranges))
       {
          pgmoneta_log_error("Incremental backup: Error getting modified blocks from BRT entry");
          goto error;
       }
 
       /*
-          sort the blocks numbers and translate the absolute block numbers to relative
+          the runs are in block order, translate them to block numbers relative to the segment
        */
-      qsort(incr_blocks, num_incr_blocks, sizeof(block_number), compare_block_numbers);
-      if (start_blk != 0)
+      num_incr_blocks = 0;
+      for (int r = 0; r < num_incr_ranges; r++)
       {
-         for (int i = 0; i < num_incr_blocks; i++)
+         incr_ranges[r].start -= start_blk;
+         for (uint32_t j = 0; j < incr_ranges[r].length; j++)
          {
-            incr_blocks[i] -= start_blk;
+            incr_blocks[num_incr_blocks++] = incr_ranges[r].start + j;
          }
       }
 
@@ -502,12 +586,15 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
 
       /* serialize the incremental changes */
       if (write_incremental_file(server, ssl, socket, backup_data, server_files[i],
-                                 num_incr_blocks, incr_blocks, truncation_block_length, false))
+                                 num_incr_blocks, incr_blocks, incr_ranges, num_incr_ranges,
+                                 truncation_block_length, false, resume))
       {
          goto error;
       }
       free(incr_blocks);
       incr_blocks = NULL;
+      free(incr_ranges);
+      incr_ranges = NULL;
    }
 
    /* Stop Backup */
@@ -593,6 +680,9 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
    pgmoneta_snprintf(backup->parent_label, sizeof(backup->parent_label), "%s", incremental_label);
    sscanf(lf.checkpoint_lsn, "%X/%X", &backup->checkpoint_lsn_hi32, &backup->checkpoint_lsn_lo32);
 
+   pgmoneta_resume_finish(resume, true, backup_data);
+   resume = NULL;
+
    if (pgmoneta_save_info(server_backup, backup))
    {
       pgmoneta_log_error("Incremental backup: Could not save backup %s", label);
@@ -622,6 +712,9 @@ incr_backup_execute_14_to_16(char* name __attribute__((unused)), struct art* nod
    return 0;
 
 error:
+   /* Keep the files fetched so far for the next attempt */
+   pgmoneta_resume_finish(resume, false, backup_data);
+
    if (backup_base == NULL)
    {
       backup_base = pgmoneta_get_server_backup_identifier(server, label);
@@ -644,6 +737,7 @@ error:
    free(start_backup_xlog);
    free(stop_backup_xlog);
    free(incr_blocks);
+   free(incr_ranges);
    free(wal_dir);
    free(wal);
    free(tag);
@@ -1060,6 +1154,385 @@ incr_backup_execute(char* name __attribute__((unused)), struct art* nodes)
    }
 }
 
+int
+pgmoneta_parallel_backup_execute(char* name __attribute__((unused)), struct art* nodes)
+{
+   int server = -1;
+   char* label = NULL;
+   struct timespec start_t;
+   struct timespec end_t;
+   char* backup_base = NULL;
+   char* backup_data = NULL;
+   char* server_backup = NULL;
+   char* manifest_path = NULL;
+   int usr;
+   int number_of_connections = 0;
+   char* tag = NULL;
+   char* wal = NULL;
+   SSL* ssl = NULL;
+   int socket = -1;
+   double backup_elapsed_time;
+   int hours;
+   int minutes;
+   double seconds;
+   char elapsed[128];
+   char version[10];
+   char minor_version[10];
+   unsigned long size;
+   uint64_t biggest_file_size;
+   uint64_t system_identifier = 0;
+   char* wal_dir = NULL;
+   uint64_t start_backup_lsn = 0;
+   char* start_backup_xlog = NULL;
+   char* stop_backup_xlog = NULL;
+   struct label_file_contents lf = {0};
+   uint32_t stop_tli = 0;
+   char* start_wal_filename = NULL;
+   char** server_files = NULL;
+   int num_of_server_files = 0;
+   struct parallel_backup pb;
+   struct parallel_input* pi = NULL;
+   struct workers* workers = NULL;
+   struct json* manifest = NULL;
+   struct backup* backup = NULL;
+   struct resume* resume = NULL;
+   struct main_configuration* config;
+
+   struct message* msg = NULL;
+   struct query_response* response = NULL;
+
+   config = (struct main_configuration*)shmem;
+
+#ifdef DEBUG
+   pgmoneta_dump_art(nodes);
+
+   assert(pgmoneta_art_contains_key(nodes, NODE_SERVER_ID));
+   assert(pgmoneta_art_contains_key(nodes, NODE_LABEL));
+   assert(pgmoneta_art_contains_key(nodes, NODE_BACKUP));
+   assert(pgmoneta_art_contains_key(nodes, NODE_BACKUP_BASE));
+   assert(pgmoneta_art_contains_key(nodes, NODE_BACKUP_DATA));
+   assert(pgmoneta_art_contains_key(nodes, NODE_SERVER_BACKUP));
+#endif
+
+   server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
+   label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
+   backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
+   backup_base = (char*)pgmoneta_art_search(nodes, NODE_BACKUP_BASE);
+   backup_data = (char*)pgmoneta_art_search(nodes, NODE_BACKUP_DATA);
+   server_backup = (char*)pgmoneta_art_search(nodes, NODE_SERVER_BACKUP);
+
+   memset(&pb, 0, sizeof(struct parallel_backup));
+
+   number_of_connections = pgmoneta_get_backup_connections(server);
+
+   pgmoneta_log_debug("Parallel backup (execute): %s/%s (%d connections)", config->common.servers[server].name, label, number_of_connections);
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &start_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &start_t);
+#endif
+
+   pgmoneta_memory_init();
+
+   usr = -1;
+   // find the corresponding user's index of the given server
+   for (int i = 0; usr == -1 && i < config->common.number_of_users; i++)
+   {
+      if (pgmoneta_compare_string(config->common.servers[server].username, config->common.users[i].username))
+      {
+         usr = i;
+      }
+   }
+
+   if (usr == -1)
+   {
+      pgmoneta_log_error("User not found for server: %d", server);
+      goto error;
+   }
+
+   if (pgmoneta_server_authenticate(server, "postgres", config->common.users[usr].username, config->common.users[usr].password, false, &ssl, &socket) != AUTH_SUCCESS)
+   {
+      pgmoneta_log_info("Invalid credentials for %s", config->common.users[usr].username);
+      goto error;
+   }
+
+   if (!pgmoneta_server_valid(server))
+   {
+      pgmoneta_server_info(server, ssl, socket);
+
+      if (!pgmoneta_server_valid(server))
+      {
+         goto error;
+      }
+   }
+   memset(version, 0, sizeof(version));
+   pgmoneta_snprintf(version, sizeof(version), "%d", config->common.servers[server].version);
+   memset(minor_version, 0, sizeof(minor_version));
+   pgmoneta_snprintf(minor_version, sizeof(minor_version), "%d", config->common.servers[server].minor_version);
+
+   block_size = config->common.servers[server].block_size;
+   segment_size = config->common.servers[server].segment_size;
+   rel_seg_size = config->common.servers[server].relseg_size;
+   wal_segment_size = config->common.servers[server].wal_size;
+
+   /* The manifest of PostgreSQL 17+ carries the system identifier */
+   if (config->common.servers[server].version >= 17)
+   {
+      pgmoneta_create_query_message("SELECT system_identifier FROM pg_control_system();", &msg);
+      if (pgmoneta_query_execute(ssl, socket, msg, &response) || response == NULL || response->number_of_columns != 1)
+      {
+         pgmoneta_log_error("Parallel backup: Unable to get the system identifier of %s", config->common.servers[server].name);
+         goto error;
+      }
+
+      system_identifier = strtoull(pgmoneta_query_response_get_data(response, 0), NULL, 10);
+
+      pgmoneta_free_query_response(response);
+      response = NULL;
+      pgmoneta_free_message(msg);
+      msg = NULL;
+   }
+
+   tag = pgmoneta_append(tag, "pgmoneta_");
+   tag = pgmoneta_append(tag, label);
+
+   /* Pick up the files of an interrupted full backup */
+   if (pgmoneta_resume_open(server, NULL, &resume))
+   {
+      goto error;
+   }
+
+   /* Start Backup */
+   if (pgmoneta_server_start_backup(server, ssl, socket, tag, &start_backup_xlog))
+   {
+      pgmoneta_log_error("Parallel backup couldn't start");
+      goto error;
+   }
+   start_backup_lsn = pgmoneta_string_to_lsn(start_backup_xlog);
+
+   wal_dir = pgmoneta_get_server_wal(server);
+
+   if (pgmoneta_resume_start(resume, label, start_backup_lsn, wal_dir))
+   {
+      pgmoneta_log_error("Parallel backup: Unable to record the progress of %s", label);
+      goto error;
+   }
+
+   pgmoneta_mkdir(backup_data);
+   if (create_standard_directories(ssl, socket, backup_data, &server_files, &num_of_server_files))
+   {
+      pgmoneta_log_error("Parallel backup: Failed to creating standard directories");
+      goto error;
+   }
+
+   pb.server = server;
+   pb.usr = usr;
+   pb.backup_data = backup_data;
+   pb.files = server_files;
+   pb.number_of_files = num_of_server_files;
+   pb.resume = resume;
+   atomic_init(&pb.next, 0);
+   atomic_init(&pb.failed, false);
+
+   number_of_connections = MIN(number_of_connections, MAX(num_of_server_files, 1));
+
+   if (pgmoneta_workers_initialize(number_of_connections, &workers))
+   {
+      goto error;
+   }
+
+   /* Every connection takes the next file of the list until all are fetched */
+   for (int i = 0; i < number_of_connections; i++)
+   {
+      pi = (struct parallel_input*)malloc(sizeof(struct parallel_input));
+      if (pi == NULL)
+      {
+         atomic_store(&pb.failed, true);
+         break;
+      }
+
+      pi->common.workers = workers;
+      pi->backup = &pb;
+
+      if (pgmoneta_workers_add(workers, do_parallel_fetch, (struct worker_common*)pi))
+      {
+         free(pi);
+         atomic_store(&pb.failed, true);
+         break;
+      }
+      pi = NULL;
+   }
+
+   pgmoneta_workers_wait(workers);
+
+   if (!pgmoneta_workers_outcome_ok(workers) || atomic_load(&pb.failed))
+   {
+      pgmoneta_workers_transfer_failures(workers, nodes);
+      pgmoneta_log_error("Parallel backup: Unable to fetch the files of %s", config->common.servers[server].name);
+      goto error;
+   }
+
+   pgmoneta_workers_destroy(workers);
+   workers = NULL;
+
+   /* Stop Backup */
+   if (pgmoneta_server_stop_backup(server, ssl, socket, backup_data, &stop_backup_xlog, &lf))
+   {
+      pgmoneta_log_error("Parallel backup: Couldn't stop backup because checkpoint failed");
+      goto error;
+   }
+
+   /* Get stop timeline id */
+   pgmoneta_create_query_message("SELECT timeline_id FROM pg_control_checkpoint();", &msg);
+   if (pgmoneta_query_execute(ssl, socket, msg, &response) || response == NULL || response->number_of_columns != 1)
+   {
+      goto error;
+   }
+
+   stop_tli = pgmoneta_atoi(pgmoneta_query_response_get_data(response, 0));
+
+   /* copy wal */
+   start_wal_filename = pgmoneta_wal_file_name(lf.start_tli, start_backup_lsn / wal_segment_size, wal_segment_size);
+
+   /* wait for start_wal_file to get switched */
+   if (wait_for_wal_switch(wal_dir, start_wal_filename))
+   {
+      pgmoneta_log_error("Error during WAL switch for %s", start_wal_filename);
+      goto error;
+   }
+
+   if (copy_wal_from_archive(start_wal_filename, wal_dir, backup_data))
+   {
+      pgmoneta_log_error("Parallel backup: Error copying WAL from archive");
+      goto error;
+   }
+
+#ifdef HAVE_FREEBSD
+   clock_gettime(CLOCK_MONOTONIC_FAST, &end_t);
+#else
+   clock_gettime(CLOCK_MONOTONIC_RAW, &end_t);
+#endif
+
+   backup_elapsed_time = pgmoneta_compute_duration(start_t, end_t);
+   hours = (int)backup_elapsed_time / 3600;
+   minutes = ((int)backup_elapsed_time % 3600) / 60;
+   seconds = (int)backup_elapsed_time % 60 + (backup_elapsed_time - ((long)backup_elapsed_time));
+
+   memset(&elapsed[0], 0, sizeof(elapsed));
+   sprintf(&elapsed[0], "%02i:%02i:%.4f", hours, minutes, seconds);
+
+   pgmoneta_log_debug("Base: %s/%s (Elapsed: %s)", config->common.servers[server].name, label, &elapsed[0]);
+
+   pgmoneta_read_wal(backup_data, &wal);
+
+   backup->valid = VALID_TRUE;
+   pgmoneta_snprintf(backup->label, sizeof(backup->label), "%s", label);
+   backup->number_of_tablespaces = 0;
+   backup->compression = config->compression_type;
+   backup->encryption = config->common.encryption;
+   pgmoneta_snprintf(backup->wal, sizeof(backup->wal), "%s", wal);
+   backup->major_version = atoi(version);
+   backup->minor_version = atoi(minor_version);
+   backup->keep = false;
+
+   sscanf(start_backup_xlog, "%X/%X", &backup->start_lsn_hi32, &backup->start_lsn_lo32);
+   sscanf(stop_backup_xlog, "%X/%X", &backup->end_lsn_hi32, &backup->end_lsn_lo32);
+   backup->start_timeline = lf.start_tli;
+   backup->end_timeline = stop_tli;
+   backup->basebackup_elapsed_time = backup_elapsed_time;
+   backup->type = TYPE_FULL;
+   sscanf(lf.checkpoint_lsn, "%X/%X", &backup->checkpoint_lsn_hi32, &backup->checkpoint_lsn_lo32);
+
+   /* BASE_BACKUP sends a backup_manifest, so write the same one for the manifest phase */
+   manifest_path = pgmoneta_append(manifest_path, backup_data);
+   manifest_path = pgmoneta_append(manifest_path, "backup_manifest");
+
+   if (pgmoneta_generate_manifest(config->common.servers[server].version >= 17 ? 2 : 1, system_identifier,
+                                  backup_data, backup, &manifest, server, nodes))
+   {
+      pgmoneta_log_error("Parallel backup: Could not generate the manifest");
+      goto error;
+   }
+
+   if (pgmoneta_write_postgresql_manifest(manifest, manifest_path))
+   {
+      pgmoneta_log_error("Parallel backup: Could not write file %s to disk", manifest_path);
+      goto error;
+   }
+
+   size = pgmoneta_directory_size(backup_data);
+   biggest_file_size = pgmoneta_biggest_file(backup_data);
+
+   backup->restore_size = size;
+   backup->biggest_file_size = biggest_file_size;
+
+   pgmoneta_resume_finish(resume, true, backup_data);
+   resume = NULL;
+
+   if (pgmoneta_save_info(server_backup, backup))
+   {
+      pgmoneta_log_error("Parallel backup: Could not save backup %s", label);
+      goto error;
+   }
+
+   pgmoneta_close_ssl(ssl);
+   if (socket != -1)
+   {
+      pgmoneta_disconnect(socket);
+   }
+   free_string_array(server_files, num_of_server_files);
+
+   pgmoneta_json_destroy(manifest);
+   free(manifest_path);
+   free(start_backup_xlog);
+   free(stop_backup_xlog);
+   free(wal_dir);
+   free(wal);
+   free(tag);
+   free(start_wal_filename);
+   pgmoneta_free_message(msg);
+   pgmoneta_free_query_response(response);
+   pgmoneta_memory_destroy();
+   return 0;
+
+error:
+   pgmoneta_workers_destroy(workers);
+
+   /* Keep the files fetched so far for the next attempt */
+   pgmoneta_resume_finish(resume, false, backup_data);
+
+   if (backup_base == NULL)
+   {
+      backup_base = pgmoneta_get_server_backup_identifier(server, label);
+   }
+
+   if (pgmoneta_exists(backup_base))
+   {
+      pgmoneta_delete_directory(backup_base);
+   }
+
+   pgmoneta_close_ssl(ssl);
+   if (socket != -1)
+   {
+      pgmoneta_disconnect(socket);
+   }
+   free_string_array(server_files, num_of_server_files);
+
+   pgmoneta_json_destroy(manifest);
+   free(manifest_path);
+   free(start_backup_xlog);
+   free(stop_backup_xlog);
+   free(wal_dir);
+   free(wal);
+   free(tag);
+   free(start_wal_filename);
+   pgmoneta_free_message(msg);
+   pgmoneta_free_query_response(response);
+   pgmoneta_memory_destroy();
+   return 1;
+}
+
 static size_t
 get_incremental_header_size(uint32_t num_incr_blocks)
 {
@@ -1090,23 +1563,6 @@ get_incremental_file_size(uint32_t num_incr_blocks)
    return result;
 }
 
-static int
-compare_block_numbers(const void* a, const void* b)
-{
-   block_number aa = *(block_number*)a;
-   block_number bb = *(block_number*)b;
-
-   if (aa < bb)
-   {
-      return -1;
-   }
-   else if (aa > bb)
-   {
-      return 1;
-   }
-   return 0;
-}
-
 static int
 create_standard_directories(SSL* ssl, int socket, char* backup_data, char*** p, int* c)
 {
@@ -1396,7 +1852,8 @@ error:
 static int
 write_incremental_file(int server, SSL* ssl, int socket, char* backup_data,
                        char* relative_filename, uint32_t num_incr_blocks,
-                       block_number* incr_blocks, uint32_t truncation_block_length, bool empty)
+                       block_number* incr_blocks, block_ref_table_range* incr_ranges, int num_incr_ranges,
+                       uint32_t truncation_block_length, bool empty, struct resume* resume)
 {
    FILE* file = NULL;
    size_t expected_file_size;
@@ -1406,10 +1863,10 @@ write_incremental_file(int server, SSL* ssl, int socket, char* backup_data,
    char* rel_path = NULL;
    size_t padding_length = 0;
    size_t padding_bytes = 0;
-   block_number blkno;
    size_t bytes_written = 0;
+   bool truncated = false;
    uint8_t* binary_data = NULL;
-   int binary_data_length = 0;
+   int64_t binary_data_length = 0;
 
    /* preprocessing of incremental filename */
    rel_path = pgmoneta_append(rel_path, relative_filename);
@@ -1461,49 +1918,70 @@ write_incremental_file(int server, SSL* ssl, int socket, char* backup_data,
    }
 
    expected_file_size = get_incremental_file_size(num_incr_blocks);
+
+   binary_data = (uint8_t*)pgmoneta_memory_buffer_acquire(block_size * INCREMENTAL_FETCH_BLOCKS);
+   if (binary_data == NULL)
+   {
+      goto error;
+   }
    /*
        Request the blocks from the server
 
-       Assume the incremental block array is sorted, also note that we may have to consider
+       The runs of modified blocks are in block order and each run is fetched with one request
+       for up to INCREMENTAL_FETCH_BLOCKS blocks, also note that we may have to consider
        the filename with their segment number, which can be determined using the block number
        segment_number = block_number / (# of blocks in each segment)
 
        Will try to fetch untill either we get all the blocks (from server) with block number
        provided by the caller or request failed due to side effects like concurrent truncation.
     */
-   for (uint32_t i = 0; i < num_incr_blocks; i++)
+   for (int r = 0; !truncated && r < num_incr_ranges; r++)
    {
-      blkno = incr_blocks[i];
+      block_number blkno = incr_ranges[r].start;
+      uint32_t remaining = incr_ranges[r].length;
 
-      if (pgmoneta_server_read_binary_file(server, ssl, relative_filename,
-                                           block_size * blkno, block_size, socket, &binary_data, &binary_data_length))
+      while (remaining > 0)
       {
-         pgmoneta_log_error("Write incremental file: error fetching the block#%d of file: %s from the server", blkno, relative_filename);
-         goto error;
-      }
+         uint32_t count = MIN(remaining, (uint32_t)INCREMENTAL_FETCH_BLOCKS);
+         size_t requested = block_size * count;
 
-      /*
-          If partial read, means the relation is truncated after the incremental workflow has started.
-          Not to worry, just fill all the blocks including this one with 0, untill we wrote the number
-           of bytes expected by caller, WAL replay will take care of it later.
-       */
-      if ((size_t)binary_data_length < block_size)
-      {
-         free(binary_data);
-         binary_data = NULL;
-         break;
-      }
+         if (pgmoneta_server_read_binary_file(server, ssl, relative_filename,
+                                              (int64_t)block_size * blkno, requested, socket, binary_data, &binary_data_length))
+         {
+            pgmoneta_log_error("Write incremental file: error fetching the blocks#%u-%u of file: %s from the server",
+                               blkno, blkno + count - 1, relative_filename);
+            goto error;
+         }
 
-      bytes_written += fwrite(binary_data, sizeof(uint8_t), binary_data_length, file);
-      /* read/write content must be of multiple of block size length */
-      if (bytes_written % block_size)
-      {
-         pgmoneta_log_error("Write incremental file: partial write/read");
-         goto error;
-      }
+         pgmoneta_bandwidth_consume(binary_data_length);
+
+         /*
+             If partial read, means the relation is truncated after the incremental workflow has started.
+             Not to worry, keep the complete blocks and fill all the others with 0, untill we wrote the number
+              of bytes expected by caller, WAL replay will take care of it later.
+          */
+         if ((size_t)binary_data_length < requested)
+         {
+            binary_data_length -= binary_data_length % block_size;
+            truncated = true;
+         }
+
+         bytes_written += fwrite(binary_data, sizeof(uint8_t), binary_data_length, file);
+         /* read/write content must be of multiple of block size length */
+         if (bytes_written % block_size)
+         {
+            pgmoneta_log_error("Write incremental file: partial write/read");
+            goto error;
+         }
+
+         if (truncated)
+         {
+            break;
+         }
 
-      free(binary_data);
-      binary_data = NULL;
+         blkno += count;
+         remaining -= count;
+      }
    }
 
    /* Handle truncation, by padding with 0 */
@@ -1515,15 +1993,24 @@ write_incremental_file(int server, SSL* ssl, int socket, char* backup_data,
    bytes_written += padding_bytes;
 
 done:
+   pgmoneta_memory_buffer_release(binary_data);
+   binary_data = NULL;
+   fflush(file);
+   fclose(file);
+   file = NULL;
+
+   if (pgmoneta_resume_complete(resume, relative_filename, filepath + strlen(backup_data), false, backup_data))
+   {
+      goto error;
+   }
+
    free(filepath);
    free(file_name);
    free(rel_path);
-   fflush(file);
-   fclose(file);
    return 0;
 
 error:
-   free(binary_data);
+   pgmoneta_memory_buffer_release(binary_data);
    binary_data = NULL;
    free(filepath);
    free(file_name);
@@ -1538,14 +2025,14 @@ error:
 
 static int
 write_full_file(int server, SSL* ssl, int socket, char* backup_data,
-                char* relative_filename, size_t expected_size)
+                char* relative_filename, size_t expected_size, struct resume* resume, bool checksum)
 {
    FILE* file = NULL;
    size_t chunk_size = block_size * 1024;
-   size_t offset = 0;
+   int64_t offset = 0;
    char* filepath = NULL;
    uint8_t* binary_data = NULL;
-   int binary_data_length = 0;
+   int64_t binary_data_length = 0;
    size_t bytes_written = 0;
 
    if (expected_size % block_size)
@@ -1563,10 +2050,16 @@ write_full_file(int server, SSL* ssl, int socket, char* backup_data,
       goto error;
    }
 
+   binary_data = (uint8_t*)pgmoneta_memory_buffer_acquire(chunk_size);
+   if (binary_data == NULL)
+   {
+      goto error;
+   }
+
    while (true)
    {
       if (pgmoneta_server_read_binary_file(server, ssl, relative_filename, offset, chunk_size,
-                                           socket, &binary_data, &binary_data_length))
+                                           socket, binary_data, &binary_data_length))
       {
          goto error;
       }
@@ -1574,11 +2067,11 @@ write_full_file(int server, SSL* ssl, int socket, char* backup_data,
       /* EOF */
       if (binary_data_length == 0)
       {
-         free(binary_data);
-         binary_data = NULL;
          break;
       }
 
+      pgmoneta_bandwidth_consume(binary_data_length);
+
       /* write the output */
       bytes_written = fwrite(binary_data, sizeof(uint8_t), binary_data_length, file);
       if (bytes_written != (size_t)binary_data_length)
@@ -1587,16 +2080,23 @@ write_full_file(int server, SSL* ssl, int socket, char* backup_data,
       }
 
       offset += binary_data_length;
-      free(binary_data);
-      binary_data = NULL;
    }
 
-   free(filepath);
+   pgmoneta_memory_buffer_release(binary_data);
+   binary_data = NULL;
    fflush(file);
    fclose(file);
+   file = NULL;
+
+   if (pgmoneta_resume_complete(resume, relative_filename, relative_filename, checksum, backup_data))
+   {
+      goto error;
+   }
+
+   free(filepath);
    return 0;
 error:
-   free(binary_data);
+   pgmoneta_memory_buffer_release(binary_data);
    binary_data = NULL;
    free(filepath);
    if (file != NULL)
@@ -1911,3 +2411,177 @@ error:
    }
    return 1;
 }
+
+static void
+do_parallel_fetch(struct worker_common* wc)
+{
+   int i = 0;
+   int segno = 0;
+   bool checksum = true;
+   char* path = NULL;
+   char* local = NULL;
+   SSL* ssl = NULL;
+   int socket = -1;
+   struct rel_file_locator rlocator = {0};
+   enum fork_number frk = MAIN_FORKNUM;
+   struct parallel_input* pi = (struct parallel_input*)wc;
+   struct parallel_backup* pb = pi->backup;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   pgmoneta_memory_init();
+
+   if (pgmoneta_server_authenticate(pb->server, "postgres", config->common.users[pb->usr].username,
+                                    config->common.users[pb->usr].password, false, &ssl, &socket) != AUTH_SUCCESS)
+   {
+      pgmoneta_record_failure(wc->workers->outcome, "Parallel backup: Unable to connect to %s", config->common.servers[pb->server].name);
+      goto error;
+   }
+
+   if (pgmoneta_server_prepare_read_binary_file(pb->server, ssl, socket))
+   {
+      pgmoneta_record_failure(wc->workers->outcome, "Parallel backup: Unable to read files from %s", config->common.servers[pb->server].name);
+      goto error;
+   }
+
+   while (!atomic_load(&pb->failed))
+   {
+      i = atomic_fetch_add(&pb->next, 1);
+      if (i >= pb->number_of_files)
+      {
+         break;
+      }
+
+      path = pb->files[i];
+
+      if (parallel_exclude(path))
+      {
+         continue;
+      }
+
+      /* Relation forks are WAL-logged, so an interrupted backup can keep the ones without changes */
+      checksum = true;
+      frk = MAIN_FORKNUM;
+      if ((pgmoneta_starts_with(path, "base/") || pgmoneta_starts_with(path, "global/")) &&
+          !pgmoneta_ends_with(path, "pg_filenode.map") && !pgmoneta_ends_with(path, "PG_VERSION") &&
+          !pgmoneta_ends_with(path, "pg_control") &&
+          !parse_relation_file(pb->backup_data, path, &rlocator, &frk, &segno))
+      {
+         checksum = frk == FSM_FORKNUM;
+      }
+
+      if (pgmoneta_resume_reuse(pb->resume, ssl, socket, path, checksum ? NULL : &rlocator, frk, pb->backup_data))
+      {
+         continue;
+      }
+
+      if (write_full_file(pb->server, ssl, socket, pb->backup_data, path, 0, pb->resume, checksum))
+      {
+         /* A file dropped during the backup is recreated by the WAL replay, as with BASE_BACKUP */
+         if (parallel_vanished(ssl, socket, path))
+         {
+            pgmoneta_log_debug("Parallel backup: %s was removed during the backup", path);
+
+            local = pgmoneta_append(local, pb->backup_data);
+            local = pgmoneta_append(local, path);
+            if (pgmoneta_exists(local))
+            {
+               pgmoneta_delete_file(local, NULL);
+            }
+            free(local);
+            local = NULL;
+            continue;
+         }
+
+         pgmoneta_record_failure(wc->workers->outcome, "Parallel backup: Error during backup of %s", path);
+         goto error;
+      }
+   }
+
+   pgmoneta_close_ssl(ssl);
+   if (socket != -1)
+   {
+      pgmoneta_disconnect(socket);
+   }
+   pgmoneta_memory_destroy();
+   free(pi);
+
+   return;
+
+error:
+   atomic_store(&pb->failed, true);
+
+   pgmoneta_close_ssl(ssl);
+   if (socket != -1)
+   {
+      pgmoneta_disconnect(socket);
+   }
+   pgmoneta_memory_destroy();
+   free(pi);
+}
+
+static bool
+parallel_exclude(char* path)
+{
+   char* name = NULL;
+   static char* directories[] = {"pg_wal/", "pg_dynshmem/", "pg_notify/", "pg_replslot/", "pg_serial/",
+                                 "pg_snapshots/", "pg_stat_tmp/", "pg_subtrans/", NULL};
+   static char* files[] = {"postmaster.pid", "postmaster.opts", "backup_label", "tablespace_map",
+                           "backup_manifest", "current_logfiles", NULL};
+
+   for (int i = 0; directories[i] != NULL; i++)
+   {
+      if (pgmoneta_starts_with(path, directories[i]))
+      {
+         return true;
+      }
+   }
+
+   for (int i = 0; files[i] != NULL; i++)
+   {
+      if (pgmoneta_compare_string(path, files[i]))
+      {
+         return true;
+      }
+   }
+
+   name = strrchr(path, '/');
+   name = name != NULL ? name + 1 : path;
+
+   return pgmoneta_compare_string(name, "pg_internal.init") || strstr(path, "pgsql_tmp") != NULL;
+}
+
+static bool
+parallel_vanished(SSL* ssl, int socket, char* path)
+{
+   bool vanished = false;
+   char result[2];
+   int64_t length = 0;
+   int32_t types[1] = {TEXTOID};
+   struct message* parse_msg = NULL;
+   struct message* bind_msg = NULL;
+
+   memset(result, 0, sizeof(result));
+
+   /* The path is bound as a parameter of the unnamed statement, never pasted into the query */
+   if (pgmoneta_create_parse_message("", "SELECT pg_stat_file($1, true) IS NULL;", 1, &types[0], &parse_msg) != MESSAGE_STATUS_OK ||
+       pgmoneta_extended_query_execute(ssl, socket, parse_msg, NULL, 0, NULL))
+   {
+      goto done;
+   }
+
+   if (pgmoneta_create_bind_execute_message("", 1, &path, false, &bind_msg) != MESSAGE_STATUS_OK ||
+       pgmoneta_extended_query_execute(ssl, socket, bind_msg, &result[0], sizeof(result) - 1, &length))
+   {
+      goto done;
+   }
+
+   vanished = length == 1 && result[0] == 't';
+
+done:
+   pgmoneta_free_message(parse_msg);
+   pgmoneta_free_message(bind_msg);
+
+   return vanished;
+}
@@ -31,6 +31,7 @@
 #include <pgmoneta.h>
 #include <art.h>
 #include <backup.h>
+#include <delete.h>
 #include <link.h>
 #include <logging.h>
 #include <management.h>
@@ -261,9 +262,12 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
    struct workers* workers = NULL;
    struct main_configuration* config;
    struct backup* temp_backup = NULL;
+   struct workers* reclaim = NULL;
 
    config = (struct main_configuration*)shmem;
 
+   reclaim = (struct workers*)pgmoneta_art_search(nodes, NODE_RECLAIM);
+
    /* Find previous valid backup */
    for (int i = index - 1; prev_index == -1 && i >= 0; i--)
    {
@@ -321,7 +325,7 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
          pgmoneta_workers_destroy(workers);
 
          /* Delete from */
-         pgmoneta_delete_directory(d);
+         pgmoneta_delete_reclaim(server, d, reclaim);
          free(d);
          d = NULL;
 
@@ -355,7 +359,7 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
       else if (prev_index != -1)
       {
          /* Latest valid backup */
-         pgmoneta_delete_directory(d);
+         pgmoneta_delete_reclaim(server, d, reclaim);
       }
       else if (next_index != -1)
       {
@@ -376,7 +380,7 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
          pgmoneta_workers_destroy(workers);
 
          /* Delete from */
-         pgmoneta_delete_directory(d);
+         pgmoneta_delete_reclaim(server, d, reclaim);
          free(d);
          d = NULL;
 
@@ -410,13 +414,13 @@ delete_backup(int server, int index, struct backup* backup __attribute__((unused
       else
       {
          /* Only valid backup */
-         pgmoneta_delete_directory(d);
+         pgmoneta_delete_reclaim(server, d, reclaim);
       }
    }
    else
    {
       /* Just delete */
-      pgmoneta_delete_directory(d);
+      pgmoneta_delete_reclaim(server, d, reclaim);
    }
 
    free(temp_backup);
@@ -149,6 +149,8 @@ encryption_execute(char* name __attribute__((unused)), struct art* nodes)
       pgmoneta_deque_add(excludes, "backup.sha512", 0, ValueString);
       pgmoneta_deque_add(excludes, "backup.sha512.tmp", 0, ValueString);
       pgmoneta_deque_add(excludes, "backup.sha256", 0, ValueString);
+      pgmoneta_deque_add(excludes, COMPRESSION_MANIFEST, 0, ValueString);
+      pgmoneta_deque_add(excludes, COMPRESSION_DICTIONARY, 0, ValueString);
 
       if (pgmoneta_is_progress_enabled(server))
       {
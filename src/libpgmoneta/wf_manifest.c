@@ -26,7 +26,6 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <pgmoneta.h>
-#include <csv.h>
 #include <info.h>
 #include <logging.h>
 #include <manifest.h>
@@ -82,13 +81,7 @@ manifest_execute(char* name __attribute__((unused)), struct art* nodes)
    char* manifest_orig = NULL;
    char* manifest = NULL;
    char* incremental = NULL;
-   char* key_path[1] = {"Files"};
    struct backup* backup = NULL;
-   struct json_reader* reader = NULL;
-   struct json* entry = NULL;
-   struct csv_writer* writer = NULL;
-   char file_path[MAX_PATH];
-   char* info[MANIFEST_COLUMN_COUNT];
    struct main_configuration* config;
 
    struct json* m = NULL;
@@ -154,36 +147,16 @@ manifest_execute(char* name __attribute__((unused)), struct art* nodes)
       }
 
       pgmoneta_json_destroy(m);
+      m = NULL;
    }
 
-   if (pgmoneta_csv_writer_init(manifest, &writer))
+   // sorted by path, so manifests can be compared in a single pass
+   if (pgmoneta_manifest_convert(manifest_orig, manifest, MANIFEST_SORT_CHUNK))
    {
-      pgmoneta_log_error("Could not create csv writer for %s", manifest);
+      pgmoneta_log_error("Could not convert manifest %s", manifest_orig);
       goto error;
    }
 
-   if (pgmoneta_json_reader_init(manifest_orig, &reader))
-   {
-      goto error;
-   }
-   if (pgmoneta_json_locate(reader, key_path, 1))
-   {
-      pgmoneta_log_error("Could not locate files array in manifest %s", manifest_orig);
-      goto error;
-   }
-
-   // convert original manifest file
-   while (pgmoneta_json_next_array_item(reader, &entry))
-   {
-      memset(file_path, 0, MAX_PATH);
-      pgmoneta_snprintf(file_path, MAX_PATH, "%s", (char*)pgmoneta_json_get(entry, "Path"));
-      info[MANIFEST_PATH_INDEX] = file_path;
-      info[MANIFEST_CHECKSUM_INDEX] = (char*)pgmoneta_json_get(entry, "Checksum");
-      pgmoneta_csv_write(writer, MANIFEST_COLUMN_COUNT, info);
-      pgmoneta_json_destroy(entry);
-      entry = NULL;
-   }
-
    pgmoneta_permission(manifest, 6, 0, 0);
 
 #ifdef HAVE_FREEBSD
@@ -199,18 +172,12 @@ manifest_execute(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
 
-   pgmoneta_json_reader_close(reader);
-   pgmoneta_csv_writer_destroy(writer);
-   pgmoneta_json_destroy(entry);
    free(manifest);
    free(manifest_orig);
 
    return 0;
 error:
    pgmoneta_json_destroy(m);
-   pgmoneta_json_reader_close(reader);
-   pgmoneta_csv_writer_destroy(writer);
-   pgmoneta_json_destroy(entry);
    free(manifest);
    free(manifest_orig);
 
@@ -34,6 +34,8 @@
 #include <logging.h>
 #include <restore.h>
 #include <utils.h>
+#include <wal.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
@@ -60,6 +62,11 @@ static int restore_excluded_files_teardown(char*, struct art*);
 
 static char* get_user_password(char* username);
 static void create_standby_signal(char* basedir);
+static char* wal_target_directory(int server, char* directory, char* label);
+static void wal_recovery_target(struct art* nodes, struct backup* backup, uint32_t* tli, uint64_t* lsn);
+static uint64_t wal_staging_lsn(int server, struct backup* backup);
+static int wal_staging_start(int server, char* directory, char* label, struct backup* backup, struct art* nodes);
+static int wal_staging_finish(struct art* nodes);
 
 struct workflow*
 pgmoneta_create_restore(void)
@@ -217,6 +224,13 @@ restore_execute(char* name __attribute__((unused)), struct art* nodes)
    if (number_of_workers > 0)
    {
       pgmoneta_workers_initialize(number_of_workers, &workers);
+
+      /* WAL after the backup is staged in parallel with the data files */
+      if ((bool)pgmoneta_art_search(nodes, NODE_COPY_WAL) &&
+          wal_staging_start(server, directory, label, backup, nodes))
+      {
+         pgmoneta_log_warn("Restore: Unable to stage WAL for %s/%s during the restore", config->common.servers[server].name, label);
+      }
    }
 
    if (pgmoneta_copy_postgresql_restore(server, from, to, directory, label, backup, workers))
@@ -247,6 +261,8 @@ error:
       pgmoneta_workers_destroy(workers);
    }
 
+   wal_staging_finish(nodes);
+
    free(from);
    free(origwal);
    free(waldir);
@@ -274,7 +290,7 @@ combine_incremental_execute(char* name __attribute__((unused)), struct art* node
    char* output_dir;
    char* base = NULL;
    struct backup* bck = NULL;
-   struct json* manifest = NULL;
+   char* manifest = NULL;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
@@ -311,7 +327,7 @@ combine_incremental_execute(char* name __attribute__((unused)), struct art* node
    input_dir = pgmoneta_get_server_backup_identifier_data(server, label);
    base = (char*)pgmoneta_art_search(nodes, NODE_TARGET_ROOT);
    output_dir = (char*)pgmoneta_art_search(nodes, NODE_TARGET_BASE);
-   manifest = (struct json*)pgmoneta_art_search(nodes, NODE_MANIFEST);
+   manifest = (char*)pgmoneta_art_search(nodes, NODE_MANIFEST);
    if (manifest == NULL)
    {
       goto error;
@@ -728,11 +744,12 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
    int server = 0;
    char* label = NULL;
    struct backup* backup = NULL;
+   uint32_t tli = 0;
+   uint64_t lsn = 0;
+   uint64_t start_lsn = 0;
+   struct deque* files = NULL;
    int number_of_workers = 0;
    struct workers* workers = NULL;
-   struct main_configuration* config;
-
-   config = (struct main_configuration*)shmem;
 
 #ifdef DEBUG
    assert(nodes != NULL);
@@ -748,28 +765,52 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
       return 0;
    }
 
+   server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
+   label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
+   directory = (char*)pgmoneta_art_search(nodes, NODE_TARGET_ROOT);
+   backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
+
    number_of_workers = pgmoneta_get_number_of_workers(server);
    if (number_of_workers > 0)
    {
       pgmoneta_workers_initialize(number_of_workers, &workers);
    }
 
-   server = (int)pgmoneta_art_search(nodes, NODE_SERVER_ID);
-   label = (char*)pgmoneta_art_search(nodes, NODE_LABEL);
-   directory = (char*)pgmoneta_art_search(nodes, NODE_TARGET_ROOT);
-   backup = (struct backup*)pgmoneta_art_search(nodes, NODE_BACKUP);
-
    origwal = pgmoneta_get_server_backup_identifier_data_wal(server, label);
    waldir = pgmoneta_get_server_wal(server);
+   waltarget = wal_target_directory(server, directory, label);
 
-   waltarget = pgmoneta_append(waltarget, directory);
-   waltarget = pgmoneta_append(waltarget, "/");
-   waltarget = pgmoneta_append(waltarget, config->common.servers[server].name);
-   waltarget = pgmoneta_append(waltarget, "-");
-   waltarget = pgmoneta_append(waltarget, label);
-   waltarget = pgmoneta_append(waltarget, "/pg_wal/");
+   wal_recovery_target(nodes, backup, &tli, &lsn);
+   start_lsn = ((uint64_t)backup->start_lsn_hi32 << 32) | backup->start_lsn_lo32;
+
+   /* The WAL after the backup may already be staged during the restore */
+   if (pgmoneta_art_search(nodes, NODE_WAL_STAGING) != 0)
+   {
+      lsn = MIN(lsn, wal_staging_lsn(server, backup) - 1);
+   }
 
-   pgmoneta_copy_wal_files(server, waldir, waltarget, &backup->wal[0], workers);
+   if (pgmoneta_wal_restore_plan(server, start_lsn, tli, lsn, true, &files))
+   {
+      if (pgmoneta_art_search(nodes, NODE_WAL_STAGING) != 0)
+      {
+         goto error;
+      }
+
+      pgmoneta_log_warn("Restore: Unable to plan the WAL for %s, copying all WAL from %s", label, backup->wal);
+      pgmoneta_copy_wal_files(server, waldir, waltarget, &backup->wal[0], workers);
+   }
+   else
+   {
+      if (pgmoneta_is_progress_enabled(server))
+      {
+         pgmoneta_progress_set_total(server, pgmoneta_deque_size(files));
+      }
+
+      if (pgmoneta_wal_stage(server, files, waltarget, workers))
+      {
+         goto error;
+      }
+   }
 
    pgmoneta_workers_wait(workers);
    if (workers != NULL && !pgmoneta_workers_outcome_ok(workers))
@@ -778,7 +819,19 @@ copy_wal_execute(char* name __attribute__((unused)), struct art* nodes)
       goto error;
    }
    pgmoneta_workers_destroy(workers);
+   workers = NULL;
+
+   if (files != NULL && pgmoneta_is_progress_enabled(server))
+   {
+      pgmoneta_progress_increment(server, pgmoneta_deque_size(files));
+   }
 
+   if (wal_staging_finish(nodes))
+   {
+      goto error;
+   }
+
+   pgmoneta_deque_destroy(files);
    free(origwal);
    free(waldir);
    free(waltarget);
@@ -789,6 +842,8 @@ error:
    {
       pgmoneta_workers_destroy(workers);
    }
+   wal_staging_finish(nodes);
+   pgmoneta_deque_destroy(files);
    free(origwal);
    free(waldir);
    free(waltarget);
@@ -1029,3 +1084,177 @@ create_standby_signal(char* basedir)
 
    free(f);
 }
+
+static char*
+wal_target_directory(int server, char* directory, char* label)
+{
+   char* waltarget = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   waltarget = pgmoneta_append(waltarget, directory);
+   waltarget = pgmoneta_append(waltarget, "/");
+   waltarget = pgmoneta_append(waltarget, config->common.servers[server].name);
+   waltarget = pgmoneta_append(waltarget, "-");
+   waltarget = pgmoneta_append(waltarget, label);
+   waltarget = pgmoneta_append(waltarget, "/pg_wal/");
+
+   return waltarget;
+}
+
+static void
+wal_recovery_target(struct art* nodes, struct backup* backup, uint32_t* tli, uint64_t* lsn)
+{
+   char tokens[512];
+   char* position = NULL;
+   char* ptr = NULL;
+
+   *tli = 0;
+   *lsn = UINT64_MAX;
+
+   position = (char*)pgmoneta_art_search(nodes, USER_POSITION);
+   if (position == NULL || strlen(position) == 0)
+   {
+      return;
+   }
+
+   memset(&tokens[0], 0, sizeof(tokens));
+   memcpy(&tokens[0], position, MIN(strlen(position), sizeof(tokens) - 1));
+
+   ptr = strtok(&tokens[0], ",");
+
+   while (ptr != NULL)
+   {
+      char* value = strchr(ptr, '=');
+
+      if (value != NULL)
+      {
+         *value = '\0';
+         value++;
+      }
+
+      if (pgmoneta_compare_string(ptr, "lsn") && value != NULL && pgmoneta_lsn_from_string(value) != 0)
+      {
+         *lsn = pgmoneta_lsn_from_string(value);
+      }
+      else if (pgmoneta_compare_string(ptr, "immediate"))
+      {
+         /* Recovery ends as soon as the backup is consistent */
+         *lsn = ((uint64_t)backup->end_lsn_hi32 << 32) | backup->end_lsn_lo32;
+      }
+      else if (pgmoneta_compare_string(ptr, "timeline") && value != NULL)
+      {
+         if (pgmoneta_compare_string(value, "current"))
+         {
+            *tli = backup->end_timeline;
+         }
+         else if (strlen(value) > 0 && !pgmoneta_compare_string(value, "latest"))
+         {
+            *tli = (uint32_t)strtoul(value, NULL, 10);
+         }
+      }
+
+      ptr = strtok(NULL, ",");
+   }
+}
+
+static uint64_t
+wal_staging_lsn(int server, struct backup* backup)
+{
+   uint64_t end_lsn;
+   uint64_t segsize;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   segsize = (uint64_t)config->common.servers[server].wal_size;
+   end_lsn = ((uint64_t)backup->end_lsn_hi32 << 32) | backup->end_lsn_lo32;
+
+   /* The first segment after the backup, which can't be part of the backup itself */
+   return (end_lsn / segsize + 1) * segsize;
+}
+
+static int
+wal_staging_start(int server, char* directory, char* label, struct backup* backup, struct art* nodes)
+{
+   uint32_t tli = 0;
+   uint64_t lsn = 0;
+   char* waltarget = NULL;
+   struct deque* files = NULL;
+   struct workers* staging = NULL;
+
+   wal_recovery_target(nodes, backup, &tli, &lsn);
+
+   if (pgmoneta_wal_restore_plan(server, wal_staging_lsn(server, backup), tli, lsn, false, &files))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_empty(files))
+   {
+      pgmoneta_deque_destroy(files);
+      return 0;
+   }
+
+   if (pgmoneta_workers_initialize(pgmoneta_get_number_of_workers(server), &staging))
+   {
+      goto error;
+   }
+
+   waltarget = wal_target_directory(server, directory, label);
+
+   pgmoneta_log_debug("Restore: Staging %d WAL files while the data files are restored", pgmoneta_deque_size(files));
+
+   if (pgmoneta_wal_stage(server, files, waltarget, staging))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_art_insert(nodes, NODE_WAL_STAGING, (uintptr_t)staging, ValueRef))
+   {
+      goto error;
+   }
+
+   pgmoneta_deque_destroy(files);
+   free(waltarget);
+
+   return 0;
+
+error:
+
+   if (staging != NULL)
+   {
+      pgmoneta_workers_wait(staging);
+      pgmoneta_workers_destroy(staging);
+   }
+   pgmoneta_deque_destroy(files);
+   free(waltarget);
+
+   return 1;
+}
+
+static int
+wal_staging_finish(struct art* nodes)
+{
+   bool ok = true;
+   struct workers* staging = NULL;
+
+   staging = (struct workers*)pgmoneta_art_search(nodes, NODE_WAL_STAGING);
+   if (staging == NULL)
+   {
+      return 0;
+   }
+
+   pgmoneta_workers_wait(staging);
+   if (!pgmoneta_workers_outcome_ok(staging))
+   {
+      pgmoneta_workers_transfer_failures(staging, nodes);
+      ok = false;
+   }
+   pgmoneta_workers_destroy(staging);
+
+   pgmoneta_art_delete(nodes, NODE_WAL_STAGING);
+
+   return ok ? 0 : 1;
+}
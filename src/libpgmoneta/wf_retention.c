@@ -31,6 +31,7 @@
 #include <delete.h>
 #include <logging.h>
 #include <utils.h>
+#include <workers.h>
 #include <workflow.h>
 
 /* system */
@@ -103,6 +104,10 @@ retention_execute(char* name __attribute__((unused)), struct art* nodes)
    struct backup** backups = NULL;
    struct backup* child = NULL;
    bool* retention_keep = NULL;
+   int number_of_workers = 0;
+   int deleted = 0;
+   bool found = false;
+   struct workers* reclaim = NULL;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
@@ -147,47 +152,79 @@ retention_execute(char* name __attribute__((unused)), struct art* nodes)
          retention_years = config->retention_years;
       }
 
-      number_of_backups = 0;
-      backups = NULL;
+      deleted = 0;
 
-      d = pgmoneta_get_server_backup(i);
+      /* Expired backups are moved aside, and their trees removed in the background */
+      number_of_workers = pgmoneta_get_number_of_workers(i);
+      if (number_of_workers > 0)
+      {
+         pgmoneta_workers_initialize(number_of_workers, &reclaim);
+      }
+
+      pgmoneta_delete_trash(i, reclaim);
 
-      pgmoneta_load_infos(d, &number_of_backups, &backups);
+      d = pgmoneta_get_server_backup(i);
 
-      if (number_of_backups > 0)
+      /* A deletion changes the backup chains, so reload them after each one */
+      do
       {
-         mark_retention(i, retention_days, retention_weeks, retention_months,
-                        retention_years, number_of_backups, backups, &retention_keep);
-         for (int j = 0; j < number_of_backups; j++)
+         found = false;
+         number_of_backups = 0;
+         backups = NULL;
+
+         pgmoneta_load_infos(d, &number_of_backups, &backups);
+
+         if (number_of_backups > 0)
          {
-            if (!retention_keep[j])
+            mark_retention(i, retention_days, retention_weeks, retention_months,
+                           retention_years, number_of_backups, backups, &retention_keep);
+            for (int j = 0; !found && j < number_of_backups; j++)
             {
-               pgmoneta_get_backup_child(i, backups[j], &child);
-               // a backup can only be deleted if it has no child
-               if (!backups[j]->keep && child == NULL)
+               if (!retention_keep[j])
                {
-                  pgmoneta_log_trace("Retention: %s/%s (%s)", config->common.servers[i].name, backups[j]->label, atomic_load(&config->common.servers[i].repository) ? "Active" : "Inactive");
-
-                  if (!atomic_load(&config->common.servers[i].repository))
+                  pgmoneta_get_backup_child(i, backups[j], &child);
+                  // a backup can only be deleted if it has no child
+                  if (!backups[j]->keep && child == NULL)
                   {
-                     pgmoneta_log_info("Retention: %s/%s", config->common.servers[i].name, backups[j]->label);
-                     pgmoneta_delete(i, backups[j]->label);
-                     break;
+                     pgmoneta_log_trace("Retention: %s/%s (%s)", config->common.servers[i].name, backups[j]->label, atomic_load(&config->common.servers[i].repository) ? "Active" : "Inactive");
+
+                     if (!atomic_load(&config->common.servers[i].repository))
+                     {
+                        pgmoneta_log_info("Retention: %s/%s", config->common.servers[i].name, backups[j]->label);
+                        if (!pgmoneta_delete_deferred(i, backups[j]->label, reclaim))
+                        {
+                           deleted++;
+                           found = true;
+                        }
+                     }
                   }
+                  free(child);
+                  child = NULL;
                }
-               free(child);
-               child = NULL;
             }
          }
-      }
 
-      pgmoneta_delete_wal(i);
+         for (int j = 0; j < number_of_backups; j++)
+         {
+            free(backups[j]);
+         }
+         free(backups);
+         backups = NULL;
+
+         free(retention_keep);
+         retention_keep = NULL;
+      }
+      while (found);
 
-      for (int j = 0; j < number_of_backups; j++)
+      if (deleted > 1)
       {
-         free(backups[j]);
+         pgmoneta_log_debug("Retention: %d backups for %s", deleted, config->common.servers[i].name);
       }
-      free(backups);
+
+      pgmoneta_delete_wal(i);
+
+      number_of_backups = 0;
+      backups = NULL;
 
       if (config->common.servers[i].number_of_hot_standbys > 0)
       {
@@ -227,8 +264,10 @@ retention_execute(char* name __attribute__((unused)), struct art* nodes)
          free(srv);
       }
 
-      free(retention_keep);
-      retention_keep = NULL;
+      pgmoneta_workers_wait(reclaim);
+      pgmoneta_workers_destroy(reclaim);
+      reclaim = NULL;
+
       free(d);
       d = NULL;
    }
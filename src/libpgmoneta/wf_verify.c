@@ -120,15 +120,14 @@ verify_execute(char* name __attribute__((unused)), struct art* nodes)
 
    if (pgmoneta_is_progress_enabled(server))
    {
-      struct deque* manifest_paths = NULL;
+      int manifest_files = 0;
 
-      if (pgmoneta_manifest_get_paths(manifest_file, &manifest_paths))
+      if (pgmoneta_manifest_count_files(manifest_file, &manifest_files))
       {
-         pgmoneta_log_error("Verify: Unable to get manifest paths for progress tracking: %s", manifest_file);
+         pgmoneta_log_error("Verify: Unable to count manifest files for progress tracking: %s", manifest_file);
          goto error;
       }
-      pgmoneta_progress_set_total(server, pgmoneta_deque_size(manifest_paths));
-      pgmoneta_deque_destroy(manifest_paths);
+      pgmoneta_progress_set_total(server, manifest_files);
    }
    if (pgmoneta_deque_create(true, &failed_deque))
    {
@@ -30,6 +30,7 @@
 #include <pgmoneta.h>
 #include <compression.h>
 #include <deque.h>
+#include <info.h>
 #include <logging.h>
 #include <progress.h>
 #include <utils.h>
@@ -39,10 +40,12 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 static char* zstd_name(void);
 static int zstd_execute_compress(char*, struct art*);
 static int zstd_execute_uncompress(char*, struct art*);
+static int zstd_link_dictionary(int server, struct backup* backup, char* backup_base);
 
 struct workflow*
 pgmoneta_create_zstd(bool compress)
@@ -155,6 +158,11 @@ zstd_execute_compress(char* name __attribute__((unused)), struct art* nodes)
          pgmoneta_progress_set_total(server, file_count);
       }
 
+      if (config->compression_dictionary && zstd_link_dictionary(server, backup, backup_base))
+      {
+         goto error;
+      }
+
       if (pgmoneta_compress_directory(server, backup_base, COMPRESSION_SERVER_ZSTD, workers, excludes))
       {
          goto error;
@@ -329,3 +337,48 @@ error:
 
    return 1;
 }
+
+static int
+zstd_link_dictionary(int server, struct backup* backup, char* backup_base)
+{
+   char* from = NULL;
+   char* to = NULL;
+
+   if (backup == NULL || backup->type != TYPE_INCREMENTAL || strlen(backup->parent_label) == 0)
+   {
+      return 0;
+   }
+
+   from = pgmoneta_get_server_backup_identifier(server, backup->parent_label);
+   from = pgmoneta_append(from, COMPRESSION_DICTIONARY);
+
+   to = pgmoneta_append(to, backup_base);
+   if (!pgmoneta_ends_with(to, "/"))
+   {
+      to = pgmoneta_append(to, "/");
+   }
+   to = pgmoneta_append(to, COMPRESSION_DICTIONARY);
+
+   /* The incremental backup shares the dictionary of its parent, and the
+    * hard link keeps it when retention removes the parent */
+   if (pgmoneta_exists(from) && !pgmoneta_exists(to))
+   {
+      if (link(from, to) && pgmoneta_copy_file(from, to, NULL))
+      {
+         pgmoneta_log_error("ZSTD: Could not link dictionary %s to %s", from, to);
+         goto error;
+      }
+   }
+
+   free(from);
+   free(to);
+
+   return 0;
+
+error:
+
+   free(from);
+   free(to);
+
+   return 1;
+}
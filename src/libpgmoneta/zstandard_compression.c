@@ -30,18 +30,23 @@
 #include <pgmoneta.h>
 #include <aes.h>
 #include <compression.h>
+#include <deque.h>
 #include <extraction.h>
 #include <logging.h>
 #include <management.h>
+#include <memory.h>
 #include <utils.h>
+#include <value.h>
 #include <zstandard_compression.h>
 
 /* system */
 #include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <zdict.h>
 #include <zstd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -50,6 +55,9 @@
 #define NAME                           "zstd"
 #define ZSTD_DEFAULT_NUMBER_OF_WORKERS 4
 
+#define ZSTD_MAX_CONTEXTS     64
+#define ZSTD_MAX_DICTIONARIES 64
+
 static int zstd_compress(char* from, char* to, ZSTD_CCtx* cctx, size_t zin_size, void* zin, size_t zout_size, void* zout);
 static int zstd_decompress(char* from, char* to, ZSTD_DCtx* dctx, size_t zin_size, void* zin, size_t zout_size, void* zout);
 static int zstd_configure_cctx(ZSTD_CCtx* cctx, int level, int workers);
@@ -58,13 +66,40 @@ static int zstd_compressor_compress(struct compressor* compressor, void* out_buf
 static int zstd_compressor_decompress(struct compressor* compressor, void* out_buf, size_t out_capacity, size_t* out_size, bool* finished);
 static void zstd_compressor_close(struct compressor* compressor);
 
+static int zstd_reference_dictionary(ZSTD_DCtx* dctx, void* src, size_t size);
+static int zstd_collect_samples(char* directory, struct deque* candidates, size_t* total);
+static int zstd_dictionary_find(int server, uint32_t id, void** data, size_t* size);
+static int zstd_dictionary_read(char* path, void** data, size_t* size);
+static char* zstd_dictionary_path(char* directory);
+
 struct zstd_compressor
 {
    struct compressor super;
    ZSTD_DCtx* dctx;
    ZSTD_CCtx* cctx;
+   bool dictionary;
+};
+
+struct zstd_dictionary
+{
+   uint32_t id;                               /**< The dictionary ID */
+   ZSTD_CDict* cdict;                         /**< The digested dictionary */
+   pthread_mutex_t lock;                      /**< The lock of the contexts */
+   ZSTD_CCtx* contexts[ZSTD_MAX_CONTEXTS];    /**< The idle compression contexts */
+   int number_of_contexts;                    /**< The number of idle compression contexts */
+};
+
+/* The dictionaries loaded for decompression in this process */
+struct zstd_ddict
+{
+   uint32_t id;       /**< The dictionary ID */
+   ZSTD_DDict* ddict; /**< The digested dictionary */
 };
 
+static pthread_mutex_t ddicts_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct zstd_ddict ddicts[ZSTD_MAX_DICTIONARIES];
+static int number_of_ddicts = 0;
+
 void
 pgmoneta_zstandardd_request(SSL* ssl, int client_fd, uint8_t compression, uint8_t encryption, struct json* payload)
 {
@@ -174,7 +209,7 @@ pgmoneta_zstandardd_file(char* from, char* to)
    if (pgmoneta_ends_with(from, ".zstd"))
    {
       zin_size = ZSTD_DStreamInSize();
-      zin = malloc(zin_size);
+      zin = pgmoneta_memory_buffer_acquire(zin_size);
       if (zin == NULL)
       {
          pgmoneta_log_error("ZSTD: Allocation failed (input buffer)");
@@ -182,7 +217,7 @@ pgmoneta_zstandardd_file(char* from, char* to)
       }
 
       zout_size = ZSTD_DStreamOutSize();
-      zout = malloc(zout_size);
+      zout = pgmoneta_memory_buffer_acquire(zout_size);
       if (zout == NULL)
       {
          pgmoneta_log_error("ZSTD: Allocation failed (output buffer)");
@@ -218,8 +253,8 @@ pgmoneta_zstandardd_file(char* from, char* to)
 
    ZSTD_freeDCtx(dctx);
 
-   free(zin);
-   free(zout);
+   pgmoneta_memory_buffer_release(zin);
+   pgmoneta_memory_buffer_release(zout);
 
    return 0;
 
@@ -230,8 +265,8 @@ error:
       ZSTD_freeDCtx(dctx);
    }
 
-   free(zin);
-   free(zout);
+   pgmoneta_memory_buffer_release(zin);
+   pgmoneta_memory_buffer_release(zout);
 
    return 1;
 }
@@ -332,20 +367,32 @@ error:
 
 int
 pgmoneta_zstandardc_file(char* from, char* to)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   return pgmoneta_zstandardc_file_level(from, to, config->compression_level);
+}
+
+int
+pgmoneta_zstandardc_file_level(char* from, char* to, int level)
 {
    size_t zin_size = 0;
    void* zin = NULL;
    size_t zout_size = 0;
    void* zout = NULL;
    ZSTD_CCtx* cctx = NULL;
-   int level;
    int workers;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shmem;
 
-   level = config->compression_level;
-   if (level < 1)
+   if (level == COMPRESSION_LEVEL_STORE)
+   {
+      level = ZSTD_minCLevel();
+   }
+   else if (level < 1)
    {
       level = 1;
    }
@@ -357,14 +404,14 @@ pgmoneta_zstandardc_file(char* from, char* to)
    workers = config->workers != 0 ? config->workers : ZSTD_DEFAULT_NUMBER_OF_WORKERS;
 
    zin_size = ZSTD_CStreamInSize();
-   zin = malloc(zin_size);
+   zin = pgmoneta_memory_buffer_acquire(zin_size);
    if (zin == NULL)
    {
       pgmoneta_log_error("ZSTD: Allocation failed (input buffer)");
       goto error;
    }
    zout_size = ZSTD_CStreamOutSize();
-   zout = malloc(zout_size);
+   zout = pgmoneta_memory_buffer_acquire(zout_size);
    if (zout == NULL)
    {
       pgmoneta_log_error("ZSTD: Allocation failed (output buffer)");
@@ -402,8 +449,8 @@ pgmoneta_zstandardc_file(char* from, char* to)
 
    ZSTD_freeCCtx(cctx);
 
-   free(zin);
-   free(zout);
+   pgmoneta_memory_buffer_release(zin);
+   pgmoneta_memory_buffer_release(zout);
 
    return 0;
 
@@ -414,8 +461,8 @@ error:
       ZSTD_freeCCtx(cctx);
    }
 
-   free(zin);
-   free(zout);
+   pgmoneta_memory_buffer_release(zin);
+   pgmoneta_memory_buffer_release(zout);
 
    return 1;
 }
@@ -502,6 +549,374 @@ pgmoneta_zstd_compressor_create(struct compressor** compressor)
    return 0;
 }
 
+int
+pgmoneta_zstandard_dictionary_train(char* directory, int level, struct zstd_dictionary** dictionary)
+{
+   struct deque* candidates = NULL;
+   struct deque_iterator* iter = NULL;
+   struct zstd_dictionary* d = NULL;
+   char* samples = NULL;
+   size_t* sizes = NULL;
+   unsigned number_of_samples = 0;
+   size_t samples_size = 0;
+   size_t total = 0;
+   size_t stride = 1;
+   size_t index = 0;
+   void* buffer = NULL;
+   size_t size;
+   uint32_t id;
+   char* path = NULL;
+   char* tmp = NULL;
+   FILE* file = NULL;
+
+   *dictionary = NULL;
+
+   path = zstd_dictionary_path(directory);
+   if (path == NULL)
+   {
+      goto error;
+   }
+
+   /* An incremental backup shares the dictionary of its parent */
+   if (pgmoneta_exists(path))
+   {
+      if (zstd_dictionary_read(path, &buffer, &size))
+      {
+         pgmoneta_log_error("ZSTD: Could not read dictionary %s", path);
+         goto error;
+      }
+
+      id = ZDICT_getDictID(buffer, size);
+      if (id == 0)
+      {
+         pgmoneta_log_error("ZSTD: Invalid dictionary %s", path);
+         goto error;
+      }
+
+      goto create;
+   }
+
+   if (pgmoneta_deque_create(false, &candidates))
+   {
+      goto error;
+   }
+
+   if (zstd_collect_samples(directory, candidates, &total))
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_size(candidates) < ZSTD_DICTIONARY_MIN_SAMPLES)
+   {
+      pgmoneta_log_debug("ZSTD: Too few small files in %s for a dictionary", directory);
+      goto done;
+   }
+
+   /* Spread the sample over the whole directory when it doesn't fit */
+   if (total > ZSTD_DICTIONARY_SAMPLE_SIZE)
+   {
+      stride = (total + ZSTD_DICTIONARY_SAMPLE_SIZE - 1) / ZSTD_DICTIONARY_SAMPLE_SIZE;
+   }
+
+   samples = (char*)malloc(ZSTD_DICTIONARY_SAMPLE_SIZE);
+   sizes = (size_t*)malloc(pgmoneta_deque_size(candidates) * sizeof(size_t));
+   buffer = malloc(ZSTD_DICTIONARY_SIZE);
+   if (samples == NULL || sizes == NULL || buffer == NULL)
+   {
+      goto error;
+   }
+
+   if (pgmoneta_deque_iterator_create(candidates, &iter))
+   {
+      goto error;
+   }
+
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      size_t file_size = (size_t)pgmoneta_value_data(iter->value);
+      size_t n;
+
+      if (index++ % stride != 0 || samples_size + file_size > ZSTD_DICTIONARY_SAMPLE_SIZE)
+      {
+         continue;
+      }
+
+      file = fopen(iter->tag, "rb");
+      if (file == NULL)
+      {
+         continue;
+      }
+
+      n = fread(samples + samples_size, 1, file_size, file);
+      fclose(file);
+      file = NULL;
+
+      if (n > 0)
+      {
+         sizes[number_of_samples++] = n;
+         samples_size += n;
+      }
+   }
+
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   if (number_of_samples < ZSTD_DICTIONARY_MIN_SAMPLES)
+   {
+      goto done;
+   }
+
+   size = ZDICT_trainFromBuffer(buffer, ZSTD_DICTIONARY_SIZE, samples, sizes, number_of_samples);
+   if (ZDICT_isError(size))
+   {
+      pgmoneta_log_debug("ZSTD: Dictionary training failed for %s: %s", directory, ZDICT_getErrorName(size));
+      goto done;
+   }
+
+   id = ZDICT_getDictID(buffer, size);
+   if (id == 0)
+   {
+      goto done;
+   }
+
+   /* The dictionary is part of the backup, and its identifier is in the header */
+   tmp = pgmoneta_append(tmp, path);
+   tmp = pgmoneta_append(tmp, ".tmp");
+
+   if (pgmoneta_fopen_secure(tmp, "wb", &file) || fwrite(buffer, 1, size, file) != size)
+   {
+      pgmoneta_log_error("ZSTD: Could not write dictionary %s", tmp);
+      if (file != NULL)
+      {
+         fclose(file);
+         file = NULL;
+      }
+      pgmoneta_delete_file(tmp, NULL);
+      goto error;
+   }
+
+   fflush(file);
+   fclose(file);
+   file = NULL;
+
+   if (pgmoneta_move_file(tmp, path))
+   {
+      goto error;
+   }
+
+   pgmoneta_log_debug("ZSTD: Dictionary %u trained from %u files (%zu bytes)", id, number_of_samples, samples_size);
+
+create:
+
+   d = (struct zstd_dictionary*)malloc(sizeof(struct zstd_dictionary));
+   if (d == NULL)
+   {
+      goto error;
+   }
+
+   memset(d, 0, sizeof(struct zstd_dictionary));
+   pthread_mutex_init(&d->lock, NULL);
+
+   d->id = id;
+   d->cdict = ZSTD_createCDict(buffer, size, MIN(19, MAX(1, level)));
+   if (d->cdict == NULL)
+   {
+      goto error;
+   }
+
+   *dictionary = d;
+   d = NULL;
+
+done:
+
+   pgmoneta_deque_destroy(candidates);
+   free(samples);
+   free(sizes);
+   free(buffer);
+   free(path);
+   free(tmp);
+
+   return 0;
+
+error:
+
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(candidates);
+   pgmoneta_zstandard_dictionary_destroy(d);
+   free(samples);
+   free(sizes);
+   free(buffer);
+   free(path);
+   free(tmp);
+
+   return 1;
+}
+
+uint32_t
+pgmoneta_zstandard_dictionary_id(struct zstd_dictionary* dictionary)
+{
+   return dictionary != NULL ? dictionary->id : 0;
+}
+
+int
+pgmoneta_zstandardc_file_dictionary(char* from, char* to, struct zstd_dictionary* dictionary)
+{
+   ZSTD_CCtx* cctx = NULL;
+   FILE* fin = NULL;
+   FILE* fout = NULL;
+   struct stat st;
+   void* in = NULL;
+   void* out = NULL;
+   size_t in_size;
+   size_t out_size;
+   size_t ret;
+   char* tmp_to = NULL;
+
+   if (dictionary == NULL || stat(from, &st) != 0 || (size_t)st.st_size > ZSTD_DICTIONARY_FILE_SIZE)
+   {
+      goto error;
+   }
+
+   pthread_mutex_lock(&dictionary->lock);
+   if (dictionary->number_of_contexts > 0)
+   {
+      cctx = dictionary->contexts[--dictionary->number_of_contexts];
+   }
+   pthread_mutex_unlock(&dictionary->lock);
+
+   if (cctx == NULL)
+   {
+      cctx = ZSTD_createCCtx();
+      if (cctx == NULL)
+      {
+         pgmoneta_log_error("ZSTD: Could not create compression context");
+         goto error;
+      }
+   }
+
+   ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+   ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+   ret = ZSTD_CCtx_refCDict(cctx, dictionary->cdict);
+   if (ZSTD_isError(ret))
+   {
+      pgmoneta_log_error("ZSTD: Could not reference dictionary: %s", ZSTD_getErrorName(ret));
+      goto error;
+   }
+
+   in = pgmoneta_memory_buffer_acquire(ZSTD_DICTIONARY_FILE_SIZE);
+   out = pgmoneta_memory_buffer_acquire(ZSTD_compressBound(ZSTD_DICTIONARY_FILE_SIZE));
+   if (in == NULL || out == NULL)
+   {
+      goto error;
+   }
+
+   fin = fopen(from, "rb");
+   if (fin == NULL)
+   {
+      pgmoneta_log_error("ZSTD: Could not open input file %s: %s", from, strerror(errno));
+      goto error;
+   }
+
+   in_size = fread(in, 1, ZSTD_DICTIONARY_FILE_SIZE, fin);
+   if (ferror(fin))
+   {
+      pgmoneta_log_error("ZSTD: Read error while compressing %s: %s", from, strerror(errno));
+      goto error;
+   }
+
+   fclose(fin);
+   fin = NULL;
+
+   out_size = ZSTD_compress2(cctx, out, ZSTD_compressBound(ZSTD_DICTIONARY_FILE_SIZE), in, in_size);
+   if (ZSTD_isError(out_size))
+   {
+      pgmoneta_log_error("ZSTD: Compression error: %s", ZSTD_getErrorName(out_size));
+      goto error;
+   }
+
+   tmp_to = pgmoneta_append(tmp_to, to);
+   tmp_to = pgmoneta_append(tmp_to, ".tmp");
+
+   if (pgmoneta_fopen_secure(tmp_to, "wb", &fout))
+   {
+      pgmoneta_log_error("ZSTD: Could not open output file %s: %s", tmp_to, strerror(errno));
+      goto error;
+   }
+
+   if (fwrite(out, 1, out_size, fout) != out_size)
+   {
+      pgmoneta_log_error("ZSTD: Write error while compressing %s: %s", to, strerror(errno));
+      goto error;
+   }
+
+   fflush(fout);
+   fclose(fout);
+   fout = NULL;
+
+   pgmoneta_permission(tmp_to, 6, 0, 0);
+   if (pgmoneta_move_file(tmp_to, to))
+   {
+      goto error;
+   }
+
+   pgmoneta_delete_file(from, NULL);
+
+   pthread_mutex_lock(&dictionary->lock);
+   if (dictionary->number_of_contexts < ZSTD_MAX_CONTEXTS)
+   {
+      dictionary->contexts[dictionary->number_of_contexts++] = cctx;
+      cctx = NULL;
+   }
+   pthread_mutex_unlock(&dictionary->lock);
+
+   ZSTD_freeCCtx(cctx);
+   pgmoneta_memory_buffer_release(in);
+   pgmoneta_memory_buffer_release(out);
+   free(tmp_to);
+
+   return 0;
+
+error:
+
+   if (fin != NULL)
+   {
+      fclose(fin);
+   }
+
+   if (fout != NULL)
+   {
+      fclose(fout);
+      pgmoneta_delete_file(tmp_to, NULL);
+   }
+
+   ZSTD_freeCCtx(cctx);
+   pgmoneta_memory_buffer_release(in);
+   pgmoneta_memory_buffer_release(out);
+   free(tmp_to);
+
+   return 1;
+}
+
+void
+pgmoneta_zstandard_dictionary_destroy(struct zstd_dictionary* dictionary)
+{
+   if (dictionary == NULL)
+   {
+      return;
+   }
+
+   for (int i = 0; i < dictionary->number_of_contexts; i++)
+   {
+      ZSTD_freeCCtx(dictionary->contexts[i]);
+   }
+
+   ZSTD_freeCDict(dictionary->cdict);
+   pthread_mutex_destroy(&dictionary->lock);
+
+   free(dictionary);
+}
+
 static int
 zstd_configure_cctx(ZSTD_CCtx* cctx, int level, int workers)
 {
@@ -640,6 +1055,7 @@ zstd_decompress(char* from, char* to, ZSTD_DCtx* dctx, size_t zin_size, void* zi
    size_t toRead;
    size_t read;
    size_t lastRet = 0;
+   bool first = true;
    char* tmp_to = NULL;
 
    fin = fopen(from, "rb");
@@ -663,6 +1079,13 @@ zstd_decompress(char* from, char* to, ZSTD_DCtx* dctx, size_t zin_size, void* zi
    while ((read = fread(zin, sizeof(char), toRead, fin)))
    {
       ZSTD_inBuffer input = (ZSTD_inBuffer){zin, read, 0};
+
+      if (first && zstd_reference_dictionary(dctx, zin, read))
+      {
+         goto error;
+      }
+      first = false;
+
       while (input.pos < input.size)
       {
          ZSTD_outBuffer output = (ZSTD_outBuffer){zout, zout_size, 0};
@@ -813,6 +1236,16 @@ zstd_compressor_decompress(struct compressor* compressor, void* out_buf, size_t
       }
    }
 
+   if (!this->dictionary)
+   {
+      if (zstd_reference_dictionary(this->dctx, (char*)this->super.in_buf + this->super.in_pos,
+                                    this->super.in_size - this->super.in_pos))
+      {
+         goto error;
+      }
+      this->dictionary = true;
+   }
+
    ZSTD_inBuffer input = {.src = this->super.in_buf, .size = this->super.in_size, .pos = this->super.in_pos};
    ZSTD_outBuffer output = {.dst = out_buf, .size = out_capacity, .pos = 0};
    size_t remaining = ZSTD_decompressStream(this->dctx, &output, &input);
@@ -841,3 +1274,231 @@ zstd_compressor_close(struct compressor* compressor)
    ZSTD_freeDCtx(this->dctx);
    ZSTD_freeCCtx(this->cctx);
 }
+
+static int
+zstd_reference_dictionary(ZSTD_DCtx* dctx, void* src, size_t size)
+{
+   struct main_configuration* config;
+   ZSTD_DDict* ddict = NULL;
+   void* data = NULL;
+   size_t data_size = 0;
+   uint32_t id;
+   size_t ret = 0;
+
+   config = (struct main_configuration*)shmem;
+
+   id = ZSTD_getDictID_fromFrame(src, size);
+   if (id == 0)
+   {
+      /* Drop a dictionary left over from an earlier frame */
+      ret = ZSTD_DCtx_refDDict(dctx, NULL);
+      return ZSTD_isError(ret) ? 1 : 0;
+   }
+
+   pthread_mutex_lock(&ddicts_lock);
+
+   for (int i = 0; ddict == NULL && i < number_of_ddicts; i++)
+   {
+      if (ddicts[i].id == id)
+      {
+         ddict = ddicts[i].ddict;
+      }
+   }
+
+   /* The dictionary is in a backup of any server, as backups may be restored elsewhere */
+   for (int i = 0; ddict == NULL && config != NULL && i < config->common.number_of_servers; i++)
+   {
+      if (!zstd_dictionary_find(i, id, &data, &data_size))
+      {
+         break;
+      }
+   }
+
+   /* Cached dictionaries live as long as the process, since any context may still reference them */
+   if (data != NULL && number_of_ddicts < ZSTD_MAX_DICTIONARIES)
+   {
+      ddict = ZSTD_createDDict(data, data_size);
+      if (ddict != NULL)
+      {
+         ddicts[number_of_ddicts].id = id;
+         ddicts[number_of_ddicts].ddict = ddict;
+         number_of_ddicts++;
+      }
+   }
+
+   if (ddict != NULL)
+   {
+      ret = ZSTD_DCtx_refDDict(dctx, ddict);
+   }
+   else if (data != NULL)
+   {
+      /* The cache is full, so the context gets its own copy */
+      ret = ZSTD_DCtx_loadDictionary(dctx, data, data_size);
+   }
+
+   pthread_mutex_unlock(&ddicts_lock);
+
+   if (ddict == NULL && data == NULL)
+   {
+      pgmoneta_log_error("ZSTD: Dictionary %u not found", id);
+      return 1;
+   }
+
+   free(data);
+
+   if (ZSTD_isError(ret))
+   {
+      pgmoneta_log_error("ZSTD: Could not reference dictionary %u: %s", id, ZSTD_getErrorName(ret));
+      return 1;
+   }
+
+   return 0;
+}
+
+static int
+zstd_collect_samples(char* directory, struct deque* candidates, size_t* total)
+{
+   DIR* dir = NULL;
+   struct dirent* entry = NULL;
+   char path[MAX_PATH];
+   struct stat st;
+
+   if (!(dir = opendir(directory)))
+   {
+      return 1;
+   }
+
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (pgmoneta_compare_string(entry->d_name, ".") || pgmoneta_compare_string(entry->d_name, ".."))
+      {
+         continue;
+      }
+
+      pgmoneta_snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+
+      if (lstat(path, &st) != 0)
+      {
+         continue;
+      }
+
+      if (S_ISDIR(st.st_mode))
+      {
+         zstd_collect_samples(path, candidates, total);
+      }
+      else if (S_ISREG(st.st_mode) && st.st_size > 0 && (size_t)st.st_size <= ZSTD_DICTIONARY_FILE_SIZE &&
+               !pgmoneta_is_compressed(path) && !pgmoneta_is_encrypted(path))
+      {
+         pgmoneta_deque_add(candidates, path, (uintptr_t)st.st_size, ValueUInt64);
+         *total += (size_t)st.st_size;
+      }
+   }
+
+   closedir(dir);
+
+   return 0;
+}
+
+static int
+zstd_dictionary_find(int server, uint32_t id, void** data, size_t* size)
+{
+   char* server_backup = NULL;
+   char path[MAX_PATH];
+   char header[8];
+   DIR* dir = NULL;
+   FILE* file = NULL;
+   struct dirent* entry = NULL;
+   bool found = false;
+
+   server_backup = pgmoneta_get_server_backup(server);
+   if (server_backup == NULL || !(dir = opendir(server_backup)))
+   {
+      free(server_backup);
+      return 1;
+   }
+
+   while (!found && (entry = readdir(dir)) != NULL)
+   {
+      if (pgmoneta_compare_string(entry->d_name, ".") || pgmoneta_compare_string(entry->d_name, ".."))
+      {
+         continue;
+      }
+
+      pgmoneta_snprintf(path, sizeof(path), "%s%s/%s", server_backup, entry->d_name, COMPRESSION_DICTIONARY);
+
+      /* Only the header is read until the identifier matches */
+      file = fopen(path, "rb");
+      if (file == NULL)
+      {
+         continue;
+      }
+
+      if (fread(header, 1, sizeof(header), file) == sizeof(header) && ZDICT_getDictID(header, sizeof(header)) == id)
+      {
+         found = zstd_dictionary_read(path, data, size) == 0;
+      }
+
+      fclose(file);
+   }
+
+   closedir(dir);
+   free(server_backup);
+
+   return found ? 0 : 1;
+}
+
+static int
+zstd_dictionary_read(char* path, void** data, size_t* size)
+{
+   FILE* file = NULL;
+   void* buffer = NULL;
+   struct stat st;
+
+   *data = NULL;
+   *size = 0;
+
+   if (stat(path, &st) != 0 || st.st_size <= 0)
+   {
+      goto error;
+   }
+
+   buffer = malloc((size_t)st.st_size);
+   file = fopen(path, "rb");
+
+   if (buffer == NULL || file == NULL || fread(buffer, 1, (size_t)st.st_size, file) != (size_t)st.st_size)
+   {
+      goto error;
+   }
+
+   fclose(file);
+
+   *data = buffer;
+   *size = (size_t)st.st_size;
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(buffer);
+
+   return 1;
+}
+
+static char*
+zstd_dictionary_path(char* directory)
+{
+   char* path = NULL;
+
+   path = pgmoneta_append(path, directory);
+   if (!pgmoneta_ends_with(path, "/"))
+   {
+      path = pgmoneta_append(path, "/");
+   }
+   path = pgmoneta_append(path, COMPRESSION_DICTIONARY);
+
+   return path;
+}
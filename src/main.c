@@ -51,6 +51,7 @@
 #include <restore.h>
 #include <retention.h>
 #include <s3.h>
+#include <scheduler.h>
 #include <security.h>
 #include <server.h>
 #include <shmem.h>
@@ -59,6 +60,7 @@
 #include <utils.h>
 #include <verify.h>
 #include <wal.h>
+#include <walarchive.h>
 #include <zstandard_compression.h>
 
 /* system */
@@ -102,6 +104,9 @@ static void retention_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void verification_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void valid_cb(struct ev_loop* loop, ev_periodic* w, int revents);
 static void wal_streaming_cb(struct ev_loop* loop, ev_periodic* w, int revents);
+static void scheduler_cb(struct ev_loop* loop, ev_periodic* w, int revents);
+static void wal_archive_cb(struct ev_loop* loop, ev_periodic* w, int revents);
+static void dispatch_backups(void);
 static bool accept_fatal(int error);
 static void reload_configuration(bool* restart);
 static void service_reload_cb(struct ev_loop* loop, ev_signal* w, int revents);
@@ -320,6 +325,8 @@ main(int argc, char** argv)
    struct ev_periodic valid;
    struct ev_periodic wal_streaming;
    struct ev_periodic verification;
+   struct ev_periodic scheduler;
+   struct ev_periodic wal_archive;
    size_t shmem_size;
    size_t prometheus_cache_shmem_size = 0;
    struct main_configuration* config = NULL;
@@ -784,6 +791,8 @@ main(int argc, char** argv)
       errx(1, "Error in creating and initializing prometheus cache shared memory");
    }
 
+   pgmoneta_memory_buffer_initialize(config->hugepage);
+
    /* Bind Unix Domain Socket */
    if (pgmoneta_bind_unix_socket(config->common.unix_socket_dir, MAIN_UDS, &unix_management_socket))
    {
@@ -932,6 +941,21 @@ main(int argc, char** argv)
    ev_periodic_init(&verification, verification_cb, 0., pgmoneta_time_convert(config->verification, FORMAT_TIME_S), 0);
    ev_periodic_start(main_loop, &verification);
 
+   /* Start the backup queue */
+   if (pgmoneta_scheduler_load())
+   {
+      pgmoneta_log_warn("Unable to load the backup queue");
+   }
+   ev_periodic_init(&scheduler, scheduler_cb, 0., 5, 0);
+   ev_periodic_start(main_loop, &scheduler);
+
+   /* Start the WAL archive to the S3 and Azure storage engines */
+   if (pgmoneta_wal_archive_enabled())
+   {
+      ev_periodic_init(&wal_archive, wal_archive_cb, 0., pgmoneta_time_convert(config->wal_archive, FORMAT_TIME_S), 0);
+      ev_periodic_start(main_loop, &wal_archive);
+   }
+
    pgmoneta_log_info("Started on %s", config->host);
    pgmoneta_log_debug("Management: %d", unix_management_socket);
    for (int i = 0; i < metrics_fds_length; i++)
@@ -995,6 +1019,8 @@ main(int argc, char** argv)
    sd_notify(0, "STOPPING=1");
 #endif
 
+   pgmoneta_scheduler_destroy();
+
    shutdown_management(true);
    shutdown_metrics();
    shutdown_nagios();
@@ -1176,25 +1202,18 @@ accept_mgt_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
       {
          if (pgmoneta_server_is_online(srv))
          {
-            pid = fork();
-            if (pid == -1)
+            if (pgmoneta_scheduler_enqueue(srv, client_fd, compression, encryption, payload))
             {
-               pgmoneta_management_response_error(NULL, client_fd, server, MANAGEMENT_ERROR_BACKUP_NOFORK, NAME,
+               pgmoneta_management_response_error(NULL, client_fd, server, MANAGEMENT_ERROR_BACKUP_QUEUE, NAME,
                                                   compression, encryption, payload);
-               pgmoneta_log_error("Backup: No fork (%d)", MANAGEMENT_ERROR_BACKUP_NOFORK);
+               pgmoneta_log_error("Backup: Queue is full (%d)", MANAGEMENT_ERROR_BACKUP_QUEUE);
                goto error;
             }
-            else if (pid == 0)
-            {
-               struct json* pyl = NULL;
 
-               shutdown_ports(false);
+            /* The client waits in the queue */
+            client_fd = -1;
 
-               pgmoneta_json_clone(payload, &pyl);
-
-               pgmoneta_set_proc_title(1, ai->argv, "backup", config->common.servers[srv].name);
-               pgmoneta_backup(client_fd, srv, compression, encryption, pyl);
-            }
+            dispatch_backups();
          }
          else
          {
@@ -2465,9 +2484,20 @@ accept_management_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
 static void
 sigchld_cb(struct ev_loop* loop __attribute__((unused)), ev_signal* w __attribute__((unused)), int revents __attribute__((unused)))
 {
-   while (waitpid(-1, NULL, WNOHANG) > 0)
+   pid_t pid;
+   bool finished = false;
+
+   while ((pid = waitpid(-1, NULL, WNOHANG)) > 0)
    {
-      ;
+      if (pgmoneta_scheduler_finish(pid))
+      {
+         finished = true;
+      }
+   }
+
+   if (finished && keep_running)
+   {
+      dispatch_backups();
    }
 }
 
@@ -2639,6 +2669,67 @@ coredump_cb(struct ev_loop* loop, ev_signal* w, int revents)
    abort();
 }
 
+static void
+scheduler_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
+{
+   if (EV_ERROR & revents)
+   {
+      pgmoneta_log_trace("scheduler_cb: got invalid event: %s", strerror(errno));
+      errno = 0;
+      return;
+   }
+
+   if (keep_running)
+   {
+      dispatch_backups();
+   }
+}
+
+static void
+dispatch_backups(void)
+{
+   pid_t pid;
+   struct scheduler_job* job = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   while ((job = pgmoneta_scheduler_next()) != NULL)
+   {
+      pid = fork();
+      if (pid == -1)
+      {
+         pgmoneta_management_response_error(NULL, job->client_fd, config->common.servers[job->server].name,
+                                            MANAGEMENT_ERROR_BACKUP_NOFORK, NAME, job->compression, job->encryption,
+                                            job->payload);
+         pgmoneta_log_error("Backup: No fork (%d)", MANAGEMENT_ERROR_BACKUP_NOFORK);
+         pgmoneta_scheduler_remove(job);
+         return;
+      }
+      else if (pid == 0)
+      {
+         int server = job->server;
+         int client_fd = job->client_fd;
+         uint8_t compression = job->compression;
+         uint8_t encryption = job->encryption;
+         struct json* pyl = NULL;
+
+         shutdown_ports(false);
+
+         pgmoneta_json_clone(job->payload, &pyl);
+
+         /* Only keep the client of this backup */
+         job->client_fd = -1;
+         pgmoneta_scheduler_destroy();
+
+         pgmoneta_set_proc_title(1, argv_ptr, "backup", config->common.servers[server].name);
+         pgmoneta_backup(client_fd, server, compression, encryption, pyl);
+      }
+
+      pgmoneta_scheduler_start(job, pid);
+   }
+}
+
 static void
 retention_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
 {
@@ -2673,6 +2764,23 @@ verification_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __a
    }
 }
 
+static void
+wal_archive_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
+{
+   if (EV_ERROR & revents)
+   {
+      pgmoneta_log_trace("wal_archive_cb: got invalid event: %s", strerror(errno));
+      errno = 0;
+      return;
+   }
+
+   if (!fork())
+   {
+      shutdown_ports(false);
+      pgmoneta_wal_archive(argv_ptr);
+   }
+}
+
 static void
 valid_cb(struct ev_loop* loop __attribute__((unused)), ev_periodic* w __attribute__((unused)), int revents)
 {
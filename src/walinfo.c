@@ -44,6 +44,7 @@
 #include <walfile.h>
 #include <walfile/rmgr.h>
 #include <walfile/wal_reader.h>
+#include <workers.h>
 
 /* system */
 #include <err.h>
@@ -51,6 +52,7 @@
 #include <getopt.h>
 #include <inttypes.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <signal.h> // for signal handling
 #include <stdio.h>
 #include <stdlib.h>
@@ -75,12 +77,110 @@
 
 #define WAL_FILTER_MAX_TOKENS   32
 
-static int describe_walfile(char* path, enum value_type type, FILE* output, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects);
+/* Number of consecutive WAL segments decoded by one parallel task */
+#define WAL_SEGMENTS_PER_RUN 4
+
+/**
+ * A WAL segment handled by the segment pipeline
+ */
+struct wal_segment
+{
+   char* name;  /**< The segment file name, possibly with compression and encryption suffixes */
+   char* path;  /**< The segment path on disk, or NULL when held in memory */
+   void* data;  /**< The segment content, or NULL when read from the path */
+   size_t size; /**< The size of the segment content */
+};
+
+struct wal_pipeline;
+
+/**
+ * A run of consecutive WAL segments decoded by one task
+ */
+struct wal_run
+{
+   struct worker_common common;            /**< The common base */
+   struct wal_pipeline* pipeline;          /**< The pipeline */
+   int first;                              /**< The index of the first segment */
+   int count;                              /**< The number of segments */
+   bool done;                              /**< Has the task finished */
+   int result;                             /**< The result of the task */
+   char* output;                           /**< The rendered output */
+   size_t output_size;                     /**< The size of the rendered output */
+   uint32_t displayed;                     /**< The number of displayed records */
+   long first_record;                      /**< The output offset of the first displayed record, or -1 */
+   struct column_widths widths;            /**< The column widths of the run */
+   struct rmgr_stats stats[RM_MAX_ID + 1]; /**< The statistics of the run */
+};
+
+/**
+ * Decodes WAL segments on a set of workers and emits the results in segment order
+ */
+struct wal_pipeline
+{
+   enum value_type type;         /**< The output format */
+   FILE* out;                    /**< The output descriptor */
+   bool quiet;                   /**< Is the output suppressed */
+   bool color;                   /**< Are colors used */
+   struct deque* rms;            /**< The resource managers */
+   uint64_t start_lsn;           /**< The start LSN */
+   uint64_t end_lsn;             /**< The end LSN */
+   struct deque* xids;           /**< The XIDs */
+   uint32_t limit;               /**< The limit */
+   bool summary;                 /**< Collect statistics instead of records */
+   char** included_objects;      /**< The included objects */
+   struct column_widths* widths; /**< Shared column widths, or NULL for widths per segment */
+   bool widths_only;             /**< Only calculate the column widths */
+   bool stop_on_error;           /**< Stop at the first failed segment */
+   bool lead;                    /**< Is the first segment only decoded by parallel runs to stitch the records crossing out of it */
+   bool sequential;              /**< Are the runs decoded on the calling thread */
+   struct workers* workers;      /**< The workers */
+   int window;                   /**< The maximum number of runs in flight */
+   struct wal_segment* segments; /**< The segments in LSN order */
+   int number_of_segments;       /**< The number of segments */
+   struct wal_run* runs;         /**< The runs */
+   int number_of_runs;           /**< The number of runs */
+   int next_submit;              /**< The next run to submit */
+   int next_emit;                /**< The next run to emit */
+   int result;                   /**< The aggregated result */
+   pthread_mutex_t lock;         /**< The lock protecting the run states */
+   pthread_cond_t cond;          /**< Signalled when a run finishes */
+};
+
+/**
+ * The state of a TAR archive described while it is read
+ */
+struct wal_tar_stream
+{
+   struct wal_pipeline* template; /**< The pipeline settings */
+   int jobs;                      /**< The number of jobs */
+   struct wal_segment* segments;  /**< The lead segment followed by the batch */
+   int number_of_segments;        /**< The number of segments, including the lead slot */
+   int capacity;                  /**< The maximum number of segments in a batch */
+   char* spill;                   /**< The directory of the out-of-order members, or NULL */
+   struct deque* spilled;         /**< The names of the out-of-order members */
+   int result;                    /**< The aggregated result */
+};
+
+static int describe_walfile(char* path, enum value_type type, FILE* output, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects, int jobs);
 static int describe_walfile_internal(char* path, enum value_type type, FILE* out, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects, struct column_widths* provided_widths);
-static int describe_walfiles_in_directory(char* dir_path, enum value_type type, FILE* output, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects);
-static int describe_wal_tar_archive(char* path, enum value_type type, FILE* out, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects);
+static int describe_walfiles_in_directory(char* dir_path, enum value_type type, FILE* output, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects, int jobs);
+static int describe_wal_tar_archive(char* path, enum value_type type, FILE* out, bool quiet, bool color, struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids, uint32_t limit, bool summary, char** included_objects, int jobs);
 static int prepare_wal_files_from_tar_archive(char* path, char** temp_dir, struct deque** wal_files);
 static bool is_tar_archive_input(char* path);
+static int wal_pipeline_create(struct wal_pipeline* template, struct wal_segment* segments, int number_of_segments, int jobs, struct wal_pipeline** pipeline);
+static void wal_pipeline_destroy(struct wal_pipeline* pipeline);
+static int wal_pipeline_pump(struct wal_pipeline* pipeline);
+static void wal_pipeline_emit(struct wal_pipeline* pipeline, struct wal_run* run);
+static void describe_wal_run(struct worker_common* wc);
+static int read_wal_segment(struct wal_segment* segment, struct walfile** wf);
+static void render_walfile(struct wal_pipeline* pipeline, struct walfile* wf, FILE* out, struct column_widths* widths, struct rmgr_stats* stats, long* first_record);
+static int wal_tar_member_cb(char* name, void* data, size_t size, void* arg);
+static bool wal_tar_continues(struct wal_tar_stream* stream, char* name);
+static int wal_tar_add(struct wal_tar_stream* stream, char* name, char* path, void* data, size_t size);
+static int wal_tar_describe(struct wal_tar_stream* stream);
+static void wal_tar_release(struct wal_segment* segment);
+static int wal_segments_from_directory(char* dir_path, struct wal_segment** segments, int* number_of_segments);
+static void free_wal_segments(struct wal_segment* segments, int number_of_segments);
 
 /* Forward declarations */
 struct decoded_xlog_record;
@@ -5077,6 +5177,7 @@ usage(void)
    printf("  -e,  --end         Filter on an end LSN\n");
    printf("  -x,  --xid         Filter on an XID\n");
    printf("  -l,  --limit       Limit number of outputs\n");
+   printf("  -j,  --jobs        Number of threads decoding a directory or TAR archive\n");
    printf("  -v,  --verbose     Output result\n");
    printf("  -S,  --summary     Show detailed WAL statistics including counts, sizes, and percentages by resource manager\n");
    printf("  -V,  --version     Display version information\n");
@@ -5145,6 +5246,7 @@ main(int argc, char** argv)
    uint64_t end_lsn_low = 0;
    struct deque* xids = NULL;
    uint32_t limit = 0;
+   int jobs = 1;
    bool verbose = false;
    bool summary = false;
    enum value_type type = ValueString;
@@ -5193,6 +5295,7 @@ main(int argc, char** argv)
       {"e", "end", true},
       {"x", "xid", true},
       {"l", "limit", true},
+      {"j", "jobs", true},
       {"v", "verbose", false},
       {"S", "summary", false},
       {"V", "version", false},
@@ -5337,6 +5440,15 @@ main(int argc, char** argv)
       {
          limit = pgmoneta_atoi(optarg);
       }
+      else if (pgmoneta_compare_string(optname, "j") || pgmoneta_compare_string(optname, "jobs"))
+      {
+         jobs = pgmoneta_atoi(optarg);
+         if (jobs < 1)
+         {
+            fprintf(stderr, "Invalid number of jobs: %s\n", optarg);
+            exit(1);
+         }
+      }
       else if (pgmoneta_compare_string(optname, "m") || pgmoneta_compare_string(optname, "mapping"))
       {
          enable_mapping = true;
@@ -5875,6 +5987,7 @@ main(int argc, char** argv)
       partial_record->xlog_record_bytes_read = 0;
       partial_record->xlog_record = NULL;
       partial_record->data_buffer = NULL;
+      partial_record->lsn = 0;
 
       if (!pgmoneta_exists(filepath))
       {
@@ -5885,7 +5998,7 @@ main(int argc, char** argv)
       if (pgmoneta_is_directory(filepath))
       {
          if (describe_walfiles_in_directory(filepath, type, out, quiet, color,
-                                            rms, start_lsn, end_lsn, xids, limit, summary, included_objects))
+                                            rms, start_lsn, end_lsn, xids, limit, summary, included_objects, jobs))
          {
             fprintf(stderr, "Error while reading/describing WAL directory\n");
             goto error;
@@ -5904,23 +6017,14 @@ main(int argc, char** argv)
          }
 
          if (describe_walfile(filepath, type, out, quiet, color,
-                              rms, start_lsn, end_lsn, xids, limit, summary, included_objects))
+                              rms, start_lsn, end_lsn, xids, limit, summary, included_objects, jobs))
          {
             fprintf(stderr, "Error while reading/describing WAL file\n");
             goto error;
          }
       }
 
-      if (partial_record->xlog_record != NULL)
-      {
-         free(partial_record->xlog_record);
-      }
-      if (partial_record->data_buffer != NULL)
-      {
-         free(partial_record->data_buffer);
-      }
-      free(partial_record);
-      partial_record = NULL;
+      pgmoneta_reset_partial_record();
    }
    else if (!interactive)
    {
@@ -5943,6 +6047,7 @@ main(int argc, char** argv)
       free(included_objects);
    }
 
+   pgmoneta_wal_reset_server();
    pgmoneta_destroy_shared_memory(shmem, size);
 
    if (logfile)
@@ -6042,14 +6147,14 @@ error:
 static int
 describe_walfile(char* path, enum value_type type, FILE* out, bool quiet, bool color,
                  struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids,
-                 uint32_t limit, bool summary, char** included_objects)
+                 uint32_t limit, bool summary, char** included_objects, int jobs)
 {
    /* Check if this is a TAR archive */
    if (is_tar_archive_input(path))
    {
       return describe_wal_tar_archive(path, type, out, quiet, color, rms,
                                       start_lsn, end_lsn, xids, limit,
-                                      summary, included_objects);
+                                      summary, included_objects, jobs);
    }
 
    return describe_walfile_internal(path, type, out, quiet, color, rms, start_lsn, end_lsn,
@@ -6189,113 +6294,113 @@ cleanup:
 static int
 describe_walfiles_in_directory(char* dir_path, enum value_type type, FILE* output, bool quiet, bool color,
                                struct deque* rms, uint64_t start_lsn, uint64_t end_lsn, struct deque* xids,
-                               uint32_t limit, bool summary, char** included_objects)
+                               uint32_t limit, bool summary, char** included_objects, int jobs)
 {
-   struct deque* files = NULL;
-   struct deque_iterator* file_iterator = NULL;
-   char* file_path = malloc(MAX_PATH);
+   struct wal_segment* segments = NULL;
+   struct wal_pipeline template = {0};
+   struct wal_pipeline* pipeline = NULL;
    struct column_widths widths = {0};
-   struct walfile* wf = NULL;
-   char* from = NULL;
-   char* to = NULL;
+   int number_of_segments = 0;
+   int ret = 1;
 
-   if (pgmoneta_get_wal_files(dir_path, &files))
+   if (wal_segments_from_directory(dir_path, &segments, &number_of_segments))
    {
-      free(file_path);
       return 1;
    }
 
+   template.type = type;
+   template.out = output;
+   template.quiet = quiet;
+   template.color = color;
+   template.rms = rms;
+   template.start_lsn = start_lsn;
+   template.end_lsn = end_lsn;
+   template.xids = xids;
+   template.limit = limit;
+   template.summary = summary;
+   template.included_objects = included_objects;
+
+   /* The text format aligns the columns across all files, so calculate the widths first */
    if (type == ValueString && !summary)
    {
-      pgmoneta_deque_iterator_create(files, &file_iterator);
-      while (pgmoneta_deque_iterator_next(file_iterator))
+      template.widths = &widths;
+      template.widths_only = true;
+      template.stop_on_error = false;
+
+      if (wal_pipeline_create(&template, segments, number_of_segments, jobs, &pipeline))
       {
-         pgmoneta_snprintf(file_path, MAX_PATH, "%s/%s", dir_path, (char*)file_iterator->value->data);
+         goto error;
+      }
+      wal_pipeline_pump(pipeline);
+      wal_pipeline_destroy(pipeline);
+      pipeline = NULL;
 
-         if (!pgmoneta_is_file(file_path))
-         {
-            continue;
-         }
+      /* Do not carry a record split at the end of the last file into the first one */
+      pgmoneta_reset_partial_record();
 
-         char secure_temp_dir[MAX_PATH];
-         pgmoneta_snprintf(secure_temp_dir, sizeof(secure_temp_dir), "%s/pgmoneta-walinfo-XXXXXX", pgmoneta_get_tmpdir());
-         if (mkdtemp(secure_temp_dir) == NULL)
-         {
-            free(from);
-            from = NULL;
-            continue;
-         }
+      template.widths_only = false;
+   }
 
-         from = pgmoneta_append(from, file_path);
-         if (from == NULL)
-         {
-            pgmoneta_delete_directory(secure_temp_dir);
-            continue;
-         }
+   template.stop_on_error = true;
 
-         to = pgmoneta_format_and_append(to, "%s/%s", secure_temp_dir, basename(file_path));
+   if (wal_pipeline_create(&template, segments, number_of_segments, jobs, &pipeline))
+   {
+      goto error;
+   }
 
-         if (pgmoneta_extract_file(from, PGMONETA_FILE_TYPE_UNKNOWN, true, NULL, &to))
-         {
-            pgmoneta_delete_directory(secure_temp_dir);
-            free(from);
-            free(to);
-            from = NULL;
-            to = NULL;
-            continue;
-         }
+   if (wal_pipeline_pump(pipeline))
+   {
+      goto error;
+   }
 
-         if (pgmoneta_read_walfile(-1, to, &wf) == 0)
-         {
-            pgmoneta_calculate_column_widths(wf, start_lsn, end_lsn, rms, xids, included_objects, &widths);
-            pgmoneta_destroy_walfile(wf);
-            wf = NULL;
-         }
+   ret = 0;
 
-         if (to != NULL)
-         {
-            free(to);
-            to = NULL;
-         }
-         pgmoneta_delete_directory(secure_temp_dir);
-         free(from);
-         from = NULL;
-      }
-      pgmoneta_deque_iterator_destroy(file_iterator);
-      file_iterator = NULL;
+error:
+   wal_pipeline_destroy(pipeline);
+   free_wal_segments(segments, number_of_segments);
+
+   return ret;
+}
+
+static int
+wal_segments_from_directory(char* dir_path, struct wal_segment** segments, int* number_of_segments)
+{
+   struct deque* files = NULL;
+   struct deque_iterator* file_iterator = NULL;
+   struct wal_segment* s = NULL;
+   int n = 0;
+
+   *segments = NULL;
+   *number_of_segments = 0;
+
+   if (pgmoneta_get_wal_files(dir_path, &files))
+   {
+      return 1;
+   }
+
+   s = calloc(MAX(pgmoneta_deque_size(files), (uint32_t)1), sizeof(struct wal_segment));
+   if (s == NULL)
+   {
+      pgmoneta_deque_destroy(files);
+      return 1;
    }
 
    pgmoneta_deque_iterator_create(files, &file_iterator);
    while (pgmoneta_deque_iterator_next(file_iterator))
    {
-      pgmoneta_snprintf(file_path, MAX_PATH, "%s/%s", dir_path, (char*)file_iterator->value->data);
+      char* name = (char*)file_iterator->value->data;
 
-      struct column_widths* widths_to_use = (type == ValueString && !summary) ? &widths : NULL;
-      if (describe_walfile_internal(file_path, type, output, quiet, color,
-                                    rms, start_lsn, end_lsn, xids, limit, summary, included_objects, widths_to_use))
-      {
-         goto error;
-      }
+      s[n].name = pgmoneta_append(NULL, name);
+      s[n].path = pgmoneta_format_and_append(NULL, "%s/%s", dir_path, name);
+      n++;
    }
    pgmoneta_deque_iterator_destroy(file_iterator);
-   file_iterator = NULL;
-
    pgmoneta_deque_destroy(files);
-   free(file_path);
-   return 0;
 
-error:
-   pgmoneta_deque_destroy(files);
-   pgmoneta_deque_iterator_destroy(file_iterator);
+   *segments = s;
+   *number_of_segments = n;
 
-   free(file_path);
-   free(from);
-   if (to != NULL)
-   {
-      free(to);
-   }
-   pgmoneta_destroy_walfile(wf);
-   return 1;
+   return 0;
 }
 
 static int
@@ -6405,56 +6510,771 @@ static int
 describe_wal_tar_archive(char* path, enum value_type type, FILE* out, bool quiet, bool color,
                          struct deque* rms, uint64_t start_lsn, uint64_t end_lsn,
                          struct deque* xids, uint32_t limit, bool summary,
-                         char** included_objects)
+                         char** included_objects, int jobs)
 {
-   char* temp_dir = NULL;
-   struct deque* wal_files = NULL;
-   struct deque_iterator* iter = NULL;
-   int result = 0;
+   struct wal_tar_stream stream = {0};
+   struct wal_segment* segments = NULL;
+   struct wal_pipeline template = {0};
+   struct wal_pipeline* pipeline = NULL;
+   int number_of_segments = 0;
+
+   template.type = type;
+   template.out = out;
+   template.quiet = quiet;
+   template.color = color;
+   template.rms = rms;
+   template.start_lsn = start_lsn;
+   template.end_lsn = end_lsn;
+   template.xids = xids;
+   template.limit = limit;
+   template.summary = summary;
+   template.included_objects = included_objects;
+   template.widths = NULL;
+   template.widths_only = false;
+   template.stop_on_error = false;
+
+   /* The limit needs a single decoder, so only batch the members for parallel runs */
+   stream.template = &template;
+   stream.jobs = jobs;
+   stream.capacity = jobs <= 1 || limit > 0 ? 1 : jobs * WAL_SEGMENTS_PER_RUN;
+   stream.segments = calloc(stream.capacity + 1, sizeof(struct wal_segment));
+   stream.number_of_segments = 1;
+
+   if (stream.segments == NULL || pgmoneta_deque_create(false, &stream.spilled))
+   {
+      goto error;
+   }
 
-   if (prepare_wal_files_from_tar_archive(path, &temp_dir, &wal_files))
+   /* The members are described while the archive is read as long as they continue
+      the WAL stream. Members arriving out of order are spilled to a temporary
+      directory until their predecessor has been described */
+   if (pgmoneta_extract_archive_stream(path, PGMONETA_FILE_TYPE_UNKNOWN, wal_tar_member_cb, &stream))
    {
+      pgmoneta_log_error("Failed to read TAR archive: %s", path);
       goto error;
    }
 
-   if (wal_files != NULL)
+   if (wal_tar_describe(&stream))
+   {
+      goto error;
+   }
+   wal_tar_release(&stream.segments[0]);
+
+   /* The members that never continued the stream are described in LSN order */
+   if (stream.spill != NULL && pgmoneta_deque_size(stream.spilled) > 0)
+   {
+      pgmoneta_reset_partial_record();
+
+      if (wal_segments_from_directory(stream.spill, &segments, &number_of_segments))
+      {
+         goto error;
+      }
+
+      if (wal_pipeline_create(&template, segments, number_of_segments, jobs, &pipeline))
+      {
+         goto error;
+      }
+
+      if (wal_pipeline_pump(pipeline))
+      {
+         stream.result = 1;
+      }
+   }
+
+   wal_pipeline_destroy(pipeline);
+   free_wal_segments(segments, number_of_segments);
+   free(stream.segments);
+   pgmoneta_deque_destroy(stream.spilled);
+   if (stream.spill != NULL)
    {
-      pgmoneta_deque_iterator_create(wal_files, &iter);
-      while (pgmoneta_deque_iterator_next(iter))
+      pgmoneta_delete_directory(stream.spill);
+      free(stream.spill);
+   }
+
+   return stream.result;
+
+error:
+   wal_pipeline_destroy(pipeline);
+   free_wal_segments(segments, number_of_segments);
+   if (stream.segments != NULL)
+   {
+      for (int i = 0; i < stream.number_of_segments; i++)
       {
-         char* wal_path = (char*)iter->value->data;
-         if (describe_walfile_internal(wal_path, type, out, quiet, color, rms,
-                                       start_lsn, end_lsn, xids, limit, summary,
-                                       included_objects, NULL))
+         wal_tar_release(&stream.segments[i]);
+      }
+      free(stream.segments);
+   }
+   pgmoneta_deque_destroy(stream.spilled);
+   if (stream.spill != NULL)
+   {
+      pgmoneta_delete_directory(stream.spill);
+      free(stream.spill);
+   }
+
+   return 1;
+}
+
+static int
+wal_tar_member_cb(char* name, void* data, size_t size, void* arg)
+{
+   struct wal_tar_stream* stream = (struct wal_tar_stream*)arg;
+   struct deque_iterator* iter = NULL;
+   char* base = NULL;
+   char* target = NULL;
+   char* spilled = NULL;
+   FILE* file = NULL;
+   bool found = false;
+
+   if (!(pgmoneta_extraction_get_file_type(name) & PGMONETA_FILE_TYPE_WAL))
+   {
+      free(data);
+      return 0;
+   }
+
+   base = strrchr(name, '/') != NULL ? strrchr(name, '/') + 1 : name;
+
+   if (!wal_tar_continues(stream, base))
+   {
+      if (stream->spill == NULL)
+      {
+         stream->spill = pgmoneta_format_and_append(NULL, "%s/pgmoneta_wal_XXXXXX", pgmoneta_get_tmpdir());
+         if (stream->spill == NULL || mkdtemp(stream->spill) == NULL)
          {
-            result = 1;
+            pgmoneta_log_error("Failed to create temp directory for WAL file %s", name);
+            free(stream->spill);
+            stream->spill = NULL;
+            goto error;
          }
       }
-      pgmoneta_deque_iterator_destroy(iter);
+
+      target = pgmoneta_format_and_append(target, "%s/%s", stream->spill, base);
+      if (target == NULL || pgmoneta_fopen_secure(target, "wb", &file) || fwrite(data, 1, size, file) != size)
+      {
+         pgmoneta_log_error("Failed to spill WAL file %s", name);
+         goto error;
+      }
+
+      fclose(file);
+      free(target);
+      free(data);
+
+      return pgmoneta_deque_add(stream->spilled, NULL, (uintptr_t)base, ValueString);
    }
 
-   pgmoneta_deque_destroy(wal_files);
-   pgmoneta_delete_directory(temp_dir);
-   free(temp_dir);
+   if (wal_tar_add(stream, base, NULL, data, size))
+   {
+      return 1;
+   }
 
-   return result;
+   /* The member may be the predecessor of spilled members */
+   do
+   {
+      found = false;
+
+      pgmoneta_deque_iterator_create(stream->spilled, &iter);
+      while (!found && pgmoneta_deque_iterator_next(iter))
+      {
+         if (wal_tar_continues(stream, (char*)iter->value->data))
+         {
+            spilled = pgmoneta_append(NULL, (char*)iter->value->data);
+            pgmoneta_deque_iterator_remove(iter);
+            found = true;
+         }
+      }
+      pgmoneta_deque_iterator_destroy(iter);
+      iter = NULL;
+
+      if (found)
+      {
+         target = pgmoneta_format_and_append(NULL, "%s/%s", stream->spill, spilled);
+         if (target == NULL || wal_tar_add(stream, spilled, target, NULL, 0))
+         {
+            free(target);
+            free(spilled);
+            return 1;
+         }
+         free(target);
+         free(spilled);
+         target = NULL;
+         spilled = NULL;
+      }
+   }
+   while (found);
+
+   return 0;
 
 error:
-   if (iter != NULL)
+   if (file != NULL)
    {
-      pgmoneta_deque_iterator_destroy(iter);
+      fclose(file);
    }
+   free(target);
+   free(data);
 
-   if (wal_files != NULL)
+   return 1;
+}
+
+static bool
+wal_tar_continues(struct wal_tar_stream* stream, char* name)
+{
+   char* previous = NULL;
+   unsigned int tli = 0;
+   unsigned int log = 0;
+   unsigned int seg = 0;
+   unsigned int previous_tli = 0;
+   unsigned int previous_log = 0;
+   unsigned int previous_seg = 0;
+
+   if (stream->number_of_segments > 1)
    {
-      pgmoneta_deque_destroy(wal_files);
+      previous = stream->segments[stream->number_of_segments - 1].name;
+   }
+   else
+   {
+      previous = stream->segments[0].name;
+   }
+
+   /* The first member starts the stream */
+   if (previous == NULL)
+   {
+      return true;
+   }
+
+   if (sscanf(name, "%8X%8X%8X", &tli, &log, &seg) != 3 ||
+       sscanf(previous, "%8X%8X%8X", &previous_tli, &previous_log, &previous_seg) != 3)
+   {
+      return false;
+   }
+
+   if (tli != previous_tli)
+   {
+      return false;
+   }
+
+   return (log == previous_log && seg == previous_seg + 1) || (log == previous_log + 1 && seg == 0);
+}
+
+static int
+wal_tar_add(struct wal_tar_stream* stream, char* name, char* path, void* data, size_t size)
+{
+   struct wal_segment* segment = &stream->segments[stream->number_of_segments];
+
+   segment->name = pgmoneta_append(NULL, name);
+   segment->path = path != NULL ? pgmoneta_append(NULL, path) : NULL;
+   segment->data = data;
+   segment->size = size;
+   stream->number_of_segments++;
+
+   if (segment->name == NULL || (path != NULL && segment->path == NULL))
+   {
+      return 1;
+   }
+
+   if (stream->number_of_segments > stream->capacity)
+   {
+      return wal_tar_describe(stream);
+   }
+
+   return 0;
+}
+
+static int
+wal_tar_describe(struct wal_tar_stream* stream)
+{
+   struct wal_pipeline* pipeline = NULL;
+   struct wal_segment* segments = stream->segments;
+   int number_of_segments = stream->number_of_segments;
+   int last = stream->number_of_segments - 1;
+
+   if (number_of_segments <= 1)
+   {
+      return 0;
+   }
+
+   /* A sequential pipeline continues from the decoder state of the previous batch,
+      while parallel runs decode the lead again. The lead slot is empty until the
+      first batch has been described */
+   stream->template->lead = segments[0].name != NULL && stream->capacity > 1;
+   if (!stream->template->lead)
+   {
+      segments++;
+      number_of_segments--;
+   }
+
+   if (wal_pipeline_create(stream->template, segments, number_of_segments, stream->jobs, &pipeline))
+   {
+      return 1;
+   }
+
+   if (wal_pipeline_pump(pipeline))
+   {
+      stream->result = 1;
+   }
+
+   wal_pipeline_destroy(pipeline);
+   stream->template->lead = false;
+
+   /* Keep the last segment as the lead of the next batch */
+   wal_tar_release(&stream->segments[0]);
+   for (int i = 1; i < last; i++)
+   {
+      wal_tar_release(&stream->segments[i]);
+   }
+   stream->segments[0] = stream->segments[last];
+   memset(&stream->segments[last], 0, sizeof(struct wal_segment));
+   stream->number_of_segments = 1;
+
+   return 0;
+}
+
+static void
+wal_tar_release(struct wal_segment* segment)
+{
+   /* A segment without content was spilled, and is not needed anymore */
+   if (segment->data == NULL && segment->path != NULL)
+   {
+      remove(segment->path);
+   }
+
+   free(segment->name);
+   free(segment->path);
+   free(segment->data);
+   memset(segment, 0, sizeof(struct wal_segment));
+}
+
+static int
+wal_pipeline_create(struct wal_pipeline* template, struct wal_segment* segments, int number_of_segments, int jobs, struct wal_pipeline** pipeline)
+{
+   struct wal_pipeline* p = NULL;
+   int offset = 0;
+   int per_run = 1;
+
+   *pipeline = NULL;
+
+   p = malloc(sizeof(struct wal_pipeline));
+   if (p == NULL)
+   {
+      goto error;
    }
 
-   if (temp_dir != NULL)
+   memcpy(p, template, sizeof(struct wal_pipeline));
+
+   /* The limit counts records in output order, which needs a single decoder */
+   p->sequential = jobs <= 1 || p->limit > 0;
+   p->workers = NULL;
+   p->segments = segments;
+   p->number_of_segments = number_of_segments;
+   p->runs = NULL;
+   p->number_of_runs = 0;
+   p->next_submit = 0;
+   p->next_emit = 0;
+   p->result = 0;
+   p->window = p->sequential ? 1 : jobs * 2;
+   offset = p->lead ? 1 : 0;
+
+   pthread_mutex_init(&p->lock, NULL);
+   pthread_cond_init(&p->cond, NULL);
+
+   if (!p->sequential)
    {
-      pgmoneta_delete_directory(temp_dir);
-      free(temp_dir);
+      /* Each run decodes its predecessor segment again to stitch the records
+         crossing into it, so keep the runs long enough to amortize that */
+      per_run = MAX(1, MIN(WAL_SEGMENTS_PER_RUN, (number_of_segments - offset) / (jobs * 2)));
+
+      if (pgmoneta_workers_initialize(jobs, &p->workers))
+      {
+         pgmoneta_log_error("Failed to initialize %d workers", jobs);
+         goto error;
+      }
    }
 
+   p->number_of_runs = (number_of_segments - offset + per_run - 1) / per_run;
+   p->runs = calloc(MAX(p->number_of_runs, 1), sizeof(struct wal_run));
+   if (p->runs == NULL)
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < p->number_of_runs; i++)
+   {
+      p->runs[i].pipeline = p;
+      p->runs[i].first = offset + i * per_run;
+      p->runs[i].count = MIN(per_run, number_of_segments - p->runs[i].first);
+   }
+
+   *pipeline = p;
+
+   return 0;
+
+error:
+   wal_pipeline_destroy(p);
    return 1;
 }
+
+static void
+wal_pipeline_destroy(struct wal_pipeline* pipeline)
+{
+   if (pipeline == NULL)
+   {
+      return;
+   }
+
+   if (pipeline->workers != NULL)
+   {
+      pgmoneta_workers_wait(pipeline->workers);
+      pgmoneta_workers_destroy(pipeline->workers);
+   }
+
+   if (pipeline->runs != NULL)
+   {
+      for (int i = 0; i < pipeline->number_of_runs; i++)
+      {
+         free(pipeline->runs[i].output);
+      }
+      free(pipeline->runs);
+   }
+
+   pthread_cond_destroy(&pipeline->cond);
+   pthread_mutex_destroy(&pipeline->lock);
+
+   free(pipeline);
+}
+
+static int
+wal_pipeline_pump(struct wal_pipeline* pipeline)
+{
+   struct wal_run* run = NULL;
+
+   while (pipeline->next_emit < pipeline->number_of_runs)
+   {
+      /* Keep the window of runs in flight full */
+      while (pipeline->next_submit < pipeline->number_of_runs &&
+             pipeline->next_submit - pipeline->next_emit < pipeline->window)
+      {
+         run = &pipeline->runs[pipeline->next_submit];
+         pipeline->next_submit++;
+
+         if (pipeline->workers != NULL)
+         {
+            pgmoneta_workers_add(pipeline->workers, describe_wal_run, (struct worker_common*)run);
+         }
+         else
+         {
+            describe_wal_run((struct worker_common*)run);
+         }
+      }
+
+      /* Emit the runs in order, waiting for the oldest one */
+      run = &pipeline->runs[pipeline->next_emit];
+
+      pthread_mutex_lock(&pipeline->lock);
+      while (!run->done)
+      {
+         pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+      }
+      pthread_mutex_unlock(&pipeline->lock);
+
+      wal_pipeline_emit(pipeline, run);
+      pipeline->next_emit++;
+
+      if (pipeline->stop_on_error && pipeline->result)
+      {
+         return 1;
+      }
+   }
+
+   return pipeline->result;
+}
+
+static void
+wal_pipeline_emit(struct wal_pipeline* pipeline, struct wal_run* run)
+{
+   char* output = run->output;
+   size_t output_size = run->output_size;
+   uint32_t count = 0;
+
+   if (pipeline->widths_only)
+   {
+      pipeline->widths->rm_width = MAX(pipeline->widths->rm_width, run->widths.rm_width);
+      pipeline->widths->lsn_width = MAX(pipeline->widths->lsn_width, run->widths.lsn_width);
+      pipeline->widths->rec_width = MAX(pipeline->widths->rec_width, run->widths.rec_width);
+      pipeline->widths->tot_width = MAX(pipeline->widths->tot_width, run->widths.tot_width);
+      pipeline->widths->xid_width = MAX(pipeline->widths->xid_width, run->widths.xid_width);
+      pipeline->widths->ts_width = MAX(pipeline->widths->ts_width, run->widths.ts_width);
+   }
+   else if (output != NULL)
+   {
+      if (!pipeline->sequential && pipeline->type == ValueJSON && run->displayed > 0)
+      {
+         /* Separate the first record of the run from the records emitted before it */
+         count = pgmoneta_wal_get_display_count();
+         if (count > 0 && !pipeline->quiet && run->first_record >= 0 && (size_t)run->first_record <= output_size)
+         {
+            fwrite(output, 1, run->first_record, pipeline->out);
+            fwrite(",\n", 1, 2, pipeline->out);
+            output_size -= run->first_record;
+            output += run->first_record;
+         }
+         pgmoneta_wal_set_display_count(count + run->displayed);
+      }
+
+      fwrite(output, 1, output_size, pipeline->out);
+   }
+
+   if (pipeline->summary)
+   {
+      pgmoneta_wal_merge_stats(run->stats);
+   }
+
+   if (run->result)
+   {
+      pipeline->result = 1;
+   }
+
+   free(run->output);
+   run->output = NULL;
+   run->output_size = 0;
+}
+
+static void
+describe_wal_run(struct worker_common* wc)
+{
+   struct wal_run* run = (struct wal_run*)wc;
+   struct wal_pipeline* pipeline = run->pipeline;
+   struct walfile* wf = NULL;
+   FILE* out = NULL;
+   uint32_t count = 0;
+
+   if (!pipeline->sequential)
+   {
+      pgmoneta_reset_partial_record();
+
+      /* Decode the preceding segment silently, so that a record crossing
+         into this run is stitched exactly as in a sequential pass */
+      if (run->first > 0 && read_wal_segment(&pipeline->segments[run->first - 1], &wf) == 0)
+      {
+         pgmoneta_destroy_walfile(wf);
+         wf = NULL;
+      }
+
+      /* The first record of the run is written without a separator, which is added on emit */
+      pgmoneta_wal_set_display_count(0);
+   }
+   count = pgmoneta_wal_get_display_count();
+   run->first_record = -1;
+
+   if (!pipeline->widths_only)
+   {
+      out = open_memstream(&run->output, &run->output_size);
+      if (out == NULL)
+      {
+         pgmoneta_log_error("Failed to create the output buffer");
+         run->result = 1;
+         goto done;
+      }
+   }
+
+   for (int i = run->first; i < run->first + run->count; i++)
+   {
+      if (read_wal_segment(&pipeline->segments[i], &wf))
+      {
+         pgmoneta_log_error("Failed to read WAL file at %s", pipeline->segments[i].name);
+         run->result = 1;
+
+         if (pipeline->stop_on_error)
+         {
+            break;
+         }
+         continue;
+      }
+
+      render_walfile(pipeline, wf, out, &run->widths, run->stats, &run->first_record);
+
+      pgmoneta_destroy_walfile(wf);
+      wf = NULL;
+   }
+
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+
+   run->displayed = pgmoneta_wal_get_display_count() - count;
+
+   if (!pipeline->sequential)
+   {
+      pgmoneta_reset_partial_record();
+      pgmoneta_wal_reset_server();
+   }
+
+done:
+   pthread_mutex_lock(&pipeline->lock);
+   run->done = true;
+   pthread_cond_broadcast(&pipeline->cond);
+   pthread_mutex_unlock(&pipeline->lock);
+}
+
+static int
+read_wal_segment(struct wal_segment* segment, struct walfile** wf)
+{
+   void* raw = NULL;
+   size_t raw_size = 0;
+   void* data = NULL;
+   size_t data_size = 0;
+   char* name = NULL;
+   char* wal_name = NULL;
+   uint32_t file_type = 0;
+   FILE* file = NULL;
+   struct stat st;
+   int ret = 1;
+
+   *wf = NULL;
+
+   if (segment->data != NULL)
+   {
+      raw = segment->data;
+      raw_size = segment->size;
+   }
+   else
+   {
+      file = fopen(segment->path, "rb");
+      if (file == NULL || fstat(fileno(file), &st))
+      {
+         pgmoneta_log_error("WAL file at %s does not exist", segment->path);
+         goto cleanup;
+      }
+
+      raw_size = (size_t)st.st_size;
+      raw = malloc(MAX(raw_size, (size_t)1));
+      if (raw == NULL || fread(raw, 1, raw_size, file) != raw_size)
+      {
+         pgmoneta_log_error("Failed to read WAL file at %s", segment->path);
+         goto cleanup;
+      }
+   }
+
+   name = strrchr(segment->name, '/') != NULL ? strrchr(segment->name, '/') + 1 : segment->name;
+   file_type = pgmoneta_extraction_get_file_type(name) & (PGMONETA_FILE_TYPE_ENCRYPTED | PGMONETA_FILE_TYPE_COMPRESSION_MASK);
+
+   if (file_type != 0)
+   {
+      if (pgmoneta_extract_buffer(name, PGMONETA_FILE_TYPE_UNKNOWN, raw, raw_size, &data, &data_size))
+      {
+         pgmoneta_log_error("Failed to extract WAL file %s", segment->name);
+         goto cleanup;
+      }
+
+      if (pgmoneta_extraction_strip_suffix(name, file_type, &wal_name))
+      {
+         goto cleanup;
+      }
+   }
+   else
+   {
+      data = raw;
+      data_size = raw_size;
+      wal_name = pgmoneta_append(NULL, name);
+   }
+
+   if (pgmoneta_read_walfile_buffer(-1, wal_name, data, data_size, wf))
+   {
+      goto cleanup;
+   }
+
+   ret = 0;
+
+cleanup:
+   if (data != raw)
+   {
+      free(data);
+   }
+   if (raw != segment->data)
+   {
+      free(raw);
+   }
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(wal_name);
+
+   return ret;
+}
+
+static void
+render_walfile(struct wal_pipeline* pipeline, struct walfile* wf, FILE* out, struct column_widths* widths, struct rmgr_stats* stats, long* first_record)
+{
+   struct deque_iterator* record_iterator = NULL;
+   struct decoded_xlog_record* record = NULL;
+   struct column_widths local_widths = {0};
+   struct column_widths* w = pipeline->widths != NULL ? pipeline->widths : &local_widths;
+
+   if (pipeline->widths_only)
+   {
+      pgmoneta_calculate_column_widths(wf, pipeline->start_lsn, pipeline->end_lsn, pipeline->rms,
+                                       pipeline->xids, pipeline->included_objects, widths);
+      return;
+   }
+
+   if (pipeline->type == ValueString && !pipeline->summary && pipeline->widths == NULL)
+   {
+      pgmoneta_calculate_column_widths(wf, pipeline->start_lsn, pipeline->end_lsn, pipeline->rms,
+                                       pipeline->xids, pipeline->included_objects, &local_widths);
+   }
+
+   if (pgmoneta_deque_iterator_create(wf->records, &record_iterator))
+   {
+      pgmoneta_log_error("Failed to create deque iterator");
+      return;
+   }
+
+   if (pipeline->type == ValueJSON && !pipeline->quiet && !pipeline->summary)
+   {
+      fprintf(out, "{ \"WAL\": [\n");
+   }
+
+   while (pgmoneta_deque_iterator_next(record_iterator))
+   {
+      record = (struct decoded_xlog_record*)record_iterator->value->data;
+      if (pipeline->summary)
+      {
+         pgmoneta_wal_record_collect_stats_into(record, pipeline->start_lsn, pipeline->end_lsn, stats);
+      }
+      else
+      {
+         /* Until a record is displayed, the next one lands at the current offset */
+         if (pgmoneta_wal_get_display_count() == 0)
+         {
+            *first_record = ftell(out);
+         }
+
+         pgmoneta_wal_record_display(record, wf->long_phd->std.xlp_magic, pipeline->type, out, pipeline->quiet,
+                                     pipeline->color, pipeline->rms, pipeline->start_lsn, pipeline->end_lsn,
+                                     pipeline->xids, pipeline->limit, pipeline->included_objects, w, wf->xid_ts_map);
+      }
+   }
+
+   if (pipeline->type == ValueJSON && !pipeline->quiet && !pipeline->summary)
+   {
+      fprintf(out, "\n]}");
+   }
+
+   pgmoneta_deque_iterator_destroy(record_iterator);
+}
+
+static void
+free_wal_segments(struct wal_segment* segments, int number_of_segments)
+{
+   if (segments == NULL)
+   {
+      return;
+   }
+
+   for (int i = 0; i < number_of_segments; i++)
+   {
+      free(segments[i].name);
+      free(segments[i].path);
+      free(segments[i].data);
+   }
+   free(segments);
+}
@@ -361,6 +361,74 @@ cleanup:
    MCTF_FINISH();
 }
 
+/**
+ * Test: A streamed response is sent as frames and read back as one document.
+ */
+MCTF_TEST(test_management_response_ok_stream)
+{
+   struct test_encryption_env env;
+   int sockets[2] = {-1, -1};
+   struct json* payload = NULL;
+   struct json* response = NULL;
+   struct json* backups = NULL;
+   struct json* backup = NULL;
+   struct json* json = NULL;
+   struct timespec t = {0};
+   uint8_t compression = MANAGEMENT_COMPRESSION_NONE;
+   char label[MISC_LENGTH];
+
+   MCTF_ASSERT(pgmoneta_test_setup_encryption_env(&env) == 0, cleanup, "Failed to setup mock environment");
+   MCTF_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0, cleanup, "socketpair should succeed");
+
+   MCTF_ASSERT(pgmoneta_management_create_header(MANAGEMENT_LIST_BACKUP, MANAGEMENT_COMPRESSION_GZIP, MANAGEMENT_ENCRYPTION_AES256_GCM,
+                                                 MANAGEMENT_OUTPUT_FORMAT_TEXT, &payload) == 0,
+               cleanup, "header should be created");
+   MCTF_ASSERT(pgmoneta_json_create(&response) == 0, cleanup, "response should be created");
+   pgmoneta_json_put(payload, MANAGEMENT_CATEGORY_RESPONSE, (uintptr_t)response, ValueJSON);
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)"primary", ValueString);
+
+   MCTF_ASSERT(pgmoneta_json_create(&backups) == 0, cleanup, "backups should be created");
+   for (int i = 0; i < 2000; i++)
+   {
+      MCTF_ASSERT(pgmoneta_json_create(&backup) == 0, cleanup, "backup should be created");
+      pgmoneta_snprintf(label, sizeof(label), "20260101%06d", i);
+      pgmoneta_json_put(backup, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)label, ValueString);
+      pgmoneta_json_put(backup, MANAGEMENT_ARGUMENT_BACKUP_SIZE, (uintptr_t)(i * 8192), ValueUInt64);
+      pgmoneta_json_append(backups, (uintptr_t)backup, ValueJSON);
+      backup = NULL;
+   }
+   pgmoneta_json_put(response, MANAGEMENT_ARGUMENT_BACKUPS, (uintptr_t)backups, ValueJSON);
+
+   MCTF_ASSERT(pgmoneta_management_response_ok(NULL, sockets[0], t, t, MANAGEMENT_COMPRESSION_GZIP, MANAGEMENT_ENCRYPTION_AES256_GCM, payload) == 0,
+               cleanup, "streamed response should be written");
+   MCTF_ASSERT(pgmoneta_management_read_json(NULL, sockets[1], &compression, NULL, &json) == 0, cleanup,
+               "streamed response should be read");
+   MCTF_ASSERT(compression == MANAGEMENT_COMPRESSION_GZIP, cleanup, "compression should not carry the stream flag");
+
+   response = (struct json*)pgmoneta_json_get(json, MANAGEMENT_CATEGORY_RESPONSE);
+   MCTF_ASSERT_STR_EQ((char*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_SERVER), "primary", cleanup, "server mismatch");
+
+   backups = (struct json*)pgmoneta_json_get(response, MANAGEMENT_ARGUMENT_BACKUPS);
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_json_array_length(backups), 2000, cleanup, "backup count mismatch");
+   MCTF_ASSERT((bool)pgmoneta_json_get((struct json*)pgmoneta_json_get(json, MANAGEMENT_CATEGORY_OUTCOME), MANAGEMENT_ARGUMENT_STATUS),
+               cleanup, "outcome should be successful");
+
+cleanup:
+   if (sockets[0] != -1)
+   {
+      close(sockets[0]);
+   }
+   if (sockets[1] != -1)
+   {
+      close(sockets[1]);
+   }
+   pgmoneta_json_destroy(backup);
+   pgmoneta_json_destroy(payload);
+   pgmoneta_json_destroy(json);
+   pgmoneta_test_teardown_encryption_env(&env);
+   MCTF_FINISH();
+}
+
 /**
  * Test: Writing a management error to a closed peer fails without terminating the process.
  */
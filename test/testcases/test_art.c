@@ -963,6 +963,177 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_art_long_prefix)
+{
+   struct art* t = NULL;
+   char key[128];
+   char** matches = NULL;
+   int count = 0;
+
+   pgmoneta_test_setup();
+
+   pgmoneta_art_create(&t);
+   MCTF_ASSERT_PTR_NONNULL(t, cleanup, "ART creation failed");
+
+   // Relation forks share prefixes longer than the inline prefix buffer
+   for (int i = 0; i < 50; i++)
+   {
+      snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d", 2600 + i);
+      MCTF_ASSERT(!pgmoneta_art_insert(t, key, i, ValueInt32), cleanup, "Insert failed");
+      snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d_fsm", 2600 + i);
+      MCTF_ASSERT(!pgmoneta_art_insert(t, key, 100 + i, ValueInt32), cleanup, "Insert fsm failed");
+      snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d_vm", 2600 + i);
+      MCTF_ASSERT(!pgmoneta_art_insert(t, key, 200 + i, ValueInt32), cleanup, "Insert vm failed");
+   }
+   MCTF_ASSERT(!pgmoneta_art_insert(t, "pg_tblspc/16385/PG_17_202406281/16385/1259", 300, ValueInt32), cleanup, "Insert failed");
+   MCTF_ASSERT_INT_EQ(t->size, 151, cleanup, "ART size should be 151");
+
+   // Keys that only differ past the inline prefix must not be found
+   MCTF_ASSERT(!pgmoneta_art_contains_key(t, "pg_tblspc/16385/PG_17_202406281/16386/1259"), cleanup, "Key should not exist");
+   MCTF_ASSERT(!pgmoneta_art_contains_key(t, "pg_tblspc/16385/PG_17_202406281/16384/2649_init"), cleanup, "Key should not exist");
+
+   for (int i = 0; i < 50; i++)
+   {
+      snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d_fsm", 2600 + i);
+      MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, key), 100 + i, cleanup, "Search fsm mismatch");
+      if (i % 2 == 0)
+      {
+         snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d", 2600 + i);
+         MCTF_ASSERT(!pgmoneta_art_delete(t, key), cleanup, "Delete failed");
+         snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d_vm", 2600 + i);
+         MCTF_ASSERT(!pgmoneta_art_delete(t, key), cleanup, "Delete vm failed");
+      }
+   }
+   MCTF_ASSERT_INT_EQ(t->size, 101, cleanup, "ART size should be 101");
+
+   // Deletes merge nodes, and with that their prefixes
+   MCTF_ASSERT(!pgmoneta_art_delete(t, "pg_tblspc/16385/PG_17_202406281/16385/1259"), cleanup, "Delete failed");
+   for (int i = 0; i < 50; i++)
+   {
+      snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d_fsm", 2600 + i);
+      MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, key), 100 + i, cleanup, "Search fsm after delete mismatch");
+      snprintf(key, sizeof(key), "pg_tblspc/16385/PG_17_202406281/16384/%d_vm", 2600 + i);
+      MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, key), i % 2 == 0 ? 0 : 200 + i, cleanup, "Search vm after delete mismatch");
+   }
+
+   count = pgmoneta_art_prefix_search(t, "pg_tblspc/16385/PG_17_202406281/16384/2611", &matches, 10);
+   MCTF_ASSERT_INT_EQ(count, 3, cleanup, "Prefix search should return 3 matches");
+
+cleanup:
+   if (matches)
+   {
+      for (int i = 0; i < count; i++)
+      {
+         free(matches[i]);
+      }
+      free(matches);
+   }
+   pgmoneta_art_destroy(t);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_node16_search)
+{
+   struct art* t = NULL;
+   char key[8];
+
+   pgmoneta_test_setup();
+
+   pgmoneta_art_create(&t);
+   MCTF_ASSERT_PTR_NONNULL(t, cleanup, "ART creation failed");
+
+   // 16 children under one node, then shrink it so stale keys stay behind
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "k%c", 'a' + i);
+      MCTF_ASSERT(!pgmoneta_art_insert(t, key, i + 1, ValueInt32), cleanup, "Insert failed");
+   }
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "k%c", 'a' + i);
+      MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, key), i + 1, cleanup, "Search mismatch");
+   }
+   for (int i = 15; i >= 6; i--)
+   {
+      snprintf(key, sizeof(key), "k%c", 'a' + i);
+      MCTF_ASSERT(!pgmoneta_art_delete(t, key), cleanup, "Delete failed");
+   }
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "k%c", 'a' + i);
+      MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, key), i < 6 ? i + 1 : 0, cleanup, "Search after delete mismatch");
+   }
+   MCTF_ASSERT(!pgmoneta_art_contains_key(t, "k"), cleanup, "Key should not exist");
+
+cleanup:
+   pgmoneta_art_destroy(t);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_bulk_load)
+{
+   struct art* t = NULL;
+   struct art* u = NULL;
+   char* keys[400];
+   uintptr_t values[400];
+   char* unsorted[3] = {"b", "a", "c"};
+   uintptr_t unsorted_values[3] = {2, 1, 3};
+   int count = 0;
+
+   pgmoneta_test_setup();
+
+   memset(keys, 0, sizeof(keys));
+
+   // Sorted relation paths with a fan out large enough for every node type,
+   // and one duplicate which replaces the first value
+   for (int i = 0; i < 300; i++)
+   {
+      keys[count] = malloc(64);
+      snprintf(keys[count], 64, "base/16384/%c%c", '0' + i / 5, 'a' + i % 5);
+      values[count] = i + 1;
+      count++;
+   }
+   keys[count] = strdup(keys[count - 1]);
+   values[count] = 1000;
+   count++;
+
+   pgmoneta_art_create(&t);
+   MCTF_ASSERT(!pgmoneta_art_bulk_load(t, keys, values, ValueInt32, count), cleanup, "Bulk load failed");
+   MCTF_ASSERT_INT_EQ(t->size, 300, cleanup, "ART size should be 300");
+   for (int i = 0; i < 299; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, keys[i]), i + 1, cleanup, "Search mismatch");
+   }
+   MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, keys[299]), 1000, cleanup, "Duplicate should win");
+   MCTF_ASSERT(!pgmoneta_art_contains_key(t, "base/16384/0"), cleanup, "Key should not exist");
+
+   // The bulk loaded tree takes ordinary updates
+   MCTF_ASSERT(!pgmoneta_art_insert(t, "base/16384/0a_fsm", 2000, ValueInt32), cleanup, "Insert failed");
+   MCTF_ASSERT(!pgmoneta_art_delete(t, keys[1]), cleanup, "Delete failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, "base/16384/0a_fsm"), 2000, cleanup, "Search mismatch");
+   MCTF_ASSERT_INT_EQ(pgmoneta_art_search(t, keys[0]), 1, cleanup, "Search mismatch");
+   MCTF_ASSERT_INT_EQ(t->size, 300, cleanup, "ART size should be 300");
+
+   // Unsorted keys are inserted one by one
+   pgmoneta_art_create(&u);
+   MCTF_ASSERT(!pgmoneta_art_bulk_load(u, unsorted, unsorted_values, ValueInt32, 3), cleanup, "Bulk load failed");
+   MCTF_ASSERT_INT_EQ(u->size, 3, cleanup, "ART size should be 3");
+   MCTF_ASSERT_INT_EQ(pgmoneta_art_search(u, "a"), 1, cleanup, "Search mismatch");
+   MCTF_ASSERT_INT_EQ(pgmoneta_art_search(u, "c"), 3, cleanup, "Search mismatch");
+
+cleanup:
+   for (int i = 0; i < count; i++)
+   {
+      free(keys[i]);
+   }
+   pgmoneta_art_destroy(t);
+   pgmoneta_art_destroy(u);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
 static void
 test_obj_create(int idx, struct art_test_obj** obj)
 {
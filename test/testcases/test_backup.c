@@ -28,16 +28,24 @@
  */
 
 #include <pgmoneta.h>
+#include <configuration.h>
 #include <logging.h>
+#include <message.h>
+#include <network.h>
+#include <security.h>
 #include <tsclient.h>
 #include <tsclient_helpers.h>
 #include <tscommon.h>
 #include <mctf.h>
+#include <resume.h>
 #include <utils.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#define BANDWIDTH_TEST_RATE (4 * 1024 * 1024)
 
 MCTF_TEST(test_pgmoneta_backup_full)
 {
@@ -89,4 +97,140 @@ cleanup:
    }
    pgmoneta_test_basedir_cleanup();
    MCTF_FINISH();
-}
\ No newline at end of file
+}
+
+MCTF_TEST(test_pgmoneta_backup_incremental_bandwidth)
+{
+   SSL* ssl = NULL;
+   int socket = -1;
+   char* cell = NULL;
+   int64_t relation_size = 0;
+   double elapsed = 0.0;
+   double minimum = 0.0;
+   struct timespec start;
+   struct timespec end;
+   struct query_response* qr = NULL;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(pgmoneta_test_connect_user(&ssl, &socket) == 0, cleanup, "failed to connect as the test user");
+
+   /* A relation that is in the full backup */
+   MCTF_ASSERT(pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, "DROP TABLE IF EXISTS bandwidth_test;", &qr) == 0, cleanup, "drop table failed");
+   pgmoneta_test_cleanup_query_response(&qr);
+   MCTF_ASSERT(pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, "CREATE TABLE bandwidth_test (id int, payload text);", &qr) == 0, cleanup, "create table failed");
+   pgmoneta_test_cleanup_query_response(&qr);
+   MCTF_ASSERT(pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, "INSERT INTO bandwidth_test SELECT i, repeat('x', 200) FROM generate_series(1, 40000) i;", &qr) == 0, cleanup, "insert failed");
+   pgmoneta_test_cleanup_query_response(&qr);
+
+   MCTF_ASSERT(pgmoneta_test_add_backup() == 0, cleanup, "full backup failed");
+
+   /* Every block changes, so the incremental backup fetches all of them */
+   MCTF_ASSERT(pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, "UPDATE bandwidth_test SET id = id + 1;", &qr) == 0, cleanup, "update failed");
+   pgmoneta_test_cleanup_query_response(&qr);
+   MCTF_ASSERT(pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, "SELECT pg_relation_size('bandwidth_test');", &qr) == 0, cleanup, "relation size failed");
+   cell = pgmoneta_query_response_get_data(qr, 0);
+   MCTF_ASSERT_PTR_NONNULL(cell, cleanup, "no relation size");
+   relation_size = strtoll(cell, NULL, 10);
+   pgmoneta_test_cleanup_query_response(&qr);
+
+   MCTF_ASSERT(pgmoneta_tsclient_conf_set(CONFIGURATION_ARGUMENT_MAX_BANDWIDTH, "4M", 0) == 0, cleanup, "conf set max_bandwidth failed");
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   MCTF_ASSERT(pgmoneta_tsclient_backup("primary", "newest", 0) == 0, cleanup, "incremental backup failed");
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   /* The changed blocks alone take this long at the limit, with room for the burst */
+   elapsed = pgmoneta_compute_duration(start, end);
+   minimum = (double)relation_size / BANDWIDTH_TEST_RATE / 2.0;
+   MCTF_ASSERT(elapsed >= minimum, cleanup, "incremental backup of %" PRId64 " bytes took %.2f s, expected at least %.2f s",
+               relation_size, elapsed, minimum);
+
+cleanup:
+   pgmoneta_tsclient_conf_set(CONFIGURATION_ARGUMENT_MAX_BANDWIDTH, "0", 0);
+   pgmoneta_test_cleanup_query_response(&qr);
+   if (ssl != NULL || socket != -1)
+   {
+      if (pgmoneta_test_execute_query(PRIMARY_SERVER, ssl, socket, "DROP TABLE IF EXISTS bandwidth_test;", &qr) == 0)
+      {
+         pgmoneta_test_cleanup_query_response(&qr);
+      }
+   }
+   pgmoneta_test_cleanup_connection(&ssl, &socket);
+   pgmoneta_test_basedir_cleanup();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_pgmoneta_backup_resume)
+{
+   char* backup = NULL;
+   char* backup_data = NULL;
+   char* directory = NULL;
+   char* kept = NULL;
+   FILE* f = NULL;
+   struct resume* resume = NULL;
+   struct resume_file* rf = NULL;
+
+   pgmoneta_test_setup();
+
+   backup = pgmoneta_get_server_backup_identifier(PRIMARY_SERVER, "resume_test");
+   backup_data = pgmoneta_get_server_backup_identifier_data(PRIMARY_SERVER, "resume_test");
+   directory = pgmoneta_append(directory, backup_data);
+   directory = pgmoneta_append(directory, "base/1/");
+   kept = pgmoneta_get_server(PRIMARY_SERVER);
+   kept = pgmoneta_append(kept, "resume/data/base/1/16384");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_resume_open(PRIMARY_SERVER, "parent", &resume), 0, cleanup, "open failed");
+   MCTF_ASSERT_INT_EQ((int)resume->number_of_files, 0, cleanup, "expected no files to reuse");
+   MCTF_ASSERT_INT_EQ(pgmoneta_resume_start(resume, "resume_test", 0x1000000, NULL), 0, cleanup, "start failed");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_mkdir(directory), 0, cleanup, "mkdir failed");
+   directory = pgmoneta_append(directory, "16384");
+   f = fopen(directory, "w");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup, "unable to create file");
+   fputs("pgmoneta", f);
+   fclose(f);
+   f = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_resume_complete(resume, "base/1/16384", "base/1/16384", true, backup_data), 0, cleanup, "complete failed");
+
+   /* Without the data directory the files stay where a crash would leave them */
+   pgmoneta_resume_finish(resume, false, NULL);
+   resume = NULL;
+   MCTF_ASSERT(pgmoneta_exists(directory), cleanup, "file should be left in the backup");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_resume_open(PRIMARY_SERVER, "parent", &resume), 0, cleanup, "open after crash failed");
+   MCTF_ASSERT_INT_EQ((int)resume->number_of_files, 1, cleanup, "expected one file to reuse");
+   MCTF_ASSERT(!pgmoneta_exists(backup), cleanup, "backup directory should be taken over");
+   MCTF_ASSERT(pgmoneta_exists(kept), cleanup, "file should be kept for the next backup");
+
+   rf = (struct resume_file*)pgmoneta_art_search(resume->files, "base/1/16384");
+   MCTF_ASSERT_PTR_NONNULL(rf, cleanup, "file not recorded");
+   MCTF_ASSERT_INT_EQ((int)rf->size, 8, cleanup, "size mismatch");
+   MCTF_ASSERT_INT_EQ((int)strlen(rf->sha256), 64, cleanup, "checksum missing");
+
+   pgmoneta_resume_finish(resume, true, NULL);
+   resume = NULL;
+
+   /* A backup of another parent discards the files */
+   MCTF_ASSERT_INT_EQ(pgmoneta_resume_open(PRIMARY_SERVER, "other", &resume), 0, cleanup, "open failed");
+   MCTF_ASSERT_INT_EQ((int)resume->number_of_files, 0, cleanup, "expected no files to reuse");
+   MCTF_ASSERT(!pgmoneta_exists(kept), cleanup, "files of another parent should be discarded");
+
+cleanup:
+   if (f != NULL)
+   {
+      fclose(f);
+   }
+   pgmoneta_resume_finish(resume, true, NULL);
+   if (backup != NULL && pgmoneta_exists(backup))
+   {
+      pgmoneta_delete_directory(backup);
+   }
+   free(backup);
+   free(backup_data);
+   free(directory);
+   free(kept);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pgmoneta.h>
+#include <bandwidth.h>
+#include <mctf.h>
+#include <shmem.h>
+#include <tscommon.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOW         10000000000LL /* An arbitrary time of 10 s */
+#define SECOND      1000000000LL
+#define MEGABYTE    1000000
+#define RATE_EQ(a, b) ((a) - (b) < 0.5 && (b) - (a) < 0.5)
+
+static bool shmem_allocated = false;
+
+static void setup_servers(void);
+
+MCTF_MODULE_SETUP(bandwidth)
+{
+   if (shmem == NULL)
+   {
+      pgmoneta_create_shared_memory(sizeof(struct main_configuration), HUGEPAGE_OFF, &shmem);
+      memset(shmem, 0, sizeof(struct main_configuration));
+      shmem_allocated = true;
+   }
+}
+
+MCTF_MODULE_TEARDOWN(bandwidth)
+{
+   if (shmem_allocated && shmem != NULL)
+   {
+      pgmoneta_destroy_shared_memory(shmem, sizeof(struct main_configuration));
+      shmem = NULL;
+      shmem_allocated = false;
+   }
+}
+
+MCTF_TEST_SETUP(bandwidth)
+{
+   pgmoneta_test_config_save();
+   setup_servers();
+}
+
+MCTF_TEST_TEARDOWN(bandwidth)
+{
+   pgmoneta_test_config_restore();
+}
+
+MCTF_TEST(test_bandwidth_rates_unlimited)
+{
+   double global = -1.0;
+   double assured = -1.0;
+   double ceiling = -1.0;
+   double share = -1.0;
+
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_BACKUP, NOW, &global, &assured, &ceiling, &share);
+
+   MCTF_ASSERT(RATE_EQ(global, 0.0), cleanup, "global should be unlimited, got %f", global);
+   MCTF_ASSERT(RATE_EQ(assured, 0.0), cleanup, "assured should be unlimited, got %f", assured);
+   MCTF_ASSERT(RATE_EQ(ceiling, 0.0), cleanup, "ceiling should be unlimited, got %f", ceiling);
+   MCTF_ASSERT(RATE_EQ(share, 0.0), cleanup, "share should be unlimited, got %f", share);
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_bandwidth_rates_fair_share)
+{
+   double global = 0.0;
+   double assured = 0.0;
+   double ceiling = 0.0;
+   double share = 0.0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+   config->max_bandwidth = MEGABYTE;
+   config->common.servers[1].bandwidth_weight = 3;
+
+   /* Alone, a server gets the whole limit */
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_BACKUP, NOW, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(global, MEGABYTE), cleanup, "global should be the limit, got %f", global);
+   MCTF_ASSERT(RATE_EQ(assured, MEGABYTE), cleanup, "assured should be the limit, got %f", assured);
+   MCTF_ASSERT(RATE_EQ(ceiling, MEGABYTE), cleanup, "ceiling should be the limit, got %f", ceiling);
+   MCTF_ASSERT(RATE_EQ(share, MEGABYTE), cleanup, "share should be the limit, got %f", share);
+
+   /* An active server takes its weighted share */
+   atomic_store(&config->common.servers[1].bandwidth.operations[BANDWIDTH_BACKUP].last_active, NOW - 1);
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_BACKUP, NOW, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(assured, MEGABYTE / 4), cleanup, "assured should be a quarter, got %f", assured);
+   MCTF_ASSERT(RATE_EQ(ceiling, MEGABYTE), cleanup, "ceiling should stay the limit, got %f", ceiling);
+   MCTF_ASSERT(RATE_EQ(share, MEGABYTE / 4), cleanup, "share should be the server share, got %f", share);
+
+   /* Within the server, WAL streaming outweighs a backup */
+   atomic_store(&config->common.servers[0].bandwidth.operations[BANDWIDTH_WAL].last_active, NOW - 1);
+   atomic_store(&config->common.servers[0].bandwidth.operations[BANDWIDTH_BACKUP].last_active, NOW - 1);
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_BACKUP, NOW, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(share, MEGABYTE / 4 * BANDWIDTH_WEIGHT_BACKUP / (BANDWIDTH_WEIGHT_WAL + BANDWIDTH_WEIGHT_BACKUP)),
+               cleanup, "unexpected backup share %f", share);
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_WAL, NOW, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(share, MEGABYTE / 4 * BANDWIDTH_WEIGHT_WAL / (BANDWIDTH_WEIGHT_WAL + BANDWIDTH_WEIGHT_BACKUP)),
+               cleanup, "unexpected WAL share %f", share);
+
+   /* A server idle for more than a second leaves the sharing */
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_BACKUP, NOW + 2 * SECOND, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(assured, MEGABYTE), cleanup, "assured should be the limit again, got %f", assured);
+   MCTF_ASSERT(RATE_EQ(share, MEGABYTE), cleanup, "share should be the limit again, got %f", share);
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_bandwidth_rates_server_limit)
+{
+   double global = 0.0;
+   double assured = 0.0;
+   double ceiling = 0.0;
+   double share = 0.0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+   config->common.servers[0].max_bandwidth = MEGABYTE / 10;
+
+   /* Without a global limit the server limit applies */
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_RESTORE, NOW, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(global, 0.0), cleanup, "global should be unlimited, got %f", global);
+   MCTF_ASSERT(RATE_EQ(assured, MEGABYTE / 10), cleanup, "assured should be the server limit, got %f", assured);
+   MCTF_ASSERT(RATE_EQ(ceiling, MEGABYTE / 10), cleanup, "ceiling should be the server limit, got %f", ceiling);
+
+   /* The server limit caps its share of a larger global limit */
+   config->max_bandwidth = MEGABYTE;
+   pgmoneta_bandwidth_rates(0, BANDWIDTH_RESTORE, NOW, &global, &assured, &ceiling, &share);
+   MCTF_ASSERT(RATE_EQ(assured, MEGABYTE / 10), cleanup, "assured should be the server limit, got %f", assured);
+   MCTF_ASSERT(RATE_EQ(ceiling, MEGABYTE / 10), cleanup, "ceiling should be the server limit, got %f", ceiling);
+   MCTF_ASSERT(RATE_EQ(share, MEGABYTE / 10), cleanup, "share should be the server limit, got %f", share);
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_bandwidth_bucket_wait)
+{
+   struct bandwidth_bucket unlimited = {0};
+   struct bandwidth_bucket bucket = {0};
+
+   /* An unlimited bucket never waits */
+   pgmoneta_bandwidth_bucket_refill(&unlimited, 0.0, NOW);
+   pgmoneta_bandwidth_bucket_take(&unlimited, 0.0, MEGABYTE);
+   MCTF_ASSERT(pgmoneta_bandwidth_bucket_ready(&unlimited, 0.0), cleanup, "unlimited bucket should be ready");
+   MCTF_ASSERT(pgmoneta_bandwidth_bucket_wait(&unlimited, 0.0) == 0, cleanup, "unlimited bucket should not wait");
+
+   /* A new bucket starts with 100 ms worth of tokens */
+   pgmoneta_bandwidth_bucket_refill(&bucket, MEGABYTE, NOW);
+   MCTF_ASSERT(RATE_EQ(bucket.tokens, MEGABYTE / 10), cleanup, "unexpected burst %f", bucket.tokens);
+
+   /* Going 50000 bytes into debt at 1 MB/s is a 50 ms wait */
+   pgmoneta_bandwidth_bucket_take(&bucket, MEGABYTE, MEGABYTE / 10 + 50000);
+   MCTF_ASSERT(!pgmoneta_bandwidth_bucket_ready(&bucket, MEGABYTE), cleanup, "bucket in debt should not be ready");
+   MCTF_ASSERT(llabs(pgmoneta_bandwidth_bucket_wait(&bucket, MEGABYTE) - 50000000LL) < 1000, cleanup,
+               "unexpected wait %lld", (long long)pgmoneta_bandwidth_bucket_wait(&bucket, MEGABYTE));
+
+   /* Half of the debt is paid back after 25 ms */
+   pgmoneta_bandwidth_bucket_refill(&bucket, MEGABYTE, NOW + 25000000LL);
+   MCTF_ASSERT(llabs(pgmoneta_bandwidth_bucket_wait(&bucket, MEGABYTE) - 25000000LL) < 1000, cleanup,
+               "unexpected wait %lld", (long long)pgmoneta_bandwidth_bucket_wait(&bucket, MEGABYTE));
+
+   /* An idle bucket does not save more than the burst */
+   pgmoneta_bandwidth_bucket_refill(&bucket, MEGABYTE, NOW + 10 * SECOND);
+   MCTF_ASSERT(RATE_EQ(bucket.tokens, MEGABYTE / 10), cleanup, "tokens should be capped, got %f", bucket.tokens);
+   MCTF_ASSERT(pgmoneta_bandwidth_bucket_wait(&bucket, MEGABYTE) == 0, cleanup, "full bucket should not wait");
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_bandwidth_bucket_borrow)
+{
+   struct bandwidth_bucket share = {0};
+   struct bandwidth_bucket ceil = {0};
+   double share_rate = MEGABYTE / 4;
+   double ceil_rate = MEGABYTE;
+   size_t chunk = 10000;
+   size_t assured = 0;
+   size_t borrowed = 0;
+
+   pgmoneta_bandwidth_bucket_refill(&share, share_rate, NOW);
+   pgmoneta_bandwidth_bucket_refill(&ceil, ceil_rate, NOW);
+
+   /* Send within the share first, then borrow until the ceiling is in debt */
+   while (pgmoneta_bandwidth_bucket_ready(&ceil, ceil_rate))
+   {
+      if (pgmoneta_bandwidth_bucket_ready(&share, share_rate))
+      {
+         pgmoneta_bandwidth_bucket_take(&share, share_rate, chunk);
+         assured += chunk;
+      }
+      else
+      {
+         borrowed += chunk;
+      }
+      pgmoneta_bandwidth_bucket_take(&ceil, ceil_rate, chunk);
+   }
+
+   MCTF_ASSERT(assured > 0, cleanup, "nothing was sent within the share");
+   MCTF_ASSERT(borrowed > 0, cleanup, "nothing was borrowed");
+   MCTF_ASSERT(assured + borrowed <= MEGABYTE / 10 + chunk, cleanup,
+               "sent %zu bytes, more than the ceiling allows", assured + borrowed);
+
+   /* The ceiling in debt by less than a chunk at 1 MB/s waits less than 10 ms */
+   MCTF_ASSERT(pgmoneta_bandwidth_bucket_wait(&ceil, ceil_rate) > 0, cleanup, "ceiling should wait");
+   MCTF_ASSERT(pgmoneta_bandwidth_bucket_wait(&ceil, ceil_rate) <= 10000000LL, cleanup,
+               "unexpected wait %lld", (long long)pgmoneta_bandwidth_bucket_wait(&ceil, ceil_rate));
+
+cleanup:
+   MCTF_FINISH();
+}
+
+static void
+setup_servers(void)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   config->max_bandwidth = 0;
+   config->common.number_of_servers = 2;
+   memset(&config->bandwidth, 0, sizeof(struct bandwidth));
+
+   for (int i = 0; i < 2; i++)
+   {
+      config->common.servers[i].max_bandwidth = 0;
+      config->common.servers[i].bandwidth_weight = 1;
+      memset(&config->common.servers[i].bandwidth, 0, sizeof(struct bandwidth_server));
+   }
+}
@@ -111,6 +111,102 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_pgmoneta_merge_file)
+{
+   int nblocks = 0;
+   block_ref_table* brt = NULL;
+   block_number blocks[64];
+   struct rel_file_locator rlocator;
+   enum fork_number frk;
+   block_ref_table_entry* entry = NULL;
+   char* r = NULL;
+
+   pgmoneta_test_setup();
+
+   relation_fork_init(1663, 234, 345, MAIN_FORKNUM, &rlocator, &frk);
+
+   pgmoneta_brt_create_empty(&brt);
+   MCTF_ASSERT(!consecutive_mark_block_modified(brt, &rlocator, frk, 0, 10), cleanup, "Mark modified failed 1");
+   MCTF_ASSERT(!brt_write(brt), cleanup, "BRT write failed");
+   pgmoneta_brt_destroy(brt);
+   brt = NULL;
+
+   // Merge the summary into a table that already has other blocks
+   pgmoneta_brt_create_empty(&brt);
+   MCTF_ASSERT(!consecutive_mark_block_modified(brt, &rlocator, frk, 100, 10), cleanup, "Mark modified failed 2");
+
+   r = get_backup_summary_path();
+   r = pgmoneta_append(r, "tmp.summary");
+   MCTF_ASSERT(!pgmoneta_brt_merge_file(r, brt), cleanup, "BRT merge failed");
+
+   entry = pgmoneta_brt_get_entry(brt, &rlocator, frk, NULL);
+   MCTF_ASSERT_PTR_NONNULL(entry, cleanup, "Entry not found in block reference table");
+
+   MCTF_ASSERT(!pgmoneta_brt_entry_get_blocks(entry, 0, 200, blocks, 64, &nblocks), cleanup, "Get blocks failed");
+   MCTF_ASSERT_INT_EQ(nblocks, 20, cleanup, "Merged table should have the blocks of both tables");
+
+cleanup:
+   free(r);
+   pgmoneta_brt_destroy(brt);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_pgmoneta_ranges_union)
+{
+   int nranges = 0;
+   block_ref_table* brt = NULL;
+   block_ref_table* other = NULL;
+   block_ref_table_range ranges[8];
+   struct rel_file_locator rlocator;
+   enum fork_number frk;
+   block_ref_table_entry* entry = NULL;
+
+   pgmoneta_test_setup();
+
+   relation_fork_init(1663, 234, 345, MAIN_FORKNUM, &rlocator, &frk);
+
+   // The second run spans an array chunk and a bitmap chunk
+   pgmoneta_brt_create_empty(&other);
+   MCTF_ASSERT(!consecutive_mark_block_modified(other, &rlocator, frk, 0, 10), cleanup, "Mark modified failed 1");
+   MCTF_ASSERT(!consecutive_mark_block_modified(other, &rlocator, frk, 65000, 5000), cleanup, "Mark modified failed 2");
+
+   pgmoneta_brt_create_empty(&brt);
+   MCTF_ASSERT(!consecutive_mark_block_modified(brt, &rlocator, frk, 10, 10), cleanup, "Mark modified failed 3");
+   MCTF_ASSERT(!pgmoneta_brt_union(brt, other), cleanup, "BRT union failed");
+
+   entry = pgmoneta_brt_get_entry(brt, &rlocator, frk, NULL);
+   MCTF_ASSERT_PTR_NONNULL(entry, cleanup, "Entry not found in block reference table");
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_brt_entry_cardinality(entry), 5020, cleanup, "Union should have the blocks of both tables");
+
+   MCTF_ASSERT(!pgmoneta_brt_entry_get_ranges(entry, 0, 100000, ranges, 8, &nranges), cleanup, "Get ranges failed");
+   MCTF_ASSERT_INT_EQ(nranges, 2, cleanup, "Adjacent blocks should be joined into runs");
+   MCTF_ASSERT_INT_EQ((int)ranges[0].start, 0, cleanup, "First run start");
+   MCTF_ASSERT_INT_EQ((int)ranges[0].length, 20, cleanup, "First run length");
+   MCTF_ASSERT_INT_EQ((int)ranges[1].start, 65000, cleanup, "Second run start");
+   MCTF_ASSERT_INT_EQ((int)ranges[1].length, 5000, cleanup, "Second run length");
+
+   // Round trip through a file keeps the runs
+   MCTF_ASSERT(!brt_write(brt), cleanup, "BRT write failed");
+   pgmoneta_brt_destroy(brt);
+   brt = NULL;
+   MCTF_ASSERT(!brt_read(&brt), cleanup, "BRT read failed");
+
+   entry = pgmoneta_brt_get_entry(brt, &rlocator, frk, NULL);
+   MCTF_ASSERT_PTR_NONNULL(entry, cleanup, "Entry not found after read");
+   MCTF_ASSERT(!pgmoneta_brt_entry_get_ranges(entry, 5, 65010, ranges, 8, &nranges), cleanup, "Get ranges failed after read");
+   MCTF_ASSERT_INT_EQ(nranges, 2, cleanup, "Clipped ranges");
+   MCTF_ASSERT_INT_EQ((int)ranges[0].start, 5, cleanup, "Clipped first run start");
+   MCTF_ASSERT_INT_EQ((int)ranges[0].length, 15, cleanup, "Clipped first run length");
+   MCTF_ASSERT_INT_EQ((int)ranges[1].length, 10, cleanup, "Clipped second run length");
+
+cleanup:
+   pgmoneta_brt_destroy(brt);
+   pgmoneta_brt_destroy(other);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
 static void
 relation_fork_init(int spcoid, int dboid, int relnum, enum fork_number forknum, struct rel_file_locator* r, enum fork_number* frk)
 {
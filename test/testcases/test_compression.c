@@ -37,7 +37,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <unistd.h>
 #include <utils.h>
+#include <zstandard_compression.h>
 #include <tsclient_helpers.h>
 
 /* Server-Side Compression Tests */
@@ -294,6 +296,187 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_compression_class)
+{
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class("data/base/5/16384"), COMPRESSION_CLASS_RELATION, cleanup, "class base failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class("data/global/1262"), COMPRESSION_CLASS_RELATION, cleanup, "class global failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class("data/pg_wal/000000010000000000000001"), COMPRESSION_CLASS_WAL, cleanup, "class wal failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class("data/pg_xact/0000"), COMPRESSION_CLASS_TRANSACTION, cleanup, "class xact failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class("data/pg_multixact/offsets/0000"), COMPRESSION_CLASS_TRANSACTION, cleanup, "class multixact failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class("data/postgresql.conf"), COMPRESSION_CLASS_OTHER, cleanup, "class other failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_class(NULL), COMPRESSION_CLASS_OTHER, cleanup, "class NULL failed");
+   MCTF_ASSERT_STR_EQ(pgmoneta_compression_class_name(COMPRESSION_CLASS_WAL), "wal", cleanup, "class name failed");
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_compression_sample)
+{
+   FILE* f = NULL;
+   char* redundant = "/tmp/pgmoneta_sample_redundant";
+   char* random = "/tmp/pgmoneta_sample_random";
+   uint64_t x = 88172645463325252ULL;
+   int decision = -1;
+
+   f = fopen(redundant, "w");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup, "fopen redundant failed");
+   for (int i = 0; i < COMPRESSION_SAMPLE_SIZE; i++)
+   {
+      fputc('a', f);
+   }
+   fclose(f);
+
+   f = fopen(random, "w");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup, "fopen random failed");
+   for (int i = 0; i < COMPRESSION_SAMPLE_SIZE; i++)
+   {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      fputc((int)(x & 0xFF), f);
+   }
+   fclose(f);
+   f = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_sample(redundant, &decision), 0, cleanup, "sample redundant failed");
+   MCTF_ASSERT_INT_EQ(decision, COMPRESSION_DECISION_FAST, cleanup, "redundant data should use the fast level");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_compression_sample(random, &decision), 0, cleanup, "sample random failed");
+   MCTF_ASSERT_INT_EQ(decision, COMPRESSION_DECISION_SKIP, cleanup, "random data should be skipped");
+
+   MCTF_ASSERT(pgmoneta_compression_sample("/tmp/pgmoneta_sample_missing", &decision) != 0, cleanup, "sample missing file should fail");
+
+cleanup:
+   if (f != NULL)
+   {
+      fclose(f);
+   }
+   remove(redundant);
+   remove(random);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_compression_zstd_dictionary)
+{
+   char dir[MAX_PATH] = "/tmp/pgmoneta_zstd_dictionary_XXXXXX";
+   char backup[MAX_PATH];
+   char incremental[MAX_PATH];
+   char samples[MAX_PATH];
+   char path[MAX_PATH];
+   char linked[MAX_PATH];
+   char from[MAX_PATH];
+   char compressed[MAX_PATH];
+   char decompressed[MAX_PATH];
+   char saved_base_dir[MAX_PATH];
+   char saved_name[MISC_LENGTH];
+   char expected[1024];
+   char actual[1024];
+   int saved_number_of_servers;
+   bool saved = false;
+   size_t expected_size = 0;
+   size_t actual_size = 0;
+   FILE* f = NULL;
+   struct zstd_dictionary* dictionary = NULL;
+   struct zstd_dictionary* shared = NULL;
+   struct main_configuration* config = NULL;
+
+   pgmoneta_test_setup();
+
+   config = (struct main_configuration*)shmem;
+
+   MCTF_ASSERT_PTR_NONNULL(config, cleanup, "configuration is not available");
+   MCTF_ASSERT_PTR_NONNULL(mkdtemp(dir), cleanup, "failed to create temp dir");
+
+   memcpy(saved_base_dir, config->base_dir, MAX_PATH);
+   memcpy(saved_name, config->common.servers[PRIMARY_SERVER].name, MISC_LENGTH);
+   saved_number_of_servers = config->common.number_of_servers;
+   saved = true;
+
+   pgmoneta_snprintf(config->base_dir, MAX_PATH, "%s", dir);
+   pgmoneta_snprintf(config->common.servers[PRIMARY_SERVER].name, MISC_LENGTH, "%s", "primary");
+   config->common.number_of_servers = MAX(config->common.number_of_servers, PRIMARY_SERVER + 1);
+
+   /* Many small files with a shared structure in a backup of the server */
+   pgmoneta_snprintf(backup, MAX_PATH, "%s/primary/backup/20260101000000/", dir);
+   pgmoneta_snprintf(incremental, MAX_PATH, "%s/primary/backup/20260102000000/", dir);
+   pgmoneta_snprintf(samples, MAX_PATH, "%sdata/", backup);
+   MCTF_ASSERT(!pgmoneta_mkdir(samples), cleanup, "failed to create samples dir");
+   MCTF_ASSERT(!pgmoneta_mkdir(incremental), cleanup, "failed to create incremental dir");
+
+   for (int i = 0; i < 256; i++)
+   {
+      pgmoneta_snprintf(path, MAX_PATH, "%s%d.conf", samples, i);
+      f = fopen(path, "w");
+      MCTF_ASSERT_PTR_NONNULL(f, cleanup, "failed to create sample");
+      for (int j = 0; j < 16; j++)
+      {
+         fprintf(f, "relation_%d_attribute_%d = 'value %d of the sample relation'\n", i % 7, j, (i * 31 + j * 17) % 1000);
+      }
+      fclose(f);
+      f = NULL;
+   }
+
+   MCTF_ASSERT(!pgmoneta_zstandard_dictionary_train(backup, 3, &dictionary), cleanup, "dictionary training failed");
+   MCTF_ASSERT_PTR_NONNULL(dictionary, cleanup, "no dictionary trained");
+   MCTF_ASSERT(pgmoneta_zstandard_dictionary_id(dictionary) != 0, cleanup, "dictionary has no identifier");
+
+   /* The dictionary is part of the backup */
+   pgmoneta_snprintf(path, MAX_PATH, "%s%s", backup, COMPRESSION_DICTIONARY);
+   MCTF_ASSERT(pgmoneta_exists(path), cleanup, "dictionary not stored in the backup");
+
+   /* An incremental backup reuses the dictionary of its parent */
+   pgmoneta_snprintf(linked, MAX_PATH, "%s%s", incremental, COMPRESSION_DICTIONARY);
+   MCTF_ASSERT(link(path, linked) == 0, cleanup, "failed to link dictionary");
+   MCTF_ASSERT(!pgmoneta_zstandard_dictionary_train(incremental, 3, &shared), cleanup, "dictionary reuse failed");
+   MCTF_ASSERT_PTR_NONNULL(shared, cleanup, "dictionary not reused");
+   MCTF_ASSERT(pgmoneta_zstandard_dictionary_id(shared) == pgmoneta_zstandard_dictionary_id(dictionary), cleanup,
+               "reused dictionary has another identifier");
+
+   pgmoneta_snprintf(from, MAX_PATH, "%s/sample.conf", dir);
+   pgmoneta_snprintf(compressed, MAX_PATH, "%s/sample.conf.zstd", dir);
+   pgmoneta_snprintf(decompressed, MAX_PATH, "%s/sample.out", dir);
+   pgmoneta_snprintf(path, MAX_PATH, "%s42.conf", samples);
+
+   f = fopen(path, "r");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup, "failed to open sample");
+   expected_size = fread(expected, 1, sizeof(expected), f);
+   fclose(f);
+   f = NULL;
+
+   MCTF_ASSERT(!pgmoneta_copy_file(path, from, NULL), cleanup, "failed to copy sample");
+   MCTF_ASSERT(!pgmoneta_zstandardc_file_dictionary(from, compressed, dictionary), cleanup, "dictionary compression failed");
+
+   /* The dictionary is found in the backup through the identifier in the frame */
+   MCTF_ASSERT(!pgmoneta_zstandardd_file(compressed, decompressed), cleanup, "dictionary decompression failed");
+
+   f = fopen(decompressed, "r");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup, "failed to open decompressed file");
+   actual_size = fread(actual, 1, sizeof(actual), f);
+   fclose(f);
+   f = NULL;
+
+   MCTF_ASSERT_INT_EQ((int)actual_size, (int)expected_size, cleanup, "decompressed size mismatch");
+   MCTF_ASSERT(memcmp(actual, expected, expected_size) == 0, cleanup, "decompressed content mismatch");
+
+cleanup:
+   if (f != NULL)
+   {
+      fclose(f);
+   }
+   pgmoneta_zstandard_dictionary_destroy(dictionary);
+   pgmoneta_zstandard_dictionary_destroy(shared);
+   if (saved)
+   {
+      memcpy(config->base_dir, saved_base_dir, MAX_PATH);
+      memcpy(config->common.servers[PRIMARY_SERVER].name, saved_name, MISC_LENGTH);
+      config->common.number_of_servers = saved_number_of_servers;
+   }
+   pgmoneta_delete_directory(dir);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
 MCTF_TEST(test_not_double_compression_full_backup)
 {
    char* pg_version_str = NULL;
@@ -27,15 +27,21 @@
  */
 
 #include <pgmoneta.h>
+#include <delete.h>
 #include <server.h>
 #include <tsclient.h>
 #include <tsclient_helpers.h>
 #include <tscommon.h>
 #include <utils.h>
+#include <workers.h>
+#include <workflow.h>
 #include <mctf.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+static int create_tree(char* directory);
 
 MCTF_TEST(test_pgmoneta_delete_full)
 {
@@ -288,4 +294,183 @@ cleanup:
    }
    pgmoneta_test_basedir_cleanup();
    MCTF_FINISH();
-}
\ No newline at end of file
+}
+
+MCTF_TEST(test_pgmoneta_delete_retention_chain)
+{
+   struct json* response_before = NULL;
+   struct json* response_after = NULL;
+   struct workflow* workflow = NULL;
+   struct art* nodes = NULL;
+   char* en = NULL;
+   int ec = -1;
+   int num_bck_before = 0;
+   int num_bck_after = 0;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   pgmoneta_test_setup();
+   pgmoneta_test_config_save();
+
+   MCTF_ASSERT(pgmoneta_test_add_backup_chain() == 0, cleanup, "backup chain failed during setup - check server is online and backup configuration");
+
+   MCTF_ASSERT(!pgmoneta_tsclient_list_backup("primary", NULL, &response_before, 0), cleanup, "list backup before failed");
+   num_bck_before = pgmoneta_tsclient_get_backup_count(response_before);
+   MCTF_ASSERT_INT_EQ(num_bck_before, 3, cleanup, "expected 3 backups before retention");
+
+   /* Expire the whole chain, the labels have a resolution of a second */
+   sleep(1);
+
+   config->retention_days = 0;
+   config->retention_weeks = -1;
+   config->retention_months = -1;
+   config->retention_years = -1;
+   config->common.servers[PRIMARY_SERVER].retention_days = 0;
+   config->common.servers[PRIMARY_SERVER].retention_weeks = 0;
+   config->common.servers[PRIMARY_SERVER].retention_months = 0;
+   config->common.servers[PRIMARY_SERVER].retention_years = 0;
+   config->common.servers[PRIMARY_SERVER].online = true;
+
+   workflow = pgmoneta_workflow_create(WORKFLOW_TYPE_RETENTION, NULL);
+   MCTF_ASSERT_PTR_NONNULL(workflow, cleanup, "retention workflow is null");
+   MCTF_ASSERT_INT_EQ(pgmoneta_art_create(&nodes), 0, cleanup, "failed to create nodes");
+   MCTF_ASSERT_INT_EQ(pgmoneta_workflow_execute(workflow, nodes, &en, &ec), 0, cleanup, "retention failed");
+
+   /* Each deletion leaves its parent without a child, so one run removes the chain */
+   MCTF_ASSERT(!pgmoneta_tsclient_list_backup("primary", NULL, &response_after, 0), cleanup, "list backup after failed");
+   num_bck_after = pgmoneta_tsclient_get_backup_count(response_after);
+   MCTF_ASSERT_INT_EQ(num_bck_after, 0, cleanup, "expected no backups after retention");
+
+cleanup:
+   if (response_before != NULL)
+   {
+      pgmoneta_json_destroy(response_before);
+   }
+   if (response_after != NULL)
+   {
+      pgmoneta_json_destroy(response_after);
+   }
+   pgmoneta_art_destroy(nodes);
+   pgmoneta_workflow_destroy(workflow);
+   pgmoneta_test_config_restore();
+   pgmoneta_test_basedir_cleanup();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_pgmoneta_delete_reclaim)
+{
+   char* server = NULL;
+   char* d = NULL;
+   char* trashed = NULL;
+   struct workers* workers = NULL;
+
+   pgmoneta_test_setup();
+
+   server = pgmoneta_get_server(PRIMARY_SERVER);
+   MCTF_ASSERT_PTR_NONNULL(server, cleanup, "server directory is null");
+
+   d = pgmoneta_append(d, server);
+   d = pgmoneta_append(d, "backup/reclaim_test/");
+   trashed = pgmoneta_append(trashed, server);
+   trashed = pgmoneta_append(trashed, "trash/reclaim_test");
+
+   MCTF_ASSERT_INT_EQ(create_tree(d), 0, cleanup, "failed to create tree");
+   MCTF_ASSERT_INT_EQ(pgmoneta_workers_initialize(2, &workers), 0, cleanup, "failed to create workers");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_delete_reclaim(PRIMARY_SERVER, d, workers), 0, cleanup, "reclaim failed");
+   MCTF_ASSERT(!pgmoneta_exists(d), cleanup, "directory should be moved away before reclaim returns");
+
+   pgmoneta_workers_wait(workers);
+   MCTF_ASSERT(!pgmoneta_exists(trashed), cleanup, "trash should be empty after the workers finish");
+
+cleanup:
+   pgmoneta_workers_destroy(workers);
+   if (d != NULL && pgmoneta_exists(d))
+   {
+      pgmoneta_delete_directory(d);
+   }
+   free(server);
+   free(d);
+   free(trashed);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_pgmoneta_delete_trash)
+{
+   char* server = NULL;
+   char* d = NULL;
+
+   pgmoneta_test_setup();
+
+   server = pgmoneta_get_server(PRIMARY_SERVER);
+   MCTF_ASSERT_PTR_NONNULL(server, cleanup, "server directory is null");
+
+   d = pgmoneta_append(d, server);
+   d = pgmoneta_append(d, "trash/left_over/");
+
+   MCTF_ASSERT_INT_EQ(create_tree(d), 0, cleanup, "failed to create tree");
+
+   /* Without workers the left overs are removed in place */
+   MCTF_ASSERT_INT_EQ(pgmoneta_delete_trash(PRIMARY_SERVER, NULL), 0, cleanup, "trash sweep failed");
+   MCTF_ASSERT(!pgmoneta_exists(d), cleanup, "left over should be removed");
+
+cleanup:
+   if (d != NULL && pgmoneta_exists(d))
+   {
+      pgmoneta_delete_directory(d);
+   }
+   free(server);
+   free(d);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+static int
+create_tree(char* directory)
+{
+   char* sub = NULL;
+   char* file = NULL;
+   FILE* f = NULL;
+
+   sub = pgmoneta_append(sub, directory);
+   sub = pgmoneta_append(sub, "data/base/1/");
+
+   if (pgmoneta_mkdir(sub))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < 16; i++)
+   {
+      char name[16];
+
+      snprintf(&name[0], sizeof(name), "%d", 16384 + i);
+
+      file = pgmoneta_append(file, sub);
+      file = pgmoneta_append(file, &name[0]);
+
+      f = fopen(file, "w");
+      if (f == NULL)
+      {
+         goto error;
+      }
+      fputs("pgmoneta", f);
+      fclose(f);
+      f = NULL;
+
+      free(file);
+      file = NULL;
+   }
+
+   free(sub);
+
+   return 0;
+
+error:
+   free(sub);
+   free(file);
+
+   return 1;
+}
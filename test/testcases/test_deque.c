@@ -450,6 +450,154 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_deque_large_lookup)
+{
+   struct deque* dq = NULL;
+   char tag[32];
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(!pgmoneta_deque_create(false, &dq), cleanup, "deque creation failed");
+   for (int i = 0; i < 1000; i++)
+   {
+      snprintf(tag, sizeof(tag), "file%d", i);
+      MCTF_ASSERT(!pgmoneta_deque_add(dq, tag, (uintptr_t)i, ValueInt32), cleanup, "add failed");
+   }
+
+   // the first lookup indexes the tags, later adds keep the index up to date
+   MCTF_ASSERT(pgmoneta_deque_exists(dq, "file500"), cleanup, "file500 should exist");
+   MCTF_ASSERT(!pgmoneta_deque_exists(dq, "file1000"), cleanup, "file1000 should not exist");
+   MCTF_ASSERT(!pgmoneta_deque_add(dq, "file1000", 1000, ValueInt32), cleanup, "add 1000 failed");
+   MCTF_ASSERT(!pgmoneta_deque_add(dq, "file10", 2000, ValueInt32), cleanup, "add duplicate failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_get(dq, "file1000"), 1000, cleanup, "get file1000 failed");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_get(dq, "file10"), 10, cleanup, "get should return the first file10");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_remove(dq, "file10"), 2, cleanup, "remove should remove both file10");
+   MCTF_ASSERT(!pgmoneta_deque_exists(dq, "file10"), cleanup, "file10 should not exist");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_poll(dq, NULL), 0, cleanup, "poll should return 0");
+   MCTF_ASSERT(!pgmoneta_deque_exists(dq, "file0"), cleanup, "file0 should not exist");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_poll_last(dq, NULL), 1000, cleanup, "poll_last should return 1000");
+   MCTF_ASSERT(!pgmoneta_deque_exists(dq, "file1000"), cleanup, "file1000 should not exist");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_get(dq, "file999"), 999, cleanup, "get file999 failed");
+   MCTF_ASSERT_INT_EQ(dq->size, 998, cleanup, "deque size should be 998");
+
+   pgmoneta_deque_clear(dq);
+   MCTF_ASSERT(!pgmoneta_deque_exists(dq, "file1"), cleanup, "file1 should not exist after clear");
+
+cleanup:
+   pgmoneta_deque_destroy(dq);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_deque_remove_holes)
+{
+   struct deque* dq = NULL;
+   struct deque_iterator* iter = NULL;
+   int cnt = 0;
+   int expected = 0;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(!pgmoneta_deque_create(false, &dq), cleanup, "deque creation failed");
+   for (int i = 0; i < 100; i++)
+   {
+      MCTF_ASSERT(!pgmoneta_deque_add(dq, NULL, (uintptr_t)i, ValueInt32), cleanup, "add failed");
+   }
+
+   // remove every odd value from the middle, then wrap around the ring
+   MCTF_ASSERT(!pgmoneta_deque_iterator_create(dq, &iter), cleanup, "iterator creation failed");
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      if (pgmoneta_value_data(iter->value) % 2 == 1)
+      {
+         pgmoneta_deque_iterator_remove(iter);
+         MCTF_ASSERT_PTR_NULL(iter->value, cleanup, "removed value should be NULL");
+      }
+   }
+   pgmoneta_deque_iterator_destroy(iter);
+   iter = NULL;
+   MCTF_ASSERT_INT_EQ(dq->size, 50, cleanup, "deque size should be 50");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_peek_last(dq, NULL), 98, cleanup, "peek_last should return 98");
+
+   for (int i = 0; i < 10; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgmoneta_deque_poll(dq, NULL), i * 2, cleanup, "poll mismatch");
+   }
+   for (int i = 100; i < 200; i++)
+   {
+      MCTF_ASSERT(!pgmoneta_deque_add(dq, NULL, (uintptr_t)i, ValueInt32), cleanup, "add failed");
+   }
+   MCTF_ASSERT_INT_EQ(dq->size, 140, cleanup, "deque size should be 140");
+
+   MCTF_ASSERT(!pgmoneta_deque_iterator_create(dq, &iter), cleanup, "iterator creation failed");
+   expected = 20;
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      MCTF_ASSERT_INT_EQ(pgmoneta_value_data(iter->value), expected, cleanup, "iteration order mismatch");
+      expected += expected < 100 ? 2 : 1;
+      cnt++;
+   }
+   MCTF_ASSERT_INT_EQ(cnt, 140, cleanup, "iteration count mismatch");
+
+   for (int i = 199; i >= 100; i--)
+   {
+      MCTF_ASSERT_INT_EQ(pgmoneta_deque_poll_last(dq, NULL), i, cleanup, "poll_last mismatch");
+   }
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_poll_last(dq, NULL), 98, cleanup, "poll_last should return 98");
+
+cleanup:
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(dq);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_deque_sort_large_stable)
+{
+   struct deque* dq = NULL;
+   struct deque_iterator* iter = NULL;
+   char tag[32];
+   int prev_key = -1;
+   int prev_value = -1;
+   int cnt = 0;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(!pgmoneta_deque_create(false, &dq), cleanup, "deque creation failed");
+   for (int i = 0; i < 5000; i++)
+   {
+      // 50 distinct tags in scrambled order, the value keeps the insertion order
+      snprintf(tag, sizeof(tag), "key%02d", (i * 37) % 50);
+      MCTF_ASSERT(!pgmoneta_deque_add(dq, tag, (uintptr_t)i, ValueInt32), cleanup, "add failed");
+   }
+   pgmoneta_deque_poll(dq, NULL);
+   pgmoneta_deque_remove(dq, "key07");
+
+   pgmoneta_deque_sort(dq, NULL);
+
+   MCTF_ASSERT(!pgmoneta_deque_iterator_create(dq, &iter), cleanup, "iterator creation failed");
+   while (pgmoneta_deque_iterator_next(iter))
+   {
+      int key = atoi(iter->tag + 3);
+      int value = (int)pgmoneta_value_data(iter->value);
+      MCTF_ASSERT(key >= prev_key, cleanup, "tags out of order");
+      MCTF_ASSERT(key != prev_key || value > prev_value, cleanup, "sort is not stable");
+      MCTF_ASSERT(key != 7, cleanup, "key07 should be removed");
+      prev_key = key;
+      prev_value = value;
+      cnt++;
+   }
+   MCTF_ASSERT_INT_EQ(cnt, 4899, cleanup, "sorted count mismatch");
+   MCTF_ASSERT_INT_EQ(pgmoneta_deque_get(dq, "key49"), 27, cleanup, "get after sort failed");
+
+cleanup:
+   pgmoneta_deque_iterator_destroy(iter);
+   pgmoneta_deque_destroy(dq);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
 static void
 test_obj_create(int idx, struct deque_test_obj** obj)
 {
@@ -341,3 +341,77 @@ cleanup:
    pgmoneta_test_teardown();
    MCTF_FINISH();
 }
+
+MCTF_TEST(test_json_parse_arena)
+{
+   char* doc = "{\"Files\":[{\"Path\":\"base/1\",\"Size\":8192},{\"Path\":\"base/2\",\"Size\":0}],"
+               "\"Escaped\":\"a\\\"b\\\\c\\n\",\"Double\":1.5,\"Negative\":-3,\"Flag\":true,"
+               "\"Null\":null,\"Empty\":{},\"Nested\":[[1,2],[\"x\"]]}";
+   struct json* heap = NULL;
+   struct json* arena = NULL;
+   struct json* files = NULL;
+   char* heap_str = NULL;
+   char* arena_str = NULL;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(!pgmoneta_json_parse_string(doc, &heap), cleanup, "heap parse failed");
+   MCTF_ASSERT(!pgmoneta_json_parse_string_arena(doc, &arena), cleanup, "arena parse failed");
+   MCTF_ASSERT_PTR_NONNULL(arena->arena, cleanup, "arena document should have an arena");
+   MCTF_ASSERT(arena->owns_arena, cleanup, "arena root should own the arena");
+
+   heap_str = pgmoneta_json_to_string(heap, FORMAT_JSON_COMPACT, NULL, 0);
+   arena_str = pgmoneta_json_to_string(arena, FORMAT_JSON_COMPACT, NULL, 0);
+   MCTF_ASSERT_STR_EQ(arena_str, heap_str, cleanup, "arena and heap documents differ");
+
+   files = (struct json*)pgmoneta_json_get(arena, "Files");
+   MCTF_ASSERT_PTR_NONNULL(files, cleanup, "Files should exist");
+   MCTF_ASSERT_INT_EQ(pgmoneta_json_array_length(files), 2, cleanup, "Files length mismatch");
+   MCTF_ASSERT(files->arena == arena->arena && !files->owns_arena, cleanup, "nested objects should share the arena");
+
+   MCTF_ASSERT(pgmoneta_json_parse_string_arena("{\"a\":}", &files), cleanup, "invalid document should fail");
+   MCTF_ASSERT(pgmoneta_json_parse_string_arena("{\"a\":\"b", &files), cleanup, "unterminated string should fail");
+
+cleanup:
+   free(heap_str);
+   free(arena_str);
+   pgmoneta_json_destroy(heap);
+   pgmoneta_json_destroy(arena);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_json_arena_modify)
+{
+   struct json* arena = NULL;
+   struct json* files = NULL;
+   struct json* file = NULL;
+   struct json* replaced = NULL;
+   char* str = NULL;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(!pgmoneta_json_parse_string_arena("{\"Files\":[{\"Path\":\"base/1\"}],\"Label\":\"old\",\"Gone\":1}", &arena), cleanup, "arena parse failed");
+
+   // heap objects handed to an arena document are destroyed with it
+   pgmoneta_json_create(&file);
+   pgmoneta_json_put(file, "Path", (uintptr_t)"base/2", ValueString);
+   files = (struct json*)pgmoneta_json_get(arena, "Files");
+   MCTF_ASSERT(!pgmoneta_json_append(files, (uintptr_t)file, ValueJSON), cleanup, "append failed");
+
+   pgmoneta_json_create(&replaced);
+   pgmoneta_json_put(replaced, "x", 1, ValueInt32);
+   MCTF_ASSERT(!pgmoneta_json_put(arena, "Extra", (uintptr_t)replaced, ValueJSON), cleanup, "put failed");
+   MCTF_ASSERT(!pgmoneta_json_put(arena, "Extra", 2, ValueInt32), cleanup, "replace failed");
+   MCTF_ASSERT(!pgmoneta_json_put(arena, "Label", (uintptr_t)"new", ValueString), cleanup, "put failed");
+   MCTF_ASSERT(!pgmoneta_json_remove(arena, "Gone"), cleanup, "remove failed");
+
+   str = pgmoneta_json_to_string(arena, FORMAT_JSON_COMPACT, NULL, 0);
+   MCTF_ASSERT_STR_EQ(str, "{\"Extra\":2,\"Files\":[{\"Path\":\"base/1\"},{\"Path\":\"base/2\"}],\"Label\":\"new\"}", cleanup, "modified document mismatch");
+
+cleanup:
+   free(str);
+   pgmoneta_json_destroy(arena);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <pgmoneta.h>
+#include <art.h>
+#include <json.h>
+#include <manifest.h>
+#include <tscommon.h>
+#include <mctf.h>
+#include <utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int
+write_text(char* path, char* text)
+{
+   FILE* f = NULL;
+
+   f = fopen(path, "w");
+   if (f == NULL)
+   {
+      return 1;
+   }
+   fputs(text, f);
+   fclose(f);
+   return 0;
+}
+
+static int
+put_file(struct json* files, char* path, uint64_t size, char* checksum)
+{
+   struct json* f = NULL;
+
+   if (pgmoneta_json_create(&f))
+   {
+      return 1;
+   }
+   pgmoneta_json_put(f, "Path", (uintptr_t)path, ValueString);
+   pgmoneta_json_put(f, "Size", size, ValueUInt64);
+   pgmoneta_json_put(f, "Last-Modified", (uintptr_t)"2026-01-01 00:00:00 GMT", ValueString);
+   pgmoneta_json_put(f, "Checksum-Algorithm", (uintptr_t)"SHA512", ValueString);
+   pgmoneta_json_put(f, "Checksum", (uintptr_t)checksum, ValueString);
+   return pgmoneta_json_append(files, (uintptr_t)f, ValueJSON);
+}
+
+static int
+count_diff(enum manifest_diff kind, char* path __attribute__((unused)), char* checksum __attribute__((unused)), void* data)
+{
+   int* counts = (int*)data;
+
+   counts[kind]++;
+   return 0;
+}
+
+MCTF_TEST(test_manifest_iterator_sizes)
+{
+   char dir[] = "/tmp/test_manifest_XXXXXX";
+   char path[MAX_PATH] = {0};
+   struct manifest_iterator* iter = NULL;
+   uint64_t size = 0;
+   uint64_t biggest = 0;
+   int count = 0;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT_PTR_NONNULL(mkdtemp(dir), cleanup, "Failed to create temp dir");
+   pgmoneta_snprintf(path, MAX_PATH, "%s/backup_manifest", dir);
+
+   MCTF_ASSERT(!write_text(path,
+                           "{ \"PostgreSQL-Backup-Manifest-Version\": 2,\n"
+                           "\"System-Identifier\": 7300000000000000001,\n"
+                           "\"Files\": [\n"
+                           "{ \"Path\": \"PG_VERSION\", \"Size\": 3, \"Last-Modified\": \"2026-01-01 00:00:00 GMT\", \"Checksum-Algorithm\": \"CRC32C\", \"Checksum\": \"aaaa\" },\n"
+                           "{ \"Path\": \"base/1/1259\", \"Size\": 81920, \"Last-Modified\": \"2026-01-01 00:00:00 GMT\", \"Checksum-Algorithm\": \"CRC32C\", \"Checksum\": \"bbbb\" },\n"
+                           "{ \"Path\": \"global/pg_control\", \"Size\": 8192, \"Last-Modified\": \"2026-01-01 00:00:00 GMT\", \"Checksum-Algorithm\": \"CRC32C\", \"Checksum\": \"cccc\" }\n"
+                           "],\n"
+                           "\"WAL-Ranges\": [\n"
+                           "{ \"Timeline\": 1, \"Start-LSN\": \"0/2000028\", \"End-LSN\": \"0/2000100\" }\n"
+                           "],\n"
+                           "\"Manifest-Checksum\": \"dddd\"}\n"),
+               cleanup, "Failed to write manifest");
+
+   MCTF_ASSERT(!pgmoneta_manifest_iterator_create(path, &iter), cleanup, "Iterator creation failed");
+   while (pgmoneta_manifest_iterator_next(iter))
+   {
+      count++;
+      if (count == 2)
+      {
+         MCTF_ASSERT_STR_EQ(iter->path, "base/1/1259", cleanup, "Path mismatch");
+         MCTF_ASSERT_STR_EQ(iter->checksum, "bbbb", cleanup, "Checksum mismatch");
+         MCTF_ASSERT(iter->size == 81920, cleanup, "Size mismatch");
+      }
+   }
+   MCTF_ASSERT_INT_EQ(count, 3, cleanup, "Should iterate 3 files");
+
+   MCTF_ASSERT(!pgmoneta_manifest_sum_sizes(path, NULL, NULL, &size, &biggest), cleanup, "Sum sizes failed");
+   MCTF_ASSERT(size == 3 + 81920 + 8192, cleanup, "Total size mismatch");
+   MCTF_ASSERT(biggest == 81920, cleanup, "Biggest file size mismatch");
+
+cleanup:
+   pgmoneta_manifest_iterator_destroy(iter);
+   pgmoneta_delete_directory(dir);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_manifest_merge_diff)
+{
+   char dir[] = "/tmp/test_manifest_XXXXXX";
+   char old_path[MAX_PATH] = {0};
+   char new_path[MAX_PATH] = {0};
+   char unsorted_path[MAX_PATH] = {0};
+   int counts[3] = {0};
+   int files = 0;
+   struct art* deleted = NULL;
+   struct art* changed = NULL;
+   struct art* added = NULL;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT_PTR_NONNULL(mkdtemp(dir), cleanup, "Failed to create temp dir");
+   pgmoneta_snprintf(old_path, MAX_PATH, "%s/old.manifest", dir);
+   pgmoneta_snprintf(new_path, MAX_PATH, "%s/new.manifest", dir);
+   pgmoneta_snprintf(unsorted_path, MAX_PATH, "%s/unsorted.manifest", dir);
+
+   MCTF_ASSERT(!write_text(old_path, "a,1\nb,2\nc,3\ne,5\n"), cleanup, "Failed to write old manifest");
+   MCTF_ASSERT(!write_text(new_path, "b,2\nc,33\nd,4\ne,5\nf,6\n"), cleanup, "Failed to write new manifest");
+   MCTF_ASSERT(!write_text(unsorted_path, "f,6\ne,5\nd,4\nc,33\nb,2\n"), cleanup, "Failed to write unsorted manifest");
+
+   MCTF_ASSERT(!pgmoneta_manifest_merge_diff(old_path, new_path, count_diff, counts), cleanup, "Merge diff failed");
+   MCTF_ASSERT_INT_EQ(counts[ManifestDeleted], 1, cleanup, "Deleted count mismatch");
+   MCTF_ASSERT_INT_EQ(counts[ManifestChanged], 1, cleanup, "Changed count mismatch");
+   MCTF_ASSERT_INT_EQ(counts[ManifestAdded], 2, cleanup, "Added count mismatch");
+
+   memset(counts, 0, sizeof(counts));
+   MCTF_ASSERT_INT_EQ(pgmoneta_manifest_merge_diff(old_path, unsorted_path, count_diff, counts), MANIFEST_DIFF_UNSORTED,
+                      cleanup, "Unsorted input should be detected");
+
+   MCTF_ASSERT(!pgmoneta_manifest_count_files(new_path, &files), cleanup, "Count files failed");
+   MCTF_ASSERT_INT_EQ(files, 5, cleanup, "File count mismatch");
+
+   // sorted and unsorted inputs give the same result
+   for (int i = 0; i < 2; i++)
+   {
+      MCTF_ASSERT(!pgmoneta_compare_manifests(old_path, i == 0 ? new_path : unsorted_path, &deleted, &changed, &added),
+                  cleanup, "Compare manifests failed");
+      MCTF_ASSERT(pgmoneta_art_contains_key(deleted, "a"), cleanup, "a should be deleted");
+      MCTF_ASSERT_STR_EQ((char*)pgmoneta_art_search(changed, "c"), "3", cleanup, "c should be changed");
+      MCTF_ASSERT(pgmoneta_art_contains_key(changed, "backup_manifest"), cleanup, "backup_manifest should be changed");
+      MCTF_ASSERT(pgmoneta_art_contains_key(added, "d"), cleanup, "d should be added");
+      MCTF_ASSERT(pgmoneta_art_contains_key(added, "f"), cleanup, "f should be added");
+      MCTF_ASSERT(!pgmoneta_art_contains_key(changed, "b"), cleanup, "b should be unchanged");
+      MCTF_ASSERT(deleted->size == 1 && changed->size == 2 && added->size == 2, cleanup, "Diff size mismatch");
+
+      pgmoneta_art_destroy(deleted);
+      pgmoneta_art_destroy(changed);
+      pgmoneta_art_destroy(added);
+      deleted = NULL;
+      changed = NULL;
+      added = NULL;
+   }
+
+cleanup:
+   pgmoneta_art_destroy(deleted);
+   pgmoneta_art_destroy(changed);
+   pgmoneta_art_destroy(added);
+   pgmoneta_delete_directory(dir);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_manifest_write_sorted)
+{
+   char dir[] = "/tmp/test_manifest_XXXXXX";
+   char path[MAX_PATH] = {0};
+   char rewritten[MAX_PATH] = {0};
+   char* expected[] = {"PG_VERSION", "base/1/1259", "global/pg_control", "base/1/1260"};
+   int count = 0;
+   struct json* manifest = NULL;
+   struct json* files = NULL;
+   struct json* ranges = NULL;
+   struct json* range = NULL;
+   struct json* extra = NULL;
+   struct manifest_iterator* iter = NULL;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT_PTR_NONNULL(mkdtemp(dir), cleanup, "Failed to create temp dir");
+   pgmoneta_snprintf(path, MAX_PATH, "%s/backup_manifest", dir);
+   pgmoneta_snprintf(rewritten, MAX_PATH, "%s/backup_manifest.new", dir);
+
+   pgmoneta_json_create(&manifest);
+   pgmoneta_json_put(manifest, "PostgreSQL-Backup-Manifest-Version", 1, ValueInt32);
+
+   pgmoneta_json_create(&files);
+   put_file(files, "global/pg_control", 8192, "cccc");
+   put_file(files, "base/1/INCREMENTAL.1260", 100, "eeee");
+   put_file(files, "PG_VERSION", 3, "aaaa");
+   put_file(files, "base/1/1259", 81920, "bbbb");
+   pgmoneta_json_put(manifest, "Files", (uintptr_t)files, ValueJSON);
+
+   pgmoneta_json_create(&ranges);
+   pgmoneta_json_create(&range);
+   pgmoneta_json_put(range, "Timeline", 1, ValueInt32);
+   pgmoneta_json_put(range, "Start-LSN", (uintptr_t)"0/2000028", ValueString);
+   pgmoneta_json_put(range, "End-LSN", (uintptr_t)"0/2000100", ValueString);
+   pgmoneta_json_append(ranges, (uintptr_t)range, ValueJSON);
+   pgmoneta_json_put(manifest, "WAL-Ranges", (uintptr_t)ranges, ValueJSON);
+
+   MCTF_ASSERT(!pgmoneta_write_postgresql_manifest(manifest, path), cleanup, "Write manifest failed");
+
+   // replace the incremental entry with its reconstructed file
+   pgmoneta_json_create(&extra);
+   put_file(extra, "base/1/1260", 8192, "ffff");
+   MCTF_ASSERT(!pgmoneta_manifest_rewrite(path, extra, pgmoneta_is_incremental_path, rewritten), cleanup, "Rewrite manifest failed");
+
+   MCTF_ASSERT(!pgmoneta_manifest_iterator_create(rewritten, &iter), cleanup, "Iterator creation failed");
+   while (pgmoneta_manifest_iterator_next(iter))
+   {
+      MCTF_ASSERT(count < 4, cleanup, "Too many files");
+      MCTF_ASSERT_STR_EQ(iter->path, expected[count], cleanup, "Source entries should come first, in their order");
+      count++;
+   }
+   MCTF_ASSERT_INT_EQ(count, 4, cleanup, "Should iterate 4 files");
+
+cleanup:
+   pgmoneta_manifest_iterator_destroy(iter);
+   pgmoneta_json_destroy(manifest);
+   pgmoneta_json_destroy(extra);
+   pgmoneta_delete_directory(dir);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_manifest_convert)
+{
+   char dir[] = "/tmp/test_manifest_XXXXXX";
+   char source[MAX_PATH] = {0};
+   char whole[MAX_PATH] = {0};
+   char runs[MAX_PATH] = {0};
+   char run[MAX_PATH] = {0};
+   char entry[128];
+   char* text = NULL;
+   int count = 0;
+   int counts[3] = {0, 0, 0};
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT_PTR_NONNULL(mkdtemp(dir), cleanup, "Failed to create temp dir");
+   pgmoneta_snprintf(source, MAX_PATH, "%s/backup_manifest", dir);
+   pgmoneta_snprintf(whole, MAX_PATH, "%s/whole.manifest", dir);
+   pgmoneta_snprintf(runs, MAX_PATH, "%s/runs.manifest", dir);
+   pgmoneta_snprintf(run, MAX_PATH, "%s.0", runs);
+
+   // PostgreSQL doesn't sort the entries of its manifests
+   text = pgmoneta_append(text, "{ \"PostgreSQL-Backup-Manifest-Version\": 1,\n\"Files\": [\n");
+   for (int i = 0; i < 10; i++)
+   {
+      pgmoneta_snprintf(entry, sizeof(entry), "%s{ \"Path\": \"base/1/%d\", \"Size\": 8192, \"Checksum\": \"c%d\" }\n",
+                        i == 0 ? "" : ",", (i * 7) % 10, i);
+      text = pgmoneta_append(text, entry);
+   }
+   text = pgmoneta_append(text, "],\n\"WAL-Ranges\": [] }\n");
+   MCTF_ASSERT(!write_text(source, text), cleanup, "Failed to write manifest");
+
+   MCTF_ASSERT(!pgmoneta_manifest_convert(source, whole, 0), cleanup, "Convert in memory failed");
+   MCTF_ASSERT(!pgmoneta_manifest_convert(source, runs, 3), cleanup, "Convert in runs failed");
+   MCTF_ASSERT(access(run, F_OK) != 0, cleanup, "Runs should be removed");
+
+   MCTF_ASSERT(!pgmoneta_manifest_count_files(runs, &count), cleanup, "Count files failed");
+   MCTF_ASSERT_INT_EQ(count, 10, cleanup, "Should convert 10 files");
+
+   // the merge diff rejects unsorted input
+   MCTF_ASSERT(!pgmoneta_manifest_merge_diff(whole, runs, count_diff, counts), cleanup, "Outputs should be sorted");
+   MCTF_ASSERT_INT_EQ(counts[ManifestDeleted] + counts[ManifestChanged] + counts[ManifestAdded], 0, cleanup, "Outputs should be equal");
+
+cleanup:
+   free(text);
+   pgmoneta_delete_directory(dir);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <pgmoneta.h>
+#include <deque.h>
+#include <memory.h>
+#include <message.h>
+#include <tscommon.h>
+#include <mctf.h>
+#include <utils.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void*
+memory_message_thread(void* arg)
+{
+   struct message** m = (struct message**)arg;
+
+   *m = pgmoneta_memory_message();
+   if (*m != NULL)
+   {
+      (*m)->kind = 'T';
+   }
+   pgmoneta_memory_destroy();
+
+   return NULL;
+}
+
+#define ARENA_THREADS 4
+#define ARENA_OFFERS  10000
+
+static void*
+memory_arena_thread(void* arg)
+{
+   struct deque* deque = (struct deque*)arg;
+   char tag[32];
+
+   for (int i = 0; i < ARENA_OFFERS; i++)
+   {
+      snprintf(tag, sizeof(tag), "tag-%d", i % 100);
+      if (pgmoneta_deque_add(deque, tag, (uintptr_t)"value", ValueString))
+      {
+         break;
+      }
+   }
+
+   return NULL;
+}
+
+MCTF_TEST(test_memory_message_thread)
+{
+   pthread_t thread;
+   struct message* own = NULL;
+   struct message* other = NULL;
+
+   pgmoneta_test_setup();
+
+   pgmoneta_memory_init();
+   own = pgmoneta_memory_message();
+   MCTF_ASSERT_PTR_NONNULL(own, cleanup, "no message");
+   own->kind = 'M';
+
+   /* A thread reading a connection gets a message buffer of its own */
+   MCTF_ASSERT(pthread_create(&thread, NULL, memory_message_thread, &other) == 0, cleanup, "thread failed");
+   pthread_join(thread, NULL);
+
+   MCTF_ASSERT_PTR_NONNULL(other, cleanup, "no message in the thread");
+   MCTF_ASSERT(other != own, cleanup, "message shared between threads");
+   MCTF_ASSERT(own->kind == 'M', cleanup, "message changed by the thread");
+   MCTF_ASSERT(pgmoneta_memory_message() == own, cleanup, "message of the thread changed");
+
+cleanup:
+   pgmoneta_memory_destroy();
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_memory_buffer_acquire)
+{
+   void* b1 = NULL;
+   void* b2 = NULL;
+   struct memory_buffer_statistics before;
+   struct memory_buffer_statistics after;
+
+   pgmoneta_test_setup();
+
+   b1 = pgmoneta_memory_buffer_acquire(1000);
+   MCTF_ASSERT_PTR_NONNULL(b1, cleanup, "acquire failed");
+   MCTF_ASSERT(pgmoneta_memory_buffer_capacity(b1) >= 1000, cleanup, "capacity too small");
+   MCTF_ASSERT(((uintptr_t)b1 % (uintptr_t)sysconf(_SC_PAGESIZE)) == 0, cleanup, "buffer not page aligned");
+   memset(b1, 'a', pgmoneta_memory_buffer_capacity(b1));
+
+   pgmoneta_memory_buffer_release(b1);
+   pgmoneta_memory_buffer_statistics(&before);
+
+   /* The same size class comes back from the thread cache */
+   b2 = pgmoneta_memory_buffer_acquire(2000);
+   MCTF_ASSERT_PTR_NONNULL(b2, cleanup, "acquire failed");
+   pgmoneta_memory_buffer_statistics(&after);
+   MCTF_ASSERT(b2 == b1, cleanup, "buffer was not reused");
+   MCTF_ASSERT(after.hits == before.hits + 1, cleanup, "hit not counted");
+   MCTF_ASSERT(after.misses == before.misses, cleanup, "unexpected miss");
+
+cleanup:
+   pgmoneta_memory_buffer_release(b2);
+   pgmoneta_memory_buffer_trim();
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_memory_buffer_resize)
+{
+   char* b = NULL;
+   char* r = NULL;
+
+   pgmoneta_test_setup();
+
+   b = (char*)pgmoneta_memory_buffer_acquire(100);
+   MCTF_ASSERT_PTR_NONNULL(b, cleanup, "acquire failed");
+   memcpy(b, "pgmoneta", 9);
+
+   /* Fits in the current capacity */
+   r = (char*)pgmoneta_memory_buffer_resize(b, 200);
+   MCTF_ASSERT(r == b, cleanup, "resize within capacity moved the buffer");
+
+   r = (char*)pgmoneta_memory_buffer_resize(b, 3 * 1024 * 1024);
+   MCTF_ASSERT_PTR_NONNULL(r, cleanup, "resize failed");
+   b = r;
+   MCTF_ASSERT(pgmoneta_memory_buffer_capacity(b) >= 3 * 1024 * 1024, cleanup, "capacity too small");
+   MCTF_ASSERT_STR_EQ(b, "pgmoneta", cleanup, "content lost");
+
+cleanup:
+   pgmoneta_memory_buffer_release(b);
+   pgmoneta_memory_buffer_trim();
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_memory_buffer_trim)
+{
+   void* b = NULL;
+   struct memory_buffer_statistics before;
+   struct memory_buffer_statistics after;
+
+   pgmoneta_test_setup();
+
+   pgmoneta_memory_buffer_trim();
+   pgmoneta_memory_buffer_statistics(&before);
+
+   /* Larger than the largest size class */
+   b = pgmoneta_memory_buffer_acquire(32 * 1024 * 1024);
+   MCTF_ASSERT_PTR_NONNULL(b, cleanup, "acquire failed");
+   pgmoneta_memory_buffer_release(b);
+   b = NULL;
+
+   b = pgmoneta_memory_buffer_acquire(64 * 1024);
+   MCTF_ASSERT_PTR_NONNULL(b, cleanup, "acquire failed");
+   pgmoneta_memory_buffer_release(b);
+   b = NULL;
+
+   pgmoneta_memory_buffer_trim();
+   pgmoneta_memory_buffer_statistics(&after);
+
+   MCTF_ASSERT(after.misses == before.misses + 2, cleanup, "both buffers should be mapped");
+   MCTF_ASSERT(after.mapped == before.mapped, cleanup, "trim should unmap the cached buffers");
+   MCTF_ASSERT(after.in_use == before.in_use, cleanup, "buffers still in use");
+
+cleanup:
+   pgmoneta_memory_buffer_release(b);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_memory_arena_threads)
+{
+   struct memory_arena* arena = NULL;
+   struct deque* deques[2] = {NULL, NULL};
+   pthread_t threads[ARENA_THREADS];
+   int started = 0;
+
+   pgmoneta_test_setup();
+
+   MCTF_ASSERT(!pgmoneta_memory_arena_create(0, &arena), cleanup, "arena creation failed");
+   MCTF_ASSERT(!arena->shared, cleanup, "a new arena should not be shared");
+   MCTF_ASSERT(!pgmoneta_deque_create_with_arena(true, arena, &deques[0]), cleanup, "deque creation failed");
+   MCTF_ASSERT(!pgmoneta_deque_create_with_arena(true, arena, &deques[1]), cleanup, "deque creation failed");
+   MCTF_ASSERT(arena->shared, cleanup, "a thread safe deque should share the arena");
+
+   /* Each deque locks on its own, so the arena they share has to serialize the allocations */
+   for (started = 0; started < ARENA_THREADS; started++)
+   {
+      if (pthread_create(&threads[started], NULL, memory_arena_thread, deques[started % 2]))
+      {
+         break;
+      }
+   }
+   for (int i = 0; i < started; i++)
+   {
+      pthread_join(threads[i], NULL);
+   }
+
+   MCTF_ASSERT_INT_EQ(started, ARENA_THREADS, cleanup, "thread failed");
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_deque_size(deques[0]), ARENA_THREADS / 2 * ARENA_OFFERS, cleanup, "deque size mismatch");
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_deque_size(deques[1]), ARENA_THREADS / 2 * ARENA_OFFERS, cleanup, "deque size mismatch");
+   MCTF_ASSERT(arena->allocated <= arena->reserved, cleanup, "arena accounting mismatch");
+
+cleanup:
+   pgmoneta_deque_destroy(deques[0]);
+   pgmoneta_deque_destroy(deques[1]);
+   pgmoneta_memory_arena_destroy(arena);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pgmoneta.h>
+#include <json.h>
+#include <management.h>
+#include <mctf.h>
+#include <scheduler.h>
+#include <shmem.h>
+#include <tscommon.h>
+#include <utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool shmem_allocated = false;
+static char base_dir[] = "/tmp/pgmoneta_test_scheduler_XXXXXX";
+
+static int setup_servers(void);
+static int enqueue(int server, char* incremental);
+
+MCTF_MODULE_SETUP(scheduler)
+{
+   if (shmem == NULL)
+   {
+      pgmoneta_create_shared_memory(sizeof(struct main_configuration), HUGEPAGE_OFF, &shmem);
+      memset(shmem, 0, sizeof(struct main_configuration));
+      shmem_allocated = true;
+   }
+}
+
+MCTF_MODULE_TEARDOWN(scheduler)
+{
+   if (shmem_allocated && shmem != NULL)
+   {
+      pgmoneta_destroy_shared_memory(shmem, sizeof(struct main_configuration));
+      shmem = NULL;
+      shmem_allocated = false;
+   }
+}
+
+MCTF_TEST_SETUP(scheduler)
+{
+   pgmoneta_test_config_save();
+   pgmoneta_memory_init();
+}
+
+MCTF_TEST_TEARDOWN(scheduler)
+{
+   pgmoneta_scheduler_destroy();
+   pgmoneta_memory_destroy();
+   pgmoneta_test_config_restore();
+}
+
+MCTF_TEST(test_scheduler_priority_order)
+{
+   struct scheduler_job* job = NULL;
+   struct main_configuration* config;
+
+   MCTF_ASSERT_INT_EQ(setup_servers(), 0, cleanup, "setup failed");
+   config = (struct main_configuration*)shmem;
+   config->common.servers[1].backup_priority = 5;
+
+   MCTF_ASSERT_INT_EQ(enqueue(0, NULL), 0, cleanup, "enqueue 0 failed");
+   MCTF_ASSERT_INT_EQ(enqueue(1, NULL), 0, cleanup, "enqueue 1 failed");
+   MCTF_ASSERT_INT_EQ(enqueue(2, NULL), 0, cleanup, "enqueue 2 failed");
+   MCTF_ASSERT_INT_EQ(enqueue(0, NULL), 0, cleanup, "enqueue 0 again failed");
+   MCTF_ASSERT_INT_EQ(atomic_load(&config->common.servers[0].scheduler.queued), 2, cleanup, "server 0 queue depth");
+
+   job = pgmoneta_scheduler_next();
+   MCTF_ASSERT_PTR_NONNULL(job, cleanup, "no first job");
+   MCTF_ASSERT_INT_EQ(job->server, 1, cleanup, "higher priority should start first");
+   pgmoneta_scheduler_start(job, 1001);
+
+   job = pgmoneta_scheduler_next();
+   MCTF_ASSERT_PTR_NONNULL(job, cleanup, "no second job");
+   MCTF_ASSERT_INT_EQ(job->server, 0, cleanup, "oldest job should start second");
+   pgmoneta_scheduler_start(job, 1002);
+
+   job = pgmoneta_scheduler_next();
+   MCTF_ASSERT_PTR_NONNULL(job, cleanup, "no third job");
+   MCTF_ASSERT_INT_EQ(job->server, 2, cleanup, "server 2 should start third");
+   pgmoneta_scheduler_start(job, 1003);
+
+   /* The second backup of server 0 waits for the first one */
+   MCTF_ASSERT_PTR_NULL(pgmoneta_scheduler_next(), cleanup, "server 0 is busy");
+
+   MCTF_ASSERT(pgmoneta_scheduler_finish(1002), cleanup, "finish 1002");
+   MCTF_ASSERT(!pgmoneta_scheduler_finish(4242), cleanup, "unknown process");
+
+   job = pgmoneta_scheduler_next();
+   MCTF_ASSERT_PTR_NONNULL(job, cleanup, "no fourth job");
+   MCTF_ASSERT_INT_EQ(job->server, 0, cleanup, "server 0 should start again");
+   pgmoneta_scheduler_start(job, 1004);
+
+   MCTF_ASSERT_INT_EQ(atomic_load(&config->common.servers[0].scheduler.queued), 0, cleanup, "server 0 queue depth");
+   MCTF_ASSERT_INT_EQ(atomic_load(&config->common.servers[0].scheduler.dispatched), 2, cleanup, "server 0 started");
+
+cleanup:
+   pgmoneta_delete_directory(base_dir);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_scheduler_limits)
+{
+   struct scheduler_job* job = NULL;
+   struct main_configuration* config;
+
+   MCTF_ASSERT_INT_EQ(setup_servers(), 0, cleanup, "setup failed");
+   config = (struct main_configuration*)shmem;
+
+   for (int i = 0; i < 3; i++)
+   {
+      MCTF_ASSERT_INT_EQ(enqueue(i, NULL), 0, cleanup, "enqueue failed");
+   }
+
+   /* All servers share the volume of base_dir */
+   config->backup_max_per_volume = 2;
+
+   for (int i = 0; i < 2; i++)
+   {
+      job = pgmoneta_scheduler_next();
+      MCTF_ASSERT_PTR_NONNULL(job, cleanup, "job expected within the volume limit");
+      pgmoneta_scheduler_start(job, 2000 + i);
+   }
+   MCTF_ASSERT_PTR_NULL(pgmoneta_scheduler_next(), cleanup, "volume limit reached");
+
+   config->backup_max_per_volume = 0;
+   config->backup_max_concurrent = 2;
+   MCTF_ASSERT_PTR_NULL(pgmoneta_scheduler_next(), cleanup, "global limit reached");
+
+   config->backup_max_concurrent = 3;
+   MCTF_ASSERT_PTR_NONNULL(pgmoneta_scheduler_next(), cleanup, "job expected within the global limit");
+
+   /* An offline or busy server keeps its backup queued */
+   config->common.servers[2].online = false;
+   MCTF_ASSERT_PTR_NULL(pgmoneta_scheduler_next(), cleanup, "server 2 is offline");
+
+   config->common.servers[2].online = true;
+   atomic_store(&config->common.servers[2].repository, true);
+   MCTF_ASSERT_PTR_NULL(pgmoneta_scheduler_next(), cleanup, "server 2 is busy");
+
+cleanup:
+   pgmoneta_delete_directory(base_dir);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_scheduler_persistence)
+{
+   struct scheduler_job* job = NULL;
+   struct json* request = NULL;
+   struct main_configuration* config;
+
+   MCTF_ASSERT_INT_EQ(setup_servers(), 0, cleanup, "setup failed");
+   config = (struct main_configuration*)shmem;
+
+   MCTF_ASSERT_INT_EQ(enqueue(2, "auto"), 0, cleanup, "enqueue 2 failed");
+   MCTF_ASSERT_INT_EQ(enqueue(0, NULL), 0, cleanup, "enqueue 0 failed");
+
+   /* A restart loses the queue in memory, but not on disk */
+   pgmoneta_scheduler_destroy();
+   atomic_store(&config->common.servers[0].scheduler.queued, 0);
+   atomic_store(&config->common.servers[2].scheduler.queued, 0);
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_scheduler_load(), 0, cleanup, "load failed");
+   MCTF_ASSERT_INT_EQ(atomic_load(&config->common.servers[2].scheduler.queued), 1, cleanup, "server 2 not queued");
+
+   job = pgmoneta_scheduler_next();
+   MCTF_ASSERT_PTR_NONNULL(job, cleanup, "no job after load");
+   MCTF_ASSERT_INT_EQ(job->server, 2, cleanup, "arrival order lost");
+   MCTF_ASSERT_INT_EQ(job->client_fd, -1, cleanup, "loaded job has a client");
+
+   request = (struct json*)pgmoneta_json_get(job->payload, MANAGEMENT_CATEGORY_REQUEST);
+   MCTF_ASSERT_STR_EQ((char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_SERVER), "c", cleanup, "server name lost");
+   MCTF_ASSERT_STR_EQ((char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_BACKUP), "auto", cleanup, "identifier lost");
+
+   pgmoneta_scheduler_start(job, 3001);
+   MCTF_ASSERT(pgmoneta_scheduler_finish(3001), cleanup, "finish 3001");
+
+   job = pgmoneta_scheduler_next();
+   MCTF_ASSERT_PTR_NONNULL(job, cleanup, "second job lost");
+   MCTF_ASSERT_INT_EQ(job->server, 0, cleanup, "second job server");
+   request = (struct json*)pgmoneta_json_get(job->payload, MANAGEMENT_CATEGORY_REQUEST);
+   MCTF_ASSERT_PTR_NULL((char*)pgmoneta_json_get(request, MANAGEMENT_ARGUMENT_BACKUP), cleanup, "full backup has an identifier");
+
+cleanup:
+   pgmoneta_delete_directory(base_dir);
+   MCTF_FINISH();
+}
+
+static int
+setup_servers(void)
+{
+   char* names[] = {"a", "b", "c"};
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   memcpy(base_dir + strlen(base_dir) - 6, "XXXXXX", 6);
+   if (mkdtemp(base_dir) == NULL)
+   {
+      return 1;
+   }
+
+   memset(config->base_dir, 0, sizeof(config->base_dir));
+   memcpy(config->base_dir, base_dir, strlen(base_dir));
+
+   config->backup_max_concurrent = 0;
+   config->backup_max_per_volume = 0;
+   config->common.number_of_servers = 3;
+
+   for (int i = 0; i < 3; i++)
+   {
+      memset(&config->common.servers[i].name, 0, MISC_LENGTH);
+      memcpy(&config->common.servers[i].name, names[i], strlen(names[i]));
+      config->common.servers[i].online = true;
+      config->common.servers[i].backup_priority = 0;
+      atomic_store(&config->common.servers[i].repository, false);
+      atomic_store(&config->common.servers[i].scheduler.queued, 0);
+      atomic_store(&config->common.servers[i].scheduler.dispatched, 0);
+      atomic_store(&config->common.servers[i].scheduler.wait, 0);
+   }
+
+   return 0;
+}
+
+static int
+enqueue(int server, char* incremental)
+{
+   int ret = 1;
+   struct json* payload = NULL;
+   struct json* request = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (pgmoneta_management_create_header(MANAGEMENT_BACKUP, MANAGEMENT_COMPRESSION_NONE, MANAGEMENT_ENCRYPTION_NONE,
+                                         MANAGEMENT_OUTPUT_FORMAT_JSON, &payload))
+   {
+      goto done;
+   }
+
+   if (pgmoneta_management_create_request(payload, &request))
+   {
+      goto done;
+   }
+
+   pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_SERVER, (uintptr_t)config->common.servers[server].name, ValueString);
+   if (incremental != NULL)
+   {
+      pgmoneta_json_put(request, MANAGEMENT_ARGUMENT_BACKUP, (uintptr_t)incremental, ValueString);
+   }
+
+   ret = pgmoneta_scheduler_enqueue(server, -1, MANAGEMENT_COMPRESSION_NONE, MANAGEMENT_ENCRYPTION_NONE, payload);
+
+done:
+   pgmoneta_json_destroy(payload);
+
+   return ret;
+}
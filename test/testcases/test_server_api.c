@@ -28,11 +28,13 @@
  */
 
 #include <pgmoneta.h>
+#include <message.h>
 #include <network.h>
 #include <security.h>
 #include <server.h>
 #include <tscommon.h>
 #include <mctf.h>
+#include <utils.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -90,19 +92,27 @@ cleanup:
 
 MCTF_TEST(test_server_api_read_file)
 {
-   uint8_t* data = NULL;
-   int data_length;
+   uint8_t data[100];
+   int64_t data_length = 0;
    char file_path[] = "postgresql.conf";
 
    MCTF_ASSERT(setup_server_connection() == 0, cleanup, "failed to setup server connection - check authentication and server configuration");
 
-   if (pgmoneta_server_read_binary_file(PRIMARY_SERVER, srv_ssl, file_path, 0, 100, srv_socket, &data, &data_length))
+   MCTF_ASSERT(pgmoneta_server_prepare_read_binary_file(PRIMARY_SERVER, srv_ssl, srv_socket) == 0, cleanup, "failed to prepare reading binary files");
+
+   if (pgmoneta_server_read_binary_file(PRIMARY_SERVER, srv_ssl, file_path, 0, sizeof(data), srv_socket, &data[0], &data_length))
    {
       MCTF_ASSERT(false, cleanup, "failed to read binary file");
    }
 
+   MCTF_ASSERT(data_length > 0 && data_length <= (int64_t)sizeof(data), cleanup, "unexpected length of binary file chunk");
+
+   /* An offset past 4GB is beyond the end of the file */
+   MCTF_ASSERT(pgmoneta_server_read_binary_file(PRIMARY_SERVER, srv_ssl, file_path, 5368709120LL, sizeof(data), srv_socket, &data[0], &data_length) == 0,
+               cleanup, "failed to read binary file with a 64-bit offset");
+   MCTF_ASSERT(data_length == 0, cleanup, "expected no data beyond the end of the file");
+
 cleanup:
-   free(data);
    teardown_server_connection();
    MCTF_FINISH();
 }
@@ -164,6 +174,38 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_server_api_bind_execute_binary)
+{
+   struct message* msg = NULL;
+   char bytea[] = {'p', 'g', 0, 'm', 0, 'o'};
+   char* parameters[2] = {&bytea[0], NULL};
+   int32_t lengths[2] = {sizeof(bytea), 0};
+   int32_t bind = 0;
+   char* data = NULL;
+
+   MCTF_ASSERT(pgmoneta_create_bind_execute_binary_message(READ_BINARY_FILE_STATEMENT, 2, parameters, lengths, true, &msg) == MESSAGE_STATUS_OK,
+               cleanup, "failed to create the bind message");
+
+   data = (char*)msg->data;
+   bind = pgmoneta_read_int32(data + 1);
+
+   /* Bind: the length covers portal, statement, 5 int16 fields and the parameters */
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_byte(data), 'B', cleanup, "expected a Bind message");
+   MCTF_ASSERT_INT_EQ(bind, (int32_t)(4 + 1 + strlen(READ_BINARY_FILE_STATEMENT) + 1 + 5 * 2 + 4 + sizeof(bytea) + 4), cleanup, "Bind length mismatch");
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_int16(data + 1 + bind - 4), 1, cleanup, "expected one result format");
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_int16(data + 1 + bind - 2), 1, cleanup, "expected binary results");
+
+   /* Execute and Sync follow right after the Bind and end the message */
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_byte(data + 1 + bind), 'E', cleanup, "expected an Execute message");
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_int32(data + 1 + bind + 1), 9, cleanup, "Execute length mismatch");
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_byte(data + 1 + bind + 10), 'S', cleanup, "expected a Sync message");
+   MCTF_ASSERT_INT_EQ((int)msg->length, 1 + bind + 10 + 5, cleanup, "message length mismatch");
+
+cleanup:
+   pgmoneta_free_message(msg);
+   MCTF_FINISH();
+}
+
 static int
 setup_server_connection(void)
 {
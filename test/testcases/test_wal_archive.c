@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2026 The pgmoneta community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pgmoneta.h>
+#include <mctf.h>
+#include <shmem.h>
+#include <tscommon.h>
+#include <utils.h>
+#include <walarchive.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static bool shmem_allocated = false;
+static char base_dir[] = "/tmp/pgmoneta_test_wal_archive_XXXXXX";
+
+static int setup_server(void);
+static int create_file(char* directory, char* name, size_t size);
+
+MCTF_MODULE_SETUP(wal_archive)
+{
+   if (shmem == NULL)
+   {
+      pgmoneta_create_shared_memory(sizeof(struct main_configuration), HUGEPAGE_OFF, &shmem);
+      memset(shmem, 0, sizeof(struct main_configuration));
+      shmem_allocated = true;
+   }
+}
+
+MCTF_MODULE_TEARDOWN(wal_archive)
+{
+   if (shmem_allocated && shmem != NULL)
+   {
+      pgmoneta_destroy_shared_memory(shmem, sizeof(struct main_configuration));
+      shmem = NULL;
+      shmem_allocated = false;
+   }
+}
+
+MCTF_TEST_SETUP(wal_archive)
+{
+   pgmoneta_test_config_save();
+}
+
+MCTF_TEST_TEARDOWN(wal_archive)
+{
+   pgmoneta_delete_directory(base_dir);
+   pgmoneta_test_config_restore();
+}
+
+MCTF_TEST(test_wal_archive_cursor)
+{
+   struct wal_archive_cursor cursor;
+
+   MCTF_ASSERT_INT_EQ(setup_server(), 0, cleanup, "setup failed");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_read_cursor(0, &cursor), 0, cleanup, "read of a missing cursor failed");
+   MCTF_ASSERT_INT_EQ((int)strlen(cursor.segment), 0, cleanup, "missing cursor should be empty");
+
+   memset(&cursor, 0, sizeof(cursor));
+   pgmoneta_snprintf(cursor.segment, sizeof(cursor.segment), "%s", "000000010000000000000007");
+   cursor.updated = 1700000000;
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_write_cursor(0, &cursor), 0, cleanup, "write failed");
+
+   memset(&cursor, 0, sizeof(cursor));
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_read_cursor(0, &cursor), 0, cleanup, "read failed");
+   MCTF_ASSERT_STR_EQ(cursor.segment, "000000010000000000000007", cleanup, "segment mismatch");
+   MCTF_ASSERT(cursor.updated == 1700000000, cleanup, "updated mismatch");
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_wal_archive_lag)
+{
+   char* wal = NULL;
+   uint64_t seconds = 0;
+   uint64_t bytes = 0;
+   struct wal_archive_cursor cursor;
+
+   MCTF_ASSERT_INT_EQ(setup_server(), 0, cleanup, "setup failed");
+
+   wal = pgmoneta_get_server_wal(0);
+   MCTF_ASSERT_INT_EQ(create_file(wal, "000000010000000000000001.zstd", 100), 0, cleanup, "create 1 failed");
+   MCTF_ASSERT_INT_EQ(create_file(wal, "000000010000000000000002.zstd", 200), 0, cleanup, "create 2 failed");
+   MCTF_ASSERT_INT_EQ(create_file(wal, "000000010000000000000003", 300), 0, cleanup, "create 3 failed");
+   MCTF_ASSERT_INT_EQ(create_file(wal, "000000010000000000000004.partial", 400), 0, cleanup, "create 4 failed");
+
+   /* Nothing archived yet */
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_lag(0, &seconds, &bytes), 0, cleanup, "lag failed");
+   MCTF_ASSERT(bytes == 600, cleanup, "all finished segments should lag");
+   MCTF_ASSERT(!pgmoneta_wal_archive_is_archived(0, "000000010000000000000001.zstd"), cleanup, "1 is not archived");
+
+   memset(&cursor, 0, sizeof(cursor));
+   pgmoneta_snprintf(cursor.segment, sizeof(cursor.segment), "%s", "000000010000000000000001");
+   cursor.updated = time(NULL);
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_write_cursor(0, &cursor), 0, cleanup, "write failed");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_lag(0, &seconds, &bytes), 0, cleanup, "lag failed");
+   MCTF_ASSERT(bytes == 500, cleanup, "segments after the cursor should lag");
+   MCTF_ASSERT(pgmoneta_wal_archive_is_archived(0, "000000010000000000000001.zstd"), cleanup, "1 is archived");
+   MCTF_ASSERT(!pgmoneta_wal_archive_is_archived(0, "000000010000000000000002.zstd"), cleanup, "2 is not archived");
+
+   /* Without the archive all WAL counts as archived */
+   ((struct main_configuration*)shmem)->wal_archive = PGMONETA_TIME_DISABLED;
+   MCTF_ASSERT(pgmoneta_wal_archive_is_archived(0, "000000010000000000000002.zstd"), cleanup, "disabled archive");
+   MCTF_ASSERT_INT_EQ(pgmoneta_wal_archive_lag(0, &seconds, &bytes), 0, cleanup, "lag failed");
+   MCTF_ASSERT(bytes == 0 && seconds == 0, cleanup, "disabled archive has no lag");
+
+cleanup:
+   free(wal);
+   MCTF_FINISH();
+}
+
+static int
+setup_server(void)
+{
+   char* wal = NULL;
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   memcpy(base_dir + strlen(base_dir) - 6, "XXXXXX", 6);
+   if (mkdtemp(base_dir) == NULL)
+   {
+      return 1;
+   }
+
+   memset(config->base_dir, 0, sizeof(config->base_dir));
+   memcpy(config->base_dir, base_dir, strlen(base_dir));
+
+   config->storage_engine = STORAGE_ENGINE_LOCAL | STORAGE_ENGINE_S3;
+   config->wal_archive = PGMONETA_TIME_SEC(60);
+   config->common.number_of_servers = 1;
+
+   memset(&config->common.servers[0].name, 0, MISC_LENGTH);
+   memcpy(&config->common.servers[0].name, "primary", strlen("primary"));
+   atomic_store(&config->common.servers[0].wal_archive, false);
+
+   wal = pgmoneta_get_server_wal(0);
+   if (pgmoneta_mkdir(wal))
+   {
+      free(wal);
+      return 1;
+   }
+
+   free(wal);
+
+   return 0;
+}
+
+static int
+create_file(char* directory, char* name, size_t size)
+{
+   char path[MAX_PATH];
+   FILE* file = NULL;
+
+   pgmoneta_snprintf(path, sizeof(path), "%s%s", directory, name);
+
+   file = fopen(path, "w");
+   if (file == NULL)
+   {
+      return 1;
+   }
+
+   for (size_t i = 0; i < size; i++)
+   {
+      fputc('x', file);
+   }
+
+   fclose(file);
+
+   return 0;
+}
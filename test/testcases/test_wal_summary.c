@@ -81,6 +81,35 @@ MCTF_MODULE_TEARDOWN(wal_summary)
    }
 }
 
+MCTF_TEST(test_pgmoneta_wal_summarizer_exited)
+{
+   struct main_configuration* config = NULL;
+
+   pgmoneta_test_setup();
+   pgmoneta_test_config_save();
+
+   config = (struct main_configuration*)shmem;
+   MCTF_ASSERT_PTR_NONNULL(config, cleanup, "configuration is null");
+   MCTF_ASSERT(config->common.number_of_servers > PRIMARY_SERVER, cleanup, "primary server not configured");
+
+   atomic_store(&config->common.servers[PRIMARY_SERVER].wal_summarizer, true);
+   config->common.servers[PRIMARY_SERVER].wal_summarizer_pid = 12345;
+
+   // another child leaves the lock alone
+   pgmoneta_wal_summarizer_exited(12346);
+   MCTF_ASSERT(atomic_load(&config->common.servers[PRIMARY_SERVER].wal_summarizer), cleanup, "lock released by another child");
+
+   // a summarizer that didn't exit normally still releases it
+   pgmoneta_wal_summarizer_exited(12345);
+   MCTF_ASSERT(!atomic_load(&config->common.servers[PRIMARY_SERVER].wal_summarizer), cleanup, "lock not released");
+   MCTF_ASSERT_INT_EQ(config->common.servers[PRIMARY_SERVER].wal_summarizer_pid, -1, cleanup, "pid not cleared");
+
+cleanup:
+   pgmoneta_test_config_restore();
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
 MCTF_TEST(test_pgmoneta_wal_summary)
 {
    char* summary_dir = NULL;
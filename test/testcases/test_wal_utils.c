@@ -39,6 +39,7 @@
 #include <tswalutils.h>
 #include <utils.h>
 #include <value.h>
+#include <wal.h>
 #include <walfile.h>
 #include <mctf.h>
 
@@ -62,6 +63,7 @@ static int compare_deque(struct deque* dq1, struct deque* dq2, int (*compare)(vo
 static int compare_xlog_page_header(void* a, void* b);
 static int compare_xlog_record(void* a, void* b);
 static void destroy_walfile(struct walfile* wf);
+static int create_restore_plan_wal(char* base_dir, char* name);
 
 static bool shmem_allocated = false;
 
@@ -173,6 +175,203 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_xid_timestamp_map)
+{
+   struct xid_timestamp_map* map = NULL;
+   struct xid_timestamp_entry* entries = NULL;
+   size_t count = 0;
+   timestamp_tz ts = 0;
+
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_create(&map), cleanup, "failed to create map");
+
+   /* Enough entries to rehash several times; insert in descending order so
+    * sorted iteration has to do real work
+    */
+   for (transaction_id xid = 20000; xid >= 1; xid--)
+   {
+      MCTF_ASSERT(!pgmoneta_xid_timestamp_map_put(map, xid, (timestamp_tz)xid * 10), cleanup, "failed to put XID");
+   }
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_xid_timestamp_map_size(map), (size_t)20000, cleanup, "unexpected map size");
+
+   for (transaction_id xid = 1; xid <= 20000; xid++)
+   {
+      MCTF_ASSERT(!pgmoneta_xid_timestamp_map_get(map, xid, &ts), cleanup, "XID not found");
+      MCTF_ASSERT(ts == (timestamp_tz)xid * 10, cleanup, "wrong timestamp for XID");
+   }
+
+   MCTF_ASSERT(pgmoneta_xid_timestamp_map_get(map, 20001, &ts), cleanup, "unknown XID found");
+   MCTF_ASSERT(pgmoneta_xid_timestamp_map_get(map, INVALID_TRANSACTION_ID, &ts), cleanup, "invalid XID found");
+
+   /* An update replaces the timestamp without adding an entry */
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_put(map, 42, 7), cleanup, "failed to update XID");
+   MCTF_ASSERT_INT_EQ(pgmoneta_xid_timestamp_map_size(map), (size_t)20000, cleanup, "update changed map size");
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_get(map, 42, &ts), cleanup, "updated XID not found");
+   MCTF_ASSERT(ts == 7, cleanup, "update was not applied");
+
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_sorted(map, &entries, &count), cleanup, "failed to sort map");
+   MCTF_ASSERT_INT_EQ(count, (size_t)20000, cleanup, "unexpected sorted count");
+
+   for (size_t i = 0; i < count; i++)
+   {
+      MCTF_ASSERT(entries[i].xid == (transaction_id)(i + 1), cleanup, "entries are not in XID order");
+   }
+
+cleanup:
+   free(entries);
+   pgmoneta_xid_timestamp_map_destroy(map);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_xid_timestamp_map_subxacts)
+{
+   struct xid_timestamp_map* map = NULL;
+   transaction_id subxacts[500];
+   timestamp_tz ts = 0;
+
+   for (int i = 0; i < 500; i++)
+   {
+      subxacts[i] = 1001 + i;
+   }
+
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_create(&map), cleanup, "failed to create map");
+
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_put_all(map, 1000, &subxacts[0], 500, 123456), cleanup, "failed to put transaction");
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_put_all(map, 2000, NULL, 0, 654321), cleanup, "failed to put transaction without subxacts");
+   MCTF_ASSERT(pgmoneta_xid_timestamp_map_put_all(map, INVALID_TRANSACTION_ID, NULL, 0, 1), cleanup, "invalid XID accepted");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_xid_timestamp_map_size(map), (size_t)502, cleanup, "unexpected map size");
+
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_get(map, 1000, &ts), cleanup, "top-level XID not found");
+   MCTF_ASSERT(ts == 123456, cleanup, "wrong timestamp for top-level XID");
+
+   for (int i = 0; i < 500; i++)
+   {
+      MCTF_ASSERT(!pgmoneta_xid_timestamp_map_get(map, subxacts[i], &ts), cleanup, "subXID not found");
+      MCTF_ASSERT(ts == 123456, cleanup, "subXID does not share the commit timestamp");
+   }
+
+   MCTF_ASSERT(!pgmoneta_xid_timestamp_map_get(map, 2000, &ts), cleanup, "XID without subxacts not found");
+   MCTF_ASSERT(ts == 654321, cleanup, "wrong timestamp for XID without subxacts");
+
+cleanup:
+   pgmoneta_xid_timestamp_map_destroy(map);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_wal_restore_plan)
+{
+   char dir[MAX_PATH] = "/tmp/pgmoneta_restore_plan_XXXXXX";
+   char saved_base_dir[MAX_PATH];
+   char saved_name[MISC_LENGTH];
+   int saved_number_of_servers;
+   int saved_wal_size;
+   bool saved = false;
+   struct deque* files = NULL;
+   struct main_configuration* config = NULL;
+
+   config = (struct main_configuration*)shmem;
+
+   MCTF_ASSERT_PTR_NONNULL(config, cleanup, "configuration is not available");
+   MCTF_ASSERT_PTR_NONNULL(mkdtemp(dir), cleanup, "failed to create temp dir");
+
+   memcpy(saved_base_dir, config->base_dir, MAX_PATH);
+   memcpy(saved_name, config->common.servers[0].name, MISC_LENGTH);
+   saved_number_of_servers = config->common.number_of_servers;
+   saved_wal_size = config->common.servers[0].wal_size;
+   saved = true;
+
+   pgmoneta_snprintf(config->base_dir, MAX_PATH, "%s", dir);
+   pgmoneta_snprintf(config->common.servers[0].name, MISC_LENGTH, "%s", "primary");
+   config->common.number_of_servers = MAX(config->common.number_of_servers, 1);
+   config->common.servers[0].wal_size = 16 * 1024 * 1024;
+
+   MCTF_ASSERT(!create_restore_plan_wal(dir, "primary"), cleanup, "failed to create WAL directory");
+
+   /* Latest timeline: timeline 1 up to the switch in segment 3, then timeline 2 */
+   MCTF_ASSERT(!pgmoneta_wal_restore_plan(0, 0x1000000, 0, UINT64_MAX, false, &files), cleanup, "plan for latest timeline failed");
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_deque_size(files), 7, cleanup, "latest timeline plan size mismatch");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "000000010000000000000001"), cleanup, "segment 1/1 missing");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "000000010000000000000003"), cleanup, "segment 1/3 missing");
+   MCTF_ASSERT(!pgmoneta_deque_exists(files, "000000010000000000000004"), cleanup, "segment 1/4 is past the switch");
+   MCTF_ASSERT(!pgmoneta_deque_exists(files, "000000010000000000000005"), cleanup, "segment 1/5 is past the switch");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "000000020000000000000003"), cleanup, "segment 2/3 missing");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "000000020000000000000006"), cleanup, "segment 2/6 missing");
+   MCTF_ASSERT(!pgmoneta_deque_exists(files, "00000002.history"), cleanup, "history file not requested");
+   pgmoneta_deque_destroy(files);
+   files = NULL;
+
+   /* Target LSN inside segment 4 of timeline 2 */
+   MCTF_ASSERT(!pgmoneta_wal_restore_plan(0, 0x1000000, 2, 0x4800000, true, &files), cleanup, "plan with target LSN failed");
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_deque_size(files), 6, cleanup, "target LSN plan size mismatch");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "000000020000000000000004"), cleanup, "segment 2/4 missing");
+   MCTF_ASSERT(!pgmoneta_deque_exists(files, "000000020000000000000005"), cleanup, "segment 2/5 is past the target LSN");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "00000002.history"), cleanup, "history file missing");
+   pgmoneta_deque_destroy(files);
+   files = NULL;
+
+   /* Timeline 1 ignores the switch and starts from the start LSN */
+   MCTF_ASSERT(!pgmoneta_wal_restore_plan(0, 0x2000000, 1, UINT64_MAX, false, &files), cleanup, "plan for timeline 1 failed");
+   MCTF_ASSERT_INT_EQ((int)pgmoneta_deque_size(files), 4, cleanup, "timeline 1 plan size mismatch");
+   MCTF_ASSERT(!pgmoneta_deque_exists(files, "000000010000000000000001"), cleanup, "segment 1/1 is before the start LSN");
+   MCTF_ASSERT(pgmoneta_deque_exists(files, "000000010000000000000005"), cleanup, "segment 1/5 missing");
+   MCTF_ASSERT(!pgmoneta_deque_exists(files, "000000020000000000000003"), cleanup, "segment 2/3 is on another timeline");
+
+cleanup:
+   pgmoneta_deque_destroy(files);
+   if (saved)
+   {
+      memcpy(config->base_dir, saved_base_dir, MAX_PATH);
+      memcpy(config->common.servers[0].name, saved_name, MISC_LENGTH);
+      config->common.number_of_servers = saved_number_of_servers;
+      config->common.servers[0].wal_size = saved_wal_size;
+   }
+   pgmoneta_delete_directory(dir);
+   MCTF_FINISH();
+}
+
+static int
+create_restore_plan_wal(char* base_dir, char* name)
+{
+   char path[MAX_PATH];
+   char* segments[] = {
+      "000000010000000000000001", "000000010000000000000002", "000000010000000000000003",
+      "000000010000000000000004", "000000010000000000000005",
+      "000000020000000000000003", "000000020000000000000004", "000000020000000000000005",
+      "000000020000000000000006"
+   };
+   FILE* f = NULL;
+
+   pgmoneta_snprintf(path, MAX_PATH, "%s/%s/wal/", base_dir, name);
+   if (pgmoneta_mkdir(path))
+   {
+      return 1;
+   }
+
+   for (size_t i = 0; i < sizeof(segments) / sizeof(segments[0]); i++)
+   {
+      pgmoneta_snprintf(path, MAX_PATH, "%s/%s/wal/%s", base_dir, name, segments[i]);
+      f = fopen(path, "w");
+      if (f == NULL)
+      {
+         return 1;
+      }
+      fclose(f);
+   }
+
+   /* Timeline 2 switched off timeline 1 in the middle of segment 3 */
+   pgmoneta_snprintf(path, MAX_PATH, "%s/%s/wal/00000002.history", base_dir, name);
+   f = fopen(path, "w");
+   if (f == NULL)
+   {
+      return 1;
+   }
+   fprintf(f, "1\t0/3800000\tno recovery target specified\n");
+   fclose(f);
+
+   return 0;
+}
+
 static int
 compare_walfile(struct walfile* wf1, struct walfile* wf2)
 {
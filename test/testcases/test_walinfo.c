@@ -38,6 +38,7 @@
 #include <tswalinfo.h>
 #include <walfile.h>
 #include <utils.h>
+#include <wal.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -47,6 +48,11 @@
 
 #define WAL_TEST_SUBDIR         "/walfiles"
 
+#define WAL_JOBS_TEST_SUBDIR    "/walfiles_jobs"
+#define WAL_JOBS_SEGMENTS       9
+#define WAL_JOBS_SEGMENT_SIZE   (1024 * 1024)
+#define WAL_JOBS_RECORD_DATA    2000
+
 #define WALINFO_AES_TEST_SUBDIR "/walinfo_aes"
 
 /*
@@ -262,6 +268,158 @@ prepare_wal_test_path(char* path, size_t size)
    return 0;
 }
 
+/**
+ * Write a directory of consecutive WAL segments filled with checkpoint records.
+ * The records are laid out as a continuous stream, so records cross page and
+ * segment boundaries. The last segment is only half filled.
+ * @param dir The directory
+ * @param number_of_segments The number of segments
+ * @param number_of_records [out] The number of records written
+ * @return 0 on success, 1 on failure
+ */
+static int
+create_wal_segments(char* dir, int number_of_segments, int* number_of_records)
+{
+   struct walfile* wf = NULL;
+   struct decoded_xlog_record* rec = NULL;
+   struct xlog_long_page_header_data long_header;
+   struct xlog_page_header_data short_header;
+   char* encoded = NULL;
+   char* segment = NULL;
+   char* main_data = NULL;
+   char path[MAX_PATH];
+   uint32_t length = 0;
+   uint32_t written = 0;
+   uint32_t offset = 0;
+   uint32_t chunk = 0;
+   int segno = 1;
+   int records = 0;
+   FILE* file = NULL;
+   int ret = 1;
+
+   *number_of_records = 0;
+
+   wf = pgmoneta_test_generate_check_point_shutdown_v17();
+   if (wf == NULL || pgmoneta_deque_peek(wf->records, NULL) == 0)
+   {
+      goto cleanup;
+   }
+
+   /* Pad the main data so that a few records fill a page */
+   rec = (struct decoded_xlog_record*)pgmoneta_deque_peek(wf->records, NULL);
+   main_data = calloc(1, WAL_JOBS_RECORD_DATA);
+   if (main_data == NULL)
+   {
+      goto cleanup;
+   }
+   memcpy(main_data, rec->main_data, rec->main_data_len);
+   free(rec->main_data);
+   rec->main_data = main_data;
+   rec->main_data_len = WAL_JOBS_RECORD_DATA;
+
+   encoded = pgmoneta_wal_encode_xlog_record(rec, RANDOM_MAGIC, NULL);
+   if (encoded == NULL)
+   {
+      goto cleanup;
+   }
+   memcpy(&length, encoded + offsetof(struct xlog_record, xl_tot_len), sizeof(uint32_t));
+
+   segment = calloc(1, WAL_JOBS_SEGMENT_SIZE);
+   if (segment == NULL)
+   {
+      goto cleanup;
+   }
+
+   while (segno <= number_of_segments)
+   {
+      if (written == 0)
+      {
+         offset = MAXALIGN(offset);
+         if (segno == number_of_segments && offset >= WAL_JOBS_SEGMENT_SIZE / 2)
+         {
+            break;
+         }
+      }
+
+      if (offset == WAL_JOBS_SEGMENT_SIZE)
+      {
+         pgmoneta_snprintf(path, sizeof(path), "%s/%08X%08X%08X", dir, RANDOM_TLI, 0,
+                           (uint32_t)segno);
+         if (pgmoneta_fopen_secure(path, "wb", &file) ||
+             fwrite(segment, 1, WAL_JOBS_SEGMENT_SIZE, file) != WAL_JOBS_SEGMENT_SIZE)
+         {
+            goto cleanup;
+         }
+         fclose(file);
+         file = NULL;
+
+         memset(segment, 0, WAL_JOBS_SEGMENT_SIZE);
+         offset = 0;
+         segno++;
+         continue;
+      }
+
+      if (offset % RANDOM_XLOG_BLCKSZ == 0)
+      {
+         memset(&short_header, 0, sizeof(short_header));
+         short_header.xlp_magic = RANDOM_MAGIC;
+         short_header.xlp_info = written > 0 ? XLP_FIRST_IS_CONTRECORD : 0;
+         short_header.xlp_tli = RANDOM_TLI;
+         short_header.xlp_pageaddr = (xlog_rec_ptr)segno * WAL_JOBS_SEGMENT_SIZE + offset;
+         short_header.xlp_rem_len = written > 0 ? length - written : 0;
+
+         if (offset == 0)
+         {
+            memset(&long_header, 0, sizeof(long_header));
+            long_header.std = short_header;
+            long_header.std.xlp_info |= XLP_LONG_HEADER;
+            long_header.xlp_seg_size = WAL_JOBS_SEGMENT_SIZE;
+            long_header.xlp_xlog_blcksz = RANDOM_XLOG_BLCKSZ;
+            memcpy(segment, &long_header, sizeof(long_header));
+            offset = SIZE_OF_XLOG_LONG_PHD;
+         }
+         else
+         {
+            memcpy(segment + offset, &short_header, sizeof(short_header));
+            offset += SIZE_OF_XLOG_SHORT_PHD;
+         }
+         continue;
+      }
+
+      chunk = MIN(length - written, RANDOM_XLOG_BLCKSZ - offset % RANDOM_XLOG_BLCKSZ);
+      memcpy(segment + offset, encoded + written, chunk);
+      offset += chunk;
+      written += chunk;
+
+      if (written == length)
+      {
+         written = 0;
+         records++;
+      }
+   }
+
+   pgmoneta_snprintf(path, sizeof(path), "%s/%08X%08X%08X", dir, RANDOM_TLI, 0, (uint32_t)number_of_segments);
+   if (pgmoneta_fopen_secure(path, "wb", &file) ||
+       fwrite(segment, 1, WAL_JOBS_SEGMENT_SIZE, file) != WAL_JOBS_SEGMENT_SIZE)
+   {
+      goto cleanup;
+   }
+
+   *number_of_records = records;
+   ret = 0;
+
+cleanup:
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   free(segment);
+   free(encoded);
+   pgmoneta_destroy_walfile(wf);
+
+   return ret;
+}
+
 #define PREPARE_AND_CREATE_WAL(path, wf)                                                                              \
    do                                                                                                                 \
    {                                                                                                                  \
@@ -683,6 +841,109 @@ cleanup:
    MCTF_FINISH();
 }
 
+MCTF_TEST(test_walinfo_cli_directory_jobs)
+{
+   char wal_dir[MAX_PATH];
+   char tar_path[MAX_PATH];
+   char cmd[MAX_PATH * 3];
+   char* arguments[] = {"", "-F json", "-S"};
+   char* output = NULL;
+   char* parallel_output = NULL;
+   char* tar_output = NULL;
+   char* p = NULL;
+   char parallel_arguments[64];
+   int exit_code = 1;
+   int records = 0;
+   int found = 0;
+
+   pgmoneta_test_setup();
+
+   memset(wal_dir, 0, sizeof(wal_dir));
+   pgmoneta_snprintf(wal_dir, sizeof(wal_dir), "%s%s", TEST_BASE_DIR, WAL_JOBS_TEST_SUBDIR);
+
+   memset(tar_path, 0, sizeof(tar_path));
+   pgmoneta_snprintf(tar_path, sizeof(tar_path), "%s%s.tar", TEST_BASE_DIR, WAL_JOBS_TEST_SUBDIR);
+
+   if (pgmoneta_exists(wal_dir))
+   {
+      pgmoneta_delete_directory(wal_dir);
+   }
+   MCTF_ASSERT_INT_EQ(pgmoneta_mkdir(wal_dir), 0, cleanup, "Failed to create WAL directory");
+
+   /* More segments than runs in flight, so that the reorder window is exercised */
+   MCTF_ASSERT_INT_EQ(create_wal_segments(wal_dir, WAL_JOBS_SEGMENTS, &records), 0,
+                      cleanup, "Failed to create WAL segments");
+
+   memset(cmd, 0, sizeof(cmd));
+   pgmoneta_snprintf(cmd, sizeof(cmd), "tar cf \"%s\" -C \"%s\" .", tar_path, wal_dir);
+   MCTF_ASSERT_INT_EQ(pgmoneta_test_exec_command(cmd, &tar_output, &exit_code), 0,
+                      cleanup, "Failed to create tar archive");
+   MCTF_ASSERT_INT_EQ(exit_code, 0, cleanup, "tar failed, output: %s", tar_output ? tar_output : "<null>");
+
+   for (int i = 0; i < (int)(sizeof(arguments) / sizeof(arguments[0])); i++)
+   {
+      exit_code = 1;
+      MCTF_ASSERT_INT_EQ(pgmoneta_walinfo_cli(wal_dir, arguments[i], &output, &exit_code), 0,
+                         cleanup, "Failed to execute walinfo CLI on directory");
+      MCTF_ASSERT_INT_EQ(exit_code, 0, cleanup, "walinfo CLI on directory returned non-zero exit code, output: %s",
+                         output ? output : "<null>");
+
+      if (i == 0)
+      {
+         /* Every record crossing a segment boundary is stitched exactly once */
+         found = 0;
+         for (p = strstr(output, "CHECKPOINT_SHUTDOWN"); p != NULL; p = strstr(p + 1, "CHECKPOINT_SHUTDOWN"))
+         {
+            found++;
+         }
+         MCTF_ASSERT_INT_EQ(found, records, cleanup, "Unexpected number of records in directory WAL output");
+      }
+
+      for (int jobs = 2; jobs <= 4; jobs += 2)
+      {
+         pgmoneta_snprintf(parallel_arguments, sizeof(parallel_arguments), "-j %d %s", jobs, arguments[i]);
+
+         exit_code = 1;
+         MCTF_ASSERT_INT_EQ(pgmoneta_walinfo_cli(wal_dir, parallel_arguments, &parallel_output, &exit_code), 0,
+                            cleanup, "Failed to execute walinfo CLI with %s", parallel_arguments);
+         MCTF_ASSERT_INT_EQ(exit_code, 0, cleanup, "walinfo CLI with %s returned non-zero exit code, output: %s",
+                            parallel_arguments, parallel_output ? parallel_output : "<null>");
+         MCTF_ASSERT_STR_EQ(parallel_output, output, cleanup, "Parallel output with %s differs from sequential output",
+                            parallel_arguments);
+         free(parallel_output);
+         parallel_output = NULL;
+
+         exit_code = 1;
+         MCTF_ASSERT_INT_EQ(pgmoneta_walinfo_cli(tar_path, parallel_arguments, &parallel_output, &exit_code), 0,
+                            cleanup, "Failed to execute walinfo CLI on tar archive with %s", parallel_arguments);
+         MCTF_ASSERT_INT_EQ(exit_code, 0, cleanup, "walinfo CLI on tar archive with %s returned non-zero exit code, output: %s",
+                            parallel_arguments, parallel_output ? parallel_output : "<null>");
+         MCTF_ASSERT_STR_EQ(parallel_output, output, cleanup, "Tar archive output with %s differs from sequential output",
+                            parallel_arguments);
+         free(parallel_output);
+         parallel_output = NULL;
+      }
+
+      free(output);
+      output = NULL;
+   }
+
+cleanup:
+   free(output);
+   free(parallel_output);
+   free(tar_output);
+   if (pgmoneta_exists(tar_path))
+   {
+      unlink(tar_path);
+   }
+   if (pgmoneta_exists(wal_dir))
+   {
+      pgmoneta_delete_directory(wal_dir);
+   }
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}
+
 MCTF_TEST(test_walinfo_cli_summary_flag)
 {
    char path[MAX_PATH];
@@ -876,3 +1137,50 @@ cleanup:
    pgmoneta_test_teardown();
    MCTF_FINISH();
 }
+
+MCTF_TEST(test_walinfo_read_mappings_from_json)
+{
+   char path[] = "/tmp/pgmoneta_mappings_XXXXXX";
+   char* name = NULL;
+   FILE* file = NULL;
+   int fd = -1;
+
+   pgmoneta_test_setup();
+
+   fd = mkstemp(path);
+   MCTF_ASSERT(fd != -1, cleanup, "failed to create the mappings file");
+   file = fdopen(fd, "w");
+   MCTF_ASSERT_PTR_NONNULL(file, cleanup, "failed to open the mappings file");
+
+   /* The format documented in the manual, with OIDs no generated WAL uses */
+   fprintf(file, "{\"tablespaces\": [{\"mapping_space\": \"990001\"}],"
+           " \"databases\": [{\"mapping_db\": \"990002\"}],"
+           " \"relations\": [{\"public.mapping_a\": \"990003\"}, {\"public.mapping_b\": \"990004\"}]}\n");
+   fclose(file);
+   file = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_read_mappings_from_json(path), 0, cleanup, "failed to read the mappings");
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_get_tablespace_name(990001, &name), 0, cleanup, "tablespace lookup failed");
+   MCTF_ASSERT_STR_EQ(name, "mapping_space", cleanup, "tablespace name mismatch");
+   free(name);
+   name = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_get_database_name(990002, &name), 0, cleanup, "database lookup failed");
+   MCTF_ASSERT_STR_EQ(name, "mapping_db", cleanup, "database name mismatch");
+   free(name);
+   name = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgmoneta_get_relation_name(990004, &name), 0, cleanup, "relation lookup failed");
+   MCTF_ASSERT_STR_EQ(name, "public.mapping_b", cleanup, "relation name mismatch");
+
+cleanup:
+   free(name);
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+   unlink(path);
+   pgmoneta_test_teardown();
+   MCTF_FINISH();
+}